@@ -23,35 +23,69 @@
 
 #include "cxconfig.h"
 
+#include "cxutil/cxbench.h"
+#include "cxutil/cxhash.h"
 #include "cxutil/cxio.h"
+#include "cxutil/cxreclaim.h"
+#include "cxutil/cxsnapshot.h"
+#include "cxutil/cxthreadpool.h"
 #include "cxutil/cxtime.h"
 #include "cxutil/cxgraphics.h"
 
+#include "cxstructs/BTreeMap.h"
 #include "cxstructs/BinaryTree.h"
+#include "cxstructs/BloomFilter.h"
+#include "cxstructs/CSRGraph.h"
+#include "cxstructs/ConcurrentHashMap.h"
+#include "cxstructs/ConcurrentPriorityQueue.h"
+#include "cxstructs/ConcurrentQueue.h"
 #include "cxstructs/DeQueue.h"
 #include "cxstructs/DoubleLinkedList.h"
+#include "cxstructs/FlatHashMap.h"
+#include "cxstructs/FlatQuadTree.h"
+#include "cxstructs/AABBTree.h"
 #include "cxstructs/Geometry.h"
+#include "cxstructs/Grid2D.h"
 #include "cxstructs/HashMap.h"
 #include "cxstructs/HashSet.h"
+#include "cxstructs/IntrusiveList.h"
+#include "cxstructs/LRUCache.h"
 #include "cxstructs/LinkedList.h"
 #include "cxstructs/Pair.h"
 #include "cxstructs/PriorityQueue.h"
+#include "cxstructs/TopK.h"
 #include "cxstructs/QuadTree.h"
 #include "cxstructs/Queue.h"
+#include "cxstructs/SlidingWindow.h"
+#include "cxstructs/RadixTrie.h"
 #include "cxstructs/Stack.h"
+#include "cxstructs/StaticHashMap.h"
 #include "cxstructs/Trie.h"
+#include "cxstructs/UnrolledList.h"
+#include "cxstructs/WorkStealingDeque.h"
+#include "cxstructs/k-Tree.h"
 #include "cxstructs/mat.h"
+#include "cxstructs/packed_vec.h"
+#include "cxstructs/qmat.h"
 #include "cxstructs/row.h"
+#include "cxstructs/bitset.h"
+#include "cxstructs/fixed_mat.h"
+#include "cxstructs/small_vec.h"
+#include "cxstructs/soa_vec.h"
 #include "cxstructs/vec.h"
 #include "cxstructs/HashGrid.h"
 
 #include "cxml/FNN.h"
+#include "cxml/StaticFNN.h"
+#include "cxml/IVFIndex.h"
 #include "cxml/k-NN.h"
 #include "cxml/word2vec.h"
 
+#include "cxalgos/ExternalSort.h"
 #include "cxalgos/GraphTraversal.h"
 #include "cxalgos/MathFunctions.h"
 #include "cxalgos/Misc.h"
+#include "cxalgos/Parallel.h"
 #include "cxalgos/PathFinding.h"
 #include "cxalgos/PatternMatching.h"
 #include "cxalgos/Search.h"
@@ -0,0 +1,451 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXALGOS_EXTERNALSORT_H_
+#define CXSTRUCTS_SRC_CXALGOS_EXTERNALSORT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxio.h"
+#include "../cxutil/cxthreadpool.h"
+#include "Sorting.h"
+
+// External merge sort for files of fixed width records that dont fit into memory
+// Run generation: the input is mapped with MappedFile and copied out in chunks of half the memory budget.
+// While one chunk is sorted with parallel_sort() the previous sorted run is written to a temp file by
+// another thread. The consumed part of the mapping is dropped from the page cache right away.
+// Merge: all runs (at most fan_in per pass) are merged through a loser tree - log2(k) comparisons per record
+// on a fixed path from leaf to root. Every run reader and the output writer have two blocks: one is consumed
+// or filled while the other is read or written asynchronously, so the disk stays busy during the merge
+
+namespace cxhelper {
+/**
+ * Tournament tree over k sequences - every inner node keeps the loser of its match, the overall winner is
+ * stored separately. After the winner's sequence advanced, replay() only walks from its leaf to the root.<br>
+ * less(i, j) compares the current heads of sequence i and j - exhausted sequences have to compare greater
+ * than everything
+ */
+template <typename Less>
+class LoserTree {
+  std::vector<uint_32_cx> tree_;  // inner nodes 1..k-1, leaves are at k..2k-1
+  uint_32_cx k_;
+  uint_32_cx winner_ = 0;
+  Less less_;
+
+  uint_32_cx build(uint_32_cx node) {
+    if (node >= k_) {
+      return node - k_;
+    }
+    uint_32_cx left = build(2 * node);
+    uint_32_cx right = build(2 * node + 1);
+    if (less_(right, left)) {
+      std::swap(left, right);
+    }
+    tree_[node] = right;
+    return left;
+  }
+
+ public:
+  LoserTree(uint_32_cx k, Less less) : tree_(std::max<uint_32_cx>(k, 1)), k_(k), less_(std::move(less)) {
+    if (k_ > 0) {
+      winner_ = build(1);
+    }
+  }
+  // The sequence with the smallest head
+  [[nodiscard]] inline uint_32_cx winner() const noexcept { return winner_; }
+  // Call after the head of the winner changed
+  inline void replay() noexcept {
+    uint_32_cx winner = winner_;
+    for (uint_32_cx node = (winner + k_) / 2; node > 0; node /= 2) {
+      if (less_(tree_[node], winner)) {
+        std::swap(tree_[node], winner);
+      }
+    }
+    winner_ = winner;
+  }
+};
+
+inline std::FILE* open_unbuffered(const std::filesystem::path& path, const char* mode) noexcept {
+  std::FILE* file = std::fopen(path.string().c_str(), mode);
+  if (file) {
+    std::setvbuf(file, nullptr, _IONBF, 0);  // blocks are large, the stdio buffer would only copy
+  }
+  return file;
+}
+
+/**
+ * Reads a run of records through two blocks - the next one is read asynchronously while the current one
+ * is consumed
+ */
+template <typename T>
+class RunReader {
+  std::FILE* file_ = nullptr;
+  std::unique_ptr<T[]> blocks_[2];
+  size_t len_[2] = {0, 0};
+  size_t capacity_ = 0;
+  size_t pos_ = 0;
+  uint64_t unread_ = 0;  // records not yet requested from the file
+  int current_ = 0;
+  bool ok_ = true;
+  std::future<size_t> next_;
+
+  void fetch(int block) {
+    const auto n = static_cast<size_t>(std::min<uint64_t>(capacity_, unread_));
+    unread_ -= n;
+    len_[block] = n;
+    next_ = std::async(std::launch::async,
+                       [file = file_, data = blocks_[block].get(), n] { return std::fread(data, sizeof(T), n, file); });
+  }
+
+ public:
+  RunReader() = default;
+  RunReader(const RunReader&) = delete;
+  RunReader& operator=(const RunReader&) = delete;
+  ~RunReader() { close(); }
+
+  bool open(const std::filesystem::path& path, uint64_t count, size_t capacity) {
+    file_ = open_unbuffered(path, "rb");
+    if (!file_) {
+      return false;
+    }
+    capacity_ = capacity;
+    unread_ = count;
+    blocks_[0] = std::make_unique_for_overwrite<T[]>(capacity_);
+    blocks_[1] = std::make_unique_for_overwrite<T[]>(capacity_);
+    fetch(0);
+    ok_ = next_.get() == len_[0];
+    if (unread_ > 0) {
+      fetch(1);
+    }
+    return ok_;
+  }
+  void close() noexcept {
+    if (next_.valid()) {
+      next_.wait();
+    }
+    if (file_) {
+      std::fclose(file_);
+      file_ = nullptr;
+    }
+  }
+  // The current record or nullptr once the run is exhausted
+  [[nodiscard]] inline const T* head() const noexcept {
+    return pos_ < len_[current_] ? &blocks_[current_][pos_] : nullptr;
+  }
+  inline void advance() {
+    if (++pos_ < len_[current_]) {
+      return;
+    }
+    pos_ = 0;
+    current_ ^= 1;
+    if (!next_.valid()) {
+      len_[current_] = 0;
+      return;
+    }
+    ok_ &= next_.get() == len_[current_];
+    if (unread_ > 0) {
+      fetch(current_ ^ 1);
+    }
+  }
+  [[nodiscard]] inline bool ok() const noexcept { return ok_; }
+};
+
+/**
+ * Writes records through two blocks - a full block is written asynchronously while the other one fills
+ */
+template <typename T>
+class RunWriter {
+  std::FILE* file_ = nullptr;
+  std::unique_ptr<T[]> blocks_[2];
+  size_t capacity_ = 0;
+  size_t len_ = 0;
+  int current_ = 0;
+  bool ok_ = true;
+  std::future<bool> pending_;
+
+ public:
+  RunWriter() = default;
+  RunWriter(const RunWriter&) = delete;
+  RunWriter& operator=(const RunWriter&) = delete;
+  ~RunWriter() { finish(); }
+
+  bool open(const std::filesystem::path& path, size_t capacity) {
+    file_ = open_unbuffered(path, "wb");
+    capacity_ = capacity;
+    blocks_[0] = std::make_unique_for_overwrite<T[]>(capacity_);
+    blocks_[1] = std::make_unique_for_overwrite<T[]>(capacity_);
+    return file_ != nullptr;
+  }
+  inline void push(const T& record) {
+    blocks_[current_][len_++] = record;
+    if (len_ == capacity_) {
+      flush();
+    }
+  }
+  void flush() {
+    if (pending_.valid()) {
+      ok_ &= pending_.get();
+    }
+    if (len_ > 0) {
+      pending_ = std::async(std::launch::async, [file = file_, data = blocks_[current_].get(), n = len_] {
+        return std::fwrite(data, sizeof(T), n, file) == n;
+      });
+      current_ ^= 1;
+      len_ = 0;
+    }
+  }
+  // Writes the rest and closes the file
+  bool finish() {
+    if (!file_) {
+      return ok_;
+    }
+    flush();
+    if (pending_.valid()) {
+      ok_ &= pending_.get();
+    }
+    ok_ &= std::fclose(file_) == 0;
+    file_ = nullptr;
+    return ok_;
+  }
+};
+
+template <typename T>
+inline bool write_records(const std::filesystem::path& path, const T* data, size_t n) {
+  std::FILE* file = open_unbuffered(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = std::fwrite(data, sizeof(T), n, file) == n;
+  ok &= std::fclose(file) == 0;
+  return ok;
+}
+
+struct SortRun {
+  std::filesystem::path path;
+  uint64_t count;
+};
+
+// Deletes the temp files of a sort on every exit path
+struct TempRuns {
+  std::vector<SortRun> runs;
+  ~TempRuns() {
+    std::error_code ec;
+    for (const auto& run : runs) {
+      std::filesystem::remove(run.path, ec);
+    }
+  }
+};
+
+template <typename T, typename Compare>
+bool merge_runs(const SortRun* runs, uint_32_cx k, const std::filesystem::path& output, Compare& comp,
+                size_t memory) {
+  // one block per reader and the writer, each split in two for the double buffering
+  const size_t block = std::max<size_t>(4096, memory / (2 * (k + 1)) / sizeof(T));
+  std::vector<RunReader<T>> readers(k);
+  for (uint_32_cx i = 0; i < k; i++) {
+    if (!readers[i].open(runs[i].path, runs[i].count, block)) {
+      return false;
+    }
+  }
+  RunWriter<T> writer;
+  if (!writer.open(output, block)) {
+    return false;
+  }
+  auto less = [&readers, &comp](uint_32_cx a, uint_32_cx b) {
+    const T* x = readers[a].head();
+    const T* y = readers[b].head();
+    return x != nullptr && (y == nullptr || comp(*x, *y));
+  };
+  LoserTree<decltype(less)> tree(k, less);
+  while (true) {
+    auto& reader = readers[tree.winner()];
+    const T* head = reader.head();
+    if (head == nullptr) {
+      break;
+    }
+    writer.push(*head);
+    reader.advance();
+    tree.replay();
+  }
+  bool ok = writer.finish();
+  for (const auto& reader : readers) {
+    ok &= reader.ok();
+  }
+  return ok;
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * Settings of external_sort()
+ */
+struct ExternalSortConfig {
+  size_t memory = size_t(256) << 20;  // bytes for sorting runs and for the merge buffers
+  uint_32_cx fan_in = 256;            // most runs merged at once - more runs take extra merge passes
+  std::string temp_dir;               // where runs are written - the system temp directory if empty
+  ThreadPool* pool = nullptr;         // pool for sorting the runs - the global one if nullptr
+};
+
+/**
+ * <h2>External merge sort</h2>
+ * Sorts a binary file of fixed width records that is larger than memory and writes the result to output.
+ * <br><br>
+ * The input is mapped in chunks of half the memory budget, each chunk is sorted with parallel_sort() and
+ * written as a run to a temp file while the next one is sorted. The runs are then merged through a loser
+ * tree with asynchronous double buffered reads and writes. More runs than fan_in are first merged in
+ * groups into longer runs. An input that fits into the budget is sorted in memory without temp files.
+ * <p>
+ * Needs about twice the input size of free disk space (runs + output). The sort is not stable.
+ * <pre>
+ * struct Record { uint64_t key; char payload[56]; };
+ * external_sort&lt;Record&gt;("in.bin", "out.bin", [](const Record& a, const Record& b) { return a.key &lt; b.key; });
+ * </pre>
+ * @tparam T trivially copyable record type - the file is an array of them
+ * @tparam Compare strict weak ordering like std::less
+ * @param input the file to sort
+ * @param output where the sorted records are written - must be a different file
+ * @param comp the order
+ * @param config memory budget, temp directory and thread pool
+ * @return false if a file couldnt be opened, read or written or the input isnt a whole number of records
+ */
+template <typename T, typename Compare = std::less<T>>
+bool external_sort(const std::string& input, const std::string& output, Compare comp = Compare(),
+                   const ExternalSortConfig& config = {}) {
+  static_assert(std::is_trivially_copyable_v<T>, "records are copied as raw bytes");
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  if (fs::exists(output, ec) && fs::equivalent(input, output, ec)) {
+    return false;
+  }
+  MappedFile in;
+  if (!in.open(input) || in.size() % sizeof(T) != 0) {
+    return false;
+  }
+  ThreadPool& pool = config.pool ? *config.pool : ThreadPool::global();
+  const uint64_t total = in.size() / sizeof(T);
+  const size_t memory = std::max(config.memory, 4 * sizeof(T));
+
+  if (total <= memory / sizeof(T)) {
+    auto data = std::make_unique_for_overwrite<T[]>(static_cast<size_t>(std::max<uint64_t>(total, 1)));
+    if (total > 0) {
+      std::memcpy(data.get(), in.data(), in.size());
+    }
+    in.close();
+    parallel_sort(data.get(), static_cast<uint_32_cx>(total), comp, pool);
+    return cxhelper::write_records(output, data.get(), static_cast<size_t>(total));
+  }
+
+  const fs::path dir = config.temp_dir.empty() ? fs::temp_directory_path(ec) : fs::path(config.temp_dir);
+  const std::string prefix = "cxsort-" + std::to_string(std::random_device{}()) + "-";
+  uint_32_cx next_id = 0;
+  auto temp_path = [&] { return dir / (prefix + std::to_string(next_id++) + ".run"); };
+  cxhelper::TempRuns temp;
+
+  // run generation - sorting one half while the other is written
+  const size_t run_len = memory / 2 / sizeof(T);
+  std::unique_ptr<T[]> halves[2] = {std::make_unique_for_overwrite<T[]>(run_len),
+                                    std::make_unique_for_overwrite<T[]>(run_len)};
+  std::future<bool> pending;
+  bool ok = true;
+  int current = 0;
+  in.advise(Access::SEQUENTIAL);
+  for (uint64_t begin = 0; begin < total && ok; begin += run_len) {
+    const auto n = static_cast<size_t>(std::min<uint64_t>(run_len, total - begin));
+    const size_t offset = static_cast<size_t>(begin) * sizeof(T);
+    in.advise(Access::WILL_NEED, offset + n * sizeof(T), n * sizeof(T));  // page in the next chunk
+    std::memcpy(halves[current].get(), in.data() + offset, n * sizeof(T));
+    in.advise(Access::DONT_NEED, offset, n * sizeof(T));
+    parallel_sort(halves[current].get(), static_cast<uint_32_cx>(n), comp, pool);
+
+    if (pending.valid()) {
+      ok &= pending.get();
+    }
+    temp.runs.push_back({temp_path(), n});
+    pending = std::async(std::launch::async, [path = temp.runs.back().path, data = halves[current].get(), n] {
+      return cxhelper::write_records(path, data, n);
+    });
+    current ^= 1;
+  }
+  if (pending.valid()) {
+    ok &= pending.get();
+  }
+  in.close();
+  halves[0].reset();
+  halves[1].reset();
+  if (!ok) {
+    return false;
+  }
+
+  // merge passes until fan_in runs are left, then the final merge into the output
+  const uint_32_cx fan_in = std::max<uint_32_cx>(config.fan_in, 2);
+  std::vector<cxhelper::SortRun> runs = temp.runs;
+  while (runs.size() > fan_in) {
+    std::vector<cxhelper::SortRun> merged;
+    for (size_t i = 0; i < runs.size(); i += fan_in) {
+      const auto k = static_cast<uint_32_cx>(std::min<size_t>(fan_in, runs.size() - i));
+      uint64_t count = 0;
+      for (uint_32_cx j = 0; j < k; j++) {
+        count += runs[i + j].count;
+      }
+      temp.runs.push_back({temp_path(), count});
+      merged.push_back(temp.runs.back());
+      if (!cxhelper::merge_runs<T>(runs.data() + i, k, merged.back().path, comp, memory)) {
+        return false;
+      }
+      for (uint_32_cx j = 0; j < k; j++) {
+        fs::remove(runs[i + j].path, ec);  // frees the disk space early
+      }
+    }
+    runs = std::move(merged);
+  }
+  return cxhelper::merge_runs<T>(runs.data(), static_cast<uint_32_cx>(runs.size()), output, comp, memory);
+}
+/**
+ * Sorts a binary file of arithmetic values with external_sort() in the given direction
+ * @tparam T arithmetic type
+ * @param input the file to sort
+ * @param output where the sorted values are written
+ * @param ascending false to sort descending
+ * @param config memory budget, temp directory and thread pool
+ * @return false if a file couldnt be opened, read or written
+ */
+template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+bool external_sort(const std::string& input, const std::string& output, bool ascending,
+                   const ExternalSortConfig& config = {}) {
+  if (ascending) {
+    return external_sort<T>(input, output, std::less<T>(), config);
+  }
+  return external_sort<T>(input, output, std::greater<T>(), config);
+}
+}  // namespace cxstructs
+
+#endif  // CXSTRUCTS_SRC_CXALGOS_EXTERNALSORT_H_
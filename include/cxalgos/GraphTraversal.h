@@ -21,52 +21,396 @@
 #ifndef CXSTRUCTS_DFS_H
 #define CXSTRUCTS_DFS_H
 
-#include <iostream>
-#include <unordered_map>
-#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include "../cxconfig.h"
-#include "../cxstructs/HashSet.h"
-#include "../cxstructs/Pair.h"
-#include "../cxstructs/vec.h"
+#include "../cxstructs/CSRGraph.h"
+#include "../cxstructs/PriorityQueue.h"
+#include "../cxstructs/bitset.h"
+#include "../cxutil/cxthreadpool.h"
 
 namespace cxstructs {
 
 /**
  * Treats the vector as an adjacency matrix
- * @return - the number of reachable nodes from the given start node
+ * @return - the number of reachable nodes from the given start node, including itself
  */
 template <typename T>
-int depth_first_search(std::vector<std::vector<T>>& mat, int nodeIndex,
-                       std::vector<bool> vis = {}) {
-  int count = 1;
-  if (mat.empty() || nodeIndex >= mat.size())
+int depth_first_search(const std::vector<std::vector<T>>& mat, int nodeIndex) {
+  if (nodeIndex < 0 || nodeIndex >= static_cast<int>(mat.size())) {
     return 0;
-  if (vis.empty()) {
+  }
+  bitset vis(mat.size());
+  std::vector<int> stack{nodeIndex};
+  vis.set(nodeIndex);
+  int count = 0;
+  while (!stack.empty()) {
+    const int node = stack.back();
+    stack.pop_back();
     count++;
-    vis = std::vector(mat.size(), false);
+    for (int i = 0; i < static_cast<int>(mat[node].size()); ++i) {
+      if (mat[node][i] == 1 && vis.test_and_set(i)) {
+        stack.push_back(i);
+      }
+    }
   }
+  return count;
+}
 
-  for (int i = 0; i < mat[nodeIndex].size(); ++i) {
-    if (mat[nodeIndex][i] == 1 && !vis[i]) {
-      vis[i] = true;
-      count += depth_first_search(mat, nodeIndex, vis);
+/**
+ * Iterative depth first search - an explicit stack of (vertex, next edge) replaces the recursion,
+ * so deep graphs cant overflow the call stack. Visited vertices are tracked in a bitset.
+ * @param graph the graph
+ * @param source start vertex
+ * @param visit called with every reached vertex in preorder
+ * @return the number of reached vertices, including source
+ */
+template <typename W, typename Visit>
+uint32_t depth_first_search(const CSRGraph<W>& graph, uint32_t source, Visit visit) {
+  using EdgeIndex = typename CSRGraph<W>::EdgeIndex;
+  if (source >= graph.vertices()) {
+    return 0;
+  }
+  bitset visited(graph.vertices());
+  std::vector<std::pair<uint32_t, EdgeIndex>> stack;
+  visited.set(source);
+  visit(source);
+  stack.emplace_back(source, graph.edge_begin(source));
+  uint32_t count = 1;
+  while (!stack.empty()) {
+    auto& [v, e] = stack.back();
+    if (e == graph.edge_end(v)) {
+      stack.pop_back();
+      continue;
+    }
+    const uint32_t u = graph.target(e++);
+    if (visited.test_and_set(u)) {
+      visit(u);
+      count++;
+      stack.emplace_back(u, graph.edge_begin(u));
     }
   }
   return count;
 }
-template <typename State, typename Action>
-vec<vec<std::pair<Action, State>>> shortest_path_search(
-    State start, std::unordered_map<State, Action> (*successors)(State), bool (*is_goal)(State)) {
-  if (is_goal(start)) {
-    return {{Action(), start}};
-  }
-  auto explored = HashSet<Action, State>();
-  auto frontier = vec<std::pair<Action, State>>();
-  while (!frontier.empty()) {
-    auto path = frontier.pop_front();
-    auto s = path.at[-1].second;
+/**
+ * @return the number of vertices reachable from source, including itself
+ */
+template <typename W>
+uint32_t depth_first_search(const CSRGraph<W>& graph, uint32_t source) {
+  return depth_first_search(graph, source, [](uint32_t) {});
+}
+
+/**
+ * Breadth first search over a flat queue with a bitset for the visited vertices
+ * @param graph the graph
+ * @param source start vertex
+ * @param depth resized to the vertex count, the number of edges from source or CSRGraph::kNone if unreached
+ * @return the number of reached vertices, including source
+ */
+template <typename W>
+uint32_t breadth_first_search(const CSRGraph<W>& graph, uint32_t source, std::vector<uint32_t>& depth) {
+  const uint32_t n = graph.vertices();
+  depth.assign(n, CSRGraph<W>::kNone);
+  if (source >= n) {
+    return 0;
+  }
+  bitset visited(n);
+  std::vector<uint32_t> queue;
+  queue.reserve(n);
+  queue.push_back(source);
+  visited.set(source);
+  depth[source] = 0;
+  for (std::size_t head = 0; head < queue.size(); head++) {
+    const uint32_t v = queue[head];
+    for (const uint32_t u : graph.neighbours(v)) {
+      if (visited.test_and_set(u)) {
+        depth[u] = depth[v] + 1;
+        queue.push_back(u);
+      }
+    }
+  }
+  return static_cast<uint32_t>(queue.size());
+}
+
+/**
+ * Direction optimizing parallel breadth first search (Beamer et al.) on the ThreadPool.
+ * <br><br>
+ * Small frontiers are expanded top-down: the threads split the frontier, claim unvisited neighbours with an
+ * atomic bit and append them to the next frontier in per chunk batches.<br>
+ * Once the frontier has more out-edges than the unvisited part of the graph (1/14th of it), a level is cheaper
+ * bottom-up: every unvisited vertex scans its in-edges and stops at the first parent in the frontier. It
+ * switches back once the frontier shrinks below 1/24th of the vertices.
+ * <br><br>
+ * Gives the same depths as breadth_first_search()
+ * @param graph the graph
+ * @param reverse the transpose of graph, used by the bottom-up steps
+ * @param source start vertex
+ * @param depth resized to the vertex count, the number of edges from source or CSRGraph::kNone if unreached
+ * @param pool the pool to run on
+ * @return the number of reached vertices, including source
+ */
+template <typename W>
+uint32_t parallel_breadth_first_search(const CSRGraph<W>& graph, const CSRGraph<W>& reverse, uint32_t source,
+                                       std::vector<uint32_t>& depth, ThreadPool& pool = ThreadPool::global()) {
+  using EdgeIndex = typename CSRGraph<W>::EdgeIndex;
+  constexpr EdgeIndex kAlpha = 14;
+  constexpr uint32_t kBeta = 24;
+  const uint32_t n = graph.vertices();
+  depth.assign(n, CSRGraph<W>::kNone);
+  if (source >= n) {
+    return 0;
+  }
+  CX_ASSERT(reverse.vertices() == n && reverse.edges() == graph.edges(), "reverse has to be the transpose");
+
+  bitset visited(n);
+  bitset front(n);
+  bitset next_front(n);
+  std::vector<uint32_t> frontier(n);
+  std::vector<uint32_t> next(n);
+  frontier[0] = source;
+  visited.set(source);
+  depth[source] = 0;
+
+  uint32_t frontier_size = 1;
+  uint32_t reached = 1;
+  EdgeIndex frontier_edges = graph.degree(source);
+  EdgeIndex unexplored = graph.edges() - frontier_edges;  // out-edges of unvisited vertices
+  bool bottom_up = false;
+  bool growing = true;
+  std::atomic<uint_32_cx> tail;
+  std::atomic<EdgeIndex> scout;
+
+  for (uint32_t level = 1; frontier_size > 0; level++) {
+    if (!bottom_up && frontier_edges > unexplored / kAlpha) {
+      front.clear();
+      for (uint32_t i = 0; i < frontier_size; i++) {
+        front.set(frontier[i]);
+      }
+      bottom_up = true;
+    } else if (bottom_up && !growing && frontier_size < n / kBeta) {
+      uint32_t count = 0;
+      front.for_each_set([&](size_t v) { frontier[count++] = static_cast<uint32_t>(v); });
+      bottom_up = false;
+    }
+    tail = 0;
+    scout = 0;
+    if (bottom_up) {
+      next_front.clear();
+      // nothing writes visited or front during the step
+      pool.parallel_for(
+          0, n,
+          [&](uint_32_cx begin, uint_32_cx end) {
+            uint_32_cx awake = 0;
+            EdgeIndex edges = 0;
+            for (auto v = static_cast<uint32_t>(begin); v < end; v++) {
+              if (visited.test(v)) {
+                continue;
+              }
+              for (const uint32_t parent : reverse.neighbours(v)) {
+                if (front.test(parent)) {
+                  depth[v] = level;
+                  next_front.atomic_set(v);
+                  awake++;
+                  edges += graph.degree(v);
+                  break;
+                }
+              }
+            }
+            tail += awake;
+            scout += edges;
+          },
+          4096);
+      visited |= next_front;
+      std::swap(front, next_front);
+    } else {
+      pool.parallel_for(
+          0, frontier_size,
+          [&](uint_32_cx begin, uint_32_cx end) {
+            std::vector<uint32_t> local;
+            EdgeIndex edges = 0;
+            for (uint_32_cx i = begin; i < end; i++) {
+              for (const uint32_t u : graph.neighbours(frontier[i])) {
+                if (!visited.atomic_test(u) && visited.atomic_test_and_set(u)) {
+                  depth[u] = level;
+                  local.push_back(u);
+                  edges += graph.degree(u);
+                }
+              }
+            }
+            const uint_32_cx at = tail.fetch_add(local.size());
+            std::copy(local.begin(), local.end(), next.begin() + at);
+            scout += edges;
+          },
+          64);
+      std::swap(frontier, next);
+    }
+    growing = tail > frontier_size;
+    frontier_size = static_cast<uint32_t>(tail.load());
+    frontier_edges = scout;
+    unexplored -= std::min(unexplored, frontier_edges);
+    reached += frontier_size;
+  }
+  return reached;
+}
+/**
+ * parallel_breadth_first_search() for undirected graphs, they are their own transpose
+ */
+template <typename W>
+uint32_t parallel_breadth_first_search(const CSRGraph<W>& graph, uint32_t source, std::vector<uint32_t>& depth,
+                                       ThreadPool& pool = ThreadPool::global()) {
+  CX_ASSERT(graph.symmetric(), "directed graphs need their transpose");
+  return parallel_breadth_first_search(graph, graph, source, depth, pool);
+}
+
+/**
+ * Dijkstra's shortest paths from one source. The frontier is an IndexedPriorityQueue keyed by vertex,
+ * so every vertex is queued at most once and improved with decrease_key instead of pushing duplicates.
+ * @param graph the graph, weights must not be negative
+ * @param source start vertex
+ * @param dist resized to the vertex count, the distance from source or numeric_limits<W>::max() if unreached
+ * @param parent if not null, resized to the vertex count and filled with the previous vertex on the shortest
+ * path, CSRGraph::kNone for source and unreached vertices
+ * @param target if given the search stops once its distance is final
+ * @return the number of vertices whose distance is final
+ */
+template <typename W>
+uint32_t dijkstra(const CSRGraph<W>& graph, uint32_t source, std::vector<W>& dist,
+                  std::vector<uint32_t>* parent = nullptr, uint32_t target = CSRGraph<W>::kNone) {
+  const uint32_t n = graph.vertices();
+  dist.assign(n, std::numeric_limits<W>::max());
+  if (parent) {
+    parent->assign(n, CSRGraph<W>::kNone);
+  }
+  if (source >= n) {
+    return 0;
+  }
+  IndexedPriorityQueue<W> open(n);
+  dist[source] = W(0);
+  open.insert(source, W(0));
+  uint32_t settled = 0;
+  while (!open.empty()) {
+    const uint32_t v = open.top_handle();
+    open.pop();
+    settled++;
+    if (v == target) {
+      break;
+    }
+    for (auto e = graph.edge_begin(v); e < graph.edge_end(v); e++) {
+      CX_ASSERT(graph.weight(e) >= W(0), "negative edge weight");
+      const uint32_t u = graph.target(e);
+      const W d = dist[v] + graph.weight(e);
+      if (d < dist[u]) {
+        if (open.contains(u)) {
+          open.decrease_key(u, d);
+        } else {
+          // a settled vertex cant improve with non negative weights
+          open.insert(u, d);
+        }
+        dist[u] = d;
+        if (parent) {
+          (*parent)[u] = v;
+        }
+      }
+    }
   }
+  return settled;
+}
+
+/**
+ * Bidirectional Dijkstra between two vertices: one search from source over graph, one from target over its
+ * transpose, always advancing the side with the smaller frontier key. It stops once the two keys together
+ * reach the best meeting distance, which usually settles far fewer vertices than a one sided search.
+ * @param graph the graph, weights must not be negative
+ * @param reverse the transpose of graph
+ * @param source start vertex
+ * @param target end vertex
+ * @param path if not null, filled with the vertices from source to target - empty if unreachable
+ * @return the shortest distance or numeric_limits<W>::max() if target is unreachable
+ */
+template <typename W>
+W bidirectional_dijkstra(const CSRGraph<W>& graph, const CSRGraph<W>& reverse, uint32_t source,
+                         uint32_t target, std::vector<uint32_t>* path = nullptr) {
+  constexpr W kInf = std::numeric_limits<W>::max();
+  constexpr uint32_t kNone = CSRGraph<W>::kNone;
+  const uint32_t n = graph.vertices();
+  if (path) {
+    path->clear();
+  }
+  if (source >= n || target >= n) {
+    return kInf;
+  }
+  CX_ASSERT(reverse.vertices() == n && reverse.edges() == graph.edges(), "reverse has to be the transpose");
+  if (source == target) {
+    if (path) {
+      path->push_back(source);
+    }
+    return W(0);
+  }
+  struct Side {
+    const CSRGraph<W>& graph;
+    std::vector<W> dist;
+    std::vector<uint32_t> parent;
+    IndexedPriorityQueue<W> open;
+    Side(const CSRGraph<W>& g, uint32_t n, uint32_t start)
+        : graph(g), dist(n, std::numeric_limits<W>::max()), parent(n, CSRGraph<W>::kNone), open(n) {
+      dist[start] = W(0);
+      open.insert(start, W(0));
+    }
+  };
+  Side forward(graph, n, source);
+  Side backward(reverse, n, target);
+  W best = kInf;
+  uint32_t meet = kNone;
+
+  while (!forward.open.empty() && !backward.open.empty()) {
+    if (forward.open.top() + backward.open.top() >= best) {
+      break;
+    }
+    Side& side = forward.open.top() <= backward.open.top() ? forward : backward;
+    const Side& other = &side == &forward ? backward : forward;
+    const uint32_t v = side.open.top_handle();
+    side.open.pop();
+    for (auto e = side.graph.edge_begin(v); e < side.graph.edge_end(v); e++) {
+      CX_ASSERT(side.graph.weight(e) >= W(0), "negative edge weight");
+      const uint32_t u = side.graph.target(e);
+      const W d = side.dist[v] + side.graph.weight(e);
+      if (d < side.dist[u]) {
+        if (side.open.contains(u)) {
+          side.open.decrease_key(u, d);
+        } else {
+          side.open.insert(u, d);
+        }
+        side.dist[u] = d;
+        side.parent[u] = v;
+      }
+      if (other.dist[u] != kInf && side.dist[u] + other.dist[u] < best) {
+        best = side.dist[u] + other.dist[u];
+        meet = u;
+      }
+    }
+  }
+  if (path && meet != kNone) {
+    for (uint32_t v = meet; v != kNone; v = forward.parent[v]) {
+      path->push_back(v);
+    }
+    std::reverse(path->begin(), path->end());
+    for (uint32_t v = backward.parent[meet]; v != kNone; v = backward.parent[v]) {
+      path->push_back(v);
+    }
+  }
+  return best;
+}
+/**
+ * bidirectional_dijkstra() for undirected graphs, they are their own transpose
+ */
+template <typename W>
+W bidirectional_dijkstra(const CSRGraph<W>& graph, uint32_t source, uint32_t target,
+                         std::vector<uint32_t>* path = nullptr) {
+  CX_ASSERT(graph.symmetric(), "directed graphs need their transpose");
+  return bidirectional_dijkstra(graph, graph, source, target, path);
 }
 }  // namespace cxstructs
 
@@ -21,57 +21,1176 @@
 #ifndef CXSTRUCTS_ASTAR_PATHFINDING_H
 #define CXSTRUCTS_ASTAR_PATHFINDING_H
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
+#include <mutex>
 #include <queue>
+#include <span>
 #include <type_traits>
+#include <vector>
 #include "../cxconfig.h"
 #include "../cxstructs/Geometry.h"
-#include "../cxstructs/HashSet.h"
-#include "../cxstructs/Pair.h"
+#include "../cxstructs/Grid2D.h"
 #include "../cxstructs/PriorityQueue.h"
+#include "../cxstructs/bitset.h"
+#include "../cxutil/cxthreadpool.h"
 
 namespace cxhelper {
 using namespace cxstructs;
-struct Node {
-  Point position;
-  uint16_t f_cost;
-  uint16_t g_cost;
-  uint16_t h_cost;
-  Node* parent;
-  Node() {}
-  Node(const Node& n)
-      : f_cost(n.f_cost),
-        position(n.position),
-        parent(n.parent),
-        h_cost(n.h_cost),
-        g_cost(n.g_cost) {}
-  Node(Point position, uint16_t g_cost, uint16_t h_cost, Node* parent)
-      : position(position),
-        g_cost(g_cost),
-        h_cost(h_cost),
-        f_cost(g_cost + h_cost),
-        parent(parent) {}
-
-  inline bool operator<(const Node& o) const { return f_cost < o.f_cost; }
-  inline bool operator>(const Node& o) const { return f_cost > o.f_cost; }
-  inline bool operator==(const Node& o) const { return f_cost == o.f_cost; }
-  inline bool operator<=(const Node& o) const { return f_cost <= o.f_cost; }
+constexpr float kSqrt2 = 1.41421356F;
+// the 4 orthogonal directions first, then the diagonals
+constexpr int kGridDirs[8][2] = {{1, 0},  {-1, 0}, {0, 1},  {0, -1},
+                                 {1, 1},  {-1, 1}, {1, -1}, {-1, -1}};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * FOUR moves orthogonally with cost 1 and the manhattan heuristic.<p>
+ * EIGHT also moves diagonally with cost sqrt(2) and the octile heuristic. Diagonal moves
+ * cant cut corners: both orthogonal neighbours have to be free
+ */
+enum class Neighbourhood : uint8_t { FOUR, EIGHT };
+
+/**
+ * <h2>GridAStar</h2>
+ * Reusable A* engine for grids.
+ * <br><br>
+ * All per cell state (g cost, parent, closed bit, heap position) lives in flat arrays
+ * sized to the field once. The closed set is a stamped_bitset, clearing it only increments a generation, and
+ * g cost and parent are only read for open or closed cells. A query therefore allocates nothing
+ * and only touches the cells it expands, no matter how big the field is.<br>
+ * The frontier is an IndexedPriorityQueue (4-ary) keyed by cell, so every cell is in it at most once and its
+ * contains() is the open set.
+ * <br><br>
+ * Not thread safe - use one engine per thread.
+ * <pre>
+ * GridAStar astar;
+ * std::vector<Point> path;
+ * astar.find_path(FieldView(tiles, w, h), WALL, start, target, path, Neighbourhood::EIGHT);
+ * </pre>
+ */
+class GridAStar {
+ protected:
+  static constexpr uint32_t kNone = UINT32_MAX;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  struct OpenKey {
+    float f;
+    float g;
+  };
+  struct OpenAfter {
+    // on equal f prefer the deeper node, it is closer to the target
+    inline bool operator()(const OpenKey& a, const OpenKey& b) const noexcept {
+      return a.f > b.f || (a.f == b.f && a.g < b.g);
+    }
+  };
+  std::vector<float> g_;
+  std::vector<uint32_t> parent_;
+  stamped_bitset closed_;
+  IndexedPriorityQueue<OpenKey, OpenAfter> open_;  // cells are the handles, contains() is the open set
+  uint32_t expanded_ = 0;
+  float cost_ = 0;
+
+  inline uint32_t pop() noexcept {
+    const uint32_t top = open_.top_handle();
+    open_.pop();
+    return top;
+  }
+  [[nodiscard]] inline bool is_open(uint32_t cell) const noexcept { return open_.contains(cell); }
+  [[nodiscard]] inline bool is_closed(uint32_t cell) const noexcept { return closed_.test(cell); }
+  // opens the cell or lowers its cost, returns false if the new cost isnt better
+  inline bool relax(uint32_t cell, float g, float h, uint32_t parent) {
+    if (is_closed(cell) || (is_open(cell) && g >= g_[cell])) {
+      return false;
+    }
+    g_[cell] = g;
+    parent_[cell] = parent;
+    if (is_open(cell)) {
+      open_.update(cell, {g + h, g});
+    } else {
+      open_.insert(cell, {g + h, g});
+    }
+    return true;
+  }
+  inline void new_query(uint32_t width, uint32_t height) {
+    if (width != width_ || height != height_) {
+      reserve(width, height);
+    }
+    closed_.clear();
+    open_.clear();
+    expanded_ = 0;
+    cost_ = 0;
+  }
+  [[nodiscard]] static inline float heuristic(int64_t x, int64_t y, int64_t tx, int64_t ty,
+                                              Neighbourhood n) noexcept {
+    const auto dx = static_cast<float>(std::abs(x - tx));
+    const auto dy = static_cast<float>(std::abs(y - ty));
+    if (n == Neighbourhood::FOUR) {
+      return dx + dy;
+    }
+    return std::max(dx, dy) + (kSqrt2 - 1) * std::min(dx, dy);
+  }
+  // appends the cells from start to cell
+  inline void reconstruct(uint32_t cell, std::vector<Point>& path) const {
+    const size_t first = path.size();
+    while (cell != kNone) {
+      path.emplace_back(static_cast<float>(cell % width_), static_cast<float>(cell / width_));
+      cell = parent_[cell];
+    }
+    std::reverse(path.begin() + first, path.end());
+  }
+  template <typename S, typename B>
+  [[nodiscard]] static inline bool passable(const FieldView<S>& field, const B& blocked,
+                                            int64_t x, int64_t y) noexcept {
+    return field.inside(x, y) && !(field(x, y) == blocked);
+  }
+
+ public:
+  GridAStar() = default;
+  /**
+   * @param width width of the fields the engine is used with
+   * @param height height of the fields the engine is used with
+   */
+  GridAStar(uint32_t width, uint32_t height) { reserve(width, height); }
+  /**
+   * Sizes the arrays for the given field size - done automatically on the first query with a new size
+   */
+  inline void reserve(uint32_t width, uint32_t height) {
+    width_ = width;
+    height_ = height;
+    const size_t cells = static_cast<size_t>(width) * height;
+    g_.resize(cells);
+    parent_.resize(cells);
+    open_.reserve(cells);
+    closed_.resize(cells);
+  }
+  /**
+   * Finds the shortest path from start to target
+   * @param field the search space
+   * @param blocked cells equal to this value are obstacles
+   * @param start the starting cell
+   * @param target the target cell
+   * @param path overwritten with the cells from start to target (both included) - empty if there is none
+   * @param neighbourhood FOUR or EIGHT connected moves
+   * @return true if a path was found
+   */
+  template <typename S, typename B>
+  bool find_path(const FieldView<S>& field, const B& blocked, const Point& start,
+                 const Point& target, std::vector<Point>& path,
+                 Neighbourhood neighbourhood = Neighbourhood::FOUR) {
+    path.clear();
+    new_query(field.width(), field.height());
+    const auto sx = static_cast<int64_t>(start.x()), sy = static_cast<int64_t>(start.y());
+    const auto tx = static_cast<int64_t>(target.x()), ty = static_cast<int64_t>(target.y());
+    if (!passable(field, blocked, sx, sy) || !passable(field, blocked, tx, ty)) {
+      return false;
+    }
+    const auto goal = static_cast<uint32_t>(tx + ty * width_);
+    relax(static_cast<uint32_t>(sx + sy * width_), 0, heuristic(sx, sy, tx, ty, neighbourhood),
+          kNone);
+    const int dirs = neighbourhood == Neighbourhood::FOUR ? 4 : 8;
+    while (!open_.empty()) {
+      const uint32_t cell = pop();
+      if (cell == goal) {
+        cost_ = g_[cell];
+        reconstruct(cell, path);
+        return true;
+      }
+      closed_.set(cell);
+      expanded_++;
+      const int64_t x = cell % width_, y = cell / width_;
+      for (int d = 0; d < dirs; d++) {
+        const int64_t nx = x + kGridDirs[d][0], ny = y + kGridDirs[d][1];
+        if (!passable(field, blocked, nx, ny)) {
+          continue;
+        }
+        float step = 1;
+        if (d >= 4) {
+          if (!passable(field, blocked, nx, y) || !passable(field, blocked, x, ny)) {
+            continue;
+          }
+          step = kSqrt2;
+        }
+        relax(static_cast<uint32_t>(nx + ny * width_), g_[cell] + step,
+              heuristic(nx, ny, tx, ty, neighbourhood), cell);
+      }
+    }
+    return false;
+  }
+  /**
+   * @return the cost of the last path found
+   */
+  [[nodiscard]] inline float last_cost() const noexcept { return cost_; }
+  /**
+   * @return the number of cells expanded by the last query
+   */
+  [[nodiscard]] inline uint32_t last_expanded() const noexcept { return expanded_; }
 };
 
-inline std::vector<Point> reconstruct_path(Node* target_node) {
-  std::vector<Point> path;
-  Node* node = target_node;
-  while (node) {
-    path.push_back(node->position);
-    node = node->parent;
+/**
+ * <h2>GridJPS</h2>
+ * Jump Point Search for uniform cost grids with 8 neighbours, same rules as GridAStar with
+ * Neighbourhood::EIGHT (no corner cutting) and the same optimal path costs.
+ * <br><br>
+ * Instead of putting every neighbour on the frontier, JPS jumps along straight and diagonal lines and only
+ * stops at cells where an obstacle forces a turn (jump points). Symmetric paths through open areas are
+ * never expanded, so open maps need orders of magnitude fewer heap operations than A*.
+ * The jump points are expanded back into a path through every cell.
+ */
+class GridJPS : public GridAStar {
+  int64_t tx_ = 0, ty_ = 0;
+
+  // true if a jump point lies on the straight line from (x, y) in direction (dx, dy), (x, y) excluded
+  template <typename S, typename B>
+  [[nodiscard]] inline bool straight_jump(const FieldView<S>& field, const B& blocked, int64_t x,
+                                          int64_t y, int dx, int dy) const noexcept {
+    while (true) {
+      x += dx;
+      y += dy;
+      if (!passable(field, blocked, x, y)) {
+        return false;
+      }
+      if ((x == tx_ && y == ty_) || forced(field, blocked, x, y, dx, dy)) {
+        return true;
+      }
+    }
+  }
+  // straight moves only: a side cell is free but the one behind it is blocked
+  template <typename S, typename B>
+  [[nodiscard]] static inline bool forced(const FieldView<S>& field, const B& blocked, int64_t x,
+                                          int64_t y, int dx, int dy) noexcept {
+    if (dx != 0) {
+      return (passable(field, blocked, x, y - 1) && !passable(field, blocked, x - dx, y - 1)) ||
+             (passable(field, blocked, x, y + 1) && !passable(field, blocked, x - dx, y + 1));
+    }
+    return (passable(field, blocked, x - 1, y) && !passable(field, blocked, x - 1, y - dy)) ||
+           (passable(field, blocked, x + 1, y) && !passable(field, blocked, x + 1, y - dy));
+  }
+  // jumps from (x, y) in direction (dx, dy), returns false if the line runs into an obstacle
+  template <typename S, typename B>
+  inline bool jump(const FieldView<S>& field, const B& blocked, int64_t& x, int64_t& y, int dx,
+                   int dy) const noexcept {
+    const bool diagonal = dx != 0 && dy != 0;
+    while (true) {
+      if (diagonal &&
+          (!passable(field, blocked, x + dx, y) || !passable(field, blocked, x, y + dy))) {
+        return false;
+      }
+      x += dx;
+      y += dy;
+      if (!passable(field, blocked, x, y)) {
+        return false;
+      }
+      if (x == tx_ && y == ty_) {
+        return true;
+      }
+      if (diagonal) {
+        if (straight_jump(field, blocked, x, y, dx, 0) ||
+            straight_jump(field, blocked, x, y, 0, dy)) {
+          return true;
+        }
+      } else if (forced(field, blocked, x, y, dx, dy)) {
+        return true;
+      }
+    }
+  }
+  // the directions worth searching from a cell reached moving in (dx, dy)
+  template <typename S, typename B>
+  inline int pruned(const FieldView<S>& field, const B& blocked, int64_t x, int64_t y, int dx,
+                    int dy, int (&dirs)[8][2]) const noexcept {
+    int n = 0;
+    auto add = [&](int ax, int ay) {
+      dirs[n][0] = ax;
+      dirs[n][1] = ay;
+      n++;
+    };
+    if (dx != 0 && dy != 0) {
+      const bool horizontal = passable(field, blocked, x + dx, y);
+      const bool vertical = passable(field, blocked, x, y + dy);
+      if (vertical) {
+        add(0, dy);
+      }
+      if (horizontal) {
+        add(dx, 0);
+      }
+      if (horizontal && vertical) {
+        add(dx, dy);
+      }
+    } else if (dx != 0) {
+      const bool up = passable(field, blocked, x, y - 1);
+      const bool down = passable(field, blocked, x, y + 1);
+      if (passable(field, blocked, x + dx, y)) {
+        add(dx, 0);
+        if (up) {
+          add(dx, -1);
+        }
+        if (down) {
+          add(dx, 1);
+        }
+      }
+      if (up) {
+        add(0, -1);
+      }
+      if (down) {
+        add(0, 1);
+      }
+    } else {
+      const bool left = passable(field, blocked, x - 1, y);
+      const bool right = passable(field, blocked, x + 1, y);
+      if (passable(field, blocked, x, y + dy)) {
+        add(0, dy);
+        if (left) {
+          add(-1, dy);
+        }
+        if (right) {
+          add(1, dy);
+        }
+      }
+      if (left) {
+        add(-1, 0);
+      }
+      if (right) {
+        add(1, 0);
+      }
+    }
+    return n;
   }
-  std::reverse(path.begin(), path.end());
-  return path;
-}
 
-}  // namespace cxhelper
+ public:
+  using GridAStar::GridAStar;
+  /**
+   * Finds the shortest 8-connected path from start to target
+   * @param field the search space
+   * @param blocked cells equal to this value are obstacles
+   * @param start the starting cell
+   * @param target the target cell
+   * @param path overwritten with every cell from start to target (both included) - empty if there is none
+   * @return true if a path was found
+   */
+  template <typename S, typename B>
+  bool find_path(const FieldView<S>& field, const B& blocked, const Point& start,
+                 const Point& target, std::vector<Point>& path) {
+    path.clear();
+    new_query(field.width(), field.height());
+    const auto sx = static_cast<int64_t>(start.x()), sy = static_cast<int64_t>(start.y());
+    tx_ = static_cast<int64_t>(target.x());
+    ty_ = static_cast<int64_t>(target.y());
+    if (!passable(field, blocked, sx, sy) || !passable(field, blocked, tx_, ty_)) {
+      return false;
+    }
+    const auto goal = static_cast<uint32_t>(tx_ + ty_ * width_);
+    relax(static_cast<uint32_t>(sx + sy * width_), 0,
+          heuristic(sx, sy, tx_, ty_, Neighbourhood::EIGHT), kNone);
+    int dirs[8][2];
+    bool found = false;
+    while (!open_.empty()) {
+      const uint32_t cell = pop();
+      if (cell == goal) {
+        cost_ = g_[cell];
+        found = true;
+        break;
+      }
+      closed_.set(cell);
+      expanded_++;
+      const int64_t x = cell % width_, y = cell / width_;
+      int n = 0;
+      if (parent_[cell] == kNone) {
+        for (int d = 0; d < 8; d++) {
+          const int dx = kGridDirs[d][0], dy = kGridDirs[d][1];
+          if (d < 4 ||
+              (passable(field, blocked, x + dx, y) && passable(field, blocked, x, y + dy))) {
+            dirs[n][0] = dx;
+            dirs[n++][1] = dy;
+          }
+        }
+      } else {
+        const int64_t px = parent_[cell] % width_, py = parent_[cell] / width_;
+        n = pruned(field, blocked, x, y, (x > px) - (x < px), (y > py) - (y < py), dirs);
+      }
+      for (int d = 0; d < n; d++) {
+        int64_t jx = x, jy = y;
+        if (!jump(field, blocked, jx, jy, dirs[d][0], dirs[d][1])) {
+          continue;
+        }
+        // a jump is a straight or a purely diagonal line, so its cost is the octile distance
+        relax(static_cast<uint32_t>(jx + jy * width_),
+              g_[cell] + heuristic(x, y, jx, jy, Neighbourhood::EIGHT),
+              heuristic(jx, jy, tx_, ty_, Neighbourhood::EIGHT), cell);
+      }
+    }
+    if (!found) {
+      return false;
+    }
+    std::vector<Point> jumps;
+    reconstruct(goal, jumps);
+    path.push_back(jumps[0]);
+    for (size_t i = 1; i < jumps.size(); i++) {
+      const Point& from = jumps[i - 1];
+      const Point& to = jumps[i];
+      const float dx = (to.x() > from.x()) - (to.x() < from.x());
+      const float dy = (to.y() > from.y()) - (to.y() < from.y());
+      Point p = from;
+      while (!(p == to)) {
+        p = Point(p.x() + dx, p.y() + dy);
+        path.push_back(p);
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * <h2>GridHPA</h2>
+ * Hierarchical pathfinding (HPA*) for big grids that change rarely.
+ * <br><br>
+ * The grid is split into square clusters. Every free stretch along a cluster border gets one entrance
+ * (two at its ends if it is 6 or more cells long), the entrance cells form an abstract graph. The distances
+ * between all entrances of a cluster are computed with a search limited to that cluster and cached.
+ * A query connects start and target to the entrances of their clusters, runs A* on the small abstract graph
+ * and refines each abstract step with a search inside a single cluster.
+ * <br><br>
+ * When cells change call invalidate() with them: only the borders and clusters around them are recomputed,
+ * lazily on the next query. The field has to be passed unchanged apart from invalidated cells.<p>
+ * Paths are near optimal - they are forced through the entrances, typically a few percent longer.
+ * Start and target inside the same cluster are first connected directly.
+ */
+class GridHPA {
+  static constexpr uint32_t kNone = UINT32_MAX;
+  static constexpr float kInf = 1e30F;
+  struct Entrance {
+    uint32_t a, b;  // a lies in the left/upper cluster
+    bool operator==(const Entrance& o) const noexcept = default;
+  };
+  struct Cluster {
+    std::vector<uint32_t> nodes;  // entrance cells in this cluster
+    std::vector<float> dist;      // nodes x nodes, kInf if not connected inside the cluster
+    bool dirty = true;
+  };
+  // a search limited to one cluster rectangle
+  struct LocalSearch {
+    uint32_t x0_ = 0, y0_ = 0, w_ = 0, h_ = 0, size_ = 0;
+    std::vector<float> g_;
+    std::vector<uint32_t> parent_;
+    std::vector<uint32_t> stamp_;
+    std::vector<uint32_t> want_;
+    IndexedPriorityQueue<float> open_;  // local indices are the handles
+    uint32_t generation_ = 0;
+  };
+
+  uint32_t cluster_size_;
+  Neighbourhood neighbourhood_;
+  uint32_t width_ = 0, height_ = 0;
+  uint32_t clusters_x_ = 0, clusters_y_ = 0;
+  std::vector<Cluster> clusters_;
+  std::vector<std::vector<Entrance>> vborders_;  // between (cx, cy) and (cx + 1, cy)
+  std::vector<std::vector<Entrance>> hborders_;  // between (cx, cy) and (cx, cy + 1)
+  std::vector<uint8_t> vdirty_, hdirty_;
+  bool built_ = false;
+  uint_32_cx threads_ = 1;
+  // flat abstract graph rebuilt from the clusters after every change
+  std::vector<uint32_t> node_cell_;
+  std::vector<uint32_t> cluster_first_;
+  std::vector<uint32_t> edge_begin_;
+  std::vector<std::pair<uint32_t, float>> edges_;
+  // abstract search state, two extra nodes for start and target
+  std::vector<float> ag_;
+  std::vector<uint32_t> aparent_;
+  std::vector<uint32_t> astamp_;
+  IndexedPriorityQueue<float> aopen_;
+  uint32_t ageneration_ = 0;
+  LocalSearch local_;
+  float cost_ = 0;
+  uint32_t rebuilt_ = 0;
+
+  [[nodiscard]] inline uint32_t cluster_of(uint32_t cell) const noexcept {
+    return (cell % width_) / cluster_size_ + (cell / width_) / cluster_size_ * clusters_x_;
+  }
+  [[nodiscard]] inline float estimate(uint32_t a, uint32_t b) const noexcept {
+    return GridAStarAccess::heuristic(a % width_, a / width_, b % width_, b / width_,
+                                      neighbourhood_);
+  }
+  struct GridAStarAccess : GridAStar {
+    using GridAStar::heuristic;
+    using GridAStar::passable;
+  };
+  template <typename S, typename B>
+  [[nodiscard]] static inline bool passable(const FieldView<S>& field, const B& blocked,
+                                            int64_t x, int64_t y) noexcept {
+    return GridAStarAccess::passable(field, blocked, x, y);
+  }
+
+  template <typename S, typename B>
+  void scan_border(const FieldView<S>& field, const B& blocked, bool vertical, uint32_t cx,
+                   uint32_t cy, std::vector<Entrance>& out) const {
+    out.clear();
+    const uint32_t length = vertical ? std::min(cluster_size_, height_ - cy * cluster_size_)
+                                     : std::min(cluster_size_, width_ - cx * cluster_size_);
+    auto cells = [&](uint32_t i) {
+      if (vertical) {
+        const uint32_t x = (cx + 1) * cluster_size_ - 1, y = cy * cluster_size_ + i;
+        return Entrance{x + y * width_, x + 1 + y * width_};
+      }
+      const uint32_t x = cx * cluster_size_ + i, y = (cy + 1) * cluster_size_ - 1;
+      return Entrance{x + y * width_, x + (y + 1) * width_};
+    };
+    auto open = [&](uint32_t i) {
+      const Entrance e = cells(i);
+      return passable(field, blocked, e.a % width_, e.a / width_) &&
+             passable(field, blocked, e.b % width_, e.b / width_);
+    };
+    for (uint32_t i = 0; i < length;) {
+      if (!open(i)) {
+        i++;
+        continue;
+      }
+      uint32_t end = i;
+      while (end < length && open(end)) {
+        end++;
+      }
+      if (end - i < 6) {
+        out.push_back(cells(i + (end - i) / 2));
+      } else {
+        out.push_back(cells(i));
+        out.push_back(cells(end - 1));
+      }
+      i = end;
+    }
+  }
+  inline void local_bounds(LocalSearch& l, uint32_t cluster) const {
+    l.x0_ = cluster % clusters_x_ * cluster_size_;
+    l.y0_ = cluster / clusters_x_ * cluster_size_;
+    l.w_ = std::min(cluster_size_, width_ - l.x0_);
+    l.h_ = std::min(cluster_size_, height_ - l.y0_);
+    if (l.stamp_.empty()) {
+      const size_t cells = static_cast<size_t>(cluster_size_) * cluster_size_;
+      l.g_.resize(cells);
+      l.parent_.resize(cells);
+      l.stamp_.assign(cells, 0);
+      l.want_.assign(cells, 0);
+      l.open_.reserve(cells);
+    }
+    if (l.generation_ >= (UINT32_MAX - 1) / 2) {
+      std::fill(l.stamp_.begin(), l.stamp_.end(), 0);
+      std::fill(l.want_.begin(), l.want_.end(), 0);
+      l.generation_ = 0;
+    }
+    l.generation_++;
+    l.open_.clear();
+  }
+  [[nodiscard]] inline uint32_t local_index(const LocalSearch& l, uint32_t cell) const noexcept {
+    return (cell / width_ - l.y0_) * l.w_ + (cell % width_ - l.x0_);
+  }
+  [[nodiscard]] inline uint32_t local_cell(const LocalSearch& l, uint32_t index) const noexcept {
+    return l.x0_ + index % l.w_ + (l.y0_ + index / l.w_) * width_;
+  }
+  [[nodiscard]] static inline bool local_done(const LocalSearch& l, uint32_t index) noexcept {
+    return l.stamp_[index] == 2 * l.generation_ + 1;
+  }
+  // A* to goal inside the cluster of source, or Dijkstra (goal == kNone) until all wanted cells are settled
+  template <typename S, typename B>
+  void local_search(LocalSearch& l, const FieldView<S>& field, const B& blocked, uint32_t source,
+                    uint32_t goal, std::span<const uint32_t> wanted = {}) const {
+    local_bounds(l, cluster_of(source));
+    uint32_t remaining = 0;
+    for (const uint32_t cell : wanted) {
+      uint32_t& want = l.want_[local_index(l, cell)];
+      remaining += want != l.generation_;
+      want = l.generation_;
+    }
+    const uint32_t first = local_index(l, source);
+    l.g_[first] = 0;
+    l.parent_[first] = kNone;
+    l.stamp_[first] = 2 * l.generation_;
+    l.open_.insert(first, goal == kNone ? 0 : estimate(source, goal));
+    const int dirs = neighbourhood_ == Neighbourhood::FOUR ? 4 : 8;
+    auto inside = [&](int64_t x, int64_t y) {
+      return x >= l.x0_ && y >= l.y0_ && x < l.x0_ + l.w_ && y < l.y0_ + l.h_ &&
+             passable(field, blocked, x, y);
+    };
+    while (!l.open_.empty()) {
+      const uint32_t index = l.open_.top_handle();
+      l.open_.pop();
+      l.stamp_[index] = 2 * l.generation_ + 1;
+      const uint32_t cell = local_cell(l, index);
+      if (cell == goal || (l.want_[index] == l.generation_ && --remaining == 0)) {
+        return;
+      }
+      const int64_t x = cell % width_, y = cell / width_;
+      for (int d = 0; d < dirs; d++) {
+        const int64_t nx = x + kGridDirs[d][0], ny = y + kGridDirs[d][1];
+        if (!inside(nx, ny) || (d >= 4 && (!inside(nx, y) || !inside(x, ny)))) {
+          continue;
+        }
+        const auto next = static_cast<uint32_t>(nx + ny * width_);
+        const uint32_t ni = local_index(l, next);
+        const float g = l.g_[index] + (d >= 4 ? kSqrt2 : 1.0F);
+        if (local_done(l, ni) || (l.stamp_[ni] == 2 * l.generation_ && g >= l.g_[ni])) {
+          continue;
+        }
+        const float f = g + (goal == kNone ? 0 : estimate(next, goal));
+        if (l.stamp_[ni] == 2 * l.generation_) {
+          l.open_.update(ni, f);
+        } else {
+          l.stamp_[ni] = 2 * l.generation_;
+          l.open_.insert(ni, f);
+        }
+        l.g_[ni] = g;
+        l.parent_[ni] = index;
+      }
+    }
+  }
+  // the cost of the last local search to cell, kInf if it wasnt reached
+  [[nodiscard]] inline float local_cost(const LocalSearch& l, uint32_t cell) const noexcept {
+    const uint32_t index = local_index(l, cell);
+    return local_done(l, index) ? l.g_[index] : kInf;
+  }
+  // appends the local path to cell (without the source)
+  inline void local_path(const LocalSearch& l, uint32_t cell, std::vector<Point>& path) const {
+    const size_t first = path.size();
+    for (uint32_t index = local_index(l, cell); l.parent_[index] != kNone; index = l.parent_[index]) {
+      const uint32_t c = local_cell(l, index);
+      path.emplace_back(static_cast<float>(c % width_), static_cast<float>(c / width_));
+    }
+    std::reverse(path.begin() + first, path.end());
+  }
+  static inline void add_sides(const std::vector<Entrance>& border, bool first,
+                               std::vector<uint32_t>& out) {
+    for (const auto& e : border) {
+      out.push_back(first ? e.a : e.b);
+    }
+  }
+  // collects the entrances of the cluster and the distances between all of them
+  template <typename S, typename B>
+  void rebuild_cluster(LocalSearch& l, const FieldView<S>& field, const B& blocked, uint32_t c) {
+    Cluster& cluster = clusters_[c];
+    const uint32_t cx = c % clusters_x_, cy = c / clusters_x_;
+    auto& nodes = cluster.nodes;
+    nodes.clear();
+    if (cx > 0) {
+      add_sides(vborders_[cx - 1 + cy * (clusters_x_ - 1)], false, nodes);
+    }
+    if (cx + 1 < clusters_x_) {
+      add_sides(vborders_[cx + cy * (clusters_x_ - 1)], true, nodes);
+    }
+    if (cy > 0) {
+      add_sides(hborders_[c - clusters_x_], false, nodes);
+    }
+    if (cy + 1 < clusters_y_) {
+      add_sides(hborders_[c], true, nodes);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    const size_t n = nodes.size();
+    cluster.dist.assign(n * n, kInf);
+    // distances are symmetric: search from node i only until all nodes after it are settled
+    for (size_t i = 0; i + 1 < n; i++) {
+      local_search(l, field, blocked, nodes[i], kNone, std::span(nodes).subspan(i + 1));
+      for (size_t j = i + 1; j < n; j++) {
+        cluster.dist[i * n + j] = cluster.dist[j * n + i] = local_cost(l, nodes[j]);
+      }
+    }
+    cluster.dirty = false;
+  }
+  template <typename S, typename B>
+  void update(const FieldView<S>& field, const B& blocked) {
+    std::vector<Entrance> scratch;
+    for (uint32_t cy = 0; cy < clusters_y_; cy++) {
+      for (uint32_t cx = 0; cx + 1 < clusters_x_; cx++) {
+        const uint32_t b = cx + cy * (clusters_x_ - 1);
+        if (vdirty_[b]) {
+          scan_border(field, blocked, true, cx, cy, scratch);
+          if (scratch != vborders_[b]) {
+            vborders_[b].swap(scratch);
+            clusters_[cx + cy * clusters_x_].dirty = true;
+            clusters_[cx + 1 + cy * clusters_x_].dirty = true;
+          }
+          vdirty_[b] = 0;
+        }
+      }
+    }
+    for (uint32_t cy = 0; cy + 1 < clusters_y_; cy++) {
+      for (uint32_t cx = 0; cx < clusters_x_; cx++) {
+        const uint32_t b = cx + cy * clusters_x_;
+        if (hdirty_[b]) {
+          scan_border(field, blocked, false, cx, cy, scratch);
+          if (scratch != hborders_[b]) {
+            hborders_[b].swap(scratch);
+            clusters_[b].dirty = true;
+            clusters_[b + clusters_x_].dirty = true;
+          }
+          hdirty_[b] = 0;
+        }
+      }
+    }
+    std::vector<uint32_t> dirty;
+    for (uint32_t c = 0; c < clusters_.size(); c++) {
+      if (clusters_[c].dirty) {
+        dirty.push_back(c);
+      }
+    }
+    if (dirty.empty()) {
+      return;
+    }
+    rebuilt_ += dirty.size();
+    if (threads_ <= 1 || dirty.size() < 8) {
+      for (const uint32_t c : dirty) {
+        rebuild_cluster(local_, field, blocked, c);
+      }
+    } else {
+      // clusters only write their own entry, each chunk gets its own search state
+      ThreadPool::global().parallel_for(0, dirty.size(), [&](uint_32_cx begin, uint_32_cx end) {
+        LocalSearch l;
+        for (uint_32_cx i = begin; i < end; i++) {
+          rebuild_cluster(l, field, blocked, dirty[i]);
+        }
+      });
+    }
+    build_graph();
+  }
+  [[nodiscard]] inline uint32_t node_of(uint32_t cell) const noexcept {
+    const uint32_t c = cluster_of(cell);
+    const auto& nodes = clusters_[c].nodes;
+    const auto it = std::lower_bound(nodes.begin(), nodes.end(), cell);
+    return it != nodes.end() && *it == cell ? cluster_first_[c] + (it - nodes.begin()) : kNone;
+  }
+  void build_graph() {
+    node_cell_.clear();
+    cluster_first_.resize(clusters_.size() + 1);
+    for (uint32_t c = 0; c < clusters_.size(); c++) {
+      cluster_first_[c] = node_cell_.size();
+      node_cell_.insert(node_cell_.end(), clusters_[c].nodes.begin(), clusters_[c].nodes.end());
+    }
+    cluster_first_[clusters_.size()] = node_cell_.size();
+    // two passes straight into the CSR arrays: count the edges of every node, then fill them
+    const size_t nodes = node_cell_.size();
+    edge_begin_.assign(nodes + 2, 0);
+    auto for_each_edge = [&](auto&& func) {
+      for (uint32_t c = 0; c < clusters_.size(); c++) {
+        const Cluster& cluster = clusters_[c];
+        const size_t n = cluster.nodes.size();
+        for (size_t i = 0; i < n; i++) {
+          for (size_t j = 0; j < n; j++) {
+            if (i != j && cluster.dist[i * n + j] < kInf) {
+              func(cluster_first_[c] + i, cluster_first_[c] + j, cluster.dist[i * n + j]);
+            }
+          }
+        }
+      }
+      for (const auto* borders : {&vborders_, &hborders_}) {
+        for (const auto& border : *borders) {
+          for (const auto& e : border) {
+            const uint32_t a = node_of(e.a), b = node_of(e.b);
+            func(a, b, 1.0F);
+            func(b, a, 1.0F);
+          }
+        }
+      }
+    };
+    for_each_edge([&](uint32_t from, uint32_t, float) { edge_begin_[from + 2]++; });
+    for (size_t i = 2; i < edge_begin_.size(); i++) {
+      edge_begin_[i] += edge_begin_[i - 1];
+    }
+    edges_.resize(edge_begin_.back());
+    // edge_begin_[from + 1] is the write cursor and ends up as the begin of the next node
+    for_each_edge([&](uint32_t from, uint32_t to, float cost) {
+      edges_[edge_begin_[from + 1]++] = {to, cost};
+    });
+    edge_begin_.pop_back();
+    ag_.resize(node_cell_.size() + 2);
+    aparent_.resize(node_cell_.size() + 2);
+    astamp_.assign(node_cell_.size() + 2, 0);
+    ageneration_ = 0;
+  }
+
+ public:
+  /**
+   * @param clusterSize width and height of a cluster in cells
+   * @param neighbourhood FOUR or EIGHT connected moves, same rules as GridAStar
+   */
+  explicit GridHPA(uint32_t clusterSize = 32, Neighbourhood neighbourhood = Neighbourhood::EIGHT)
+      : cluster_size_(std::max<uint32_t>(clusterSize, 2)), neighbourhood_(neighbourhood) {}
+  /**
+   * (Re)builds the whole abstract graph - done automatically by the first query on a new field size
+   * @param field the search space
+   * @param blocked cells equal to this value are obstacles
+   * @param threads number of threads for this and all later cluster recomputations
+   */
+  template <typename S, typename B>
+  void build(const FieldView<S>& field, const B& blocked, uint_32_cx threads = 1) {
+    threads_ = threads;
+    width_ = field.width();
+    height_ = field.height();
+    clusters_x_ = (width_ + cluster_size_ - 1) / cluster_size_;
+    clusters_y_ = (height_ + cluster_size_ - 1) / cluster_size_;
+    clusters_.assign(static_cast<size_t>(clusters_x_) * clusters_y_, Cluster{});
+    vborders_.assign(clusters_x_ > 0 ? (clusters_x_ - 1) * clusters_y_ : 0, {});
+    hborders_.assign(clusters_y_ > 0 ? clusters_x_ * (clusters_y_ - 1) : 0, {});
+    vdirty_.assign(vborders_.size(), 1);
+    hdirty_.assign(hborders_.size(), 1);
+    local_ = LocalSearch{};
+    built_ = true;
+    rebuilt_ = 0;
+    update(field, blocked);
+  }
+  /**
+   * Marks a changed cell - the borders and clusters around it are recomputed on the next query
+   */
+  void invalidate(uint32_t x, uint32_t y) {
+    if (!built_ || x >= width_ || y >= height_) {
+      return;
+    }
+    const uint32_t cx = x / cluster_size_, cy = y / cluster_size_, c = cx + cy * clusters_x_;
+    clusters_[c].dirty = true;
+    if (cx > 0) {
+      vdirty_[cx - 1 + cy * (clusters_x_ - 1)] = 1;
+    }
+    if (cx + 1 < clusters_x_) {
+      vdirty_[cx + cy * (clusters_x_ - 1)] = 1;
+    }
+    if (cy > 0) {
+      hdirty_[c - clusters_x_] = 1;
+    }
+    if (cy + 1 < clusters_y_) {
+      hdirty_[c] = 1;
+    }
+  }
+  /**
+   * Finds a near optimal path from start to target
+   * @param field the search space - the one given to build() with all changes passed to invalidate()
+   * @param blocked cells equal to this value are obstacles
+   * @param start the starting cell
+   * @param target the target cell
+   * @param path overwritten with every cell from start to target (both included) - empty if there is none
+   * @return true if a path was found
+   */
+  template <typename S, typename B>
+  bool find_path(const FieldView<S>& field, const B& blocked, const Point& start,
+                 const Point& target, std::vector<Point>& path) {
+    path.clear();
+    cost_ = 0;
+    if (!built_ || field.width() != width_ || field.height() != height_) {
+      build(field, blocked, threads_);
+    } else {
+      update(field, blocked);
+    }
+    if (!passable(field, blocked, start.x(), start.y()) ||
+        !passable(field, blocked, target.x(), target.y())) {
+      return false;
+    }
+    const auto s = static_cast<uint32_t>(start.x()) + static_cast<uint32_t>(start.y()) * width_;
+    const auto t = static_cast<uint32_t>(target.x()) + static_cast<uint32_t>(target.y()) * width_;
+    path.push_back(Point(s % width_, s / width_));
+    const uint32_t sc = cluster_of(s), tc = cluster_of(t);
+    if (sc == tc) {
+      local_search(local_, field, blocked, s, t);
+      if (local_cost(local_, t) < kInf) {
+        cost_ = local_cost(local_, t);
+        local_path(local_, t, path);
+        return true;
+      }
+    }
+    // start and target as temporary nodes connected to the entrances of their cluster
+    const auto n = static_cast<uint32_t>(node_cell_.size());
+    const uint32_t sn = n, tn = n + 1;
+    std::vector<std::pair<uint32_t, float>> from_start, to_target;
+    local_search(local_, field, blocked, s, kNone, clusters_[sc].nodes);
+    for (uint32_t i = cluster_first_[sc]; i < cluster_first_[sc + 1]; i++) {
+      const float cost = local_cost(local_, node_cell_[i]);
+      if (cost < kInf) {
+        from_start.emplace_back(i, cost);
+      }
+    }
+    local_search(local_, field, blocked, t, kNone, clusters_[tc].nodes);
+    std::vector<float> target_dist(cluster_first_[tc + 1] - cluster_first_[tc]);
+    for (uint32_t i = cluster_first_[tc]; i < cluster_first_[tc + 1]; i++) {
+      target_dist[i - cluster_first_[tc]] = local_cost(local_, node_cell_[i]);
+    }
+    if (ageneration_ >= (UINT32_MAX - 1) / 2) {
+      std::fill(astamp_.begin(), astamp_.end(), 0);
+      ageneration_ = 0;
+    }
+    ageneration_++;
+    auto cell_of = [&](uint32_t node) {
+      return node == sn ? s : node == tn ? t : node_cell_[node];
+    };
+    aopen_.clear();
+    aopen_.insert(sn, estimate(s, t));
+    ag_[sn] = 0;
+    aparent_[sn] = kNone;
+    astamp_[sn] = 2 * ageneration_;
+    auto relax = [&](uint32_t from, uint32_t to, float cost) {
+      const float g = ag_[from] + cost;
+      if (astamp_[to] == 2 * ageneration_ + 1 ||
+          (astamp_[to] == 2 * ageneration_ && g >= ag_[to])) {
+        return;
+      }
+      const float f = g + estimate(cell_of(to), t);
+      if (astamp_[to] == 2 * ageneration_) {
+        aopen_.update(to, f);
+      } else {
+        astamp_[to] = 2 * ageneration_;
+        aopen_.insert(to, f);
+      }
+      ag_[to] = g;
+      aparent_[to] = from;
+    };
+    bool found = false;
+    while (!aopen_.empty()) {
+      const uint32_t node = aopen_.top_handle();
+      aopen_.pop();
+      astamp_[node] = 2 * ageneration_ + 1;
+      if (node == tn) {
+        found = true;
+        break;
+      }
+      if (node == sn) {
+        for (const auto& [to, cost] : from_start) {
+          relax(sn, to, cost);
+        }
+        continue;
+      }
+      for (uint32_t e = edge_begin_[node]; e < edge_begin_[node + 1]; e++) {
+        relax(node, edges_[e].first, edges_[e].second);
+      }
+      if (node >= cluster_first_[tc] && node < cluster_first_[tc + 1] &&
+          target_dist[node - cluster_first_[tc]] < kInf) {
+        relax(node, tn, target_dist[node - cluster_first_[tc]]);
+      }
+    }
+    if (!found) {
+      path.clear();
+      return false;
+    }
+    std::vector<uint32_t> waypoints;
+    for (uint32_t node = tn; node != kNone; node = aparent_[node]) {
+      waypoints.push_back(cell_of(node));
+    }
+    std::reverse(waypoints.begin(), waypoints.end());
+    for (size_t i = 1; i < waypoints.size(); i++) {
+      const uint32_t from = waypoints[i - 1], to = waypoints[i];
+      if (cluster_of(from) == cluster_of(to)) {
+        local_search(local_, field, blocked, from, to);
+        local_path(local_, to, path);
+      } else {
+        path.emplace_back(static_cast<float>(to % width_), static_cast<float>(to / width_));
+      }
+    }
+    cost_ = ag_[tn];
+    return true;
+  }
+  /**
+   * @return the cost of the last path found
+   */
+  [[nodiscard]] inline float last_cost() const noexcept { return cost_; }
+  /**
+   * @return the number of entrance nodes in the abstract graph
+   */
+  [[nodiscard]] inline uint32_t node_count() const noexcept { return node_cell_.size(); }
+  /**
+   * @return how many cluster recomputations happened since the last full build()
+   */
+  [[nodiscard]] inline uint32_t rebuilt_clusters() const noexcept { return rebuilt_; }
+};
+
+/**
+ * <h2>FlowField</h2>
+ * Distance map (Dijkstra map) from one target to every cell, for many agents sharing a destination.
+ * <br><br>
+ * After build() every cell knows the direction of its next step towards the target, so each agent
+ * reads its move in O(1) instead of running its own search. Costs are integers, 5 for a straight and
+ * 7 for a diagonal step (diagonals cost 1.4 instead of 1.414), which turns Dijkstra into a bucket queue:
+ * all cells of one distance form a wavefront that is relaxed in parallel.
+ * Neighbourhoods and corner cutting follow the rules of GridAStar.
+ */
+class FlowField {
+  static constexpr uint32_t kStraight = 5;
+  static constexpr uint32_t kDiagonal = 7;
+  static constexpr uint32_t kUnreached = UINT32_MAX;
+  static constexpr uint8_t kNoStep = 8;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t target_ = 0;
+  std::vector<uint32_t> dist_;
+  std::vector<uint8_t> step_;  // index into kGridDirs, kNoStep at the target and unreachable cells
+  std::vector<uint32_t> buckets_[kDiagonal + 1];
+  std::mutex bucket_mutex_;
+
+  template <typename S, typename B>
+  [[nodiscard]] static inline bool passable(const FieldView<S>& field, const B& blocked,
+                                            int64_t x, int64_t y) noexcept {
+    return field.inside(x, y) && !(field(x, y) == blocked);
+  }
+  // relaxes the neighbours of the wavefront cells [begin, end) that are at distance d
+  template <typename S, typename B>
+  void relax(const FieldView<S>& field, const B& blocked, const std::vector<uint32_t>& front,
+             size_t begin, size_t end, uint32_t d, int dirs,
+             std::vector<uint32_t> (&out)[kDiagonal + 1]) {
+    for (size_t i = begin; i < end; i++) {
+      const uint32_t cell = front[i];
+      if (dist_[cell] != d) {
+        continue;  // was lowered after it was queued
+      }
+      const int64_t x = cell % width_, y = cell / width_;
+      for (int k = 0; k < dirs; k++) {
+        const int64_t nx = x + kGridDirs[k][0], ny = y + kGridDirs[k][1];
+        if (!passable(field, blocked, nx, ny) ||
+            (k >= 4 && (!passable(field, blocked, nx, y) || !passable(field, blocked, x, ny)))) {
+          continue;
+        }
+        const auto next = static_cast<uint32_t>(nx + ny * width_);
+        const uint32_t nd = d + (k >= 4 ? kDiagonal : kStraight);
+        std::atomic_ref<uint32_t> slot(dist_[next]);
+        uint32_t old = slot.load(std::memory_order_relaxed);
+        while (nd < old && !slot.compare_exchange_weak(old, nd, std::memory_order_relaxed)) {
+        }
+        if (nd < old) {  // only the thread that lowered the distance queues the cell
+          out[nd % (kDiagonal + 1)].push_back(next);
+        }
+      }
+    }
+  }
+  template <typename S, typename B>
+  void directions(const FieldView<S>& field, const B& blocked, uint32_t begin, uint32_t end,
+                  int dirs) {
+    for (uint32_t y = begin; y < end; y++) {
+      for (uint32_t x = 0; x < width_; x++) {
+        const uint32_t cell = x + y * width_;
+        uint8_t best = kNoStep;
+        uint32_t bestDist = dist_[cell];
+        if (bestDist != kUnreached && cell != target_) {
+          for (int k = 0; k < dirs; k++) {
+            const int64_t nx = x + kGridDirs[k][0], ny = y + kGridDirs[k][1];
+            if (!passable(field, blocked, nx, ny) ||
+                (k >= 4 && (!passable(field, blocked, nx, y) || !passable(field, blocked, x, ny)))) {
+              continue;
+            }
+            const uint32_t nd = dist_[nx + ny * width_];
+            if (nd < bestDist) {
+              bestDist = nd;
+              best = static_cast<uint8_t>(k);
+            }
+          }
+        }
+        step_[cell] = best;
+      }
+    }
+  }
+
+ public:
+  FlowField() = default;
+  FlowField(const FlowField&) = delete;
+  FlowField& operator=(const FlowField&) = delete;
+  /**
+   * Computes the distances to target and the next step of every cell
+   * @param field the search space
+   * @param blocked cells equal to this value are obstacles
+   * @param target the shared destination
+   * @param neighbourhood FOUR or EIGHT connected moves
+   * @param threads number of threads - wavefronts of more than a few thousand cells are split up
+   */
+  template <typename S, typename B>
+  void build(const FieldView<S>& field, const B& blocked, const Point& target,
+             Neighbourhood neighbourhood = Neighbourhood::EIGHT, uint_32_cx threads = 1) {
+    width_ = field.width();
+    height_ = field.height();
+    dist_.assign(static_cast<size_t>(width_) * height_, kUnreached);
+    step_.assign(dist_.size(), kNoStep);
+    for (auto& bucket : buckets_) {
+      bucket.clear();
+    }
+    const auto tx = static_cast<int64_t>(target.x()), ty = static_cast<int64_t>(target.y());
+    if (!passable(field, blocked, tx, ty)) {
+      target_ = kUnreached;
+      return;
+    }
+    target_ = static_cast<uint32_t>(tx + ty * width_);
+    const int dirs = neighbourhood == Neighbourhood::FOUR ? 4 : 8;
+    dist_[target_] = 0;
+    buckets_[0].push_back(target_);
+    std::vector<uint32_t> front;
+    uint32_t empty = 0;
+    for (uint32_t d = 0; empty <= kDiagonal; d++) {
+      std::vector<uint32_t>& bucket = buckets_[d % (kDiagonal + 1)];
+      if (bucket.empty()) {
+        empty++;
+        continue;
+      }
+      empty = 0;
+      front.swap(bucket);
+      bucket.clear();
+      if (threads <= 1 || front.size() < 4096) {
+        relax(field, blocked, front, 0, front.size(), d, dirs, buckets_);
+      } else {
+        ThreadPool::global().parallel_for(
+            0, front.size(),
+            [&](uint_32_cx begin, uint_32_cx end) {
+              std::vector<uint32_t> out[kDiagonal + 1];
+              relax(field, blocked, front, begin, end, d, dirs, out);
+              std::lock_guard<std::mutex> lock(bucket_mutex_);
+              for (uint32_t b = 0; b <= kDiagonal; b++) {
+                buckets_[b].insert(buckets_[b].end(), out[b].begin(), out[b].end());
+              }
+            },
+            1024);
+      }
+      front.clear();
+    }
+    if (threads <= 1) {
+      directions(field, blocked, 0, height_, dirs);
+    } else {
+      ThreadPool::global().parallel_for(0, height_, [&](uint_32_cx begin, uint_32_cx end) {
+        directions(field, blocked, begin, end, dirs);
+      });
+    }
+  }
+  /**
+   * @return true if the target can be reached from (x, y)
+   */
+  [[nodiscard]] inline bool reachable(int64_t x, int64_t y) const noexcept {
+    return x >= 0 && y >= 0 && x < width_ && y < height_ && dist_[x + y * width_] != kUnreached;
+  }
+  /**
+   * @return the path cost from (x, y) to the target, negative if it cant be reached
+   */
+  [[nodiscard]] inline float distance(int64_t x, int64_t y) const noexcept {
+    return reachable(x, y) ? static_cast<float>(dist_[x + y * width_]) / kStraight : -1.0F;
+  }
+  /**
+   * The next cell on the shortest path - O(1)
+   * @return the next cell, or the given cell itself at the target and on unreachable cells
+   */
+  [[nodiscard]] inline Point next_step(const Point& from) const noexcept {
+    const auto x = static_cast<int64_t>(from.x()), y = static_cast<int64_t>(from.y());
+    if (!reachable(x, y) || step_[x + y * width_] == kNoStep) {
+      return from;
+    }
+    const uint8_t k = step_[x + y * width_];
+    return {static_cast<float>(x + kGridDirs[k][0]), static_cast<float>(y + kGridDirs[k][1])};
+  }
+  /**
+   * Follows the steps from start to the target
+   * @param start the starting cell
+   * @param path overwritten with the cells from start to the target (both included) - empty if unreachable
+   * @return true if the target is reachable
+   */
+  bool path(const Point& start, std::vector<Point>& path) const {
+    path.clear();
+    const auto x = static_cast<int64_t>(start.x()), y = static_cast<int64_t>(start.y());
+    if (!reachable(x, y)) {
+      return false;
+    }
+    Point p(x, y);
+    path.push_back(p);
+    for (Point next = next_step(p); !(next == p); next = next_step(p)) {
+      p = next;
+      path.push_back(p);
+    }
+    return true;
+  }
+};
 
-namespace cxstructs {
 /**
  * <h2>A star</h2> is a pathfinding algorithm using clever heuristics to find the shortest path.<p>
  * It generally works by having a field of nodes which is the search space and then giving each node
@@ -91,36 +1210,107 @@ using namespace cxhelper;
 template <typename S, typename B>
 std::vector<Point> astar_pathfinding(const std::vector<std::vector<S>>& field, const B& blocked_val,
                                      const Point& start, const Point& target) {
-  PriorityQueue<Node> frontier;
-  HashSet<Point> closedSet;
-  vec<row<2, int>, false> directions = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-  frontier.emplace(start, 0, start.dist(target), nullptr);
-  while (!frontier.empty()) {
-    Node* current = new Node(frontier.top());
-    frontier.pop();
-
-    if (current->position == target) {
-      return reconstruct_path(current);
+  if (field.empty()) {
+    return {};
+  }
+  // flatten into a passability map, pass a Grid2D or FieldView instead to skip this copy
+  const auto width = static_cast<uint32_t>(field[0].size());
+  const auto height = static_cast<uint32_t>(field.size());
+  std::vector<uint8_t> blocked(static_cast<size_t>(width) * height);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      blocked[y * width + x] = field[y][x] == blocked_val;
     }
+  }
+  thread_local GridAStar engine;
+  std::vector<Point> path;
+  engine.find_path(FieldView<uint8_t>(blocked, width, height), uint8_t{1}, start, target, path);
+  return path;
+}
+/**
+ * astar_pathfinding() on a contiguous field - a Grid2D or any FieldView - without copying it
+ * @param field the 2D search space
+ * @param blocked_val a arbitrary value to represent an obstacle
+ * @param start the starting point
+ * @param target the target point
+ * @return the shortest path from start to target in Points
+ */
+template <typename S, typename B>
+std::vector<Point> astar_pathfinding(const FieldView<S>& field, const B& blocked_val, const Point& start,
+                                     const Point& target) {
+  thread_local GridAStar engine;
+  std::vector<Point> path;
+  engine.find_path(field, blocked_val, start, target, path, Neighbourhood::FOUR);
+  return path;
+}
 
-    closedSet.insert(current->position);
-
-    for (const auto& dir : directions) {
-      int newX = static_cast<int>(current->position.x()) + dir[0];
-      int newY = static_cast<int>(current->position.y()) + dir[1];
-      Point new_pos(newX, newY);
-      if (newX >= 0 && newY < field.size() && newY >= 0 && newX < field[0].size() &&
-          field[newY][newX] != blocked_val && !closedSet.contains(new_pos)) {
-
-        uint16_t tentative_g_cost = current->g_cost + 1;
-        uint16_t h_cost =
-            abs(newX - static_cast<int>(target.x())) + abs(newY - static_cast<int>(target.y()));
+/**
+ * A single request for batch_pathfinding()
+ */
+struct PathRequest {
+  Point start;
+  Point target;
+};
 
-        frontier.emplace(new_pos, tentative_g_cost, h_cost, current);
+/**
+ * Solves many path requests at once, grouped by their target.<p>
+ * Targets shared by at least groupSize requests get one FlowField that all of them walk down,
+ * other requests run GridAStar. The A* requests are spread over the ThreadPool, each chunk with its own engine.
+ * @param field the search space
+ * @param blocked cells equal to this value are obstacles
+ * @param requests the start and target of every request
+ * @param paths resized to requests.size(), path i belongs to request i - empty if there is none
+ * @param neighbourhood FOUR or EIGHT connected moves
+ * @param threads number of threads
+ * @param groupSize minimum number of requests with the same target to build a flow field
+ */
+template <typename S, typename B>
+void batch_pathfinding(const FieldView<S>& field, const B& blocked,
+                       std::span<const PathRequest> requests, std::vector<std::vector<Point>>& paths,
+                       Neighbourhood neighbourhood = Neighbourhood::EIGHT, uint_32_cx threads = 1,
+                       uint32_t groupSize = 4) {
+  paths.resize(requests.size());
+  auto cell = [&](const Point& p) {
+    return static_cast<uint64_t>(p.x()) + static_cast<uint64_t>(p.y()) * field.width();
+  };
+  std::vector<uint32_t> order(requests.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return cell(requests[a].target) < cell(requests[b].target);
+  });
+  std::vector<uint32_t> single;
+  FlowField flow;
+  for (size_t begin = 0; begin < order.size();) {
+    size_t end = begin + 1;
+    const uint64_t target = cell(requests[order[begin]].target);
+    while (end < order.size() && cell(requests[order[end]].target) == target) {
+      end++;
+    }
+    if (end - begin < groupSize) {
+      single.insert(single.end(), order.begin() + begin, order.begin() + end);
+    } else {
+      flow.build(field, blocked, requests[order[begin]].target, neighbourhood, threads);
+      for (size_t i = begin; i < end; i++) {
+        flow.path(requests[order[i]].start, paths[order[i]]);
       }
     }
+    begin = end;
+  }
+  auto solve = [&](uint_32_cx begin, uint_32_cx end) {
+    GridAStar engine;
+    for (uint_32_cx i = begin; i < end; i++) {
+      const PathRequest& request = requests[single[i]];
+      engine.find_path(field, blocked, request.start, request.target, paths[single[i]],
+                       neighbourhood);
+    }
+  };
+  if (threads <= 1) {
+    solve(0, single.size());
+  } else {
+    ThreadPool::global().parallel_for(0, single.size(), solve);
   }
-  return {};
 }
 
 }  // namespace cxstructs
@@ -22,29 +22,68 @@
 #define CXSTRUCTS_SRC_ALGORITHMS_PATTERNMATCHING_H_
 
 #include <algorithm>
+#include <bit>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <iostream>
+#include <random>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "../cxconfig.h"
 #include "../cxutil/cxio.h"
 
 namespace cxhelper {
 
-inline bool is_prefix(const std::string& pattern, int pos) {
-  for (int i = 0; i < pattern.size() - pos; ++i) {
-    if (pattern[i] != pattern[i + pos]) {
-      return false;
+// first index >= from where pattern (size >= 2) starts in text - the first and last byte of the pattern are compared
+// against 32 (AVX2) or 16 (SSE2) positions at once, only positions where both match are compared fully
+inline size_t first_last_filter_find(std::string_view text, std::string_view pattern, size_t from) noexcept {
+  const size_t n = text.size();
+  const size_t m = pattern.size();
+  const char* s = text.data();
+  const char* p = pattern.data();
+  size_t i = from;
+#if defined(CX_AVX2)
+  const __m256i first = _mm256_set1_epi8(p[0]);
+  const __m256i last = _mm256_set1_epi8(p[m - 1]);
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + m - 1));
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+    while (mask != 0) {
+      const size_t candidate = i + std::countr_zero(mask);
+      if (std::memcmp(s + candidate + 1, p + 1, m - 2) == 0) {
+        return candidate;
+      }
+      mask &= mask - 1;
     }
   }
-  return true;
-}
-inline int suffix_length(const std::string& pattern, int pos) {
-  int len = 0;
-  while (pos >= 0 && pattern[pos] == pattern[pattern.size() - 1 - len]) {
-    pos--;
-    len++;
+#elif defined(CX_SSE2)
+  const __m128i first = _mm_set1_epi8(p[0]);
+  const __m128i last = _mm_set1_epi8(p[m - 1]);
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + m - 1));
+    auto mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+    while (mask != 0) {
+      const size_t candidate = i + std::countr_zero(mask);
+      if (std::memcmp(s + candidate + 1, p + 1, m - 2) == 0) {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i + m <= n; i++) {
+    if (s[i] == p[0] && s[i + m - 1] == p[m - 1] && std::memcmp(s + i + 1, p + 1, m - 2) == 0) {
+      return i;
+    }
   }
-  return len;
+  return std::string_view::npos;
 }
-
 }  // namespace cxhelper
 
 namespace cxstructs {
@@ -88,102 +127,358 @@ inline int findString_brute_force(const std::string& text, const std::string& pa
   }
   return count > 0 ? count : -1;  // return -1 on not found
 }
-inline int findString_KMP(const std::string& text, const std::string& pattern) {
-  if (text.empty() || pattern.empty()) {
-    return -1;  // return -1 on empty input
-  }
+/**
+ * <h2>KMPPattern</h2>
+ * A pattern compiled for the Knuth-Morris-Pratt search. The prefix table is built once in the constructor and
+ * reused by every search, so searching many texts for the same pattern only pays O(text) each.
+ * <br><br>
+ * The text is read strictly front to back one byte at a time - good for streams and adversarial input.
+ * The searches take string_views, so mmapped files can be searched without copying.
+ */
+class KMPPattern {
+  std::string pattern_;
+  std::vector<uint32_t> lps_;  // length of the longest proper prefix that is also a suffix of pattern_[0..i]
 
-  int count = 0;
-  uint_16_cx len = pattern.size();
-  uint_32_cx text_len = text.size();
-  auto* lps = new uint8_t[len];  //lps array
-
-  lps[0] = 0;
-  int index = 1;
-  int longestPrefix = 0;
-
-  //create the lps array
-  while (index < len) {
-    if (pattern[index] == pattern[longestPrefix]) {
-      longestPrefix++;
-      lps[index] = longestPrefix;
-      index++;
-    } else {
-      if (longestPrefix != 0) {
-        longestPrefix = lps[longestPrefix - 1];
-      } else {
-        lps[index] = 0;
-        index++;
+ public:
+  explicit KMPPattern(std::string_view pattern) : pattern_(pattern), lps_(pattern.size(), 0) {
+    uint32_t prefix = 0;
+    for (size_t i = 1; i < pattern_.size(); i++) {
+      while (prefix > 0 && pattern_[i] != pattern_[prefix]) {
+        prefix = lps_[prefix - 1];
+      }
+      if (pattern_[i] == pattern_[prefix]) {
+        prefix++;
       }
+      lps_[i] = prefix;
     }
   }
-
-  //search operation
-  for (uint_32_cx i = 0; i < text_len; i++) {
-    for (uint_32_cx j = 0; j < len; j++) {
-      if (text[i + j] == pattern[j]) {  //compare from i+j onwards
-        if (j == len - 1) {
-          count++;
-        }
-      } else {
-        i += lps[j];  //skip lps[j] amount
-        break;
+  /**
+   * @param text the text to search
+   * @param from first index to consider
+   * @return the index of the first occurrence at or after from - std::string_view::npos if there is none
+   */
+  [[nodiscard]] size_t find(std::string_view text, size_t from = 0) const noexcept {
+    const size_t m = pattern_.size();
+    if (m == 0) {
+      return from <= text.size() ? from : std::string_view::npos;
+    }
+    uint32_t j = 0;
+    for (size_t i = from; i < text.size(); i++) {
+      while (j > 0 && text[i] != pattern_[j]) {
+        j = lps_[j - 1];
+      }
+      if (text[i] == pattern_[j] && ++j == m) {
+        return i + 1 - m;
       }
     }
+    return std::string_view::npos;
   }
-  delete[] lps;                   //cleanup to prevent memory leaks
-  return count > 0 ? count : -1;  // return -1 on not found
-}
-inline int findString_Boyer_Moore(const std::string& text, const std::string& pattern) {
-  if (text.empty() || pattern.empty()) {
-    return -1;  // return -1 on empty input
+  /**
+   * @param text the text to search
+   * @return the number of (possibly overlapping) occurrences
+   */
+  [[nodiscard]] size_t count(std::string_view text) const noexcept {
+    const size_t m = pattern_.size();
+    if (m == 0) {
+      return 0;
+    }
+    size_t count = 0;
+    uint32_t j = 0;
+    for (char c : text) {
+      while (j > 0 && c != pattern_[j]) {
+        j = lps_[j - 1];
+      }
+      if (c == pattern_[j] && ++j == m) {
+        count++;
+        j = lps_[j - 1];
+      }
+    }
+    return count;
   }
+  [[nodiscard]] std::string_view pattern() const noexcept { return pattern_; }
+};
 
-  int count = 0;
-  uint_16_cx len = pattern.size();
-  uint_32_cx text_len = text.size();
+/**
+ * <h2>BoyerMoorePattern</h2>
+ * A pattern compiled for the Boyer-Moore search with the bad character (all 256 bytes) and the strong good suffix
+ * rule. Both tables are built once in the constructor.
+ * <br><br>
+ * Compares from the end of the pattern and skips up to its length per mismatch, so long patterns touch only a
+ * fraction of the text.
+ */
+class BoyerMoorePattern {
+  std::string pattern_;
+  int last_[256];                // last index of each byte in the pattern, -1 if it doesnt occur
+  std::vector<uint32_t> shift_;  // good suffix shift when pattern[j] mismatches, shift_[0] after a full match
 
-  int bad_char[128];                         //stack array due to fixed size
-  std::fill(bad_char, bad_char + 128, len);  //fill array with default values
+ public:
+  explicit BoyerMoorePattern(std::string_view pattern) : pattern_(pattern), shift_(pattern.size() + 1, 0) {
+    std::fill(last_, last_ + 256, -1);
+    const int m = static_cast<int>(pattern_.size());
+    for (int i = 0; i < m; i++) {
+      last_[static_cast<uint8_t>(pattern_[i])] = i;
+    }
+    // border[i] is the start of the widest border of pattern[i..m)
+    std::vector<int> border(m + 1);
+    int i = m, j = m + 1;
+    border[i] = j;
+    while (i > 0) {
+      while (j <= m && pattern_[i - 1] != pattern_[j - 1]) {
+        if (shift_[j] == 0) {
+          shift_[j] = j - i;
+        }
+        j = border[j];
+      }
+      border[--i] = --j;
+    }
+    j = border[0];
+    for (i = 0; i <= m; i++) {
+      if (shift_[i] == 0) {
+        shift_[i] = j;
+      }
+      if (i == j) {
+        j = border[j];
+      }
+    }
+  }
+  /**
+   * @param text the text to search
+   * @param from first index to consider
+   * @return the index of the first occurrence at or after from - std::string_view::npos if there is none
+   */
+  [[nodiscard]] size_t find(std::string_view text, size_t from = 0) const noexcept {
+    const size_t m = pattern_.size();
+    if (m == 0) {
+      return from <= text.size() ? from : std::string_view::npos;
+    }
+    for (size_t pos = from; pos + m <= text.size();) {
+      int j = static_cast<int>(m) - 1;
+      while (j >= 0 && pattern_[j] == text[pos + j]) {
+        j--;
+      }
+      if (j < 0) {
+        return pos;
+      }
+      pos += std::max<int>(shift_[j + 1], j - last_[static_cast<uint8_t>(text[pos + j])]);
+    }
+    return std::string_view::npos;
+  }
+  /**
+   * @param text the text to search
+   * @return the number of (possibly overlapping) occurrences
+   */
+  [[nodiscard]] size_t count(std::string_view text) const noexcept {
+    if (pattern_.empty()) {
+      return 0;
+    }
+    size_t count = 0;
+    // shift_[0] is the period of the pattern - the next possible overlapping occurrence
+    for (size_t pos = find(text); pos != std::string_view::npos; pos = find(text, pos + shift_[0])) {
+      count++;
+    }
+    return count;
+  }
+  [[nodiscard]] std::string_view pattern() const noexcept { return pattern_; }
+};
 
-  //produce bad character table
-  for (uint_32_cx i = 0; i < len; i++) {
-    bad_char[static_cast<uint8_t>(pattern[i]) & 0x7F] =
-        len - 1 -
-        i;  //cast number to 0-256 and bitwise and with 01111111 to zero the first bit / from my Trie implementation
+#if defined(CX_KERNEL_DECL)
+size_t simd_find(std::string_view text, std::string_view pattern, size_t from = 0) noexcept;
+size_t simd_count(std::string_view text, std::string_view pattern) noexcept;
+#else
+/**
+ * Finds pattern in text with a SIMD first/last byte filter: 32 (AVX2) or 16 (SSE2) start positions are checked
+ * at once for the first and the last byte of the pattern, only where both match the middle is compared.<p>
+ * On real text almost no position passes the filter, so this runs at memory speed for any pattern length.
+ * Single byte patterns use memchr.
+ * @param text the text to search
+ * @param pattern the pattern to find
+ * @param from first index to consider
+ * @return the index of the first occurrence at or after from - std::string_view::npos if there is none
+ */
+CX_KERNEL size_t simd_find(std::string_view text, std::string_view pattern, size_t from = 0) noexcept {
+  const size_t m = pattern.size();
+  if (m == 0) {
+    return from <= text.size() ? from : std::string_view::npos;
+  }
+  if (text.size() < m || from > text.size() - m) {
+    return std::string_view::npos;
+  }
+  if (m == 1) {
+    const void* hit = std::memchr(text.data() + from, pattern[0], text.size() - from);
+    return hit ? static_cast<const char*>(hit) - text.data() : std::string_view::npos;
   }
+  return first_last_filter_find(text, pattern, from);
+}
+/**
+ * @param text the text to search
+ * @param pattern the pattern to find
+ * @return the number of (possibly overlapping) occurrences of pattern - see simd_find()
+ */
+CX_KERNEL size_t simd_count(std::string_view text, std::string_view pattern) noexcept {
+  if (pattern.empty()) {
+    return 0;
+  }
+  size_t count = 0;
+  for (size_t pos = simd_find(text, pattern); pos != std::string_view::npos; pos = simd_find(text, pattern, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+#endif
 
-  auto* good_suffix = new int[len];  //dynamic array
-  std::fill(good_suffix, good_suffix + len,
-            len);  //fill array with default values
+/**
+ * <h2>AhoCorasick</h2>
+ * Finds any number of patterns in a single pass over the text.
+ * <br><br>
+ * The patterns are compiled into a trie whose missing edges are filled in from the failure links, which makes it a
+ * deterministic automaton: every text byte costs one table lookup, independent of the number of patterns.
+ * The bytes are first mapped to equivalence classes (one per byte that occurs in a pattern, one for all others), so
+ * a state only has as many transitions as there are distinct pattern bytes.
+ * <br><br>
+ * <pre>
+ * AhoCorasick ac({"ERROR", "WARN", "timeout"});
+ * ac.match(log, [](uint32_t pattern, size_t pos) { ... });
+ * </pre>
+ */
+class AhoCorasick {
+  static constexpr uint32_t kNone = UINT32_MAX;
+  uint8_t classes_[256]{};        // byte -> class, 0 for bytes no pattern contains
+  uint32_t class_count_ = 1;
+  std::vector<uint32_t> delta_;   // state * class_count_ + class -> next state
+  std::vector<uint32_t> output_;  // the pattern that ends in a state, kNone if none
+  std::vector<uint32_t> dict_;    // next state on the failure chain that has an output, 0 if none
+  std::vector<uint32_t> same_;    // the next pattern with the same string, kNone if none
+  std::vector<uint32_t> lengths_;
 
-  //calculation of the good suffix shift table
-  int last_prefix_pos = len;
-  for (int i = len; i > 0; --i) {
-    if (is_prefix(pattern, i)) {
-      last_prefix_pos = i;
+  void build(const std::vector<std::string_view>& patterns) {
+    for (const auto& pattern : patterns) {
+      CX_ASSERT(!pattern.empty(), "empty patterns are not allowed");
+      for (char c : pattern) {
+        const auto byte = static_cast<uint8_t>(c);
+        if (classes_[byte] == 0) {
+          classes_[byte] = class_count_++;
+        }
+      }
+    }
+    // trie - 0 marks a missing child as no edge leads back to the root
+    delta_.assign(class_count_, 0);
+    output_.assign(1, kNone);
+    same_.assign(patterns.size(), kNone);
+    for (uint32_t id = 0; id < patterns.size(); id++) {
+      uint32_t state = 0;
+      for (char c : patterns[id]) {
+        uint32_t& next = delta_[state * class_count_ + classes_[static_cast<uint8_t>(c)]];
+        if (next == 0) {
+          next = static_cast<uint32_t>(output_.size());
+          output_.push_back(kNone);
+          delta_.resize(delta_.size() + class_count_, 0);
+        }
+        state = delta_[state * class_count_ + classes_[static_cast<uint8_t>(c)]];
+      }
+      same_[id] = output_[state];
+      output_[state] = id;
+      lengths_.push_back(static_cast<uint32_t>(patterns[id].size()));
+    }
+    // breadth first: a state's failure target is shallower and complete when the state is reached
+    std::vector<uint32_t> fail(output_.size(), 0);
+    dict_.assign(output_.size(), 0);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < class_count_; c++) {
+      if (delta_[c] != 0) {
+        queue.push_back(delta_[c]);
+      }
+    }
+    while (!queue.empty()) {
+      const uint32_t state = queue.front();
+      queue.pop_front();
+      const uint32_t f = fail[state];
+      dict_[state] = output_[f] != kNone ? f : dict_[f];
+      for (uint32_t c = 0; c < class_count_; c++) {
+        uint32_t& next = delta_[state * class_count_ + c];
+        if (next != 0) {
+          fail[next] = delta_[f * class_count_ + c];
+          queue.push_back(next);
+        } else {
+          next = delta_[f * class_count_ + c];
+        }
+      }
     }
-    good_suffix[pattern.size() - i] = last_prefix_pos - i + pattern.size();
   }
 
-  for (int i = 0; i < pattern.size() - 1; ++i) {
-    int suffix_len = suffix_length(pattern, i);
-    good_suffix[suffix_len] = pattern.size() - 1 - i + suffix_len;
+ public:
+  /**
+   * @param patterns the patterns - a pattern's id is its index, duplicates are reported with each id
+   */
+  AhoCorasick(std::initializer_list<std::string_view> patterns) { build(std::vector<std::string_view>(patterns)); }
+  /**
+   * @param patterns any range of strings or string_views
+   */
+  template <typename Range>
+  explicit AhoCorasick(const Range& patterns) {
+    std::vector<std::string_view> views;
+    for (const auto& pattern : patterns) {
+      views.emplace_back(pattern);
+    }
+    build(views);
   }
-
-  len--;  //precalculate outside the loop
-  uint_32_cx i = 0, j = 0;
-  while (i < text_len) {
-    for (j = len; pattern[j] == text[i]; --i, --j) {
-      if (j == 0) {
-        count++;
-        break;
+  /**
+   * Calls callback(pattern_id, position) for every occurrence of every pattern, ordered by their end in the text.
+   * Overlapping occurrences are all reported.
+   * @param text the text to search
+   * @param callback callable taking (uint32_t, size_t)
+   */
+  template <typename Callback>
+  void match(std::string_view text, Callback callback) const {
+    uint32_t state = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+      state = delta_[state * class_count_ + classes_[static_cast<uint8_t>(text[i])]];
+      for (uint32_t s = output_[state] != kNone ? state : dict_[state]; s != 0; s = dict_[s]) {
+        for (uint32_t id = output_[s]; id != kNone; id = same_[id]) {
+          callback(id, i + 1 - lengths_[id]);
+        }
       }
     }
-    i += std::max(good_suffix[len - j], bad_char[static_cast<uint8_t>(text[i]) & 0x7F]);
   }
-  delete[] good_suffix;           //clean up memory
-  return count > 0 ? count : -1;  // return -1 on not found
+  /**
+   * @param text the text to search
+   * @return the number of occurrences of all patterns
+   */
+  [[nodiscard]] size_t count(std::string_view text) const {
+    size_t count = 0;
+    match(text, [&count](uint32_t, size_t) { count++; });
+    return count;
+  }
+  /**
+   * @param text the text to search
+   * @return true if any pattern occurs in text - stops at the first match
+   */
+  [[nodiscard]] bool contains_any(std::string_view text) const noexcept {
+    uint32_t state = 0;
+    for (char c : text) {
+      state = delta_[state * class_count_ + classes_[static_cast<uint8_t>(c)]];
+      if (output_[state] != kNone || dict_[state] != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  [[nodiscard]] uint32_t pattern_count() const noexcept { return lengths_.size(); }
+  [[nodiscard]] uint32_t state_count() const noexcept { return output_.size(); }
+};
+
+inline int findString_KMP(const std::string& text, const std::string& pattern) {
+  if (text.empty() || pattern.empty()) {
+    return -1;  // return -1 on empty input
+  }
+  const size_t count = KMPPattern(pattern).count(text);
+  return count > 0 ? static_cast<int>(count) : -1;  // return -1 on not found
+}
+inline int findString_Boyer_Moore(const std::string& text, const std::string& pattern) {
+  if (text.empty() || pattern.empty()) {
+    return -1;  // return -1 on empty input
+  }
+  const size_t count = BoyerMoorePattern(pattern).count(text);
+  return count > 0 ? static_cast<int>(count) : -1;  // return -1 on not found
 }
 }  // namespace cxstructs
 
@@ -21,8 +21,13 @@
 #ifndef CXSTRUCTS_BINARYSEARCH_H
 #define CXSTRUCTS_BINARYSEARCH_H
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
 #include "../cxconfig.h"
 
 namespace cxhelper {  // helper methods to provide clean calling interface
@@ -41,6 +46,8 @@ bool binarySearch_recursive_internal(T* arr, T target, int_32_cx low, int_32_cx
     return binarySearch_recursive_internal(arr, target, low, mid - 1);
   }
 }
+// number of queries search_many() walks down the array at the same time - enough to overlap the cache misses
+constexpr uint_32_cx kSearchInterleave = 8;
 }  // namespace cxhelper
 
 namespace cxstructs {
@@ -121,5 +128,182 @@ int binary_search_index(T* arr, T target, int_32_cx len, bool ascending) {
   }
 }
 
+/**
+ * Branchless lower bound on the specified ASCENDED SORTED array<p>
+ * The range is halved with a conditional move instead of a branch, so the loop runs exactly log2(n) times
+ * without mispredictions. Both possible next midpoints are prefetched a step ahead.<p>
+ * runtime: O(log(n))
+ * @tparam T the used datatype
+ * @param arr search array
+ * @param len the length of the given array
+ * @param target target value to search for
+ * @return index of the first element not less than target - len if there is none
+ */
+template <typename T>
+uint_32_cx lower_bound_branchless(const T* arr, uint_32_cx len, const T& target) {
+  if (len == 0) {
+    return 0;
+  }
+  const T* base = arr;
+  uint_32_cx n = len;
+  while (n > 1) {
+    const uint_32_cx half = n / 2;
+    CX_PREFETCH(base + (n - half) / 2);
+    CX_PREFETCH(base + half + (n - half) / 2);
+    base = base[half] < target ? base + half : base;
+    n -= half;
+  }
+  return static_cast<uint_32_cx>(base - arr) + (*base < target);
+}
+/**
+ * lower_bound_branchless() for many queries at once - writes the index for queries[i] to out[i].<p>
+ * Groups of 8 queries descend the array together: every step issues 8 independent loads,
+ * so their cache misses overlap instead of waiting on each other.
+ * @tparam T the used datatype
+ * @param arr search array - ascending sorted
+ * @param len the length of the given array
+ * @param queries the values to search for
+ * @param count number of queries
+ * @param out buffer with at least count elements
+ */
+template <typename T>
+void search_many(const T* arr, uint_32_cx len, const T* queries, uint_32_cx count, uint_32_cx* out) {
+  using cxhelper::kSearchInterleave;
+  uint_32_cx q = 0;
+  if (len > 0) {
+    for (; q + kSearchInterleave <= count; q += kSearchInterleave) {
+      const T* base[kSearchInterleave];
+      for (uint_32_cx j = 0; j < kSearchInterleave; j++) {
+        base[j] = arr;
+      }
+      // n only depends on len, so all queries of the group take the same number of steps
+      uint_32_cx n = len;
+      while (n > 1) {
+        const uint_32_cx half = n / 2;
+        for (uint_32_cx j = 0; j < kSearchInterleave; j++) {
+          CX_PREFETCH(base[j] + half + (n - half) / 2);
+          base[j] = base[j][half] < queries[q + j] ? base[j] + half : base[j];
+        }
+        n -= half;
+      }
+      for (uint_32_cx j = 0; j < kSearchInterleave; j++) {
+        out[q + j] = static_cast<uint_32_cx>(base[j] - arr) + (*base[j] < queries[q + j]);
+      }
+    }
+  }
+  for (; q < count; q++) {
+    out[q] = lower_bound_branchless(arr, len, queries[q]);
+  }
+}
+
+/**
+ * <h2>EytzingerTable</h2>
+ * A sorted array stored in breadth first order of a complete binary search tree (Eytzinger layout):
+ * the children of index k are 2k and 2k+1.
+ * <br><br>
+ * A lower bound walks k -> 2k or 2k+1 without branches. The first levels of the tree are shared by all
+ * searches and stay in cache, and the 16 (for 4 byte types) descendants four levels below k sit in one cache line,
+ * so they can be prefetched long before they are needed. For read-mostly tables this beats a binary search on the
+ * sorted array once it no longer fits into L2.
+ * <br><br>
+ * Searches return positions in the original sorted array.
+ * @tparam T the value type - needs operator<
+ */
+template <typename T>
+class EytzingerTable {
+  // values per cache line - prefetching b + k * kLine fetches the descendants four levels below k for 4 byte types
+  static constexpr uint_32_cx kLine = std::max<uint_32_cx>(1, 64 / sizeof(T));
+  struct AlignedDelete {
+    void operator()(T* ptr) const noexcept { ::operator delete[](ptr, std::align_val_t(64)); }
+  };
+  std::unique_ptr<T[], AlignedDelete> values_;  // 1-indexed, values_[0] is unused
+  std::unique_ptr<uint_32_cx[]> ranks_;        // position of values_[k] in the sorted array
+  uint_32_cx size_ = 0;
+
+  uint_32_cx build(const T* sorted, uint_32_cx i, uint_32_cx k) {
+    if (k <= size_) {
+      i = build(sorted, i, 2 * k);
+      values_[k] = sorted[i];
+      ranks_[k] = i++;
+      i = build(sorted, i, 2 * k + 1);
+    }
+    return i;
+  }
+  // the eytzinger index of the lower bound - 0 if every value is smaller
+  [[nodiscard]] inline uint_32_cx descend(const T& target) const noexcept {
+    uint_32_cx k = 1;
+    while (k <= size_) {
+      CX_PREFETCH(values_.get() + std::min<uint_32_cx>(k * kLine, size_));
+      k = 2 * k + (values_[k] < target);
+    }
+    // the path went right after the answer every time - undo those steps and the last left one
+    return k >> (std::countr_one(k) + 1);
+  }
+
+ public:
+  EytzingerTable() = default;
+  /**
+   * @param sorted ascending sorted values
+   * @param len number of values
+   */
+  EytzingerTable(const T* sorted, uint_32_cx len)
+      : values_(static_cast<T*>(::operator new[]((len + 1) * sizeof(T), std::align_val_t(64)))),
+        ranks_(new uint_32_cx[len + 1]),
+        size_(len) {
+    static_assert(std::is_trivially_copyable_v<T>, "EytzingerTable values have to be trivially copyable");
+    build(sorted, 0, 1);
+  }
+  /**
+   * @param target value to search for
+   * @return index in the sorted array of the first value not less than target - size() if there is none
+   */
+  [[nodiscard]] inline uint_32_cx lower_bound(const T& target) const noexcept {
+    const uint_32_cx k = descend(target);
+    return k == 0 ? size_ : ranks_[k];
+  }
+  /**
+   * @return true if target is in the table
+   */
+  [[nodiscard]] inline bool contains(const T& target) const noexcept {
+    const uint_32_cx k = descend(target);
+    return k != 0 && !(target < values_[k]);
+  }
+  /**
+   * lower_bound() for many queries at once, interleaved like cxstructs::search_many()
+   * @param queries the values to search for
+   * @param count number of queries
+   * @param out buffer with at least count elements
+   */
+  void search_many(const T* queries, uint_32_cx count, uint_32_cx* out) const noexcept {
+    using cxhelper::kSearchInterleave;
+    uint_32_cx q = 0;
+    for (; q + kSearchInterleave <= count; q += kSearchInterleave) {
+      uint_32_cx k[kSearchInterleave];
+      for (uint_32_cx j = 0; j < kSearchInterleave; j++) {
+        k[j] = 1;
+      }
+      // the first levels are complete, every path goes through them - the rest is finished one by one
+      const uint_32_cx full_levels = std::bit_width(size_ + 1) - 1;
+      for (uint_32_cx level = 0; level < full_levels; level++) {
+        for (uint_32_cx j = 0; j < kSearchInterleave; j++) {
+          CX_PREFETCH(values_.get() + std::min<uint_32_cx>(k[j] * kLine, size_));
+          k[j] = 2 * k[j] + (values_[k[j]] < queries[q + j]);
+        }
+      }
+      for (uint_32_cx j = 0; j < kSearchInterleave; j++) {
+        while (k[j] <= size_) {
+          k[j] = 2 * k[j] + (values_[k[j]] < queries[q + j]);
+        }
+        const uint_32_cx e = k[j] >> (std::countr_one(k[j]) + 1);
+        out[q + j] = e == 0 ? size_ : ranks_[e];
+      }
+    }
+    for (; q < count; q++) {
+      out[q] = lower_bound(queries[q]);
+    }
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+};
+
 }  // namespace cxstructs
 #endif  // CXSTRUCTS_BINARYSEARCH_H
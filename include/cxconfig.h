@@ -27,8 +27,10 @@
  */
 
 //#define CX_USE_INT            : uses type int for all custom types
-//
-//
+//#define CX_NO_SIMD            : disables all SIMD code paths (scalar fallbacks only)
+//#define CX_NO_PROFILE         : compiles CX_PROFILE_SCOPE() zones out entirely
+//#define CX_FORCE_ISA CX_ISA_* : caps the runtime dispatched kernels at the given instruction set
+//#define CX_KERNELS            : heavy kernels are only declared - link the compiled cxstructs_kernels library
 //
 
 /**
@@ -57,6 +59,89 @@ typedef int uint_16_cx;
 typedef int int_32_cx;
 #endif
 
+/* |-----------------------------------------------------|
+ * |                      SIMD                           |
+ * |-----------------------------------------------------|
+ */
+#ifndef CX_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CX_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define CX_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__FMA__) && defined(CX_AVX2)
+#define CX_FMA
+#endif
+#if defined(__F16C__) && defined(CX_AVX2)
+#define CX_F16C
+#endif
+#if defined(__AVX512F__) && defined(CX_FMA)
+#define CX_AVX512
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define CX_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+/* |-----------------------------------------------------|
+ * |                 RUNTIME DISPATCH                    |
+ * |-----------------------------------------------------|
+ */
+// instruction set levels for cxhelper::cpu_isa() and CX_FORCE_ISA
+#define CX_ISA_SCALAR 0
+#define CX_ISA_SSE2 1
+#define CX_ISA_AVX2 2
+#define CX_ISA_AVX512 3
+#define CX_ISA_NEON 4
+
+// on x86 the hot kernels are also compiled for instruction sets above the build target
+// and picked at runtime - CX_TARGET_* is empty when the build target already includes it
+#if defined(CX_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define CX_X86_DISPATCH
+#include <immintrin.h>
+#if defined(CX_FMA) || defined(_MSC_VER)
+#define CX_TARGET_AVX2
+#else
+#define CX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#if defined(CX_AVX512) || defined(_MSC_VER)
+#define CX_TARGET_AVX512
+#else
+#define CX_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+#endif
+
+// hints the cpu to fetch the cache line of the given address
+#if defined(__GNUC__) || defined(__clang__)
+#define CX_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(CX_SSE2)
+#define CX_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#else
+#define CX_PREFETCH(addr) ((void)0)
+#endif
+
+/* |-----------------------------------------------------|
+ * |                 COMPILED KERNELS                    |
+ * |-----------------------------------------------------|
+ */
+// With CX_KERNELS (set by linking the cxstructs_kernels target) the GEMM, sort, radix, distance and
+// pattern matching kernels are compiled once into the library - kernels/cxstructs_kernels.cpp defines
+// CX_KERNELS_IMPL, every other translation unit only sees declarations and extern templates
+#if defined(CX_KERNELS) && !defined(CX_KERNELS_IMPL)
+#define CX_KERNEL_DECL
+#endif
+// linkage of the out-of-line kernels - inline in header only builds
+#if defined(CX_KERNELS_IMPL)
+#define CX_KERNEL
+#else
+#define CX_KERNEL inline
+#endif
+
+#include "cxutil/cxcpu.h"
 #include "CXAllocator.h"
 
 
@@ -23,12 +23,20 @@
 
 #include <algorithm>
 #include <cmath>
-
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <numeric>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include "../cxconfig.h"
 #include "../cxutil/cxmath.h"
+#include "../cxstructs/qmat.h"
+#include "../cxutil/cxio.h"
+#include "../cxutil/cxthreadpool.h"
 
 #ifndef CX_LOOP_FNN
 
@@ -36,15 +44,25 @@
 
 namespace cxhelper {
 using namespace cxstructs;
+// per thread state of one layer - every thread training in parallel has its own set
+struct LayerBuffers {
+  mat_view inputs_;  // input of the last forward pass - a view, no copy
+  mat w_sums_;
+  mat activations_;
+  mat d_weights_;
+  mat d_bias_;
+  mat n_error_;
+};
+struct Workspace {
+  std::vector<LayerBuffers> layers_;
+  mat loss_;
+};
 struct Layer {
   mat weights_;
   mat bias_;
-  mat w_sums_;
-  mat inputs_;
 
   uint_16_cx in_;
   uint_16_cx out_;
-  float learnR_;
 
   func a_func;
   func d_func;
@@ -53,143 +71,643 @@ struct Layer {
   Layer()
       : weights_(),
         bias_(),
-        w_sums_(),
         in_(0),
         out_(0),
         a_func(cxstructs::relu),
-        d_func(cxstructs::d_relu),
-        learnR_(0.5) {}
-  Layer(uint_16_cx in, uint_16_cx out, func a_func, float learnR)
-      : in_(in), out_(out), learnR_(learnR), inputs_(1, in), a_func(a_func) {
-    if (a_func == cxstructs::relu) {
-      d_func = cxstructs::d_relu;
-    } else if (a_func == cxstructs::sig) {
-      d_func = cxstructs::d_sig;
-    } else {
-      d_func = [](float x) {
-        return static_cast<float>(1.0);
-      };
-    }
+        d_func(cxstructs::d_relu) {}
+  Layer(uint_16_cx in, uint_16_cx out, func a_func) : in_(in), out_(out) {
+    set_activation(a_func);
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_real_distribution<> dis(-0.3, 0.3);
 
     weights_ = mat(in, out, [&dis, &gen](int i) { return dis(gen); });
     bias_ = mat(1, out, [&dis, &gen](int i) { return dis(gen); });
-    w_sums_ = mat(1, out, [&dis, &gen](int i) { return dis(gen); });
   }
-  Layer& operator=(const Layer& other) {
-    if (this != &other) {
-
-      in_ = other.in_;
-      out_ = other.out_;
-
-      learnR_ = other.learnR_;
-      inputs_ = other.inputs_;
-      weights_ = other.weights_;
-      bias_ = other.bias_;
-      w_sums_ = other.w_sums_;
-
-      a_func = other.a_func;
-      d_func = other.d_func;
+  void set_activation(func func) {
+    a_func = func;
+    if (a_func == cxstructs::relu) {
+      d_func = cxstructs::d_relu;
+    } else if (a_func == cxstructs::sig) {
+      d_func = cxstructs::d_sig;
+    } else if (a_func == cxstructs::tanh) {
+      d_func = cxstructs::d_tanh;
+    } else {
+      d_func = cxstructs::d_linear;
     }
-    return *this;
   }
-  ~Layer() = default;
-  [[nodiscard]] mat forward(mat& in) {
-    inputs_ = in;
-
-    w_sums_ = in * weights_;  // matrix dimensions: (batch x in) * (in x out) = batch x out
-
-    // Add the bias to each row of 'w_sums_'
-    for (int i = 0; i < in.n_rows(); i++) {
-      for (int j = 0; j < out_; j++) {
-        w_sums_(i, j) += bias_(0, j);
-      }
-    }
-
-    mat out = w_sums_;
-    out.mat_op(a_func);
-    return out;
+  /**
+   * Only reads the parameters, so threads with their own buffers can run it concurrently
+   * @param in batch x in_ inputs - has to stay alive until backward()
+   * @param buf the buffers of the calling thread
+   * @return batch x out_ activations - valid until the next call
+   */
+  [[nodiscard]] mat& forward(const mat_view& in, LayerBuffers& buf) const {
+    buf.inputs_ = in;
+
+    // matrix dimensions: (batch x in) * (in x out) = batch x out, the bias is added to each row
+    affine_into(in, weights_, bias_, nullptr, buf.w_sums_);
+
+    buf.activations_ = buf.w_sums_;
+    buf.activations_.mat_op(a_func);
+    return buf.activations_;
   }
-
-  [[nodiscard]] mat backward(mat& error) {
-    w_sums_.mat_op(d_func);
+  /**
+   * Computes the gradients into buf.d_weights_ and buf.d_bias_ (both summed over the batch)
+   * and returns the error of the previous layer. Doesnt touch the parameters
+   * @param error batch x out_ error - is modified
+   * @param buf the buffers of the calling thread
+   * @param propagate false skips computing the error of the previous layer
+   * @return batch x in_ error - valid until the next call
+   */
+  mat& backward(mat& error, LayerBuffers& buf, bool propagate) const {
+    buf.w_sums_.mat_op(d_func);
 
     // Apply the derivative to each row of 'error'
-    for (int i = 0; i < error.n_rows(); i++) {
-      for (int j = 0; j < out_; j++) {
-        error(i, j) *= w_sums_(i, j);
-      }
-    }
+    error %= buf.w_sums_;
 
     //compute the gradient of the weights and bias
-    mat d_weights =
-        inputs_.transpose() * error;  //matrix dimensions: (in x batch) * (batch x out) = in x out
-    mat d_bias = error.sum_cols();    //sum the error over the batch dimension
-    d_bias.scale(1.0F/error.n_rows());
-
-    // Update the weights and bias
-    d_weights.scale(learnR_);
-    d_bias.scale(learnR_);
-    weights_ -= d_weights;
-    bias_ -= d_bias;
+    buf.d_weights_.resize(in_, out_);
+    gemm(1.0F, buf.inputs_, error, 0.0F, buf.d_weights_, true, false);  //(in x batch) * (batch x out) = in x out
+    sum_cols_into(error, buf.d_bias_);  //sum the error over the batch dimension
 
     // Compute the error for the previous layer
-    mat n_error = error * weights_.transpose();
-    return n_error;
+    if (propagate) {
+      buf.n_error_.resize(error.n_rows(), in_);
+      gemm(1.0F, error, weights_, 0.0F, buf.n_error_, false, true);
+    }
+    return buf.n_error_;
   }
 };
+/*
+ * Binary model format - native byte order, checked through the byte order mark:
+ * ModelHeader | uint32 bounds[layers + 1] | uint32 activation ids[layers] | pad to 64
+ * then per layer: weights (in x out floats) | pad to 64 | bias (out floats) | pad to 64
+ * Every float blob starts 64 byte aligned so mapped weights are as aligned as allocated ones
+ */
+constexpr char kModelMagic[8] = {'C', 'X', 'M', 'O', 'D', 'E', 'L', '\0'};
+constexpr uint32_t kModelVersion = 1;
+constexpr uint32_t kModelByteOrder = 0x01020304;
+constexpr size_t kModelAlign = 64;
+constexpr uint32_t kModelMaxBound = 65535;  // layer sizes have to fit the 16 bit Layer bounds
+struct ModelHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t byte_order_;
+  uint32_t layers_;
+  uint32_t loss_id_;
+  float learnR_;
+  uint32_t reserved_;
+};
+inline size_t model_align(size_t offset) noexcept {
+  return (offset + kModelAlign - 1) / kModelAlign * kModelAlign;
+}
+inline uint32_t activation_id(func func) {
+  if (func == cxstructs::linear) {
+    return 0;
+  } else if (func == cxstructs::relu) {
+    return 1;
+  } else if (func == cxstructs::sig) {
+    return 2;
+  } else if (func == cxstructs::tanh) {
+    return 3;
+  }
+  throw std::logic_error("custom activation functions cant be saved");
+}
+inline func activation_func(uint32_t id) {
+  constexpr func funcs[] = {cxstructs::linear, cxstructs::relu, cxstructs::sig, cxstructs::tanh};
+  if (id >= std::size(funcs)) {
+    throw std::runtime_error("unknown activation function in model file");
+  }
+  return funcs[id];
+}
+inline uint32_t loss_id(func_M loss) {
+  if (loss == mean_sqr_abs_err) {
+    return 0;
+  } else if (loss == mean_abs) {
+    return 1;
+  } else if (loss == cross_entropy) {
+    return 2;
+  }
+  throw std::logic_error("custom loss functions cant be saved");
+}
+inline func_M loss_func(uint32_t id) {
+  constexpr func_M funcs[] = {mean_sqr_abs_err, mean_abs, cross_entropy};
+  if (id >= std::size(funcs)) {
+    throw std::runtime_error("unknown loss function in model file");
+  }
+  return funcs[id];
+}
 }  // namespace cxhelper
 namespace cxstructs {
 using namespace cxhelper;
+/**
+ * <h2>Optimizer</h2>
+ * Turns the gradients of a training step into parameter updates.<p>
+ * Every parameter matrix has a fixed slot. init() is called for each slot before the first
+ * step, so stateful optimizers allocate their buffers once and reuse them for the whole training.
+ */
+class Optimizer {
+ public:
+  virtual ~Optimizer() = default;
+  /**
+   * Called once per parameter before training - allocate state here
+   * @param slot the index of the parameter
+   * @param param the parameter matrix
+   */
+  virtual void init(uint_32_cx /*slot*/, const mat& /*param*/) {}
+  /**
+   * Called once per mini-batch before the parameters are updated
+   */
+  virtual void begin_step() {}
+  /**
+   * Updates param with the given gradient
+   * @param slot the index of the parameter
+   * @param param the parameter matrix
+   * @param grad the gradient - same dimensions as param
+   * @param scale factor applied to the gradient first
+   */
+  virtual void step(uint_32_cx slot, mat& param, const mat& grad, float scale) = 0;
+};
+/**
+ * Plain gradient descent: param -= learnR * grad
+ */
+class SGD : public Optimizer {
+  float learnR_;
+
+ public:
+  explicit SGD(float learnR) : learnR_(learnR) {}
+  void step(uint_32_cx /*slot*/, mat& param, const mat& grad, float scale) override {
+    axpy(-learnR_ * scale, grad, param);
+  }
+};
+/**
+ * Gradient descent with momentum: v = momentum * v + grad, param -= learnR * v
+ */
+class Momentum : public Optimizer {
+  float learnR_;
+  float momentum_;
+  std::vector<mat> velocity_;
+
+ public:
+  explicit Momentum(float learnR, float momentum = 0.9F) : learnR_(learnR), momentum_(momentum) {}
+  void init(uint_32_cx slot, const mat& param) override {
+    if (velocity_.size() <= slot) {
+      velocity_.resize(slot + 1);
+    }
+    velocity_[slot] = mat(param.n_rows(), param.n_cols());
+  }
+  void step(uint_32_cx slot, mat& param, const mat& grad, float scale) override {
+    float* p = param.get_raw();
+    float* v = velocity_[slot].get_raw();
+    const float* g = grad.get_raw();
+    const uint_32_cx n = param.n_rows() * param.n_cols();
+#pragma omp simd
+    for (uint_32_cx i = 0; i < n; i++) {
+      v[i] = momentum_ * v[i] + scale * g[i];
+      p[i] -= learnR_ * v[i];
+    }
+  }
+};
+/**
+ * Adam - per element step sizes from bias corrected running averages of the gradient and its square
+ */
+class Adam : public Optimizer {
+  float learnR_;
+  float beta1_;
+  float beta2_;
+  float epsilon_;
+  float beta1_t_ = 1;  // beta1^t
+  float beta2_t_ = 1;  // beta2^t
+  std::vector<mat> m_;
+  std::vector<mat> v_;
+
+ public:
+  explicit Adam(float learnR = 0.001F, float beta1 = 0.9F, float beta2 = 0.999F,
+                float epsilon = 1e-8F)
+      : learnR_(learnR), beta1_(beta1), beta2_(beta2), epsilon_(epsilon) {}
+  void init(uint_32_cx slot, const mat& param) override {
+    if (m_.size() <= slot) {
+      m_.resize(slot + 1);
+      v_.resize(slot + 1);
+    }
+    m_[slot] = mat(param.n_rows(), param.n_cols());
+    v_[slot] = mat(param.n_rows(), param.n_cols());
+    beta1_t_ = beta2_t_ = 1;
+  }
+  void begin_step() override {
+    beta1_t_ *= beta1_;
+    beta2_t_ *= beta2_;
+  }
+  void step(uint_32_cx slot, mat& param, const mat& grad, float scale) override {
+    float* p = param.get_raw();
+    float* m = m_[slot].get_raw();
+    float* v = v_[slot].get_raw();
+    const float* g = grad.get_raw();
+    const uint_32_cx n = param.n_rows() * param.n_cols();
+    const float m_corr = 1.0F / (1.0F - beta1_t_);
+    const float v_corr = 1.0F / (1.0F - beta2_t_);
+#pragma omp simd
+    for (uint_32_cx i = 0; i < n; i++) {
+      const float gi = scale * g[i];
+      m[i] = beta1_ * m[i] + (1.0F - beta1_) * gi;
+      v[i] = beta2_ * v[i] + (1.0F - beta2_) * gi * gi;
+      p[i] -= learnR_ * (m[i] * m_corr) / (std::sqrt(v[i] * v_corr) + epsilon_);
+    }
+  }
+};
 /**
  * <h2>Feedforward Neural Network</h2>
- *
+ * Trained with mini-batch gradient descent. The batches are contiguous row blocks of the training
+ * data visited in a new random order every epoch, so the data is never copied. Shuffle the rows
+ * once beforehand if they are sorted.<p>
+ * With threads > 1 every batch is split across the global ThreadPool, each thread computes the
+ * gradients of its rows into its own buffers and they are summed before the update.
  */
 class FNN {
 
-  Layer* layers_;
+  std::vector<Layer> layers_;
   std::vector<int> bounds_;
   uint_16_cx len_;
   float learnR_;
   func_M loss_function_;
+  func_M_into loss_into_ = nullptr;
+  std::vector<Workspace> workspaces_;  // one per training thread, [0] is also used by forward()
+  std::unique_ptr<Optimizer> optimizer_;
+  bool optimizer_ready_ = false;
+  std::vector<uint_32_cx> batch_order_;
+  std::mt19937 rng_;
+  mat predict_buffers_[2];  // ping-pong outputs of predict()
+  Precision precision_ = Precision::FP32;
+  std::vector<qmat<int8_t>> weights_int8_;
+  std::vector<qmat<half>> weights_fp16_;
+  MappedFile mapping_;  // backs the weights of a model from load_mmap()
 
  public:
   explicit FNN(
       const std::vector<int>& bound, func a_func, float learnR,
-      func_M loss_function = mean_sqr_abs_err, func last_layer_func = [](float x) { return x; })
-      : learnR_(learnR), len_(bound.size() - 1), bounds_(bound), loss_function_(loss_function) {
-    layers_ = new Layer[len_];
+      func_M loss_function = mean_sqr_abs_err, func last_layer_func = cxstructs::linear)
+      : learnR_(learnR),
+        len_(bound.size() - 1),
+        bounds_(bound),
+        loss_function_(loss_function),
+        optimizer_(std::make_unique<SGD>(learnR)),
+        rng_(std::random_device()()) {
+    set_loss(loss_function);
+    layers_.resize(len_);
     for (int i = 1; i < len_ + 1; i++) {
       if (i == len_) {
-        layers_[i - 1] = Layer(bounds_[i - 1], bounds_[i], last_layer_func, learnR_);
+        layers_[i - 1] = Layer(bounds_[i - 1], bounds_[i], last_layer_func);
         break;
       }
-      layers_[i - 1] = Layer(bounds_[i - 1], bounds_[i], a_func, learnR_);
+      layers_[i - 1] = Layer(bounds_[i - 1], bounds_[i], a_func);
     }
+    add_workspaces(1);
   }
-  ~FNN() { delete[] layers_; }
+  FNN(const FNN&) = delete;
+  FNN& operator=(const FNN&) = delete;
+  FNN(FNN&&) noexcept = default;
+  FNN& operator=(FNN&&) noexcept = default;
+  ~FNN() = default;
 
-  mat forward(const mat& in) {
-    mat retval = in;
-    for (int i = 0; i < len_; i++) {
-      retval = layers_[i].forward(retval);
+  mat forward(const mat& in) { return forward_layers(in, workspaces_[0]); }
+  /**
+   * Inference only forward pass. Keeps nothing for backpropagation, fuses the bias and activation
+   * into the matrix multiply and alternates the layers between two reused buffers<p>
+   * Not thread safe - concurrent callers need their own FNN
+   * @param in batch x input-size rows, every row is a separate request
+   * @return batch x output-size predictions - valid until the next call
+   */
+  const mat& predict(const mat_view& in) {
+    mat_view current = in;
+    for (uint_32_cx i = 0; i < len_; i++) {
+      mat& out = predict_buffers_[i % 2];
+      const Layer& layer = layers_[i];
+      if (precision_ == Precision::INT8) {
+        affine_into(current, weights_int8_[i], layer.bias_, layer.a_func, out);
+      } else if (precision_ == Precision::FP16) {
+        affine_into(current, weights_fp16_[i], layer.bias_, layer.a_func, out);
+      } else {
+        affine_into(current, layer.weights_, layer.bias_, layer.a_func, out);
+      }
+      current = out;
     }
-    return retval;
+    return predict_buffers_[(len_ - 1) % 2];
   }
-  void train(mat& in, mat& target, uint_16_cx n = 10, uint_16_cx batchSize = 10) {
-    for (int k = 0; k < n; k++) {
-      mat outputs = forward(in);  // dims: batch x last-layer-target
-
-      outputs = loss_function_(outputs, target);  // target dims : batch x last-layer-target
+  /**
+   * Post-training quantization of the weights used by predict() - the biases stay float<p>
+   * FP16 halves and INT8 (one scale per output neuron) quarters the weight memory. The float weights
+   * are kept for forward() and training, calling train() switches predict() back to FP32
+   * @param precision the storage precision of the inference weights
+   */
+  void quantize(Precision precision) {
+    weights_int8_.clear();
+    weights_fp16_.clear();
+    for (uint_32_cx i = 0; i < len_; i++) {
+      if (precision == Precision::INT8) {
+        weights_int8_.emplace_back(layers_[i].weights_);
+      } else if (precision == Precision::FP16) {
+        weights_fp16_.emplace_back(layers_[i].weights_);
+      }
+    }
+    precision_ = precision;
+  }
+  [[nodiscard]] Precision precision() const noexcept { return precision_; }
+  /**
+   * @return the memory of the weights predict() runs on in bytes
+   */
+  [[nodiscard]] size_t weight_bytes() const noexcept {
+    size_t bytes = 0;
+    for (uint_32_cx i = 0; i < len_; i++) {
+      if (precision_ == Precision::INT8) {
+        bytes += weights_int8_[i].bytes();
+      } else if (precision_ == Precision::FP16) {
+        bytes += weights_fp16_[i].bytes();
+      } else {
+        bytes += layers_[i].weights_.n_rows() * layers_[i].weights_.n_cols() * sizeof(float);
+      }
+    }
+    return bytes;
+  }
+  /**
+   * Replaces the optimizer used by train() - the default is SGD with the learning rate of the constructor
+   * @param optimizer the new optimizer
+   */
+  void set_optimizer(std::unique_ptr<Optimizer> optimizer) {
+    optimizer_ = std::move(optimizer);
+    optimizer_ready_ = false;
+  }
+  /**
+   * Mini-batch gradient descent over the given data
+   * @param in rows x input-size training inputs
+   * @param target rows x output-size expected outputs
+   * @param n number of epochs
+   * @param batchSize rows per parameter update
+   * @param threads number of threads computing the gradients of a batch in parallel
+   */
+  void train(mat& in, mat& target, uint_16_cx n = 10, uint_16_cx batchSize = 10,
+             uint_16_cx threads = 1) {
+    CX_ASSERT(in.n_rows() == target.n_rows(), "inputs and targets differ in length");
+    const uint_32_cx rows = in.n_rows();
+    if (rows == 0) {
+      return;
+    }
+    batchSize = std::max<uint_16_cx>(batchSize, 1);
+    threads = std::max<uint_16_cx>(threads, 1);
+    quantize(Precision::FP32);  // quantized weights would go stale
+    add_workspaces(threads);
+    if (!optimizer_ready_) {
+      for (uint_32_cx i = 0; i < len_; i++) {
+        optimizer_->init(2 * i, layers_[i].weights_);
+        optimizer_->init(2 * i + 1, layers_[i].bias_);
+      }
+      optimizer_ready_ = true;
+    }
 
-      for (int i = len_ - 1; i > -1; i--) {
-        outputs = layers_[i].backward(outputs);
+    batch_order_.resize((rows + batchSize - 1) / batchSize);
+    std::iota(batch_order_.begin(), batch_order_.end(), 0);
+    for (uint_32_cx k = 0; k < n; k++) {
+      std::shuffle(batch_order_.begin(), batch_order_.end(), rng_);
+      for (uint_32_cx batch : batch_order_) {
+        const uint_32_cx start = batch * batchSize;
+        train_batch(in, target, start, std::min<uint_32_cx>(batchSize, rows - start), threads);
       }
     }
   }
   vec<float, false> get_weights(int layer, int row) { return layers_[layer].weights_.get_row(row); }
+  [[nodiscard]] const std::vector<int>& bounds() const noexcept { return bounds_; }
+  /**
+   * Direct access to the parameters of a layer, e.g. for custom training schemes<p>
+   * Quantized copies made with quantize() are not updated by writes
+   * @param layer index of the layer
+   * @return the in x out weight matrix
+   */
+  [[nodiscard]] mat& weights(int layer) noexcept { return layers_[layer].weights_; }
+  /**
+   * @param layer index of the layer
+   * @return the 1 x out bias row
+   */
+  [[nodiscard]] mat& bias(int layer) noexcept { return layers_[layer].bias_; }
+  /**
+   * Writes the network in a compact binary format: a header with the layer bounds, activation and
+   * loss ids followed by 64 byte aligned weight and bias blobs<p>
+   * Only the built-in activation (linear, relu, sig, tanh) and loss functions can be saved
+   * @param path the file to write
+   * @throws std::logic_error for custom functions, std::runtime_error if the file cant be written
+   */
+  void save(const std::string& path) const {
+    ModelHeader header{};
+    std::copy(std::begin(kModelMagic), std::end(kModelMagic), header.magic_);
+    header.version_ = kModelVersion;
+    header.byte_order_ = kModelByteOrder;
+    header.layers_ = len_;
+    header.loss_id_ = loss_id(loss_function_);
+    header.learnR_ = learnR_;
+    std::vector<uint32_t> meta(bounds_.begin(), bounds_.end());
+    for (const Layer& layer : layers_) {
+      meta.push_back(activation_id(layer.a_func));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("could not open " + path);
+    }
+    size_t offset = 0;
+    auto write = [&](const void* data, size_t bytes) {
+      file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+      offset += bytes;
+    };
+    auto pad = [&]() {
+      constexpr char zeros[kModelAlign] = {};
+      write(zeros, model_align(offset) - offset);
+    };
+    write(&header, sizeof(ModelHeader));
+    write(meta.data(), meta.size() * sizeof(uint32_t));
+    pad();
+    for (const Layer& layer : layers_) {
+      write(layer.weights_.get_raw(), layer.weights_.n_rows() * layer.weights_.n_cols() * sizeof(float));
+      pad();
+      write(layer.bias_.get_raw(), layer.bias_.n_cols() * sizeof(float));
+      pad();
+    }
+    if (!file) {
+      throw std::runtime_error("could not write " + path);
+    }
+  }
+  /**
+   * Loads a network written by save() into newly allocated memory
+   * @param path the model file
+   * @throws std::runtime_error if the file cant be read or isnt a valid model
+   */
+  static FNN load(const std::string& path) { return from_file(path, true); }
+  /**
+   * Maps the model file into memory and runs directly on it - nothing is read or copied upfront,
+   * the operating system pages the weights in on first use. The mapping is copy-on-write, training
+   * the loaded network never modifies the file
+   * @param path the model file
+   * @throws std::runtime_error if the file cant be mapped or isnt a valid model
+   */
+  static FNN load_mmap(const std::string& path) { return from_file(path, false); }
+
+ private:
+  // a network of the given shape without initialized weights
+  FNN(const std::vector<int>& bound, float learnR, func_M loss_function)
+      : bounds_(bound),
+        len_(bound.size() - 1),
+        learnR_(learnR),
+        optimizer_(std::make_unique<SGD>(learnR)),
+        rng_(std::random_device()()) {
+    set_loss(loss_function);
+    layers_.resize(len_);
+    add_workspaces(1);
+  }
+  void set_loss(func_M loss_function) {
+    loss_function_ = loss_function;
+    if (loss_function == mean_sqr_abs_err) {
+      loss_into_ = mean_sqr_abs_err_into;
+    } else if (loss_function == mean_abs) {
+      loss_into_ = mean_abs_into;
+    } else if (loss_function == cross_entropy) {
+      loss_into_ = cross_entropy_into;
+    }
+  }
+  static FNN from_file(const std::string& path, bool copy) {
+    MappedFile file;
+    if (!file.open(path, true)) {
+      throw std::runtime_error("could not open " + path);
+    }
+    auto invalid = [&path]() {
+      return std::runtime_error(path + " is not a valid model file");
+    };
+    ModelHeader header{};
+    if (file.size() < sizeof(ModelHeader)) {
+      throw invalid();
+    }
+    std::memcpy(&header, file.data(), sizeof(ModelHeader));
+    if (!std::equal(std::begin(kModelMagic), std::end(kModelMagic), header.magic_) ||
+        header.version_ != kModelVersion || header.byte_order_ != kModelByteOrder ||
+        header.layers_ == 0) {
+      throw invalid();
+    }
+    const size_t meta_count = 2 * static_cast<size_t>(header.layers_) + 1;
+    size_t offset = sizeof(ModelHeader) + meta_count * sizeof(uint32_t);
+    if (file.size() < offset) {
+      throw invalid();
+    }
+    std::vector<uint32_t> meta(meta_count);
+    std::memcpy(meta.data(), file.data() + sizeof(ModelHeader), meta_count * sizeof(uint32_t));
+    std::vector<int> bounds(header.layers_ + 1);
+    for (uint32_t i = 0; i <= header.layers_; i++) {
+      if (meta[i] == 0 || meta[i] > kModelMaxBound) {
+        throw invalid();
+      }
+      bounds[i] = static_cast<int>(meta[i]);
+    }
+    // the whole payload has to be in the file before the network is allocated
+    size_t end = offset;
+    for (uint32_t i = 0; i < header.layers_; i++) {
+      end = model_align(end) + static_cast<size_t>(meta[i]) * meta[i + 1] * sizeof(float);
+      end = model_align(end) + static_cast<size_t>(meta[i + 1]) * sizeof(float);
+      if (file.size() < end) {
+        throw invalid();
+      }
+    }
+
+    FNN net(bounds, header.learnR_, loss_func(header.loss_id_));
+    auto blob = [&](size_t floats) {
+      offset = model_align(offset);
+      if (file.size() < offset + floats * sizeof(float)) {
+        throw invalid();
+      }
+      auto* data = reinterpret_cast<float*>(file.data() + offset);
+      offset += floats * sizeof(float);
+      return data;
+    };
+    for (uint32_t i = 0; i < header.layers_; i++) {
+      Layer& layer = net.layers_[i];
+      layer.in_ = bounds[i];
+      layer.out_ = bounds[i + 1];
+      layer.set_activation(activation_func(meta[header.layers_ + 1 + i]));
+      float* weights = blob(static_cast<size_t>(meta[i]) * meta[i + 1]);
+      float* bias = blob(meta[i + 1]);
+      if (copy) {
+        layer.weights_ = mat(weights, layer.in_, layer.out_);
+        layer.bias_ = mat(bias, 1, layer.out_);
+      } else {
+        layer.weights_ = mat::wrap(weights, layer.in_, layer.out_);
+        layer.bias_ = mat::wrap(bias, 1, layer.out_);
+      }
+    }
+    if (!copy) {
+      net.mapping_ = std::move(file);
+    }
+    return net;
+  }
+  void add_workspaces(uint_32_cx count) {
+    while (workspaces_.size() < count) {
+      workspaces_.emplace_back().layers_.resize(len_);
+    }
+  }
+  // the activations of the last layer, owned by the workspace
+  mat& forward_layers(const mat& in, Workspace& ws) {
+    mat_view retval = in;
+    for (uint_32_cx i = 0; i < len_; i++) {
+      retval = layers_[i].forward(retval, ws.layers_[i]);
+    }
+    return ws.layers_[len_ - 1].activations_;
+  }
+  // forward and backward pass of the given rows, the gradients end up in the workspace
+  void compute_gradients(const mat& in, mat& target, Workspace& ws) {
+    mat& outputs = forward_layers(in, ws);  // dims: batch x last-layer-target
+
+    // target dims : batch x last-layer-target
+    if (loss_into_) {
+      loss_into_(outputs, target, ws.loss_);
+    } else {
+      ws.loss_ = loss_function_(outputs, target);
+    }
+
+    mat* error = &ws.loss_;
+    for (int i = len_ - 1; i > -1; i--) {
+      error = &layers_[i].backward(*error, ws.layers_[i], i > 0);
+    }
+  }
+  void train_batch(mat& in, mat& target, uint_32_cx start, uint_32_cx count, uint_32_cx threads) {
+    const uint_32_cx shards = std::min(threads, count);
+    auto run_shard = [&](uint_32_cx s) {
+      const uint_32_cx begin = start + count * s / shards;
+      const uint_32_cx end = start + count * (s + 1) / shards;
+      // non-owning row slices - no copy of the training data
+      mat in_rows = mat::wrap(in.get_raw() + begin * in.n_cols(), end - begin, in.n_cols());
+      mat target_rows =
+          mat::wrap(target.get_raw() + begin * target.n_cols(), end - begin, target.n_cols());
+      compute_gradients(in_rows, target_rows, workspaces_[s]);
+    };
+    if (shards == 1) {
+      run_shard(0);
+    } else {
+      ThreadPool::global().parallel_for(0, shards, [&](uint_32_cx b, uint_32_cx e) {
+        for (uint_32_cx s = b; s < e; s++) {
+          run_shard(s);
+        }
+      });
+    }
+
+    std::vector<LayerBuffers>& grads = workspaces_[0].layers_;
+    for (uint_32_cx s = 1; s < shards; s++) {
+      for (uint_32_cx i = 0; i < len_; i++) {
+        axpy(1.0F, workspaces_[s].layers_[i].d_weights_, grads[i].d_weights_);
+        axpy(1.0F, workspaces_[s].layers_[i].d_bias_, grads[i].d_bias_);
+      }
+    }
+    optimizer_->begin_step();
+    for (uint_32_cx i = 0; i < len_; i++) {
+      optimizer_->step(2 * i, layers_[i].weights_, grads[i].d_weights_, 1.0F);
+      optimizer_->step(2 * i + 1, layers_[i].bias_, grads[i].d_bias_, 1.0F / count);
+    }
+  }
+
+ public:
 
 };
 }  // namespace cxstructs
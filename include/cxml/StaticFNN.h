@@ -0,0 +1,247 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXML_STATICFNN_H_
+#define CXSTRUCTS_SRC_CXML_STATICFNN_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxstructs/fixed_mat.h"
+#include "../cxstructs/row.h"
+#include "../cxutil/cxactivation.h"
+
+// Feed forward network with the topology as template parameters - for small fixed models at inference time
+// All shapes are known at compile time, the layers live inline in the object and the forward pass is unrolled
+
+namespace cxhelper {
+// calls f(std::integral_constant<uint_32_cx, I>) for I in [0, N) - unrolled
+template <uint_32_cx N, typename F>
+inline void static_for(F&& f) noexcept {
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    (f(std::integral_constant<uint_32_cx, I>{}), ...);
+  }(std::make_index_sequence<N>{});
+}
+// weights in x out like FNN - a row of the matrix holds the weights of one input to all outputs
+template <uint_32_cx In, uint_32_cx Out>
+struct StaticLayer {
+  cxstructs::fixed_mat<In, Out> weights_;
+  cxstructs::row<Out> bias_ = cxstructs::row<Out>(0.0F);
+
+  // y = activation(x * W + b) as multiply-adds of whole output vectors - no horizontal sums.
+  // The sums stay in registers, short rows use several chains over alternating inputs so the
+  // multiply-adds dont wait on each other
+  template <typename V, uint_32_cx L, typename Activation>
+  inline void forward_lanes(const float* x, float* y) const noexcept {
+    constexpr uint_32_cx kVecs = Out / L;
+    constexpr uint_32_cx kChains = kVecs >= 4 ? 1 : 4 / kVecs;
+    V sum[kChains][kVecs];
+    static_for<kVecs>([&](auto k) {
+      sum[0][k] = v_load<V>(bias_.data() + k * L);
+      static_for<kChains - 1>([&](auto c) { sum[c + 1][k] = v_set<V>(0.0F); });
+    });
+    auto step = [&](uint_32_cx i, uint_32_cx c) {
+      const V xi = v_set<V>(x[i]);
+      const float* w = weights_[i].data();
+      static_for<kVecs>([&](auto k) { sum[c][k] = v_fmadd(xi, v_load<V>(w + k * L), sum[c][k]); });
+    };
+    uint_32_cx i = 0;
+    for (; i + kChains <= In; i += kChains) {
+      static_for<kChains>([&](auto c) { step(i + c, c); });
+    }
+    for (; i < In; i++) {
+      step(i, 0);
+    }
+    alignas(64) float out[Out];
+    static_for<kVecs>([&](auto k) {
+      static_for<kChains - 1>([&](auto c) { sum[0][k] = v_add(sum[0][k], sum[c + 1][k]); });
+      v_store(out + k * L, sum[0][k]);
+    });
+    Activation::template apply<Out>(out);
+    std::copy_n(out, Out, y);
+  }
+  template <typename Activation>
+  inline void forward(const float* x, float* y) const noexcept {
+#if defined(CX_AVX2)
+    if constexpr (Out % 8 == 0) {
+      forward_lanes<__m256, 8, Activation>(x, y);
+      return;
+    }
+#endif
+#if defined(CX_SSE2)
+    if constexpr (Out % 4 == 0) {
+      forward_lanes<__m128, 4, Activation>(x, y);
+      return;
+    }
+#endif
+    forward_lanes<float, 1, Activation>(x, y);
+  }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>StaticFNN</h2>
+ * is a feed forward network for inference whose topology is fixed at compile time, e.g.
+ * StaticFNN&lt;ReLU, 16, 32, 8&gt; has 16 inputs, a hidden layer of 32 and 8 outputs.<p>
+ * The weights are fixed_mat and row members, so the network never allocates and a forward pass runs on two
+ * stack buffers. Every layer loop has a constant trip count and the activation is a type (ReLU, Sigmoid, Tanh,
+ * Linear), so the compiler unrolls, vectorizes and inlines the whole pass - there are no function pointers
+ * and no shape checks at runtime.
+ * <br><br>
+ * Train with FNN and copy the parameters over with copy_from(). Like the default of FNN, the hidden layers
+ * use Activation and the output layer is linear.
+ * @tparam Activation activation of the hidden layers
+ * @tparam N the layer sizes, from the inputs to the outputs
+ */
+template <typename Activation, uint_32_cx... N>
+class StaticFNN {
+  static_assert(sizeof...(N) >= 2, "a network needs at least an input and an output size");
+  static_assert(((N > 0) && ...), "layers cant be empty");
+
+  static constexpr std::array<uint_32_cx, sizeof...(N)> kBounds{N...};
+  static constexpr uint_32_cx kLayers = sizeof...(N) - 1;
+  static constexpr uint_32_cx kWidest = std::max({N...});
+
+  template <std::size_t... I>
+  static auto make_layers(std::index_sequence<I...>)
+      -> std::tuple<cxhelper::StaticLayer<kBounds[I], kBounds[I + 1]>...>;
+  decltype(make_layers(std::make_index_sequence<kLayers>{})) layers_;
+
+  template <std::size_t... I>
+  inline void run(const float* in, float* out, std::index_sequence<I...>) const noexcept {
+    alignas(64) float buffers[2][kWidest];
+    (
+        [&] {
+          const float* src = I == 0 ? in : buffers[(I + 1) % 2];
+          float* dst = I + 1 == kLayers ? out : buffers[I % 2];
+          using Act = std::conditional_t<I + 1 == kLayers, Linear, Activation>;
+          std::get<I>(layers_).template forward<Act>(src, dst);
+        }(),
+        ...);
+  }
+
+ public:
+  static constexpr uint_32_cx inputs = kBounds.front();
+  static constexpr uint_32_cx outputs = kBounds.back();
+  static constexpr uint_32_cx layers = kLayers;
+  /**
+   * All weights and biases zero
+   */
+  StaticFNN() = default;
+  /**
+   * Random weights and biases in [-0.3, 0.3] like a new FNN
+   */
+  explicit StaticFNN(uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<float> dis(-0.3F, 0.3F);
+    std::apply(
+        [&](auto&... layer) {
+          (
+              [&] {
+                for (uint_32_cx i = 0; i < layer.weights_.n_rows(); i++) {
+                  for (float& w : layer.weights_[i]) {
+                    w = dis(gen);
+                  }
+                }
+                for (float& b : layer.bias_) {
+                  b = dis(gen);
+                }
+              }(),
+              ...);
+        },
+        layers_);
+  }
+  /**
+   * Copies the parameters of a trained network, e.g. an FNN - its activations have to match
+   * @param net has bounds(), weights(layer) (in x out) and bias(layer) (1 x out)
+   * @throws std::invalid_argument if the topology differs
+   */
+  template <typename Net>
+  void copy_from(Net& net) {
+    const std::vector<int> expected{static_cast<int>(N)...};
+    if (net.bounds() != expected) {
+      throw std::invalid_argument("the network has a different topology");
+    }
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (
+          [&] {
+            auto& layer = std::get<I>(layers_);
+            const auto& weights = net.weights(static_cast<int>(I));
+            const auto& bias = net.bias(static_cast<int>(I));
+            for (uint_32_cx i = 0; i < kBounds[I]; i++) {
+              for (uint_32_cx o = 0; o < kBounds[I + 1]; o++) {
+                layer.weights_(i, o) = weights(i, o);
+              }
+            }
+            for (uint_32_cx o = 0; o < kBounds[I + 1]; o++) {
+              layer.bias_[o] = bias(0, o);
+            }
+          }(),
+          ...);
+    }(std::make_index_sequence<kLayers>{});
+  }
+  /**
+   * @return the in x out weights of layer L
+   */
+  template <uint_32_cx L>
+  [[nodiscard]] auto& weights() noexcept {
+    return std::get<L>(layers_).weights_;
+  }
+  /**
+   * @return the bias of layer L
+   */
+  template <uint_32_cx L>
+  [[nodiscard]] auto& bias() noexcept {
+    return std::get<L>(layers_).bias_;
+  }
+  /**
+   * Runs one sample through the network
+   * @param in inputs floats
+   * @param out receives outputs floats - must not overlap in
+   */
+  inline void predict(const float* in, float* out) const noexcept {
+    run(in, out, std::make_index_sequence<kLayers>{});
+  }
+  [[nodiscard]] inline row<outputs> predict(const row<inputs>& in) const noexcept {
+    row<outputs> out;
+    predict(in.data(), out.data());
+    return out;
+  }
+  /**
+   * Runs count samples stored one after another
+   * @param in count * inputs floats
+   * @param out count * outputs floats
+   */
+  inline void predict_batch(const float* in, float* out, uint_32_cx count) const noexcept {
+    for (uint_32_cx s = 0; s < count; s++) {
+      predict(in + static_cast<size_t>(s) * inputs, out + static_cast<size_t>(s) * outputs);
+    }
+  }
+};
+}  // namespace cxstructs
+
+#endif  //CXSTRUCTS_SRC_CXML_STATICFNN_H_
@@ -0,0 +1,327 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTQUEUE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTQUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxmath.h"
+
+// Fixed capacity lock-free ring buffers for passing messages between threads
+// SPSCQueue: one producer and one consumer, each side only writes its own index
+// MPMCQueue: any number of producers and consumers, every slot carries a sequence number (Vyukov)
+// Indices grow forever and are masked into the power of two buffer, so full and empty never look alike
+
+namespace cxhelper {
+constexpr size_t kCacheLine = 64;
+// uninitialized storage for one element
+template <typename T>
+struct QueueSlot {
+  alignas(T) unsigned char data[sizeof(T)];
+  inline T* ptr() noexcept { return std::launder(reinterpret_cast<T*>(data)); }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>SPSCQueue</h2>
+ * Lock-free queue for exactly <b>one</b> producer thread and <b>one</b> consumer thread.
+ * <br><br>
+ * The producer only writes the tail and the consumer only writes the head, both on their own cache line.
+ * Each side keeps a cached copy of the other index and only reloads it when the queue looks full or empty,
+ * so in steady state a push or pop touches no shared cache line except the slot itself.
+ * The batch functions publish many elements with a single atomic store.
+ * @tparam T value type
+ */
+template <typename T>
+class SPSCQueue {
+  using Slot = QueueSlot<T>;
+  Slot* slots_;
+  size_t mask_;
+  alignas(kCacheLine) std::atomic<size_t> head_{0};  // next slot to pop, written by the consumer
+  size_t tail_cache_ = 0;                             // consumer copy of tail_
+  alignas(kCacheLine) std::atomic<size_t> tail_{0};  // next slot to push, written by the producer
+  size_t head_cache_ = 0;                             // producer copy of head_
+  alignas(kCacheLine) char pad_[kCacheLine - sizeof(size_t)]{};
+
+  // number of free slots for the producer, refreshes the cached head only if needed
+  inline size_t free_slots(size_t tail, size_t wanted) noexcept {
+    size_t free = mask_ + 1 - (tail - head_cache_);
+    if (free < wanted) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      free = mask_ + 1 - (tail - head_cache_);
+    }
+    return free;
+  }
+  inline size_t used_slots(size_t head, size_t wanted) noexcept {
+    size_t used = tail_cache_ - head;
+    if (used < wanted) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      used = tail_cache_ - head;
+    }
+    return used;
+  }
+
+ public:
+  /**
+   * @param capacity maximum number of elements - rounded to the next power of two
+   */
+  explicit SPSCQueue(uint_32_cx capacity = 1024)
+      : slots_(new Slot[next_power_of_2(std::max<uint_32_cx>(capacity, 2))]),
+        mask_(next_power_of_2(std::max<uint_32_cx>(capacity, 2)) - 1) {}
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+  ~SPSCQueue() {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (size_t i = head_.load(); i != tail_.load(); i++) {
+        slots_[i & mask_].ptr()->~T();
+      }
+    }
+    delete[] slots_;
+  }
+  /**
+   * Constructs a new element at the back - producer only
+   * @return false if the queue is full
+   */
+  template <typename... Args>
+  inline bool try_emplace(Args&&... args) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (free_slots(tail, 1) == 0) {
+      return false;
+    }
+    ::new (slots_[tail & mask_].data) T(std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+  inline bool try_push(const T& val) { return try_emplace(val); }
+  inline bool try_push(T&& val) { return try_emplace(std::move(val)); }
+  /**
+   * Moves the front element into out - consumer only
+   * @return false if the queue is empty
+   */
+  inline bool try_pop(T& out) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (used_slots(head, 1) == 0) {
+      return false;
+    }
+    T* ptr = slots_[head & mask_].ptr();
+    out = std::move(*ptr);
+    ptr->~T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  /**
+   * Copies as many of the n elements as fit - producer only
+   * @param vals the elements
+   * @param n number of elements
+   * @return the number of elements pushed
+   */
+  inline size_t push_n(const T* vals, size_t n) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    n = std::min(n, free_slots(tail, n));
+    for (size_t i = 0; i < n; i++) {
+      ::new (slots_[(tail + i) & mask_].data) T(vals[i]);
+    }
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+  /**
+   * Moves up to n elements into out - consumer only
+   * @param out destination with room for n elements
+   * @param n maximum number of elements
+   * @return the number of elements popped
+   */
+  inline size_t pop_n(T* out, size_t n) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    n = std::min(n, used_slots(head, n));
+    for (size_t i = 0; i < n; i++) {
+      T* ptr = slots_[(head + i) & mask_].ptr();
+      out[i] = std::move(*ptr);
+      ptr->~T();
+    }
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+  /**
+   * Exact if called from the producer or consumer while the other side is idle
+   * @return the approximate number of elements
+   */
+  [[nodiscard]] inline size_t size_approx() const noexcept {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+  [[nodiscard]] inline bool empty_approx() const noexcept { return size_approx() == 0; }
+  [[nodiscard]] inline size_t capacity() const noexcept { return mask_ + 1; }
+};
+
+/**
+ * <h2>MPMCQueue</h2>
+ * Bounded lock-free queue for any number of producers and consumers (Dmitry Vyukov's design).
+ * <br><br>
+ * Every slot has a sequence number that says whose turn it is: a slot with sequence == pos is free for
+ * the producer claiming position pos, sequence == pos + 1 means it holds the element for the consumer at pos.
+ * Producers and consumers claim positions with a single compare-and-swap on their own padded counter
+ * and never touch each others counter. The batch functions claim a whole run of ready slots with one CAS.
+ * @tparam T value type
+ */
+template <typename T>
+class MPMCQueue {
+  struct alignas(kCacheLine) Cell {
+    std::atomic<size_t> seq;
+    QueueSlot<T> slot;
+  };
+  Cell* cells_;
+  size_t mask_;
+  alignas(kCacheLine) std::atomic<size_t> enqueue_{0};
+  alignas(kCacheLine) std::atomic<size_t> dequeue_{0};
+  alignas(kCacheLine) char pad_[kCacheLine - sizeof(size_t)]{};
+
+  // claims up to n consecutive slots whose sequence is pos + offset, returns the first position
+  inline size_t claim(std::atomic<size_t>& counter, size_t offset, size_t& n) noexcept {
+    size_t pos = counter.load(std::memory_order_relaxed);
+    while (true) {
+      size_t ready = 0;
+      while (ready < n) {
+        const size_t seq = cells_[(pos + ready) & mask_].seq.load(std::memory_order_acquire);
+        const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + ready + offset);
+        if (diff != 0) {
+          if (diff > 0 && ready == 0) {
+            ready = SIZE_MAX;  // another thread took pos, reload
+          }
+          break;
+        }
+        ready++;
+      }
+      if (ready == SIZE_MAX) {
+        pos = counter.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (ready == 0) {
+        n = 0;
+        return pos;
+      }
+      if (counter.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+        n = ready;
+        return pos;
+      }
+    }
+  }
+
+ public:
+  /**
+   * @param capacity maximum number of elements - rounded to the next power of two
+   */
+  explicit MPMCQueue(uint_32_cx capacity = 1024)
+      : cells_(new Cell[next_power_of_2(std::max<uint_32_cx>(capacity, 2))]),
+        mask_(next_power_of_2(std::max<uint_32_cx>(capacity, 2)) - 1) {
+    for (size_t i = 0; i <= mask_; i++) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  MPMCQueue(const MPMCQueue&) = delete;
+  MPMCQueue& operator=(const MPMCQueue&) = delete;
+  ~MPMCQueue() {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (size_t i = dequeue_.load(); i != enqueue_.load(); i++) {
+        cells_[i & mask_].slot.ptr()->~T();
+      }
+    }
+    delete[] cells_;
+  }
+  /**
+   * Constructs a new element at the back
+   * @return false if the queue is full
+   */
+  template <typename... Args>
+  inline bool try_emplace(Args&&... args) {
+    size_t n = 1;
+    const size_t pos = claim(enqueue_, 0, n);
+    if (n == 0) {
+      return false;
+    }
+    Cell& cell = cells_[pos & mask_];
+    ::new (cell.slot.data) T(std::forward<Args>(args)...);
+    cell.seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+  inline bool try_push(const T& val) { return try_emplace(val); }
+  inline bool try_push(T&& val) { return try_emplace(std::move(val)); }
+  /**
+   * Moves the front element into out
+   * @return false if the queue is empty
+   */
+  inline bool try_pop(T& out) { return pop_n(&out, 1) == 1; }
+  /**
+   * Copies up to n elements into consecutive slots - stops early if the queue fills up
+   * @param vals the elements
+   * @param n number of elements
+   * @return the number of elements pushed, they stay in order relative to each other
+   */
+  inline size_t push_n(const T* vals, size_t n) {
+    const size_t pos = claim(enqueue_, 0, n);
+    for (size_t i = 0; i < n; i++) {
+      Cell& cell = cells_[(pos + i) & mask_];
+      ::new (cell.slot.data) T(vals[i]);
+      cell.seq.store(pos + i + 1, std::memory_order_release);
+    }
+    return n;
+  }
+  /**
+   * Moves up to n consecutive elements into out
+   * @param out destination with room for n elements
+   * @param n maximum number of elements
+   * @return the number of elements popped
+   */
+  inline size_t pop_n(T* out, size_t n) {
+    const size_t pos = claim(dequeue_, 1, n);
+    for (size_t i = 0; i < n; i++) {
+      Cell& cell = cells_[(pos + i) & mask_];
+      T* ptr = cell.slot.ptr();
+      out[i] = std::move(*ptr);
+      ptr->~T();
+      cell.seq.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+    return n;
+  }
+  /**
+   * Counts claimed positions, so it includes elements that are still being written or read
+   * @return the approximate number of elements
+   */
+  [[nodiscard]] inline size_t size_approx() const noexcept {
+    const size_t head = dequeue_.load(std::memory_order_acquire);
+    const size_t tail = enqueue_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+  [[nodiscard]] inline bool empty_approx() const noexcept { return size_approx() == 0; }
+  [[nodiscard]] inline size_t capacity() const noexcept { return mask_ + 1; }
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTQUEUE_H_
@@ -136,6 +136,17 @@ class DoubleLinkedList {
     * @return the current n_elem of this Linked List
     */
   [[nodiscard]] uint_32_cx size() const { return size_; }
+  /**
+   * @return the heap memory of this list - one node per element
+   */
+  [[nodiscard]] MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.blocks = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    stats.bytes_reserved = size_ * sizeof(DListNode<T>);
+    return stats;
+  }
   /**
   * Removes the element at index counting from the start node
   * @param index  - the index at which to erase the element
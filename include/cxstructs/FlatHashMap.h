@@ -0,0 +1,555 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_FLATHASHMAP_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_FLATHASHMAP_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include "../cxalgos/MathFunctions.h"
+#include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+
+// Open addressing HashMap in the style of the SwissTable
+// Keys and values live in flat arrays, a separate array of control bytes stores 7 bits of the hash per slot
+// Lookups compare 16 control bytes at once (SSE2/NEON) and only touch the key array on a hash match
+// No allocations per element, so insert/erase churn doesn't hit the allocator at all
+
+namespace cxhelper {  // namespace to hide the classes
+using ctrl_t = int8_t;
+constexpr ctrl_t kCtrlEmpty = -128;  // 0b10000000
+constexpr ctrl_t kCtrlDeleted = -2;  // 0b11111110
+constexpr uint_32_cx kGroupWidth = 16;
+
+/**
+ * Bitmask over the slots of a control group <p>
+ * SSE2 and the scalar version use one bit per slot, NEON uses the top bit of a nibble per slot
+ * @tparam Shift - log2 of bits per slot
+ */
+template <int Shift>
+struct CtrlMask {
+  uint64_t mask_;
+  inline explicit operator bool() const noexcept { return mask_ != 0; }
+  [[nodiscard]] inline uint_32_cx lowest() const noexcept {
+    return static_cast<uint_32_cx>(std::countr_zero(mask_)) >> Shift;
+  }
+  inline void pop() noexcept { mask_ &= mask_ - 1; }
+};
+
+/**
+ * A group of 16 control bytes loaded at once
+ */
+struct CtrlGroup {
+#if defined(CX_SSE2)
+  using Mask = CtrlMask<0>;
+  __m128i ctrl_;
+  inline explicit CtrlGroup(const ctrl_t* pos) noexcept
+      : ctrl_(_mm_load_si128(reinterpret_cast<const __m128i*>(pos))) {}
+  [[nodiscard]] inline Mask match(ctrl_t h2) const noexcept {
+    return {static_cast<uint64_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(static_cast<char>(h2)))))};
+  }
+  //empty and deleted are the only control bytes with the sign bit set
+  [[nodiscard]] inline Mask match_free() const noexcept {
+    return {static_cast<uint64_t>(_mm_movemask_epi8(ctrl_))};
+  }
+#elif defined(CX_NEON)
+  using Mask = CtrlMask<2>;
+  int8x16_t ctrl_;
+  inline explicit CtrlGroup(const ctrl_t* pos) noexcept : ctrl_(vld1q_s8(pos)) {}
+  inline static uint64_t to_mask(uint8x16_t eq) noexcept {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0) &
+           0x8888888888888888ULL;
+  }
+  [[nodiscard]] inline Mask match(ctrl_t h2) const noexcept {
+    return {to_mask(vceqq_s8(ctrl_, vdupq_n_s8(h2)))};
+  }
+  [[nodiscard]] inline Mask match_free() const noexcept {
+    return {to_mask(vcltq_s8(ctrl_, vdupq_n_s8(0)))};
+  }
+#else
+  using Mask = CtrlMask<0>;
+  ctrl_t ctrl_[kGroupWidth];
+  inline explicit CtrlGroup(const ctrl_t* pos) noexcept { std::memcpy(ctrl_, pos, kGroupWidth); }
+  [[nodiscard]] inline Mask match(ctrl_t h2) const noexcept {
+    uint64_t mask = 0;
+    for (uint_32_cx i = 0; i < kGroupWidth; i++) {
+      mask |= static_cast<uint64_t>(ctrl_[i] == h2) << i;
+    }
+    return {mask};
+  }
+  [[nodiscard]] inline Mask match_free() const noexcept {
+    uint64_t mask = 0;
+    for (uint_32_cx i = 0; i < kGroupWidth; i++) {
+      mask |= static_cast<uint64_t>(ctrl_[i] < 0) << i;
+    }
+    return {mask};
+  }
+#endif
+  [[nodiscard]] inline Mask match_empty() const noexcept { return match(kCtrlEmpty); }
+};
+/**
+ * Finalizer applied to hashes not marked as avalanching before they are split into group index and control byte.
+ * Protects against e.g. the identity std::hash for integers clustering all keys into one group
+ */
+inline uint64_t flat_mix(uint64_t h) noexcept {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>FlatHashMap</h2>
+ * An open addressing key-value store with the same interface as the HashMap, explicitly made to be swapped in.
+ * <br><br>
+ * Instead of chaining collisions into linked lists all keys and values are stored in two flat arrays.
+ * Next to them lives an array of one control byte per slot which is either empty, deleted or holds 7 bits of the keys hash.
+ * <br><br>
+ * A lookup checks a group of 16 control bytes in a single SIMD comparison and only compares keys where the 7 bits match.
+ * Collisions are resolved by moving on to the next group (triangular probing), so there is no pointer chasing and no allocation per element.
+ * <br><br>
+ * <b>Important:</b> Inserting or erasing invalidates references into the map.
+ *
+ * @tparam K key type
+ * @tparam V value type
+ * @tparam Hash hash function - ideally already well distributed
+ */
+template <typename K, typename V, typename Hash = cxstructs::hash<K>>
+class FlatHashMap {
+  constexpr static uint_32_cx npos = ~static_cast<uint_32_cx>(0);
+  alignas(kGroupWidth) constexpr static ctrl_t kEmptyGroup[kGroupWidth] = {
+      kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty,
+      kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty,
+      kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty};
+
+  using KeyAlloc = std::allocator<K>;
+  using ValAlloc = std::allocator<V>;
+  KeyAlloc key_alloc_;
+  ValAlloc val_alloc_;
+
+  uint_32_cx initialCapacity_;
+  uint_32_cx size_;
+  uint_32_cx capacity_;
+  uint_32_cx growth_left_;
+  float load_factor_;
+
+  ctrl_t* ctrl_;
+  K* keys_;
+  V* values_;
+  Hash hash_func_;
+
+  [[nodiscard]] inline static ctrl_t H2(uint64_t hash) noexcept {
+    return static_cast<ctrl_t>(hash & 0x7F);
+  }
+  [[nodiscard]] inline static uint64_t H1(uint64_t hash) noexcept { return hash >> 7; }
+  [[nodiscard]] inline uint64_t hash(const K& key) const {
+    if constexpr (is_avalanching<Hash>::value) {
+      return hash_func_(key);
+    } else {
+      return flat_mix(hash_func_(key));
+    }
+  }
+  [[nodiscard]] inline uint_32_cx group_mask() const noexcept {
+    return capacity_ == 0 ? 0 : capacity_ / kGroupWidth - 1;
+  }
+  [[nodiscard]] inline uint_32_cx max_load(uint_32_cx capacity) const noexcept {
+    // at least one slot, a tiny load factor would otherwise never let the table grow
+    return std::max<uint_32_cx>(1, static_cast<uint_32_cx>(capacity * load_factor_));
+  }
+
+  inline void allocate(uint_32_cx capacity) {
+    capacity_ = capacity;
+    ctrl_ = static_cast<ctrl_t*>(::operator new(capacity, std::align_val_t(kGroupWidth)));
+    std::memset(ctrl_, kCtrlEmpty, capacity);
+    keys_ = key_alloc_.allocate(capacity);
+    values_ = val_alloc_.allocate(capacity);
+    growth_left_ = max_load(capacity) - size_;
+  }
+  inline void destroy_all() noexcept {
+    if (capacity_ == 0) {
+      return;
+    }
+    if constexpr (!std::is_trivially_destructible_v<K> || !std::is_trivially_destructible_v<V>) {
+      for (uint_32_cx i = 0; i < capacity_; i++) {
+        if (ctrl_[i] >= 0) {
+          std::allocator_traits<KeyAlloc>::destroy(key_alloc_, &keys_[i]);
+          std::allocator_traits<ValAlloc>::destroy(val_alloc_, &values_[i]);
+        }
+      }
+    }
+    ::operator delete(ctrl_, std::align_val_t(kGroupWidth));
+    key_alloc_.deallocate(keys_, capacity_);
+    val_alloc_.deallocate(values_, capacity_);
+  }
+  inline void reset_empty() noexcept {
+    ctrl_ = const_cast<ctrl_t*>(kEmptyGroup);
+    keys_ = nullptr;
+    values_ = nullptr;
+    capacity_ = 0;
+    growth_left_ = 0;
+    size_ = 0;
+  }
+  /**
+   * Walks the probe sequence of the given hash until the key or an empty slot is found
+   * @return the slot index or npos
+   */
+  [[nodiscard]] inline uint_32_cx find_index(const K& key, uint64_t hash) const {
+    const ctrl_t h2 = H2(hash);
+    const uint_32_cx mask = group_mask();
+    uint_32_cx group = H1(hash) & mask;
+    for (uint_32_cx i = 1;; i++) {
+      const CtrlGroup g(ctrl_ + group * kGroupWidth);
+      for (auto m = g.match(h2); m; m.pop()) {
+        const uint_32_cx index = group * kGroupWidth + m.lowest();
+        if (keys_[index] == key) [[likely]] {
+          return index;
+        }
+      }
+      if (g.match_empty()) [[likely]] {
+        return npos;
+      }
+      group = (group + i) & mask;
+    }
+  }
+  /**
+   * @return the first empty or deleted slot in the probe sequence of the given hash
+   */
+  [[nodiscard]] inline uint_32_cx find_free(uint64_t hash) const noexcept {
+    const uint_32_cx mask = group_mask();
+    uint_32_cx group = H1(hash) & mask;
+    for (uint_32_cx i = 1;; i++) {
+      const auto m = CtrlGroup(ctrl_ + group * kGroupWidth).match_free();
+      if (m) {
+        return group * kGroupWidth + m.lowest();
+      }
+      group = (group + i) & mask;
+    }
+  }
+  inline void reHash(uint_32_cx new_capacity) {
+    ctrl_t* old_ctrl = ctrl_;
+    K* old_keys = keys_;
+    V* old_values = values_;
+    const uint_32_cx old_capacity = capacity_;
+
+    allocate(new_capacity);
+    for (uint_32_cx i = 0; i < old_capacity; i++) {
+      if (old_ctrl[i] >= 0) {
+        const uint64_t h = hash(old_keys[i]);
+        const uint_32_cx index = find_free(h);
+        ctrl_[index] = H2(h);
+        std::allocator_traits<KeyAlloc>::construct(key_alloc_, &keys_[index],
+                                                   std::move(old_keys[i]));
+        std::allocator_traits<ValAlloc>::construct(val_alloc_, &values_[index],
+                                                   std::move(old_values[i]));
+        std::allocator_traits<KeyAlloc>::destroy(key_alloc_, &old_keys[i]);
+        std::allocator_traits<ValAlloc>::destroy(val_alloc_, &old_values[i]);
+      }
+    }
+    if (old_capacity != 0) {
+      ::operator delete(old_ctrl, std::align_val_t(kGroupWidth));
+      key_alloc_.deallocate(old_keys, old_capacity);
+      val_alloc_.deallocate(old_values, old_capacity);
+    }
+  }
+  inline void reHashBig() {
+    // a table full of tombstones is cleaned at the same size instead of doubled
+    if (capacity_ != 0 && size_ < max_load(capacity_) / 2) {
+      reHash(capacity_);
+    } else {
+      uint_32_cx capacity = capacity_ == 0 ? initialCapacity_ : capacity_ * 2;
+      while (max_load(capacity) <= size_) {  // small load factors need more than one doubling
+        capacity *= 2;
+      }
+      reHash(capacity);
+    }
+  }
+  /**
+   * Places a new key into the table, the key must not be contained already
+   * @return the slot index
+   */
+  inline uint_32_cx emplace_new(uint64_t h, const K& key) {
+    uint_32_cx index = find_free(h);
+    if (growth_left_ == 0 && ctrl_[index] == kCtrlEmpty) {
+      reHashBig();
+      index = find_free(h);
+    }
+    growth_left_ -= ctrl_[index] == kCtrlEmpty;
+    ctrl_[index] = H2(h);
+    std::allocator_traits<KeyAlloc>::construct(key_alloc_, &keys_[index], key);
+    size_++;
+    return index;
+  }
+  inline static uint_32_cx fit_capacity(uint_32_cx capacity) noexcept {
+    return next_power_of_2(capacity < kGroupWidth ? kGroupWidth : capacity);
+  }
+
+ public:
+  explicit FlatHashMap(uint_32_cx initialCapacity = 64, float loadFactor = 0.875F)
+      : initialCapacity_(fit_capacity(initialCapacity)),
+        size_(0),
+        load_factor_(loadFactor > 0.875F ? 0.875F : loadFactor),
+        hash_func_(default_hash_func<Hash, K>()) {
+    allocate(initialCapacity_);
+  }
+  /**
+   * This constructor allows the user to supply their own hash function for the key type
+   * @param hash_function  this function is called with any given key with type K
+   * @param initialCapacity the initial size of the container and the growth size
+   * @param loadFactor the maximum fill ratio (capped at 0.875)
+   */
+  explicit FlatHashMap(Hash hash_function, uint_32_cx initialCapacity = 64,
+                       float loadFactor = 0.875F)
+      : initialCapacity_(fit_capacity(initialCapacity)),
+        size_(0),
+        load_factor_(loadFactor > 0.875F ? 0.875F : loadFactor),
+        hash_func_(std::move(hash_function)) {
+    allocate(initialCapacity_);
+  }
+  FlatHashMap(const FlatHashMap& o)
+      : initialCapacity_(o.initialCapacity_),
+        size_(0),
+        load_factor_(o.load_factor_),
+        hash_func_(o.hash_func_) {
+    if (o.capacity_ == 0) {
+      reset_empty();
+      return;
+    }
+    allocate(o.capacity_);
+    std::memcpy(ctrl_, o.ctrl_, capacity_);
+    for (uint_32_cx i = 0; i < capacity_; i++) {
+      if (ctrl_[i] >= 0) {
+        std::allocator_traits<KeyAlloc>::construct(key_alloc_, &keys_[i], o.keys_[i]);
+        std::allocator_traits<ValAlloc>::construct(val_alloc_, &values_[i], o.values_[i]);
+      }
+    }
+    size_ = o.size_;
+    growth_left_ = o.growth_left_;
+  }
+  FlatHashMap(FlatHashMap&& o) noexcept
+      : initialCapacity_(o.initialCapacity_),
+        size_(o.size_),
+        capacity_(o.capacity_),
+        growth_left_(o.growth_left_),
+        load_factor_(o.load_factor_),
+        ctrl_(o.ctrl_),
+        keys_(o.keys_),
+        values_(o.values_),
+        hash_func_(std::move(o.hash_func_)) {
+    o.reset_empty();
+  }
+  FlatHashMap& operator=(const FlatHashMap& o) {
+    if (this != &o) {
+      FlatHashMap copy(o);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+  FlatHashMap& operator=(FlatHashMap&& o) noexcept {
+    if (this != &o) {
+      destroy_all();
+
+      initialCapacity_ = o.initialCapacity_;
+      size_ = o.size_;
+      capacity_ = o.capacity_;
+      growth_left_ = o.growth_left_;
+      load_factor_ = o.load_factor_;
+      ctrl_ = o.ctrl_;
+      keys_ = o.keys_;
+      values_ = o.values_;
+      hash_func_ = std::move(o.hash_func_);
+
+      o.reset_empty();
+    }
+    return *this;
+  }
+  ~FlatHashMap() { destroy_all(); }
+  /**
+   * Sizes the table once so that n elements fit without any further rehashing
+   * @param n the number of elements to make room for
+   */
+  inline void reserve(uint_32_cx n) {
+    uint_32_cx capacity = capacity_ == 0 ? initialCapacity_ : capacity_;
+    while (max_load(capacity) < n) {
+      capacity <<= 1;
+    }
+    if (capacity > capacity_) {
+      reHash(capacity);
+    }
+  }
+  /**
+   * Retrieves the value for the given key<p>
+   * If the key doesnt exist a default constructed value is inserted
+   * @param key - the key to the value
+   * @return the value at this key
+   */
+  inline V& operator[](const K& key) {
+    const uint64_t h = hash(key);
+    uint_32_cx index = find_index(key, h);
+    if (index == npos) {
+      index = emplace_new(h, key);
+      std::allocator_traits<ValAlloc>::construct(val_alloc_, &values_[index]);
+    }
+    return values_[index];
+  }
+  /**
+   * Inserts a key, value Pair into the map<p>
+   * Replaces the value if the key already exists
+   * @param key - the key to access the stored element
+   * @param val - the stored value at the given key
+   */
+  inline void insert(const K& key, const V& val) {
+    const uint64_t h = hash(key);
+    const uint_32_cx index = find_index(key, h);
+    if (index != npos) {
+      values_[index] = val;
+      return;
+    }
+    const uint_32_cx new_index = emplace_new(h, key);
+    std::allocator_traits<ValAlloc>::construct(val_alloc_, &values_[new_index], val);
+  }
+  /**
+   * Retrieves the value for the given key <p>
+   * <b>Throws an std::out_of_range if the key doesnt exist</b>
+   * @param key - the key to the value
+   * @return the value at this key
+   */
+  [[nodiscard]] inline V& at(const K& key) const {
+    const uint_32_cx index = find_index(key, hash(key));
+    if (index == npos) {
+      throw std::out_of_range("no such key");
+    }
+    return values_[index];
+  }
+  /**
+   * Removes this key, value Pair from the map
+   * @param key - they key to be removed
+   */
+  inline void erase(const K& key) {
+    const uint_32_cx index = find_index(key, hash(key));
+    if (index == npos) {
+      return;
+    }
+    std::allocator_traits<KeyAlloc>::destroy(key_alloc_, &keys_[index]);
+    std::allocator_traits<ValAlloc>::destroy(val_alloc_, &values_[index]);
+    size_--;
+    // a group with an empty slot stops every probe, so no sequence can continue past it
+    if (CtrlGroup(ctrl_ + (index & ~(kGroupWidth - 1))).match_empty()) {
+      ctrl_[index] = kCtrlEmpty;
+      growth_left_++;
+    } else {
+      ctrl_[index] = kCtrlDeleted;
+    }
+  }
+  /**
+   * @brief Checks if the map contains a specific key.
+   *
+   * @param key The key to search for in the map.
+   * @return true if the key is present in the map, false otherwise.
+   */
+  [[nodiscard]] inline bool contains(const K& key) const {
+    return find_index(key, hash(key)) != npos;
+  }
+  /**
+   *
+   * @return the current n_elem of the map
+   */
+  [[nodiscard]] inline uint_32_cx size() const { return size_; }
+  [[nodiscard]] inline bool empty() const { return size_ == 0; }
+  /**
+   * @return the number of slots allocated
+   */
+  [[nodiscard]] inline uint_32_cx capacity() const { return capacity_; }
+  /**
+   * Walks all slots - load_factor is elements per slot, max_probe the most groups a lookup of a present key visits
+   * @return the heap memory of this map
+   */
+  [[nodiscard]] MemoryStats memory_stats() const {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * (sizeof(K) + sizeof(V));
+    if (capacity_ == 0) {
+      return stats;
+    }
+    stats.bytes_reserved = capacity_ * (sizeof(ctrl_t) + sizeof(K) + sizeof(V));
+    stats.blocks = 3;
+    stats.load_factor = static_cast<float>(size_) / static_cast<float>(capacity_);
+    const uint_32_cx mask = group_mask();
+    for (uint_32_cx index = 0; index < capacity_; index++) {
+      if (ctrl_[index] < 0) {
+        continue;
+      }
+      uint_32_cx group = H1(hash(keys_[index])) & mask;
+      uint_32_cx probe = 1;
+      while (group != index / kGroupWidth) {
+        group = (group + probe) & mask;
+        probe++;
+      }
+      stats.max_probe = std::max(stats.max_probe, probe);
+    }
+    return stats;
+  }
+  /**
+   * Clears the map of all its contents
+   */
+  inline void clear() {
+    destroy_all();
+    size_ = 0;
+    allocate(initialCapacity_);
+  }
+  /**
+   * Reduces the underlying arrays to the smallest power of two that fits the current size.
+   * Also removes all tombstones left behind by erase().
+   */
+  inline void shrink_to_fit() {
+    uint_32_cx capacity = kGroupWidth;
+    while (max_load(capacity) < size_ + 1) {
+      capacity <<= 1;
+    }
+    if (capacity < capacity_) {
+      reHash(capacity);
+    }
+  }
+  /**
+   * Calls the given function with every key, value pair in slot order
+   * @param func callable taking (const K&, V&)
+   */
+  template <typename Function>
+  inline void for_each(Function func) {
+    for (uint_32_cx i = 0; i < capacity_; i++) {
+      if (ctrl_[i] >= 0) {
+        func(static_cast<const K&>(keys_[i]), values_[i]);
+      }
+    }
+  }
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_FLATHASHMAP_H_
@@ -22,18 +22,38 @@
 #define CXSTRUCTS_SRC_CXSTRUCTS_HASHGRID_H_
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <span>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include "../cxconfig.h"
+#include "../cxutil/cxthreadpool.h"
+#include "soa_vec.h"
 
 namespace cxhelper {}  // namespace cxhelper
 
 namespace cxstructs {
 
+/**
+ * SPARSE keeps a hash map of cells and suits huge or mostly empty worlds.<p>
+ * DENSE keeps one flat array for all cells of the bounded world with the ids of each cell next to each other
+ */
+enum class GridMode : uint8_t { SPARSE, DENSE };
+
 /**
  * HashGrid for a square space
+ * <br><br>
+ * In DENSE mode insert() only appends to a list. The cells are (re)built from it with a counting sort on the
+ * next query or an explicit build(): one pass counts the entities per cell, a prefix sum gives the start of
+ * every cell and a second pass scatters the ids. There is no allocation per cell, so clearing and refilling
+ * the grid every frame costs two linear passes.<p>
+ * Once built, queries in DENSE mode dont modify the grid and can run from many threads at once.
+ * <br><br>
+ * Every cell also stores the positions of its entities, so radius and pair queries test the exact distance.
+ * <br><br>
+ * For many-core use fill the grid with build_parallel() and answer whole batches of queries with query_batch().
  */
 template <typename EntityID = uint32_t>
 struct HashGrid {
@@ -41,17 +61,211 @@ struct HashGrid {
   using GridID = size_type;
 
  private:
-  std::unordered_map<GridID, std::vector<EntityID>> map;
+  struct Cell {
+    std::vector<EntityID> ids;
+    std::vector<float> xs;
+    std::vector<float> ys;
+  };
+  // the entities of one cell as parallel arrays
+  struct CellView {
+    const EntityID* ids = nullptr;
+    const float* xs = nullptr;
+    const float* ys = nullptr;
+    size_type size = 0;
+  };
+  struct Entry {
+    float x, y;
+    GridID gID;
+    EntityID id;
+  };
+  std::unordered_map<GridID, Cell> map;
   float cellSize;
   size_type spaceSize;
   size_type gridSize;
+  GridMode mode;
+
+  // DENSE mode
+  std::vector<Entry> pending;        // every insert since the last clear()
+  std::vector<uint32_t> cellStart;   // cell c holds cellIDs[cellStart[c], cellStart[c + 1])
+  std::vector<uint32_t> cursor;      // write positions during the build
+  std::vector<EntityID> cellIDs;
+  std::vector<float> cellXs;
+  std::vector<float> cellYs;
+  bool dirty = false;
+
+  [[nodiscard]] inline CellView view(GridID gID) const noexcept {
+    if (mode == GridMode::DENSE) {
+      if (gID + 1 >= cellStart.size()) {
+        return {};
+      }
+      const uint32_t begin = cellStart[gID];
+      return {cellIDs.data() + begin, cellXs.data() + begin, cellYs.data() + begin,
+              cellStart[gID + 1] - begin};
+    }
+    const auto it = map.find(gID);  // dont create empty cells while searching
+    if (it == map.end()) {
+      return {};
+    }
+    const Cell& c = it->second;
+    return {c.ids.data(), c.xs.data(), c.ys.data(), static_cast<size_type>(c.ids.size())};
+  }
+  [[nodiscard]] inline CellView cell(GridID gID) {
+    if (dirty) {
+      build();
+    }
+    return view(gID);
+  }
+  // cell range [lo, hi] covering [low, high] on one axis, false if it misses the grid
+  [[nodiscard]] inline bool cellRange(float low, float high, size_type& lo,
+                                      size_type& hi) const noexcept {
+    const float first = std::floor(low / cellSize);
+    const float last = std::floor(high / cellSize);
+    if (last < 0 || first >= static_cast<float>(gridSize)) {
+      return false;
+    }
+    lo = first < 0 ? 0 : static_cast<size_type>(first);
+    hi = std::min(gridSize - 1, static_cast<size_type>(last));
+    return true;
+  }
+  inline void rectCollect(float x1, float y1, float x2, float y2,
+                          std::vector<EntityID>& outVec) const {
+    size_type cx1, cx2, cy1, cy2;
+    if (!cellRange(x1, x2, cx1, cx2) || !cellRange(y1, y2, cy1, cy2)) {
+      return;
+    }
+    for (size_type y = cy1; y <= cy2; ++y) {
+      for (size_type x = cx1; x <= cx2; ++x) {
+        const CellView c = view(x + y * gridSize);
+        outVec.insert(outVec.end(), c.ids, c.ids + c.size);
+      }
+    }
+  }
+  inline void radiusCollect(float x, float y, float r, std::vector<EntityID>& outVec) const {
+    size_type x1, x2, y1, y2;
+    if (!cellRange(x - r, x + r, x1, x2) || !cellRange(y - r, y + r, y1, y2)) {
+      return;
+    }
+    const float r2 = r * r;
+    for (size_type cy = y1; cy <= y2; ++cy) {
+      for (size_type cx = x1; cx <= x2; ++cx) {
+        const CellView c = view(cx + cy * gridSize);
+        for (size_type i = 0; i < c.size; i++) {
+          const float dx = c.xs[i] - x, dy = c.ys[i] - y;
+          if (dx * dx + dy * dy <= r2) {
+            outVec.push_back(c.ids[i]);
+          }
+        }
+      }
+    }
+  }
+  // answers the queries in contiguous chunks, each into its own buffer, then concatenates the buffers
+  template <typename Query, typename Collect>
+  inline void batch(std::span<const Query> queries, std::vector<EntityID>& out,
+                    std::vector<uint32_t>& offsets, uint_32_cx threads, Collect collect) {
+    if (dirty) {
+      build();
+    }
+    const uint_32_cx n = queries.size();
+    offsets.assign(n + 1, 0);
+    const uint_32_cx chunks = threads <= 1 || n == 0 ? 1 : std::min<uint_32_cx>(threads * 4, n);
+    const uint_32_cx per = (n + chunks - 1) / std::max<uint_32_cx>(chunks, 1);
+    std::vector<std::vector<EntityID>> buffers(chunks);
+    auto run = [&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_32_cx c = begin; c < end; c++) {
+        auto& buffer = buffers[c];
+        for (uint_32_cx q = c * per; q < std::min(n, (c + 1) * per); q++) {
+          const size_t before = buffer.size();
+          collect(queries[q], buffer);
+          offsets[q + 1] = buffer.size() - before;
+        }
+      }
+    };
+    if (chunks == 1) {
+      run(0, 1);
+    } else {
+      ThreadPool::global().parallel_for(0, chunks, run);
+    }
+    for (uint_32_cx q = 0; q < n; q++) {
+      offsets[q + 1] += offsets[q];
+    }
+    out.resize(offsets[n]);
+    auto copy = [&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_32_cx c = begin; c < end; c++) {
+        const uint_32_cx first = std::min(n, c * per);
+        std::copy(buffers[c].begin(), buffers[c].end(), out.begin() + offsets[first]);
+      }
+    };
+    if (chunks == 1) {
+      copy(0, 1);
+    } else {
+      ThreadPool::global().parallel_for(0, chunks, copy);
+    }
+  }
+  // pairs inside the cell and against the forward half of its neighbourhood
+  template <typename Callback>
+  inline void cellPairs(size_type cx, size_type cy, int reach, float r2, Callback& callback) const {
+    const CellView a = view(cx + cy * gridSize);
+    if (a.size == 0) {
+      return;
+    }
+    for (size_type i = 0; i < a.size; i++) {
+      for (size_type j = i + 1; j < a.size; j++) {
+        const float dx = a.xs[i] - a.xs[j], dy = a.ys[i] - a.ys[j];
+        if (dx * dx + dy * dy <= r2) {
+          callback(a.ids[i], a.ids[j]);
+        }
+      }
+    }
+    for (int oy = 0; oy <= reach; oy++) {
+      for (int ox = oy == 0 ? 1 : -reach; ox <= reach; ox++) {
+        const auto nx = static_cast<int64_t>(cx) + ox, ny = static_cast<int64_t>(cy) + oy;
+        if (nx < 0 || ny < 0 || nx >= static_cast<int64_t>(gridSize) ||
+            ny >= static_cast<int64_t>(gridSize)) {
+          continue;
+        }
+        const CellView b = view(static_cast<GridID>(nx + ny * gridSize));
+        for (size_type i = 0; i < a.size; i++) {
+          for (size_type j = 0; j < b.size; j++) {
+            const float dx = a.xs[i] - b.xs[j], dy = a.ys[i] - b.ys[j];
+            if (dx * dx + dy * dy <= r2) {
+              callback(a.ids[i], b.ids[j]);
+            }
+          }
+        }
+      }
+    }
+  }
+  inline void resetDense() {
+    if (mode == GridMode::DENSE) {
+      cellStart.assign(static_cast<size_t>(gridSize) * gridSize + 1, 0);
+      cursor.resize(static_cast<size_t>(gridSize) * gridSize);
+      dirty = !pending.empty();
+    }
+  }
 
  public:
+  struct RectQuery {
+    float x1, y1, x2, y2;
+  };
+  struct RadiusQuery {
+    float x, y, r;
+  };
   explicit HashGrid(float cellSize, size_type spaceSize, bool reserveUpfront = true)
+      : HashGrid(cellSize, spaceSize, GridMode::SPARSE, reserveUpfront) {}
+  /**
+   * @param cellSize the width and height of a cell
+   * @param spaceSize the width and height of the world
+   * @param mode SPARSE or DENSE backend
+   * @param reserveUpfront reserve the hash map in SPARSE mode
+   */
+  HashGrid(float cellSize, size_type spaceSize, GridMode mode, bool reserveUpfront = true)
       : cellSize(cellSize),
         spaceSize(spaceSize),
-        gridSize(static_cast<size_type>(spaceSize / cellSize)) {
-    if (reserveUpfront) {
+        gridSize(static_cast<size_type>(std::ceil(spaceSize / cellSize))),
+        mode(mode) {
+    if (mode == GridMode::DENSE) {
+      resetDense();
+    } else if (reserveUpfront) {
       map.reserve(gridSize);
     }
   };
@@ -64,58 +278,303 @@ struct HashGrid {
   [[nodiscard]] inline GridID getGridID(float x, float y) const noexcept {
     return static_cast<int>(x / cellSize) + static_cast<int>(y / cellSize) * gridSize;
   }
+  [[nodiscard]] inline GridMode getMode() const noexcept { return mode; }
+  [[nodiscard]] inline size_type getGridSize() const noexcept { return gridSize; }
   inline void clear() {
+    if (mode == GridMode::DENSE) {
+      pending.clear();
+      std::fill(cellStart.begin(), cellStart.end(), 0);
+      cellIDs.clear();
+      cellXs.clear();
+      cellYs.clear();
+      dirty = false;
+      return;
+    }
     for (auto& pair : map) {
-      pair.second.clear();
+      pair.second.ids.clear();
+      pair.second.xs.clear();
+      pair.second.ys.clear();
     }
   };
   inline void setupNew(float newCellSize, uint_16_cx newSpaceSize, bool optimized = true) {
     if (optimized) {
       float value = cellSize / spaceSize;
       cellSize = newSpaceSize * value;
-      map.reserve(std::pow(spaceSize / cellSize, 2));
+      spaceSize = newSpaceSize;
     } else {
       cellSize = newCellSize;
       spaceSize = newSpaceSize;
     }
+    gridSize = static_cast<size_type>(std::ceil(spaceSize / cellSize));
     map.clear();
+    pending.clear();
+    cellIDs.clear();
+    cellXs.clear();
+    cellYs.clear();
+    if (mode == GridMode::DENSE) {
+      resetDense();
+    } else if (optimized) {
+      map.reserve(gridSize * gridSize);
+    }
   };
   inline void insert(float x, float y, EntityID entityID) {
     CX_ASSERT(x < spaceSize && y < spaceSize, "x or y is larger than spaceSize");
-    map[getGridID(x, y)].emplace_back(entityID);
+    if (mode == GridMode::DENSE) {
+      pending.push_back({x, y, getGridID(x, y), entityID});
+      dirty = true;
+      return;
+    }
+    Cell& c = map[getGridID(x, y)];
+    c.ids.emplace_back(entityID);
+    c.xs.emplace_back(x);
+    c.ys.emplace_back(y);
   };
+  /**
+   * DENSE mode: sorts all inserted entities into their cells - called by the first query after an insert.
+   * Call it directly to build outside of the queries, e.g. before querying from many threads
+   */
+  inline void build() {
+    if (mode != GridMode::DENSE) {
+      return;
+    }
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (const auto& entry : pending) {
+      cellStart[entry.gID + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) {
+      cellStart[c] += cellStart[c - 1];
+    }
+    std::copy(cellStart.begin(), cellStart.end() - 1, cursor.begin());
+    cellIDs.resize(pending.size());
+    cellXs.resize(pending.size());
+    cellYs.resize(pending.size());
+    for (const auto& entry : pending) {
+      const uint32_t pos = cursor[entry.gID]++;
+      cellIDs[pos] = entry.id;
+      cellXs[pos] = entry.x;
+      cellYs[pos] = entry.y;
+    }
+    dirty = false;
+  }
+  /**
+   * Replaces the contents of the grid with the given entities.<p>
+   * DENSE mode: the positions are split into one range per thread. Each range counts its entities per cell
+   * into its own histogram, a prefix sum over all histograms (cell major, thread minor) gives every range its
+   * write offset inside each cell and the ranges then scatter without any synchronization. The cell order is
+   * the same as with insert() + build(). The histograms take threads * cells counters.<p>
+   * SPARSE mode inserts one by one as the hash map cant be written concurrently
+   * @param positions the (x, y) of each entity
+   * @param ids the id of each entity - if empty the index into positions is used
+   * @param threads number of threads
+   */
+  inline void build_parallel(std::span<const std::pair<float, float>> positions,
+                             std::span<const EntityID> ids = {}, uint_32_cx threads = 1) {
+    build_parallel(
+        positions.size(), [positions](size_t i) { return positions[i]; }, ids, threads);
+  }
+  /**
+   * Same as build_parallel() with the coordinates in separate arrays, e.g. the x and y fields of a soa_vec:
+   * <pre>grid.build_parallel(points.get<0>(), points.get<1>(), {}, threads);</pre>
+   * @param xs the x of each entity
+   * @param ys the y of each entity
+   * @param ids the id of each entity - if empty the index is used
+   * @param threads number of threads
+   */
+  inline void build_parallel(std::span<const float> xs, std::span<const float> ys,
+                             std::span<const EntityID> ids = {}, uint_32_cx threads = 1) {
+    CX_ASSERT(xs.size() == ys.size(), "one y per x");
+    build_parallel(
+        xs.size(), [xs, ys](size_t i) { return std::pair<float, float>(xs[i], ys[i]); }, ids,
+        threads);
+  }
+
+ private:
+  template <typename PositionOf>
+  inline void build_parallel(size_t n, PositionOf positionOf, std::span<const EntityID> ids,
+                             uint_32_cx threads) {
+    CX_ASSERT(ids.empty() || ids.size() == n, "one id per position");
+    clear();
+    auto idOf = [&](size_t i) { return ids.empty() ? static_cast<EntityID>(i) : ids[i]; };
+    if (mode != GridMode::DENSE) {
+      for (size_t i = 0; i < n; i++) {
+        const auto [x, y] = positionOf(i);
+        insert(x, y, idOf(i));
+      }
+      return;
+    }
+    const size_t cells = static_cast<size_t>(gridSize) * gridSize;
+    const uint_32_cx ranges = std::max<uint_32_cx>(1, std::min<uint_32_cx>(threads, n / 1024 + 1));
+    const size_t per = (n + ranges - 1) / ranges;
+    std::vector<uint32_t> histograms(ranges * cells, 0);
+    pending.resize(n);
+    cellIDs.resize(n);
+    cellXs.resize(n);
+    cellYs.resize(n);
+
+    auto forRanges = [&](auto&& func) {
+      if (ranges == 1) {
+        func(0, 1);
+      } else {
+        ThreadPool::global().parallel_for(0, ranges, func);
+      }
+    };
+    forRanges([&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_32_cx t = begin; t < end; t++) {
+        uint32_t* histogram = histograms.data() + t * cells;
+        for (size_t i = t * per; i < std::min(n, (t + 1) * per); i++) {
+          const auto [x, y] = positionOf(i);
+          CX_ASSERT(x < spaceSize && y < spaceSize, "x or y is larger than spaceSize");
+          const GridID gID = getGridID(x, y);
+          pending[i] = {x, y, gID, idOf(i)};
+          histogram[gID]++;
+        }
+      }
+    });
+    uint32_t sum = 0;
+    for (size_t c = 0; c < cells; c++) {
+      cellStart[c] = sum;
+      for (uint_32_cx t = 0; t < ranges; t++) {
+        const uint32_t count = histograms[t * cells + c];
+        histograms[t * cells + c] = sum;  // now the write offset of range t
+        sum += count;
+      }
+    }
+    cellStart[cells] = sum;
+    forRanges([&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_32_cx t = begin; t < end; t++) {
+        uint32_t* offset = histograms.data() + t * cells;
+        for (size_t i = t * per; i < std::min(n, (t + 1) * per); i++) {
+          const Entry& entry = pending[i];
+          const uint32_t pos = offset[entry.gID]++;
+          cellIDs[pos] = entry.id;
+          cellXs[pos] = entry.x;
+          cellYs[pos] = entry.y;
+        }
+      }
+    });
+    dirty = false;
+  }
+
+ public:
+  /**
+   * @return the ids in the given cell - valid until the next insert, build or clear
+   */
+  [[nodiscard]] inline std::span<const EntityID> getCell(GridID gID) {
+    const CellView c = cell(gID);
+    return {c.ids, c.size};
+  }
 
   inline bool containedInCell(float x, float y, EntityID eID) noexcept {
     CX_ASSERT(x < spaceSize && y < spaceSize, "x or y is larger than spaceSize");
-    const auto& vec = map[getGridID(x, y)];
-    return std::find(vec.begin(), vec.end(), eID) != vec.end();
+    return containedInCell(getGridID(x, y), eID);
   }
 
   inline bool containedInCell(GridID gID, EntityID eID) noexcept {
-    const auto& vec = map[gID];
-    return std::find(vec.begin(), vec.end(), eID) != vec.end();
+    const CellView c = cell(gID);
+    return std::find(c.ids, c.ids + c.size, eID) != c.ids + c.size;
   }
 
   inline void containedInRectCollect(float x1, float y1, float x2, float y2,
                                      std::vector<EntityID>& outVec) noexcept {
     CX_ASSERT(x1 < spaceSize && y1 < spaceSize, "x or y is larger than spaceSize");
     CX_ASSERT(x2 < spaceSize && y2 < spaceSize, "x or y is larger than spaceSize");
-    auto topLeftX = static_cast<size_type>(x1 / cellSize);
-    auto topLeftY = static_cast<size_type>(y1 / cellSize);
-    auto bottomRightX = static_cast<size_type>(x2 / cellSize);
-    auto bottomRightY = static_cast<size_type>(y2 / cellSize);
-
-    for (size_type x = topLeftX; x <= bottomRightX; ++x) {
-      for (size_type y = topLeftY; y <= bottomRightY; ++y) {
-        const auto& vec = map[x + y * gridSize];
-        outVec.insert(outVec.end(), vec.begin(), vec.end());
+    if (dirty) {
+      build();
+    }
+    rectCollect(x1, y1, x2, y2, outVec);
+  }
+  /**
+   * Appends all entities within distance r of (x, y) to outVec
+   * @param x x-coordinate of the center
+   * @param y y-coordinate of the center
+   * @param r the radius - points exactly at distance r are included
+   * @param outVec the ids are appended
+   */
+  inline void query_radius(float x, float y, float r, std::vector<EntityID>& outVec) {
+    if (dirty) {
+      build();
+    }
+    radiusCollect(x, y, r, outVec);
+  }
+  /**
+   * Answers many rect queries at once, with the same result per query as containedInRectCollect().<p>
+   * The ids of query i end up in out[offsets[i], offsets[i + 1])
+   * @param queries the rects as (x1, y1, x2, y2)
+   * @param out overwritten with the ids of all queries
+   * @param offsets overwritten with queries.size() + 1 offsets into out
+   * @param threads number of threads
+   */
+  inline void query_batch(std::span<const RectQuery> queries, std::vector<EntityID>& out,
+                          std::vector<uint32_t>& offsets, uint_32_cx threads = 1) {
+    batch(queries, out, offsets, threads, [this](const RectQuery& q, std::vector<EntityID>& buffer) {
+      rectCollect(q.x1, q.y1, q.x2, q.y2, buffer);
+    });
+  }
+  /**
+   * Answers many radius queries at once, with the same result per query as query_radius().<p>
+   * The ids of query i end up in out[offsets[i], offsets[i + 1])
+   * @param queries the circles as (x, y, r)
+   * @param out overwritten with the ids of all queries
+   * @param offsets overwritten with queries.size() + 1 offsets into out
+   * @param threads number of threads
+   */
+  inline void query_batch(std::span<const RadiusQuery> queries, std::vector<EntityID>& out,
+                          std::vector<uint32_t>& offsets, uint_32_cx threads = 1) {
+    batch(queries, out, offsets, threads, [this](const RadiusQuery& q, std::vector<EntityID>& buffer) {
+      radiusCollect(q.x, q.y, q.r, buffer);
+    });
+  }
+  /**
+   * Calls callback(EntityID a, EntityID b) exactly once for every unordered pair of entities within distance r.<p>
+   * Each cell is checked against itself and the forward half of its neighbours (the rest of its row to the right
+   * and the rows below), so no pair is seen twice and no dedup is needed.<p>
+   * With threads > 1 the cell rows are distributed over the global ThreadPool - the callback is then called
+   * concurrently and has to be thread safe
+   * @param r the distance - pairs exactly at distance r are included
+   * @param callback callable taking (EntityID, EntityID)
+   * @param threads number of threads
+   */
+  template <typename Callback>
+  inline void for_each_neighbour_pair(float r, Callback callback, uint_32_cx threads = 1) {
+    if (dirty) {
+      build();
+    }
+    const int reach = std::max(1, static_cast<int>(std::ceil(r / cellSize)));
+    const float r2 = r * r;
+    if (mode == GridMode::DENSE) {
+      auto rows = [&](uint_32_cx begin, uint_32_cx end) {
+        for (size_type cy = begin; cy < end; cy++) {
+          for (size_type cx = 0; cx < gridSize; cx++) {
+            cellPairs(cx, cy, reach, r2, callback);
+          }
+        }
+      };
+      if (threads <= 1) {
+        rows(0, gridSize);
+      } else {
+        ThreadPool::global().parallel_for(0, gridSize, rows);
+      }
+      return;
+    }
+    std::vector<GridID> used;  // only visit cells that exist
+    used.reserve(map.size());
+    for (const auto& pair : map) {
+      if (!pair.second.ids.empty()) {
+        used.push_back(pair.first);
       }
     }
+    auto cells = [&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_32_cx i = begin; i < end; i++) {
+        cellPairs(used[i] % gridSize, used[i] / gridSize, reach, r2, callback);
+      }
+    };
+    if (threads <= 1) {
+      cells(0, used.size());
+    } else {
+      ThreadPool::global().parallel_for(0, used.size(), cells);
+    }
   }
 
-
-  inline bool isCloseTo(float cellRadius) {}
-
 };
 
 }  // namespace cxstructs
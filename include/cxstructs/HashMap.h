@@ -21,13 +21,19 @@
 #ifndef CXSTRUCTS_HASHMAP_H
 #define CXSTRUCTS_HASHMAP_H
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <functional>
+#include <iterator>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
 #include "../cxalgos/MathFunctions.h"
 #include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+#include "BloomFilter.h"
 #include "Pair.h"
 
 // HashMap implementation using constant stack arrays as buffer and linked lists
@@ -129,6 +135,22 @@ struct HashLinkedList {
     }
     throw std::out_of_range("no such key");
   }
+  inline V* find(const K& key) {
+    for (uint_16_cx i = 0; i < ArrayLength; i++) {
+      if (data_[i].assigned() && data_[i].first() == key) {
+        return &data_[i].second();
+      }
+    }
+
+    HListNode* current = head_;
+    while (current != nullptr) {
+      if (current->key_ == key) {
+        return &current->value_;
+      }
+      current = current->next_;
+    }
+    return nullptr;
+  }
   inline bool replaceAdd(const K& key, const V& val) {
     for (int i = 0; i < ArrayLength; i++) {
       if (data_[i].assigned() && data_[i].first() == key) {
@@ -160,6 +182,24 @@ struct HashLinkedList {
     }
     return true;
   }
+  //appends a key that is known to be unique, skipping the search
+  inline void add(const K& key, const V& val) {
+    for (uint_16_cx i = 0; i < ArrayLength; i++) {
+      if (!data_[i].assigned()) {
+        data_[i].assigned() = true;
+        data_[i].first() = key;
+        data_[i].second() = val;
+        return;
+      }
+    }
+    if (head_ == nullptr) {
+      head_ = new HListNode(key, val);
+      end_ = head_;
+    } else {
+      end_->next_ = new HListNode(key, val);
+      end_ = end_->next_;
+    }
+  }
   inline bool remove(const K& key) {
     for (uint_16_cx i = 0; i < ArrayLength; i++) {
       if (data_[i].assigned() && data_[i].first() == key) {
@@ -222,17 +262,22 @@ using namespace cxhelper;
  * This data structure is an efficient key-value store, typically providing lookups in constant time (O(1)).
  * <br><br>
  * <b>Important:</b> For non-primitive and non-string types, a custom hash function is recommended.
+ * The default cxstructs::hash is stateless and inlined, to use a runtime hash function pass std::function as Hash.
  * <br><br>
  * A HashMap is notably beneficial due to its speed and ease of use. Hashing keys to numerical indices allows for quick value retrieval from the underlying array.
  * <br><br>
  * A hash function can sometimes create a similar output for the same input which is a collision. One way to combat this is called separate chaining.
  * Separate chaining is a technique to handle hash collisions by using LinkedLists as buckets and simply appending the element to the end of this list.
  * This means that each bucket-array index hosts a linked list that is traversed to locate the correct key as the key is still unique (same keys are replaced).
+ * <br><br>
+ * The Filter policy sits in front of the buckets: with BloomFilter<> a lookup of an absent key is mostly answered
+ * by one filter block instead of a walk through the bucket.
  */
 
-template <typename K, typename V, typename Hash = std::function<size_t(const K&)>>
+template <typename K, typename V, typename Hash = cxstructs::hash<K>, typename Filter = cxhelper::NoFilter>
 class HashMap {
   constexpr static uint_16_cx BufferLen = 1;
+  constexpr static uint_32_cx kBulkBatch = 32;
   using HList = HashLinkedList<K, V, BufferLen>;
 
   uint_32_cx initialCapacity_;
@@ -243,53 +288,66 @@ class HashMap {
 
   HList* arr_;
   Hash hash_func_;
+  Filter filter_;
+  // number of erased keys still set in the filter
+  uint_32_cx erased_ = 0;
 
-  inline void reHashBig() {
-    // once the n_elem limit is reached all values needs to be rehashed to fit to the keys with the new bucket n_elem
+  inline void reHash(uint_32_cx newBuckets) {
+    // all values needs to be rehashed to fit to the keys with the new bucket n_elem
     auto oldBuckets = buckets_;
-    buckets_ <<= 1;
+    buckets_ = newBuckets;
     auto* newArr = new HList[buckets_];
+    maxSize = buckets_ * load_factor_;
+    filter_.reset(maxSize);
+    erased_ = 0;
 
-    for (int i = 0; i < oldBuckets; i++) {
+    for (uint_32_cx i = 0; i < oldBuckets; i++) {
       const auto data = arr_[i].data_;
       for (uint_fast32_t j = 0; j < BufferLen; j++) {
         if (data[j].assigned()) {
-          size_t hash = hash_func_(data[j].first()) & (buckets_ - 1);
-          newArr[hash].replaceAdd(data[j].first(), data[j].second());
+          const size_t hash = hash_func_(data[j].first());
+          filter_.insert_hash(hash);
+          newArr[hash & (buckets_ - 1)].add(data[j].first(), data[j].second());
         }
       }
       HashListNode<K, V>* current = arr_[i].head_;
       while (current) {
-        size_t hash = hash_func_(current->key_) & (buckets_ - 1);
-        newArr[hash].replaceAdd(current->key_, current->value_);
+        const size_t hash = hash_func_(current->key_);
+        filter_.insert_hash(hash);
+        newArr[hash & (buckets_ - 1)].add(current->key_, current->value_);
         current = current->next_;
       }
     }
     delete[] arr_;
     arr_ = newArr;
-    maxSize = buckets_ * load_factor_;
   }
-  inline void reHashSmall() {
-    //only used in shrink_to_fit()
-    auto oldBuckets = buckets_;
-    buckets_ = size_ * 1.5;
-    auto* newArr = new HList[buckets_];
-
-    for (int i = 0; i < oldBuckets; i++) {
+  // once the n_elem limit is reached the buckets are doubled
+  inline void reHashBig() { reHash(buckets_ << 1); }
+  //only used in shrink_to_fit()
+  inline void reHashSmall() { reHash(size_ * 1.5); }
+  // erased keys stay in the filter, it is rebuilt once they reach half of maxSize
+  inline void count_erased(uint_32_cx n) {
+    if constexpr (Filter::enabled) {
+      erased_ += n;
+      if (erased_ > maxSize / 2) {
+        reHash(buckets_);
+      }
+    }
+  }
+  // calls func(bucket, key, value) in bucket order, the order snapshots are written in
+  template <typename Function>
+  inline void for_each_bucket_entry(Function func) const {
+    for (uint_32_cx i = 0; i < buckets_; i++) {
+      auto& data = arr_[i].data_;
       for (uint_fast32_t j = 0; j < BufferLen; j++) {
-        size_t hash = hash_func_(arr_[i].data_[j].first()) & (buckets_ - 1);
-        newArr[hash].replaceAdd(arr_[i].data_[j].first(), arr_[i].data_[j].second());
+        if (data[j].assigned()) {
+          func(i, data[j].first(), data[j].second());
+        }
       }
-      HashListNode<K, V>* current = arr_[i].head_;
-      while (current) {
-        size_t hash = hash_func_(current->key_) & (buckets_ - 1);
-        newArr[hash].replaceAdd(current->key_, current->value_);
-        current = current->next_;
+      for (auto* current = arr_[i].head_; current; current = current->next_) {
+        func(i, current->key_, current->value_);
       }
     }
-    delete[] arr_;
-    arr_ = newArr;
-    maxSize = buckets_ * load_factor_;
   }
 
  public:
@@ -299,8 +357,10 @@ class HashMap {
         size_(0),
         arr_(new HList[next_power_of_2(initialCapacity)]),
         maxSize(next_power_of_2(initialCapacity) * loadFactor),
-        hash_func_(std::hash<K>()),
-        load_factor_(loadFactor) {}
+        hash_func_(default_hash_func<Hash, K>()),
+        load_factor_(loadFactor) {
+    filter_.reset(maxSize);
+  }
   /**
    * This constructor allows the user to supply their own hash function for the key type
    * @tparam HashFunction callable that takes a key with type V and returns int
@@ -315,31 +375,37 @@ class HashMap {
         arr_(new HList[next_power_of_2(initialCapacity)]),
         maxSize(next_power_of_2(initialCapacity) * loadFactor),
         hash_func_(hash_function),
-        load_factor_(loadFactor) {}
-  HashMap(const HashMap<K, V>& o)
+        load_factor_(loadFactor) {
+    filter_.reset(maxSize);
+  }
+  HashMap(const HashMap& o)
       : initialCapacity_(o.initialCapacity_),
         size_(o.size_),
         buckets_(o.buckets_),
-        hash_func_(o.hash_func_),
         maxSize(o.maxSize),
-        load_factor_(o.load_factor_) {
+        load_factor_(o.load_factor_),
+        hash_func_(o.hash_func_),
+        filter_(o.filter_),
+        erased_(o.erased_) {
     arr_ = new HList[buckets_];
     for (uint_32_cx i = 0; i < buckets_; i++) {
       arr_[i] = o.arr_[i];
     }
   }
-  HashMap(HashMap<K, V>&& o) noexcept
+  HashMap(HashMap&& o) noexcept
       : initialCapacity_(o.initialCapacity_),
         size_(o.size_),
         buckets_(o.buckets_),
-        hash_func_(std::move(o.hash_func_)),
         maxSize(o.maxSize),
         load_factor_(o.load_factor_),
-        arr_(o.arr_) {
+        arr_(o.arr_),
+        hash_func_(std::move(o.hash_func_)),
+        filter_(std::move(o.filter_)),
+        erased_(o.erased_) {
     o.arr_ = nullptr;
     o.size_ = 0;
   }
-  HashMap& operator=(const HashMap<K, V>& o) {
+  HashMap& operator=(const HashMap& o) {
     if (this != &o) {
       delete[] arr_;
 
@@ -347,6 +413,8 @@ class HashMap {
       size_ = o.size_;
       buckets_ = o.buckets_;
       hash_func_ = o.hash_func_;
+      filter_ = o.filter_;
+      erased_ = o.erased_;
       maxSize = o.maxSize;
 
       arr_ = new HList[buckets_];
@@ -356,7 +424,7 @@ class HashMap {
     }
     return *this;
   }
-  HashMap& operator=(HashMap<K, V>&& o) noexcept {
+  HashMap& operator=(HashMap&& o) noexcept {
     if (this != &o) {
       delete[] arr_;
 
@@ -364,6 +432,8 @@ class HashMap {
       size_ = o.size_;
       buckets_ = o.buckets_;
       hash_func_ = std::move(o.hash_func_);
+      filter_ = std::move(o.filter_);
+      erased_ = o.erased_;
       maxSize = o.maxSize;
       arr_ = o.arr_;
 
@@ -389,7 +459,95 @@ class HashMap {
     if (size_ > maxSize) {
       reHashBig();
     }
-    size_ += arr_[hash_func_(key) & (buckets_ - 1)].replaceAdd(key, val);
+    const size_t hash = hash_func_(key);
+    if (arr_[hash & (buckets_ - 1)].replaceAdd(key, val)) {
+      filter_.insert_hash(hash);
+      size_++;
+    }
+  }
+  /**
+   * Sizes the bucket array once so that n elements fit without any further rehashing
+   * @param n the number of elements to make room for
+   */
+  inline void reserve(uint_32_cx n) {
+    const auto needed = next_power_of_2(static_cast<uint_32_cx>(n / load_factor_) + 1);
+    if (needed > buckets_) {
+      reHash(needed);
+    }
+  }
+  /**
+   * Inserts all key, value pairs of the given range<p>
+   * Reserves space for the whole range up front, then hashes a batch of keys and prefetches
+   * their buckets before placing them, so the cache misses overlap
+   * @param first iterator to the first pair (anything with .first and .second e.g. std::pair)
+   * @param last iterator past the last pair
+   */
+  template <typename It>
+  inline void insert_bulk(It first, It last) {
+    static_assert(std::forward_iterator<It>, "insert_bulk needs forward iterators");
+    reserve(size_ + static_cast<uint_32_cx>(std::distance(first, last)));
+    size_t hashes[kBulkBatch];
+    while (first != last) {
+      It it = first;
+      uint_32_cx n = 0;
+      for (; n < kBulkBatch && first != last; ++first, ++n) {
+        hashes[n] = hash_func_(first->first);
+        CX_PREFETCH(&arr_[hashes[n] & (buckets_ - 1)]);
+      }
+      for (uint_32_cx i = 0; i < n; ++i, ++it) {
+        if (arr_[hashes[i] & (buckets_ - 1)].replaceAdd(it->first, it->second)) {
+          filter_.insert_hash(hashes[i]);
+          size_++;
+        }
+      }
+    }
+  }
+  /**
+   * Inserts n key, value pairs from two parallel arrays
+   * @param keys pointer to the keys
+   * @param values pointer to the values
+   * @param n number of pairs
+   */
+  inline void insert_bulk(const K* keys, const V* values, uint_32_cx n) {
+    reserve(size_ + n);
+    size_t hashes[kBulkBatch];
+    for (uint_32_cx start = 0; start < n; start += kBulkBatch) {
+      const uint_32_cx end = std::min(n, start + kBulkBatch);
+      for (uint_32_cx i = start; i < end; i++) {
+        hashes[i - start] = hash_func_(keys[i]);
+        CX_PREFETCH(&arr_[hashes[i - start] & (buckets_ - 1)]);
+      }
+      for (uint_32_cx i = start; i < end; i++) {
+        if (arr_[hashes[i - start] & (buckets_ - 1)].replaceAdd(keys[i], values[i])) {
+          filter_.insert_hash(hashes[i - start]);
+          size_++;
+        }
+      }
+    }
+  }
+  /**
+   * Removes all keys of the given range from the map<p>
+   * Keys are hashed and their buckets prefetched in batches, just like insert_bulk
+   * @param first iterator to the first key
+   * @param last iterator past the last key
+   */
+  template <typename It>
+  inline void erase_bulk(It first, It last) {
+    static_assert(std::forward_iterator<It>, "erase_bulk needs forward iterators");
+    const auto before = size_;
+    size_t hashes[kBulkBatch];
+    while (first != last) {
+      It it = first;
+      uint_32_cx n = 0;
+      for (; n < kBulkBatch && first != last; ++first, ++n) {
+        hashes[n] = hash_func_(*first) & (buckets_ - 1);
+        CX_PREFETCH(&arr_[hashes[n]]);
+      }
+      for (uint_32_cx i = 0; i < n; ++i, ++it) {
+        size_ -= arr_[hashes[i]].remove(*it);
+      }
+    }
+    count_erased(before - size_);
   }
   /**
    * Retrieves the value for the given key <p>
@@ -405,9 +563,10 @@ class HashMap {
    * @param key - they key to be removed
    */
   inline void erase(const K& key) {
-    size_t hash = hash_func_(key) & (buckets_ - 1);
-    size_ -= arr_[hash].remove(key);
+    const bool removed = arr_[hash_func_(key) & (buckets_ - 1)].remove(key);
+    size_ -= removed;
     CX_ASSERT(size_ >= 0, "no such element to erase");
+    count_erased(removed);
   }
   /**
    *
@@ -419,6 +578,125 @@ class HashMap {
    * @return the initial capacity
    */
   [[nodiscard]] inline uint_32_cx capacity() const { return buckets_; }
+  /**
+   * Walks all buckets - load_factor is elements per bucket, max_probe the longest bucket chain
+   * @return the heap memory of this map
+   */
+  [[nodiscard]] MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * (sizeof(K) + sizeof(V));
+    stats.bytes_reserved = buckets_ * sizeof(HList);
+    stats.blocks = 1;
+    for (uint_32_cx i = 0; i < buckets_; i++) {
+      uint_32_cx chain = 0;
+      for (uint_16_cx j = 0; j < BufferLen; j++) {
+        chain += arr_[i].data_[j].assigned();
+      }
+      for (auto node = arr_[i].head_; node; node = node->next_) {
+        chain++;
+        stats.blocks++;
+        stats.bytes_reserved += sizeof(HashListNode<K, V>);
+      }
+      stats.max_probe = std::max(stats.max_probe, chain);
+    }
+    stats.bytes_reserved += filter_.memory_usage();
+    stats.load_factor = buckets_ ? static_cast<float>(size_) / static_cast<float>(buckets_) : 0;
+    return stats;
+  }
+  /**
+   * Writes the map into a snapshot keeping its bucket layout - see cxsnapshot.h<p>
+   * Each bucket becomes a range in one key (and value) array, found through a table of offsets.
+   * Trivially copyable keys and values are stored as raw arrays, std::string with its length
+   * @param writer a SnapshotWriter
+   */
+  template <typename Writer>
+  void save_snapshot(Writer& writer) const {
+    constexpr bool raw = std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>;
+    writer.begin("hashmap", 1, sizeof(K) + sizeof(V), size_);
+    writer.write_value(static_cast<uint64_t>(buckets_));
+    std::vector<uint64_t> offsets(buckets_ + 1, 0);
+    for_each_bucket_entry([&](uint_32_cx bucket, const K&, const V&) { offsets[bucket + 1]++; });
+    for (uint_32_cx i = 0; i < buckets_; i++) {
+      offsets[i + 1] += offsets[i];
+    }
+    writer.write_array(offsets.data(), offsets.size());
+    if constexpr (raw) {
+      std::vector<K> keys;
+      std::vector<V> values;
+      keys.reserve(size_);
+      values.reserve(size_);
+      for_each_bucket_entry([&](uint_32_cx, const K& key, const V& value) {
+        keys.push_back(key);
+        values.push_back(value);
+      });
+      writer.write_array(keys.data(), keys.size());
+      writer.write_array(values.data(), values.size());
+    } else {
+      for_each_bucket_entry([&](uint_32_cx, const K& key, const V& value) {
+        writer.write_item(key);
+        writer.write_item(value);
+      });
+    }
+    writer.end();
+  }
+  /**
+   * Replaces the contents with the next snapshot section.<p>
+   * The pairs go straight into their saved buckets - nothing is hashed or searched, so the map has to use
+   * the same hash function as the one that was saved
+   * @param reader a SnapshotReader
+   * @return false if the section doesnt hold a map of this type
+   */
+  template <typename Reader>
+  bool load_snapshot(Reader& reader) {
+    constexpr bool raw = std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>;
+    uint64_t n = 0, buckets = 0;
+    if (!reader.begin("hashmap", 1, sizeof(K) + sizeof(V), n) || !reader.read_value(buckets) || buckets == 0 ||
+        (buckets & (buckets - 1)) != 0 || buckets > (1ULL << 31) || n > (1ULL << 32)) {
+      return false;
+    }
+    const uint64_t* offsets = reader.template read_array<uint64_t>(buckets + 1);
+    if (!offsets || offsets[0] != 0 || offsets[buckets] != n ||
+        !std::is_sorted(offsets, offsets + buckets + 1)) {
+      return false;
+    }
+    const K* keys = nullptr;
+    const V* values = nullptr;
+    if constexpr (raw) {
+      keys = reader.template read_array<K>(n);
+      values = reader.template read_array<V>(n);
+      if (!keys || !values) {
+        return false;
+      }
+    }
+    auto* fresh = new HList[buckets];
+    for (uint64_t b = 0; b < buckets; b++) {
+      for (uint64_t i = offsets[b]; i < offsets[b + 1]; i++) {
+        if constexpr (raw) {
+          fresh[b].add(keys[i], values[i]);
+        } else {
+          K key{};
+          V value{};
+          if (!reader.read_item(key) || !reader.read_item(value)) {
+            delete[] fresh;
+            return false;
+          }
+          fresh[b].add(key, value);
+        }
+      }
+    }
+    delete[] arr_;
+    arr_ = fresh;
+    buckets_ = static_cast<uint_32_cx>(buckets);
+    size_ = static_cast<uint_32_cx>(n);
+    maxSize = buckets_ * load_factor_;
+    filter_.reset(maxSize);
+    erased_ = 0;
+    if constexpr (Filter::enabled) {
+      for_each_bucket_entry([&](uint_32_cx, const K& k, const V&) { filter_.insert_hash(hash_func_(k)); });
+    }
+    return reader.end();
+  }
   /**
    * Clears the hashMap of all its contents
    */
@@ -428,6 +706,8 @@ class HashMap {
     buckets_ = initialCapacity_;
     size_ = 0;
     maxSize = buckets_ * load_factor_;
+    filter_.reset(maxSize);
+    erased_ = 0;
   }
   /**
  * @brief Checks if the HashMap contained a specific key.
@@ -435,7 +715,49 @@ class HashMap {
  * @param key The key to search for in the HashMap.
  * @return true if the key is present in the HashMap, false otherwise.
  */
-  inline bool contains(const K& key) { return arr_[hash_func_(key) % buckets_].contains(key); }
+  inline bool contains(const K& key) const {
+    const size_t hash = hash_func_(key);
+    return filter_.may_contain_hash(hash) && arr_[hash & (buckets_ - 1)].contains(key);
+  }
+  /**
+   * Looks up the value of the given key without throwing or inserting
+   * @param key the key to search for
+   * @return a pointer to the value or nullptr if the key doesnt exist
+   */
+  [[nodiscard]] inline V* find(const K& key) const {
+    const size_t hash = hash_func_(key);
+    return filter_.may_contain_hash(hash) ? arr_[hash & (buckets_ - 1)].find(key) : nullptr;
+  }
+  /**
+   * Calls the given function with every key, value pair in bucket order
+   * @param func callable taking (const K&, V&)
+   */
+  template <typename Function>
+  inline void for_each(Function func) const {
+    for_each_in_buckets(0, buckets_, func);
+  }
+  /**
+   * Calls the given function with the key, value pairs of the buckets [begin, end) - disjoint bucket ranges
+   * can be visited from several threads at once, see parallel::for_each()
+   * @param func callable taking (const K&, V&)
+   */
+  template <typename Function>
+  inline void for_each_in_buckets(uint_32_cx begin, uint_32_cx end, Function func) const {
+    CX_ASSERT(begin <= end && end <= buckets_, "bucket range out of bounds");
+    for (uint_32_cx i = begin; i < end; i++) {
+      auto& data = arr_[i].data_;
+      for (uint_fast32_t j = 0; j < BufferLen; j++) {
+        if (data[j].assigned()) {
+          func(static_cast<const K&>(data[j].first()), data[j].second());
+        }
+      }
+      HashListNode<K, V>* current = arr_[i].head_;
+      while (current) {
+        func(static_cast<const K&>(current->key_), current->value_);
+        current = current->next_;
+      }
+    }
+  }
   /**
    * Reduces the underlying array size to something close to the actual data size.
    * This decreases memory usage.
@@ -453,5 +775,9 @@ class HashMap {
           };
   };
 };
+#if defined(CX_KERNEL_DECL)
+// instantiated once in the cxstructs_kernels library
+extern template class HashMap<int, int>;
+#endif
 }  // namespace cxstructs
 #endif  // CXSTRUCTS_HASHMAP_H
@@ -21,13 +21,19 @@
 #ifndef CXSTRUCTS_SRC_DATASTRUCTURES_HASHSET_H_
 #define CXSTRUCTS_SRC_DATASTRUCTURES_HASHSET_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <functional>
+#include <iterator>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
 #include "../cxalgos/MathFunctions.h"
 #include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+#include "BloomFilter.h"
 #include "row.h"
 
 namespace cxhelper {  // namespace to hide the classes
@@ -119,6 +125,23 @@ struct HashSetLinkedList {
     }
     return true;
   }
+  //appends a value that is known to be unique, skipping the search
+  inline void add(const V& value) {
+    for (uint_16_cx i = 0; i < ArrayLength; i++) {
+      if (!data_[i].assigned_) {
+        data_[i].assigned_ = true;
+        data_[i].value_ = value;
+        return;
+      }
+    }
+    if (head_ == nullptr) {
+      head_ = new HSListNode(value);
+      end_ = head_;
+    } else {
+      end_->next_ = new HSListNode(value);
+      end_ = end_->next_;
+    }
+  }
   inline bool remove(const V& value) {
     for (uint_16_cx i = 0; i < ArrayLength; i++) {
       if (data_[i].assigned_ && data_[i].value_ == value) {
@@ -185,12 +208,14 @@ using namespace cxhelper;
  * nce of something, for example the state of visited nodes in a path finding algorithm.
  *
  * @tparam V The type of the values to be stored.
- * @tparam Hash The hash function to be used.
+ * @tparam Hash The hash function to be used. Defaults to the stateless cxstructs::hash, pass std::function for runtime polymorphism.
+ * @tparam Filter filter policy checked before the buckets - pass BloomFilter<> when most lookups miss
  */
-template <typename V, typename Hash = std::function<size_t(const V&)>>
+template <typename V, typename Hash = cxstructs::hash<V>, typename Filter = cxhelper::NoFilter>
 class HashSet {
 
   constexpr inline static uint_16_cx BufferLen = 2;
+  constexpr inline static uint_32_cx kBulkBatch = 32;
   using HList = cxhelper::HashSetLinkedList<V, BufferLen>;
   uint_32_cx initialCapacity_;
   uint_32_cx size_;
@@ -200,54 +225,66 @@ class HashSet {
 
   HList* arr_;
   Hash hash_func_;
+  Filter filter_;
+  // number of erased keys still set in the filter
+  uint_32_cx erased_ = 0;
 
-  inline void reHashBig() {
-    // once the n_elem limit is reached all values needs to be rehashed to fit to the keys with the new bucket n_elem
+  inline void reHash(uint_32_cx newBuckets) {
+    // all values needs to be rehashed to fit to the keys with the new bucket n_elem
     auto oldBuckets = buckets_;
-    buckets_ = buckets_ * 2;
+    buckets_ = newBuckets;
     auto* newArr = new HList[buckets_];
+    maxSize = buckets_ * load_factor_;
+    filter_.reset(maxSize);
+    erased_ = 0;
 
-#pragma omp simd  //single instruction multiple d?
-    for (int i = 0; i < oldBuckets; i++) {
+    for (uint_32_cx i = 0; i < oldBuckets; i++) {
       const auto& data = arr_[i].data_;
       for (uint_fast32_t j = 0; j < BufferLen; j++) {
         if (data[j].assigned_) {
-          size_t hash = hash_func_(data[j].value_) & (buckets_ - 1);
-          newArr[hash].replaceAdd(data[j].value_);
+          const size_t hash = hash_func_(data[j].value_);
+          filter_.insert_hash(hash);
+          newArr[hash & (buckets_ - 1)].add(data[j].value_);
         }
       }
       HashSetListNode<V>* current = arr_[i].head_;
       while (current) {
-        size_t hash = hash_func_(current->value_) & (buckets_ - 1);
-        newArr[hash].replaceAdd(current->value_);
+        const size_t hash = hash_func_(current->value_);
+        filter_.insert_hash(hash);
+        newArr[hash & (buckets_ - 1)].add(current->value_);
         current = current->next_;
       }
     }
     delete[] arr_;
     arr_ = newArr;
-    maxSize = buckets_ * load_factor_;
   }
-  inline void reHashSmall() {
-    //only used in shrink_to_fit()
-    auto oldBuckets = buckets_;
-    buckets_ = size_ * 1.5;
-    auto* newArr = new HList[buckets_];
-
-    for (int i = 0; i < oldBuckets; i++) {
+  // once the n_elem limit is reached the buckets are doubled
+  inline void reHashBig() { reHash(buckets_ * 2); }
+  //only used in shrink_to_fit()
+  inline void reHashSmall() { reHash(size_ * 1.5); }
+  // erased keys stay in the filter, it is rebuilt once they reach half of maxSize
+  inline void count_erased(uint_32_cx n) {
+    if constexpr (Filter::enabled) {
+      erased_ += n;
+      if (erased_ > maxSize / 2) {
+        reHash(buckets_);
+      }
+    }
+  }
+  // calls func(bucket, value) in bucket order, the order snapshots are written in
+  template <typename Function>
+  inline void for_each_bucket_entry(Function func) const {
+    for (uint_32_cx i = 0; i < buckets_; i++) {
+      const auto& data = arr_[i].data_;
       for (uint_fast32_t j = 0; j < BufferLen; j++) {
-        size_t hash = hash_func_(arr_[i].data_[j].first()) % buckets_;
-        newArr[hash].replaceAdd(arr_[i].data_[j].first(), arr_[i].data_[j].second());
+        if (data[j].assigned_) {
+          func(i, data[j].value_);
+        }
       }
-      HList* current = arr_[i].head_;
-      while (current) {
-        size_t hash = hash_func_(current->key_) % buckets_;
-        newArr[hash].replaceAdd(current->key_, current->value_);
-        current = current->next_;
+      for (auto* current = arr_[i].head_; current; current = current->next_) {
+        func(i, current->value_);
       }
     }
-    delete[] arr_;
-    arr_ = newArr;
-    maxSize = buckets_ * load_factor_;
   }
 
  public:
@@ -257,8 +294,10 @@ class HashSet {
         size_(0),
         arr_(new HList[next_power_of_2(initialCapacity)]),
         maxSize(next_power_of_2(initialCapacity) * loadFactor),
-        hash_func_(std::hash<V>()),
-        load_factor_(loadFactor) {}
+        hash_func_(default_hash_func<Hash, V>()),
+        load_factor_(loadFactor) {
+    filter_.reset(maxSize);
+  }
   /**
    * This constructor allows the user to supply their own hash function for the key type
    * @tparam HashFunction callable that takes a key with type V and returns int
@@ -273,14 +312,18 @@ class HashSet {
         arr_(new HList[next_power_of_2(initialCapacity)]),
         maxSize(next_power_of_2(initialCapacity) * loadFactor),
         hash_func_(hash_function),
-        load_factor_(loadFactor) {}
+        load_factor_(loadFactor) {
+    filter_.reset(maxSize);
+  }
   HashSet(const HashSet& o)
       : initialCapacity_(o.initialCapacity_),
         size_(o.size_),
         buckets_(o.buckets_),
-        hash_func_(o.hash_func_),
         maxSize(o.maxSize),
-        load_factor_(o.load_factor_) {
+        load_factor_(o.load_factor_),
+        hash_func_(o.hash_func_),
+        filter_(o.filter_),
+        erased_(o.erased_) {
     arr_ = new HList[buckets_];
     for (uint_32_cx i = 0; i < buckets_; i++) {
       arr_[i] = o.arr_[i];
@@ -290,10 +333,12 @@ class HashSet {
       : initialCapacity_(o.initialCapacity_),
         size_(o.size_),
         buckets_(o.buckets_),
-        hash_func_(std::move(o.hash_func_)),
         maxSize(o.maxSize),
         load_factor_(o.load_factor_),
-        arr_(o.arr_) {
+        arr_(o.arr_),
+        hash_func_(std::move(o.hash_func_)),
+        filter_(std::move(o.filter_)),
+        erased_(o.erased_) {
     o.arr_ = nullptr;
     o.size_ = 0;
   }
@@ -305,6 +350,8 @@ class HashSet {
       size_ = o.size_;
       buckets_ = o.buckets_;
       hash_func_ = o.hash_func_;
+      filter_ = o.filter_;
+      erased_ = o.erased_;
       maxSize = o.maxSize;
 
       arr_ = new HList[buckets_];
@@ -322,6 +369,8 @@ class HashSet {
       size_ = o.size_;
       buckets_ = o.buckets_;
       hash_func_ = std::move(o.hash_func_);
+      filter_ = std::move(o.filter_);
+      erased_ = o.erased_;
       maxSize = o.maxSize;
       arr_ = o.arr_;
 
@@ -340,15 +389,82 @@ class HashSet {
     if (size_ > maxSize) {
       reHashBig();
     }
-    size_ += arr_[hash_func_(val) & (buckets_ - 1)].replaceAdd(val);
+    const size_t hash = hash_func_(val);
+    if (arr_[hash & (buckets_ - 1)].replaceAdd(val)) {
+      filter_.insert_hash(hash);
+      size_++;
+    }
+  }
+  /**
+   * Sizes the bucket array once so that n elements fit without any further rehashing
+   * @param n the number of elements to make room for
+   */
+  inline void reserve(uint_32_cx n) {
+    const auto needed = next_power_of_2(static_cast<uint_32_cx>(n / load_factor_) + 1);
+    if (needed > buckets_) {
+      reHash(needed);
+    }
+  }
+  /**
+   * Inserts all values of the given range<p>
+   * Reserves space for the whole range up front, then hashes a batch of values and prefetches
+   * their buckets before placing them, so the cache misses overlap
+   * @param first iterator to the first value
+   * @param last iterator past the last value
+   */
+  template <typename It>
+  inline void insert_bulk(It first, It last) {
+    static_assert(std::forward_iterator<It>, "insert_bulk needs forward iterators");
+    reserve(size_ + static_cast<uint_32_cx>(std::distance(first, last)));
+    size_t hashes[kBulkBatch];
+    while (first != last) {
+      It it = first;
+      uint_32_cx n = 0;
+      for (; n < kBulkBatch && first != last; ++first, ++n) {
+        hashes[n] = hash_func_(*first);
+        CX_PREFETCH(&arr_[hashes[n] & (buckets_ - 1)]);
+      }
+      for (uint_32_cx i = 0; i < n; ++i, ++it) {
+        if (arr_[hashes[i] & (buckets_ - 1)].replaceAdd(*it)) {
+          filter_.insert_hash(hashes[i]);
+          size_++;
+        }
+      }
+    }
+  }
+  /**
+   * Removes all values of the given range from the HashSet<p>
+   * Values are hashed and their buckets prefetched in batches, just like insert_bulk
+   * @param first iterator to the first value
+   * @param last iterator past the last value
+   */
+  template <typename It>
+  inline void erase_bulk(It first, It last) {
+    static_assert(std::forward_iterator<It>, "erase_bulk needs forward iterators");
+    const auto before = size_;
+    size_t hashes[kBulkBatch];
+    while (first != last) {
+      It it = first;
+      uint_32_cx n = 0;
+      for (; n < kBulkBatch && first != last; ++first, ++n) {
+        hashes[n] = hash_func_(*first) & (buckets_ - 1);
+        CX_PREFETCH(&arr_[hashes[n]]);
+      }
+      for (uint_32_cx i = 0; i < n; ++i, ++it) {
+        size_ -= arr_[hashes[i]].remove(*it);
+      }
+    }
+    count_erased(before - size_);
   }
   /**
    * Removes this val, value Pair from the HashSet
    * @param val - they val to be removed
    */
   inline void erase(const V& val) {
-    size_ -= arr_[hash_func_(val) & (buckets_ - 1)].remove(val);
+    const bool removed = arr_[hash_func_(val) & (buckets_ - 1)].remove(val);
+    size_ -= removed;
     CX_ASSERT(size_ >= 0, "no such element to erase");
+    count_erased(removed);
   }
   /**
    *
@@ -360,6 +476,113 @@ class HashSet {
    * @return the initial capacity
    */
   [[nodiscard]] inline uint_32_cx capacity() const { return buckets_; }
+  /**
+   * Walks all buckets - load_factor is elements per bucket, max_probe the longest bucket chain
+   * @return the heap memory of this set
+   */
+  [[nodiscard]] MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * sizeof(V);
+    stats.bytes_reserved = buckets_ * sizeof(HList);
+    stats.blocks = 1;
+    for (uint_32_cx i = 0; i < buckets_; i++) {
+      uint_32_cx chain = 0;
+      for (uint_16_cx j = 0; j < BufferLen; j++) {
+        chain += arr_[i].data_[j].assigned_;
+      }
+      for (auto node = arr_[i].head_; node; node = node->next_) {
+        chain++;
+        stats.blocks++;
+        stats.bytes_reserved += sizeof(cxhelper::HashSetListNode<V>);
+      }
+      stats.max_probe = std::max(stats.max_probe, chain);
+    }
+    stats.bytes_reserved += filter_.memory_usage();
+    stats.load_factor = buckets_ ? static_cast<float>(size_) / static_cast<float>(buckets_) : 0;
+    return stats;
+  }
+  /**
+   * Writes the set into a snapshot keeping its bucket layout - see cxsnapshot.h<p>
+   * Each bucket becomes a range in one value array, found through a table of offsets.
+   * Trivially copyable values are stored as a raw array, std::string with its length
+   * @param writer a SnapshotWriter
+   */
+  template <typename Writer>
+  void save_snapshot(Writer& writer) const {
+    constexpr bool raw = std::is_trivially_copyable_v<V>;
+    writer.begin("hashset", 1, sizeof(V), size_);
+    writer.write_value(static_cast<uint64_t>(buckets_));
+    std::vector<uint64_t> offsets(buckets_ + 1, 0);
+    for_each_bucket_entry([&](uint_32_cx bucket, const V&) { offsets[bucket + 1]++; });
+    for (uint_32_cx i = 0; i < buckets_; i++) {
+      offsets[i + 1] += offsets[i];
+    }
+    writer.write_array(offsets.data(), offsets.size());
+    if constexpr (raw) {
+      std::vector<V> values;
+      values.reserve(size_);
+      for_each_bucket_entry([&](uint_32_cx, const V& value) { values.push_back(value); });
+      writer.write_array(values.data(), values.size());
+    } else {
+      for_each_bucket_entry([&](uint_32_cx, const V& value) { writer.write_item(value); });
+    }
+    writer.end();
+  }
+  /**
+   * Replaces the contents with the next snapshot section.<p>
+   * The values go straight into their saved buckets - nothing is hashed or searched, so the set has to use
+   * the same hash function as the one that was saved
+   * @param reader a SnapshotReader
+   * @return false if the section doesnt hold a set of this type
+   */
+  template <typename Reader>
+  bool load_snapshot(Reader& reader) {
+    constexpr bool raw = std::is_trivially_copyable_v<V>;
+    uint64_t n = 0, buckets = 0;
+    if (!reader.begin("hashset", 1, sizeof(V), n) || !reader.read_value(buckets) || buckets == 0 ||
+        (buckets & (buckets - 1)) != 0 || buckets > (1ULL << 31) || n > (1ULL << 32)) {
+      return false;
+    }
+    const uint64_t* offsets = reader.template read_array<uint64_t>(buckets + 1);
+    if (!offsets || offsets[0] != 0 || offsets[buckets] != n ||
+        !std::is_sorted(offsets, offsets + buckets + 1)) {
+      return false;
+    }
+    const V* values = nullptr;
+    if constexpr (raw) {
+      values = reader.template read_array<V>(n);
+      if (!values) {
+        return false;
+      }
+    }
+    auto* fresh = new HList[buckets];
+    for (uint64_t b = 0; b < buckets; b++) {
+      for (uint64_t i = offsets[b]; i < offsets[b + 1]; i++) {
+        if constexpr (raw) {
+          fresh[b].add(values[i]);
+        } else {
+          V value{};
+          if (!reader.read_item(value)) {
+            delete[] fresh;
+            return false;
+          }
+          fresh[b].add(value);
+        }
+      }
+    }
+    delete[] arr_;
+    arr_ = fresh;
+    buckets_ = static_cast<uint_32_cx>(buckets);
+    size_ = static_cast<uint_32_cx>(n);
+    maxSize = buckets_ * load_factor_;
+    filter_.reset(maxSize);
+    erased_ = 0;
+    if constexpr (Filter::enabled) {
+      for_each_bucket_entry([&](uint_32_cx, const V& v) { filter_.insert_hash(hash_func_(v)); });
+    }
+    return reader.end();
+  }
   /**
    * Clears the HashSet of all its contents
    */
@@ -368,6 +591,8 @@ class HashSet {
     arr_ = new HList[buckets_];
     size_ = 0;
     maxSize = buckets_ * load_factor_;
+    filter_.reset(maxSize);
+    erased_ = 0;
   }
   /**
  * @brief Checks if the HashSet contained a specific key.
@@ -375,7 +600,10 @@ class HashSet {
  * @param key The key to search for in the HashSet.
  * @return true if the key is present in the HashSet, false otherwise.
  */
-  inline bool contains(const V& key) { return arr_[hash_func_(key) % buckets_].contains(key); }
+  inline bool contains(const V& key) {
+    const size_t hash = hash_func_(key);
+    return filter_.may_contain_hash(hash) && arr_[hash & (buckets_ - 1)].contains(key);
+  }
   /**
    * Reduces the underlying array size to something close to the actual data size.
    * This decreases memory usage.
@@ -0,0 +1,570 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_LRUCACHE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_LRUCACHE_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+
+// Bounded caches where every entry lives in one preallocated slab of nodes
+// The recency lists are intrusive: each node carries the 32 bit indices of its neighbours, so a hit is one
+// probe of the open addressing index (hash tags next to node indices) plus relinking three nodes - nothing
+// is allocated after construction. ARC additionally keeps ghost entries (keys of recently evicted nodes)
+// in the same slab to adapt between recency and frequency
+
+namespace cxstructs {
+/**
+ * Replacement strategy of an LRUCache
+ */
+enum class CachePolicy : uint8_t {
+  LRU,   // evicts the least recently used entry
+  SLRU,  // segmented LRU - entries hit twice move into a protected segment of 80% of the capacity
+  ARC    // adaptive replacement cache - balances recency and frequency with ghost lists of evicted keys
+};
+
+/**
+ * <h2>LRUCache</h2>
+ * A key-value cache with a fixed capacity that evicts entries according to its CachePolicy.
+ * <br><br>
+ * All entries are stored in a flat slab allocated once in the constructor. The recency lists link the
+ * nodes by index and the lookup index is an open addressing table of (hash tag, node index) pairs with
+ * backward shift deletion. get(), put() and the eviction are O(1) and never allocate.
+ * <br><br>
+ * The eviction callback is called with the key and value of every entry dropped to make room - not for
+ * erase() or overwrites. ARC keeps up to capacity keys of evicted entries, their values are reset to V().
+ * <p>
+ * K and V have to be default constructible. Pointers returned by get() are valid until the next put()
+ * @tparam K key type
+ * @tparam V value type
+ * @tparam Hash hash function
+ * @tparam KeyEqual key comparison
+ */
+template <typename K, typename V, typename Hash = cxstructs::hash<K>, typename KeyEqual = std::equal_to<K>>
+class LRUCache {
+  static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+  enum List : uint8_t {
+    T1,    // seen once recently (LRU: the only list, SLRU: probation)
+    T2,    // seen at least twice (SLRU: protected)
+    B1,    // ARC ghosts evicted from T1
+    B2,    // ARC ghosts evicted from T2
+    FREE
+  };
+  struct Node {
+    K key{};
+    V value{};
+    uint32_t prev = kNil;
+    uint32_t next = kNil;
+    uint8_t list_id = FREE;
+  };
+  struct Slot {
+    uint32_t hash;
+    uint32_t node;  // kNil if empty
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<Slot> slots_;
+  uint32_t head_[4] = {kNil, kNil, kNil, kNil};  // most recently used
+  uint32_t tail_[4] = {kNil, kNil, kNil, kNil};  // least recently used
+  uint32_t count_[4] = {0, 0, 0, 0};
+  uint32_t free_ = kNil;
+  uint32_t capacity_;
+  uint32_t mask_;
+  uint32_t protected_cap_;  // SLRU
+  uint32_t target_t1_ = 0;  // ARC: adaptive target size of T1 (p)
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  CachePolicy policy_;
+  [[no_unique_address]] Hash hash_;
+  [[no_unique_address]] KeyEqual equal_;
+  std::function<void(const K&, V&)> on_evict_;
+
+  template <typename, typename, typename>
+  friend class ConcurrentLRUCache;
+
+  [[nodiscard]] inline uint32_t hash_of(const K& key) const noexcept {
+    auto h = static_cast<uint64_t>(hash_(key));
+    if constexpr (!cxhelper::is_avalanching<Hash>::value) {
+      h = hash_int(h);
+    }
+    return static_cast<uint32_t>(h);
+  }
+  [[nodiscard]] inline uint32_t find_slot(const K& key, uint32_t h) const noexcept {
+    for (uint32_t i = h & mask_;; i = (i + 1) & mask_) {
+      const Slot& slot = slots_[i];
+      if (slot.node == kNil) {
+        return kNil;
+      }
+      if (slot.hash == h && equal_(nodes_[slot.node].key, key)) {
+        return i;
+      }
+    }
+  }
+  inline void insert_slot(uint32_t h, uint32_t node) noexcept {
+    uint32_t i = h & mask_;
+    while (slots_[i].node != kNil) {
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = {h, node};
+  }
+  // backward shift deletion - keeps probe sequences without tombstones
+  inline void erase_slot(uint32_t hole) noexcept {
+    for (uint32_t j = (hole + 1) & mask_; slots_[j].node != kNil; j = (j + 1) & mask_) {
+      const uint32_t home = slots_[j].hash & mask_;
+      if (((j - home) & mask_) >= ((j - hole) & mask_)) {
+        slots_[hole] = slots_[j];
+        hole = j;
+      }
+    }
+    slots_[hole].node = kNil;
+  }
+  inline void unlink(uint32_t n) noexcept {
+    Node& node = nodes_[n];
+    (node.prev == kNil ? head_[node.list_id] : nodes_[node.prev].next) = node.next;
+    (node.next == kNil ? tail_[node.list_id] : nodes_[node.next].prev) = node.prev;
+    count_[node.list_id]--;
+  }
+  inline void link_front(uint32_t n, uint8_t list_id) noexcept {
+    Node& node = nodes_[n];
+    node.list_id = list_id;
+    node.prev = kNil;
+    node.next = head_[list_id];
+    (head_[list_id] == kNil ? tail_[list_id] : nodes_[head_[list_id]].prev) = n;
+    head_[list_id] = n;
+    count_[list_id]++;
+  }
+  inline void move_front(uint32_t n, uint8_t list_id) noexcept {
+    if (head_[list_id] == n) {
+      return;
+    }
+    unlink(n);
+    link_front(n, list_id);
+  }
+  [[nodiscard]] inline uint32_t find_node(const K& key, uint32_t h) const noexcept {
+    const uint32_t slot = find_slot(key, h);
+    return slot == kNil ? kNil : slots_[slot].node;
+  }
+  // drops the node from its list and the index
+  inline void release(uint32_t n, uint32_t h) noexcept {
+    erase_slot(find_slot(nodes_[n].key, h));
+    unlink(n);
+    nodes_[n].list_id = FREE;
+    nodes_[n].next = free_;
+    free_ = n;
+  }
+  inline void evict_value(uint32_t n) {
+    if (on_evict_) {
+      on_evict_(nodes_[n].key, nodes_[n].value);
+    }
+    nodes_[n].value = V();
+  }
+  inline void evict(uint32_t n) {
+    evict_value(n);
+    release(n, hash_of(nodes_[n].key));
+  }
+  // ARC REPLACE - turns the LRU entry of T1 or T2 into a ghost
+  inline void arc_replace(bool hit_in_b2) {
+    const bool from_t1 = count_[T1] > 0 && (count_[T1] > target_t1_ || (hit_in_b2 && count_[T1] == target_t1_) ||
+                                            count_[T2] == 0);
+    const uint32_t n = tail_[from_t1 ? T1 : T2];
+    evict_value(n);
+    unlink(n);
+    link_front(n, from_t1 ? B1 : B2);
+  }
+  inline void touch(uint32_t n) noexcept {
+    switch (policy_) {
+      case CachePolicy::LRU:
+        move_front(n, T1);
+        break;
+      case CachePolicy::SLRU:
+        if (nodes_[n].list_id == T1) {
+          unlink(n);
+          link_front(n, T2);
+          if (count_[T2] > protected_cap_) {
+            const uint32_t demoted = tail_[T2];
+            unlink(demoted);
+            link_front(demoted, T1);
+          }
+        } else {
+          move_front(n, T2);
+        }
+        break;
+      case CachePolicy::ARC:
+        move_front(n, T2);
+        break;
+    }
+  }
+  [[nodiscard]] inline uint32_t take_free() noexcept {
+    const uint32_t n = free_;
+    free_ = nodes_[n].next;
+    return n;
+  }
+  // makes room for a new key that is not in the cache or a ghost list, returns a free node
+  inline uint32_t make_room() {
+    if (policy_ != CachePolicy::ARC) {
+      if (size() == capacity_) {
+        evict(tail_[count_[T1] > 0 ? T1 : T2]);
+      }
+      return take_free();
+    }
+    const uint32_t l1 = count_[T1] + count_[B1];
+    const uint32_t total = l1 + count_[T2] + count_[B2];
+    if (l1 == capacity_) {
+      if (count_[T1] < capacity_) {
+        release(tail_[B1], hash_of(nodes_[tail_[B1]].key));
+        if (size() >= capacity_) {  // erase() can leave T1 and T2 below capacity
+          arc_replace(false);
+        }
+      } else {
+        evict(tail_[T1]);
+      }
+    } else if (total >= capacity_) {
+      if (total == 2 * capacity_) {
+        release(tail_[B2], hash_of(nodes_[tail_[B2]].key));
+      }
+      if (size() >= capacity_) {
+        arc_replace(false);
+      }
+    }
+    return take_free();
+  }
+  inline V* get_hashed(const K& key, uint32_t h) {
+    const uint32_t n = find_node(key, h);
+    if (n == kNil || nodes_[n].list_id >= B1) {
+      misses_++;
+      return nullptr;
+    }
+    hits_++;
+    touch(n);
+    return &nodes_[n].value;
+  }
+  template <typename Value>
+  inline V& put_hashed(const K& key, Value&& value, uint32_t h) {
+    uint32_t n = find_node(key, h);
+    if (n != kNil && nodes_[n].list_id < B1) {
+      nodes_[n].value = std::forward<Value>(value);
+      touch(n);
+      return nodes_[n].value;
+    }
+    if (n != kNil) {
+      // ARC ghost hit - the key was evicted recently, adapt the target size of T1 towards the list it came from
+      const bool in_b2 = nodes_[n].list_id == B2;
+      if (in_b2) {
+        const uint32_t delta = std::max<uint32_t>(count_[B1] / count_[B2], 1);
+        target_t1_ = target_t1_ > delta ? target_t1_ - delta : 0;
+      } else {
+        const uint32_t delta = std::max<uint32_t>(count_[B2] / count_[B1], 1);
+        target_t1_ = std::min(capacity_, target_t1_ + delta);
+      }
+      if (size() >= capacity_) {
+        arc_replace(in_b2);
+      }
+      unlink(n);
+      link_front(n, T2);
+    } else {
+      n = make_room();
+      nodes_[n].key = key;
+      insert_slot(h, n);
+      link_front(n, T1);
+    }
+    nodes_[n].value = std::forward<Value>(value);
+    return nodes_[n].value;
+  }
+  inline bool erase_hashed(const K& key, uint32_t h) {
+    const uint32_t n = find_node(key, h);
+    if (n == kNil) {
+      return false;
+    }
+    const bool cached = nodes_[n].list_id < B1;
+    nodes_[n].value = V();
+    release(n, h);
+    return cached;
+  }
+
+ public:
+  /**
+   * @param capacity the maximum number of cached entries
+   * @param policy the replacement strategy
+   * @param hash the hash function
+   * @throws std::invalid_argument if capacity is 0
+   */
+  explicit LRUCache(uint_32_cx capacity, CachePolicy policy = CachePolicy::LRU,
+                    Hash hash = cxhelper::default_hash_func<Hash, K>())
+      : capacity_(static_cast<uint32_t>(capacity)), policy_(policy), hash_(std::move(hash)) {
+    if (capacity == 0 || capacity >= kNil / 4) {
+      throw std::invalid_argument("cache capacity out of range");
+    }
+    protected_cap_ = std::max<uint32_t>(1, capacity_ * 4 / 5);
+    const uint32_t slab = policy_ == CachePolicy::ARC ? 2 * capacity_ : capacity_;
+    nodes_.resize(slab);
+    for (uint32_t i = 0; i < slab; i++) {
+      nodes_[i].next = i + 1 < slab ? i + 1 : kNil;
+    }
+    free_ = 0;
+    slots_.assign(std::bit_ceil(std::max<uint32_t>(8, slab * 2)), Slot{0, kNil});
+    mask_ = static_cast<uint32_t>(slots_.size() - 1);
+  }
+  /**
+   * Looks up the key and marks it as recently used
+   * @param key the key to search for
+   * @return pointer to the cached value or nullptr on a miss
+   */
+  [[nodiscard]] inline V* get(const K& key) { return get_hashed(key, hash_of(key)); }
+  /**
+   * Looks up the key without changing its recency or the hit statistics
+   * @param key the key to search for
+   * @return pointer to the cached value or nullptr
+   */
+  [[nodiscard]] inline const V* peek(const K& key) const noexcept {
+    const uint32_t n = find_node(key, hash_of(key));
+    return n == kNil || nodes_[n].list_id >= B1 ? nullptr : &nodes_[n].value;
+  }
+  /**
+   * @param key the key to search for
+   * @return true if the key is cached
+   */
+  [[nodiscard]] inline bool contains(const K& key) const noexcept { return peek(key) != nullptr; }
+  /**
+   * Inserts or overwrites the value of the key and marks it as recently used.<br>
+   * Evicts an entry if the cache is full
+   * @param key the key
+   * @param value the value
+   * @return a reference to the cached value
+   */
+  inline V& put(const K& key, const V& value) { return put_hashed(key, value, hash_of(key)); }
+  inline V& put(const K& key, V&& value) { return put_hashed(key, std::move(value), hash_of(key)); }
+  /**
+   * Removes the key without calling the eviction callback
+   * @param key the key to remove
+   * @return true if the key was cached
+   */
+  inline bool erase(const K& key) { return erase_hashed(key, hash_of(key)); }
+  /**
+   * Sets the function called with (const K&, V&) for every entry evicted to make room
+   * @param func the callback - an empty function disables it
+   */
+  inline void on_evict(std::function<void(const K&, V&)> func) { on_evict_ = std::move(func); }
+  /**
+   * Removes all entries and ghost keys without calling the eviction callback
+   */
+  inline void clear() {
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+      nodes_[i] = Node();
+      nodes_[i].next = i + 1 < nodes_.size() ? i + 1 : kNil;
+    }
+    std::fill(slots_.begin(), slots_.end(), Slot{0, kNil});
+    std::fill(std::begin(head_), std::end(head_), kNil);
+    std::fill(std::begin(tail_), std::end(tail_), kNil);
+    std::fill(std::begin(count_), std::end(count_), 0);
+    free_ = 0;
+    target_t1_ = 0;
+  }
+  /**
+   * Calls func(const K&, V&) for every cached entry - most recently used first within each segment
+   * @param func the callable
+   */
+  template <typename Function>
+  inline void for_each(Function func) {
+    for (uint8_t list_id : {T2, T1}) {
+      for (uint32_t n = head_[list_id]; n != kNil; n = nodes_[n].next) {
+        func(static_cast<const K&>(nodes_[n].key), nodes_[n].value);
+      }
+    }
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return count_[T1] + count_[T2]; }
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept { return capacity_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size() == 0; }
+  [[nodiscard]] inline CachePolicy policy() const noexcept { return policy_; }
+  /**
+   * @return number of ARC ghost keys - always 0 for the other policies
+   */
+  [[nodiscard]] inline uint_32_cx ghosts() const noexcept { return count_[B1] + count_[B2]; }
+  [[nodiscard]] inline uint64_t hits() const noexcept { return hits_; }
+  [[nodiscard]] inline uint64_t misses() const noexcept { return misses_; }
+  /**
+   * @return hits / (hits + misses) of get() - 0 before the first lookup
+   */
+  [[nodiscard]] inline double hit_rate() const noexcept {
+    return hits_ + misses_ == 0 ? 0.0 : static_cast<double>(hits_) / static_cast<double>(hits_ + misses_);
+  }
+  /**
+   * @return the heap memory - the node slab and the index, nodes of values owning heap memory not included
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size();
+    stats.bytes_used = size() * sizeof(Node);
+    stats.bytes_reserved = nodes_.capacity() * sizeof(Node) + slots_.capacity() * sizeof(Slot);
+    stats.blocks = 2;
+    stats.load_factor = static_cast<float>(size() + ghosts()) / static_cast<float>(slots_.size());
+    return stats;
+  }
+
+};
+
+/**
+ * <h2>ConcurrentLRUCache</h2>
+ * Thread safe LRUCache made out of independently locked shards - every shard is an LRUCache with
+ * capacity / shards entries behind its own mutex (a hit reorders the lists, so readers lock exclusively).
+ * <br><br>
+ * The shard is picked from the upper bits of the hash, the eviction order is per shard.
+ * Values are returned by copy as references would escape the lock. The eviction callback runs under the
+ * lock of its shard.
+ * @tparam K key type
+ * @tparam V value type
+ * @tparam Hash hash function
+ */
+template <typename K, typename V, typename Hash = cxstructs::hash<K>>
+class ConcurrentLRUCache {
+  using Cache = LRUCache<K, V, Hash>;
+  struct alignas(64) Shard {
+    std::mutex mutex_;
+    Cache cache_;
+    Shard(uint_32_cx capacity, CachePolicy policy, const Hash& hash) : cache_(capacity, policy, hash) {}
+  };
+  std::vector<std::unique_ptr<Shard>> shards_;
+  uint_32_cx shard_shift_;
+  Hash hash_;
+
+  [[nodiscard]] inline std::pair<Shard*, uint32_t> locate(const K& key) const {
+    auto h = static_cast<uint64_t>(hash_(key));
+    if constexpr (!cxhelper::is_avalanching<Hash>::value) {
+      h = hash_int(h);
+    }
+    const uint64_t spread = h * 0x9E3779B97F4A7C15ULL;
+    return {shards_[shard_shift_ == 64 ? 0 : spread >> shard_shift_].get(), static_cast<uint32_t>(h)};
+  }
+
+ public:
+  /**
+   * @param capacity the total number of cached entries - split evenly, rounded up per shard
+   * @param policy the replacement strategy of every shard
+   * @param shardCount number of independently locked shards - rounded to the next power of two
+   * @param hash the hash function
+   */
+  explicit ConcurrentLRUCache(uint_32_cx capacity, CachePolicy policy = CachePolicy::LRU, uint_32_cx shardCount = 16,
+                              Hash hash = cxhelper::default_hash_func<Hash, K>())
+      : hash_(std::move(hash)) {
+    shardCount = std::bit_ceil(std::max<uint_32_cx>(1, std::min(shardCount, capacity)));
+    shard_shift_ = 64 - std::countr_zero(static_cast<uint64_t>(shardCount));
+    for (uint_32_cx i = 0; i < shardCount; i++) {
+      shards_.push_back(std::make_unique<Shard>((capacity + shardCount - 1) / shardCount, policy, hash_));
+    }
+  }
+  /**
+   * @param key the key to search for
+   * @return a copy of the cached value or an empty optional
+   */
+  [[nodiscard]] inline std::optional<V> get(const K& key) {
+    auto [shard, h] = locate(key);
+    std::lock_guard lock(shard->mutex_);
+    if (V* val = shard->cache_.get_hashed(key, h)) {
+      return *val;
+    }
+    return std::nullopt;
+  }
+  /**
+   * Inserts or overwrites the value of the key
+   */
+  inline void put(const K& key, V value) {
+    auto [shard, h] = locate(key);
+    std::lock_guard lock(shard->mutex_);
+    shard->cache_.put_hashed(key, std::move(value), h);
+  }
+  /**
+   * Returns the cached value or computes, caches and returns func() on a miss - the shard stays locked
+   * while func runs, so concurrent misses of the same key compute it only once
+   * @param key the key
+   * @param func callable returning V
+   */
+  template <typename Function>
+  inline V get_or_put(const K& key, Function func) {
+    auto [shard, h] = locate(key);
+    std::lock_guard lock(shard->mutex_);
+    if (V* val = shard->cache_.get_hashed(key, h)) {
+      return *val;
+    }
+    return shard->cache_.put_hashed(key, func(), h);
+  }
+  inline bool erase(const K& key) {
+    auto [shard, h] = locate(key);
+    std::lock_guard lock(shard->mutex_);
+    return shard->cache_.erase_hashed(key, h);
+  }
+  [[nodiscard]] inline bool contains(const K& key) const {
+    auto [shard, h] = locate(key);
+    std::lock_guard lock(shard->mutex_);
+    const uint32_t n = shard->cache_.find_node(key, h);
+    return n != Cache::kNil && shard->cache_.nodes_[n].list_id < Cache::B1;
+  }
+  /**
+   * Sets the eviction callback of every shard - it is called concurrently from different shards
+   */
+  inline void on_evict(const std::function<void(const K&, V&)>& func) {
+    for (auto& shard : shards_) {
+      std::lock_guard lock(shard->mutex_);
+      shard->cache_.on_evict(func);
+    }
+  }
+  inline void clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard lock(shard->mutex_);
+      shard->cache_.clear();
+    }
+  }
+  /**
+   * Locks every shard in turn, so the result can be outdated under concurrent writes
+   */
+  [[nodiscard]] inline uint_32_cx size() const {
+    uint_32_cx size = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard lock(shard->mutex_);
+      size += shard->cache_.size();
+    }
+    return size;
+  }
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept {
+    return shards_.size() * shards_[0]->cache_.capacity();
+  }
+  [[nodiscard]] inline uint_32_cx shard_count() const noexcept { return shards_.size(); }
+  [[nodiscard]] inline double hit_rate() const {
+    uint64_t hits = 0, misses = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard lock(shard->mutex_);
+      hits += shard->cache_.hits();
+      misses += shard->cache_.misses();
+    }
+    return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+  }
+
+};
+}  // namespace cxstructs
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_LRUCACHE_H_
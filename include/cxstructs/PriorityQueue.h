@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <iostream>
 #include <queue>
+#include <vector>
 #include "../cxconfig.h"
 
 namespace cxstructs {
@@ -36,11 +37,9 @@ namespace cxstructs {
  * of the largest (by default) element, at the expense of logarithmic insertion and extraction. A user-defined comparator
  * can be supplied to change the ordering, e.g., using std::greater<T> would cause the smallest element to appear as the top().
  */
-template <typename T, typename Compare = std::greater<T>, bool UseCXPoolAllocator = true>
+template <typename T, typename Compare = std::greater<T>, AllocPolicy Policy = PoolAlloc>
 class PriorityQueue {
-  using Allocator =
-      typename std::conditional<UseCXPoolAllocator, CXPoolAllocator<T, sizeof(T) * 33, 1>,
-                                std::allocator<T>>::type;
+  using Allocator = cxhelper::policy_allocator_t<T, Policy>;
   Allocator alloc;
   T* arr_;
   uint_32_cx len_;
@@ -50,6 +49,7 @@ class PriorityQueue {
   bool is_trivial_destr = std::is_trivially_destructible<T>::value;
 
   inline void resize() noexcept {
+    auto old_len = len_;
     len_ *= 2;
 
     T* n_arr = alloc.allocate(len_);
@@ -60,7 +60,7 @@ class PriorityQueue {
         std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
       }
     }
-    alloc.deallocate(arr_, size_);
+    alloc.deallocate(arr_, old_len);
     arr_ = n_arr;
   }
   inline void shrink() noexcept {
@@ -115,11 +115,15 @@ class PriorityQueue {
       : arr_(alloc.allocate(len)), len_(len), size_(0) {}
   /**
    * @brief Constructor that initializes the priority queue with an existing array.
-   *  <b>Takes ownership of the array</b>
-   * @param arr Pointer to the array to copy elements from.
+   *  <b>Takes ownership of the array</b> - it has to be allocated with new[]
+   * @param arr Pointer to the array to move elements from.
    * @param len The number of elements in the array.
    */
-  inline explicit PriorityQueue(T*&& arr, uint_32_cx len) : arr_(arr), len_(len), size_(len) {
+  inline explicit PriorityQueue(T*&& arr, uint_32_cx len)
+      : arr_(alloc.allocate(len)), len_(len), size_(len) {
+    //the allocator pools its memory by size so foreign arrays are moved over and freed
+    std::uninitialized_move(arr, arr + len, arr_);
+    delete[] arr;
     heapify();
     arr = nullptr;  //avoid double deletion
   }
@@ -181,6 +185,19 @@ class PriorityQueue {
    * @return the current n_elem of the priority-queue
    */
   [[nodiscard]] inline uint_32_cx size() const { return size_; }
+  /**
+   * @return the heap memory of this PriorityQueue - one array of capacity() elements
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    if (arr_) {
+      stats.bytes_reserved = cxhelper::allocation_size<Allocator>(len_);
+      stats.blocks = 1;
+    }
+    return stats;
+  }
   /**
    * Adds an element to the priority queue
    * @param e the element to be added
@@ -272,5 +289,270 @@ class PriorityQueue {
   Iterator end() { return Iterator(arr_ + size_); }
 
 };
+
+/**
+ * <h2>IndexedPriorityQueue</h2>
+ * A d-ary heap whose elements can be found again through a handle, so their priority can be changed or
+ * they can be removed without pushing duplicates.
+ * <br><br>
+ * The default arity of 4 halves the height of the tree compared to a binary heap. The children of a node
+ * are adjacent in memory, so sift_down compares them within one or two cache lines.
+ * Values are stored in the heap next to their handle and a separate table maps handles to heap positions.
+ * <br><br>
+ * Handles come from one of two sources - a queue keeps the kind of its first element:
+ * <ul>
+ * <li>push() / emplace() hand out handles and reuse them after the element is popped or erased</li>
+ * <li>insert() takes a caller chosen handle in [0, n), e.g. a cell or vertex index - what A* and Dijkstra need</li>
+ * </ul>
+ * Same comparator convention as PriorityQueue: std::greater<T> puts the smallest element on top().
+ * <pre>
+ * IndexedPriorityQueue<float> open(cells);
+ * open.insert(start, 0);
+ * ...
+ * if (open.contains(next)) open.decrease_key(next, cost); else open.insert(next, cost);
+ * </pre>
+ * @tparam T value type
+ * @tparam Compare comp(a, b) returns true if a comes after b
+ * @tparam Arity number of children per node
+ */
+template <typename T, typename Compare = std::greater<T>, uint_32_cx Arity = 4>
+class IndexedPriorityQueue {
+  static_assert(Arity >= 2, "heap needs at least two children per node");
+
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kInvalid = UINT32_MAX;
+
+ private:
+  struct Entry {
+    T value;
+    Handle handle;
+  };
+  std::vector<Entry> heap_;
+  std::vector<uint32_t> pos_;  // heap index of each handle, kInvalid if it isnt queued
+  std::vector<Handle> free_;
+  Compare comp_;
+  bool keyed_ = false;
+
+  inline void place(Entry&& e, uint32_t index) noexcept {
+    pos_[e.handle] = index;
+    heap_[index] = std::move(e);
+  }
+  inline void sift_up(uint32_t index) noexcept {
+    Entry e = std::move(heap_[index]);
+    while (index > 0) {
+      const uint32_t parent = (index - 1) / Arity;
+      if (!comp_(heap_[parent].value, e.value)) {
+        break;
+      }
+      place(std::move(heap_[parent]), index);
+      index = parent;
+    }
+    place(std::move(e), index);
+  }
+  inline void sift_down(uint32_t index) noexcept {
+    const auto n = static_cast<uint32_t>(heap_.size());
+    Entry e = std::move(heap_[index]);
+    while (true) {
+      const uint64_t first = static_cast<uint64_t>(index) * Arity + 1;
+      if (first >= n) {
+        break;
+      }
+      const auto last = static_cast<uint32_t>(std::min<uint64_t>(first + Arity, n));
+      auto best = static_cast<uint32_t>(first);
+      for (auto c = best + 1; c < last; c++) {
+        if (comp_(heap_[best].value, heap_[c].value)) {
+          best = c;
+        }
+      }
+      if (!comp_(e.value, heap_[best].value)) {
+        break;
+      }
+      place(std::move(heap_[best]), index);
+      index = best;
+    }
+    place(std::move(e), index);
+  }
+  // removes the element at index from the heap
+  inline void remove_at(uint32_t index) noexcept {
+    const Handle h = heap_[index].handle;
+    pos_[h] = kInvalid;
+    if (!keyed_) {
+      free_.push_back(h);
+    }
+    if (index + 1 == heap_.size()) {
+      heap_.pop_back();
+      return;
+    }
+    heap_[index] = std::move(heap_.back());
+    heap_.pop_back();
+    pos_[heap_[index].handle] = index;
+    if (index > 0 && comp_(heap_[(index - 1) / Arity].value, heap_[index].value)) {
+      sift_up(index);
+    } else {
+      sift_down(index);
+    }
+  }
+  inline Handle next_handle() {
+    if (!free_.empty()) {
+      const Handle h = free_.back();
+      free_.pop_back();
+      return h;
+    }
+    pos_.push_back(kInvalid);
+    return static_cast<Handle>(pos_.size() - 1);
+  }
+
+ public:
+  IndexedPriorityQueue() : IndexedPriorityQueue(0) {}
+  /**
+   * @param handles number of caller chosen handles to make room for, see insert()
+   * @param comp the comparator
+   */
+  explicit IndexedPriorityQueue(uint_32_cx handles, Compare comp = Compare())
+      : pos_(handles, kInvalid), comp_(std::move(comp)) {}
+  /**
+   * Adds an element and returns its handle
+   * @param val the element to be added
+   * @return a handle that stays valid until the element is popped or erased
+   */
+  inline Handle push(const T& val) {
+    CX_ASSERT(!keyed_, "dont mix push() with caller chosen handles");
+    const Handle h = next_handle();
+    heap_.push_back({val, h});
+    sift_up(static_cast<uint32_t>(heap_.size() - 1));
+    return h;
+  }
+  /**
+   * Constructs a new element in place and returns its handle
+   * @param args T constructor arguments
+   */
+  template <typename... Args>
+  inline Handle emplace(Args&&... args) {
+    CX_ASSERT(!keyed_, "dont mix emplace() with caller chosen handles");
+    const Handle h = next_handle();
+    heap_.push_back({T(std::forward<Args>(args)...), h});
+    sift_up(static_cast<uint32_t>(heap_.size() - 1));
+    return h;
+  }
+  /**
+   * Adds an element under a caller chosen handle - the handle table grows to fit it
+   * @param handle the handle, must not be queued already
+   * @param val the element to be added
+   */
+  inline void insert(Handle handle, const T& val) {
+    CX_ASSERT(free_.empty() && (keyed_ || heap_.empty()), "dont mix insert() with push()");
+    keyed_ = true;
+    if (handle >= pos_.size()) {
+      pos_.resize(static_cast<size_t>(handle) + 1, kInvalid);
+    }
+    CX_ASSERT(pos_[handle] == kInvalid, "handle is already queued");
+    heap_.push_back({val, handle});
+    sift_up(static_cast<uint32_t>(heap_.size() - 1));
+  }
+  /**
+   * @return true if the handle belongs to a queued element
+   */
+  [[nodiscard]] inline bool contains(Handle handle) const noexcept {
+    return handle < pos_.size() && pos_[handle] != kInvalid;
+  }
+  /**
+   * @return the value of a queued element
+   */
+  [[nodiscard]] inline const T& get(Handle handle) const noexcept {
+    CX_ASSERT(contains(handle), "no such element");
+    return heap_[pos_[handle]].value;
+  }
+  /**
+   * Replaces the value of a queued element, it moves up or down as needed
+   * @param handle the handle of the element
+   * @param val the new value
+   */
+  inline void update(Handle handle, const T& val) {
+    CX_ASSERT(contains(handle), "no such element");
+    const uint32_t index = pos_[handle];
+    const bool up = comp_(heap_[index].value, val);
+    heap_[index].value = val;
+    if (up) {
+      sift_up(index);
+    } else {
+      sift_down(index);
+    }
+  }
+  /**
+   * Raises the priority of a queued element, val must not come after the current value.
+   * Only sifts up - cheaper than update()
+   * @param handle the handle of the element
+   * @param val the new value
+   */
+  inline void decrease_key(Handle handle, const T& val) {
+    CX_ASSERT(contains(handle), "no such element");
+    const uint32_t index = pos_[handle];
+    CX_ASSERT(!comp_(val, heap_[index].value), "new value has a lower priority");
+    heap_[index].value = val;
+    sift_up(index);
+  }
+  /**
+   * Removes a queued element
+   * @param handle the handle of the element
+   * @return true if the element was queued
+   */
+  inline bool erase(Handle handle) noexcept {
+    if (!contains(handle)) {
+      return false;
+    }
+    remove_at(pos_[handle]);
+    return true;
+  }
+  /**
+   * @return the highest priority element
+   */
+  [[nodiscard]] inline const T& top() const noexcept {
+    CX_ASSERT(!heap_.empty(), "no such element");
+    return heap_[0].value;
+  }
+  /**
+   * @return the handle of the highest priority element
+   */
+  [[nodiscard]] inline Handle top_handle() const noexcept {
+    CX_ASSERT(!heap_.empty(), "no such element");
+    return heap_[0].handle;
+  }
+  /**
+   * Removes the highest priority element
+   */
+  inline void pop() noexcept {
+    CX_ASSERT(!heap_.empty(), "no such element");
+    remove_at(0);
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return heap_.size(); }
+  [[nodiscard]] inline bool empty() const noexcept { return heap_.empty(); }
+  /**
+   * Removes all elements in O(size)<p>
+   * With caller chosen handles the handle table keeps its size, so a search can reuse the queue without
+   * touching every handle
+   */
+  inline void clear() noexcept {
+    for (const Entry& e : heap_) {
+      pos_[e.handle] = kInvalid;
+    }
+    heap_.clear();
+    free_.clear();
+    if (!keyed_) {
+      pos_.clear();
+    }
+  }
+  /**
+   * Makes room for caller chosen handles in [0, handles) and elements
+   * @param handles the size of the handle table
+   * @param elements the number of elements to reserve heap space for
+   */
+  inline void reserve(uint_32_cx handles, uint_32_cx elements = 0) {
+    if (handles > pos_.size()) {
+      pos_.resize(handles, kInvalid);
+    }
+    heap_.reserve(elements);
+  }
+};
 }  // namespace cxstructs
 #endif  //CXSTRUCTS_SRC_CXSTRUCTS_PRIORITYQUEUE_H_
@@ -0,0 +1,460 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_RADIXTRIE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_RADIXTRIE_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../cxconfig.h"
+
+// Adaptive radix tree (ART) nodes: a node grows from 4 to 16, 48 and 256 children only when it needs to
+// Each node owns a compressed edge label, an (offset, length) slice of one shared character arena
+// Splitting an edge only shortens the slices, new characters are appended for the new leaf suffix only
+
+namespace cxhelper {
+enum class RadixType : uint8_t { N4, N16, N48, N256 };
+struct RadixNode {
+  RadixType type_;
+  bool terminal_ = false;
+  uint16_t count_ = 0;
+  uint32_t label_len_ = 0;
+  uint32_t label_ = 0;  // offset into the label arena
+};
+// keys_ are kept sorted so iterating the children is in lexicographic order
+struct RadixNode4 : RadixNode {
+  uint8_t keys_[4];
+  RadixNode* children_[4];
+};
+struct RadixNode16 : RadixNode {
+  alignas(16) uint8_t keys_[16];
+  RadixNode* children_[16];
+};
+struct RadixNode48 : RadixNode {
+  uint8_t index_[256];  // 0 is empty, otherwise slot + 1
+  RadixNode* children_[48];
+};
+struct RadixNode256 : RadixNode {
+  RadixNode* children_[256];
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>RadixTrie</h2>
+ * A compressed (Patricia) trie with adaptive node sizes in the style of an ART (adaptive radix tree).
+ * <br><br>
+ * Chains of single child nodes are collapsed into one edge label, so a node only exists where words branch or
+ * end. Nodes start with room for 4 children and are replaced by the next size (16, 48, 256) once full. The
+ * labels are slices of one shared character arena and nodes come from the CXPoolAllocator size class pools,
+ * so a dictionary takes a few dozen bytes per word instead of the 1KB per character of the Trie.
+ * <br><br>
+ * Works with any bytes, not just ASCII. Results are in lexicographic (byte) order.
+ */
+class RadixTrie {
+  RadixNode* root_;
+  std::vector<char> labels_;
+  uint_32_cx size_ = 0;
+
+  template <typename Node>
+  using Alloc = CXPoolAllocator<Node, sizeof(Node) * 32, 1>;
+
+  template <typename Node>
+  static inline Node* make_node(RadixType type) {
+    Node* node = Alloc<Node>().allocate(1);
+    new (node) Node{};
+    node->type_ = type;
+    return node;
+  }
+  static inline void free_node(RadixNode* node) noexcept {
+    switch (node->type_) {
+      case RadixType::N4:
+        Alloc<RadixNode4>().deallocate(static_cast<RadixNode4*>(node), 1);
+        break;
+      case RadixType::N16:
+        Alloc<RadixNode16>().deallocate(static_cast<RadixNode16*>(node), 1);
+        break;
+      case RadixType::N48:
+        Alloc<RadixNode48>().deallocate(static_cast<RadixNode48*>(node), 1);
+        break;
+      case RadixType::N256:
+        Alloc<RadixNode256>().deallocate(static_cast<RadixNode256*>(node), 1);
+        break;
+    }
+  }
+  static inline size_t node_size(const RadixNode* node) noexcept {
+    switch (node->type_) {
+      case RadixType::N4:
+        return sizeof(RadixNode4);
+      case RadixType::N16:
+        return sizeof(RadixNode16);
+      case RadixType::N48:
+        return sizeof(RadixNode48);
+      default:
+        return sizeof(RadixNode256);
+    }
+  }
+  [[nodiscard]] static inline RadixNode** find_child(RadixNode* node, uint8_t key) noexcept {
+    switch (node->type_) {
+      case RadixType::N4: {
+        auto* n = static_cast<RadixNode4*>(node);
+        for (uint_32_cx i = 0; i < n->count_; i++) {
+          if (n->keys_[i] == key) {
+            return &n->children_[i];
+          }
+        }
+        return nullptr;
+      }
+      case RadixType::N16: {
+        auto* n = static_cast<RadixNode16*>(node);
+#if defined(CX_SSE2)
+        const __m128i keys = _mm_load_si128(reinterpret_cast<const __m128i*>(n->keys_));
+        const auto cmp = _mm_cmpeq_epi8(keys, _mm_set1_epi8(static_cast<char>(key)));
+        const uint32_t mask = _mm_movemask_epi8(cmp) & ((1U << n->count_) - 1);
+        return mask ? &n->children_[std::countr_zero(mask)] : nullptr;
+#else
+        for (uint_32_cx i = 0; i < n->count_; i++) {
+          if (n->keys_[i] == key) {
+            return &n->children_[i];
+          }
+        }
+        return nullptr;
+#endif
+      }
+      case RadixType::N48: {
+        auto* n = static_cast<RadixNode48*>(node);
+        return n->index_[key] ? &n->children_[n->index_[key] - 1] : nullptr;
+      }
+      default: {
+        auto* n = static_cast<RadixNode256*>(node);
+        return n->children_[key] ? &n->children_[key] : nullptr;
+      }
+    }
+  }
+  template <typename Small>
+  static inline void insert_sorted(Small* n, uint8_t key, RadixNode* child) noexcept {
+    uint_32_cx i = n->count_;
+    while (i > 0 && n->keys_[i - 1] > key) {
+      n->keys_[i] = n->keys_[i - 1];
+      n->children_[i] = n->children_[i - 1];
+      i--;
+    }
+    n->keys_[i] = key;
+    n->children_[i] = child;
+    n->count_++;
+  }
+  template <typename Big>
+  static inline Big* grow(RadixNode* node, RadixType type) {
+    Big* big = make_node<Big>(type);
+    static_cast<RadixNode&>(*big) = *node;
+    big->type_ = type;
+    return big;
+  }
+  // adds the child, replacing the node with the next bigger size if its full
+  static inline void add_child(RadixNode*& ref, uint8_t key, RadixNode* child) {
+    RadixNode* node = ref;
+    switch (node->type_) {
+      case RadixType::N4: {
+        auto* n = static_cast<RadixNode4*>(node);
+        if (n->count_ < 4) {
+          insert_sorted(n, key, child);
+          return;
+        }
+        auto* big = grow<RadixNode16>(node, RadixType::N16);
+        std::copy(n->keys_, n->keys_ + 4, big->keys_);
+        std::copy(n->children_, n->children_ + 4, big->children_);
+        insert_sorted(big, key, child);
+        ref = big;
+        break;
+      }
+      case RadixType::N16: {
+        auto* n = static_cast<RadixNode16*>(node);
+        if (n->count_ < 16) {
+          insert_sorted(n, key, child);
+          return;
+        }
+        auto* big = grow<RadixNode48>(node, RadixType::N48);
+        for (uint_32_cx i = 0; i < 16; i++) {
+          big->index_[n->keys_[i]] = i + 1;
+          big->children_[i] = n->children_[i];
+        }
+        big->index_[key] = 17;
+        big->children_[16] = child;
+        big->count_++;
+        ref = big;
+        break;
+      }
+      case RadixType::N48: {
+        auto* n = static_cast<RadixNode48*>(node);
+        if (n->count_ < 48) {
+          n->children_[n->count_] = child;
+          n->index_[key] = ++n->count_;
+          return;
+        }
+        auto* big = grow<RadixNode256>(node, RadixType::N256);
+        for (uint_32_cx b = 0; b < 256; b++) {
+          if (n->index_[b]) {
+            big->children_[b] = n->children_[n->index_[b] - 1];
+          }
+        }
+        big->children_[key] = child;
+        big->count_++;
+        ref = big;
+        break;
+      }
+      default: {
+        auto* n = static_cast<RadixNode256*>(node);
+        n->children_[key] = child;
+        n->count_++;
+        return;
+      }
+    }
+    free_node(node);
+  }
+  // calls func(key, child) in ascending key order
+  template <typename Function>
+  static inline void for_each_child(const RadixNode* node, Function func) {
+    switch (node->type_) {
+      case RadixType::N4: {
+        auto* n = static_cast<const RadixNode4*>(node);
+        for (uint_32_cx i = 0; i < n->count_; i++) {
+          func(n->keys_[i], n->children_[i]);
+        }
+        break;
+      }
+      case RadixType::N16: {
+        auto* n = static_cast<const RadixNode16*>(node);
+        for (uint_32_cx i = 0; i < n->count_; i++) {
+          func(n->keys_[i], n->children_[i]);
+        }
+        break;
+      }
+      case RadixType::N48: {
+        auto* n = static_cast<const RadixNode48*>(node);
+        for (uint_32_cx b = 0; b < 256; b++) {
+          if (n->index_[b]) {
+            func(static_cast<uint8_t>(b), n->children_[n->index_[b] - 1]);
+          }
+        }
+        break;
+      }
+      default: {
+        auto* n = static_cast<const RadixNode256*>(node);
+        for (uint_32_cx b = 0; b < 256; b++) {
+          if (n->children_[b]) {
+            func(static_cast<uint8_t>(b), n->children_[b]);
+          }
+        }
+      }
+    }
+  }
+  inline RadixNode* make_leaf(std::string_view suffix) {
+    auto* leaf = make_node<RadixNode4>(RadixType::N4);
+    leaf->terminal_ = true;
+    leaf->label_ = labels_.size();
+    leaf->label_len_ = suffix.size();
+    labels_.insert(labels_.end(), suffix.begin(), suffix.end());
+    return leaf;
+  }
+  void collect(const RadixNode* node, std::string& word, std::vector<std::string>& out) const {
+    const size_t before = word.size();
+    word.append(labels_.data() + node->label_, node->label_len_);
+    if (node->terminal_) {
+      out.emplace_back(word);
+    }
+    for_each_child(node, [&](uint8_t key, const RadixNode* child) {
+      word.push_back(static_cast<char>(key));
+      collect(child, word, out);
+      word.pop_back();
+    });
+    word.resize(before);
+  }
+  void free_all() noexcept {
+    std::vector<RadixNode*> stack{root_};
+    while (!stack.empty()) {
+      RadixNode* node = stack.back();
+      stack.pop_back();
+      for_each_child(node, [&](uint8_t, RadixNode* child) { stack.push_back(child); });
+      free_node(node);
+    }
+  }
+
+ public:
+  RadixTrie() : root_(make_node<RadixNode4>(RadixType::N4)) {}
+  ~RadixTrie() { free_all(); }
+  RadixTrie(const RadixTrie&) = delete;
+  RadixTrie& operator=(const RadixTrie&) = delete;
+  RadixTrie(RadixTrie&&) = delete;
+  RadixTrie& operator=(RadixTrie&&) = delete;
+
+  /**
+   * Inserts the given string into the trie
+   * @param s the string
+   * @return true if it wasnt contained before
+   */
+  bool insert(std::string_view s) {
+    RadixNode** ref = &root_;
+    size_t pos = 0;
+    while (true) {
+      RadixNode* node = *ref;
+      const char* label = labels_.data() + node->label_;
+      const size_t common = std::min<size_t>(node->label_len_, s.size() - pos);
+      uint32_t m = 0;
+      while (m < common && label[m] == s[pos + m]) {
+        m++;
+      }
+      if (m < node->label_len_) {
+        // the word leaves the edge in the middle - split it, the old node keeps the rest of the label
+        auto* parent = make_node<RadixNode4>(RadixType::N4);
+        parent->label_ = node->label_;
+        parent->label_len_ = m;
+        parent->keys_[0] = static_cast<uint8_t>(label[m]);
+        parent->children_[0] = node;
+        parent->count_ = 1;
+        node->label_ += m + 1;
+        node->label_len_ -= m + 1;
+        *ref = parent;
+        pos += m;
+        if (pos == s.size()) {
+          parent->terminal_ = true;
+        } else {
+          add_child(*ref, static_cast<uint8_t>(s[pos]), make_leaf(s.substr(pos + 1)));
+        }
+        size_++;
+        return true;
+      }
+      pos += m;
+      if (pos == s.size()) {
+        if (node->terminal_) {
+          return false;
+        }
+        node->terminal_ = true;
+        size_++;
+        return true;
+      }
+      RadixNode** child = find_child(node, static_cast<uint8_t>(s[pos]));
+      if (!child) {
+        add_child(*ref, static_cast<uint8_t>(s[pos]), make_leaf(s.substr(pos + 1)));
+        size_++;
+        return true;
+      }
+      ref = child;
+      pos++;
+    }
+  }
+  /**
+   * @param s a string query
+   * @return true if s is inside the trie
+   */
+  [[nodiscard]] bool contains(std::string_view s) const noexcept {
+    RadixNode* node = root_;
+    size_t pos = 0;
+    while (true) {
+      if (s.size() - pos < node->label_len_ ||
+          std::memcmp(labels_.data() + node->label_, s.data() + pos, node->label_len_) != 0) {
+        return false;
+      }
+      pos += node->label_len_;
+      if (pos == s.size()) {
+        return node->terminal_;
+      }
+      RadixNode** child = find_child(node, static_cast<uint8_t>(s[pos]));
+      if (!child) {
+        return false;
+      }
+      node = *child;
+      pos++;
+    }
+  }
+  /**
+   * Returns all words that start with the given prefix, including the prefix itself if it was inserted
+   * @param prefix the prefix to search for
+   * @return the words in lexicographic order
+   */
+  [[nodiscard]] std::vector<std::string> startsWith(std::string_view prefix) const {
+    RadixNode* node = root_;
+    size_t pos = 0;
+    while (true) {
+      const size_t remaining = prefix.size() - pos;
+      const char* label = labels_.data() + node->label_;
+      if (remaining <= node->label_len_) {
+        if (std::memcmp(label, prefix.data() + pos, remaining) != 0) {
+          return {};
+        }
+        break;
+      }
+      if (std::memcmp(label, prefix.data() + pos, node->label_len_) != 0) {
+        return {};
+      }
+      pos += node->label_len_;
+      RadixNode** child = find_child(node, static_cast<uint8_t>(prefix[pos]));
+      if (!child) {
+        return {};
+      }
+      node = *child;
+      pos++;
+    }
+    std::vector<std::string> words;
+    std::string word(prefix.substr(0, pos));
+    collect(node, word, words);
+    return words;
+  }
+  /**
+   * @return the total amount of words in the trie
+   */
+  [[nodiscard]] uint_32_cx size() const { return size_; }
+  /**
+   * @return true if the trie contains no words
+   */
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  /**
+   * Clears the trie of all words
+   */
+  void clear() {
+    free_all();
+    labels_.clear();
+    size_ = 0;
+    root_ = make_node<RadixNode4>(RadixType::N4);
+  }
+  /**
+   * @return the bytes used by all nodes and the label arena
+   */
+  [[nodiscard]] size_t memory_usage() const {
+    size_t bytes = labels_.capacity();
+    std::vector<const RadixNode*> stack{root_};
+    while (!stack.empty()) {
+      const RadixNode* node = stack.back();
+      stack.pop_back();
+      bytes += node_size(node);
+      for_each_child(node, [&](uint8_t, const RadixNode* child) { stack.push_back(child); });
+    }
+    return bytes;
+  }
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_RADIXTRIE_H_
@@ -0,0 +1,417 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_SLIDINGWINDOW_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_SLIDINGWINDOW_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+#include "Queue.h"
+
+// Rolling aggregates over the last N values of a stream
+// The values themselves live in a Queue of fixed capacity N. Min and max are the fronts of two monotonic
+// deques (each entry is dominated by nothing after it), sum and variance are updated with the value that
+// enters and the one that leaves. Every N pushes the moments are recomputed from the window so rounding
+// errors of the remove steps cannot pile up - amortised that is two more reads per push
+namespace cxhelper {
+/**
+ * Count, sum and sum of squared deviations from the mean (M2) of a group of values.<br>
+ * Groups are merged and split with the pairwise formulas of Chan et al.
+ */
+struct WindowMoments {
+  double n = 0;
+  double sum = 0;
+  double m2 = 0;
+
+  [[nodiscard]] inline double mean() const noexcept { return n > 0 ? sum / n : 0.0; }
+};
+
+// Two passes over contiguous values - independent lane accumulators so the loops vectorise
+template <typename T>
+inline WindowMoments window_moments(const T* data, uint_32_cx n) noexcept {
+  constexpr uint_32_cx kLanes = 8;
+  WindowMoments res;
+  if (n == 0) return res;
+
+  double lanes[kLanes] = {};
+  uint_32_cx i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (uint_32_cx l = 0; l < kLanes; l++) {
+      lanes[l] += static_cast<double>(data[i + l]);
+    }
+  }
+  double sum = 0;
+  for (; i < n; i++) {
+    sum += static_cast<double>(data[i]);
+  }
+  for (uint_32_cx l = 0; l < kLanes; l++) {
+    sum += lanes[l];
+    lanes[l] = 0;
+  }
+
+  const double mean = sum / static_cast<double>(n);
+  double m2 = 0;
+  for (i = 0; i + kLanes <= n; i += kLanes) {
+    for (uint_32_cx l = 0; l < kLanes; l++) {
+      const double d = static_cast<double>(data[i + l]) - mean;
+      lanes[l] += d * d;
+    }
+  }
+  for (; i < n; i++) {
+    const double d = static_cast<double>(data[i]) - mean;
+    m2 += d * d;
+  }
+  for (uint_32_cx l = 0; l < kLanes; l++) {
+    m2 += lanes[l];
+  }
+
+  res.n = static_cast<double>(n);
+  res.sum = sum;
+  res.m2 = m2;
+  return res;
+}
+inline WindowMoments merge_moments(const WindowMoments& a, const WindowMoments& b) noexcept {
+  if (a.n == 0) return b;
+  if (b.n == 0) return a;
+  WindowMoments res;
+  res.n = a.n + b.n;
+  res.sum = a.sum + b.sum;
+  const double delta = b.mean() - a.mean();
+  res.m2 = a.m2 + b.m2 + delta * delta * a.n * b.n / res.n;
+  return res;
+}
+// Inverse of merge_moments - the moments of total without the group part
+inline WindowMoments split_moments(const WindowMoments& total, const WindowMoments& part) noexcept {
+  WindowMoments res;
+  res.n = total.n - part.n;
+  if (res.n <= 0) return {};
+  res.sum = total.sum - part.sum;
+  const double delta = part.mean() - res.mean();
+  res.m2 = std::max(0.0, total.m2 - part.m2 - delta * delta * res.n * part.n / total.n);
+  return res;
+}
+
+template <typename T>
+struct WindowEntry {
+  T value;
+  uint64_t seq;
+};
+
+/**
+ * Monotonic deque on a fixed ring - values are kept in Compare order from front to back, so the front is the
+ * extremum of everything still inside the window.<br>
+ * With std::less the front is the minimum: a push removes every entry from the back that is not smaller than
+ * the new value, as those can never be the minimum again
+ */
+template <typename T, typename Compare>
+class MonotonicRing {
+  std::vector<WindowEntry<T>> ring_;
+  uint_32_cx head_ = 0;
+  uint_32_cx count_ = 0;
+  [[no_unique_address]] Compare comp_;
+
+  [[nodiscard]] inline uint_32_cx slot(uint_32_cx i) const noexcept {
+    i += head_;
+    return i >= ring_.size() ? i - static_cast<uint_32_cx>(ring_.size()) : i;
+  }
+  inline void pop_dominated(const T& val) noexcept {
+    while (count_ > 0 && !comp_(ring_[slot(count_ - 1)].value, val)) {
+      count_--;
+    }
+  }
+
+ public:
+  explicit MonotonicRing(uint_32_cx capacity) : ring_(capacity) {}
+
+  [[nodiscard]] inline const T& front() const noexcept { return ring_[head_].value; }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return count_; }
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept { return static_cast<uint_32_cx>(ring_.size()); }
+  inline void clear() noexcept { head_ = count_ = 0; }
+  // Drops entries that left the window - everything older than the sequence number oldest
+  inline void expire(uint64_t oldest) noexcept {
+    while (count_ > 0 && ring_[head_].seq < oldest) {
+      head_ = slot(1);
+      count_--;
+    }
+  }
+  inline void push(const T& val, uint64_t seq) noexcept {
+    pop_dominated(val);
+    CX_ASSERT(count_ < ring_.size(), "expire before push");
+    ring_[slot(count_++)] = {val, seq};
+  }
+  /**
+   * Same result as pushing data[0..n) one by one, but only the batch extremum is compared against the
+   * old entries. Inside the batch the survivors are its strict suffix extrema, found in one backward scan
+   * @param scratch room for n entries
+   */
+  inline void push_batch(const T* data, uint_32_cx n, uint64_t first_seq, WindowEntry<T>* scratch) noexcept {
+    if (n == 0) return;
+    uint_32_cx kept = 0;
+    scratch[kept++] = {data[n - 1], first_seq + n - 1};
+    for (uint_32_cx i = n - 1; i-- > 0;) {
+      if (comp_(data[i], scratch[kept - 1].value)) {
+        scratch[kept++] = {data[i], first_seq + i};
+      }
+    }
+    pop_dominated(scratch[kept - 1].value);
+    CX_ASSERT(count_ + kept <= ring_.size(), "expire before push");
+    while (kept > 0) {
+      ring_[slot(count_++)] = scratch[--kept];
+    }
+  }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>SlidingWindow</h2>
+ * Keeps the last <b>window</b> values of a stream and answers min, max, sum, mean and variance over them
+ * in O(1) - instead of rescanning the window on every tick.<br>
+ * Once full, every push evicts the oldest value.
+ * <br><br>
+ * The values are stored in a Queue of fixed capacity (the ring buffer), min and max come from monotonic deques
+ * (amortised O(1) per push), sum and variance are updated incrementally and recomputed every <b>window</b>
+ * pushes to cancel rounding drift.
+ * <br><br>
+ * <b>push_n()</b> takes a whole batch: the moments of the batch and of the evicted values are computed in
+ * vectorised passes over contiguous memory and merged in one step.
+ * <p>
+ * Sums are kept as double - exact for integer streams while the window sum stays below 2^53
+ * @tparam T arithmetic value type
+ */
+template <typename T, AllocPolicy Policy = PoolAlloc>
+class SlidingWindow {
+  static_assert(std::is_arithmetic_v<T>, "SlidingWindow needs an arithmetic type");
+  using Entry = cxhelper::WindowEntry<T>;
+
+  Queue<T, Policy> values_;
+  cxhelper::MonotonicRing<T, std::less<T>> min_;
+  cxhelper::MonotonicRing<T, std::greater<T>> max_;
+  std::vector<Entry> scratch_;
+  cxhelper::WindowMoments moments_;
+  uint64_t pushed_ = 0;
+  uint_32_cx window_;
+  uint_32_cx since_resync_ = 0;
+
+  static inline uint_32_cx checked(uint_32_cx window) {
+    if (window == 0) throw std::invalid_argument("window must not be 0");
+    return window;
+  }
+  // Moments of the values at positions [begin, end) from the oldest
+  [[nodiscard]] inline cxhelper::WindowMoments range_moments(uint_32_cx begin, uint_32_cx end) const noexcept {
+    cxhelper::WindowMoments res;
+    while (begin < end) {
+      auto run = values_.segment(begin);
+      const auto len = std::min(static_cast<uint_32_cx>(run.size()), end - begin);
+      res = cxhelper::merge_moments(res, cxhelper::window_moments(run.data(), len));
+      begin += len;
+    }
+    return res;
+  }
+  inline void after_push(uint_32_cx n) noexcept {
+    const uint64_t oldest = pushed_ - values_.size();
+    min_.expire(oldest);
+    max_.expire(oldest);
+    since_resync_ += n;
+    if (since_resync_ >= window_) {
+      resync();
+    }
+  }
+
+ public:
+  /**
+   * @param window the number of most recent values the aggregates cover
+   * @throws std::invalid_argument if window is 0
+   */
+  explicit SlidingWindow(uint_32_cx window)
+      : values_(checked(window)), min_(window), max_(window), scratch_(window), window_(window) {}
+
+  /**
+   * Adds a value - evicts the oldest one if the window is full
+   * @param val the new value
+   */
+  inline void push(T val) noexcept {
+    const auto x = static_cast<double>(val);
+    if (values_.size() == window_) {
+      const auto y = static_cast<double>(values_.front());
+      values_.pop();
+      const double old_mean = moments_.mean();
+      moments_.sum += x - y;
+      moments_.m2 += (x - y) * ((x - moments_.mean()) + (y - old_mean));
+      moments_.m2 = std::max(0.0, moments_.m2);
+    } else {
+      const double delta = x - moments_.mean();
+      moments_.n += 1;
+      moments_.sum += x;
+      moments_.m2 += delta * (x - moments_.mean());
+    }
+    values_.push(val);
+    pushed_++;
+    after_push(1);
+    min_.push(val, pushed_ - 1);
+    max_.push(val, pushed_ - 1);
+  }
+  /**
+   * Adds n values in order - same result as n calls to push().<br>
+   * The moments of the batch and of the values it evicts are computed in vectorised passes and merged once.
+   * If n exceeds the window only the last window values are looked at
+   * @param data pointer to the values
+   * @param n number of values
+   */
+  inline void push_n(const T* data, uint_32_cx n) noexcept {
+    if (n == 0) return;
+    if (n >= window_) {
+      pushed_ += n - window_;
+      data += n - window_;
+      n = window_;
+      while (!values_.empty()) {
+        values_.pop();
+      }
+      min_.clear();
+      max_.clear();
+      moments_ = {};
+    }
+
+    const uint_32_cx evict = values_.size() + n > window_ ? values_.size() + n - window_ : 0;
+    moments_ = cxhelper::split_moments(moments_, range_moments(0, evict));
+    moments_ = cxhelper::merge_moments(moments_, cxhelper::window_moments(data, n));
+    for (uint_32_cx i = 0; i < evict; i++) {
+      values_.pop();
+    }
+    for (uint_32_cx i = 0; i < n; i++) {
+      values_.push(data[i]);
+    }
+
+    pushed_ += n;
+    after_push(n);
+    min_.push_batch(data, n, pushed_ - n, scratch_.data());
+    max_.push_batch(data, n, pushed_ - n, scratch_.data());
+  }
+  /**
+   * @param values the values to add in order
+   */
+  inline void push_n(std::span<const T> values) noexcept {
+    push_n(values.data(), static_cast<uint_32_cx>(values.size()));
+  }
+  /**
+   * Recomputes sum and variance from the stored values - called automatically every window pushes
+   */
+  inline void resync() noexcept {
+    moments_ = range_moments(0, values_.size());
+    since_resync_ = 0;
+  }
+  /**
+   * Removes all values - the window size stays
+   */
+  inline void clear() noexcept {
+    while (!values_.empty()) {
+      values_.pop();
+    }
+    min_.clear();
+    max_.clear();
+    moments_ = {};
+    since_resync_ = 0;
+  }
+
+  /**
+   * @return the smallest value in the window
+   */
+  [[nodiscard]] inline T min() const noexcept {
+    CX_ASSERT(values_.size() > 0, "window is empty");
+    return min_.front();
+  }
+  /**
+   * @return the largest value in the window
+   */
+  [[nodiscard]] inline T max() const noexcept {
+    CX_ASSERT(values_.size() > 0, "window is empty");
+    return max_.front();
+  }
+  /**
+   * @return the sum of the values in the window
+   */
+  [[nodiscard]] inline double sum() const noexcept { return moments_.sum; }
+  /**
+   * @return the mean of the values in the window - 0 if empty
+   */
+  [[nodiscard]] inline double mean() const noexcept { return moments_.mean(); }
+  /**
+   * @return the population variance of the values in the window - 0 if empty
+   */
+  [[nodiscard]] inline double variance() const noexcept {
+    return moments_.n > 0 ? moments_.m2 / moments_.n : 0.0;
+  }
+  /**
+   * @return the sample variance (divided by n - 1) - 0 for less than two values
+   */
+  [[nodiscard]] inline double sample_variance() const noexcept {
+    return moments_.n > 1 ? moments_.m2 / (moments_.n - 1) : 0.0;
+  }
+  /**
+   * @return the population standard deviation
+   */
+  [[nodiscard]] inline double stddev() const noexcept { return std::sqrt(variance()); }
+
+  /**
+   * @param i position from the oldest value
+   * @return the value
+   */
+  [[nodiscard]] inline T operator[](uint_32_cx i) const noexcept { return values_[i]; }
+  /**
+   * @return the oldest value in the window
+   */
+  [[nodiscard]] inline T front() const noexcept { return values_.front(); }
+  /**
+   * @return the most recent value
+   */
+  [[nodiscard]] inline T back() const noexcept { return values_.back(); }
+  /**
+   * @return the underlying queue - oldest value at the front
+   */
+  [[nodiscard]] inline const Queue<T, Policy>& values() const noexcept { return values_; }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return values_.size(); }
+  [[nodiscard]] inline uint_32_cx window() const noexcept { return window_; }
+  [[nodiscard]] inline bool empty() const noexcept { return values_.size() == 0; }
+  [[nodiscard]] inline bool full() const noexcept { return values_.size() == window_; }
+  /**
+   * @return the total number of values pushed since construction
+   */
+  [[nodiscard]] inline uint64_t pushed() const noexcept { return pushed_; }
+  /**
+   * @return the heap memory - the queue plus both monotonic deques and the batch scratch buffer
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats = values_.memory_stats();
+    stats.bytes_used += (min_.size() + max_.size()) * sizeof(Entry);
+    stats.bytes_reserved += (min_.capacity() + max_.capacity() + scratch_.capacity()) * sizeof(Entry);
+    stats.blocks += 3;
+    return stats;
+  }
+
+};
+}  // namespace cxstructs
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_SLIDINGWINDOW_H_
@@ -0,0 +1,406 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_STATICHASHMAP_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_STATICHASHMAP_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+#include "HashMap.h"
+#include "bitset.h"
+
+namespace cxhelper {
+/**
+ * Layout of the first bytes of a StaticHashMap blob - all counts are stored as 64 bit
+ */
+struct StaticHashHeader {
+  static constexpr uint64_t kMagic = 0x31484d5453584355ULL;  // "UCXSTMH1"
+  uint64_t magic;
+  uint32_t key_size;
+  uint32_t value_size;
+  uint64_t keys;
+  uint64_t slots;    // positions the pilots map to, a bit more than keys
+  uint64_t buckets;  // one pilot each
+  uint64_t seed;
+};
+template <typename K, typename V>
+struct StaticHashSlot {
+  K key;
+  V value;
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>StaticHashMap</h2>
+ * A read only map built once from a HashMap or a key range, using a minimal perfect hash (PTHash style).<br>
+ * Keys are split into buckets of about 3 and every bucket gets a pilot that sends all its keys to free
+ * positions. The n key, value pairs sit in exactly n slots - there are no empty slots and a lookup hashes once,
+ * reads one pilot and compares one slot.
+ * <br><br>
+ * The whole map is one flat blob (header, pilots, remap table, slots) reachable via data() / size_bytes().
+ * Written to a file it can be mmapped at startup and used in place through StaticHashMap::view() without any
+ * rebuilding - the blob only depends on the key and value bytes, so K and V have to be trivially copyable
+ * and the Hash has to be the same between writer and reader.
+ * <br><br>
+ * Building costs a few hash evaluations per key, pilots take under a byte per key.
+ * @tparam K key type, trivially copyable
+ * @tparam V value type, trivially copyable
+ * @tparam Hash hash of the key, remixed with the seed of the map
+ */
+template <typename K, typename V, typename Hash = cxstructs::hash<K>>
+class StaticHashMap {
+  using Header = cxhelper::StaticHashHeader;
+  using Slot = cxhelper::StaticHashSlot<K, V>;
+  static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>,
+                "StaticHashMap stores keys and values as raw bytes");
+  static_assert(alignof(Slot) <= alignof(uint64_t), "slots are aligned to 8 bytes inside the blob");
+  static constexpr uint64_t kBucketSize = 3;
+  static constexpr double kSlotFactor = 0.99;
+  static constexpr uint32_t kMaxPilot = 1U << 16;
+  static constexpr int kSeeds = 16;
+  static constexpr size_t kBulkBatch = 32;
+
+  std::vector<uint64_t> storage_;  // empty for views
+  const Header* header_ = nullptr;
+  const uint16_t* pilots_ = nullptr;
+  const uint32_t* remap_ = nullptr;
+  const Slot* slots_ = nullptr;
+  size_t bytes_ = 0;
+  Hash hash_func_;
+
+  static constexpr size_t align8(size_t bytes) noexcept { return (bytes + 7) & ~size_t(7); }
+  static constexpr size_t align2(size_t count) noexcept { return (count + 1) & ~size_t(1); }
+  static constexpr size_t blob_size(uint64_t keys, uint64_t slots, uint64_t buckets) noexcept {
+    return align8(sizeof(Header) + align2(buckets) * sizeof(uint16_t) + (slots - keys) * sizeof(uint32_t)) +
+           keys * sizeof(Slot);
+  }
+  [[nodiscard]] inline uint64_t key_hash(const K& key, uint64_t seed) const noexcept {
+    if constexpr (cxhelper::is_avalanching<Hash>::value) {
+      return static_cast<uint64_t>(hash_func_(key)) ^ seed;
+    } else {
+      return hash_int(static_cast<uint64_t>(hash_func_(key)) ^ seed);
+    }
+  }
+  [[nodiscard]] static inline uint64_t bucket_of(uint64_t h, uint64_t buckets) noexcept {
+    return ((h >> 32) * buckets) >> 32;
+  }
+  // the multiply carries the low hash bits up - keys of one bucket share their high bits
+  [[nodiscard]] static inline uint64_t position_of(uint64_t h, uint16_t pilot, uint64_t slots) noexcept {
+    return ((((h ^ (pilot * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL) >> 32) * slots) >> 32;
+  }
+  inline void attach(const void* blob, size_t bytes) {
+    if (bytes < sizeof(Header)) {
+      throw std::invalid_argument("blob too small for a StaticHashMap");
+    }
+    header_ = static_cast<const Header*>(blob);
+    const auto* base = static_cast<const unsigned char*>(blob);
+    if (header_->magic != Header::kMagic || header_->key_size != sizeof(K) || header_->value_size != sizeof(V) ||
+        header_->slots < header_->keys || header_->buckets == 0 || header_->slots >= (1ULL << 32) ||
+        bytes < blob_size(header_->keys, header_->slots, header_->buckets)) {
+      throw std::invalid_argument("blob is not a StaticHashMap of this key and value type");
+    }
+    pilots_ = reinterpret_cast<const uint16_t*>(base + sizeof(Header));
+    remap_ = reinterpret_cast<const uint32_t*>(pilots_ + align2(header_->buckets));
+    slots_ = reinterpret_cast<const Slot*>(base + blob_size(header_->keys, header_->slots, header_->buckets) -
+                                           header_->keys * sizeof(Slot));
+    bytes_ = blob_size(header_->keys, header_->slots, header_->buckets);
+  }
+  // tries one seed, returns false if two different keys share a full hash or a bucket finds no pilot
+  bool try_build(const K* keys, const V* values, uint64_t n, uint64_t seed) {
+    const uint64_t slots = std::max<uint64_t>(n, static_cast<uint64_t>(static_cast<double>(n) / kSlotFactor));
+    const uint64_t buckets = std::max<uint64_t>(1, (n + kBucketSize - 1) / kBucketSize);
+
+    std::vector<uint64_t> hashes(n);
+    std::vector<uint64_t> offsets(buckets + 1, 0);
+    for (uint64_t i = 0; i < n; i++) {
+      hashes[i] = key_hash(keys[i], seed);
+      offsets[bucket_of(hashes[i], buckets) + 1]++;
+    }
+    for (uint64_t b = 0; b < buckets; b++) {
+      offsets[b + 1] += offsets[b];
+    }
+    std::vector<uint64_t> members(n);
+    {
+      std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+      for (uint64_t i = 0; i < n; i++) {
+        members[fill[bucket_of(hashes[i], buckets)]++] = i;
+      }
+    }
+
+    // largest buckets first while most positions are still free
+    std::vector<uint64_t> order(buckets);
+    for (uint64_t b = 0; b < buckets; b++) {
+      order[b] = b;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+      return offsets[a + 1] - offsets[a] > offsets[b + 1] - offsets[b];
+    });
+
+    std::vector<uint16_t> pilots(buckets, 0);
+    std::vector<uint64_t> positions(n);
+    cxstructs::bitset taken(slots);
+    std::vector<uint64_t> candidate;
+    for (const uint64_t b : order) {
+      const uint64_t begin = offsets[b], end = offsets[b + 1];
+      if (begin == end) {
+        break;
+      }
+      for (uint64_t i = begin; i < end; i++) {
+        for (uint64_t j = begin; j < i; j++) {
+          if (hashes[members[i]] == hashes[members[j]]) {
+            if (keys[members[i]] == keys[members[j]]) {
+              throw std::invalid_argument("duplicate key in StaticHashMap");
+            }
+            return false;
+          }
+        }
+      }
+      uint32_t pilot = 0;
+      for (;; pilot++) {
+        if (pilot == kMaxPilot) {
+          return false;
+        }
+        candidate.clear();
+        bool free = true;
+        for (uint64_t i = begin; i < end && free; i++) {
+          const uint64_t pos = position_of(hashes[members[i]], pilot, slots);
+          free = !taken.test(pos) && std::find(candidate.begin(), candidate.end(), pos) == candidate.end();
+          candidate.push_back(pos);
+        }
+        if (free) {
+          break;
+        }
+      }
+      pilots[b] = static_cast<uint16_t>(pilot);
+      for (uint64_t i = begin; i < end; i++) {
+        positions[members[i]] = candidate[i - begin];
+        taken.set(candidate[i - begin]);
+      }
+    }
+
+    storage_.assign(align8(blob_size(n, slots, buckets)) / 8, 0);
+    auto* base = reinterpret_cast<unsigned char*>(storage_.data());
+    const Header header{Header::kMagic, sizeof(K), sizeof(V), n, slots, buckets, seed};
+    std::memcpy(base, &header, sizeof(Header));
+    auto* pilot_out = reinterpret_cast<uint16_t*>(base + sizeof(Header));
+    std::copy(pilots.begin(), pilots.end(), pilot_out);
+    // positions past n are sent to the free ones below n
+    auto* remap = reinterpret_cast<uint32_t*>(pilot_out + align2(buckets));
+    uint64_t free_below = 0;
+    for (uint64_t pos = n; pos < slots; pos++) {
+      if (taken.test(pos)) {
+        while (taken.test(free_below)) {
+          free_below++;
+        }
+        remap[pos - n] = static_cast<uint32_t>(free_below++);
+      }
+    }
+    attach(base, storage_.size() * sizeof(uint64_t));
+    auto* slot_out = const_cast<Slot*>(slots_);
+    for (uint64_t i = 0; i < n; i++) {
+      const uint64_t pos = positions[i] < n ? positions[i] : remap[positions[i] - n];
+      std::memcpy(&slot_out[pos].key, &keys[i], sizeof(K));
+      std::memcpy(&slot_out[pos].value, &values[i], sizeof(V));
+    }
+    return true;
+  }
+  StaticHashMap(const void* blob, size_t bytes, Hash hash_function) : hash_func_(hash_function) {
+    if (reinterpret_cast<uintptr_t>(blob) % alignof(uint64_t) != 0) {
+      throw std::invalid_argument("StaticHashMap blob has to be 8 byte aligned");
+    }
+    attach(blob, bytes);
+  }
+  inline void build(const K* keys, const V* values, uint64_t n) {
+    for (int s = 0; s < kSeeds; s++) {
+      if (try_build(keys, values, n, hash_int(0x5eed + s))) {
+        return;
+      }
+    }
+    throw std::runtime_error("could not find a perfect hash - the hash function collides too often");
+  }
+
+ public:
+  /**
+   * Builds the map from two parallel arrays
+   * @param keys pointer to n unique keys
+   * @param values pointer to n values
+   * @param n number of pairs
+   */
+  StaticHashMap(const K* keys, const V* values, size_t n, Hash hash_function = Hash())
+      : hash_func_(hash_function) {
+    build(keys, values, n);
+  }
+  /**
+   * Builds the map from a range of pairs (anything with .first and .second e.g. std::pair)
+   * @param first iterator to the first pair
+   * @param last iterator past the last pair
+   */
+  template <typename It>
+  StaticHashMap(It first, It last, Hash hash_function = Hash()) : hash_func_(hash_function) {
+    static_assert(std::forward_iterator<It>, "StaticHashMap needs forward iterators");
+    std::vector<K> keys;
+    std::vector<V> values;
+    for (; first != last; ++first) {
+      keys.push_back(first->first);
+      values.push_back(first->second);
+    }
+    build(keys.data(), values.data(), keys.size());
+  }
+  /**
+   * Builds the map from all pairs of a HashMap
+   * @param map the map to freeze
+   */
+  template <typename MapHash, typename Filter>
+  explicit StaticHashMap(const HashMap<K, V, MapHash, Filter>& map, Hash hash_function = Hash())
+      : hash_func_(hash_function) {
+    std::vector<K> keys;
+    std::vector<V> values;
+    keys.reserve(map.size());
+    values.reserve(map.size());
+    map.for_each([&](const K& key, V& value) {
+      keys.push_back(key);
+      values.push_back(value);
+    });
+    build(keys.data(), values.data(), keys.size());
+  }
+  StaticHashMap(const StaticHashMap& o) : storage_(o.storage_), hash_func_(o.hash_func_) {
+    attach(storage_.empty() ? static_cast<const void*>(o.header_) : storage_.data(), o.bytes_);
+  }
+  StaticHashMap& operator=(const StaticHashMap& o) {
+    if (this != &o) {
+      storage_ = o.storage_;
+      hash_func_ = o.hash_func_;
+      attach(storage_.empty() ? static_cast<const void*>(o.header_) : storage_.data(), o.bytes_);
+    }
+    return *this;
+  }
+  // the storage keeps its address when moved
+  StaticHashMap(StaticHashMap&&) noexcept = default;
+  StaticHashMap& operator=(StaticHashMap&&) noexcept = default;
+  /**
+   * Uses a blob from data() in place e.g. a mmapped file - it has to stay alive and 8 byte aligned.<p>
+   * <b>Throws std::invalid_argument if the blob doesnt hold a map of this key and value type</b>
+   * @param blob start of the blob
+   * @param bytes size of the blob
+   * @return a map reading from the blob
+   */
+  static StaticHashMap view(const void* blob, size_t bytes, Hash hash_function = Hash()) {
+    return StaticHashMap(blob, bytes, hash_function);
+  }
+  /**
+   * Looks up the value of the given key
+   * @param key the key to search for
+   * @return a pointer to the value or nullptr if the key doesnt exist
+   */
+  [[nodiscard]] inline const V* find(const K& key) const noexcept {
+    const uint64_t n = header_->keys;
+    if (n == 0) [[unlikely]] {
+      return nullptr;
+    }
+    const uint64_t h = key_hash(key, header_->seed);
+    uint64_t pos = position_of(h, pilots_[bucket_of(h, header_->buckets)], header_->slots);
+    if (pos >= n) [[unlikely]] {
+      pos = remap_[pos - n];
+    }
+    const Slot& slot = slots_[pos];
+    return slot.key == key ? &slot.value : nullptr;
+  }
+  [[nodiscard]] inline bool contains(const K& key) const noexcept { return find(key) != nullptr; }
+  /**
+   * Looks up n keys at once<p>
+   * Hashes a batch of keys and prefetches their pilots, then prefetches their slots before comparing,
+   * so the cache misses of the batch overlap
+   * @param keys pointer to n keys
+   * @param n number of keys
+   * @param out receives a pointer to each value or nullptr
+   */
+  inline void find_bulk(const K* keys, size_t n, const V** out) const noexcept {
+    const uint64_t count = header_->keys;
+    if (count == 0) [[unlikely]] {
+      std::fill(out, out + n, nullptr);
+      return;
+    }
+    uint64_t hashes[kBulkBatch];
+    uint64_t positions[kBulkBatch];
+    for (size_t start = 0; start < n; start += kBulkBatch) {
+      const size_t end = std::min(n, start + kBulkBatch);
+      for (size_t i = start; i < end; i++) {
+        hashes[i - start] = key_hash(keys[i], header_->seed);
+        CX_PREFETCH(&pilots_[bucket_of(hashes[i - start], header_->buckets)]);
+      }
+      for (size_t i = start; i < end; i++) {
+        const uint64_t h = hashes[i - start];
+        uint64_t pos = position_of(h, pilots_[bucket_of(h, header_->buckets)], header_->slots);
+        if (pos >= count) [[unlikely]] {
+          pos = remap_[pos - count];
+        }
+        positions[i - start] = pos;
+        CX_PREFETCH(&slots_[pos]);
+      }
+      for (size_t i = start; i < end; i++) {
+        const Slot& slot = slots_[positions[i - start]];
+        out[i] = slot.key == keys[i] ? &slot.value : nullptr;
+      }
+    }
+  }
+  /**
+   * Retrieves the value for the given key <p>
+   * <b>Throws an std::out_of_range if the key doesnt exist</b>
+   */
+  [[nodiscard]] inline const V& at(const K& key) const {
+    const V* value = find(key);
+    if (value == nullptr) {
+      throw std::out_of_range("no such key in StaticHashMap");
+    }
+    return *value;
+  }
+  /**
+   * Calls the given function with every key, value pair in slot order
+   * @param func callable taking (const K&, const V&)
+   */
+  template <typename Function>
+  inline void for_each(Function func) const {
+    for (uint64_t i = 0; i < header_->keys; i++) {
+      func(slots_[i].key, slots_[i].value);
+    }
+  }
+  [[nodiscard]] inline size_t size() const noexcept { return header_->keys; }
+  [[nodiscard]] inline bool empty() const noexcept { return header_->keys == 0; }
+  /**
+   * @return the start of the blob - written to a file it can be loaded again with view()
+   */
+  [[nodiscard]] inline const void* data() const noexcept { return header_; }
+  [[nodiscard]] inline size_t size_bytes() const noexcept { return bytes_; }
+  /**
+   * @return the heap memory owned by this map - 0 for views
+   */
+  [[nodiscard]] inline size_t memory_usage() const noexcept { return storage_.capacity() * sizeof(uint64_t); }
+
+};
+}  // namespace cxstructs
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_STATICHASHMAP_H_
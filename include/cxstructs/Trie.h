@@ -30,7 +30,12 @@
 #include <deque>
 #include <iostream>
 #include <memory>
+#include <new>
+#include <limits>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "../cxconfig.h"
 
@@ -38,12 +43,23 @@ namespace cxhelper {
 struct TrieNode {
   std::array<TrieNode*, 128> children{};
   bool filled = false;
+  float weight = 0;
+  float maxWeight = 0;  // upper bound of all weights below and including this node
   std::string word;
-  inline void setWord(const std::string& s) {
+  inline void setWord(const std::string& s, float w) {
     filled = true;
     word = s;
+    weight = w;
   }
 };
+// a Trie node inside a snapshot - nodes are stored in preorder with their children in character order
+struct TrieSnapshotNode {
+  uint8_t character;
+  uint8_t filled;
+  uint16_t children;
+  float weight;
+  float maxWeight;
+};
 }  // namespace cxhelper
 
 namespace cxstructs {
@@ -51,31 +67,44 @@ using namespace cxhelper;
 
 /**
  *Only supports ASCII characters (0-127)
+ * <br><br>
+ * The nodes live in a pool owned by the trie. Removed nodes go back to it and are reused by later inserts,
+ * compact() moves all live nodes into a fresh pool and releases the old one to the system.
  */
 
 class Trie {
-  using Allocator = CXPoolAllocator<TrieNode, sizeof(TrieNode) * 31, 1>;
+  using Allocator = Pool<sizeof(TrieNode) * 31, 1>;
   TrieNode* root;
-  Allocator alloc;
+  std::unique_ptr<Allocator> alloc;
   uint_32_cx size_;
+  uint_32_cx nodes_ = 0;
   static inline uint8_t getASCII(char c) { return static_cast<uint8_t>(c) & 0x7F; }
-  void getAllSubChildren(TrieNode* node, std::vector<std::string>& words) {
-    for (auto subNode : node->children) {
-      if (subNode) {
-        if (subNode->filled) {
-          words.emplace_back(subNode->word);
-        }
-        getAllSubChildren(subNode, words);
+  inline TrieNode* newNode() {
+    nodes_++;
+    return new (alloc->allocate()) TrieNode();
+  }
+  inline void freeNode(TrieNode* node) noexcept {
+    nodes_--;
+    node->~TrieNode();
+    alloc->deallocate(node);
+  }
+  static inline bool hasChildren(const TrieNode* node) noexcept {
+    return std::any_of(node->children.begin(), node->children.end(),
+                       [](const TrieNode* child) { return child != nullptr; });
+  }
+  [[nodiscard]] TrieNode* findNode(std::string_view s) const noexcept {
+    TrieNode* iterator = root;
+    for (auto& c : s) {
+      iterator = iterator->children[getASCII(c)];
+      if (!iterator) {
+        return nullptr;
       }
     }
+    return iterator;
   }
 
  public:
-  Trie() : size_(0) {
-    TrieNode* temp = alloc.allocate(1);
-    std::allocator_traits<Allocator>::construct(alloc, temp);
-    root = temp;
-  }
+  Trie() : alloc(std::make_unique<Allocator>(sizeof(TrieNode))), size_(0) { root = newNode(); }
   ~Trie() {
     std::deque<TrieNode*> nodesToDelete;
     nodesToDelete.push_back(root);
@@ -90,8 +119,7 @@ class Trie {
         }
       }
 
-      std::allocator_traits<Allocator>::destroy(alloc, node);
-      alloc.deallocate(node, 1);
+      freeNode(node);
     }
   }
   Trie& operator=(const Trie& o) = delete;
@@ -103,27 +131,31 @@ class Trie {
  *  Inserts the given string into the trie, saving it for lookups
  * @param s the string
  */
-  void insert(const std::string& s) {
+  void insert(const std::string& s, float weight = 0) {
     TrieNode* iterator = root;
+    iterator->maxWeight = std::max(iterator->maxWeight, weight);
     uint8_t ascii;
     for (auto& c : s) {
       ascii = getASCII(c);
       if (!iterator->children[ascii]) {
-        TrieNode* temp = alloc.allocate(1);
-        std::allocator_traits<Allocator>::construct(alloc, temp);
+        TrieNode* temp = newNode();
+        temp->maxWeight = weight;
         iterator->children[ascii] = temp;
       }
       iterator = iterator->children[ascii];
+      iterator->maxWeight = std::max(iterator->maxWeight, weight);
     }
-    iterator->setWord(s);
-    size_++;
+    if (!iterator->filled) {
+      size_++;
+    }
+    iterator->setWord(s, weight);
   }
   /**
    * This function checks if the provided string is present in the Trie.
    * @param s  A string query
    * @return true if s is inside the trie
    */
-  bool contains(const std::string& s) {
+  bool contains(const std::string& s) const {
     TrieNode* iterator = root;
     for (auto& c : s) {
       iterator = iterator->children[getASCII(c)];
@@ -141,21 +173,98 @@ class Trie {
  * @param prefix A string that serves as the prefix for the search.
  * @return A vector of strings where each string is a word that begins with the given prefix.
  */
-  std::vector<std::string> startsWith(const std::string& prefix) {
-    TrieNode* iterator = root;
-    for (auto& c : prefix) {
-      iterator = iterator->children[getASCII(c)];
-      if (!iterator) {
-        return {};
+  std::vector<std::string> startsWith(const std::string& prefix) const {
+    std::vector<std::string> retval{};
+    for_each_prefix(prefix, [&retval](std::string_view word) { retval.emplace_back(word); });
+    return retval;
+  }
+  /**
+   * Streams the words starting with prefix (including the prefix itself) in lexicographic order without
+   * copying them. The views point into the trie and are valid until the word is removed or compact() is called.<p>
+   * func may return false to stop early
+   * @param prefix the prefix to search for
+   * @param func callable taking std::string_view, returning void or bool
+   * @param limit stops after this many words
+   * @return the number of words passed to func
+   */
+  template <typename Function>
+  uint_32_cx for_each_prefix(std::string_view prefix, Function func,
+                             uint_32_cx limit = std::numeric_limits<uint_32_cx>::max()) const {
+    TrieNode* start = findNode(prefix);
+    if (!start || limit == 0) {
+      return 0;
+    }
+    uint_32_cx count = 0;
+    std::vector<TrieNode*> stack{start};
+    while (!stack.empty()) {
+      TrieNode* node = stack.back();
+      stack.pop_back();
+      if (node->filled) {
+        count++;
+        if constexpr (std::is_same_v<decltype(func(std::string_view())), bool>) {
+          if (!func(std::string_view(node->word))) {
+            return count;
+          }
+        } else {
+          func(std::string_view(node->word));
+        }
+        if (count == limit) {
+          return count;
+        }
+      }
+      for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+        if (*it) {
+          stack.push_back(*it);
+        }
       }
     }
-    if (iterator) {
-      std::vector<std::string> retval{};
-      getAllSubChildren(iterator, retval);
-      return retval;
-    } else {
-      return {};
+    return count;
+  }
+  /**
+   * Returns the k heaviest words starting with prefix (weights are given to insert()), heaviest first.<p>
+   * Every node knows the largest weight below it, so a best-first search only descends into the branches
+   * that can still contain one of the k results instead of visiting the whole subtree
+   * @param prefix the prefix to search for
+   * @param k number of results
+   * @return pairs of word and weight - the views are valid until the word is removed or compact() is called
+   */
+  [[nodiscard]] std::vector<std::pair<std::string_view, float>> top_k(std::string_view prefix,
+                                                                      uint_32_cx k) const {
+    std::vector<std::pair<std::string_view, float>> result;
+    TrieNode* start = findNode(prefix);
+    if (!start || k == 0) {
+      return result;
+    }
+    // (score, node, word) - a word entry is final once it is the best one left
+    struct Entry {
+      float score;
+      TrieNode* node;
+      bool word;
+      bool operator<(const Entry& o) const noexcept {
+        return score < o.score || (score == o.score && !word && o.word);
+      }
+    };
+    std::vector<Entry> heap{{start->maxWeight, start, false}};
+    while (!heap.empty() && result.size() < k) {
+      std::pop_heap(heap.begin(), heap.end());
+      const Entry top = heap.back();
+      heap.pop_back();
+      if (top.word) {
+        result.emplace_back(top.node->word, top.node->weight);
+        continue;
+      }
+      if (top.node->filled) {
+        heap.push_back({top.node->weight, top.node, true});
+        std::push_heap(heap.begin(), heap.end());
+      }
+      for (auto child : top.node->children) {
+        if (child) {
+          heap.push_back({child->maxWeight, child, false});
+          std::push_heap(heap.begin(), heap.end());
+        }
+      }
     }
+    return result;
   }
   /**
    *
@@ -184,18 +293,187 @@ class Trie {
         }
       }
 
-      std::allocator_traits<Allocator>::destroy(alloc, node);
-      alloc.deallocate(node, 1);
+      freeNode(node);
     }
     size_ = 0;
-    TrieNode* temp = alloc.allocate(1);
-    std::allocator_traits<Allocator>::construct(alloc, temp);
-    root = temp;
+    root = newNode();
+  }
+  /**
+   * Removes the given word from the trie.<p>
+   * Nodes left without a word and without children are unlinked and given back to the pool,
+   * the weight bounds along the path are recomputed
+   * @param s the word to remove
+   * @return true if the word was contained
+   */
+  bool remove(std::string_view s) {
+    std::vector<TrieNode*> path{root};
+    path.reserve(s.size() + 1);
+    for (auto& c : s) {
+      TrieNode* next = path.back()->children[getASCII(c)];
+      if (!next) {
+        return false;
+      }
+      path.push_back(next);
+    }
+    TrieNode* node = path.back();
+    if (!node->filled) {
+      return false;
+    }
+    node->filled = false;
+    node->weight = 0;
+    std::string().swap(node->word);
+    size_--;
+    for (size_t i = path.size() - 1; i > 0; i--) {
+      node = path[i];
+      if (node->filled || hasChildren(node)) {
+        break;
+      }
+      path[i - 1]->children[getASCII(s[i - 1])] = nullptr;
+      freeNode(node);
+      path.pop_back();
+    }
+    for (size_t i = path.size(); i-- > 0;) {
+      node = path[i];
+      float bound = node->filled ? node->weight : std::numeric_limits<float>::lowest();
+      for (auto child : node->children) {
+        if (child) {
+          bound = std::max(bound, child->maxWeight);
+        }
+      }
+      node->maxWeight = bound;
+    }
+    return true;
   }
   /**
-   * Removes the given word from the trie
+   * Moves all nodes into a new pool in depth first order and frees the old pool.<p>
+   * Use it after many removals - the pool never gives memory back by itself. Afterwards the nodes of
+   * each subtree are next to each other, which makes prefix scans walk memory mostly linearly.
+   * Invalidates all string_views handed out before.
    */
-  void remove(const std::string& s) { size_--; }
+  void compact() {
+    auto fresh = std::make_unique<Allocator>(sizeof(TrieNode));
+    TrieNode* newRoot = nullptr;
+    std::vector<std::pair<TrieNode*, TrieNode**>> stack{{root, &newRoot}};
+    while (!stack.empty()) {
+      auto [old, slot] = stack.back();
+      stack.pop_back();
+      auto* node = new (fresh->allocate()) TrieNode();
+      node->filled = old->filled;
+      node->weight = old->weight;
+      node->maxWeight = old->maxWeight;
+      node->word = std::move(old->word);
+      *slot = node;
+      for (uint_32_cx c = old->children.size(); c-- > 0;) {
+        if (old->children[c]) {
+          stack.emplace_back(old->children[c], &node->children[c]);
+        }
+      }
+      old->~TrieNode();
+    }
+    root = newRoot;
+    alloc = std::move(fresh);
+  }
+  /**
+   * Writes the trie into a snapshot - see cxsnapshot.h<p>
+   * The nodes are stored in preorder with their child counts in place of pointers, followed by the words
+   * of the filled nodes in the same order
+   * @param writer a SnapshotWriter
+   */
+  template <typename Writer>
+  void save_snapshot(Writer& writer) const {
+    std::vector<TrieSnapshotNode> nodes;
+    std::vector<const TrieNode*> words;
+    nodes.reserve(nodes_);
+    std::vector<std::pair<const TrieNode*, uint8_t>> stack{{root, 0}};
+    while (!stack.empty()) {
+      auto [node, character] = stack.back();
+      stack.pop_back();
+      uint16_t children = 0;
+      for (uint_32_cx c = node->children.size(); c-- > 0;) {
+        if (node->children[c]) {
+          stack.emplace_back(node->children[c], static_cast<uint8_t>(c));
+          children++;
+        }
+      }
+      nodes.push_back({character, node->filled, children, node->weight, node->maxWeight});
+      if (node->filled) {
+        words.push_back(node);
+      }
+    }
+    writer.begin("trie", 1, sizeof(TrieSnapshotNode), nodes.size());
+    writer.write_array(nodes.data(), nodes.size());
+    for (const TrieNode* node : words) {
+      writer.write_string(node->word);
+    }
+    writer.end();
+  }
+  /**
+   * Replaces the contents with the next snapshot section.<p>
+   * The nodes are recreated in preorder without walking a path per word, which also leaves them laid out
+   * like after compact(). A failed load leaves the trie empty
+   * @param reader a SnapshotReader
+   * @return false if the section doesnt hold a trie
+   */
+  template <typename Reader>
+  bool load_snapshot(Reader& reader) {
+    uint64_t count = 0;
+    if (!reader.begin("trie", 1, sizeof(TrieSnapshotNode), count)) {
+      return false;
+    }
+    const auto* nodes = reader.template read_array<TrieSnapshotNode>(count);
+    if (!nodes || count == 0) {
+      return false;
+    }
+    clear();
+    // parents whose children are still being read, with the number of children left
+    std::vector<std::pair<TrieNode*, uint16_t>> stack;
+    bool ok = true;
+    for (uint64_t i = 0; i < count && ok; i++) {
+      const TrieSnapshotNode& record = nodes[i];
+      TrieNode* node = root;
+      if (i > 0) {
+        while (!stack.empty() && stack.back().second == 0) {
+          stack.pop_back();
+        }
+        if (stack.empty() || record.character >= 128 || stack.back().first->children[record.character]) {
+          ok = false;
+          break;
+        }
+        stack.back().second--;
+        node = newNode();
+        stack.back().first->children[record.character] = node;
+      }
+      node->weight = record.weight;
+      node->maxWeight = record.maxWeight;
+      if (record.filled) {
+        std::string_view word;
+        ok = reader.read_string(word);
+        node->setWord(std::string(word), record.weight);
+        size_++;
+      }
+      if (record.children > 128) {
+        ok = false;
+      } else if (record.children > 0) {
+        stack.emplace_back(node, record.children);
+      }
+    }
+    ok = ok && std::all_of(stack.begin(), stack.end(), [](const auto& entry) { return entry.second == 0; });
+    if (!ok) {
+      clear();
+      return false;
+    }
+    return reader.end();
+  }
+  /**
+   * @return the number of allocated nodes, including the root
+   */
+  [[nodiscard]] uint_32_cx node_count() const { return nodes_; }
+  /**
+   * @return the bytes the node pool holds, in use or free
+   */
+  [[nodiscard]] size_t memory_usage() const {
+    return alloc->chunk_count() * std::max(sizeof(TrieNode) * 31, sizeof(TrieNode));
+  }
 };
 }  // namespace cxstructs
 #endif  //CXSTRUCTS_TRIE_H
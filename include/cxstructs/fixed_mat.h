@@ -0,0 +1,316 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_FIXED_MAT_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_FIXED_MAT_H_
+
+#include <cmath>
+#include <initializer_list>
+#include <type_traits>
+#include "../cxconfig.h"
+#include "row.h"
+
+
+namespace cxstructs {
+
+/**
+ * <h2>fixed_mat</h2>
+ * is a compile-time sized matrix of R rows, stored as R row<C, T> on the stack.<p>
+ * Unlike mat it never allocates and all operations are constexpr and unrolled at compile time, so small
+ * transforms (2x2 to 4x4), mat-vec products and inverses compile down to straight-line code.
+ * Float matrices with 4 or 8 columns use the SIMD dot product of row.<p>
+ * For 2D geometry the 3x3 matrices are affine transforms: see translation(), rotation(), scaling() and
+ * transform_point() - they compose with operator* like mat.
+ *
+ * @tparam R number of rows
+ * @tparam C number of columns
+ * @tparam T element type - defaults to float
+ */
+template <uint_32_cx R, uint_32_cx C, typename T = float>
+class fixed_mat {
+  row<C, T> rows_[R]{};
+
+  template <typename F>
+  static constexpr void unroll(F&& f) noexcept {
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (f(static_cast<uint_32_cx>(I)), ...);
+    }(std::make_index_sequence<R>{});
+  }
+
+ public:
+  /**
+   * Zero initialized matrix
+   */
+  constexpr fixed_mat() = default;
+  constexpr explicit fixed_mat(const T val) {
+    for (auto& r : rows_) {
+      r = row<C, T>(val);
+    }
+  }
+  /**
+   * @param form called with (row, column) for every element
+   */
+  template <typename fill_form,
+            typename = std::enable_if_t<std::is_invocable_r_v<T, fill_form, uint_32_cx, uint_32_cx>>>
+  constexpr explicit fixed_mat(fill_form form) {
+    for (uint_32_cx i = 0; i < R; i++) {
+      for (uint_32_cx j = 0; j < C; j++) {
+        rows_[i][j] = form(i, j);
+      }
+    }
+  }
+  /**
+   * @param init_list R * C values in row-major order
+   */
+  constexpr fixed_mat(std::initializer_list<T> init_list) {
+    CX_ASSERT(init_list.size() == R * C, "");
+    auto it = init_list.begin();
+    for (uint_32_cx i = 0; i < R; i++) {
+      for (uint_32_cx j = 0; j < C; j++) {
+        rows_[i][j] = *it++;
+      }
+    }
+  }
+  [[nodiscard]] static constexpr fixed_mat identity() noexcept
+    requires(R == C)
+  {
+    fixed_mat result;
+    for (uint_32_cx i = 0; i < R; i++) {
+      result.rows_[i][i] = T(1);
+    }
+    return result;
+  }
+  [[nodiscard]] constexpr T& operator()(uint_32_cx i, uint_32_cx j) noexcept { return rows_[i][j]; }
+  [[nodiscard]] constexpr const T& operator()(uint_32_cx i, uint_32_cx j) const noexcept {
+    return rows_[i][j];
+  }
+  [[nodiscard]] constexpr row<C, T>& operator[](uint_32_cx i) noexcept { return rows_[i]; }
+  [[nodiscard]] constexpr const row<C, T>& operator[](uint_32_cx i) const noexcept {
+    return rows_[i];
+  }
+  [[nodiscard]] constexpr uint_32_cx n_rows() const noexcept { return R; }
+  [[nodiscard]] constexpr uint_32_cx n_cols() const noexcept { return C; }
+
+  [[nodiscard]] constexpr fixed_mat operator+(const fixed_mat& o) const noexcept {
+    fixed_mat result;
+    unroll([&](uint_32_cx i) { result.rows_[i] = rows_[i] + o.rows_[i]; });
+    return result;
+  }
+  [[nodiscard]] constexpr fixed_mat operator-(const fixed_mat& o) const noexcept {
+    fixed_mat result;
+    unroll([&](uint_32_cx i) { result.rows_[i] = rows_[i] - o.rows_[i]; });
+    return result;
+  }
+  [[nodiscard]] constexpr fixed_mat operator*(T scalar) const noexcept {
+    fixed_mat result;
+    unroll([&](uint_32_cx i) { result.rows_[i] = rows_[i] * scalar; });
+    return result;
+  }
+  [[nodiscard]] constexpr bool operator==(const fixed_mat& o) const noexcept {
+    for (uint_32_cx i = 0; i < R; i++) {
+      if (!(rows_[i] == o.rows_[i])) return false;
+    }
+    return true;
+  }
+  /**
+   * @return the mat-vec product - one row dot product per row
+   */
+  [[nodiscard]] constexpr row<R, T> operator*(const row<C, T>& v) const noexcept {
+    row<R, T> result;
+    unroll([&](uint_32_cx i) { result[i] = rows_[i].dot(v); });
+    return result;
+  }
+  /**
+   * @return the matrix product - accumulates scaled rows of o so the inner loop stays row-wise
+   */
+  template <uint_32_cx K>
+  [[nodiscard]] constexpr fixed_mat<R, K, T> operator*(const fixed_mat<C, K, T>& o) const noexcept {
+    fixed_mat<R, K, T> result;
+    for (uint_32_cx i = 0; i < R; i++) {
+      row<K, T> acc(T(0));
+      for (uint_32_cx j = 0; j < C; j++) {
+        acc += o[j] * rows_[i][j];
+      }
+      result[i] = acc;
+    }
+    return result;
+  }
+  [[nodiscard]] constexpr fixed_mat<C, R, T> transpose() const noexcept {
+    fixed_mat<C, R, T> result;
+    for (uint_32_cx i = 0; i < R; i++) {
+      for (uint_32_cx j = 0; j < C; j++) {
+        result(j, i) = rows_[i][j];
+      }
+    }
+    return result;
+  }
+  /**
+   * Closed form determinant for 2x2, 3x3 and 4x4
+   */
+  [[nodiscard]] constexpr T determinant() const noexcept
+    requires(R == C && R >= 2 && R <= 4)
+  {
+    const auto& m = *this;
+    if constexpr (R == 2) {
+      return m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+    } else if constexpr (R == 3) {
+      return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1)) -
+             m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0)) +
+             m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+    } else {
+      const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+      const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+      const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+      const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+      const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+      const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+      const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+      const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+      const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+      const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+      const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+      const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+      return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+  }
+  /**
+   * Closed form inverse (adjugate / determinant) for 2x2, 3x3 and 4x4
+   * @param out the inverse - untouched if the matrix is singular
+   * @return false if the determinant is 0
+   */
+  [[nodiscard]] constexpr bool inverse(fixed_mat& out) const noexcept
+    requires(R == C && R >= 2 && R <= 4)
+  {
+    const auto& m = *this;
+    if constexpr (R == 2) {
+      const T det = determinant();
+      if (det == T(0)) return false;
+      const T inv = T(1) / det;
+      out = {m(1, 1) * inv, -m(0, 1) * inv, -m(1, 0) * inv, m(0, 0) * inv};
+    } else if constexpr (R == 3) {
+      const T c00 = m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1);
+      const T c01 = m(1, 2) * m(2, 0) - m(1, 0) * m(2, 2);
+      const T c02 = m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0);
+      const T det = m(0, 0) * c00 + m(0, 1) * c01 + m(0, 2) * c02;
+      if (det == T(0)) return false;
+      const T inv = T(1) / det;
+      out = {c00 * inv,
+             (m(0, 2) * m(2, 1) - m(0, 1) * m(2, 2)) * inv,
+             (m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1)) * inv,
+             c01 * inv,
+             (m(0, 0) * m(2, 2) - m(0, 2) * m(2, 0)) * inv,
+             (m(0, 2) * m(1, 0) - m(0, 0) * m(1, 2)) * inv,
+             c02 * inv,
+             (m(0, 1) * m(2, 0) - m(0, 0) * m(2, 1)) * inv,
+             (m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0)) * inv};
+    } else {
+      // 2x2 sub determinants of the upper (s) and lower (c) two rows
+      const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+      const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+      const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+      const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+      const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+      const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+      const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+      const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+      const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+      const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+      const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+      const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+      const T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+      if (det == T(0)) return false;
+      const T inv = T(1) / det;
+      out = {(m(1, 1) * c5 - m(1, 2) * c4 + m(1, 3) * c3) * inv,
+             (-m(0, 1) * c5 + m(0, 2) * c4 - m(0, 3) * c3) * inv,
+             (m(3, 1) * s5 - m(3, 2) * s4 + m(3, 3) * s3) * inv,
+             (-m(2, 1) * s5 + m(2, 2) * s4 - m(2, 3) * s3) * inv,
+             (-m(1, 0) * c5 + m(1, 2) * c2 - m(1, 3) * c1) * inv,
+             (m(0, 0) * c5 - m(0, 2) * c2 + m(0, 3) * c1) * inv,
+             (-m(3, 0) * s5 + m(3, 2) * s2 - m(3, 3) * s1) * inv,
+             (m(2, 0) * s5 - m(2, 2) * s2 + m(2, 3) * s1) * inv,
+             (m(1, 0) * c4 - m(1, 1) * c2 + m(1, 3) * c0) * inv,
+             (-m(0, 0) * c4 + m(0, 1) * c2 - m(0, 3) * c0) * inv,
+             (m(3, 0) * s4 - m(3, 1) * s2 + m(3, 3) * s0) * inv,
+             (-m(2, 0) * s4 + m(2, 1) * s2 - m(2, 3) * s0) * inv,
+             (-m(1, 0) * c3 + m(1, 1) * c1 - m(1, 2) * c0) * inv,
+             (m(0, 0) * c3 - m(0, 1) * c1 + m(0, 2) * c0) * inv,
+             (-m(3, 0) * s3 + m(3, 1) * s1 - m(3, 2) * s0) * inv,
+             (m(2, 0) * s3 - m(2, 1) * s1 + m(2, 2) * s0) * inv};
+    }
+    return true;
+  }
+  /**
+   * @return affine 2D translation
+   */
+  [[nodiscard]] static constexpr fixed_mat translation(T x, T y) noexcept
+    requires(R == 3 && C == 3)
+  {
+    return {1, 0, x, 0, 1, y, 0, 0, 1};
+  }
+  /**
+   * @return affine 2D scaling around the origin
+   */
+  [[nodiscard]] static constexpr fixed_mat scaling(T x, T y) noexcept
+    requires(R == 3 && C == 3)
+  {
+    return {x, 0, 0, 0, y, 0, 0, 0, 1};
+  }
+  /**
+   * @param radians counter-clockwise around the origin
+   * @return affine 2D rotation
+   */
+  [[nodiscard]] static inline fixed_mat rotation(T radians) noexcept
+    requires(R == 3 && C == 3)
+  {
+    const T c = std::cos(radians);
+    const T s = std::sin(radians);
+    return {c, -s, 0, s, c, 0, 0, 0, 1};
+  }
+  /**
+   * Applies the affine transform to a point - (x, y) for 3x3, (x, y, z) for 4x4
+   * @return the transformed point without the homogeneous coordinate
+   */
+  [[nodiscard]] constexpr row<C - 1, T> transform_point(const row<C - 1, T>& p) const noexcept
+    requires(R == C && R >= 3)
+  {
+    row<C - 1, T> result;
+    for (uint_32_cx i = 0; i < C - 1; i++) {
+      T sum = rows_[i][C - 1];
+      for (uint_32_cx j = 0; j < C - 1; j++) {
+        sum += rows_[i][j] * p[j];
+      }
+      result[i] = sum;
+    }
+    return result;
+  }
+  /**
+   * Applies a 3x3 affine transform to any point type with x() and y() (e.g. Point)
+   */
+  template <class PointType>
+  [[nodiscard]] constexpr PointType transform_point(const PointType& p) const noexcept
+    requires(R == 3 && C == 3 && requires { p.x(); })
+  {
+    const row<2, T> result = transform_point(row<2, T>{p.x(), p.y()});
+    return PointType(result[0], result[1]);
+  }
+};
+
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_FIXED_MAT_H_
@@ -0,0 +1,281 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_K_TREE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_K_TREE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxdistance.h"
+#include "row.h"
+
+//used in kNN XD
+
+namespace cxstructs {
+
+enum class DISTANCE_FUNCTION_XD { EUCLIDEAN, MANHATTAN, CHEBYSHEV, COSINE };
+
+/**
+ * <h2>kTree</h2>
+ * is a k-d tree: a binary space partitioning tree for points with any number of dimensions.<p>
+ * Every inner node splits its points at the median of the dimension with the largest spread,
+ * so the tree is perfectly balanced and needs no pointers. The subtree of a node is the contiguous range
+ * [lo, hi) of the point array with the node itself at (lo + hi) / 2 - the array is the tree.
+ * Ranges of at most kLeafSize points are leaves and scanned linearly.
+ * <br><br>
+ * The tree keeps its own copy of the points in tree order, so a search walks linear memory.<p>
+ * COSINE is answered as EUCLIDEAN on normalized vectors, which gives the same order.
+ * The reported distance is then 1 - cosine similarity.
+ */
+class kTree {
+  static constexpr uint_32_cx kLeafSize = 8;
+
+  std::vector<float> points_;      // n x dims in tree order
+  std::vector<uint32_t> ids_;      // original index of every point
+  std::vector<uint16_t> split_;    // split dimension of the node at each position
+  uint_32_cx dims_ = 0;
+  uint_32_cx size_ = 0;
+  DISTANCE_FUNCTION_XD distance_ = DISTANCE_FUNCTION_XD::EUCLIDEAN;
+
+  [[nodiscard]] inline const float* point(uint_32_cx pos) const noexcept {
+    return points_.data() + static_cast<size_t>(pos) * dims_;
+  }
+  // distance in the metric of the tree - squared for euclidean so no sqrt is needed while searching
+  // N is the number of dimensions if known at compile time (unrolled row kernels) or 0
+  template <DISTANCE_FUNCTION_XD D, uint_32_cx N>
+  [[nodiscard]] inline float raw_distance(const float* a, const float* b) const noexcept {
+    if constexpr (N != 0) {
+      if constexpr (D == DISTANCE_FUNCTION_XD::MANHATTAN) {
+        return cxhelper::row_manhattan_distance<N>(a, b);
+      } else if constexpr (D == DISTANCE_FUNCTION_XD::CHEBYSHEV) {
+        return cxhelper::row_chebyshev_distance<N>(a, b);
+      } else {
+        return cxhelper::row_squared_distance<N>(a, b);
+      }
+    } else if constexpr (D == DISTANCE_FUNCTION_XD::MANHATTAN) {
+      return cxhelper::l1_simd(a, b, dims_);
+    } else if constexpr (D == DISTANCE_FUNCTION_XD::CHEBYSHEV) {
+      return cxhelper::linf_simd(a, b, dims_);
+    } else {
+      return cxhelper::l2_squared_simd(a, b, dims_);
+    }
+  }
+  // lower bound of the distance to anything on the other side of a split plane
+  template <DISTANCE_FUNCTION_XD D>
+  static inline float plane_distance(float diff) noexcept {
+    if constexpr (D == DISTANCE_FUNCTION_XD::MANHATTAN || D == DISTANCE_FUNCTION_XD::CHEBYSHEV) {
+      return std::abs(diff);
+    } else {
+      return diff * diff;
+    }
+  }
+  void build(std::vector<uint32_t>& order, const float* data, uint_32_cx lo, uint_32_cx hi) {
+    if (hi - lo <= kLeafSize) {
+      return;
+    }
+    uint_32_cx best_dim = 0;
+    float best_spread = -1;
+    for (uint_32_cx d = 0; d < dims_; d++) {
+      float low = std::numeric_limits<float>::max();
+      float high = std::numeric_limits<float>::lowest();
+      for (uint_32_cx i = lo; i < hi; i++) {
+        const float v = data[static_cast<size_t>(order[i]) * dims_ + d];
+        low = std::min(low, v);
+        high = std::max(high, v);
+      }
+      if (high - low > best_spread) {
+        best_spread = high - low;
+        best_dim = d;
+      }
+    }
+    const uint_32_cx mid = (lo + hi) / 2;
+    std::nth_element(order.begin() + lo, order.begin() + mid, order.begin() + hi,
+                     [data, best_dim, dims = dims_](uint32_t a, uint32_t b) {
+                       return data[static_cast<size_t>(a) * dims + best_dim] <
+                              data[static_cast<size_t>(b) * dims + best_dim];
+                     });
+    split_[mid] = static_cast<uint16_t>(best_dim);
+    build(order, data, lo, mid);
+    build(order, data, mid + 1, hi);
+  }
+  // max-heap on the distance holding the k best candidates
+  static inline void offer(std::vector<std::pair<float, uint32_t>>& heap, uint_32_cx k, float dist,
+                           uint32_t pos) {
+    if (heap.size() < k) {
+      heap.emplace_back(dist, pos);
+      std::push_heap(heap.begin(), heap.end());
+    } else if (dist < heap.front().first) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = {dist, pos};
+      std::push_heap(heap.begin(), heap.end());
+    }
+  }
+  template <DISTANCE_FUNCTION_XD D, uint_32_cx N>
+  void search(const float* query, uint_32_cx k, uint_32_cx lo, uint_32_cx hi,
+              std::vector<std::pair<float, uint32_t>>& heap) const {
+    if (hi - lo <= kLeafSize) {
+      for (uint_32_cx i = lo; i < hi; i++) {
+        offer(heap, k, raw_distance<D, N>(query, point(i)), i);
+      }
+      return;
+    }
+    const uint_32_cx mid = (lo + hi) / 2;
+    const float diff = query[split_[mid]] - point(mid)[split_[mid]];
+    offer(heap, k, raw_distance<D, N>(query, point(mid)), mid);
+    if (diff < 0) {
+      search<D, N>(query, k, lo, mid, heap);
+      if (heap.size() < k || plane_distance<D>(diff) < heap.front().first) {
+        search<D, N>(query, k, mid + 1, hi, heap);
+      }
+    } else {
+      search<D, N>(query, k, mid + 1, hi, heap);
+      if (heap.size() < k || plane_distance<D>(diff) < heap.front().first) {
+        search<D, N>(query, k, lo, mid, heap);
+      }
+    }
+  }
+  // common small dimensions get a search with the distance unrolled at compile time
+  template <DISTANCE_FUNCTION_XD D>
+  void search_root(const float* query, uint_32_cx k,
+                   std::vector<std::pair<float, uint32_t>>& heap) const {
+    switch (dims_) {
+      case 2:
+        return search<D, 2>(query, k, 0, size_, heap);
+      case 3:
+        return search<D, 3>(query, k, 0, size_, heap);
+      case 4:
+        return search<D, 4>(query, k, 0, size_, heap);
+      case 8:
+        return search<D, 8>(query, k, 0, size_, heap);
+      default:
+        return search<D, 0>(query, k, 0, size_, heap);
+    }
+  }
+  static inline void normalize(float* v, uint_32_cx dims) noexcept {
+    float norm = 0;
+    for (uint_32_cx i = 0; i < dims; i++) {
+      norm += v[i] * v[i];
+    }
+    if (norm > 0) {
+      norm = 1.0F / std::sqrt(norm);
+      for (uint_32_cx i = 0; i < dims; i++) {
+        v[i] *= norm;
+      }
+    }
+  }
+
+ public:
+  kTree() = default;
+  /**
+   * Builds the tree in O(n * log(n) * dims)
+   * @param data n * dims floats, one point after another
+   * @param n number of points
+   * @param dims dimensions of every point
+   * @param distance the distance function used to search
+   */
+  kTree(const float* data, uint_32_cx n, uint_32_cx dims,
+        DISTANCE_FUNCTION_XD distance = DISTANCE_FUNCTION_XD::EUCLIDEAN)
+      : dims_(dims), size_(n), distance_(distance) {
+    if (dims == 0 || dims > std::numeric_limits<uint16_t>::max()) {
+      throw std::logic_error("invalid number of dimensions");
+    }
+    std::vector<float> normalized;
+    if (distance == DISTANCE_FUNCTION_XD::COSINE) {
+      normalized.assign(data, data + static_cast<size_t>(n) * dims);
+      for (uint_32_cx i = 0; i < n; i++) {
+        normalize(normalized.data() + static_cast<size_t>(i) * dims, dims);
+      }
+      data = normalized.data();
+    }
+    ids_.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+      ids_[i] = i;
+    }
+    split_.assign(n, 0);
+    build(ids_, data, 0, n);
+    points_.resize(static_cast<size_t>(n) * dims);
+    for (uint_32_cx i = 0; i < n; i++) {
+      std::copy_n(data + static_cast<size_t>(ids_[i]) * dims, dims,
+                  points_.data() + static_cast<size_t>(i) * dims);
+    }
+  }
+  /**
+   * Finds the k closest points to the query
+   * @param query pointer to dims() floats
+   * @param k number of neighbours
+   * @param result filled with (distance, index) pairs ordered by ascending distance - reusing it between
+   * calls avoids allocations
+   */
+  void k_nearest(const float* query, uint_32_cx k,
+                 std::vector<std::pair<float, uint32_t>>& result) const {
+    result.clear();
+    if (k == 0 || size_ == 0) {
+      return;
+    }
+    result.reserve(std::min(k, size_));
+    switch (distance_) {
+      case DISTANCE_FUNCTION_XD::MANHATTAN:
+        search_root<DISTANCE_FUNCTION_XD::MANHATTAN>(query, k, result);
+        break;
+      case DISTANCE_FUNCTION_XD::CHEBYSHEV:
+        search_root<DISTANCE_FUNCTION_XD::CHEBYSHEV>(query, k, result);
+        break;
+      case DISTANCE_FUNCTION_XD::COSINE: {
+        std::vector<float> unit(query, query + dims_);
+        normalize(unit.data(), dims_);
+        search_root<DISTANCE_FUNCTION_XD::EUCLIDEAN>(unit.data(), k, result);
+        break;
+      }
+      default:
+        search_root<DISTANCE_FUNCTION_XD::EUCLIDEAN>(query, k, result);
+    }
+    std::sort_heap(result.begin(), result.end());
+    for (auto& [dist, pos] : result) {
+      pos = ids_[pos];
+      if (distance_ == DISTANCE_FUNCTION_XD::EUCLIDEAN) {
+        dist = std::sqrt(dist);
+      } else if (distance_ == DISTANCE_FUNCTION_XD::COSINE) {
+        dist *= 0.5F;  // |a-b|^2 = 2 - 2cos for unit vectors
+      }
+    }
+  }
+  /**
+   * @param query pointer to dims() floats
+   * @param k number of neighbours
+   * @return (distance, index) pairs of the k closest points ordered by ascending distance
+   */
+  [[nodiscard]] std::vector<std::pair<float, uint32_t>> k_nearest(const float* query,
+                                                                  uint_32_cx k) const {
+    std::vector<std::pair<float, uint32_t>> result;
+    k_nearest(query, k, result);
+    return result;
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+  [[nodiscard]] inline uint_32_cx dims() const noexcept { return dims_; }
+  [[nodiscard]] inline DISTANCE_FUNCTION_XD distance() const noexcept { return distance_; }
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_K_TREE_H_
@@ -0,0 +1,589 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_PACKED_VEC_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_PACKED_VEC_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+
+// Compressed integer vectors - packed_vec stores every value with a fixed number of bits, delta_vec stores
+// sorted sequences as deltas in blocks of 128 with their own bit width (PFor: outliers are patched in
+// afterwards instead of widening the whole block)
+// Values are read with one unaligned 8 byte load at the byte holding their first bit, so the storage keeps
+// 8 bytes of zero padding at the end. Unpacking 8 values at once is a gather + variable shift with AVX2
+
+namespace cxhelper {
+[[nodiscard]] constexpr uint64_t low_mask(uint32_t bits) noexcept {
+  return bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+}
+/**
+ * @return the bits wide value starting at bit offset bit - 8 bytes from its first byte must be readable
+ */
+[[nodiscard]] inline uint32_t load_bits(const uint8_t* bytes, size_t bit, uint32_t bits) noexcept {
+  uint64_t word;
+  std::memcpy(&word, bytes + bit / 8, 8);
+  return static_cast<uint32_t>((word >> (bit % 8)) & low_mask(bits));
+}
+/**
+ * Overwrites the bits wide value at bit offset bit, the neighbouring values stay untouched
+ */
+inline void store_bits(uint8_t* bytes, size_t bit, uint32_t bits, uint32_t value) noexcept {
+  uint64_t word;
+  std::memcpy(&word, bytes + bit / 8, 8);
+  const uint64_t mask = low_mask(bits) << (bit % 8);
+  word = (word & ~mask) | ((uint64_t(value) << (bit % 8)) & mask);
+  std::memcpy(bytes + bit / 8, &word, 8);
+}
+inline void pack_bits(uint8_t* bytes, size_t start, const uint32_t* values, size_t count,
+                      uint32_t bits) noexcept {
+  for (size_t i = 0; i < count; i++) {
+    store_bits(bytes, (start + i) * bits, bits, values[i]);
+  }
+}
+inline void unpack_bits_scalar(const uint8_t* bytes, size_t start, size_t count, uint32_t bits,
+                               uint32_t* out) noexcept {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = load_bits(bytes, (start + i) * bits, bits);
+  }
+}
+template <typename T>
+inline void prefix_sum_scalar(T* values, size_t n, T base) noexcept {
+  for (size_t i = 0; i < n; i++) {
+    base += values[i];
+    values[i] = base;
+  }
+}
+inline void prefix_sum_u32_scalar(uint32_t* values, size_t n, uint32_t base) noexcept {
+  prefix_sum_scalar(values, n, base);
+}
+#if defined(CX_X86_DISPATCH)
+// pshufb control per width: lane k takes the 4 bytes starting at its first byte, lanes 4-7 counted from the
+// byte that holds the first bit of lane 4 (the upper 16 bytes are loaded from there)
+inline constexpr auto kUnpackShuffle = [] {
+  std::array<std::array<uint8_t, 32>, 26> table{};
+  for (uint32_t bits = 1; bits <= 25; bits++) {
+    for (uint32_t k = 0; k < 8; k++) {
+      const uint32_t first = k * bits / 8 - (k < 4 ? 0 : 4 * bits / 8);
+      for (uint32_t b = 0; b < 4; b++) {
+        table[bits][k * 4 + b] = static_cast<uint8_t>(first + b);
+      }
+    }
+  }
+  return table;
+}();
+// A group of 8 values starting at an index divisible by 8 starts on a byte boundary, so the byte offsets and
+// shifts of its lanes are the same for every group. Up to 25 bits a value fits into the 4 bytes moved into
+// its lane by one shuffle - near the end of the range, where two 16 byte loads could overrun the padding,
+// the lanes are gathered instead
+CX_TARGET_AVX2 inline void unpack_bits_avx2(const uint8_t* bytes, size_t start, size_t count,
+                                            uint32_t bits, uint32_t* out) noexcept {
+  if (bits > 25 || bits == 0) {
+    unpack_bits_scalar(bytes, start, count, bits, out);
+    return;
+  }
+  size_t i = 0;
+  for (; i < count && (start + i) % 8 != 0; i++) {
+    out[i] = load_bits(bytes, (start + i) * bits, bits);
+  }
+  const __m256i position =
+      _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(bits)));
+  const __m256i offsets = _mm256_srli_epi32(position, 3);
+  const __m256i shifts = _mm256_and_si256(position, _mm256_set1_epi32(7));
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>(low_mask(bits)));
+  const __m256i shuffle = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kUnpackShuffle[bits].data()));
+  const size_t upper = 4 * bits / 8;
+  // the last value has 8 readable bytes from its first byte on - the loads of a group end at upper + 16
+  if (count > 0 && i + 8 <= count) {
+    const size_t readable = (start + count - 1) * bits / 8 + 8;
+    for (; i + 8 <= count && (start + i) / 8 * bits + upper + 16 <= readable; i += 8) {
+      const uint8_t* group = bytes + (start + i) / 8 * bits;
+      const __m256i v = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(group + upper)), 1);
+      const __m256i lanes = _mm256_shuffle_epi8(v, shuffle);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                          _mm256_and_si256(_mm256_srlv_epi32(lanes, shifts), mask));
+    }
+  }
+  for (; i + 8 <= count; i += 8) {
+    const auto* group = reinterpret_cast<const int*>(bytes + (start + i) / 8 * bits);
+    const __m256i v = _mm256_i32gather_epi32(group, offsets, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_and_si256(_mm256_srlv_epi32(v, shifts), mask));
+  }
+  unpack_bits_scalar(bytes, start + i, count - i, bits, out + i);
+}
+// inclusive prefix sum of 8 lanes in three shift + add steps, the running total is carried between groups
+CX_TARGET_AVX2 inline void prefix_sum_u32_avx2(uint32_t* values, size_t n, uint32_t base) noexcept {
+  __m256i carry = _mm256_set1_epi32(static_cast<int>(base));
+  const __m256i last = _mm256_set1_epi32(7);
+  const __m256i mid = _mm256_set1_epi32(3);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+    const __m256i low_total = _mm256_permutevar8x32_epi32(x, mid);
+    x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(), low_total, 0xF0));
+    x = _mm256_add_epi32(x, carry);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), x);
+    carry = _mm256_permutevar8x32_epi32(x, last);
+  }
+  prefix_sum_scalar(values + i, n - i, i == 0 ? base : values[i - 1]);
+}
+#endif
+/**
+ * Unpacks count values of the given width starting at value index start into out
+ */
+inline void unpack_bits(const uint8_t* bytes, size_t start, size_t count, uint32_t bits,
+                        uint32_t* out) noexcept {
+#if defined(CX_AVX2)
+  unpack_bits_avx2(bytes, start, count, bits, out);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = select_isa(unpack_bits_scalar, unpack_bits_avx2);
+  kernel(bytes, start, count, bits, out);
+#else
+  unpack_bits_scalar(bytes, start, count, bits, out);
+#endif
+}
+/**
+ * values[i] = base + values[0] + ... + values[i]
+ */
+inline void prefix_sum_u32(uint32_t* values, size_t n, uint32_t base) noexcept {
+#if defined(CX_AVX2)
+  prefix_sum_u32_avx2(values, n, base);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = select_isa(prefix_sum_u32_scalar, prefix_sum_u32_avx2);
+  kernel(values, n, base);
+#else
+  prefix_sum_u32_scalar(values, n, base);
+#endif
+}
+template <typename T>
+struct DeltaBlock {
+  T base;              // first value of the block
+  uint64_t offset;     // byte offset of the packed deltas
+  uint32_t exceptions; // index of the first patched delta
+  uint8_t bits;        // width of the packed deltas
+  uint8_t exception_count;
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>packed_vec</h2>
+ * Vector of unsigned integers that are all smaller than 2^Bits, stored back to back with Bits bits each.
+ * <br><br>
+ * 20 bit ids take 2.5 instead of 4 bytes, 12 bit ones a third of a <code>vec<uint32_t></code>.
+ * Random access reads one unaligned 8 byte word, unpack() and for_each() decode 8 values per gather with
+ * AVX2, which keeps a scan bound by memory bandwidth - and there is a lot less memory to stream.
+ * <br><br>
+ * Elements are returned by value, set() replaces one in place.
+ * <pre>
+ * packed_vec<20> ids;
+ * ids.push_back(123456);
+ * ids.for_each([](uint32_t id) { ... });
+ * </pre>
+ * @tparam Bits bits per element, 1 to 32
+ */
+template <uint32_t Bits>
+class packed_vec {
+  static_assert(Bits >= 1 && Bits <= 32, "packed_vec stores 1 to 32 bits per element");
+  static_assert(std::endian::native == std::endian::little, "packed_vec assumes a little endian target");
+  std::vector<uint64_t> words_;
+  size_t size_ = 0;
+
+  // words for n values plus one word of padding for the 8 byte loads
+  [[nodiscard]] static constexpr size_t words_for(size_t n) noexcept { return (n * Bits + 63) / 64 + 1; }
+  [[nodiscard]] inline uint8_t* bytes() noexcept { return reinterpret_cast<uint8_t*>(words_.data()); }
+  [[nodiscard]] inline const uint8_t* bytes() const noexcept {
+    return reinterpret_cast<const uint8_t*>(words_.data());
+  }
+  inline void grow(size_t n) {
+    if (words_for(n) > words_.size()) {
+      words_.resize(std::max(words_for(n), words_.size() * 2), 0);
+    }
+  }
+
+ public:
+  static constexpr uint32_t max_value = static_cast<uint32_t>(cxhelper::low_mask(Bits));
+
+  class const_iterator {
+    const packed_vec* vec_;
+    size_t index_;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = uint32_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = uint32_t;
+
+    const_iterator() : vec_(nullptr), index_(0) {}
+    const_iterator(const packed_vec* vec, size_t index) : vec_(vec), index_(index) {}
+    inline uint32_t operator*() const noexcept { return vec_->get(index_); }
+    inline const_iterator& operator++() noexcept {
+      index_++;
+      return *this;
+    }
+    inline const_iterator operator++(int) noexcept {
+      const_iterator copy = *this;
+      index_++;
+      return copy;
+    }
+    inline bool operator==(const const_iterator& other) const noexcept { return index_ == other.index_; }
+    inline bool operator!=(const const_iterator& other) const noexcept { return index_ != other.index_; }
+  };
+
+  packed_vec() : words_(1, 0) {}
+  /**
+   * @param n number of elements
+   * @param value initial value of all elements
+   */
+  explicit packed_vec(size_t n, uint32_t value = 0) : words_(1, 0) { resize(n, value); }
+  /**
+   * Packs n values - each must be at most max_value
+   */
+  packed_vec(const uint32_t* values, size_t n) : words_(1, 0) { append(values, n); }
+  packed_vec(std::initializer_list<uint32_t> list) : words_(1, 0) { append(list.begin(), list.size()); }
+
+  [[nodiscard]] inline uint32_t get(size_t i) const noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    return cxhelper::load_bits(bytes(), i * Bits, Bits);
+  }
+  [[nodiscard]] inline uint32_t operator[](size_t i) const noexcept { return get(i); }
+  [[nodiscard]] inline uint32_t at(size_t i) const {
+    if (i >= size_) {
+      throw std::out_of_range("index out of bounds");
+    }
+    return get(i);
+  }
+  inline void set(size_t i, uint32_t value) noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    CX_ASSERT(value <= max_value, "value does not fit into Bits");
+    cxhelper::store_bits(bytes(), i * Bits, Bits, value);
+  }
+  inline void push_back(uint32_t value) {
+    CX_ASSERT(value <= max_value, "value does not fit into Bits");
+    grow(size_ + 1);
+    cxhelper::store_bits(bytes(), size_ * Bits, Bits, value);
+    size_++;
+  }
+  inline void pop_back() noexcept {
+    CX_ASSERT(size_ > 0, "no elements to pop");
+    size_--;
+  }
+  [[nodiscard]] inline uint32_t back() const noexcept { return get(size_ - 1); }
+  /**
+   * Appends n values at once
+   */
+  inline void append(const uint32_t* values, size_t n) {
+    grow(size_ + n);
+    cxhelper::pack_bits(bytes(), size_, values, n, Bits);
+    size_ += n;
+  }
+  /**
+   * Decodes count elements starting at start into out
+   */
+  inline void unpack(size_t start, size_t count, uint32_t* out) const noexcept {
+    CX_ASSERT(start + count <= size_, "range out of bounds");
+    cxhelper::unpack_bits(bytes(), start, count, Bits, out);
+  }
+  /**
+   * Calls func(value) for every element in order, decoding 256 at a time
+   */
+  template <typename Function>
+  inline void for_each(Function func) const {
+    alignas(32) uint32_t buffer[256];
+    for (size_t i = 0; i < size_; i += 256) {
+      const size_t count = std::min<size_t>(256, size_ - i);
+      cxhelper::unpack_bits(bytes(), i, count, Bits, buffer);
+      for (size_t j = 0; j < count; j++) {
+        func(buffer[j]);
+      }
+    }
+  }
+  /**
+   * Changes the number of elements, new ones get the given value
+   */
+  inline void resize(size_t n, uint32_t value = 0) {
+    grow(n);
+    for (size_t i = size_; i < n; i++) {
+      cxhelper::store_bits(bytes(), i * Bits, Bits, value);
+    }
+    size_ = n;
+  }
+  inline void reserve(size_t n) {
+    if (words_for(n) > words_.size()) {
+      words_.resize(words_for(n), 0);
+    }
+  }
+  inline void shrink_to_fit() {
+    words_.resize(words_for(size_));
+    words_.shrink_to_fit();
+  }
+  inline void clear() noexcept { size_ = 0; }
+  [[nodiscard]] inline size_t size() const noexcept { return size_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+  [[nodiscard]] inline size_t capacity() const noexcept { return (words_.size() - 1) * 64 / Bits; }
+  /**
+   * @return the allocated bytes
+   */
+  [[nodiscard]] inline size_t memory_usage() const noexcept {
+    return sizeof(*this) + words_.capacity() * sizeof(uint64_t);
+  }
+  [[nodiscard]] inline const_iterator begin() const noexcept { return {this, 0}; }
+  [[nodiscard]] inline const_iterator end() const noexcept { return {this, size_}; }
+};
+
+/**
+ * <h2>delta_vec</h2>
+ * Append only vector for sorted (non decreasing) unsigned integers, e.g. timestamps or posting lists.
+ * <br><br>
+ * Values are grouped in blocks of 128 and stored as deltas to their predecessor. Each block picks the bit
+ * width that minimizes its size - deltas wider than that are stored as exceptions and patched in after
+ * unpacking (PFor), so a single large gap does not widen the whole block. The newest values (less than a
+ * block) stay uncompressed until the block is full.
+ * <br><br>
+ * The block table doubles as skip table: get(i) decodes only the front of one block, lower_bound() binary
+ * searches the block bases first. Scans unpack with AVX2 and do the prefix sum 8 lanes at a time.
+ * <pre>
+ * delta_vec<uint64_t> times;
+ * times.push_back(now);
+ * size_t first = times.lower_bound(start);
+ * </pre>
+ * @tparam T unsigned integer type
+ */
+template <typename T = uint32_t>
+class delta_vec {
+  static_assert(std::is_unsigned_v<T> && sizeof(T) <= 8, "delta_vec stores unsigned integers");
+  static_assert(std::endian::native == std::endian::little, "delta_vec assumes a little endian target");
+  using Block = cxhelper::DeltaBlock<T>;
+
+ public:
+  static constexpr size_t block_size = 128;
+
+ private:
+  std::vector<Block> blocks_;
+  std::vector<uint8_t> data_ = std::vector<uint8_t>(8, 0);
+  std::vector<uint8_t> exception_pos_;
+  std::vector<T> exception_high_;
+  std::array<T, block_size> tail_{};
+  size_t tail_size_ = 0;
+
+  // picks the width with the smallest block size: packed deltas + 1 byte position and a T per exception
+  [[nodiscard]] static uint32_t best_width(const T* deltas) noexcept {
+    size_t widths[65]{};
+    for (size_t i = 0; i < block_size; i++) {
+      widths[static_cast<size_t>(std::bit_width(deltas[i]))]++;
+    }
+    size_t best = SIZE_MAX, wider = block_size;
+    uint32_t best_bits = 32;
+    for (uint32_t bits = 0; bits <= 32; bits++) {
+      wider -= widths[bits];
+      const size_t cost = block_size * bits + wider * (8 + 8 * sizeof(T));
+      if (cost < best) {
+        best = cost;
+        best_bits = bits;
+      }
+    }
+    return best_bits;
+  }
+  inline void encode_tail() {
+    T deltas[block_size];
+    deltas[0] = 0;
+    for (size_t i = 1; i < block_size; i++) {
+      deltas[i] = tail_[i] - tail_[i - 1];
+    }
+    const uint32_t bits = best_width(deltas);
+    Block block{tail_[0], data_.size() - 8, static_cast<uint32_t>(exception_pos_.size()),
+                static_cast<uint8_t>(bits), 0};
+    uint32_t low[block_size];
+    for (size_t i = 0; i < block_size; i++) {
+      low[i] = static_cast<uint32_t>(deltas[i] & cxhelper::low_mask(bits));
+      if (static_cast<uint32_t>(std::bit_width(deltas[i])) > bits) {
+        exception_pos_.push_back(static_cast<uint8_t>(i));
+        exception_high_.push_back(static_cast<T>(deltas[i] >> bits));
+        block.exception_count++;
+      }
+    }
+    // block_size * bits / 8 new bytes, the old padding is reused and new padding appended
+    data_.resize(data_.size() + block_size * bits / 8, 0);
+    cxhelper::pack_bits(data_.data() + block.offset, 0, low, block_size, bits);
+    blocks_.push_back(block);
+    tail_size_ = 0;
+  }
+  // decodes the first count values of a block into out
+  inline void decode(const Block& block, size_t count, T* out) const noexcept {
+    if constexpr (sizeof(T) == 4) {
+      cxhelper::unpack_bits(data_.data() + block.offset, 0, count, block.bits, out);
+    } else {
+      alignas(32) uint32_t low[block_size];
+      cxhelper::unpack_bits(data_.data() + block.offset, 0, count, block.bits, low);
+      std::copy(low, low + count, out);
+    }
+    for (uint32_t e = block.exceptions; e < block.exceptions + block.exception_count; e++) {
+      if (exception_pos_[e] < count) {
+        out[exception_pos_[e]] |= exception_high_[e] << block.bits;
+      }
+    }
+    if constexpr (sizeof(T) == 4) {
+      cxhelper::prefix_sum_u32(out, count, block.base);
+    } else {
+      cxhelper::prefix_sum_scalar(out, count, block.base);
+    }
+  }
+
+ public:
+  delta_vec() = default;
+  /**
+   * Appends a value - must not be smaller than the last one
+   */
+  inline void push_back(T value) {
+    CX_ASSERT(empty() || value >= back(), "delta_vec values must be non decreasing");
+    tail_[tail_size_++] = value;
+    if (tail_size_ == block_size) {
+      encode_tail();
+    }
+  }
+  /**
+   * Appends n sorted values
+   */
+  inline void append(const T* values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      push_back(values[i]);
+    }
+  }
+  /**
+   * Random access - decodes the block up to i
+   */
+  [[nodiscard]] inline T get(size_t i) const noexcept {
+    CX_ASSERT(i < size(), "index out of bounds");
+    const size_t block = i / block_size;
+    if (block == blocks_.size()) {
+      return tail_[i % block_size];
+    }
+    alignas(32) T values[block_size];
+    decode(blocks_[block], i % block_size + 1, values);
+    return values[i % block_size];
+  }
+  [[nodiscard]] inline T operator[](size_t i) const noexcept { return get(i); }
+  [[nodiscard]] inline T at(size_t i) const {
+    if (i >= size()) {
+      throw std::out_of_range("index out of bounds");
+    }
+    return get(i);
+  }
+  [[nodiscard]] inline T back() const noexcept {
+    CX_ASSERT(!empty(), "no elements");
+    return tail_size_ > 0 ? tail_[tail_size_ - 1] : get(size() - 1);
+  }
+  /**
+   * @return the index of the first value not less than value, size() if there is none
+   */
+  [[nodiscard]] inline size_t lower_bound(T value) const noexcept {
+    // first block whose base is >= value - the answer lies in the block before it or at its start
+    const auto it = std::lower_bound(blocks_.begin(), blocks_.end(), value,
+                                     [](const Block& block, T v) { return block.base < v; });
+    size_t block = it - blocks_.begin();
+    if (block > 0) {
+      alignas(32) T values[block_size];
+      decode(blocks_[block - 1], block_size, values);
+      const size_t pos = std::lower_bound(values, values + block_size, value) - values;
+      if (pos < block_size) {
+        return (block - 1) * block_size + pos;
+      }
+    }
+    if (block < blocks_.size()) {
+      return block * block_size;
+    }
+    return blocks_.size() * block_size +
+           (std::lower_bound(tail_.begin(), tail_.begin() + tail_size_, value) - tail_.begin());
+  }
+  [[nodiscard]] inline bool contains(T value) const noexcept {
+    const size_t i = lower_bound(value);
+    return i < size() && get(i) == value;
+  }
+  /**
+   * Calls func(value) for every value in order, one block at a time
+   */
+  template <typename Function>
+  inline void for_each(Function func) const {
+    alignas(32) T values[block_size];
+    for (const Block& block : blocks_) {
+      decode(block, block_size, values);
+      for (size_t i = 0; i < block_size; i++) {
+        func(values[i]);
+      }
+    }
+    for (size_t i = 0; i < tail_size_; i++) {
+      func(tail_[i]);
+    }
+  }
+  /**
+   * Decodes all values into out, which must hold size() elements
+   */
+  inline void copy_to(T* out) const noexcept {
+    for (const Block& block : blocks_) {
+      decode(block, block_size, out);
+      out += block_size;
+    }
+    std::copy(tail_.begin(), tail_.begin() + tail_size_, out);
+  }
+  inline void clear() noexcept {
+    blocks_.clear();
+    data_.assign(8, 0);
+    exception_pos_.clear();
+    exception_high_.clear();
+    tail_size_ = 0;
+  }
+  inline void shrink_to_fit() {
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+    exception_pos_.shrink_to_fit();
+    exception_high_.shrink_to_fit();
+  }
+  [[nodiscard]] inline size_t size() const noexcept { return blocks_.size() * block_size + tail_size_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size() == 0; }
+  /**
+   * @return the number of deltas stored as exceptions
+   */
+  [[nodiscard]] inline size_t exceptions() const noexcept { return exception_pos_.size(); }
+  /**
+   * @return the allocated bytes
+   */
+  [[nodiscard]] inline size_t memory_usage() const noexcept {
+    return sizeof(*this) + blocks_.capacity() * sizeof(Block) + data_.capacity() +
+           exception_pos_.capacity() + exception_high_.capacity() * sizeof(T);
+  }
+};
+}  // namespace cxstructs
+
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_PACKED_VEC_H_
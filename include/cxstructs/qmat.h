@@ -0,0 +1,315 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_QMAT_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_QMAT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+#include "mat.h"
+
+// Weight-only quantized matrices for inference - the inputs and outputs stay float
+// The weights are stored transposed, so every stored row is one output column and is read front to back
+// The kernels convert 8 weights at a time to float (AVX2, F16C for half) and reuse them for 4 input rows
+
+namespace cxstructs {
+/**
+ * IEEE 754 half precision float - storage only, convert to float for math
+ */
+struct half {
+  uint16_t bits_ = 0;
+
+  half() = default;
+  explicit half(float f) : bits_(from_float(f)) {}
+  explicit operator float() const noexcept { return to_float(bits_); }
+
+  /**
+   * Rounds to the nearest representable value, ties to even
+   */
+  static inline uint16_t from_float(float f) noexcept {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(float));
+    const uint32_t sign = (x >> 16) & 0x8000U;
+    const uint32_t abs = x & 0x7FFFFFFFU;
+    if (abs >= 0x7F800000U) {  // inf and nan
+      return sign | 0x7C00U | (abs > 0x7F800000U ? 0x200U : 0U);
+    }
+    if (abs >= 0x477FF000U) {  // rounds above 65504
+      return sign | 0x7C00U;
+    }
+    if (abs < 0x38800000U) {  // half subnormals
+      if (abs < 0x33000000U) {
+        return sign;
+      }
+      const uint32_t mant = (abs & 0x7FFFFFU) | 0x800000U;
+      const uint32_t shift = 126 - (abs >> 23);
+      uint32_t m = mant >> shift;
+      const uint32_t rem = mant & ((1U << shift) - 1);
+      const uint32_t halfway = 1U << (shift - 1);
+      if (rem > halfway || (rem == halfway && (m & 1U))) {
+        m++;
+      }
+      return sign | m;
+    }
+    uint32_t h = (abs - 0x38000000U) >> 13;
+    const uint32_t rem = abs & 0x1FFFU;
+    if (rem > 0x1000U || (rem == 0x1000U && (h & 1U))) {
+      h++;
+    }
+    return sign | h;
+  }
+  static inline float to_float(uint16_t h) noexcept {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000U) << 16;
+    const uint32_t exp = (h >> 10) & 0x1FU;
+    const uint32_t mant = h & 0x3FFU;
+    uint32_t bits;
+    if (exp == 0) {
+      const float val = static_cast<float>(mant) * 5.9604645e-8F;  // mant * 2^-24
+      return sign ? -val : val;
+    } else if (exp == 31) {
+      bits = sign | 0x7F800000U | (mant << 13);
+    } else {
+      bits = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(float));
+    return f;
+  }
+};
+/**
+ * Storage precision of inference weights
+ */
+enum class Precision : uint8_t { FP32, FP16, INT8 };
+}  // namespace cxstructs
+
+namespace cxhelper {
+using cxstructs::half;
+constexpr uint_32_cx kQRows = 4;  // input rows sharing one pass over a weight row
+
+template <typename T>
+inline float q_to_float(T val) noexcept {
+  if constexpr (std::is_same_v<T, half>) {
+    return half::to_float(val.bits_);
+  } else {
+    return static_cast<float>(val);
+  }
+}
+#if defined(CX_AVX2)
+template <typename T>
+constexpr bool kQVectorized = std::is_same_v<T, int8_t>
+#if defined(CX_F16C)
+                              || std::is_same_v<T, half>
+#endif
+    ;
+// converts 8 stored weights to floats
+template <typename T>
+inline __m256 q_load8(const T* ptr) noexcept {
+  if constexpr (std::is_same_v<T, int8_t>) {
+    const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+  } else {
+#if defined(CX_F16C)
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)));
+#else
+    return _mm256_setzero_ps();
+#endif
+  }
+}
+inline float hsum256(__m256 v) noexcept {
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 shuf = _mm_movehdup_ps(lo);
+  __m128 sums = _mm_add_ps(lo, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+#endif
+/**
+ * C[rows x (n_begin..n_end)] = act(A * W^T * scale + bias) for transposed quantized weights W[N x K]
+ * @param scales one per output column - nullptr for 1
+ */
+template <typename T>
+inline void qgemm(const float* A, uint_32_cx lda, uint_32_cx rows, const T* W, uint_32_cx K,
+                  const float* scales, const float* bias, float (*act)(float), float* C,
+                  uint_32_cx ldc, uint_32_cx n_begin, uint_32_cx n_end) {
+  for (uint_32_cx b0 = 0; b0 < rows; b0 += kQRows) {
+    const uint_32_cx r_count = std::min(kQRows, rows - b0);
+    const float* a[kQRows];
+    for (uint_32_cx r = 0; r < kQRows; r++) {
+      a[r] = A + (b0 + (r < r_count ? r : 0)) * lda;  // missing rows repeat the first one
+    }
+    for (uint_32_cx n = n_begin; n < n_end; n++) {
+      const T* w = W + n * K;
+      float acc[kQRows] = {0, 0, 0, 0};
+      uint_32_cx k = 0;
+#if defined(CX_AVX2)
+      if constexpr (kQVectorized<T>) {
+        __m256 sums[kQRows];
+        for (auto& sum : sums) {
+          sum = _mm256_setzero_ps();
+        }
+        for (; k + 8 <= K; k += 8) {
+          const __m256 wv = q_load8(w + k);
+          for (uint_32_cx r = 0; r < kQRows; r++) {
+#if defined(CX_FMA)
+            sums[r] = _mm256_fmadd_ps(_mm256_loadu_ps(a[r] + k), wv, sums[r]);
+#else
+            sums[r] = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a[r] + k), wv), sums[r]);
+#endif
+          }
+        }
+        for (uint_32_cx r = 0; r < kQRows; r++) {
+          acc[r] = hsum256(sums[r]);
+        }
+      }
+#endif
+      for (; k < K; k++) {
+        const float wf = q_to_float(w[k]);
+        for (uint_32_cx r = 0; r < kQRows; r++) {
+          acc[r] += a[r][k] * wf;
+        }
+      }
+      const float scale = scales ? scales[n] : 1.0F;
+      const float b = bias ? bias[n] : 0.0F;
+      for (uint_32_cx r = 0; r < r_count; r++) {
+        C[(b0 + r) * ldc + n] = acc[r] * scale + b;
+      }
+    }
+    if (act) {
+      for (uint_32_cx r = 0; r < r_count; r++) {
+        gemm_activate(C + (b0 + r) * ldc + n_begin, n_end - n_begin, act);
+      }
+    }
+  }
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>Quantized Matrix</h2>
+ * A read-only, reduced precision copy of a float mat meant for the weights of inference workloads.
+ * <br><br>
+ * <b>half</b> halves the memory, <b>int8_t</b> quarters it and stores one float scale per column
+ * (max |value| / 127). The values are stored transposed, so every column of the original matrix is one
+ * contiguous stored row and its scale is a per (stored) row scale.<br>
+ * Multiplying keeps the inputs in float and converts the weights on the fly, which pays off when
+ * the weights do not fit the caches and memory bandwidth is the limit.
+ * @tparam T int8_t or cxstructs::half
+ */
+template <typename T>
+class qmat {
+  static_assert(std::is_same_v<T, int8_t> || std::is_same_v<T, half>, "qmat holds int8_t or half");
+  std::vector<T> data_;        // n_cols_ x n_rows_ - transposed
+  std::vector<float> scales_;  // int8 only - one per column
+  uint_32_cx n_rows_ = 0;
+  uint_32_cx n_cols_ = 0;
+
+ public:
+  qmat() = default;
+  /**
+   * Quantizes the given matrix
+   * @param m the float matrix - not referenced afterwards
+   */
+  explicit qmat(const mat& m)
+      : data_(m.n_rows() * m.n_cols()), n_rows_(m.n_rows()), n_cols_(m.n_cols()) {
+    if constexpr (std::is_same_v<T, int8_t>) {
+      scales_.resize(n_cols_);
+    }
+    for (uint_32_cx j = 0; j < n_cols_; j++) {
+      T* dst = data_.data() + j * n_rows_;
+      if constexpr (std::is_same_v<T, int8_t>) {
+        float max_abs = 0;
+        for (uint_32_cx i = 0; i < n_rows_; i++) {
+          max_abs = std::max(max_abs, std::abs(m(i, j)));
+        }
+        const float scale = max_abs > 0 ? max_abs / 127.0F : 1.0F;
+        scales_[j] = scale;
+        for (uint_32_cx i = 0; i < n_rows_; i++) {
+          const float q = std::round(m(i, j) / scale);
+          dst[i] = static_cast<int8_t>(std::clamp(q, -127.0F, 127.0F));
+        }
+      } else {
+        for (uint_32_cx i = 0; i < n_rows_; i++) {
+          dst[i] = half(m(i, j));
+        }
+      }
+    }
+  }
+  /**
+   * @return the dequantized value at (row, col)
+   */
+  inline float operator()(uint_32_cx row, uint_32_cx col) const {
+    const float val = cxhelper::q_to_float(data_[col * n_rows_ + row]);
+    return scales_.empty() ? val : val * scales_[col];
+  }
+  /**
+   * @return a float copy - exactly the values the kernels compute with
+   */
+  [[nodiscard]] mat dequantize() const {
+    mat ret(n_rows_, n_cols_);
+    for (uint_32_cx i = 0; i < n_rows_; i++) {
+      for (uint_32_cx j = 0; j < n_cols_; j++) {
+        ret(i, j) = (*this)(i, j);
+      }
+    }
+    return ret;
+  }
+  /**
+   * @return the memory used by the values and scales in bytes
+   */
+  [[nodiscard]] inline size_t bytes() const noexcept {
+    return data_.size() * sizeof(T) + scales_.size() * sizeof(float);
+  }
+  [[nodiscard]] inline uint_32_cx n_rows() const noexcept { return n_rows_; }
+  [[nodiscard]] inline uint_32_cx n_cols() const noexcept { return n_cols_; }
+  /**
+   * C = act(A * B + bias) with quantized B - the counterpart of the float affine_into()
+   * @param A batch x in inputs
+   * @param B in x out quantized weights
+   * @param bias 1 x out row added to every row
+   * @param act activation applied to every element - nullptr for none
+   * @param C batch x out output - resized to fit
+   */
+  friend void affine_into(const mat_view& A, const qmat& B, const mat& bias, float (*act)(float),
+                          mat& C) {
+    CX_ASSERT(A.n_cols() == B.n_rows_ && bias.n_rows() == 1 && bias.n_cols() == B.n_cols_,
+              "invalid dimensions");
+    C.resize(A.n_rows(), B.n_cols_);
+    const float* scales = B.scales_.empty() ? nullptr : B.scales_.data();
+    auto run = [&](uint_32_cx begin, uint_32_cx end) {
+      cxhelper::qgemm(A.data(), A.stride(), A.n_rows(), B.data_.data(), B.n_rows_, scales,
+                      bias.get_raw(), act, C.get_raw(), C.n_cols(), begin, end);
+    };
+    const uint64_t work = static_cast<uint64_t>(A.n_rows()) * B.n_rows_ * B.n_cols_;
+    if (work >= static_cast<uint64_t>(mat::parallel_threshold()) * 64 &&
+        ThreadPool::global().size() > 0) {
+      ThreadPool::global().parallel_for(0, B.n_cols_, run, 16);
+    } else {
+      run(0, B.n_cols_);
+    }
+  }
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_QMAT_H_
@@ -22,10 +22,121 @@
 #define CXSTRUCTS_SRC_DATASTRUCTURES_ROW_H_
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <initializer_list>
 #include <type_traits>
+#include <utility>
 #include "../cxconfig.h"
 
+// unrolled kernels on N contiguous values - used by row, fixed_mat and kTree
+namespace cxhelper {
+// expands f(0) + f(1) + ... + f(N-1) at compile time
+template <uint_32_cx N, typename T, typename F>
+constexpr T unrolled_sum(F&& f) noexcept {
+  return [&]<std::size_t... I>(std::index_sequence<I...>) {
+    return (T(0) + ... + f(static_cast<uint_32_cx>(I)));
+  }(std::make_index_sequence<N>{});
+}
+template <uint_32_cx N, typename T, typename F>
+constexpr T unrolled_max(F&& f) noexcept {
+  T result = 0;
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    ((result = std::max(result, f(static_cast<uint_32_cx>(I)))), ...);
+  }(std::make_index_sequence<N>{});
+  return result;
+}
+template <typename T>
+constexpr T abs_cx(T val) noexcept {
+  return val < T(0) ? -val : val;
+}
+// float rows of 4 and 8 use SSE/AVX/NEON when not evaluated at compile time
+template <uint_32_cx N, typename T>
+inline constexpr bool row_simd_v = std::is_same_v<T, float> && (N == 4 || N == 8);
+#if defined(CX_SSE2)
+inline float hsum128(__m128 v) noexcept {
+  __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(v, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+#endif
+// the simd paths for dot (kDiff = false) and squared distance (kDiff = true)
+template <uint_32_cx N, bool kDiff>
+inline float row_simd_sum(const float* a, const float* b) noexcept {
+#if defined(CX_AVX2)
+  if constexpr (N == 8) {
+    __m256 v = _mm256_loadu_ps(a);
+    if constexpr (kDiff) {
+      v = _mm256_sub_ps(v, _mm256_loadu_ps(b));
+      v = _mm256_mul_ps(v, v);
+    } else {
+      v = _mm256_mul_ps(v, _mm256_loadu_ps(b));
+    }
+    return hsum128(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+  }
+#endif
+#if defined(CX_SSE2)
+  __m128 acc = _mm_setzero_ps();
+  for (uint_32_cx i = 0; i < N; i += 4) {
+    __m128 v = _mm_loadu_ps(a + i);
+    if constexpr (kDiff) {
+      v = _mm_sub_ps(v, _mm_loadu_ps(b + i));
+      v = _mm_mul_ps(v, v);
+    } else {
+      v = _mm_mul_ps(v, _mm_loadu_ps(b + i));
+    }
+    acc = _mm_add_ps(acc, v);
+  }
+  return hsum128(acc);
+#elif defined(CX_NEON) && defined(__aarch64__)
+  float32x4_t acc = vdupq_n_f32(0);
+  for (uint_32_cx i = 0; i < N; i += 4) {
+    float32x4_t v = vld1q_f32(a + i);
+    if constexpr (kDiff) {
+      v = vsubq_f32(v, vld1q_f32(b + i));
+      acc = vmlaq_f32(acc, v, v);
+    } else {
+      acc = vmlaq_f32(acc, v, vld1q_f32(b + i));
+    }
+  }
+  return vaddvq_f32(acc);
+#else
+  if constexpr (kDiff) {
+    return unrolled_sum<N, float>([&](uint_32_cx i) { return (a[i] - b[i]) * (a[i] - b[i]); });
+  } else {
+    return unrolled_sum<N, float>([&](uint_32_cx i) { return a[i] * b[i]; });
+  }
+#endif
+}
+template <uint_32_cx N, typename T>
+constexpr T row_dot(const T* a, const T* b) noexcept {
+  if constexpr (row_simd_v<N, T>) {
+    if (!std::is_constant_evaluated()) {
+      return row_simd_sum<N, false>(a, b);
+    }
+  }
+  return unrolled_sum<N, T>([&](uint_32_cx i) { return a[i] * b[i]; });
+}
+template <uint_32_cx N, typename T>
+constexpr T row_squared_distance(const T* a, const T* b) noexcept {
+  if constexpr (row_simd_v<N, T>) {
+    if (!std::is_constant_evaluated()) {
+      return row_simd_sum<N, true>(a, b);
+    }
+  }
+  return unrolled_sum<N, T>([&](uint_32_cx i) { return (a[i] - b[i]) * (a[i] - b[i]); });
+}
+template <uint_32_cx N, typename T>
+constexpr T row_manhattan_distance(const T* a, const T* b) noexcept {
+  return unrolled_sum<N, T>([&](uint_32_cx i) { return abs_cx(a[i] - b[i]); });
+}
+template <uint_32_cx N, typename T>
+constexpr T row_chebyshev_distance(const T* a, const T* b) noexcept {
+  return unrolled_max<N, T>([&](uint_32_cx i) { return abs_cx(a[i] - b[i]); });
+}
+}  // namespace cxhelper
+
 namespace cxstructs {
 
 /**
@@ -39,7 +150,11 @@ namespace cxstructs {
  * dynamic memory allocation and resizing.<p>
  *
  * It is non-mutable so its size cannot be changed after construction,
- * and elements cannot be inserted or removed.
+ * and elements cannot be inserted or removed.<p>
+ *
+ * It doubles as a small vector for linear algebra (see fixed_mat). All operations are constexpr and
+ * unrolled at compile time, so they compile down to straight-line code. Float rows of 4 and 8 use
+ * SSE/AVX (NEON) for dot products and distances when evaluated at runtime.
  *
  * @tparam n_elem The number of elements in the row (fixed at compile-time).
  * @tparam T The type of elements in the row. Defaults to `float`.
@@ -48,20 +163,29 @@ template <uint_32_cx n_elem, typename T = float>
 class row {
   T arr_[n_elem];
 
+  template <typename F>
+  [[nodiscard]] constexpr row map(F&& f) const noexcept {
+    row result;
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((result.arr_[I] = f(static_cast<uint_32_cx>(I))), ...);
+    }(std::make_index_sequence<n_elem>{});
+    return result;
+  }
+
  public:
   /**
    * @brief Default constructor.
    *
    * Initializes the elements with default values.
    */
-  inline row() = default;
+  constexpr row() = default;
 
   /**
    * @brief Constructs a row with all elements initialized to the given value.
    *
    * @param val The value to initialize all elements with.
    */
-  inline explicit row(const T val) { std::fill(arr_, arr_ + n_elem, val); }
+  constexpr explicit row(const T val) { std::fill(arr_, arr_ + n_elem, val); }
 
   /**
    * @brief Constructs a row with elements initialized using a provided function.
@@ -71,23 +195,31 @@ class row {
    */
   template <typename fill_form,
             typename = std::enable_if_t<std::is_invocable_r_v<T, fill_form, uint_32_cx>>>
-  inline explicit row(fill_form form) {
+  constexpr explicit row(fill_form form) {
     for (uint_32_cx i = 0; i < n_elem; i++) {
       arr_[i] = form(i);
     }
   }
-  row(std::initializer_list<T> init_list) {
+  constexpr row(std::initializer_list<T> init_list) {
     CX_ASSERT(init_list.size() == n_elem, "");
     std::copy(init_list.begin(), init_list.end(), arr_);
   }
+  /**
+   * @brief Copies n_elem values from the given pointer.
+   */
+  [[nodiscard]] static constexpr row load(const T* ptr) noexcept {
+    row result;
+    std::copy_n(ptr, n_elem, result.arr_);
+    return result;
+  }
   /**
    * @brief Accesses the element at the specified index.
    *
    * @param i The index of the element to access.
    * @return A reference to the element at the specified index.
    */
-  [[nodiscard]] inline T& operator[](const uint_32_cx& i) { return arr_[i]; }
-  [[nodiscard]] inline const T& operator[](const uint_32_cx& i) const { return arr_[i]; }
+  [[nodiscard]] constexpr T& operator[](const uint_32_cx& i) { return arr_[i]; }
+  [[nodiscard]] constexpr const T& operator[](const uint_32_cx& i) const { return arr_[i]; }
 
   /**
    * @brief Returns the number of elements in the row.
@@ -95,6 +227,75 @@ class row {
    * @return The number of elements in the row.
    */
   [[nodiscard]] constexpr inline uint_32_cx size() const { return n_elem; }
+  [[nodiscard]] constexpr T* data() noexcept { return arr_; }
+  [[nodiscard]] constexpr const T* data() const noexcept { return arr_; }
+  [[nodiscard]] constexpr T* begin() noexcept { return arr_; }
+  [[nodiscard]] constexpr T* end() noexcept { return arr_ + n_elem; }
+  [[nodiscard]] constexpr const T* begin() const noexcept { return arr_; }
+  [[nodiscard]] constexpr const T* end() const noexcept { return arr_ + n_elem; }
+
+  [[nodiscard]] constexpr row operator+(const row& o) const noexcept {
+    return map([&](uint_32_cx i) { return arr_[i] + o.arr_[i]; });
+  }
+  [[nodiscard]] constexpr row operator-(const row& o) const noexcept {
+    return map([&](uint_32_cx i) { return arr_[i] - o.arr_[i]; });
+  }
+  [[nodiscard]] constexpr row operator-() const noexcept {
+    return map([&](uint_32_cx i) { return -arr_[i]; });
+  }
+  [[nodiscard]] constexpr row operator*(T scalar) const noexcept {
+    return map([&](uint_32_cx i) { return arr_[i] * scalar; });
+  }
+  [[nodiscard]] constexpr row operator/(T scalar) const noexcept {
+    return map([&](uint_32_cx i) { return arr_[i] / scalar; });
+  }
+  constexpr row& operator+=(const row& o) noexcept { return *this = *this + o; }
+  constexpr row& operator-=(const row& o) noexcept { return *this = *this - o; }
+  constexpr row& operator*=(T scalar) noexcept { return *this = *this * scalar; }
+  constexpr row& operator/=(T scalar) noexcept { return *this = *this / scalar; }
+  [[nodiscard]] constexpr bool operator==(const row& o) const noexcept {
+    return std::equal(arr_, arr_ + n_elem, o.arr_);
+  }
+  /**
+   * @return the element-wise (hadamard) product
+   */
+  [[nodiscard]] constexpr row hadamard(const row& o) const noexcept {
+    return map([&](uint_32_cx i) { return arr_[i] * o.arr_[i]; });
+  }
+  [[nodiscard]] constexpr T dot(const row& o) const noexcept {
+    return cxhelper::row_dot<n_elem>(arr_, o.arr_);
+  }
+  [[nodiscard]] constexpr T squared_norm() const noexcept { return dot(*this); }
+  [[nodiscard]] inline T norm() const noexcept { return std::sqrt(squared_norm()); }
+  /**
+   * @return this row scaled to unit length - unchanged if it has length 0
+   */
+  [[nodiscard]] inline row normalized() const noexcept {
+    const T length = norm();
+    return length == T(0) ? *this : *this / length;
+  }
+  [[nodiscard]] constexpr T squared_distance(const row& o) const noexcept {
+    return cxhelper::row_squared_distance<n_elem>(arr_, o.arr_);
+  }
+  [[nodiscard]] inline T distance(const row& o) const noexcept {
+    return std::sqrt(squared_distance(o));
+  }
+  [[nodiscard]] constexpr T manhattan_distance(const row& o) const noexcept {
+    return cxhelper::row_manhattan_distance<n_elem>(arr_, o.arr_);
+  }
+  [[nodiscard]] constexpr T chebyshev_distance(const row& o) const noexcept {
+    return cxhelper::row_chebyshev_distance<n_elem>(arr_, o.arr_);
+  }
+  /**
+   * @return the cross product - only for rows of 3
+   */
+  [[nodiscard]] constexpr row cross(const row& o) const noexcept
+    requires(n_elem == 3)
+  {
+    return {arr_[1] * o.arr_[2] - arr_[2] * o.arr_[1], arr_[2] * o.arr_[0] - arr_[0] * o.arr_[2],
+            arr_[0] * o.arr_[1] - arr_[1] * o.arr_[0]};
+  }
+  friend constexpr row operator*(T scalar, const row& r) noexcept { return r * scalar; }
 };
 
 }  // namespace cxstructs
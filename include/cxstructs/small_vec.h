@@ -0,0 +1,437 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_SMALLVEC_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_SMALLVEC_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include "../cxalgos/Sorting.h"
+#include "../cxconfig.h"
+#include "vec.h"
+
+// vec with inline storage for the first N elements, only spills to the heap (through the policy allocator) when it outgrows them
+// Meant for the many short lists of a program: per entity component lists, neighbour lists, small result buffers
+// An empty or small small_vec is one allocation free object, moving a small one relocates the elements into the target
+
+namespace cxstructs {
+
+/**
+ * <h2>small_vec</h2>
+ * A dynamic array with inline storage for N elements.
+ * <br><br>
+ * Has the interface of cxstructs::vec, including its Iterator, but the first N elements live inside the
+ * object itself. Only when the (N+1)th element is added the elements are relocated to a heap array of twice the size.
+ * clear() and shrink_to_fit() go back to the inline storage if the elements fit.
+ * <br><br>
+ * References and iterators are invalidated on growth <b>and</b> on moves of small small_vecs.
+ *
+ * @tparam T element type
+ * @tparam N number of inline elements
+ * @tparam Policy allocation policy of the heap array
+ */
+template <typename T, uint_32_cx N = 8, AllocPolicy Policy = PoolAlloc>
+class small_vec {
+  static_assert(N > 0, "small_vec needs inline storage, use vec otherwise");
+
+ public:
+  using value_type = T;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = uint_32_cx;
+  using iterator = T*;
+  using const_iterator = const T*;
+  using Iterator = typename vec<T, Policy>::Iterator;
+
+ private:
+  template <typename, uint_32_cx, AllocPolicy>
+  friend class small_vec;
+  using Allocator = cxhelper::policy_allocator_t<T, Policy>;
+  static constexpr bool kTrivialDestr = std::is_trivially_destructible_v<T>;
+
+  Allocator alloc;
+  T* arr_;
+  uint_32_cx size_ = 0;
+  uint_32_cx len_ = N;
+  alignas(T) unsigned char buf_[N * sizeof(T)];
+
+  [[nodiscard]] inline T* inline_buf() noexcept { return reinterpret_cast<T*>(buf_); }
+  inline void destroy_range(T* first, uint_32_cx n) noexcept {
+    if constexpr (!kTrivialDestr) {
+      for (uint_32_cx i = 0; i < n; i++) {
+        std::allocator_traits<Allocator>::destroy(alloc, first + i);
+      }
+    }
+  }
+  // moves n elements into uninitialized memory and ends their lifetime at the source
+  inline void relocate(T* src, uint_32_cx n, T* dst) noexcept {
+    if constexpr (cxhelper::is_trivially_relocatable_v<T>) {
+      if (n > 0) {
+        std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
+      }
+    } else {
+      for (uint_32_cx i = 0; i < n; i++) {
+        std::allocator_traits<Allocator>::construct(alloc, dst + i, std::move_if_noexcept(src[i]));
+        std::allocator_traits<Allocator>::destroy(alloc, src + i);
+      }
+    }
+  }
+  inline void copy_construct(const T* src, uint_32_cx n, T* dst) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (n > 0) {
+        std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
+      }
+    } else {
+      std::uninitialized_copy(src, src + n, dst);
+    }
+  }
+  inline void release_heap() noexcept {
+    if (!is_small()) {
+      alloc.deallocate(arr_, len_);
+    }
+    arr_ = inline_buf();
+    len_ = N;
+  }
+  // moves the elements to a new array of new_len, which is the inline buffer if new_len <= N
+  inline void reallocate(uint_32_cx new_len) noexcept {
+    if (new_len <= N) {
+      if (!is_small()) {
+        T* old = arr_;
+        relocate(old, size_, inline_buf());
+        alloc.deallocate(old, len_);
+        arr_ = inline_buf();
+        len_ = N;
+      }
+      return;
+    }
+    T* n_arr = alloc.allocate(new_len);
+    relocate(arr_, size_, n_arr);
+    if (!is_small()) {
+      alloc.deallocate(arr_, len_);
+    }
+    arr_ = n_arr;
+    len_ = new_len;
+  }
+  // slow path of emplace_back, args may point into the old array so the new element is built first
+  template <typename... Args>
+  inline void grow_emplace(Args&&... args) {
+    const uint_32_cx new_len = len_ * 2;
+    T* n_arr = alloc.allocate(new_len);
+    std::allocator_traits<Allocator>::construct(alloc, n_arr + size_, std::forward<Args>(args)...);
+    relocate(arr_, size_, n_arr);
+    if (!is_small()) {
+      alloc.deallocate(arr_, len_);
+    }
+    arr_ = n_arr;
+    len_ = new_len;
+    size_++;
+  }
+  inline void append_range(const T* src, uint_32_cx n) {
+    if (len_ - size_ < n) {
+      reallocate(std::max(len_ * 2, size_ + n));
+    }
+    copy_construct(src, n, arr_ + size_);
+    size_ += n;
+  }
+  // takes the elements of o, stealing its heap array if it has one
+  template <uint_32_cx M>
+  inline void take(small_vec<T, M, Policy>& o) noexcept {
+    if (o.is_small()) {
+      reserve(o.size_);
+      relocate(o.arr_, o.size_, arr_);
+      size_ = o.size_;
+    } else if (o.len_ <= N) {
+      relocate(o.arr_, o.size_, arr_);
+      size_ = o.size_;
+      o.alloc.deallocate(o.arr_, o.len_);
+    } else {
+      arr_ = o.arr_;
+      len_ = o.len_;
+      size_ = o.size_;
+    }
+    o.arr_ = o.inline_buf();
+    o.len_ = M;
+    o.size_ = 0;
+  }
+
+ public:
+  inline small_vec() noexcept : arr_(inline_buf()) {}
+  inline small_vec(uint_32_cx n_elems, const T fillVal) : arr_(inline_buf()) {
+    reserve(n_elems);
+    std::uninitialized_fill(arr_, arr_ + n_elems, fillVal);
+    size_ = n_elems;
+  }
+  inline small_vec(std::initializer_list<T> init_list) : arr_(inline_buf()) {
+    append_range(init_list.begin(), init_list.size());
+  }
+  inline small_vec(const T* data, uint_32_cx n_elem) : arr_(inline_buf()) { append_range(data, n_elem); }
+  inline small_vec(const small_vec& o) : arr_(inline_buf()) { append_range(o.arr_, o.size_); }
+  template <uint_32_cx M>
+  inline explicit small_vec(const small_vec<T, M, Policy>& o) : arr_(inline_buf()) {
+    append_range(o.arr_, o.size_);
+  }
+  template <AllocPolicy P>
+  inline explicit small_vec(const vec<T, P>& o) : arr_(inline_buf()) {
+    append_range(o.get_raw(), o.size());
+  }
+  inline small_vec(small_vec&& o) noexcept : arr_(inline_buf()) { take(o); }
+  template <uint_32_cx M>
+  inline small_vec(small_vec<T, M, Policy>&& o) noexcept : arr_(inline_buf()) {
+    take(o);
+  }
+  inline small_vec& operator=(const small_vec& o) {
+    if (this != &o) {
+      destroy_range(arr_, size_);
+      size_ = 0;
+      append_range(o.arr_, o.size_);
+    }
+    return *this;
+  }
+  inline small_vec& operator=(small_vec&& o) noexcept {
+    if (this != &o) {
+      destroy_range(arr_, size_);
+      size_ = 0;
+      release_heap();
+      take(o);
+    }
+    return *this;
+  }
+  inline ~small_vec() {
+    destroy_range(arr_, size_);
+    release_heap();
+  }
+  /**
+   * Direct access to the underlying array
+   * @param index the accessed index
+   * @return a reference to the value
+   */
+  [[nodiscard]] inline T& operator[](const uint_32_cx& index) const noexcept {
+    CX_ASSERT(index < size_, "accessing undefined memory");
+    return arr_[index];
+  }
+  /**
+   * Allows direct access at the specified index starting with index 0 <p>
+   * Negative indices can be used to access the list from the last element onwards starting with -1
+   * @param T a reference to the value at the given index
+   */
+  [[nodiscard]] inline T& at(const int_32_cx& index) const noexcept {
+    if (index < 0) {
+      CX_ASSERT(static_cast<uint_32_cx>(-index) <= size_, "index out of bounds");
+      return arr_[size_ + index];
+    }
+    CX_ASSERT(static_cast<uint_32_cx>(index) < size_, "index out of bounds");
+    return arr_[index];
+  }
+  /**
+   * Adds a element to the list
+   * @param e the element to be added
+   */
+  inline void push_back(const T& e) noexcept { emplace_back(e); }
+  /**
+   * Moves a element to the end of the list
+   * @param e the element to be added
+   */
+  inline void push_back(T&& e) noexcept { emplace_back(std::move(e)); }
+  /**
+   * Construct a new T element at the end of the list
+   * @param args T constructor arguments
+   */
+  template <typename... Args>
+  inline void emplace_back(Args&&... args) noexcept {
+    if (size_ == len_) [[unlikely]] {
+      grow_emplace(std::forward<Args>(args)...);
+      return;
+    }
+    std::allocator_traits<Allocator>::construct(alloc, &arr_[size_++], std::forward<Args>(args)...);
+  }
+  [[nodiscard]] inline T& front() const noexcept { return arr_[0]; }
+  [[nodiscard]] inline T& back() const noexcept { return arr_[size_ - 1]; }
+  /**
+   * Moves the elements back into the inline storage if they fit, otherwise into a heap array of size()
+   */
+  inline void shrink_to_fit() noexcept {
+    if (len_ > size_ && !is_small()) {
+      reallocate(size_);
+    }
+  }
+  /**
+  * Removes the last element of the list.
+  */
+  inline void pop_back() noexcept {
+    CX_ASSERT(size_ > 0, "out of bounds");
+    destroy_range(arr_ + --size_, 1);
+  }
+  /**
+   * Removes the first element of the list - O(n)
+   */
+  inline void pop_front() noexcept { pop(0); }
+  /**
+   * Removes the element at index i of the list - O(n-i)
+   */
+  inline void pop(const uint_32_cx& i) noexcept {
+    CX_ASSERT(i < size_, "out of bounds");
+    std::move(arr_ + i + 1, arr_ + size_, arr_ + i);
+    destroy_range(arr_ + --size_, 1);
+  }
+  /**
+   * Removes the first occurrence of the given element from the list
+   * @param e element to be removed
+   */
+  inline void erase(const T& e) noexcept {
+    for (uint_32_cx i = 0; i < size_; i++) {
+      if (arr_[i] == e) {
+        pop(i);
+        return;
+      }
+    }
+  }
+  /**
+   * Removes the first element for which condition(e) returns true
+   */
+  template <typename lambda>
+  inline void erase_if(lambda condition) {
+    for (uint_32_cx i = 0; i < size_; i++) {
+      if (condition(arr_[i])) {
+        pop(i);
+        return;
+      }
+    }
+  }
+  /**
+   * Removes the element at the given index
+   * @param index index of removal
+   */
+  inline void removeAt(const uint_32_cx& index) noexcept { pop(index); }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept { return len_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+  /**
+   * @return true if the elements are stored inline
+   */
+  [[nodiscard]] inline bool is_small() const noexcept {
+    return arr_ == reinterpret_cast<const T*>(buf_);
+  }
+  [[nodiscard]] static constexpr uint_32_cx inline_capacity() noexcept { return N; }
+  inline void reserve(uint_32_cx new_capacity) noexcept {
+    if (len_ < new_capacity) {
+      reallocate(new_capacity);
+    }
+  }
+  /**
+   * Clears the list of all its elements and frees the heap array
+   */
+  inline void clear() noexcept {
+    destroy_range(arr_, size_);
+    size_ = 0;
+    release_heap();
+  }
+  /**
+   * Provides access to the underlying array
+   * Valid data is only guaranteed from 0 up to size()
+   * @return a pointer to the data array
+   */
+  [[nodiscard]] inline T* get_raw() const noexcept { return arr_; }
+  /**
+   * @param val value to search for
+   * @return true if the value was found
+   */
+  [[nodiscard]] inline bool contains(const T& val) const noexcept {
+    return std::find(arr_, arr_ + size_, val) != arr_ + size_;
+  }
+  /**
+   * Appends the contents of another list at the end of this list
+   */
+  template <uint_32_cx M, AllocPolicy P>
+  inline void append(const small_vec<T, M, P>& o) noexcept {
+    append_range(o.get_raw(), o.size());
+  }
+  template <AllocPolicy P>
+  inline void append(const vec<T, P>& o) noexcept {
+    append_range(o.get_raw(), o.size());
+  }
+  /**
+  * Attempts to print the complete list to std::cout
+  * @param prefix optional prefix
+  */
+  inline void print(const std::string& prefix = "") {
+    if (!prefix.empty()) {
+      std::cout << prefix << std::endl;
+      std::cout << "   ";
+    }
+    std::cout << *this << std::endl;
+  }
+  friend std::ostream& operator<<(std::ostream& os, const small_vec& o) noexcept {
+    if (o.size_ == 0) {
+      return os << "[]";
+    }
+    os << "[" << o.arr_[0];
+    for (uint_32_cx i = 1; i < o.size_; i++) {
+      os << "," << o.arr_[i];
+    }
+    return os << "]";
+  }
+  /**
+   * Sorts the list in the given direction with cxalgos::pdq_sort
+   * @param ascending true if ascending, false if descending
+   */
+  inline void sort(bool ascending = true) noexcept { pdq_sort(arr_, size_, ascending); }
+  /**
+   * Sorts the list using a strict weak ordering of the form: comp(T,T)(bool) - see pdq_sort
+   * @param comp a callable function (lambda)
+   */
+  template <typename Comparator,
+            typename = std::enable_if_t<std::is_invocable_r_v<bool, Comparator, T, T>>>
+  inline void sort(Comparator comp) noexcept {
+    pdq_sort(arr_, size_, comp);
+  }
+  /**
+   * @return the index of the biggest element by ">" comparison
+   */
+  inline uint_32_cx max_element() const noexcept {
+    uint_32_cx index = 0;
+    for (uint_32_cx i = 1; i < size_; i++) {
+      if (arr_[i] > arr_[index]) {
+        index = i;
+      }
+    }
+    return index;
+  }
+  /**
+   * Trims the list to size new_size counting from the front
+   * @param new_size size the list will have after calling this method
+   */
+  inline void resize(uint_32_cx new_size) noexcept {
+    if (size_ > new_size) {
+      destroy_range(arr_ + new_size, size_ - new_size);
+      size_ = new_size;
+      reallocate(new_size);
+    }
+  }
+  inline Iterator begin() { return Iterator(arr_); }
+  inline Iterator end() { return Iterator(arr_ + size_); }
+
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_SMALLVEC_H_
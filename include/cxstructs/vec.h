@@ -24,10 +24,13 @@
 #include <algorithm>
 
 #include <cstdint>
+#include <cstring>
 #include <initializer_list>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <ostream>
+#include <span>
 #include <stdexcept>
 #include <vector>
 #include "../cxalgos/Sorting.h"
@@ -35,8 +38,24 @@
 
 /*This implementation is well optimized and should generally be a bit faster than the std::vector in a lot of use cases
  * Its using explicit allocator syntax to switch between the default and a custom one
+ * Only the first size() slots hold constructed elements, growing relocates them with memcpy when possible
  * Used in QuadTree.h
 */
+namespace cxhelper {
+/**
+ * True if a T can be moved to a new address with memcpy, without running its move constructor and destructor.<p>
+ * Defaults to trivially copyable types. Specialize it for types that only own heap memory through pointers:
+ * <pre>template <> struct cxhelper::is_trivially_relocatable<MyType> : std::true_type {};</pre>
+ * std::string is not relocatable on all standard libraries, its short string buffer points into itself
+ */
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+template <typename T>
+struct is_trivially_relocatable<std::unique_ptr<T>> : std::true_type {};
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+}  // namespace cxhelper
+
 namespace cxstructs {
 /**
  * <h2>vec</h2>
@@ -45,7 +64,7 @@ namespace cxstructs {
  * <p>A dynamic array is a random access, variable-n_elem list data structure that allows elements to be added or removed.
  * It provides the capability to index into the list, push_back elements to the end, and erase elements from the end in a time-efficient manner.</p>
  */
-template <typename T, bool UseCXPoolAllocator = true>
+template <typename T, AllocPolicy Policy = PoolAlloc>
 class vec {
  public:
   using value_type = T;
@@ -56,56 +75,87 @@ class vec {
   using const_iterator = const T*;
 
  private:
-  using Allocator =
-      typename std::conditional<UseCXPoolAllocator, CXPoolAllocator<T, sizeof(T) * 33, 1>,
-                                std::allocator<T>>::type;
+  template <typename, AllocPolicy>
+  friend class vec;
+  using Allocator = cxhelper::policy_allocator_t<T, Policy>;
   Allocator alloc;
   T* arr_;
   size_type size_;
   size_type len_;
 
-  bool is_trivial_destr = std::is_trivially_destructible<T>::value;
-  inline void grow() noexcept {
-    len_ *= 2;
-
-    T* n_arr = alloc.allocate(len_);
+  static constexpr bool kTrivialDestr = std::is_trivially_destructible_v<T>;
 
-    std::uninitialized_move(arr_, arr_ + size_, n_arr);
-
-    // Destroy the original objects
-    if (!is_trivial_destr) {
-      for (size_t i = 0; i < size_; i++) {
-        std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
+  inline void destroy_range(T* first, uint_32_cx n) noexcept {
+    if constexpr (!kTrivialDestr) {
+      for (uint_32_cx i = 0; i < n; i++) {
+        std::allocator_traits<Allocator>::destroy(alloc, first + i);
       }
     }
-
-    alloc.deallocate(arr_, size_);
-    arr_ = n_arr;
-
-    if (!is_trivial_destr) {
-      for (uint_fast32_t i = size_; i < len_; i++) {
-        std::allocator_traits<Allocator>::construct(alloc, &arr_[i]);
+  }
+  // moves n elements into uninitialized memory and ends their lifetime at the source
+  inline void relocate(T* src, uint_32_cx n, T* dst) noexcept {
+    if constexpr (cxhelper::is_trivially_relocatable_v<T>) {
+      if (n > 0) {
+        std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
+      }
+    } else {
+      for (uint_32_cx i = 0; i < n; i++) {
+        std::allocator_traits<Allocator>::construct(alloc, dst + i, std::move_if_noexcept(src[i]));
+        std::allocator_traits<Allocator>::destroy(alloc, src + i);
       }
     }
-    //as array is moved no need for delete []
   }
-  inline void shrink() noexcept {
-    auto old_len = len_;
-    len_ = size_ * 1.5;
-
-    T* n_arr = alloc.allocate(len_);
-
-    std::uninitialized_move(arr_, arr_ + size_, n_arr);
-
-    // Destroy the original objects
-    if (!is_trivial_destr) {
-      for (size_t i = 0; i < old_len; i++) {
-        std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
+  // copies n elements into uninitialized memory
+  template <typename U>
+  inline void copy_construct(const U* src, uint_32_cx n, T* dst) {
+    if constexpr (std::is_same_v<U, T> && std::is_trivially_copyable_v<T>) {
+      if (n > 0) {
+        std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
       }
+    } else {
+      std::uninitialized_copy(src, src + n, dst);
+    }
+  }
+  inline void reallocate(uint_32_cx new_len) noexcept {
+    T* n_arr = alloc.allocate(new_len);
+    relocate(arr_, size_, n_arr);
+    if (arr_) {
+      alloc.deallocate(arr_, len_);
     }
-
-    alloc.deallocate(arr_, old_len);
     arr_ = n_arr;
+    len_ = new_len;
+  }
+  [[nodiscard]] inline uint_32_cx next_len() const noexcept { return len_ < 4 ? 8 : len_ * 2; }
+  inline void grow() noexcept { reallocate(next_len()); }
+  inline void shrink() noexcept { reallocate(size_ * 1.5); }
+  // slow path of emplace_back, args may point into the old array so the new element is built first
+  template <typename... Args>
+  inline void grow_emplace(Args&&... args) {
+    const uint_32_cx new_len = next_len();
+    T* n_arr = alloc.allocate(new_len);
+    std::allocator_traits<Allocator>::construct(alloc, n_arr + size_, std::forward<Args>(args)...);
+    relocate(arr_, size_, n_arr);
+    if (arr_) {
+      alloc.deallocate(arr_, len_);
+    }
+    arr_ = n_arr;
+    len_ = new_len;
+    size_++;
+  }
+  // copy assignment, reuses the array if the elements fit
+  template <typename U>
+  inline void assign_copy(const U* src, uint_32_cx n, uint_32_cx len) {
+    destroy_range(arr_, size_);
+    size_ = 0;
+    if (len_ < n) {
+      if (arr_) {
+        alloc.deallocate(arr_, len_);
+      }
+      len_ = len;
+      arr_ = alloc.allocate(len_);
+    }
+    copy_construct(src, n, arr_);
+    size_ = n;
   }
 
  public:
@@ -115,22 +165,10 @@ class vec {
    * @param n_elem number of starting elements
    */
   inline explicit vec(uint_32_cx n_elems = 32)
-      : len_(n_elems), size_(0), arr_(alloc.allocate(n_elems)) {
-    if (!is_trivial_destr) {
-      for (uint_fast32_t i = 0; i < n_elems; i++) {
-        std::allocator_traits<Allocator>::construct(alloc, &arr_[i]);
-      }
-    }
-  }
+      : len_(n_elems), size_(0), arr_(alloc.allocate(n_elems)) {}
   inline vec(uint_32_cx n_elems, const T fillVal)
       : len_(n_elems), size_(n_elems), arr_(alloc.allocate(n_elems)) {
-    if (is_trivial_destr) {
-      std::fill(arr_, arr_ + n_elems, fillVal);
-    } else {
-      for (uint_fast32_t i = 0; i < n_elems; i++) {
-        std::allocator_traits<Allocator>::construct(alloc, &arr_[i], fillVal);
-      }
-    }
+    std::uninitialized_fill(arr_, arr_ + n_elems, fillVal);
   }
   /**
 * @brief Constructs a vec with the specified number of elements, and initializes them using a provided function.
@@ -154,13 +192,13 @@ class vec {
    */
   explicit vec(const std::vector<T>& vector)
       : len_(vector.size() * 1.5), size_(vector.size()), arr_(alloc.allocate(vector.size() * 1.5)) {
-    std::copy(vector.begin(), vector.end(), arr_);
+    copy_construct(vector.data(), size_, arr_);
   }
-  explicit vec(const std::vector<T>&& move_vector)
+  explicit vec(std::vector<T>&& move_vector)
       : len_(move_vector.size() * 1.5),
         size_(move_vector.size()),
         arr_(alloc.allocate(move_vector.size() * 1.5)) {
-    std::move(move_vector.begin(), move_vector.end(), arr_);
+    std::uninitialized_move(move_vector.begin(), move_vector.end(), arr_);
   }
   /**
    * Constructs a new vector by copying from the given pointer
@@ -169,8 +207,8 @@ class vec {
    * @param n_elem
    */
   inline explicit vec(T* data, uint_32_cx n_elem) : size_(n_elem), len_(n_elem * 2) {
-    arr_ = new T[len_];
-    std::copy(data, data + n_elem, arr_);
+    arr_ = alloc.allocate(len_);
+    copy_construct(data, n_elem, arr_);
   }
   /**
    * Initializer list constructor<p>
@@ -182,107 +220,60 @@ class vec {
       : size_(init_list.size()),
         len_(init_list.size() * 10),
         arr_(alloc.allocate(init_list.size() * 10)) {
-    if (is_trivial_destr) {
-      std::copy(init_list.begin(), init_list.end(), arr_);
-    } else {
-      auto it = init_list.begin();
-      for (uint_fast32_t i = 0; i < init_list.size(); i++) {
-        std::allocator_traits<Allocator>::construct(alloc, &arr_[i], *it);
-        ++it;
-      }
-    }
+    copy_construct(init_list.begin(), size_, arr_);
   }
-  inline vec(const vec<T>& o) : size_(o.size_), len_(o.len_) {
+  inline vec(const vec& o) : size_(o.size_), len_(o.len_) {
     arr_ = alloc.allocate(len_);
-    if (is_trivial_destr) {
-      std::copy(o.arr_, o.arr_ + o.size_, arr_);
-    } else {
-      std::uninitialized_copy(o.arr_, o.arr_ + o.size_, arr_);
-    }
+    copy_construct(o.arr_, o.size_, arr_);
   }
-  inline vec(const vec<T, false>& o) : size_(o.size_), len_(o.len_) {
+  template <AllocPolicy P>
+  inline vec(const vec<T, P>& o) : size_(o.size_), len_(o.len_) {
     arr_ = alloc.allocate(len_);
-    if (is_trivial_destr) {
-      std::copy(o.arr_, o.arr_ + o.size_, arr_);
-    } else {
-      std::uninitialized_copy(o.arr_, o.arr_ + o.size_, arr_);
-    }
+    copy_construct(o.arr_, o.size_, arr_);
   }
-  inline vec& operator=(const vec<T>& o) {
+  inline vec& operator=(const vec& o) {
     if (this != &o) {
-      //ugly allocator syntax but saves a lot when using e.g. vec<float>
-      if (!is_trivial_destr) {
-        for (uint_32_cx i = 0; i < len_; i++) {
-          std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-        }
-      }
-      alloc.deallocate(arr_, len_);
-
-      size_ = o.size_;
-      len_ = o.len_;
-      arr_ = alloc.allocate(len_);
-
-      if (is_trivial_destr) {
-        std::copy(o.arr_, o.arr_ + o.size_, arr_);
-      } else {
-        std::uninitialized_copy(o.arr_, o.arr_ + o.size_, arr_);
-      }
+      assign_copy(o.arr_, o.size_, o.len_);
     }
     return *this;
   }
-  inline vec& operator=(const vec<T, false>& o) {
-    if (this != &o) {
-      //ugly allocator syntax but saves a lot when using e.g. vec<float>
-      if (!is_trivial_destr) {
-        for (uint_32_cx i = 0; i < len_; i++) {
-          std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-        }
-      }
-      alloc.deallocate(arr_, len_);
-
-      size_ = o.size_;
-      len_ = o.len_;
-      arr_ = alloc.allocate(len_);
-
-      if (is_trivial_destr) {
-        std::copy(o.arr_, o.arr_ + o.size_, arr_);
-      } else {
-        std::uninitialized_copy(o.arr_, o.arr_ + o.size_, arr_);
-      }
+  template <AllocPolicy P>
+  inline vec& operator=(const vec<T, P>& o) {
+    if (static_cast<const void*>(this) != &o) {
+      assign_copy(o.arr_, o.size_, o.len_);
     }
     return *this;
   }
   //move constructor
   inline vec(vec&& o) noexcept : arr_(o.arr_), size_(o.size_), len_(o.len_) {
-    //leve other in previous state
+    //leave other empty
     o.arr_ = nullptr;  // PREVENT DOUBLE DELETION!
+    o.size_ = 0;
+    o.len_ = 0;
   }
   //move assignment
   vec& operator=(vec&& o) noexcept {
     if (this != &o) {
-      if (!is_trivial_destr) {
-        for (uint_32_cx i = 0; i < len_; i++) {
-          std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-        }
+      destroy_range(arr_, size_);
+      if (arr_) {
+        alloc.deallocate(arr_, len_);
       }
-      alloc.deallocate(arr_, len_);
-
       arr_ = o.arr_;
       size_ = o.size_;
       len_ = o.len_;
 
-      //other is left in previous state but invalidated
+      //other is left empty
       o.arr_ = nullptr;  // PREVENT DOUBLE DELETION!
+      o.size_ = 0;
+      o.len_ = 0;
     }
     return *this;
   }
   inline ~vec() {
-    if (!is_trivial_destr) {
-      for (uint_32_cx i = 0; i < size_; i++) {
-        std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-      }
+    destroy_range(arr_, size_);
+    if (arr_) {
+      alloc.deallocate(arr_, len_);
     }
-    alloc.deallocate(arr_, len_);
   }
   /**
    * Direct access to the underlying array
@@ -312,12 +303,12 @@ class vec {
    * Adds a element to the list
    * @param e the element to be added
    */
-  inline void push_back(const T& e) noexcept {
-    if (size_ == len_) {
-      grow();
-    }
-    arr_[size_++] = e;
-  }
+  inline void push_back(const T& e) noexcept { emplace_back(e); }
+  /**
+   * Moves a element to the end of the list
+   * @param e the element to be added
+   */
+  inline void push_back(T&& e) noexcept { emplace_back(std::move(e)); }
   [[nodiscard]] inline T& front() const noexcept { return arr_[0]; }
   [[nodiscard]] inline T& back() const noexcept { return arr_[size_ - 1]; }
   /**
@@ -326,8 +317,9 @@ class vec {
    */
   template <typename... Args>
   inline void emplace_back(Args&&... args) noexcept {
-    if (size_ == len_) {
-      grow();
+    if (size_ == len_) [[unlikely]] {
+      grow_emplace(std::forward<Args>(args)...);
+      return;
     }
     std::allocator_traits<Allocator>::construct(alloc, &arr_[size_++], std::forward<Args>(args)...);
   }
@@ -349,9 +341,7 @@ class vec {
   inline void pop_back() noexcept {
     CX_ASSERT(size_ > 0 , "out of bounds");
     size_--;
-    if (!is_trivial_destr) {
-      std::allocator_traits<Allocator>::destroy(alloc, &arr_[size_]);
-    }
+    destroy_range(arr_ + size_, 1);
   }
   /**
    * Removes the first element of the vec<p>
@@ -360,10 +350,8 @@ class vec {
    */
   inline void pop_front() noexcept {
     CX_ASSERT(size_ > 0, "out of bounds");
-    if (!is_trivial_destr) {
-      std::allocator_traits<Allocator>::destroy(alloc, &arr_[0]);
-    }
-    std::move(arr_ + 1, arr_ + size_--, arr_);
+    std::move(arr_ + 1, arr_ + size_, arr_);
+    destroy_range(arr_ + --size_, 1);
   }
   /**
    * Removes the element at index i of the vec<p>
@@ -372,31 +360,28 @@ class vec {
    */
   inline void pop(const uint_32_cx& i) noexcept {
     CX_ASSERT(i < size_, "out of bounds");
-    if (!is_trivial_destr) {
-      std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-    }
-    std::move(arr_ + i + 1, arr_ + size_--, arr_ + i);
+    std::move(arr_ + i + 1, arr_ + size_, arr_ + i);
+    destroy_range(arr_ + --size_, 1);
   }
   /**
    * Removes the first occurrence of the given element from the list
    * @param e element to be removed
+   * @return true if an element was removed
    */
-  inline void erase(const T& e) noexcept {
-#pragma omp simd linear(i : 1)
-    for (uint_32_cx i = 0; i < len_; i++) {
+  inline bool erase(const T& e) noexcept {
+    for (uint_32_cx i = 0; i < size_; i++) {
       if (arr_[i] == e) {
-        std::move(arr_ + i + 1, arr_ + size_, arr_ + i);
-        size_--;
-        return;
+        pop(i);
+        return true;
       }
     }
+    return false;
   }
   template <typename lambda>
   inline void erase_if(lambda condition) {
-    for (uint_32_cx i = 0; i < len_; i++) {
+    for (uint_32_cx i = 0; i < size_; i++) {
       if (condition(arr_[i])) {
-        std::move(arr_ + i + 1, arr_ + size_, arr_ + i);
-        size_--;
+        pop(i);
         return;
       }
     }
@@ -406,8 +391,8 @@ class vec {
    * @param index index of removal
    */
   inline void removeAt(const uint_32_cx& index) noexcept {
-    CX_ASSERT(index < len_ , "index out of bounds");
-    std::move(arr_ + index + 1, arr_ + size_--, arr_ + index);
+    CX_ASSERT(index < size_ , "index out of bounds");
+    pop(index);
   }
   /**
  *
@@ -415,37 +400,83 @@ class vec {
  */
   [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
   [[nodiscard]] inline uint_32_cx capacity() const noexcept { return len_; }
+  /**
+   * @return the heap memory of this vec - one array of capacity() elements
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    if (arr_) {
+      stats.bytes_reserved = cxhelper::allocation_size<Allocator>(len_);
+      stats.blocks = 1;
+    }
+    return stats;
+  }
   inline void reserve(uint_32_cx new_capacity) noexcept {
     if (len_ < new_capacity) {
-      len_ = new_capacity;
-
-      T* n_arr = alloc.allocate(len_);
-
-      std::uninitialized_move(arr_, arr_ + size_, n_arr);
-
-      // Destroy the original objects
-      if (!is_trivial_destr) {
-        for (size_t i = 0; i < size_; i++) {
-          std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-        }
-      }
-      alloc.deallocate(arr_, size_);
-
-      arr_ = n_arr;
+      reallocate(new_capacity);
     }
   }
+  /**
+   * Replaces the contents with copies of the n elements at src - the array is reused if they fit
+   * @param src first element, must not point into this vec
+   * @param n number of elements
+   */
+  inline void assign(const T* src, uint_32_cx n) { assign_copy(src, n, n); }
+  /**
+   * Writes the elements into a snapshot as one raw block - see cxsnapshot.h
+   * @param writer a SnapshotWriter
+   */
+  template <typename Writer>
+  void save_snapshot(Writer& writer) const {
+    static_assert(std::is_trivially_copyable_v<T>, "snapshots store vec elements raw");
+    writer.begin("vec", 1, sizeof(T), size_);
+    writer.write_array(arr_, size_);
+    writer.end();
+  }
+  /**
+   * Replaces the contents with the next snapshot section, a single copy out of the mapped file
+   * @param reader a SnapshotReader
+   * @return false if the section doesnt hold a vec of this type
+   */
+  template <typename Reader>
+  bool load_snapshot(Reader& reader) {
+    uint64_t n = 0;
+    if (!reader.begin("vec", 1, sizeof(T), n) || n > std::numeric_limits<uint_32_cx>::max()) {
+      return false;
+    }
+    const T* data = reader.template read_array<T>(n);
+    if (!data) {
+      return false;
+    }
+    assign(data, static_cast<uint_32_cx>(n));
+    return reader.end();
+  }
+  /**
+   * Reads the next snapshot section without copying - the span points into the mapped file
+   * and stays valid as long as the reader does
+   * @param reader a SnapshotReader
+   * @return the elements, empty if the section doesnt hold a vec of this type
+   */
+  template <typename Reader>
+  static std::span<const T> view_snapshot(Reader& reader) {
+    uint64_t n = 0;
+    if (!reader.begin("vec", 1, sizeof(T), n)) {
+      return {};
+    }
+    const T* data = reader.template read_array<T>(n);
+    return data && reader.end() ? std::span<const T>(data, n) : std::span<const T>();
+  }
   /**
    * Clears the list of all its elements <br>
    * Resets the length back to its starting value
    */
   inline void clear() noexcept {
-    int ar[3] = {2, 2, 1};
-    if (!is_trivial_destr) {
-      for (uint_32_cx i = 0; i < len_; i++) {
-        std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-      }
+    destroy_range(arr_, size_);
+    if (arr_) {
+      alloc.deallocate(arr_, len_);
     }
-    alloc.deallocate(arr_, len_);
     size_ = 0;
     len_ = 32;
     arr_ = alloc.allocate(32);
@@ -484,11 +515,12 @@ class vec {
  * If necessary, the capacity of this vec is expanded
  * @param vec  the vec to append
  */
-  inline void append(const vec<T>& vec) noexcept {
-    while (len_ - size_ < vec.size_) {
-      grow();
+  template <AllocPolicy P>
+  inline void append(const vec<T, P>& vec) noexcept {
+    if (len_ - size_ < vec.size_) {
+      reallocate(std::max(next_len(), size_ + vec.size_));
     }
-    std::copy(vec.arr_, vec.arr_ + vec.size_, arr_ + size_);
+    copy_construct(vec.arr_, vec.size_, arr_ + size_);
     size_ += vec.size_;
   }
   /**
@@ -500,12 +532,13 @@ class vec {
  * @param end index of the last element (exclusive)
  * @param start the index of the first element (inclusive)
  */
-  inline void append(const vec<T>& list, uint_32_cx endIndex, uint_32_cx startIndex = 0) noexcept {
+  template <AllocPolicy P>
+  inline void append(const vec<T, P>& list, uint_32_cx endIndex, uint_32_cx startIndex = 0) noexcept {
     CX_ASSERT(startIndex < endIndex || endIndex <= list.size_, "index out of bounds");
-    while (len_ - size_ < endIndex - startIndex) {
-      grow();
+    if (len_ - size_ < endIndex - startIndex) {
+      reallocate(std::max(next_len(), size_ + endIndex - startIndex));
     }
-    std::copy(list.arr_ + startIndex, list.arr_ + endIndex, arr_ + size_);
+    copy_construct(list.arr_ + startIndex, endIndex - startIndex, arr_ + size_);
     size_ += endIndex - startIndex;
   }
   /**
@@ -537,20 +570,41 @@ class vec {
   [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
   /**
    * Sorts the vector in the given direction<p>
-   * Uses the cxalgos::quicksort which should be slightly faster than STL sort()
+   * Uses cxalgos::pdq_sort - O(n log n) worst case, O(n) on sorted input
    * @param ascending true if ascending, false if descending
    */
-  inline void sort(bool ascending = true) noexcept { quick_sort(arr_, size_, ascending); }
+  inline void sort(bool ascending = true) noexcept { pdq_sort(arr_, size_, ascending); }
   /**
    * Sorts the vector using a custom comparator of the form: comp(T,T)(bool)
-   * If true swaps the elements
+   * It has to be a strict weak ordering like std::less: true if the first element goes before the second
    * @tparam Comparator callable taking two T and returning bool
    * @param comp a callable function (lambda)
    */
   template <typename Comparator,
             typename = std::enable_if_t<std::is_invocable_r_v<bool, Comparator, T, T>>>
   inline void sort(Comparator comp) noexcept {
-    quick_sort_comparator(arr_, size_, comp);
+    pdq_sort(arr_, size_, comp);
+  }
+  /**
+   * Sorts the vector with cxalgos::radix_sort - for arithmetic types
+   * @param ascending true if ascending, false if descending
+   * @param threads number of threads for the counting and scattering passes
+   */
+  inline void radix_sort(bool ascending = true, uint_32_cx threads = 1)
+    requires std::is_arithmetic_v<T>
+  {
+    cxstructs::radix_sort(arr_, size_, ascending, threads);
+  }
+  /**
+   * Stable sort by an arithmetic key with cxalgos::radix_sort
+   * @tparam KeyOf callable taking a const T& and returning an arithmetic key
+   * @param key the key extractor
+   * @param ascending true if ascending, false if descending
+   * @param threads number of threads for the counting and scattering passes
+   */
+  template <typename KeyOf>
+  inline void radix_sort(KeyOf key, bool ascending = true, uint_32_cx threads = 1) {
+    cxstructs::radix_sort(arr_, size_, key, ascending, threads);
   }
   /**
    * Iterates through the vector finding the biggest element by ">" comparison
@@ -574,23 +628,9 @@ class vec {
   inline void resize(uint_32_cx new_size) noexcept {
     CX_WARNING(!(size_ <= new_size), "calling grow for no reason");
     if (size_ > new_size) {
-      auto old_len = len_;
-      len_ = new_size;
-
-      T* n_arr = alloc.allocate(len_);
-
-      std::uninitialized_move(arr_, arr_ + new_size, n_arr);
-
-      // Destroy the original objects
-      if (!is_trivial_destr) {
-        for (size_t i = 0; i < old_len; i++) {
-          std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
-        }
-      }
-
-      alloc.deallocate(arr_, old_len);
-      arr_ = n_arr;
+      destroy_range(arr_ + new_size, size_ - new_size);
       size_ = new_size;
+      reallocate(new_size);
     }
   }
   class Iterator {
@@ -612,7 +652,7 @@ class vec {
       ++ptr;
       return *this;
     }
-    inline Iterator operator++(int) const noexcept {
+    inline Iterator operator++(int) noexcept {
       Iterator temp = *this;
       ++ptr;
       return temp;
@@ -653,5 +693,16 @@ class vec {
   inline Iterator end() { return Iterator(arr_ + size_); }
 
 };
+#if defined(CX_KERNEL_DECL)
+// instantiated once in the cxstructs_kernels library
+extern template class vec<int>;
+extern template class vec<float>;
+#endif
 }  // namespace cxstructs
+
+namespace cxhelper {
+// a vec only points to its array, so vec<vec<float>> grows with memcpy
+template <typename T, cxstructs::AllocPolicy Policy>
+struct is_trivially_relocatable<cxstructs::vec<T, Policy>> : std::true_type {};
+}  // namespace cxhelper
 #endif  // CXSTRUCTS_ARRAYLIST_H
@@ -0,0 +1,186 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXCPU_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXCPU_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include "../cxconfig.h"
+
+#if defined(CX_X86_DISPATCH) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__linux__) && (defined(__aarch64__) || defined(__arm__))
+#include <sys/auxv.h>
+#endif
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+
+// Runtime CPU dispatch - detects the instruction sets of the running CPU once and lets kernels pick
+// their best variant, so one binary built for plain x86-64 still uses AVX2 / AVX-512 where available.
+// Variants are compiled with CX_TARGET_AVX2 / CX_TARGET_AVX512 (see cxconfig.h) and chosen with select_isa()
+
+namespace cxhelper {
+/**
+ * Instruction set levels in ascending order - NEON is the ARM counterpart of SSE2
+ */
+enum class ISA : uint8_t { SCALAR = CX_ISA_SCALAR, SSE2 = CX_ISA_SSE2, AVX2 = CX_ISA_AVX2,
+                           AVX512 = CX_ISA_AVX512, NEON = CX_ISA_NEON };
+
+inline const char* isa_name(ISA isa) noexcept {
+  constexpr const char* names[] = {"scalar", "sse2", "avx2", "avx512", "neon"};
+  return names[static_cast<uint8_t>(isa)];
+}
+#if defined(CX_X86_DISPATCH) && defined(_MSC_VER)
+inline bool os_saves_avx(uint64_t mask) noexcept {  // the OS has to save the wide registers
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & mask) == mask;
+}
+#endif
+/**
+ * @return the best instruction set the running CPU supports - without looking at CX_FORCE_ISA
+ */
+inline ISA detect_isa() noexcept {
+#if defined(CX_NO_SIMD)
+  return ISA::SCALAR;
+#elif defined(CX_X86_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma")) {
+    return ISA::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return ISA::AVX2;
+  }
+  return __builtin_cpu_supports("sse2") ? ISA::SSE2 : ISA::SCALAR;
+#elif defined(CX_X86_DISPATCH) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] >= 7) {
+    int leaf1[4], leaf7[4];
+    __cpuid(leaf1, 1);
+    __cpuidex(leaf7, 7, 0);
+    const bool fma = (leaf1[2] & (1 << 12)) != 0;
+    const bool avx2 = (leaf7[1] & (1 << 5)) != 0;
+    const bool avx512 = (leaf7[1] & (1 << 16)) != 0;
+    if (avx512 && avx2 && fma && os_saves_avx(0xE6)) {
+      return ISA::AVX512;
+    }
+    if (avx2 && fma && os_saves_avx(0x6)) {
+      return ISA::AVX2;
+    }
+  }
+  return ISA::SSE2;  // part of x86-64
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  return ISA::NEON;  // mandatory on AArch64
+#elif defined(__linux__) && defined(__arm__) && defined(HWCAP_NEON)
+  return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0 ? ISA::NEON : ISA::SCALAR;
+#else
+  return ISA::SCALAR;
+#endif
+}
+/**
+ * Applies a cap to the detected instruction set - lower levels stay, SCALAR always wins
+ */
+inline ISA cap_isa(ISA detected, ISA cap) noexcept {
+  if (cap == ISA::SCALAR || detected == ISA::SCALAR) return ISA::SCALAR;
+  if ((cap == ISA::NEON) != (detected == ISA::NEON)) return detected;  // cap for the other architecture
+  return static_cast<uint8_t>(cap) < static_cast<uint8_t>(detected) ? cap : detected;
+}
+/**
+ * Parses "scalar", "sse2", "avx2", "avx512" or "neon"
+ * @return false for anything else
+ */
+inline bool parse_isa(const char* text, ISA& out) noexcept {
+  for (uint8_t i = 0; i <= CX_ISA_NEON; i++) {
+    if (std::strcmp(text, isa_name(static_cast<ISA>(i))) == 0) {
+      out = static_cast<ISA>(i);
+      return true;
+    }
+  }
+  return false;
+}
+/**
+ * The instruction set kernels dispatch on - detected on first use.<p>
+ * It can only be lowered: at compile time with <code>#define CX_FORCE_ISA CX_ISA_...</code> and at startup
+ * with the environment variable CX_FORCE_ISA=scalar|sse2|avx2|avx512|neon (e.g. to compare or debug variants)
+ */
+inline ISA cpu_isa() noexcept {
+  static const ISA isa = [] {
+    ISA result = detect_isa();
+#if defined(CX_FORCE_ISA)
+    result = cap_isa(result, static_cast<ISA>(CX_FORCE_ISA));
+#endif
+    ISA env;
+    const char* text = std::getenv("CX_FORCE_ISA");
+    if (text != nullptr && parse_isa(text, env)) {
+      result = cap_isa(result, env);
+    }
+    return result;
+  }();
+  return isa;
+}
+/**
+ * The per core L2 cache size in bytes - detected on first use, 512 KiB where it can not be queried.<p>
+ * Parallel loops size their chunks with it so a chunk stays in cache between passes
+ */
+inline size_t l2_cache_size() noexcept {
+  static const size_t size = [] {
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+    const long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (bytes > 0) {
+      return static_cast<size_t>(bytes);
+    }
+#endif
+    return static_cast<size_t>(512 * 1024);
+  }();
+  return size;
+}
+/**
+ * Picks the kernel variant for cpu_isa(), missing (nullptr) variants fall back to the next lower level.
+ * Kernels keep the result in a function local static so the choice is made once:
+ * <code>static const auto kernel = select_isa(dot_scalar, dot_avx2); return kernel(a, b, n);</code>
+ */
+template <typename Fn>
+inline Fn select_isa(Fn scalar, std::type_identity_t<Fn> avx2 = nullptr,
+                     std::type_identity_t<Fn> avx512 = nullptr,
+                     std::type_identity_t<Fn> neon = nullptr) noexcept {
+  switch (cpu_isa()) {
+    case ISA::AVX512:
+      if (avx512 != nullptr) return avx512;
+      [[fallthrough]];
+    case ISA::AVX2:
+      if (avx2 != nullptr) return avx2;
+      return scalar;
+    case ISA::NEON:
+      return neon != nullptr ? neon : scalar;
+    default:
+      return scalar;
+  }
+}
+}  // namespace cxhelper
+
+#endif  //CXSTRUCTS_SRC_CXUTIL_CXCPU_H_
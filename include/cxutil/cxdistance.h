@@ -0,0 +1,482 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXDISTANCE_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXDISTANCE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include "../cxconfig.h"
+
+
+// Distance kernels over float arrays - AVX-512, AVX2 (FMA) and NEON with two accumulators, runtime dispatched
+// The metric functors below wrap them and expose a comparable() form that orders like the distance
+// but skips the sqrt, so nearest neighbour searches only convert the final k results
+
+namespace cxhelper {
+#if defined(CX_X86_DISPATCH)
+CX_TARGET_AVX2 inline float dist_hsum(__m256 v) noexcept {
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+  return _mm_cvtss_f32(half);
+}
+CX_TARGET_AVX2 inline float dist_hmax(__m256 v) noexcept {
+  __m128 half = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+  return _mm_cvtss_f32(half);
+}
+CX_TARGET_AVX2 inline __m256 dist_abs(__m256 v) noexcept {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0F), v);
+}
+// mask of the first n < 16 lanes for the tail of the AVX-512 kernels
+inline __mmask16 dist_tail_mask(uint_32_cx n) noexcept {
+  return static_cast<__mmask16>((1U << n) - 1U);
+}
+#endif
+#if defined(CX_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define CX_NEON64
+#endif
+// Each kernel comes as _scalar (NEON on ARM), _avx2 and _avx512 - the *_simd functions call the best one
+// the running cpu supports, directly if the build target has it already, else chosen once via select_isa()
+#if defined(CX_AVX512)
+#define CX_DIST_DISPATCH(name) return name##_avx512(a, b, n)
+#elif defined(CX_X86_DISPATCH)
+#define CX_DIST_DISPATCH(name)                                                      \
+  static const auto kernel = select_isa(name##_scalar, name##_avx2, name##_avx512); \
+  return kernel(a, b, n)
+#else
+#define CX_DIST_DISPATCH(name) return name##_scalar(a, b, n)
+#endif
+
+inline float dot_scalar(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  float sum = 0;
+#if defined(CX_NEON64)
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+inline float l2_squared_scalar(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  float sum = 0;
+#if defined(CX_NEON64)
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  for (; i + 8 <= n; i += 8) {
+    const float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    const float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc0 = vfmaq_f32(acc0, d0, d0);
+    acc1 = vfmaq_f32(acc1, d1, d1);
+  }
+  sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+  for (; i < n; i++) {
+    const float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+inline float l1_scalar(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  float sum = 0;
+#if defined(CX_NEON64)
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vaddq_f32(acc0, vabdq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+    acc1 = vaddq_f32(acc1, vabdq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4)));
+  }
+  sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+  for (; i < n; i++) {
+    sum += std::abs(a[i] - b[i]);
+  }
+  return sum;
+}
+inline float linf_scalar(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  float max = 0;
+#if defined(CX_NEON64)
+  float32x4_t acc = vdupq_n_f32(0);
+  for (; i + 4 <= n; i += 4) {
+    acc = vmaxq_f32(acc, vabdq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  }
+  max = vmaxvq_f32(acc);
+#endif
+  for (; i < n; i++) {
+    max = std::max(max, std::abs(a[i] - b[i]));
+  }
+  return max;
+}
+// 1 - dot / sqrt(norm_a * norm_b) - 1 if either is zero
+inline float cosine_finish(float dot, float norm_a, float norm_b) noexcept {
+  const float denom = norm_a * norm_b;
+  return denom > 0 ? 1.0F - dot / std::sqrt(denom) : 1.0F;
+}
+inline float cosine_scalar(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  float dot = 0, norm_a = 0, norm_b = 0;
+#if defined(CX_NEON64)
+  float32x4_t acc_dot = vdupq_n_f32(0);
+  float32x4_t acc_a = vdupq_n_f32(0);
+  float32x4_t acc_b = vdupq_n_f32(0);
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t va = vld1q_f32(a + i);
+    const float32x4_t vb = vld1q_f32(b + i);
+    acc_dot = vfmaq_f32(acc_dot, va, vb);
+    acc_a = vfmaq_f32(acc_a, va, va);
+    acc_b = vfmaq_f32(acc_b, vb, vb);
+  }
+  dot = vaddvq_f32(acc_dot);
+  norm_a = vaddvq_f32(acc_a);
+  norm_b = vaddvq_f32(acc_b);
+#endif
+  for (; i < n; i++) {
+    dot += a[i] * b[i];
+    norm_a += a[i] * a[i];
+    norm_b += b[i] * b[i];
+  }
+  return cosine_finish(dot, norm_a, norm_b);
+}
+#if defined(CX_X86_DISPATCH)
+CX_TARGET_AVX2 inline float dot_avx2(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  float sum = dist_hsum(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+CX_TARGET_AVX2 inline float l2_squared_avx2(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+  }
+  float sum = dist_hsum(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) {
+    const float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+CX_TARGET_AVX2 inline float l1_avx2(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_add_ps(acc0, dist_abs(_mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+    acc1 = _mm256_add_ps(
+        acc1, dist_abs(_mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8))));
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_ps(acc0, dist_abs(_mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+  }
+  float sum = dist_hsum(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) {
+    sum += std::abs(a[i] - b[i]);
+  }
+  return sum;
+}
+CX_TARGET_AVX2 inline float linf_avx2(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_max_ps(acc, dist_abs(_mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+  }
+  float max = dist_hmax(acc);
+  for (; i < n; i++) {
+    max = std::max(max, std::abs(a[i] - b[i]));
+  }
+  return max;
+}
+CX_TARGET_AVX2 inline float cosine_avx2(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m256 acc_dot = _mm256_setzero_ps();
+  __m256 acc_a = _mm256_setzero_ps();
+  __m256 acc_b = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    const __m256 va = _mm256_loadu_ps(a + i);
+    const __m256 vb = _mm256_loadu_ps(b + i);
+    acc_dot = _mm256_fmadd_ps(va, vb, acc_dot);
+    acc_a = _mm256_fmadd_ps(va, va, acc_a);
+    acc_b = _mm256_fmadd_ps(vb, vb, acc_b);
+  }
+  float dot = dist_hsum(acc_dot), norm_a = dist_hsum(acc_a), norm_b = dist_hsum(acc_b);
+  for (; i < n; i++) {
+    dot += a[i] * b[i];
+    norm_a += a[i] * a[i];
+    norm_b += b[i] * b[i];
+  }
+  return cosine_finish(dot, norm_a, norm_b);
+}
+// the AVX-512 variants handle the tail with one masked load instead of a scalar loop
+CX_TARGET_AVX512 inline float dot_avx512(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+  }
+  if (i < n) {
+    const __mmask16 m = dist_tail_mask(n - i);
+    acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc1);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+CX_TARGET_AVX512 inline float l2_squared_avx512(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  for (; i + 32 <= n; i += 32) {
+    const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    const __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+  }
+  if (i < n) {
+    const __mmask16 m = dist_tail_mask(n - i);
+    const __m512 d1 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i));
+    acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+CX_TARGET_AVX512 inline float l1_avx512(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+    acc1 = _mm512_add_ps(
+        acc1, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16))));
+  }
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+  }
+  if (i < n) {
+    const __mmask16 m = dist_tail_mask(n - i);
+    acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i),
+                                                           _mm512_maskz_loadu_ps(m, b + i))));
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+CX_TARGET_AVX512 inline float linf_avx512(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m512 acc = _mm512_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    acc = _mm512_max_ps(acc, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+  }
+  if (i < n) {
+    const __mmask16 m = dist_tail_mask(n - i);
+    acc = _mm512_max_ps(acc, _mm512_abs_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i),
+                                                         _mm512_maskz_loadu_ps(m, b + i))));
+  }
+  return _mm512_reduce_max_ps(acc);
+}
+CX_TARGET_AVX512 inline float cosine_avx512(const float* a, const float* b, uint_32_cx n) noexcept {
+  uint_32_cx i = 0;
+  __m512 acc_dot = _mm512_setzero_ps();
+  __m512 acc_a = _mm512_setzero_ps();
+  __m512 acc_b = _mm512_setzero_ps();
+  for (; i < n; i += 16) {
+    const __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : dist_tail_mask(n - i);
+    const __m512 va = _mm512_maskz_loadu_ps(m, a + i);
+    const __m512 vb = _mm512_maskz_loadu_ps(m, b + i);
+    acc_dot = _mm512_fmadd_ps(va, vb, acc_dot);
+    acc_a = _mm512_fmadd_ps(va, va, acc_a);
+    acc_b = _mm512_fmadd_ps(vb, vb, acc_b);
+  }
+  return cosine_finish(_mm512_reduce_add_ps(acc_dot), _mm512_reduce_add_ps(acc_a),
+                       _mm512_reduce_add_ps(acc_b));
+}
+#endif
+#if defined(CX_KERNEL_DECL)
+float dot_simd(const float* a, const float* b, uint_32_cx n) noexcept;
+float l2_squared_simd(const float* a, const float* b, uint_32_cx n) noexcept;
+float l1_simd(const float* a, const float* b, uint_32_cx n) noexcept;
+float linf_simd(const float* a, const float* b, uint_32_cx n) noexcept;
+float cosine_simd(const float* a, const float* b, uint_32_cx n) noexcept;
+#else
+/**
+ * SIMD dot product of two float arrays
+ */
+CX_KERNEL float dot_simd(const float* a, const float* b, uint_32_cx n) noexcept {
+  CX_DIST_DISPATCH(dot);
+}
+/**
+ * SIMD squared euclidean distance of two float arrays
+ */
+CX_KERNEL float l2_squared_simd(const float* a, const float* b, uint_32_cx n) noexcept {
+  CX_DIST_DISPATCH(l2_squared);
+}
+/**
+ * SIMD manhattan distance of two float arrays
+ */
+CX_KERNEL float l1_simd(const float* a, const float* b, uint_32_cx n) noexcept {
+  CX_DIST_DISPATCH(l1);
+}
+/**
+ * SIMD chebyshev (maximum) distance of two float arrays
+ */
+CX_KERNEL float linf_simd(const float* a, const float* b, uint_32_cx n) noexcept {
+  CX_DIST_DISPATCH(linf);
+}
+/**
+ * Cosine distance 1 - cos(a, b) from dot product and both norms in a single pass - 1 if either is zero
+ */
+CX_KERNEL float cosine_simd(const float* a, const float* b, uint_32_cx n) noexcept {
+  CX_DIST_DISPATCH(cosine);
+}
+#endif
+#undef CX_DIST_DISPATCH
+#undef CX_NEON64
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>Distance metrics</h2>
+ * Functors over two equally long float spans. comparable() is cheaper and orders exactly like the
+ * distance (squared for L2), to_distance() turns a comparable value into the real distance.
+ * Nearest neighbour searches compare with comparable() and only convert the results.
+ */
+struct L1Metric {
+  static inline float comparable(const float* a, const float* b, uint_32_cx n) noexcept {
+    return cxhelper::l1_simd(a, b, n);
+  }
+  static inline float to_distance(float comparable) noexcept { return comparable; }
+  inline float operator()(std::span<const float> a, std::span<const float> b) const noexcept {
+    CX_ASSERT(a.size() == b.size(), "spans of different length");
+    return comparable(a.data(), b.data(), a.size());
+  }
+};
+struct SquaredL2Metric {
+  static inline float comparable(const float* a, const float* b, uint_32_cx n) noexcept {
+    return cxhelper::l2_squared_simd(a, b, n);
+  }
+  static inline float to_distance(float comparable) noexcept { return comparable; }
+  inline float operator()(std::span<const float> a, std::span<const float> b) const noexcept {
+    CX_ASSERT(a.size() == b.size(), "spans of different length");
+    return comparable(a.data(), b.data(), a.size());
+  }
+};
+struct L2Metric {
+  // the squared distance - same order without the sqrt
+  static inline float comparable(const float* a, const float* b, uint_32_cx n) noexcept {
+    return cxhelper::l2_squared_simd(a, b, n);
+  }
+  static inline float to_distance(float comparable) noexcept { return std::sqrt(comparable); }
+  inline float operator()(std::span<const float> a, std::span<const float> b) const noexcept {
+    CX_ASSERT(a.size() == b.size(), "spans of different length");
+    return to_distance(comparable(a.data(), b.data(), a.size()));
+  }
+};
+struct CosineMetric {
+  // 1 - cosine similarity in [0, 2]
+  static inline float comparable(const float* a, const float* b, uint_32_cx n) noexcept {
+    return cxhelper::cosine_simd(a, b, n);
+  }
+  static inline float to_distance(float comparable) noexcept { return comparable; }
+  inline float operator()(std::span<const float> a, std::span<const float> b) const noexcept {
+    CX_ASSERT(a.size() == b.size(), "spans of different length");
+    return comparable(a.data(), b.data(), a.size());
+  }
+};
+struct ChebyshevMetric {
+  static inline float comparable(const float* a, const float* b, uint_32_cx n) noexcept {
+    return cxhelper::linf_simd(a, b, n);
+  }
+  static inline float to_distance(float comparable) noexcept { return comparable; }
+  inline float operator()(std::span<const float> a, std::span<const float> b) const noexcept {
+    CX_ASSERT(a.size() == b.size(), "spans of different length");
+    return comparable(a.data(), b.data(), a.size());
+  }
+};
+/**
+ * One query against many points: out[i] = Metric::comparable(query, point i)
+ * @param query dims floats
+ * @param points count * dims floats, one point after another
+ * @param out at least count floats
+ */
+template <typename Metric>
+inline void comparable_distances(std::span<const float> query, const float* points, uint_32_cx count,
+                                 std::span<float> out) noexcept {
+  CX_ASSERT(out.size() >= count, "output buffer too small");
+  const uint_32_cx dims = query.size();
+  for (uint_32_cx i = 0; i < count; i++) {
+    const float* point = points + static_cast<size_t>(i) * dims;
+    CX_PREFETCH(point + 2 * dims);
+    out[i] = Metric::comparable(query.data(), point, dims);
+  }
+}
+/**
+ * One query against many points: out[i] = Metric()(query, point i)
+ * @param query dims floats
+ * @param points count * dims floats, one point after another
+ * @param out at least count floats
+ */
+template <typename Metric>
+inline void distances(std::span<const float> query, const float* points, uint_32_cx count,
+                      std::span<float> out) noexcept {
+  comparable_distances<Metric>(query, points, count, out);
+  for (uint_32_cx i = 0; i < count; i++) {
+    out[i] = Metric::to_distance(out[i]);
+  }
+}
+}  // namespace cxstructs
+
+#endif  //CXSTRUCTS_SRC_CXUTIL_CXDISTANCE_H_
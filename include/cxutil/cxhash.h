@@ -0,0 +1,231 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXHASH_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXHASH_H_
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "../cxconfig.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Stateless hash functors used as the default by all hashing cxstructs
+// Every call is a plain inlineable function, unlike the std::function that was used before
+// Integers use a xxh3/moremur style finalizer, strings a wyhash style loop over std::string_view
+
+namespace cxhelper {
+constexpr uint64_t kWySecret0 = 0xa0761d6478bd642fULL;
+constexpr uint64_t kWySecret1 = 0xe7037ed1a0b428dbULL;
+constexpr uint64_t kWySecret2 = 0x8ebc6af09c88c6e3ULL;
+constexpr uint64_t kWySecret3 = 0x589965cc75374cc3ULL;
+
+/**
+ * 64x64 -> 128 bit multiply folded back to 64 bit with xor
+ */
+inline uint64_t wy_mix(uint64_t a, uint64_t b) noexcept {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = static_cast<__uint128_t>(a) * b;
+  return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t high;
+  uint64_t low = _umul128(a, b, &high);
+  return low ^ high;
+#else
+  uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  uint64_t low = t + (rm1 << 32);
+  c += low < t;
+  uint64_t high = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  return low ^ high;
+#endif
+}
+inline uint64_t wy_read8(const uint8_t* p) noexcept {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+inline uint64_t wy_read4(const uint8_t* p) noexcept {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+/**
+ * Finalizer for 64 bit integers, every input bit affects every output bit
+ * @param x the value to mix
+ * @return the mixed value
+ */
+inline uint64_t hash_int(uint64_t x) noexcept {
+  x ^= x >> 32;
+  x *= 0xd6e8feb86659fd93ULL;
+  x ^= x >> 32;
+  x *= 0xd6e8feb86659fd93ULL;
+  x ^= x >> 32;
+  return x;
+}
+/**
+ * Combines two 64 bit values into one well distributed hash
+ */
+inline uint64_t hash_combine(uint64_t a, uint64_t b) noexcept {
+  return wy_mix(a ^ kWySecret0, b ^ kWySecret1);
+}
+/**
+ * Hashes an arbitrary byte range (wyhash style)
+ * @param key start of the bytes
+ * @param len number of bytes
+ * @param seed optional seed
+ * @return the hash value
+ */
+inline uint64_t hash_bytes(const void* key, size_t len, uint64_t seed = 0) noexcept {
+  const auto* p = static_cast<const uint8_t*>(key);
+  seed ^= wy_mix(seed ^ kWySecret0, kWySecret1);
+  uint64_t a, b;
+  if (len <= 16) [[likely]] {
+    if (len >= 4) {
+      a = (wy_read4(p) << 32) | wy_read4(p + ((len >> 3) << 2));
+      b = (wy_read4(p + len - 4) << 32) | wy_read4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[len >> 1]) << 8) |
+          p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = wy_mix(wy_read8(p) ^ kWySecret1, wy_read8(p + 8) ^ seed);
+        see1 = wy_mix(wy_read8(p + 16) ^ kWySecret2, wy_read8(p + 24) ^ see1);
+        see2 = wy_mix(wy_read8(p + 32) ^ kWySecret3, wy_read8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wy_mix(wy_read8(p) ^ kWySecret1, wy_read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = wy_read8(p + i - 16);
+    b = wy_read8(p + i - 8);
+  }
+  return wy_mix(kWySecret1 ^ len, wy_mix(a ^ kWySecret1, b ^ seed));
+}
+
+/**
+ * <h2>hash</h2>
+ * Stateless default hash functor for all hashing cxstructs.<p>
+ * Falls back to std::hash for unknown types. Provide your own by specializing:
+ * <pre>template <> struct cxstructs::hash<MyType> { size_t operator()(const MyType& t) const; };</pre>
+ * Specializations that are already well distributed declare <code>using is_avalanching = std::true_type;</code>
+ * so containers can skip their own mixing step.
+ * @tparam K the key type
+ */
+template <typename K, typename = void>
+struct hash {
+  inline size_t operator()(const K& key) const noexcept(noexcept(std::hash<K>()(key))) {
+    return std::hash<K>()(key);
+  }
+};
+template <typename K>
+struct hash<K, std::enable_if_t<std::is_integral_v<K> || std::is_enum_v<K>>> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(K key) const noexcept {
+    return static_cast<size_t>(hash_int(static_cast<uint64_t>(key)));
+  }
+};
+template <typename K>
+struct hash<K, std::enable_if_t<std::is_floating_point_v<K>>> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(K key) const noexcept {
+    if (key == 0) {  // -0.0 == 0.0
+      return static_cast<size_t>(hash_int(0));
+    }
+    if constexpr (sizeof(K) == sizeof(uint32_t)) {
+      uint32_t bits;
+      std::memcpy(&bits, &key, sizeof(K));
+      return static_cast<size_t>(hash_int(bits));
+    } else if constexpr (sizeof(K) == sizeof(uint64_t)) {
+      uint64_t bits;
+      std::memcpy(&bits, &key, sizeof(K));
+      return static_cast<size_t>(hash_int(bits));
+    } else {
+      return static_cast<size_t>(hash_bytes(&key, sizeof(K)));
+    }
+  }
+};
+template <typename K>
+struct hash<K*, void> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(K* key) const noexcept {
+    return static_cast<size_t>(hash_int(reinterpret_cast<uintptr_t>(key)));
+  }
+};
+template <>
+struct hash<std::string_view, void> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(std::string_view key) const noexcept {
+    return static_cast<size_t>(hash_bytes(key.data(), key.size()));
+  }
+};
+template <>
+struct hash<std::string, void> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(std::string_view key) const noexcept {
+    return static_cast<size_t>(hash_bytes(key.data(), key.size()));
+  }
+};
+}  // namespace cxstructs
+
+namespace cxhelper {
+/**
+ * Creates the hash function a container uses when none is supplied.<p>
+ * Type-erased wrappers like std::function are initialized with cxstructs::hash, everything else is default constructed
+ */
+template <typename Hash, typename K>
+inline Hash default_hash_func() {
+  if constexpr (std::is_constructible_v<Hash, cxstructs::hash<K>>) {
+    return Hash(cxstructs::hash<K>());
+  } else {
+    return Hash();
+  }
+}
+template <typename Hash, typename = void>
+struct is_avalanching : std::false_type {};
+template <typename Hash>
+struct is_avalanching<Hash, std::void_t<typename Hash::is_avalanching>> : Hash::is_avalanching {};
+}  // namespace cxhelper
+
+#endif  //CXSTRUCTS_SRC_CXUTIL_CXHASH_H_
@@ -22,50 +22,48 @@
 #define CXSTRUCTS_SRC_CXUTIL_MATH_H_
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
 #include "../cxstructs/mat.h"
 #include "../cxstructs/row.h"
+#include "cxactivation.h"
+#include "cxdistance.h"
 
 #define CX_PI \
   3.14159265358979323846  // for compatibility | apparently this is only in c++ through std::numbers which is CX20 and not on all compilers equal
 
 namespace cxstructs {
 //function pointer typedef
-typedef float (*func)(float);
 typedef mat (*func_M)(mat&, mat&);  // mat function
+typedef void (*func_M_into)(mat&, const mat&, mat&);  // mat function writing into the last argument
 typedef float (*D_func)(float p1x, float p1y, float p2x, float p2y);
 
-//activation functions
-inline float sig(float x) noexcept {
-  return 1.0F / (1.0F + std::exp(-x));
-}
-inline float tanh(float x) noexcept {
-  return std::tanh(x);
-}
-inline float relu(float x) noexcept {
-  return x > 0 ? x : 0;
-}
+//activation functions - scalar and span versions are in cxactivation.h
 inline void softmax(mat& m) noexcept {
-  float rowSum = 0;
-  for (uint_fast32_t i = 0; i < m.n_rows(); i++) {
-    rowSum = 0;
-    for (uint_fast32_t j = 0; j < m.n_cols(); j++) {
-      rowSum += std::exp(m(i, j));
-    }
-    for (uint_fast32_t j = 0; j < m.n_cols(); j++) {
-      m(i, j) = std::exp(m(i, j)) / rowSum;
-    }
+  for (uint_32_cx i = 0; i < m.n_rows(); i++) {
+    softmax_span({m.get_raw() + i * m.n_cols(), m.n_cols()});
   }
 }
-//derivatives
-inline float d_sig(float x) noexcept {
-  return sig(x) * (1 - sig(x));
-}
-inline float d_relu(float x) noexcept {
-  return x > 0 ? 1 : 0;
-}
-inline float d_tanh(float x) noexcept {
-  float t = std::tanh(x);
-  return 1 - t * t;
+/**
+ * Fused, numerically stable softmax and cross entropy for every row of logits
+ * @param logits turned into the softmax probabilities
+ * @param target the target distributions - same shape as logits
+ * @param grad the gradient with respect to the logits (probabilities - target)
+ * @return the cross entropy summed over all rows
+ */
+inline float softmax_cross_entropy_into(mat& logits, const mat& target, mat& grad) {
+  CX_ASSERT(logits.n_rows() == target.n_rows() && logits.n_cols() == target.n_cols(),
+            "invalid dimensions");
+  grad.resize(logits.n_rows(), logits.n_cols());
+  const uint_32_cx cols = logits.n_cols();
+  float loss = 0;
+  for (uint_32_cx i = 0; i < logits.n_rows(); i++) {
+    loss += softmax_cross_entropy({logits.get_raw() + i * cols, cols},
+                                  {target.get_raw() + i * cols, cols},
+                                  {grad.get_raw() + i * cols, cols});
+  }
+  return loss;
 }
 //loss
 inline mat cross_entropy(mat& pred, mat& target) {  //with softmax activation function
@@ -80,6 +78,17 @@ inline mat mean_sqr_abs_err(mat& pred, mat& target) {
   ret.scale(2);
   return ret;
 }
+//loss - allocation free versions writing the gradient into out
+inline void cross_entropy_into(mat& pred, const mat& target, mat& out) {
+  softmax_cross_entropy_into(pred, target, out);
+}
+inline void mean_abs_into(mat& pred, const mat& target, mat& out) {
+  sub_into(pred, target, out);
+}
+inline void mean_sqr_abs_err_into(mat& pred, const mat& target, mat& out) {
+  sub_into(pred, target, out);
+  out.scale(2);
+}
 //utils
 /**
  * Finds the <b>next</b> closest power of two to the right of the given number
@@ -103,15 +112,15 @@ inline uint_32_cx next_power_of_2(uint_32_cx n) noexcept {
  * @return the square root of n
  */
 inline float fast_sqrt(float n) noexcept {
-  long i;
+  int32_t i;
   float x2, y;
   const float threehalfs = 1.5F;
 
   x2 = n * 0.5F;
   y = n;
-  i = *(long*)&y;
+  std::memcpy(&i, &y, sizeof(float));  // long is 8 bytes on LP64 and read past the float
   i = 0x5f3759df - (i >> 1);
-  y = *(float*)&i;
+  std::memcpy(&y, &i, sizeof(float));
   y = y * (threehalfs - (x2 * y * y));
   return 1.0F / y;
 }
@@ -121,18 +130,16 @@ inline float euclidean(float p1x, float p1y, float p2x, float p2y) noexcept {
   return fast_sqrt((p2x - p1x) * (p2x - p1x) + (p2y - p1y) * (p2y - p1y));
 }
 inline float manhattan(float p1x, float p1y, float p2x, float p2y) noexcept {
-  return abs(p2x - p1x) + abs(p2y - p1y);
+  return std::abs(p2x - p1x) + std::abs(p2y - p1y);
+}
+// squared euclidean - orders like euclidean without the sqrt
+inline float squared_euclidean(float p1x, float p1y, float p2x, float p2y) noexcept {
+  return (p2x - p1x) * (p2x - p1x) + (p2y - p1y) * (p2y - p1y);
 }
 
-//multidimensional distance functions
+//multidimensional distance functions - the SIMD metric functors are in cxdistance.h
 inline float chebyshev(const vec<float, false>& p1, const vec<float, false>& p2) noexcept {
-  float max = 0;
-  for (uint_fast32_t i = 0; i < p1.size(); i++) {
-    if (p2[i] - p1[i] > max) {
-      max = p2[i] - p1[i];
-    }
-    return max;
-  }
+  return cxhelper::linf_simd(p1.get_raw(), p2.get_raw(), std::min(p1.size(), p2.size()));
 }
 }  // namespace cxstructs
 #endif  //CXSTRUCTS_SRC_CXUTIL_MATH_H_
@@ -0,0 +1,374 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXSNAPSHOT_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXSNAPSHOT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <type_traits>
+#include "../cxconfig.h"
+#include "cxio.h"
+
+// Binary snapshots of containers - a warm restart maps the file and copies whole arrays instead of
+// inserting element by element.
+//
+// File:    header | section | section | ...
+// Section: 64 byte aligned, a descriptor (tag, version, element size, count, payload bytes) then the payload
+// Arrays of trivially copyable elements are stored raw and aligned, node based containers write their nodes
+// in a fixed order with counts and offsets in place of pointers, so nothing in the file is an address.
+// Containers implement save_snapshot(Writer&) and load_snapshot(Reader&) member templates - they dont
+// include this header, SnapshotWriter and SnapshotReader are the only implementations.
+
+namespace cxhelper {
+struct SnapshotHeader {
+  static constexpr uint64_t kMagic = 0x31504e5358435843ULL;  // "CXCXSNP1"
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kEndian = 0x01020304;  // reads back swapped on a machine of the other endianness
+  uint64_t magic;
+  uint32_t version;
+  uint32_t endian;
+  uint64_t sections;
+  uint64_t reserved;
+};
+struct SnapshotSection {
+  char tag[8];
+  uint32_t version;    // version of the container layout
+  uint32_t elem_size;  // sizeof the element type(s), guards against loading into a different type
+  uint64_t count;      // number of elements
+  uint64_t bytes;      // payload bytes after this descriptor
+};
+constexpr size_t kSnapshotAlign = 64;
+constexpr size_t snapshot_pad(size_t offset, size_t align) noexcept {
+  return (align - offset % align) % align;
+}
+inline void snapshot_tag(const char* name, char (&tag)[8]) noexcept {
+  std::memset(tag, 0, sizeof(tag));
+  std::memcpy(tag, name, std::min<size_t>(std::strlen(name), sizeof(tag)));
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>SnapshotWriter</h2>
+ * Writes container sections into a snapshot file through one sequential stream.<p>
+ * Errors are sticky - close() reports whether everything reached the file.
+ */
+class SnapshotWriter {
+  FILE* file_ = nullptr;
+  uint64_t offset_ = 0;
+  uint64_t sections_ = 0;
+  uint64_t section_start_ = 0;
+  cxhelper::SnapshotSection current_{};
+  bool in_section_ = false;
+  bool ok_ = false;
+
+  inline void raw(const void* data, size_t bytes) {
+    if (ok_ && bytes > 0) {
+      ok_ = std::fwrite(data, 1, bytes, file_) == bytes;
+    }
+    offset_ += bytes;
+  }
+  inline void pad(size_t align) {
+    static constexpr char zeros[cxhelper::kSnapshotAlign]{};
+    raw(zeros, cxhelper::snapshot_pad(offset_, align));
+  }
+  inline void write_header() {
+    const cxhelper::SnapshotHeader header{cxhelper::SnapshotHeader::kMagic, cxhelper::SnapshotHeader::kVersion,
+                                          cxhelper::SnapshotHeader::kEndian, sections_, 0};
+    raw(&header, sizeof(header));
+  }
+
+ public:
+  /**
+   * @param filePath the snapshot file, overwritten
+   */
+  explicit SnapshotWriter(const std::string& filePath) {
+    file_ = std::fopen(filePath.c_str(), "wb");
+    ok_ = file_ != nullptr;
+    if (ok_) {
+      std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+      write_header();
+    }
+  }
+  SnapshotWriter(const SnapshotWriter&) = delete;
+  SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+  ~SnapshotWriter() { close(); }
+  /**
+   * Starts a section - called by the containers
+   * @param tag up to 8 characters naming the container
+   * @param version version of the container layout
+   * @param elem_size sizeof the stored element type(s)
+   * @param count number of elements
+   */
+  inline void begin(const char* tag, uint32_t version, uint32_t elem_size, uint64_t count) {
+    CX_ASSERT(!in_section_, "previous section was not ended");
+    pad(cxhelper::kSnapshotAlign);
+    section_start_ = offset_;
+    cxhelper::snapshot_tag(tag, current_.tag);
+    current_.version = version;
+    current_.elem_size = elem_size;
+    current_.count = count;
+    current_.bytes = 0;
+    raw(&current_, sizeof(current_));
+    in_section_ = true;
+  }
+  /**
+   * Writes a single trivially copyable value unaligned
+   */
+  template <typename T>
+  inline void write_value(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable values are written raw");
+    raw(&value, sizeof(T));
+  }
+  /**
+   * Writes n trivially copyable elements as one block, aligned to at least 8 bytes
+   */
+  template <typename T>
+  inline void write_array(const T* data, size_t n) {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable arrays are written raw");
+    pad(std::max<size_t>(8, alignof(T)));
+    raw(data, n * sizeof(T));
+  }
+  /**
+   * Writes a string as its length followed by its characters
+   */
+  inline void write_string(std::string_view s) {
+    write_value(static_cast<uint64_t>(s.size()));
+    raw(s.data(), s.size());
+  }
+  /**
+   * Writes a trivially copyable value raw, a std::string with its length
+   */
+  template <typename T>
+  inline void write_item(const T& item) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      write_string(item);
+    } else {
+      write_value(item);
+    }
+  }
+  /**
+   * Ends the current section and fills in its payload size
+   */
+  inline void end() {
+    CX_ASSERT(in_section_, "no section to end");
+    in_section_ = false;
+    sections_++;
+    current_.bytes = offset_ - section_start_ - sizeof(current_);
+    if (ok_) {
+      const auto here = static_cast<long>(offset_);
+      ok_ = std::fseek(file_, static_cast<long>(section_start_), SEEK_SET) == 0 &&
+            std::fwrite(&current_, 1, sizeof(current_), file_) == sizeof(current_) &&
+            std::fseek(file_, here, SEEK_SET) == 0;
+    }
+  }
+  /**
+   * Writes the final header and closes the file
+   * @return true if the whole snapshot was written
+   */
+  inline bool close() {
+    if (!file_) {
+      return ok_;
+    }
+    if (ok_) {
+      ok_ = std::fseek(file_, 0, SEEK_SET) == 0;
+      const uint64_t end = offset_;
+      offset_ = 0;
+      write_header();
+      offset_ = end;
+    }
+    ok_ = std::fclose(file_) == 0 && ok_;
+    file_ = nullptr;
+    return ok_;
+  }
+  [[nodiscard]] inline bool ok() const noexcept { return ok_; }
+};
+
+/**
+ * <h2>SnapshotReader</h2>
+ * Reads a snapshot file through a read-only memory mapping.<p>
+ * Arrays are handed out as pointers into the mapping - loading copies them in one go, views use them in
+ * place as long as the reader is alive. Every read is bounds checked against the current section,
+ * a malformed or mismatching file makes the calls return false / nullptr and the reader stays failed.
+ */
+class SnapshotReader {
+  MappedFile file_;
+  size_t offset_ = 0;
+  size_t section_end_ = 0;
+  uint64_t sections_ = 0;
+  bool ok_ = false;
+
+  inline const char* raw(size_t bytes) noexcept {
+    if (!ok_ || bytes > section_end_ - offset_) {
+      ok_ = false;
+      return nullptr;
+    }
+    const char* ptr = file_.data() + offset_;
+    offset_ += bytes;
+    return ptr;
+  }
+
+ public:
+  /**
+   * @param filePath the snapshot file
+   */
+  explicit SnapshotReader(const std::string& filePath) : file_(filePath) {
+    cxhelper::SnapshotHeader header{};
+    ok_ = file_.is_open() && file_.size() >= sizeof(header);
+    if (ok_) {
+      std::memcpy(&header, file_.data(), sizeof(header));
+      ok_ = header.magic == cxhelper::SnapshotHeader::kMagic &&
+            header.version == cxhelper::SnapshotHeader::kVersion &&
+            header.endian == cxhelper::SnapshotHeader::kEndian;
+      offset_ = sizeof(header);
+      sections_ = header.sections;
+      file_.advise(Access::SEQUENTIAL);
+    }
+  }
+  /**
+   * Opens the next section - called by the containers
+   * @param tag the expected container tag
+   * @param version the expected layout version
+   * @param elem_size the expected element size
+   * @param count set to the element count of the section
+   * @return false if the next section doesnt match
+   */
+  inline bool begin(const char* tag, uint32_t version, uint32_t elem_size, uint64_t& count) noexcept {
+    if (!ok_ || sections_ == 0) {
+      return ok_ = false;
+    }
+    offset_ += cxhelper::snapshot_pad(offset_, cxhelper::kSnapshotAlign);
+    cxhelper::SnapshotSection section{};
+    char expected[8];
+    cxhelper::snapshot_tag(tag, expected);
+    if (offset_ > file_.size() || file_.size() - offset_ < sizeof(section)) {
+      return ok_ = false;
+    }
+    std::memcpy(&section, file_.data() + offset_, sizeof(section));
+    offset_ += sizeof(section);
+    if (std::memcmp(section.tag, expected, sizeof(expected)) != 0 || section.version != version ||
+        section.elem_size != elem_size || section.bytes > file_.size() - offset_) {
+      return ok_ = false;
+    }
+    section_end_ = offset_ + section.bytes;
+    count = section.count;
+    sections_--;
+    return true;
+  }
+  /**
+   * Reads a single trivially copyable value
+   */
+  template <typename T>
+  inline bool read_value(T& value) noexcept {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable values are read raw");
+    const char* ptr = raw(sizeof(T));
+    if (ptr) {
+      std::memcpy(&value, ptr, sizeof(T));
+    }
+    return ptr != nullptr;
+  }
+  /**
+   * @return n elements in place inside the mapping or nullptr
+   */
+  template <typename T>
+  inline const T* read_array(size_t n) noexcept {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable arrays are read raw");
+    const size_t pad = cxhelper::snapshot_pad(offset_, std::max<size_t>(8, alignof(T)));
+    if (!raw(pad) || n > (section_end_ - offset_) / std::max<size_t>(1, sizeof(T))) {
+      ok_ = false;
+      return nullptr;
+    }
+    return reinterpret_cast<const T*>(raw(n * sizeof(T)));
+  }
+  /**
+   * @return a string written with write_string() - points into the mapping
+   */
+  inline bool read_string(std::string_view& s) noexcept {
+    uint64_t size = 0;
+    if (!read_value(size)) {
+      return false;
+    }
+    const char* ptr = raw(size);
+    s = ptr ? std::string_view(ptr, size) : std::string_view();
+    return ptr != nullptr;
+  }
+  /**
+   * Reads a value written with write_item()
+   */
+  template <typename T>
+  inline bool read_item(T& item) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      std::string_view s;
+      if (!read_string(s)) {
+        return false;
+      }
+      item.assign(s);
+      return true;
+    } else {
+      return read_value(item);
+    }
+  }
+  /**
+   * Skips what is left of the current section
+   * @return false if the reader failed on the way
+   */
+  inline bool end() noexcept {
+    offset_ = section_end_;
+    return ok_;
+  }
+  [[nodiscard]] inline bool ok() const noexcept { return ok_; }
+};
+
+/**
+ * Saves the given containers into one snapshot file, in order.
+ * <pre>
+ * save_snapshot("warm.snap", names, index, trie);
+ * ...
+ * load_snapshot("warm.snap", names, index, trie);
+ * </pre>
+ * Supported are vec, HashMap, HashSet, Trie and QuadTree. Elements have to be trivially copyable or
+ * std::string (where noted). Hash based containers keep their bucket layout, so they have to be loaded
+ * with the same hash function.
+ * @return true if the file was written completely
+ */
+template <typename... Containers>
+bool save_snapshot(const std::string& filePath, const Containers&... containers) {
+  SnapshotWriter writer(filePath);
+  (containers.save_snapshot(writer), ...);
+  return writer.close();
+}
+/**
+ * Loads containers from a snapshot written by save_snapshot() with the same container types and order.<p>
+ * Containers that follow a failed one are left untouched
+ * @return true if every container was loaded
+ */
+template <typename... Containers>
+bool load_snapshot(const std::string& filePath, Containers&... containers) {
+  SnapshotReader reader(filePath);
+  return (containers.load_snapshot(reader) && ...);
+}
+}  // namespace cxstructs
+
+#endif  // CXSTRUCTS_SRC_CXUTIL_CXSNAPSHOT_H_
@@ -0,0 +1,258 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXTHREADPOOL_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXTHREADPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxstructs/WorkStealingDeque.h"
+
+// Shared worker threads for everything in the library that can run in parallel
+// Every worker owns a WorkStealingDeque, tasks created on a worker go to its own deque and idle workers steal them
+// Tasks from other threads go through one locked injection queue
+// parallel_for() lets the calling thread work as well and only waits for chunks that are already running,
+// so nested loops run in parallel and still cant deadlock
+
+namespace cxstructs {
+/**
+ * <h2>ThreadPool</h2>
+ * A fixed number of worker threads with work stealing.
+ * <br><br>
+ * Use <code>ThreadPool::global()</code> to share one pool across the library instead of starting threads per call.
+ * Sorting, the mat kernels, k-NN and the other batch paths all run on it.
+ * <pre>
+ * auto result = pool.submit([]() { return 5; });
+ * pool.parallel_for(0, n, [&](uint_32_cx begin, uint_32_cx end) { ... });
+ * </pre>
+ */
+class ThreadPool {
+  using Task = std::function<void()>;
+  struct Worker {
+    WorkStealingDeque<Task*> deque_;
+    std::thread thread_;
+  };
+  struct Current {
+    const ThreadPool* pool = nullptr;
+    uint_32_cx index = 0;
+  };
+  // shared between parallel_for() and its helper tasks, helpers can outlive the call
+  struct LoopState {
+    std::atomic<uint_32_cx> next{0};
+    std::atomic<uint_32_cx> active{0};
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::deque<Task*> injected_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::atomic<int64_t> pending_{0};  // queued tasks that no thread has taken yet
+  std::atomic<uint_32_cx> sleeping_{0};
+  bool stop_ = false;
+
+  static inline Current& current() noexcept {
+    thread_local Current current;
+    return current;
+  }
+  Task* take(uint_32_cx index) {
+    Task* task = nullptr;
+    if (workers_[index]->deque_.pop_back(task)) {
+      return task;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!injected_.empty()) {
+        task = injected_.front();
+        injected_.pop_front();
+        return task;
+      }
+    }
+    for (uint_32_cx i = 1; i < workers_.size(); i++) {
+      if (workers_[(index + i) % workers_.size()]->deque_.steal(task)) {
+        return task;
+      }
+    }
+    return nullptr;
+  }
+  void work(uint_32_cx index) {
+    current() = {this, index};
+    while (true) {
+      if (Task* task = take(index)) {
+        pending_--;
+        (*task)();
+        delete task;
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (pending_.load() > 0) {
+        // a task is in flight between deques or a steal lost a race
+        lock.unlock();
+        std::this_thread::yield();
+        continue;
+      }
+      if (stop_) {
+        return;
+      }
+      sleeping_++;
+      condition_.wait(lock, [this] { return stop_ || pending_.load() > 0; });
+      sleeping_--;
+    }
+  }
+  void push(Task* task) {
+    pending_++;
+    const Current& self = current();
+    if (self.pool == this) {
+      workers_[self.index]->deque_.push_back(task);
+      if (sleeping_.load() == 0) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+    } else {
+      std::lock_guard<std::mutex> lock(mutex_);
+      injected_.push_back(task);
+    }
+    condition_.notify_one();
+  }
+
+ public:
+  /**
+   * @param threads number of worker threads - 0 creates none and runs everything on the calling thread
+   */
+  explicit ThreadPool(uint_32_cx threads = std::max(1U, std::thread::hardware_concurrency())) {
+    workers_.reserve(threads);
+    for (uint_32_cx i = 0; i < threads; i++) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+    for (uint_32_cx i = 0; i < threads; i++) {
+      workers_[i]->thread_ = std::thread([this, i] { work(i); });
+    }
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  /**
+   * Finishes all queued tasks before joining the workers
+   */
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker : workers_) {
+      worker->thread_.join();
+    }
+  }
+  /**
+   * The library wide pool, created on first use.<p>
+   * Has one worker less than there are hardware threads as the caller of parallel_for() works as well
+   */
+  static ThreadPool& global() {
+    static ThreadPool pool(std::max(1U, std::thread::hardware_concurrency()) - 1);
+    return pool;
+  }
+  /**
+   * @return the number of worker threads
+   */
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return workers_.size(); }
+  /**
+   * @return true if the calling thread is a worker of this pool
+   */
+  [[nodiscard]] inline bool is_worker() const noexcept { return current().pool == this; }
+  /**
+   * Queues a task - on a worker it goes to the front of that workers own deque
+   * @param func callable without arguments
+   * @return a future to the result of func
+   */
+  template <typename Function>
+  auto submit(Function func) -> std::future<std::invoke_result_t<Function>> {
+    using R = std::invoke_result_t<Function>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::move(func));
+    std::future<R> future = task->get_future();
+    if (workers_.empty()) {
+      (*task)();
+      return future;
+    }
+    push(new Task([task] { (*task)(); }));
+    return future;
+  }
+  /**
+   * Splits [begin, end) into chunks and calls func(chunk_begin, chunk_end) for each of them on the workers
+   * and the calling thread. Returns once all chunks are done.<p>
+   * Works from inside a worker as well: the helpers go to its own deque where idle workers steal them.
+   * The caller never runs unrelated tasks while it waits, so thread_local scratch buffers stay safe.
+   * @param begin first index
+   * @param end one past the last index
+   * @param func callable taking (uint_32_cx, uint_32_cx) - has to be thread safe
+   * @param grain minimal number of indices per chunk
+   */
+  template <typename Function>
+  void parallel_for(uint_32_cx begin, uint_32_cx end, Function func, uint_32_cx grain = 1) {
+    if (end <= begin) {
+      return;
+    }
+    const uint_32_cx n = end - begin;
+    grain = std::max<uint_32_cx>(grain, 1);
+    // a few chunks per thread to balance uneven work
+    const uint_32_cx chunks = std::min<uint_32_cx>((size() + 1) * 4, (n + grain - 1) / grain);
+    if (chunks <= 1 || workers_.empty()) {
+      func(begin, end);
+      return;
+    }
+    const uint_32_cx chunk_size = (n + chunks - 1) / chunks;
+    auto state = std::make_shared<LoopState>();
+    Function* body = &func;
+    // func is only touched after claiming a chunk, late helpers find none left and return
+    auto run = [state, body, begin, end, chunks, chunk_size] {
+      for (uint_32_cx c = state->next++; c < chunks; c = state->next++) {
+        const uint_32_cx chunk_begin = begin + c * chunk_size;
+        if (chunk_begin < end) {
+          (*body)(chunk_begin, std::min(end, chunk_begin + chunk_size));
+        }
+      }
+    };
+    const uint_32_cx helpers = std::min<uint_32_cx>(size(), chunks - 1);
+    for (uint_32_cx i = 0; i < helpers; i++) {
+      push(new Task([state, run] {
+        state->active++;
+        run();
+        if (--state->active == 0) {
+          state->active.notify_all();
+        }
+      }));
+    }
+    run();
+    // every chunk is claimed, wait for the ones still running on helpers
+    for (uint_32_cx active = state->active.load(); active != 0; active = state->active.load()) {
+      state->active.wait(active);
+    }
+  }
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXUTIL_CXTHREADPOOL_H_
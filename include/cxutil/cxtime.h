@@ -21,17 +21,31 @@
 #ifndef CX_TIME_H
 #define CX_TIME_H
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "../cxconfig.h"
 
 namespace cxstructs {
 using namespace std;  //std:: makes this code unreadable
 
-static chrono::time_point<chrono::high_resolution_clock> activeTimeStamp;
-static chrono::time_point<chrono::high_resolution_clock> checkpoints[3];
+// per thread, so threads timing themselves do not overwrite each other
+inline thread_local chrono::time_point<chrono::high_resolution_clock> activeTimeStamp;
+inline thread_local chrono::time_point<chrono::high_resolution_clock> checkpoints[3];
 
 /**
  * Sets the activeTimeStamp or alternatively the time of a checkpoint
@@ -74,7 +88,7 @@ inline std::string get_duration_unit<std::chrono::duration<double>>() {
 
 
 template <typename DurationType = std::chrono::duration<double>>
-inline void printTime(const std::string& prefix = "", int checkpoint = -1) {
+inline void printTime(const std::string& prefix = "", int checkpoint = -1, std::ostream& out = std::cout) {
   std::chrono::time_point<std::chrono::high_resolution_clock> start_time;
   if (checkpoint >= 0 && checkpoint < 3) {
     start_time = checkpoints[checkpoint];
@@ -86,10 +100,10 @@ inline void printTime(const std::string& prefix = "", int checkpoint = -1) {
   auto diffInDesiredUnits = std::chrono::duration_cast<DurationType>(diff);
 
   if (!prefix.empty()) {
-    std::cout << prefix << " ";
+    out << prefix << " ";
   }
-  std::cout << std::fixed << std::setprecision(3) << diffInDesiredUnits.count() << " "
-            << get_duration_unit<DurationType>() << std::endl;
+  out << std::fixed << std::setprecision(3) << diffInDesiredUnits.count() << " "
+      << get_duration_unit<DurationType>() << std::endl;
 }
 
 template <typename DurationType = std::chrono::duration<double>>
@@ -105,5 +119,665 @@ inline long long getTime(int checkpoint = -1) {
   return diffInDesiredUnits.count();
 }
 
+/**
+ * <h2>Stopwatch</h2>
+ * A timer object - unlike now() and printTime() it can be owned by any thread or struct.
+ */
+class Stopwatch {
+  chrono::steady_clock::time_point start_ = chrono::steady_clock::now();
+
+ public:
+  inline void reset() noexcept { start_ = chrono::steady_clock::now(); }
+  /**
+   * @return the time since construction or the last reset() in DurationType units
+   */
+  template <typename DurationType = std::chrono::duration<double>>
+  [[nodiscard]] inline auto elapsed() const noexcept {
+    return chrono::duration_cast<DurationType>(chrono::steady_clock::now() - start_).count();
+  }
+};
+
+/**
+ * One line of the flat profile - all times in nanoseconds
+ */
+struct ProfileEntry {
+  const char* name;
+  uint64_t calls = 0;
+  uint64_t total = 0;  // including nested zones
+  uint64_t self = 0;   // without nested zones
+  uint64_t min = UINT64_MAX;
+  uint64_t max = 0;
+};
+
+}  // namespace cxstructs
+
+namespace cxhelper {
+struct ProfileEvent {
+  const char* name;
+  uint64_t start;  // ns since the profiler epoch
+  uint64_t duration;
+  uint64_t self;
+};
+// events of one thread - only the owning thread appends, readers see everything below count
+struct ProfileBuffer {
+  static constexpr uint32_t kBlockSize = 4096;
+  static constexpr uint32_t kMaxBlocks = 1024;
+  static constexpr uint32_t kMaxDepth = 64;
+  std::atomic<ProfileEvent*> blocks[kMaxBlocks]{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> dropped{0};
+  uint64_t child_time[kMaxDepth + 1]{};  // time of finished children per depth, owner only
+  uint32_t depth = 0;
+  uint32_t thread_id;
+  std::string thread_name;
+
+  explicit ProfileBuffer(uint32_t id) : thread_id(id) {}
+  ~ProfileBuffer() {
+    for (auto& block : blocks) {
+      delete[] block.load(std::memory_order_relaxed);
+    }
+  }
+  void push(const ProfileEvent& event) noexcept {
+    const uint64_t index = count.load(std::memory_order_relaxed);
+    const uint64_t block = index / kBlockSize;
+    if (block >= kMaxBlocks) [[unlikely]] {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ProfileEvent* events = blocks[block].load(std::memory_order_relaxed);
+    if (events == nullptr) [[unlikely]] {
+      events = new (std::nothrow) ProfileEvent[kBlockSize];
+      if (events == nullptr) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      blocks[block].store(events, std::memory_order_release);
+    }
+    events[index % kBlockSize] = event;
+    count.store(index + 1, std::memory_order_release);  // publishes the event to readers
+  }
+  template <typename Func>
+  void for_each(Func func) const {
+    const uint64_t n = count.load(std::memory_order_acquire);
+    for (uint64_t i = 0; i < n; i++) {
+      func(blocks[i / kBlockSize].load(std::memory_order_acquire)[i % kBlockSize]);
+    }
+  }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>Profiler</h2>
+ * Collects the zones of CX_PROFILE_SCOPE() from all threads.
+ * <br><br>
+ * Every thread appends to its own buffer without locks or atomic read-modify-writes, the buffers outlive
+ * their threads. Reports aggregate all buffers into a flat profile (calls, total and self time per zone)
+ * or export them as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.<p>
+ * Recording is off until set_enabled(true), a disabled zone costs one relaxed load. Define CX_NO_PROFILE to
+ * remove the zones at compile time. Zone names have to outlive the profiler - string literals.
+ */
+class Profiler {
+  static inline std::atomic<bool> enabled_{false};
+  static inline std::mutex mutex_;
+  static inline std::vector<std::shared_ptr<cxhelper::ProfileBuffer>> buffers_;
+  static inline const chrono::steady_clock::time_point epoch_ = chrono::steady_clock::now();
+
+ public:
+  static inline void set_enabled(bool enabled) noexcept {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+  [[nodiscard]] static inline bool enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+  /**
+   * @return nanoseconds since the profiler epoch
+   */
+  [[nodiscard]] static inline uint64_t now_ns() noexcept {
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch_).count());
+  }
+  /**
+   * @return the buffer of the calling thread, created on first use
+   */
+  static cxhelper::ProfileBuffer& thread_buffer() {
+    thread_local std::shared_ptr<cxhelper::ProfileBuffer> buffer = [] {
+      std::lock_guard lock(mutex_);
+      buffers_.push_back(std::make_shared<cxhelper::ProfileBuffer>(static_cast<uint32_t>(buffers_.size())));
+      return buffers_.back();
+    }();
+    return *buffer;
+  }
+  /**
+   * Names the calling thread in the trace export
+   */
+  static void set_thread_name(const std::string& name) {
+    auto& buffer = thread_buffer();
+    std::lock_guard lock(mutex_);
+    buffer.thread_name = name;
+  }
+  /**
+   * Drops all recorded events - only call while no thread is inside a zone
+   */
+  static void clear() {
+    std::lock_guard lock(mutex_);
+    for (auto& buffer : buffers_) {
+      buffer->count.store(0, std::memory_order_release);
+      buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+  }
+  /**
+   * @return events lost because a thread buffer was full
+   */
+  [[nodiscard]] static uint64_t dropped() {
+    std::lock_guard lock(mutex_);
+    uint64_t dropped = 0;
+    for (const auto& buffer : buffers_) {
+      dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+  }
+  /**
+   * Aggregates the events of all threads by zone name
+   * @return one entry per zone, sorted by self time - the hottest first
+   */
+  [[nodiscard]] static std::vector<ProfileEntry> flat_profile() {
+    std::unordered_map<std::string, ProfileEntry> entries;
+    {
+      std::lock_guard lock(mutex_);
+      for (const auto& buffer : buffers_) {
+        buffer->for_each([&](const cxhelper::ProfileEvent& event) {
+          auto [it, inserted] = entries.try_emplace(event.name, ProfileEntry{event.name});
+          ProfileEntry& entry = it->second;
+          entry.calls++;
+          entry.total += event.duration;
+          entry.self += event.self;
+          entry.min = std::min(entry.min, event.duration);
+          entry.max = std::max(entry.max, event.duration);
+        });
+      }
+    }
+    std::vector<ProfileEntry> profile;
+    profile.reserve(entries.size());
+    for (auto& [name, entry] : entries) {
+      profile.push_back(entry);
+    }
+    std::sort(profile.begin(), profile.end(),
+              [](const ProfileEntry& a, const ProfileEntry& b) { return a.self > b.self; });
+    return profile;
+  }
+  /**
+   * Prints the flat profile as a table
+   */
+  static void print(std::ostream& out = std::cout) {
+    const std::vector<ProfileEntry> profile = flat_profile();
+    uint64_t self_sum = 0;
+    for (const ProfileEntry& entry : profile) {
+      self_sum += entry.self;
+    }
+    out << std::left << std::setw(32) << "zone" << std::right << std::setw(10) << "calls" << std::setw(14)
+        << "self ms" << std::setw(9) << "self %" << std::setw(14) << "total ms" << std::setw(14)
+        << "avg us" << std::setw(14) << "max us" << "\n";
+    for (const ProfileEntry& entry : profile) {
+      out << std::left << std::setw(32) << entry.name << std::right << std::setw(10) << entry.calls
+          << std::fixed << std::setprecision(3) << std::setw(14) << entry.self / 1e6 << std::setw(8)
+          << std::setprecision(1) << (self_sum ? 100.0 * entry.self / self_sum : 0) << "%"
+          << std::setprecision(3) << std::setw(14) << entry.total / 1e6 << std::setw(14)
+          << entry.total / 1e3 / entry.calls << std::setw(14) << entry.max / 1e3 << "\n";
+    }
+    out << std::defaultfloat;
+  }
+  /**
+   * Writes all events as Chrome trace JSON ("X" complete events, one track per thread)
+   */
+  static void write_chrome_trace(std::ostream& out) {
+    std::lock_guard lock(mutex_);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : buffers_) {
+      if (!buffer->thread_name.empty()) {
+        out << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)"
+            << buffer->thread_id << R"(,"args":{"name":")" << buffer->thread_name << "\"}}";
+        first = false;
+      }
+      buffer->for_each([&](const cxhelper::ProfileEvent& event) {
+        out << (first ? "\n" : ",\n") << R"({"name":")" << event.name << R"(","ph":"X","pid":1,"tid":)"
+            << buffer->thread_id << std::fixed << std::setprecision(3) << ",\"ts\":" << event.start / 1e3
+            << ",\"dur\":" << event.duration / 1e3 << "}";
+        first = false;
+      });
+    }
+    out << "\n]}\n" << std::defaultfloat;
+  }
+  /**
+   * Writes the Chrome trace JSON to a file
+   * @return false if the file could not be written
+   */
+  static bool write_chrome_trace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+      return false;
+    }
+    write_chrome_trace(out);
+    return out.good();
+  }
+};
+
+/**
+ * <h2>ProfileZone</h2>
+ * Records the time from construction to destruction as one event - use CX_PROFILE_SCOPE(name)
+ */
+class ProfileZone {
+  const char* name_;
+  cxhelper::ProfileBuffer* buffer_ = nullptr;
+  uint64_t start_ = 0;
+
+ public:
+  explicit ProfileZone(const char* name) noexcept : name_(name) {
+    if (Profiler::enabled()) [[unlikely]] {
+      buffer_ = &Profiler::thread_buffer();
+      buffer_->depth++;
+      start_ = Profiler::now_ns();
+    }
+  }
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+  ~ProfileZone() {
+    if (buffer_ == nullptr) {
+      return;
+    }
+    const uint64_t duration = Profiler::now_ns() - start_;
+    const uint32_t depth = std::min(--buffer_->depth, cxhelper::ProfileBuffer::kMaxDepth - 1);
+    // children finished before their parent, their summed time is what is not self time
+    uint64_t& children = buffer_->child_time[depth + 1];
+    const uint64_t self = duration - std::min(children, duration);
+    children = 0;
+    buffer_->child_time[depth] += duration;
+    buffer_->push({name_, start_, duration, self});
+  }
+};
+
+}  // namespace cxstructs
+
+namespace cxhelper {
+// Log-linear buckets of the latency histograms: values below 2^kHdrSubBits get their own bucket, above that
+// every power of two is split into 2^kHdrSubBits equal buckets - so a bucket is never wider than 1/128 of its
+// values (0.8% relative error) and the whole uint64_t range takes a fixed 7424 buckets
+constexpr uint32_t kHdrSubBits = 7;
+constexpr uint64_t kHdrSubBuckets = uint64_t(1) << kHdrSubBits;
+constexpr uint32_t kHdrBuckets = (65 - kHdrSubBits) * kHdrSubBuckets;
+
+inline uint32_t hdr_index(uint64_t value) noexcept {
+  if (value < kHdrSubBuckets) {
+    return static_cast<uint32_t>(value);
+  }
+  const uint32_t shift = static_cast<uint32_t>(63 - std::countl_zero(value)) - kHdrSubBits;
+  return ((shift + 1) << kHdrSubBits) + static_cast<uint32_t>((value >> shift) - kHdrSubBuckets);
+}
+// smallest value of the bucket
+inline uint64_t hdr_lower(uint32_t index) noexcept {
+  if (index < kHdrSubBuckets) {
+    return index;
+  }
+  const uint32_t shift = (index >> kHdrSubBits) - 1;
+  return ((index & (kHdrSubBuckets - 1)) + kHdrSubBuckets) << shift;
+}
+// largest value of the bucket
+inline uint64_t hdr_upper(uint32_t index) noexcept {
+  if (index < kHdrSubBuckets) {
+    return index;
+  }
+  const uint32_t shift = (index >> kHdrSubBits) - 1;
+  return hdr_lower(index) + ((uint64_t(1) << shift) - 1);
+}
+// counters of one recording thread - only the owner writes, with plain load + store instead of atomic
+// read-modify-writes, readers merge them at any time
+struct alignas(64) HdrShard {
+  std::atomic<uint64_t> counts[kHdrBuckets]{};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> min{UINT64_MAX};
+  std::atomic<uint64_t> max{0};
+  bool shared = false;  // the overflow shard of threads beyond the shard limit - uses real atomics
+
+  inline void record(uint64_t value, uint64_t count) noexcept {
+    auto& bucket = counts[hdr_index(value)];
+    if (!shared) [[likely]] {
+      bucket.store(bucket.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+      total.store(total.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+      sum.store(sum.load(std::memory_order_relaxed) + value * count, std::memory_order_relaxed);
+      if (value < min.load(std::memory_order_relaxed)) {
+        min.store(value, std::memory_order_relaxed);
+      }
+      if (value > max.load(std::memory_order_relaxed)) {
+        max.store(value, std::memory_order_relaxed);
+      }
+      return;
+    }
+    bucket.fetch_add(count, std::memory_order_relaxed);
+    total.fetch_add(count, std::memory_order_relaxed);
+    sum.fetch_add(value * count, std::memory_order_relaxed);
+    uint64_t seen = min.load(std::memory_order_relaxed);
+    while (value < seen && !min.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    seen = max.load(std::memory_order_relaxed);
+    while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+  }
+  inline void reset() noexcept {
+    for (auto& count : counts) {
+      count.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    min.store(UINT64_MAX, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+  }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * One range of a coarse histogram export - values in [lower, upper]
+ */
+struct HistogramBucket {
+  uint64_t lower;
+  uint64_t upper;
+  uint64_t count;
+};
+
+/**
+ * <h2>LatencyHistogram</h2>
+ * HDR style log-linear histogram of integer values, typically latencies in nanoseconds.
+ * <br><br>
+ * Memory is fixed (7424 counters, 58 KiB) for the whole uint64_t range and every recorded value is off by at
+ * most 0.8% - values below 128 are exact. record() is a bucket index computation and an increment, percentiles
+ * walk the counters once. Histograms are merged by adding their counters.
+ * <p>
+ * Not thread safe - for many recording threads use a LatencyRecorder
+ */
+class LatencyHistogram {
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+
+  friend class LatencyRecorder;
+
+ public:
+  LatencyHistogram() : counts_(cxhelper::kHdrBuckets, 0) {}
+  /**
+   * Records a value count times
+   */
+  inline void record(uint64_t value, uint64_t count = 1) noexcept {
+    counts_[cxhelper::hdr_index(value)] += count;
+    total_ += count;
+    sum_ += value * count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  /**
+   * Records a duration in nanoseconds
+   */
+  template <typename Rep, typename Period>
+  inline void record(chrono::duration<Rep, Period> duration) noexcept {
+    const auto ns = chrono::duration_cast<chrono::nanoseconds>(duration).count();
+    record(static_cast<uint64_t>(std::max<decltype(ns)>(ns, 0)));
+  }
+  /**
+   * Adds all values of the other histogram
+   */
+  inline void merge(const LatencyHistogram& other) noexcept {
+    for (uint32_t i = 0; i < cxhelper::kHdrBuckets; i++) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+  inline void reset() noexcept {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = sum_ = max_ = 0;
+    min_ = UINT64_MAX;
+  }
+  /**
+   * The value below or at which p percent of the recorded values are - the largest value of its bucket,
+   * clamped to the recorded min and max
+   * @param p percentile from 0 to 100
+   * @return the value, 0 if empty
+   */
+  [[nodiscard]] inline uint64_t percentile(double p) const noexcept { return percentiles({p})[0]; }
+  /**
+   * Several percentiles in one walk over the counters
+   * @param ps percentiles from 0 to 100 in any order
+   * @return one value per percentile
+   */
+  [[nodiscard]] std::vector<uint64_t> percentiles(std::initializer_list<double> ps) const {
+    std::vector<std::pair<uint64_t, size_t>> ranks;  // (rank, position in ps)
+    size_t pos = 0;
+    for (double p : ps) {
+      const double clamped = std::clamp(p, 0.0, 100.0);
+      const auto rank = static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(total_)));
+      ranks.emplace_back(std::max<uint64_t>(rank, 1), pos++);
+    }
+    std::sort(ranks.begin(), ranks.end());
+    std::vector<uint64_t> values(ranks.size(), 0);
+    if (total_ == 0) {
+      return values;
+    }
+    uint64_t seen = 0;
+    size_t next = 0;
+    for (uint32_t i = 0; i < cxhelper::kHdrBuckets && next < ranks.size(); i++) {
+      seen += counts_[i];
+      while (next < ranks.size() && ranks[next].first <= seen) {
+        values[ranks[next++].second] = std::clamp(cxhelper::hdr_upper(i), min_, max_);
+      }
+    }
+    return values;
+  }
+  /**
+   * Coarse export for plots and logs - every power of two is split into perOctave ranges (values below
+   * 2^7 are grouped the same way), only ranges with values are returned
+   * @param perOctave ranges per power of two - a power of two up to 128
+   * @return the non empty ranges in ascending order
+   */
+  [[nodiscard]] std::vector<HistogramBucket> buckets(uint32_t perOctave = 1) const {
+    perOctave = std::clamp<uint32_t>(std::bit_floor(std::max<uint32_t>(perOctave, 1)), 1,
+                                      static_cast<uint32_t>(cxhelper::kHdrSubBuckets));
+    std::vector<HistogramBucket> out;
+    for (uint32_t i = 0; i < cxhelper::kHdrBuckets; i++) {
+      if (counts_[i] == 0) {
+        continue;
+      }
+      // the range of a value: its octave [2^k, 2^(k+1)) cut into perOctave parts
+      const uint64_t low = cxhelper::hdr_lower(i);
+      uint64_t lower = 0;
+      uint64_t upper = 0;
+      if (low == 0) {
+        upper = 0;
+      } else {
+        const uint32_t octave = static_cast<uint32_t>(63 - std::countl_zero(low));
+        const uint64_t width = std::max<uint64_t>((uint64_t(1) << octave) / perOctave, 1);
+        lower = low / width * width;
+        upper = lower + width - 1;
+      }
+      if (!out.empty() && out.back().lower == lower) {
+        out.back().count += counts_[i];
+      } else {
+        out.push_back({lower, upper, counts_[i]});
+      }
+    }
+    return out;
+  }
+  [[nodiscard]] inline uint64_t count() const noexcept { return total_; }
+  [[nodiscard]] inline bool empty() const noexcept { return total_ == 0; }
+  [[nodiscard]] inline uint64_t min() const noexcept { return total_ ? min_ : 0; }
+  [[nodiscard]] inline uint64_t max() const noexcept { return max_; }
+  [[nodiscard]] inline double mean() const noexcept {
+    return total_ ? static_cast<double>(sum_) / static_cast<double>(total_) : 0.0;
+  }
+  /**
+   * Prints count, mean and the usual percentiles on one line
+   */
+  void print(const std::string& prefix = "", std::ostream& out = std::cout) const {
+    const auto p = percentiles({50, 90, 99, 99.9});
+    if (!prefix.empty()) {
+      out << prefix << " ";
+    }
+    out << "count: " << total_ << std::fixed << std::setprecision(1) << " mean: " << mean()
+        << " p50: " << p[0] << " p90: " << p[1] << " p99: " << p[2] << " p99.9: " << p[3]
+        << " max: " << max_ << std::defaultfloat << std::endl;
+  }
+};
+
+/**
+ * <h2>LatencyRecorder</h2>
+ * A LatencyHistogram that many threads record into at the same time.
+ * <br><br>
+ * Every thread gets its own set of counters on first use and increments them with plain stores - no locks and
+ * no atomic read-modify-writes on the recording path. snapshot() merges all threads into a LatencyHistogram
+ * without stopping them, so it can run at any time. The counters outlive their threads.
+ * <p>
+ * The thread remembers the last recorder it used - alternating between recorders on one thread costs a hash
+ * lookup per switch. Threads beyond the first 256 share one counter set with atomic increments.
+ */
+class LatencyRecorder {
+  static constexpr uint32_t kMaxShards = 256;
+  static inline std::atomic<uint64_t> next_id_{1};
+
+  struct ThreadCache {
+    uint64_t id = 0;
+    cxhelper::HdrShard* shard = nullptr;
+    std::unordered_map<uint64_t, cxhelper::HdrShard*> shards;  // ids are never reused
+  };
+  static inline ThreadCache& thread_cache() noexcept {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  std::atomic<cxhelper::HdrShard*> shards_[kMaxShards]{};
+  std::atomic<uint32_t> count_{0};
+  std::atomic<cxhelper::HdrShard*> overflow_{nullptr};
+  std::mutex mutex_;
+  const uint64_t id_ = next_id_.fetch_add(1, std::memory_order_relaxed);
+
+  cxhelper::HdrShard& register_thread() {
+    ThreadCache& cache = thread_cache();
+    auto it = cache.shards.find(id_);
+    cxhelper::HdrShard* shard = nullptr;
+    if (it != cache.shards.end()) {
+      shard = it->second;
+    } else {
+      std::lock_guard lock(mutex_);
+      const uint32_t n = count_.load(std::memory_order_relaxed);
+      if (n < kMaxShards) {
+        shard = new cxhelper::HdrShard();
+        shards_[n].store(shard, std::memory_order_relaxed);
+        count_.store(n + 1, std::memory_order_release);  // publishes the shard to snapshot()
+      } else {
+        shard = overflow_.load(std::memory_order_relaxed);
+        if (shard == nullptr) {
+          shard = new cxhelper::HdrShard();
+          shard->shared = true;
+          overflow_.store(shard, std::memory_order_release);
+        }
+      }
+      cache.shards.emplace(id_, shard);
+    }
+    cache.id = id_;
+    cache.shard = shard;
+    return *shard;
+  }
+  template <typename Func>
+  void for_each_shard(Func func) const {
+    const uint32_t n = count_.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < n; i++) {
+      func(*shards_[i].load(std::memory_order_relaxed));
+    }
+    if (auto* shard = overflow_.load(std::memory_order_acquire)) {
+      func(*shard);
+    }
+  }
+
+ public:
+  LatencyRecorder() = default;
+  LatencyRecorder(const LatencyRecorder&) = delete;
+  LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+  ~LatencyRecorder() {
+    for (auto& shard : shards_) {
+      delete shard.load(std::memory_order_relaxed);
+    }
+    delete overflow_.load(std::memory_order_relaxed);
+  }
+  /**
+   * Records a value from the calling thread
+   */
+  inline void record(uint64_t value, uint64_t count = 1) {
+    ThreadCache& cache = thread_cache();
+    cxhelper::HdrShard& shard = cache.id == id_ ? *cache.shard : register_thread();
+    shard.record(value, count);
+  }
+  /**
+   * Records a duration in nanoseconds from the calling thread
+   */
+  template <typename Rep, typename Period>
+  inline void record(chrono::duration<Rep, Period> duration) {
+    const auto ns = chrono::duration_cast<chrono::nanoseconds>(duration).count();
+    record(static_cast<uint64_t>(std::max<decltype(ns)>(ns, 0)));
+  }
+  /**
+   * Merges the counters of all threads - lock free, values recorded concurrently may or may not be included
+   * @return the combined histogram
+   */
+  [[nodiscard]] LatencyHistogram snapshot() const {
+    LatencyHistogram hist;
+    for_each_shard([&hist](const cxhelper::HdrShard& shard) {
+      for (uint32_t i = 0; i < cxhelper::kHdrBuckets; i++) {
+        hist.counts_[i] += shard.counts[i].load(std::memory_order_relaxed);
+      }
+      hist.total_ += shard.total.load(std::memory_order_relaxed);
+      hist.sum_ += shard.sum.load(std::memory_order_relaxed);
+      hist.min_ = std::min(hist.min_, shard.min.load(std::memory_order_relaxed));
+      hist.max_ = std::max(hist.max_, shard.max.load(std::memory_order_relaxed));
+    });
+    return hist;
+  }
+  /**
+   * Zeroes all counters - values recorded at the same time can be lost
+   */
+  void reset() {
+    for_each_shard([](cxhelper::HdrShard& shard) { shard.reset(); });
+  }
+  /**
+   * @return number of threads that recorded so far
+   */
+  [[nodiscard]] inline uint32_t threads() const noexcept { return count_.load(std::memory_order_acquire); }
+};
+
+/**
+ * <h2>LatencyTimer</h2>
+ * Records the time from construction to destruction into a LatencyHistogram or LatencyRecorder in nanoseconds
+ */
+template <typename Target>
+class LatencyTimer {
+  Target& target_;
+  chrono::steady_clock::time_point start_ = chrono::steady_clock::now();
+
+ public:
+  explicit LatencyTimer(Target& target) noexcept : target_(target) {}
+  LatencyTimer(const LatencyTimer&) = delete;
+  LatencyTimer& operator=(const LatencyTimer&) = delete;
+  ~LatencyTimer() { target_.record(chrono::steady_clock::now() - start_); }
+};
 }  // namespace cxstructs
+
+#define CX_CONCAT_IMPL(a, b) a##b
+#define CX_CONCAT(a, b) CX_CONCAT_IMPL(a, b)
+#ifndef CX_NO_PROFILE
+/**
+ * Profiles the rest of the enclosing scope under the given name - see Profiler
+ */
+#define CX_PROFILE_SCOPE(name) const cxstructs::ProfileZone CX_CONCAT(cx_profile_zone_, __LINE__)(name)
+#else
+#define CX_PROFILE_SCOPE(name) ((void)0)
+#endif
+
 #endif  //CX_TIME_H
@@ -0,0 +1,56 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// The compiled part of cxstructs - build it with -DCX_BUILD_KERNELS=ON and link cxstructs_kernels.
+// Consumers get CX_KERNELS defined, so the headers only declare the kernels below and every
+// translation unit skips parsing, instantiating and optimizing them again.
+#define CX_KERNELS_IMPL
+
+#include "cxalgos/PatternMatching.h"
+#include "cxalgos/Sorting.h"
+#include "cxstructs/HashMap.h"
+#include "cxstructs/mat.h"
+#include "cxstructs/vec.h"
+#include "cxutil/cxdistance.h"
+
+// sgemm(), sgemm_parallel(), the *_simd distance kernels, simd_find() and simd_count() are
+// defined by the headers above with CX_KERNEL - not inline in this translation unit
+
+namespace cxstructs {
+template class vec<int>;
+template class vec<float>;
+template class HashMap<int, int>;
+
+template void pdq_sort<int>(int*, uint_32_cx, bool);
+template void pdq_sort<uint32_t>(uint32_t*, uint_32_cx, bool);
+template void pdq_sort<int64_t>(int64_t*, uint_32_cx, bool);
+template void pdq_sort<float>(float*, uint_32_cx, bool);
+template void pdq_sort<double>(double*, uint_32_cx, bool);
+template void parallel_sort<int>(int*, uint_32_cx, bool, ThreadPool&);
+template void parallel_sort<uint32_t>(uint32_t*, uint_32_cx, bool, ThreadPool&);
+template void parallel_sort<int64_t>(int64_t*, uint_32_cx, bool, ThreadPool&);
+template void parallel_sort<float>(float*, uint_32_cx, bool, ThreadPool&);
+template void parallel_sort<double>(double*, uint_32_cx, bool, ThreadPool&);
+template void radix_sort<int, 0>(int*, uint_32_cx, bool, uint_32_cx);
+template void radix_sort<uint32_t, 0>(uint32_t*, uint_32_cx, bool, uint_32_cx);
+template void radix_sort<int64_t, 0>(int64_t*, uint_32_cx, bool, uint_32_cx);
+template void radix_sort<float, 0>(float*, uint_32_cx, bool, uint_32_cx);
+template void radix_sort<double, 0>(double*, uint_32_cx, bool, uint_32_cx);
+}  // namespace cxstructs
@@ -21,224 +21,233 @@
 #ifndef CXSTRUCTS_SRC_BENCHMARK_H_
 #define CXSTRUCTS_SRC_BENCHMARK_H_
 
+#include <deque>
 #include <list>
 #include <queue>
 #include <random>
+#include <stack>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include "CXStructs.h"
-inline static volatile int num1 = 2;
-//benchmarks are this /  run separately
-static void VEC() {
-  volatile int num1;
-  volatile bool force;
-  std::random_device rd;
-  std::mt19937 gen(rd());
-
-  //std::list<Data> vec;
-  //cxstructs::LinkedList<Data> vec;
-  cxstructs::HashMap<int, Data> vec;
-  // std::unordered_map<int,Data>vec;
-  //cxalgos::Queue<Data>vec;
-  //std::queue<Data> vec;
-  //std::unordered_set<int> vec;
-  //cxstructs::HashSet<int> vec;
-  //cxstructs::Queue<Data>vec;
-
-  std::uniform_int_distribution<> distr(0, 100000);
-
-  cxstructs::now();
-  for (uint_fast32_t i = 0; i < 1000000; i++) {
-    force = vec.contains(i);
-    vec.insert(distr(gen), Data());
-    force = vec.contains(i);
-  }
-  for (uint_fast32_t i = 0; i < 1000000; i++) {
-    force = vec.contains(i);
-    vec.erase(distr(gen));
-    force = vec.contains(i);
-  }
-  for (uint_fast32_t i = 0; i < 1000000; i++) {
-    force = vec.contains(i);
-    vec.insert(distr(gen), Data());
-    force = vec.contains(i);
+
+// The container benchmarks behind the speed comparison table of the README
+// Every group runs the same workload on the std:: container and the cxstruct - with the pool and the
+// std allocator policy where the cxstruct has one - the "relative" column of the report is the table entry.
+// Hash containers run with uniform, sequential and skewed keys. Built as the cxstructs_bench target
+// (-DBUILD_BENCHMARKS=ON), which counts allocations and reads the perf counters as well
+
+namespace cxbench {
+using namespace cxstructs;
+
+// a payload big enough that moving elements around is not free
+struct BenchData {
+  int arr[100]{};
+  int num = 0;
+};
+
+enum class KeyDist : uint8_t {
+  UNIFORM,     // random over 4n values - few duplicates, no locality
+  SEQUENTIAL,  // 0 to n-1 in order
+  SKEWED       // a few hot keys repeat very often, the rest is rare
+};
+
+// keys are fixed per size so every run and every container sees the same sequence
+inline std::vector<int> bench_keys(uint64_t n, KeyDist dist = KeyDist::UNIFORM) {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::vector<int> keys(n);
+  for (uint64_t i = 0; i < n; i++) {
+    switch (dist) {
+      case KeyDist::UNIFORM:
+        keys[i] = static_cast<int>(unit(gen) * static_cast<double>(n * 4));
+        break;
+      case KeyDist::SEQUENTIAL:
+        keys[i] = static_cast<int>(i);
+        break;
+      case KeyDist::SKEWED: {
+        // cubing pushes most draws towards 0 - roughly zipf like
+        const double u = unit(gen);
+        keys[i] = static_cast<int>(u * u * u * static_cast<double>(n));
+        break;
+      }
+    }
   }
-  vec.clear();
-  cxstructs::printTime<>("cxstructs::vec");
+  return keys;
 }
-static void UNORDERED_MAP() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> distr(0, 100000);
-  volatile int num1;
-  now();
-  std::unordered_map<int, Data> map;
-  for (uint_fast32_t i = 0; i < 10; i++) {
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.insert({distr(gen), Data()});
-    }
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.erase(j);
-    }
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      num1 = map[j].num;
+
+template <typename Vector>
+static void bench_vector(BenchState& state) {
+  const uint64_t n = state.arg();
+  while (state.keep_running()) {
+    Vector list;
+    for (uint64_t i = 0; i < n; i++) {
+      list.emplace_back();
     }
-  }
-  map.clear();
-  for (uint_fast32_t i = 0; i < 100; i++) {
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.insert({distr(gen), Data()});
+    for (uint64_t i = 0; i < n; i++) {
+      do_not_optimize(list[i].num);
     }
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.erase(j);
+    for (const auto& data : list) {
+      do_not_optimize(data.num);
     }
   }
-  printTime("std::unordered_map");
+  state.set_items_processed(state.iterations() * n);
 }
-static void HASH_MAP() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> distr(0, 100000);
-  volatile int num1;
-  now();
-  HashMap<int, Data> map;
-  for (uint_fast32_t i = 0; i < 10; i++) {
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.insert(distr(gen), Data());
-    }
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.erase(i);
-    }
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      num1 = map[j].num;
+
+template <typename Stack>
+static void bench_stack(BenchState& state) {
+  const uint64_t n = state.arg();
+  Stack stack;
+  while (state.keep_running()) {
+    for (uint64_t i = 0; i < n; i++) {
+      stack.emplace();
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      do_not_optimize(stack.top().num);
+      stack.pop();
     }
   }
-  map.clear();
-  for (uint_fast32_t i = 0; i < 100; i++) {
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.insert(distr(gen), Data());
-    }
-    for (uint_fast32_t j = 0; j < 10000; j++) {
-      map.erase(j);
+  state.set_items_processed(state.iterations() * n);
+}
+
+template <typename Queue>
+static void bench_queue(BenchState& state) {
+  const uint64_t n = state.arg();
+  Queue queue;
+  while (state.keep_running()) {
+    for (uint64_t i = 0; i < n; i++) {
+      queue.emplace();
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      do_not_optimize(queue.front().num);
+      do_not_optimize(queue.back().num);
+      queue.pop();
     }
   }
-  printTime("cxstructs::HashMap");
+  state.set_items_processed(state.iterations() * n);
 }
-static void CX_QUEUE() {
-  Queue<Data> q;
-  now();
-  for (uint_fast32_t i = 0; i < 1000; i++) {
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace();
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop();
-      if (j == 999) {
-        break;
-      }
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace();
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop();
+
+template <typename DeQueue>
+static void bench_dequeue(BenchState& state) {
+  const uint64_t n = state.arg();
+  DeQueue queue;
+  while (state.keep_running()) {
+    for (uint64_t i = 0; i < n; i++) {
+      queue.emplace_front();
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      do_not_optimize(queue.front().num);
+      do_not_optimize(queue.back().num);
+      queue.pop_back();
     }
-    num1 = q.size();
   }
-  printTime("cxstructs::Queue");
+  state.set_items_processed(state.iterations() * n);
 }
-static void STD_QUEUE() {
-  std::queue<Data> q;
-  now();
-  for (uint_fast32_t i = 0; i < 1000; i++) {
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace();
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop();
-      if (j == 999) {
-        break;
-      }
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace();
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop();
-    }
-    num1 = q.size();
+
+template <typename List>
+static void bench_linked_list(BenchState& state) {
+  const uint64_t n = state.arg();
+  while (state.keep_running()) {
+    List list;
+    for (uint64_t i = 0; i < n; i++) {
+      list.emplace_back();
+    }
+    for (const auto& data : list) {
+      do_not_optimize(data.num);
+    }
+    list.clear();
   }
-  printTime("std::Queue");
+  state.set_items_processed(state.iterations() * n);
 }
 
-static void CX_DEQUEUE() {
-  DeQueue<Data> q;
-  now();
-  for (uint_fast32_t i = 0; i < 2000; i++) {
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace_back();
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop_back();
-      if (j == 999) {
-        break;
+template <typename Map, KeyDist Dist>
+static void bench_hash_map(BenchState& state) {
+  const std::vector<int> keys = bench_keys(state.arg(), Dist);
+  Map map;
+  while (state.keep_running()) {
+    for (int key : keys) {
+      if constexpr (requires { map.insert_or_assign(key, key); }) {
+        map.insert_or_assign(key, key);
+      } else {
+        map.insert(key, key);
       }
     }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace_front();
+    for (int key : keys) {
+      do_not_optimize(map.contains(key + 1));
     }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop_front();
-    }
-    num1 = q.size();
-    for (const auto& elem : q) {
-      num1 = elem.num;
+    for (int key : keys) {
+      map.erase(key);
     }
   }
-  q.clear();
-  printTime("cxstructs::DeQueue");
+  state.set_items_processed(state.iterations() * keys.size());
 }
-static void STD_DEQUEUE() {
-  std::deque<Data> q;
-  now();
-  for (uint_fast32_t i = 0; i < 2000; i++) {
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace_back();
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop_back();
-      if (j == 999) {
-        break;
-      }
-    }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      q.emplace_front();
+
+template <typename Set, KeyDist Dist>
+static void bench_hash_set(BenchState& state) {
+  const std::vector<int> keys = bench_keys(state.arg(), Dist);
+  Set set;
+  while (state.keep_running()) {
+    for (int key : keys) {
+      set.insert(key);
     }
-    for (uint_fast32_t j = 0; j < 1000; j++) {
-      num1 = q.back().num;
-      num1 = q.front().num;
-      q.pop_front();
+    for (int key : keys) {
+      do_not_optimize(set.contains(key + 1));
     }
-    num1 = q.size();
-    for (const auto& elem : q) {
-      num1 = elem.num;
+    for (int key : keys) {
+      set.erase(key);
     }
   }
-  q.clear();
-  printTime("std::de_queue");
+  state.set_items_processed(state.iterations() * keys.size());
+}
+
+template <KeyDist Dist>
+inline void register_hash_benchmarks(const std::string& dist, const std::vector<uint64_t>& sizes) {
+  Benchmarks::add("HashMap/" + dist + "/std::unordered_map",
+                  bench_hash_map<std::unordered_map<int, int>, Dist>, sizes);
+  Benchmarks::add("HashMap/" + dist + "/cxstructs::HashMap", bench_hash_map<HashMap<int, int>, Dist>, sizes);
+  Benchmarks::add("HashMap/" + dist + "/cxstructs::FlatHashMap",
+                  bench_hash_map<FlatHashMap<int, int>, Dist>, sizes);
+  Benchmarks::add("HashSet/" + dist + "/std::unordered_set", bench_hash_set<std::unordered_set<int>, Dist>,
+                  sizes);
+  Benchmarks::add("HashSet/" + dist + "/cxstructs::HashSet", bench_hash_set<HashSet<int>, Dist>, sizes);
+}
+
+/**
+ * Registers the container comparisons - one group per container (and key distribution) with the std::
+ * container and the cxstruct using the PoolAlloc and the StdAlloc policy
+ * @param sizes element counts, one run each
+ */
+inline void register_container_benchmarks(const std::vector<uint64_t>& sizes = {100, 10000, 1000000}) {
+  // the sequence containers hold 404 byte elements, keep their largest size at 100k
+  std::vector<uint64_t> small_sizes;
+  for (uint64_t size : sizes) {
+    small_sizes.push_back(std::min<uint64_t>(size, 100000));
+  }
+  small_sizes.erase(std::unique(small_sizes.begin(), small_sizes.end()), small_sizes.end());
+
+  Benchmarks::add("vector/std::vector", bench_vector<std::vector<BenchData>>, small_sizes);
+  Benchmarks::add("vector/cxstructs::vec<PoolAlloc>", bench_vector<vec<BenchData, PoolAlloc>>, small_sizes);
+  Benchmarks::add("vector/cxstructs::vec<StdAlloc>", bench_vector<vec<BenchData, StdAlloc>>, small_sizes);
+  Benchmarks::add("Stack/std::stack", bench_stack<std::stack<BenchData>>, small_sizes);
+  Benchmarks::add("Stack/cxstructs::Stack<PoolAlloc>", bench_stack<Stack<BenchData, PoolAlloc>>, small_sizes);
+  Benchmarks::add("Stack/cxstructs::Stack<StdAlloc>", bench_stack<Stack<BenchData, StdAlloc>>, small_sizes);
+  Benchmarks::add("LinkedList/std::list", bench_linked_list<std::list<BenchData>>, small_sizes);
+  Benchmarks::add("LinkedList/cxstructs::LinkedList<PoolAlloc>",
+                  bench_linked_list<LinkedList<BenchData, PoolAlloc>>, small_sizes);
+  Benchmarks::add("LinkedList/cxstructs::LinkedList<StdAlloc>",
+                  bench_linked_list<LinkedList<BenchData, StdAlloc>>, small_sizes);
+  Benchmarks::add("Queue/std::queue", bench_queue<std::queue<BenchData>>, small_sizes);
+  Benchmarks::add("Queue/cxstructs::Queue<PoolAlloc>", bench_queue<Queue<BenchData, PoolAlloc>>, small_sizes);
+  Benchmarks::add("Queue/cxstructs::Queue<StdAlloc>", bench_queue<Queue<BenchData, StdAlloc>>, small_sizes);
+  Benchmarks::add("DeQueue/std::deque", bench_dequeue<std::deque<BenchData>>, small_sizes);
+  Benchmarks::add("DeQueue/cxstructs::DeQueue<PoolAlloc>", bench_dequeue<DeQueue<BenchData, PoolAlloc>>,
+                  small_sizes);
+  Benchmarks::add("DeQueue/cxstructs::DeQueue<StdAlloc>", bench_dequeue<DeQueue<BenchData, StdAlloc>>,
+                  small_sizes);
+
+  register_hash_benchmarks<KeyDist::UNIFORM>("uniform", sizes);
+  register_hash_benchmarks<KeyDist::SEQUENTIAL>("sequential", sizes);
+  register_hash_benchmarks<KeyDist::SKEWED>("skewed", sizes);
 }
+}  // namespace cxbench
 #endif  //CXSTRUCTS_SRC_BENCHMARK_H_
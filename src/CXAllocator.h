@@ -22,87 +22,838 @@
 #define CXSTRUCTS_SRC_CXALLOCATOR_H_
 
 /*
-Use the last template option to specify whether to use the allocator or not cxstruct<Type,false>.
+Use the last template option to select the allocator: cxstruct<Type, true/PoolAlloc> (default), cxstruct<Type, false/StdAlloc>
+or cxstruct<Type, ArenaAlloc>.
 Generally use the CXAllocator if you use the cxstruct for longer and as a standalone.
 In turn, generally do not use it if it's a temporary or fixed size structure
+Short-lived structures that die together (e.g. per frame) are best put into a MonotonicArena.
 In case of slower performance just switch to the other.
  */
 
-#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <iostream>
 #include <memory>
-#include <stack>
+#include <mutex>
+#include <new>
 #include <vector>
 #include "cxconfig.h"
 
+// All CXPoolAllocator instances share one set of size class pools, so a node freed by a LinkedList<int64_t>
+// can be reused by a BinaryTree<double> and memory is not stranded in a single container
+// Each thread keeps a small cache per size class and only touches the locked global pool in batches
+
 namespace cxstructs {
-template <uint_32_cx BlockSize, uint_16_cx ReservedBlocks>
-class Pool {
+/**
+ * Memory of a single cxstruct - see memory_stats() of the containers.<p>
+ * Only heap memory is counted, not the container object itself
+ */
+struct MemoryStats {
+  size_t bytes_reserved = 0;  // allocated heap memory - including size class rounding of the pool allocator
+  size_t bytes_used = 0;      // part of it holding live elements
+  size_t elements = 0;
+  size_t blocks = 0;         // separate heap blocks - nodes, buckets, subtrees or arrays
+  float load_factor = 0;     // hash containers: elements per bucket or slot
+  uint_32_cx max_probe = 0;  // hash containers: longest bucket chain or probe sequence (in groups)
+  uint_32_cx depth = 0;      // trees: deepest level, the root is 1
+
+  friend std::ostream& operator<<(std::ostream& out, const MemoryStats& stats) {
+    out << "reserved: " << stats.bytes_reserved << "B used: " << stats.bytes_used
+        << "B elements: " << stats.elements << " blocks: " << stats.blocks;
+    if (stats.load_factor > 0 || stats.max_probe > 0) {
+      out << " load factor: " << stats.load_factor << " max probe: " << stats.max_probe;
+    }
+    if (stats.depth > 0) {
+      out << " depth: " << stats.depth;
+    }
+    return out;
+  }
+};
+
+/**
+ * Memory the allocators request from or give back to the system - see set_allocator_hook()
+ */
+enum class AllocatorEvent : uint8_t {
+  SYSTEM_ALLOCATE,  // a pool or arena chunk, or a request too large for the size classes
+  SYSTEM_FREE
+};
+using AllocatorHook = void (*)(AllocatorEvent event, size_t bytes);
+}  // namespace cxstructs
+
+namespace cxhelper {
+struct SystemCounters {
+  std::atomic<size_t> bytes{0};
+  std::atomic<size_t> peak{0};
+  std::atomic<size_t> allocations{0};
+  std::atomic<cxstructs::AllocatorHook> hook{nullptr};
+};
+inline SystemCounters& system_counters() noexcept {
+  static SystemCounters counters;
+  return counters;
+}
+// only called when memory is exchanged with the system, never for blocks served from a pool
+inline void record_system_allocate(size_t bytes) noexcept {
+  auto& counters = system_counters();
+  const size_t now = counters.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  size_t peak = counters.peak.load(std::memory_order_relaxed);
+  while (now > peak && !counters.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto hook = counters.hook.load(std::memory_order_acquire)) {
+    hook(cxstructs::AllocatorEvent::SYSTEM_ALLOCATE, bytes);
+  }
+}
+inline void record_system_free(size_t bytes) noexcept {
+  auto& counters = system_counters();
+  counters.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+  if (auto hook = counters.hook.load(std::memory_order_acquire)) {
+    hook(cxstructs::AllocatorEvent::SYSTEM_FREE, bytes);
+  }
+}
+
+/**
+ * A freed block stores the link to the next free block inside itself
+ */
+struct FreeBlock {
+  FreeBlock* next_;
+};
+/**
+ * Fixed block size pool that threads its free list through the freed blocks.<p>
+ * Memory of the chunks is only returned to the system when the pool is destroyed. Not thread safe.
+ */
+class FreeListPool {
   uint_32_cx size_;
-  std::deque<void*> addrs_;
-  std::vector<uint8_t*> blocks_;
+  uint_32_cx chunk_size_;
+  uint_32_cx free_ = 0;
+  FreeBlock* head_ = nullptr;
+  std::vector<uint8_t*> chunks_;
 
-  void allocateBlock() {
-    auto* block = new uint8_t[BlockSize];
-    for (uint_32_cx i = 0; i < BlockSize; i += size_) {
-      addrs_.push_back(&block[i]);
+  void allocate_chunk() {
+    auto* chunk = static_cast<uint8_t*>(::operator new(chunk_size_));
+    record_system_allocate(chunk_size_);
+    const uint_32_cx blocks = chunk_size_ / size_;
+    free_ += blocks;
+    // pushed in reverse so the blocks are handed out in address order
+    for (uint_32_cx i = blocks; i-- > 0;) {
+      auto* block = reinterpret_cast<FreeBlock*>(chunk + i * size_);
+      block->next_ = head_;
+      head_ = block;
     }
-    blocks_.push_back(block);
+    chunks_.push_back(chunk);
   }
 
  public:
-  explicit Pool(uint_32_cx size) : size_(size) {
-    blocks_.reserve(ReservedBlocks * 2);
-    for (uint_16_cx i = 0; i < ReservedBlocks; i++) {
-      allocateBlock();
+  /**
+   * @param size size of a single block - at least the size of a pointer
+   * @param chunkSize bytes requested from the system at once - at least one block
+   * @param reservedChunks chunks allocated upfront
+   */
+  FreeListPool(uint_32_cx size, uint_32_cx chunkSize, uint_32_cx reservedChunks)
+      : size_(std::max<uint_32_cx>(size, sizeof(FreeBlock))),
+        chunk_size_(std::max<uint_32_cx>(chunkSize, size_)) {
+    chunks_.reserve(reservedChunks * 2);
+    for (uint_32_cx i = 0; i < reservedChunks; i++) {
+      allocate_chunk();
+    }
+  }
+  FreeListPool(const FreeListPool&) = delete;
+  FreeListPool& operator=(const FreeListPool&) = delete;
+  ~FreeListPool() {
+    for (auto chunk : chunks_) {
+      ::operator delete(chunk);
+      record_system_free(chunk_size_);
+    }
+  }
+  inline void* allocate() {
+    if (!head_) [[unlikely]] {
+      allocate_chunk();
+    }
+    FreeBlock* block = head_;
+    head_ = block->next_;
+    free_--;
+    return block;
+  }
+  inline void deallocate(void* ptr) noexcept {
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next_ = head_;
+    head_ = block;
+    free_++;
+  }
+  /**
+   * Detaches n blocks as a linked chain
+   * @param out set to the first block of the chain
+   * @param n number of blocks
+   */
+  inline void pop_batch(FreeBlock*& out, uint_32_cx n) {
+    FreeBlock* chain = nullptr;
+    for (uint_32_cx i = 0; i < n; i++) {
+      auto* block = static_cast<FreeBlock*>(allocate());
+      block->next_ = chain;
+      chain = block;
+    }
+    out = chain;
+  }
+  /**
+   * Gives back a chain of n blocks from first to last
+   */
+  inline void push_batch(FreeBlock* first, FreeBlock* last, uint_32_cx n) noexcept {
+    last->next_ = head_;
+    head_ = first;
+    free_ += n;
+  }
+  [[nodiscard]] inline uint_32_cx block_size() const noexcept { return size_; }
+  [[nodiscard]] inline uint_32_cx chunk_count() const noexcept { return chunks_.size(); }
+  [[nodiscard]] inline size_t chunk_bytes() const noexcept { return chunks_.size() * size_t(chunk_size_); }
+  /**
+   * @return blocks of all chunks
+   */
+  [[nodiscard]] inline size_t block_count() const noexcept {
+    return chunks_.size() * size_t(chunk_size_ / size_);
+  }
+  /**
+   * @return blocks currently in the free list
+   */
+  [[nodiscard]] inline uint_32_cx free_count() const noexcept { return free_; }
+};
+
+// size classes: multiples of 16 up to 128, then two classes per power of two (3/4 and 1) up to 32KB
+constexpr uint_32_cx kSizeClassCount = 24;
+constexpr uint_32_cx kMaxSizeClass = 32768;
+constexpr uint_32_cx kSizeClassAlign = 16;
+
+inline uint_32_cx size_class_index(uint_32_cx bytes) noexcept {
+  if (bytes <= 128) {
+    return bytes == 0 ? 0 : (bytes - 1) >> 4;
+  }
+  uint_32_cx p = 0;
+  while ((static_cast<uint_32_cx>(1) << p) < bytes) {
+    p++;
+  }
+  return 8 + (p - 8) * 2 + (bytes > (static_cast<uint_32_cx>(3) << (p - 2)));
+}
+inline uint_32_cx size_class_bytes(uint_32_cx index) noexcept {
+  if (index < 8) {
+    return (index + 1) << 4;
+  }
+  const uint_32_cx p = 8 + (index - 8) / 2;
+  return (index & 1) ? static_cast<uint_32_cx>(1) << p : static_cast<uint_32_cx>(3) << (p - 2);
+}
+// blocks moved between a thread cache and the global pool at once
+inline uint_32_cx size_class_batch(uint_32_cx index) noexcept {
+  return std::clamp<uint_32_cx>(16384 / size_class_bytes(index), 4, 64);
+}
+
+struct SizeClass {
+  std::mutex mutex_;
+  FreeListPool pool_;
+  explicit SizeClass(uint_32_cx bytes)
+      : pool_(bytes, std::max<uint_32_cx>(1 << 16, bytes * 4), 0) {}
+};
+/**
+ * The global pools are never destroyed - containers destroyed during static destruction
+ * still have somewhere to put their memory
+ */
+inline SizeClass& global_size_class(uint_32_cx index) {
+  static SizeClass* const classes = [] {
+    auto* arr = static_cast<SizeClass*>(::operator new(sizeof(SizeClass) * kSizeClassCount));
+    for (uint_32_cx i = 0; i < kSizeClassCount; i++) {
+      new (&arr[i]) SizeClass(size_class_bytes(i));
     }
+    return arr;
+  }();
+  return classes[index];
+}
+
+inline bool& thread_cache_destroyed() noexcept {
+  thread_local bool destroyed = false;
+  return destroyed;
+}
+/**
+ * Per thread free lists in front of the global size classes.<p>
+ * Refills and drains in batches so the global lock is taken once per batch, not per block.
+ * Everything still cached is given back when the thread exits.
+ */
+class ThreadCache {
+  struct List {
+    FreeBlock* head_ = nullptr;
+    uint_32_cx count_ = 0;
+  };
+  List lists_[kSizeClassCount];
+
+  void refill(uint_32_cx index) {
+    List& list = lists_[index];
+    const uint_32_cx batch = size_class_batch(index);
+    SizeClass& global = global_size_class(index);
+    std::lock_guard<std::mutex> lock(global.mutex_);
+    global.pool_.pop_batch(list.head_, batch);
+    list.count_ = batch;
   }
-  ~Pool() {
-    for (auto block : blocks_) {
-      delete[] block;
+  void drain(uint_32_cx index, uint_32_cx n) {
+    List& list = lists_[index];
+    FreeBlock* first = list.head_;
+    FreeBlock* last = first;
+    for (uint_32_cx i = 1; i < n; i++) {
+      last = last->next_;
     }
+    list.head_ = last->next_;
+    list.count_ -= n;
+    SizeClass& global = global_size_class(index);
+    std::lock_guard<std::mutex> lock(global.mutex_);
+    global.pool_.push_batch(first, last, n);
   }
 
-  void* allocate() {
-    if (addrs_.empty()) {
-      allocateBlock();
+ public:
+  ThreadCache() = default;
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+  ~ThreadCache() {
+    for (uint_32_cx i = 0; i < kSizeClassCount; i++) {
+      if (lists_[i].count_ > 0) {
+        drain(i, lists_[i].count_);
+      }
+    }
+    thread_cache_destroyed() = true;
+  }
+  inline void* allocate(uint_32_cx index) {
+    List& list = lists_[index];
+    if (!list.head_) [[unlikely]] {
+      refill(index);
+    }
+    FreeBlock* block = list.head_;
+    list.head_ = block->next_;
+    list.count_--;
+    return block;
+  }
+  inline void deallocate(uint_32_cx index, void* ptr) {
+    List& list = lists_[index];
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next_ = list.head_;
+    list.head_ = block;
+    if (++list.count_ >= 2 * size_class_batch(index)) [[unlikely]] {
+      drain(index, size_class_batch(index));
     }
-    auto ptr = addrs_.back();
-    addrs_.pop_back();
+  }
+};
+inline ThreadCache& thread_cache() {
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+/**
+ * Allocates from the shared size class pools, larger requests go to operator new
+ * @param bytes the number of bytes - has to be passed again when deallocating
+ */
+inline void* size_class_allocate(uint_32_cx bytes) {
+  if (bytes > kMaxSizeClass) {
+    void* ptr = ::operator new(bytes);
+    record_system_allocate(bytes);
     return ptr;
   }
-  void deallocate(void* ptr) { addrs_.push_back(ptr); }
+  const uint_32_cx index = size_class_index(bytes);
+  if (thread_cache_destroyed()) [[unlikely]] {
+    SizeClass& global = global_size_class(index);
+    std::lock_guard<std::mutex> lock(global.mutex_);
+    return global.pool_.allocate();
+  }
+  return thread_cache().allocate(index);
+}
+inline void size_class_deallocate(void* ptr, uint_32_cx bytes) {
+  if (bytes > kMaxSizeClass) {
+    ::operator delete(ptr);
+    record_system_free(bytes);
+    return;
+  }
+  const uint_32_cx index = size_class_index(bytes);
+  if (thread_cache_destroyed()) [[unlikely]] {
+    SizeClass& global = global_size_class(index);
+    std::lock_guard<std::mutex> lock(global.mutex_);
+    global.pool_.deallocate(ptr);
+    return;
+  }
+  thread_cache().deallocate(index, ptr);
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * Single threaded pool of fixed size blocks
+ * @tparam BlockSize bytes allocated from the system at once
+ * @tparam ReservedBlocks number of chunks allocated upfront
+ */
+template <uint_32_cx BlockSize, uint_16_cx ReservedBlocks>
+class Pool : public cxhelper::FreeListPool {
+ public:
+  explicit Pool(uint_32_cx size) : FreeListPool(size, BlockSize, ReservedBlocks) {}
 };
 
+/**
+ * <h2>CXPoolAllocator</h2>
+ * Stateless allocator on top of process wide size class pools.<p>
+ * Requests up to 32KB are rounded up to one of 24 size classes and served from a thread local cache,
+ * which exchanges blocks with the global pool of that size class in batches.
+ * All containers with the same element size therefore share their freed memory, across threads as well.
+ * Larger requests and over-aligned types go directly to operator new.
+ * <br><br>
+ * deallocate() has to be called with the same n as the matching allocate().
+ * @tparam T value type
+ * @tparam BlockSize kept for compatibility - chunk sizes are chosen per size class
+ * @tparam ReservedBlocks kept for compatibility
+ */
 template <typename T, size_t BlockSize, uint_16_cx ReservedBlocks>
 class CXPoolAllocator {
-  using PoolType = Pool<BlockSize, ReservedBlocks>;
-  PoolType pool_;
+  static constexpr bool kOverAligned = alignof(T) > cxhelper::kSizeClassAlign;
 
  public:
   using value_type = T;
-  using is_always_equal = std::false_type;
-  CXPoolAllocator() : pool_(PoolType(sizeof(T))) {}
-  CXPoolAllocator(const CXPoolAllocator& other) = default;
-  CXPoolAllocator(CXPoolAllocator&& other) noexcept = default;
-  CXPoolAllocator& operator=(const CXPoolAllocator& other) = default;
-  CXPoolAllocator& operator=(CXPoolAllocator&& other) noexcept = default;
-  ~CXPoolAllocator() = default;
+  using is_always_equal = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  template <typename U>
+  struct rebind {
+    using other = CXPoolAllocator<U, BlockSize, ReservedBlocks>;
+  };
+  CXPoolAllocator() noexcept = default;
+  template <typename U>
+  explicit CXPoolAllocator(const CXPoolAllocator<U, BlockSize, ReservedBlocks>&) noexcept {}
   T* allocate(size_t n) {
-    if (n > 1) {
-      return static_cast<T*>(malloc(sizeof(T) * n));
+    if constexpr (kOverAligned) {
+      return static_cast<T*>(::operator new(sizeof(T) * n, std::align_val_t(alignof(T))));
     } else {
-      return (T*)pool_.allocate();
+      return static_cast<T*>(cxhelper::size_class_allocate(sizeof(T) * n));
     }
   }
   void deallocate(T* ptr, size_t n) {
-    if (n > 1) {
-      free(ptr);
+    if (!ptr) {
       return;
+    }
+    if constexpr (kOverAligned) {
+      ::operator delete(ptr, std::align_val_t(alignof(T)));
     } else {
-      pool_.deallocate(ptr);
+      cxhelper::size_class_deallocate(ptr, sizeof(T) * n);
     }
   }
+  template <typename U>
+  bool operator==(const CXPoolAllocator<U, BlockSize, ReservedBlocks>&) const noexcept {
+    return true;
+  }
 };
+/**
+ * <h2>MonotonicArena</h2>
+ * Pointer bump allocator for memory that dies all at once.<p>
+ * Allocating only advances a cursor, deallocating does nothing. reset() rewinds the arena so the whole
+ * memory can be reused. If a cycle needed more than one chunk, reset() merges them into a single chunk of the
+ * combined size, so after the first cycle no more system allocations happen.
+ * <br><br>
+ * Containers with the ArenaAlloc policy allocate from the arena that is current on their thread when they are constructed:
+ * <pre>
+ * MonotonicArena frame;
+ * while (running) {
+ *   MonotonicArena::Scope scope(frame);
+ *   vec<int, ArenaAlloc> temp;
+ *   ...
+ *   frame.reset(); // all containers of this frame have to be destroyed before
+ * }
+ * </pre>
+ */
+class MonotonicArena {
+  struct Chunk {
+    uint8_t* data_;
+    size_t size_;
+  };
+  std::vector<Chunk> chunks_;
+  size_t current_ = 0;
+  uint8_t* cursor_ = nullptr;
+  uint8_t* end_ = nullptr;
+  size_t chunk_size_;
+
+  static inline MonotonicArena*& active() noexcept {
+    thread_local MonotonicArena* arena = nullptr;
+    return arena;
+  }
+  void add_chunk(size_t min_bytes) {
+    size_t size = std::max(chunk_size_, min_bytes);
+    chunk_size_ = size * 2;
+    chunks_.push_back({static_cast<uint8_t*>(::operator new(size)), size});
+    cxhelper::record_system_allocate(size);
+  }
+  void next_chunk(size_t bytes, size_t align) {
+    // skip kept chunks that are too small for this request
+    while (++current_ < chunks_.size() && chunks_[current_].size_ < bytes + align) {}
+    if (current_ == chunks_.size()) {
+      add_chunk(bytes + align);
+    }
+    cursor_ = chunks_[current_].data_;
+    end_ = cursor_ + chunks_[current_].size_;
+  }
+
+ public:
+  /**
+   * @param initialSize size of the first chunk - following chunks double in size
+   */
+  explicit MonotonicArena(size_t initialSize = 64 * 1024) : chunk_size_(std::max<size_t>(initialSize, 64)) {
+    add_chunk(0);
+    cursor_ = chunks_[0].data_;
+    end_ = cursor_ + chunks_[0].size_;
+  }
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+  ~MonotonicArena() {
+    CX_ASSERT(active() != this, "destroying the active arena");
+    for (auto& chunk : chunks_) {
+      ::operator delete(chunk.data_);
+      cxhelper::record_system_free(chunk.size_);
+    }
+  }
+  /**
+   * @param bytes number of bytes
+   * @param align power of two alignment
+   * @return pointer to uninitialized memory valid until the next reset()
+   */
+  [[nodiscard]] inline void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+    auto addr = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) & ~(uintptr_t)(align - 1);
+    if (addr + bytes > reinterpret_cast<uintptr_t>(end_)) [[unlikely]] {
+      next_chunk(bytes, align);
+      addr = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    cursor_ = reinterpret_cast<uint8_t*>(addr + bytes);
+    return reinterpret_cast<void*>(addr);
+  }
+  inline void deallocate(void*, size_t) noexcept {}
+  /**
+   * Makes all memory available again. Everything allocated before is invalid afterwards
+   */
+  inline void reset() {
+    if (current_ > 0) {
+      size_t total = 0;
+      for (auto& chunk : chunks_) {
+        total += chunk.size_;
+        ::operator delete(chunk.data_);
+        cxhelper::record_system_free(chunk.size_);
+      }
+      chunks_.clear();
+      chunk_size_ = total;
+      add_chunk(0);
+    }
+    current_ = 0;
+    cursor_ = chunks_[0].data_;
+    end_ = cursor_ + chunks_[0].size_;
+  }
+  /**
+   * @return bytes handed out since the last reset() - including alignment padding and skipped chunk tails
+   */
+  [[nodiscard]] inline size_t used() const noexcept {
+    size_t used = 0;
+    for (size_t i = 0; i < current_; i++) {
+      used += chunks_[i].size_;
+    }
+    return used + (cursor_ - chunks_[current_].data_);
+  }
+  [[nodiscard]] inline size_t capacity() const noexcept {
+    size_t capacity = 0;
+    for (auto& chunk : chunks_) {
+      capacity += chunk.size_;
+    }
+    return capacity;
+  }
+  [[nodiscard]] inline size_t chunk_count() const noexcept { return chunks_.size(); }
+  /**
+   * @return the arena of the innermost Scope on this thread, or a per thread default arena
+   */
+  static MonotonicArena& current() {
+    if (active()) {
+      return *active();
+    }
+    thread_local MonotonicArena fallback;
+    return fallback;
+  }
+  /**
+   * Makes the given arena the current one of this thread for the lifetime of the scope
+   */
+  class Scope {
+    MonotonicArena* previous_;
+
+   public:
+    explicit Scope(MonotonicArena& arena) noexcept : previous_(active()) { active() = &arena; }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope() { active() = previous_; }
+  };
+};
+
+/**
+ * Allocator handing out memory of a MonotonicArena - defaults to MonotonicArena::current()
+ * @tparam T value type
+ */
+template <typename T>
+class ArenaAllocator {
+  template <typename U>
+  friend class ArenaAllocator;
+  MonotonicArena* arena_;
+
+ public:
+  using value_type = T;
+  using is_always_equal = std::false_type;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  ArenaAllocator() : arena_(&MonotonicArena::current()) {}
+  explicit ArenaAllocator(MonotonicArena& arena) noexcept : arena_(&arena) {}
+  template <typename U>
+  explicit ArenaAllocator(const ArenaAllocator<U>& o) noexcept : arena_(o.arena_) {}
+  inline T* allocate(size_t n) {
+    return static_cast<T*>(arena_->allocate(sizeof(T) * n, alignof(T)));
+  }
+  inline void deallocate(T*, size_t) noexcept {}
+  [[nodiscard]] inline MonotonicArena& arena() const noexcept { return *arena_; }
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& o) const noexcept {
+    return arena_ == o.arena_;
+  }
+};
+
+/**
+ * Selects the allocator of a cxstruct through its last template argument.<p>
+ * Implicitly constructible from bool so <code>cxstruct<Type, false></code> keeps working.
+ */
+struct AllocPolicy {
+  enum Kind : uint8_t { Std, Pool, Arena };
+  Kind kind_;
+  constexpr AllocPolicy(bool usePool) noexcept : kind_(usePool ? Pool : Std) {}  // NOLINT
+  constexpr explicit AllocPolicy(Kind kind) noexcept : kind_(kind) {}
+  constexpr bool operator==(const AllocPolicy&) const noexcept = default;
+};
+inline constexpr AllocPolicy StdAlloc{AllocPolicy::Std};
+inline constexpr AllocPolicy PoolAlloc{AllocPolicy::Pool};
+inline constexpr AllocPolicy ArenaAlloc{AllocPolicy::Arena};
 }  // namespace cxstructs
+
+namespace cxhelper {
+template <typename T, cxstructs::AllocPolicy Policy>
+struct policy_allocator {
+  using type = std::allocator<T>;
+};
+template <typename T>
+struct policy_allocator<T, cxstructs::PoolAlloc> {
+  using type = cxstructs::CXPoolAllocator<T, sizeof(T) * 33, 1>;
+};
+template <typename T>
+struct policy_allocator<T, cxstructs::ArenaAlloc> {
+  using type = cxstructs::ArenaAllocator<T>;
+};
+/**
+ * The allocator type used by a cxstruct for the given policy
+ */
+template <typename T, cxstructs::AllocPolicy Policy>
+using policy_allocator_t = typename policy_allocator<T, Policy>::type;
+
+template <typename Allocator>
+struct is_pool_allocator : std::false_type {};
+template <typename T, size_t BlockSize, uint_16_cx ReservedBlocks>
+struct is_pool_allocator<cxstructs::CXPoolAllocator<T, BlockSize, ReservedBlocks>> : std::true_type {};
+/**
+ * @return the bytes an allocate(n) of the given allocator actually takes - the pool rounds up to its size class
+ */
+template <typename Allocator>
+constexpr size_t allocation_size(size_t n) noexcept {
+  using T = typename Allocator::value_type;
+  const size_t bytes = sizeof(T) * n;
+  if constexpr (is_pool_allocator<Allocator>::value && alignof(T) <= kSizeClassAlign) {
+    if (n > 0 && bytes <= kMaxSizeClass) {
+      return size_class_bytes(size_class_index(static_cast<uint_32_cx>(bytes)));
+    }
+  }
+  return bytes;
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * One size class of the shared pools behind CXPoolAllocator
+ */
+struct SizeClassStats {
+  uint_32_cx block_size = 0;
+  size_t chunks = 0;
+  size_t blocks = 0;       // blocks of all chunks
+  size_t free_blocks = 0;  // blocks in the global free list - not counting the ones cached by threads
+};
+/**
+ * Process wide allocator memory
+ */
+struct AllocatorStats {
+  size_t system_bytes = 0;        // currently held from operator new by pools, arenas and large requests
+  size_t peak_system_bytes = 0;   // maximum of system_bytes so far
+  size_t system_allocations = 0;  // calls to operator new so far
+  SizeClassStats size_classes[cxhelper::kSizeClassCount];
+
+  friend std::ostream& operator<<(std::ostream& out, const AllocatorStats& stats) {
+    out << "system: " << stats.system_bytes << "B peak: " << stats.peak_system_bytes
+        << "B allocations: " << stats.system_allocations << "\n";
+    for (const auto& sc : stats.size_classes) {
+      if (sc.chunks > 0) {
+        out << "  " << sc.block_size << "B: " << sc.chunks << " chunks " << sc.blocks - sc.free_blocks << "/"
+            << sc.blocks << " blocks out\n";
+      }
+    }
+    return out;
+  }
+};
+/**
+ * Takes a snapshot of the allocator memory. Locks each size class shortly
+ */
+inline AllocatorStats allocator_stats() {
+  AllocatorStats stats;
+  auto& counters = cxhelper::system_counters();
+  stats.system_bytes = counters.bytes.load(std::memory_order_relaxed);
+  stats.peak_system_bytes = counters.peak.load(std::memory_order_relaxed);
+  stats.system_allocations = counters.allocations.load(std::memory_order_relaxed);
+  for (uint_32_cx i = 0; i < cxhelper::kSizeClassCount; i++) {
+    auto& global = cxhelper::global_size_class(i);
+    std::lock_guard<std::mutex> lock(global.mutex_);
+    stats.size_classes[i] = {global.pool_.block_size(), global.pool_.chunk_count(), global.pool_.block_count(),
+                             global.pool_.free_count()};
+  }
+  return stats;
+}
+/**
+ * Installs a function called whenever an allocator takes memory from or gives it back to the system.<p>
+ * Blocks served from the pools never reach the hook, so it stays off the hot path.
+ * The hook can be called from any thread and must not allocate through a CXPoolAllocator.
+ * @param hook the new hook or nullptr to remove it
+ * @return the previous hook
+ */
+inline AllocatorHook set_allocator_hook(AllocatorHook hook) noexcept {
+  return cxhelper::system_counters().hook.exchange(hook, std::memory_order_acq_rel);
+}
+}  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+#include <thread>
+namespace cxtests {
+using namespace cxstructs;
+using namespace cxhelper;
+static void TEST_ALLOCATOR() {
+  std::cout << "TESTING ALLOCATOR" << std::endl;
+
+  std::cout << "  Testing size classes..." << std::endl;
+  for (uint_32_cx bytes = 1; bytes <= kMaxSizeClass; bytes++) {
+    const auto index = size_class_index(bytes);
+    CX_ASSERT(index < kSizeClassCount, "");
+    CX_ASSERT(size_class_bytes(index) >= bytes, "");
+    CX_ASSERT(index == 0 || size_class_bytes(index - 1) < bytes, "");
+    CX_ASSERT(size_class_bytes(index) % kSizeClassAlign == 0, "");
+  }
+
+  std::cout << "  Testing reuse across element types..." << std::endl;
+  CXPoolAllocator<int64_t, 1, 1> alloc1;
+  CXPoolAllocator<double, 1, 1> alloc2;
+  int64_t* ptr1 = alloc1.allocate(1);
+  *ptr1 = 5;
+  alloc1.deallocate(ptr1, 1);
+  double* ptr2 = alloc2.allocate(1);
+  CX_ASSERT(static_cast<void*>(ptr1) == static_cast<void*>(ptr2), "");
+  alloc2.deallocate(ptr2, 1);
+  alloc2.deallocate(nullptr, 1);
+
+  std::cout << "  Testing array and large allocations..." << std::endl;
+  for (size_t n : {3, 100, 1000, 5000, 20000}) {
+    int64_t* arr = alloc1.allocate(n);
+    std::fill(arr, arr + n, 7);
+    CX_ASSERT(arr[n - 1] == 7, "");
+    alloc1.deallocate(arr, n);
+  }
+
+  std::cout << "  Testing Pool..." << std::endl;
+  Pool<64, 1> pool(16);
+  void* block1 = pool.allocate();
+  void* block2 = pool.allocate();
+  CX_ASSERT(static_cast<uint8_t*>(block2) - static_cast<uint8_t*>(block1) == 16, "");
+  for (int i = 0; i < 10; i++) {
+    pool.allocate();
+  }
+  CX_ASSERT(pool.chunk_count() == 3, "");
+  pool.deallocate(block1);
+  CX_ASSERT(pool.allocate() == block1, "");
+
+  std::cout << "  Testing MonotonicArena..." << std::endl;
+  MonotonicArena arena(256);
+  auto* first = static_cast<uint8_t*>(arena.allocate(10, 1));
+  auto* aligned = static_cast<uint8_t*>(arena.allocate(8, 64));
+  CX_ASSERT(reinterpret_cast<uintptr_t>(aligned) % 64 == 0 && aligned > first, "");
+  for (int i = 0; i < 100; i++) {
+    std::fill_n(static_cast<uint8_t*>(arena.allocate(100)), 100, 1);
+  }
+  CX_ASSERT(arena.chunk_count() > 1, "");
+  const auto capacity = arena.capacity();
+  arena.reset();
+  CX_ASSERT(arena.used() == 0 && arena.chunk_count() == 1, "");
+  CX_ASSERT(arena.capacity() == capacity, "");
+  for (int i = 0; i < 100; i++) {
+    CX_ASSERT(arena.allocate(100) != nullptr, "");
+  }
+  CX_ASSERT(arena.chunk_count() == 1, "");
+  {
+    MonotonicArena::Scope scope(arena);
+    CX_ASSERT(&MonotonicArena::current() == &arena, "");
+    ArenaAllocator<int> arena_alloc;
+    CX_ASSERT(&arena_alloc.arena() == &arena, "");
+  }
+  CX_ASSERT(&MonotonicArena::current() != &arena, "");
+
+  std::cout << "  Testing allocator stats and hook..." << std::endl;
+  static std::atomic<size_t> hooked{0};
+  const auto previous = set_allocator_hook([](AllocatorEvent event, size_t bytes) {
+    if (event == AllocatorEvent::SYSTEM_ALLOCATE) {
+      hooked += bytes;
+    }
+  });
+  const AllocatorStats before = allocator_stats();
+  int64_t* large = alloc1.allocate(10000);
+  CX_ASSERT(hooked == 80000, "");
+  CX_ASSERT(allocator_stats().system_bytes == before.system_bytes + 80000, "");
+  alloc1.deallocate(large, 10000);
+  CX_ASSERT(allocator_stats().system_bytes == before.system_bytes, "");
+  CX_ASSERT(allocator_stats().peak_system_bytes >= before.system_bytes + 80000, "");
+  set_allocator_hook(previous);
+  const auto& sc = before.size_classes[size_class_index(sizeof(int64_t))];
+  CX_ASSERT(sc.block_size == 16 && sc.chunks > 0 && sc.free_blocks <= sc.blocks, "");
+  CX_ASSERT((allocation_size<CXPoolAllocator<int64_t, 1, 1>>(3) == 32), "");
+  CX_ASSERT(allocation_size<std::allocator<int64_t>>(3) == 24, "");
+
+  std::cout << "  Testing multithreaded allocate and free..." << std::endl;
+  using Block = std::pair<int*, size_t>;
+  std::vector<Block> live[4];
+  auto work = [&live](int t, bool handoff) {
+    CXPoolAllocator<int, 1, 1> alloc;
+    if (handoff) {  // free what another thread allocated
+      for (auto [ptr, n] : live[(t + 1) % 4]) {
+        CX_ASSERT(ptr[n - 1] == (t + 1) % 4, "");
+        alloc.deallocate(ptr, n);
+      }
+      return;
+    }
+    for (int i = 0; i < 20000; i++) {
+      const size_t n = 1 + i % 40;
+      int* ptr = alloc.allocate(n);
+      std::fill(ptr, ptr + n, t);
+      live[t].emplace_back(ptr, n);
+      if (i % 3 == 0) {
+        auto [old, old_n] = live[t][live[t].size() / 2];
+        CX_ASSERT(old[0] == t && old[old_n - 1] == t, "");
+        live[t][live[t].size() / 2] = live[t].back();
+        live[t].pop_back();
+        alloc.deallocate(old, old_n);
+      }
+    }
+  };
+  for (bool handoff : {false, true}) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back(work, t, handoff);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+}
+}  // namespace cxtests
+#endif
 #endif  //CXSTRUCTS_SRC_CXALLOCATOR_H_
@@ -18,6 +18,10 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+// standard containers first, like BenchMark.h - cxtime.h has a using namespace std inside cxstructs,
+// so member names like list or deque would otherwise parse as the std templates
+#include <deque>
+#include <list>
 #include "CXStructs.h"
 #include "cxml/word2vec.h"
 
@@ -26,33 +30,84 @@ namespace cxtests {
 
 using namespace cxstructs;
 static void test_cxstructs() {
+  TEST_CPU_DISPATCH();
+  TEST_BITSET();
+  TEST_PACKED_VEC();
+  TEST_ALLOCATOR();
   GEOMETRY_TEST();
+  WorkStealingDeque<int>::TEST();
+  ThreadPool::TEST();
   mat::TEST();
+  TEST_ACTIVATIONS();
+  TEST_DISTANCE();
+  qmat<int8_t>::TEST();
+  fixed_mat<4, 4>::TEST();
   LinkedList<int>::TEST();
   Queue<int>::TEST();
+  SlidingWindow<double>::TEST();
   Stack<int>::TEST();
   vec<int>::TEST();
+  small_vec<int>::TEST();
+  soa_vec<float>::TEST();
   Trie::TEST();
+  RadixTrie::TEST();
   DoubleLinkedList<int>::TEST();
+  UnrolledList<int>::TEST();
+  TEST_INTRUSIVE_LIST();
   DeQueue<int>::TEST();
+  TEST_HASH();
+  TEST_IO();
+  TEST_SNAPSHOT();
+  TEST_RECLAIM();
+  TEST_BENCH();
+  TEST_PROFILER();
+  TEST_HISTOGRAM();
+  TEST_GRAPHICS();
   HashMap<int, int>::TEST();
+  FlatHashMap<int, int>::TEST();
+  StaticHashMap<int, int>::TEST();
+  ConcurrentHashMap<int, int>::TEST();
+  LRUCache<int, int>::TEST();
+  ConcurrentLRUCache<int, int>::TEST();
+  ConcurrentPriorityQueue<int>::TEST();
+  SPSCQueue<int>::TEST();
+  MPMCQueue<int>::TEST();
   HashSet<int>::TEST();
+  BloomFilter<>::TEST();
   BinaryTree<int>::TEST();
+  BTreeMap<int, int>::TEST();
   QuadTree<Point>::TEST();
+  FlatQuadTree<Point>::TEST();
+  AABBTree<>::TEST();
+  HashGrid<>::TEST();
+  kTree::TEST();
+  CSRGraph<float>::TEST();
+  Grid2D<int>::TEST();
+  Grid2D<int, GridLayout::TILED>::TEST();
   PriorityQueue<int>::TEST();
+  IndexedPriorityQueue<int>::TEST();
+  TopK<uint32_t>::TEST();
 }
 
 static void test_cxalgos() {
   TEST_SORTING();
+  TEST_PARALLEL();
+  TEST_EXTERNAL_SORT();
   TEST_DFS();
+  TEST_GRAPH_SEARCH();
   TEST_SEARCH();
+  TEST_STATISTIC();
+  TEST_PATTERN_MATCHING();
   TEST_MATH();
   TEST_PATH_FINDING();
 }
 
 static void test_cxml() {
   FNN::TEST();
+  TEST_STATIC_FNN();
   kNN_2D<DataPoint_<float>>::TEST();
+  kNN_XD<DataPointXD_<float>>::TEST();
+  IVFIndex::TEST();
   Word2Vec::TEST();
 }
 
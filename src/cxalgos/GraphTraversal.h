@@ -21,55 +21,400 @@
 #ifndef CXSTRUCTS_DFS_H
 #define CXSTRUCTS_DFS_H
 
-#include <iostream>
-#include <unordered_map>
-#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include "../cxconfig.h"
-#include "../cxstructs/HashSet.h"
-#include "../cxstructs/Pair.h"
-#include "../cxstructs/vec.h"
+#include "../cxstructs/CSRGraph.h"
+#include "../cxstructs/PriorityQueue.h"
+#include "../cxstructs/bitset.h"
+#include "../cxutil/cxthreadpool.h"
 
 namespace cxstructs {
 
 /**
  * Treats the vector as an adjacency matrix
- * @return - the number of reachable nodes from the given start node
+ * @return - the number of reachable nodes from the given start node, including itself
  */
 template <typename T>
-int depth_first_search(std::vector<std::vector<T>>& mat, int nodeIndex,
-                       std::vector<bool> vis = {}) {
-  int count = 1;
-  if (mat.empty() || nodeIndex >= mat.size())
+int depth_first_search(const std::vector<std::vector<T>>& mat, int nodeIndex) {
+  if (nodeIndex < 0 || nodeIndex >= static_cast<int>(mat.size())) {
     return 0;
-  if (vis.empty()) {
+  }
+  bitset vis(mat.size());
+  std::vector<int> stack{nodeIndex};
+  vis.set(nodeIndex);
+  int count = 0;
+  while (!stack.empty()) {
+    const int node = stack.back();
+    stack.pop_back();
     count++;
-    vis = std::vector(mat.size(), false);
+    for (int i = 0; i < static_cast<int>(mat[node].size()); ++i) {
+      if (mat[node][i] == 1 && vis.test_and_set(i)) {
+        stack.push_back(i);
+      }
+    }
   }
+  return count;
+}
 
-  for (int i = 0; i < mat[nodeIndex].size(); ++i) {
-    if (mat[nodeIndex][i] == 1 && !vis[i]) {
-      vis[i] = true;
-      count += depth_first_search(mat, nodeIndex, vis);
+/**
+ * Iterative depth first search - an explicit stack of (vertex, next edge) replaces the recursion,
+ * so deep graphs cant overflow the call stack. Visited vertices are tracked in a bitset.
+ * @param graph the graph
+ * @param source start vertex
+ * @param visit called with every reached vertex in preorder
+ * @return the number of reached vertices, including source
+ */
+template <typename W, typename Visit>
+uint32_t depth_first_search(const CSRGraph<W>& graph, uint32_t source, Visit visit) {
+  using EdgeIndex = typename CSRGraph<W>::EdgeIndex;
+  if (source >= graph.vertices()) {
+    return 0;
+  }
+  bitset visited(graph.vertices());
+  std::vector<std::pair<uint32_t, EdgeIndex>> stack;
+  visited.set(source);
+  visit(source);
+  stack.emplace_back(source, graph.edge_begin(source));
+  uint32_t count = 1;
+  while (!stack.empty()) {
+    auto& [v, e] = stack.back();
+    if (e == graph.edge_end(v)) {
+      stack.pop_back();
+      continue;
+    }
+    const uint32_t u = graph.target(e++);
+    if (visited.test_and_set(u)) {
+      visit(u);
+      count++;
+      stack.emplace_back(u, graph.edge_begin(u));
     }
   }
   return count;
 }
-template <typename State, typename Action>
-vec<vec<std::pair<Action, State>>> shortest_path_search(
-    State start, std::unordered_map<State, Action> (*successors)(State), bool (*is_goal)(State)) {
-  if (is_goal(start)) {
-    return {{Action(), start}};
-  }
-  auto explored = HashSet<Action, State>();
-  auto frontier = vec<std::pair<Action, State>>();
-  while (!frontier.empty()) {
-    auto path = frontier.pop_front();
-    auto s = path.at[-1].second;
+/**
+ * @return the number of vertices reachable from source, including itself
+ */
+template <typename W>
+uint32_t depth_first_search(const CSRGraph<W>& graph, uint32_t source) {
+  return depth_first_search(graph, source, [](uint32_t) {});
+}
+
+/**
+ * Breadth first search over a flat queue with a bitset for the visited vertices
+ * @param graph the graph
+ * @param source start vertex
+ * @param depth resized to the vertex count, the number of edges from source or CSRGraph::kNone if unreached
+ * @return the number of reached vertices, including source
+ */
+template <typename W>
+uint32_t breadth_first_search(const CSRGraph<W>& graph, uint32_t source, std::vector<uint32_t>& depth) {
+  const uint32_t n = graph.vertices();
+  depth.assign(n, CSRGraph<W>::kNone);
+  if (source >= n) {
+    return 0;
+  }
+  bitset visited(n);
+  std::vector<uint32_t> queue;
+  queue.reserve(n);
+  queue.push_back(source);
+  visited.set(source);
+  depth[source] = 0;
+  for (std::size_t head = 0; head < queue.size(); head++) {
+    const uint32_t v = queue[head];
+    for (const uint32_t u : graph.neighbours(v)) {
+      if (visited.test_and_set(u)) {
+        depth[u] = depth[v] + 1;
+        queue.push_back(u);
+      }
+    }
+  }
+  return static_cast<uint32_t>(queue.size());
+}
+
+/**
+ * Direction optimizing parallel breadth first search (Beamer et al.) on the ThreadPool.
+ * <br><br>
+ * Small frontiers are expanded top-down: the threads split the frontier, claim unvisited neighbours with an
+ * atomic bit and append them to the next frontier in per chunk batches.<br>
+ * Once the frontier has more out-edges than the unvisited part of the graph (1/14th of it), a level is cheaper
+ * bottom-up: every unvisited vertex scans its in-edges and stops at the first parent in the frontier. It
+ * switches back once the frontier shrinks below 1/24th of the vertices.
+ * <br><br>
+ * Gives the same depths as breadth_first_search()
+ * @param graph the graph
+ * @param reverse the transpose of graph, used by the bottom-up steps
+ * @param source start vertex
+ * @param depth resized to the vertex count, the number of edges from source or CSRGraph::kNone if unreached
+ * @param pool the pool to run on
+ * @return the number of reached vertices, including source
+ */
+template <typename W>
+uint32_t parallel_breadth_first_search(const CSRGraph<W>& graph, const CSRGraph<W>& reverse, uint32_t source,
+                                       std::vector<uint32_t>& depth, ThreadPool& pool = ThreadPool::global()) {
+  using EdgeIndex = typename CSRGraph<W>::EdgeIndex;
+  constexpr EdgeIndex kAlpha = 14;
+  constexpr uint32_t kBeta = 24;
+  const uint32_t n = graph.vertices();
+  depth.assign(n, CSRGraph<W>::kNone);
+  if (source >= n) {
+    return 0;
+  }
+  CX_ASSERT(reverse.vertices() == n && reverse.edges() == graph.edges(), "reverse has to be the transpose");
+
+  bitset visited(n);
+  bitset front(n);
+  bitset next_front(n);
+  std::vector<uint32_t> frontier(n);
+  std::vector<uint32_t> next(n);
+  frontier[0] = source;
+  visited.set(source);
+  depth[source] = 0;
+
+  uint32_t frontier_size = 1;
+  uint32_t reached = 1;
+  EdgeIndex frontier_edges = graph.degree(source);
+  EdgeIndex unexplored = graph.edges() - frontier_edges;  // out-edges of unvisited vertices
+  bool bottom_up = false;
+  bool growing = true;
+  std::atomic<uint_32_cx> tail;
+  std::atomic<EdgeIndex> scout;
+
+  for (uint32_t level = 1; frontier_size > 0; level++) {
+    if (!bottom_up && frontier_edges > unexplored / kAlpha) {
+      front.clear();
+      for (uint32_t i = 0; i < frontier_size; i++) {
+        front.set(frontier[i]);
+      }
+      bottom_up = true;
+    } else if (bottom_up && !growing && frontier_size < n / kBeta) {
+      uint32_t count = 0;
+      front.for_each_set([&](size_t v) { frontier[count++] = static_cast<uint32_t>(v); });
+      bottom_up = false;
+    }
+    tail = 0;
+    scout = 0;
+    if (bottom_up) {
+      next_front.clear();
+      // nothing writes visited or front during the step
+      pool.parallel_for(
+          0, n,
+          [&](uint_32_cx begin, uint_32_cx end) {
+            uint_32_cx awake = 0;
+            EdgeIndex edges = 0;
+            for (auto v = static_cast<uint32_t>(begin); v < end; v++) {
+              if (visited.test(v)) {
+                continue;
+              }
+              for (const uint32_t parent : reverse.neighbours(v)) {
+                if (front.test(parent)) {
+                  depth[v] = level;
+                  next_front.atomic_set(v);
+                  awake++;
+                  edges += graph.degree(v);
+                  break;
+                }
+              }
+            }
+            tail += awake;
+            scout += edges;
+          },
+          4096);
+      visited |= next_front;
+      std::swap(front, next_front);
+    } else {
+      pool.parallel_for(
+          0, frontier_size,
+          [&](uint_32_cx begin, uint_32_cx end) {
+            std::vector<uint32_t> local;
+            EdgeIndex edges = 0;
+            for (uint_32_cx i = begin; i < end; i++) {
+              for (const uint32_t u : graph.neighbours(frontier[i])) {
+                if (!visited.atomic_test(u) && visited.atomic_test_and_set(u)) {
+                  depth[u] = level;
+                  local.push_back(u);
+                  edges += graph.degree(u);
+                }
+              }
+            }
+            const uint_32_cx at = tail.fetch_add(local.size());
+            std::copy(local.begin(), local.end(), next.begin() + at);
+            scout += edges;
+          },
+          64);
+      std::swap(frontier, next);
+    }
+    growing = tail > frontier_size;
+    frontier_size = static_cast<uint32_t>(tail.load());
+    frontier_edges = scout;
+    unexplored -= std::min(unexplored, frontier_edges);
+    reached += frontier_size;
+  }
+  return reached;
+}
+/**
+ * parallel_breadth_first_search() for undirected graphs, they are their own transpose
+ */
+template <typename W>
+uint32_t parallel_breadth_first_search(const CSRGraph<W>& graph, uint32_t source, std::vector<uint32_t>& depth,
+                                       ThreadPool& pool = ThreadPool::global()) {
+  CX_ASSERT(graph.symmetric(), "directed graphs need their transpose");
+  return parallel_breadth_first_search(graph, graph, source, depth, pool);
+}
+
+/**
+ * Dijkstra's shortest paths from one source. The frontier is an IndexedPriorityQueue keyed by vertex,
+ * so every vertex is queued at most once and improved with decrease_key instead of pushing duplicates.
+ * @param graph the graph, weights must not be negative
+ * @param source start vertex
+ * @param dist resized to the vertex count, the distance from source or numeric_limits<W>::max() if unreached
+ * @param parent if not null, resized to the vertex count and filled with the previous vertex on the shortest
+ * path, CSRGraph::kNone for source and unreached vertices
+ * @param target if given the search stops once its distance is final
+ * @return the number of vertices whose distance is final
+ */
+template <typename W>
+uint32_t dijkstra(const CSRGraph<W>& graph, uint32_t source, std::vector<W>& dist,
+                  std::vector<uint32_t>* parent = nullptr, uint32_t target = CSRGraph<W>::kNone) {
+  const uint32_t n = graph.vertices();
+  dist.assign(n, std::numeric_limits<W>::max());
+  if (parent) {
+    parent->assign(n, CSRGraph<W>::kNone);
+  }
+  if (source >= n) {
+    return 0;
+  }
+  IndexedPriorityQueue<W> open(n);
+  dist[source] = W(0);
+  open.insert(source, W(0));
+  uint32_t settled = 0;
+  while (!open.empty()) {
+    const uint32_t v = open.top_handle();
+    open.pop();
+    settled++;
+    if (v == target) {
+      break;
+    }
+    for (auto e = graph.edge_begin(v); e < graph.edge_end(v); e++) {
+      CX_ASSERT(graph.weight(e) >= W(0), "negative edge weight");
+      const uint32_t u = graph.target(e);
+      const W d = dist[v] + graph.weight(e);
+      if (d < dist[u]) {
+        if (open.contains(u)) {
+          open.decrease_key(u, d);
+        } else {
+          // a settled vertex cant improve with non negative weights
+          open.insert(u, d);
+        }
+        dist[u] = d;
+        if (parent) {
+          (*parent)[u] = v;
+        }
+      }
+    }
+  }
+  return settled;
+}
+
+/**
+ * Bidirectional Dijkstra between two vertices: one search from source over graph, one from target over its
+ * transpose, always advancing the side with the smaller frontier key. It stops once the two keys together
+ * reach the best meeting distance, which usually settles far fewer vertices than a one sided search.
+ * @param graph the graph, weights must not be negative
+ * @param reverse the transpose of graph
+ * @param source start vertex
+ * @param target end vertex
+ * @param path if not null, filled with the vertices from source to target - empty if unreachable
+ * @return the shortest distance or numeric_limits<W>::max() if target is unreachable
+ */
+template <typename W>
+W bidirectional_dijkstra(const CSRGraph<W>& graph, const CSRGraph<W>& reverse, uint32_t source,
+                         uint32_t target, std::vector<uint32_t>* path = nullptr) {
+  constexpr W kInf = std::numeric_limits<W>::max();
+  constexpr uint32_t kNone = CSRGraph<W>::kNone;
+  const uint32_t n = graph.vertices();
+  if (path) {
+    path->clear();
+  }
+  if (source >= n || target >= n) {
+    return kInf;
+  }
+  CX_ASSERT(reverse.vertices() == n && reverse.edges() == graph.edges(), "reverse has to be the transpose");
+  if (source == target) {
+    if (path) {
+      path->push_back(source);
+    }
+    return W(0);
+  }
+  struct Side {
+    const CSRGraph<W>& graph;
+    std::vector<W> dist;
+    std::vector<uint32_t> parent;
+    IndexedPriorityQueue<W> open;
+    Side(const CSRGraph<W>& g, uint32_t n, uint32_t start)
+        : graph(g), dist(n, std::numeric_limits<W>::max()), parent(n, CSRGraph<W>::kNone), open(n) {
+      dist[start] = W(0);
+      open.insert(start, W(0));
+    }
+  };
+  Side forward(graph, n, source);
+  Side backward(reverse, n, target);
+  W best = kInf;
+  uint32_t meet = kNone;
+
+  while (!forward.open.empty() && !backward.open.empty()) {
+    if (forward.open.top() + backward.open.top() >= best) {
+      break;
+    }
+    Side& side = forward.open.top() <= backward.open.top() ? forward : backward;
+    const Side& other = &side == &forward ? backward : forward;
+    const uint32_t v = side.open.top_handle();
+    side.open.pop();
+    for (auto e = side.graph.edge_begin(v); e < side.graph.edge_end(v); e++) {
+      CX_ASSERT(side.graph.weight(e) >= W(0), "negative edge weight");
+      const uint32_t u = side.graph.target(e);
+      const W d = side.dist[v] + side.graph.weight(e);
+      if (d < side.dist[u]) {
+        if (side.open.contains(u)) {
+          side.open.decrease_key(u, d);
+        } else {
+          side.open.insert(u, d);
+        }
+        side.dist[u] = d;
+        side.parent[u] = v;
+      }
+      if (other.dist[u] != kInf && side.dist[u] + other.dist[u] < best) {
+        best = side.dist[u] + other.dist[u];
+        meet = u;
+      }
+    }
   }
+  if (path && meet != kNone) {
+    for (uint32_t v = meet; v != kNone; v = forward.parent[v]) {
+      path->push_back(v);
+    }
+    std::reverse(path->begin(), path->end());
+    for (uint32_t v = backward.parent[meet]; v != kNone; v = backward.parent[v]) {
+      path->push_back(v);
+    }
+  }
+  return best;
+}
+/**
+ * bidirectional_dijkstra() for undirected graphs, they are their own transpose
+ */
+template <typename W>
+W bidirectional_dijkstra(const CSRGraph<W>& graph, uint32_t source, uint32_t target,
+                         std::vector<uint32_t>* path = nullptr) {
+  CX_ASSERT(graph.symmetric(), "directed graphs need their transpose");
+  return bidirectional_dijkstra(graph, graph, source, target, path);
 }
 }  // namespace cxstructs
 #ifndef CX_DELETE_TESTS
+#include <random>
 namespace cxtests {  // namespace cxtests
 static void TEST_DFS() {
   std::cout << "TESTING DEPTH FIRST SEARCH" << std::endl;
@@ -80,6 +425,138 @@ static void TEST_DFS() {
   int reachableNodes = depth_first_search(mat, 0);
 
   CX_ASSERT(reachableNodes == 5, "");
+  mat[0][3] = 0;
+  mat[3][0] = 0;
+  CX_ASSERT(depth_first_search(mat, 0) == 3, "");
+  CX_ASSERT(depth_first_search(mat, 4) == 2, "");
+  CX_ASSERT(depth_first_search(mat, 7) == 0, "");
+}
+static void TEST_GRAPH_SEARCH() {
+  using namespace cxstructs;
+  using Graph = CSRGraph<float>;
+  constexpr uint32_t kNone = Graph::kNone;
+  std::cout << "TESTING GRAPH SEARCH" << std::endl;
+
+  std::cout << "  Testing depth first search..." << std::endl;
+  std::vector<std::pair<uint32_t, uint32_t>> pairs = {{0, 1}, {0, 4}, {1, 2}, {2, 0}, {1, 3}, {5, 0}};
+  Graph g(6, pairs);
+  std::vector<uint32_t> order;
+  CX_ASSERT(depth_first_search(g, 0, [&order](uint32_t v) { order.push_back(v); }) == 5, "");
+  CX_ASSERT((order == std::vector<uint32_t>{0, 1, 2, 3, 4}), "");
+  CX_ASSERT(depth_first_search(g, 5) == 6, "");
+  CX_ASSERT(depth_first_search(g, 4) == 1, "");
+  CX_ASSERT(depth_first_search(g, 6) == 0, "");
+  // a long chain would overflow a recursive search
+  std::vector<std::pair<uint32_t, uint32_t>> chain;
+  for (uint32_t i = 0; i + 1 < 200000; i++) {
+    chain.emplace_back(i, i + 1);
+  }
+  Graph line(200000, chain);
+  CX_ASSERT(depth_first_search(line, 0) == 200000, "");
+
+  std::cout << "  Testing breadth first search..." << std::endl;
+  std::vector<uint32_t> depth;
+  CX_ASSERT(breadth_first_search(g, 0, depth) == 5, "");
+  CX_ASSERT((depth == std::vector<uint32_t>{0, 1, 2, 2, 1, kNone}), "");
+  CX_ASSERT(breadth_first_search(line, 0, depth) == 200000 && depth.back() == 199999, "");
+
+  std::cout << "  Testing parallel breadth first search..." << std::endl;
+  ThreadPool pool(4);
+  std::vector<uint32_t> par;
+  CX_ASSERT(parallel_breadth_first_search(line, line.transpose(), 0, par, pool) == 200000, "");
+  CX_ASSERT(par == depth, "");
+  std::mt19937 rng(42);
+  for (const uint32_t n : {50U, 5000U, 60000U}) {
+    for (const uint32_t avg_degree : {1U, 4U, 16U}) {
+      std::uniform_int_distribution<uint32_t> vertex(0, n - 1);
+      std::vector<std::pair<uint32_t, uint32_t>> edges(static_cast<std::size_t>(n) * avg_degree);
+      for (auto& e : edges) {
+        e = {vertex(rng), vertex(rng)};
+      }
+      Graph directed(n, edges);
+      const Graph reverse = directed.transpose();
+      Graph undirected(n, edges, true);
+      for (const uint32_t source : {0U, n / 2}) {
+        const uint32_t reached = breadth_first_search(directed, source, depth);
+        CX_ASSERT(parallel_breadth_first_search(directed, reverse, source, par, pool) == reached, "");
+        CX_ASSERT(par == depth, "");
+        CX_ASSERT(depth_first_search(directed, source) == reached, "");
+        const uint32_t reached_u = breadth_first_search(undirected, source, depth);
+        CX_ASSERT(parallel_breadth_first_search(undirected, source, par, pool) == reached_u, "");
+        CX_ASSERT(par == depth, "");
+      }
+    }
+  }
+
+  std::cout << "  Testing dijkstra..." << std::endl;
+  std::vector<Graph::Edge> weighted = {{0, 1, 4}, {0, 2, 1}, {2, 1, 2}, {1, 3, 1}, {2, 3, 5}, {4, 0, 1}};
+  Graph wg(5, weighted);
+  std::vector<float> dist;
+  std::vector<uint32_t> parent;
+  CX_ASSERT(dijkstra(wg, 0, dist, &parent) == 4, "");
+  CX_ASSERT(dist[0] == 0 && dist[1] == 3 && dist[2] == 1 && dist[3] == 4, "");
+  CX_ASSERT(dist[4] == std::numeric_limits<float>::max(), "");
+  CX_ASSERT(parent[3] == 1 && parent[1] == 2 && parent[2] == 0 && parent[0] == kNone, "");
+  std::vector<uint32_t> path;
+  CX_ASSERT(bidirectional_dijkstra(wg, wg.transpose(), 4, 3, &path) == 5, "");
+  CX_ASSERT((path == std::vector<uint32_t>{4, 0, 2, 1, 3}), "");
+  CX_ASSERT(bidirectional_dijkstra(wg, wg.transpose(), 3, 0, &path) == std::numeric_limits<float>::max(), "");
+  CX_ASSERT(path.empty(), "");
+  CX_ASSERT(bidirectional_dijkstra(wg, wg.transpose(), 2, 2, &path) == 0 && path.size() == 1, "");
+
+  // against Bellman-Ford on random graphs, integral weights keep the sums exact
+  for (const bool undirected : {false, true}) {
+    const uint32_t n = 300;
+    std::uniform_int_distribution<uint32_t> vertex(0, n - 1);
+    std::uniform_int_distribution<int> cost(0, 20);
+    std::vector<Graph::Edge> edges(1200);
+    for (auto& e : edges) {
+      e = {vertex(rng), vertex(rng), static_cast<float>(cost(rng))};
+    }
+    Graph rg(n, edges, undirected);
+    const Graph reverse = rg.transpose();
+    for (const uint32_t source : {0U, 17U, 299U}) {
+      std::vector<float> expected(n, std::numeric_limits<float>::max());
+      expected[source] = 0;
+      for (uint32_t round = 0; round < n; round++) {
+        for (uint32_t v = 0; v < n; v++) {
+          for (auto e = rg.edge_begin(v); e < rg.edge_end(v); e++) {
+            if (expected[v] != std::numeric_limits<float>::max()) {
+              expected[rg.target(e)] = std::min(expected[rg.target(e)], expected[v] + rg.weight(e));
+            }
+          }
+        }
+      }
+      dijkstra(rg, source, dist, &parent);
+      CX_ASSERT(dist == expected, "");
+      for (uint32_t target = 0; target < n; target += 7) {
+        std::vector<float> early;
+        dijkstra(rg, source, early, nullptr, target);
+        CX_ASSERT(early[target] == expected[target], "");
+        const float d = undirected ? bidirectional_dijkstra(rg, source, target, &path)
+                                   : bidirectional_dijkstra(rg, reverse, source, target, &path);
+        CX_ASSERT(d == expected[target], "");
+        if (d == std::numeric_limits<float>::max()) {
+          CX_ASSERT(path.empty(), "");
+          continue;
+        }
+        CX_ASSERT(path.front() == source && path.back() == target, "");
+        // the path exists and its cheapest edges add up to the distance
+        float sum = 0;
+        for (std::size_t i = 0; i + 1 < path.size(); i++) {
+          float cheapest = std::numeric_limits<float>::max();
+          for (auto e = rg.edge_begin(path[i]); e < rg.edge_end(path[i]); e++) {
+            if (rg.target(e) == path[i + 1]) {
+              cheapest = std::min(cheapest, rg.weight(e));
+            }
+          }
+          CX_ASSERT(cheapest != std::numeric_limits<float>::max(), "");
+          sum += cheapest;
+        }
+        CX_ASSERT(sum == d, "");
+      }
+    }
+  }
 }
 }  // namespace cxtests
 #endif
@@ -21,9 +21,12 @@
 #ifndef CXSTRUCTS_SRC_CXALGOS_MISC_H_
 #define CXSTRUCTS_SRC_CXALGOS_MISC_H_
 
+#include <cstdint>
 #include <ctime>
 #include <vector>
 #include "../cxstructs/Geometry.h"
+#include "../cxstructs/Grid2D.h"
+#include "../cxutil/cxhash.h"
 
 namespace cxstructs {
 template <typename S, typename B>
@@ -59,6 +62,44 @@ std::vector<std::vector<S>> maze_simple_generation(const B& obstacle_val, Point
   maze[end.y()][end.x()] = S();
   return maze;
 }
+/**
+ * Same maze as above, generated into a Grid2D - one allocation that is reused if the grid already has the
+ * size. Rows are filled in parallel, every cell is derived from the seed and its position.
+ * @param maze the grid, keeps its size and border
+ * @param obstacle_val value of the walls
+ * @param start start of the guaranteed free corridor
+ * @param end end of the corridor
+ * @param seed same seed and size give the same maze
+ */
+template <typename S, typename B, GridLayout Layout>
+void maze_simple_generation(Grid2D<S, Layout>& maze, const B& obstacle_val, Point start, Point end,
+                            uint64_t seed = static_cast<uint64_t>(std::time(nullptr))) {
+  const uint64_t mixed = hash_int(seed);
+  const uint64_t width = maze.width();
+  const S wall = static_cast<S>(obstacle_val);
+  // a table instead of a branch, the branch would mispredict on every other cell
+  maze.fill_parallel([mixed, width, wall](uint32_t x, uint32_t y) {
+    const S cells[2] = {wall, S()};
+    return cells[hash_int((y * width + x) ^ mixed) & 1];
+  });
+
+  int x = start.x();
+  int y = start.y();
+  while (x != end.x() || y != end.y()) {
+    maze(x, y) = S();
+
+    if (x < end.x()) {
+      x++;
+    } else if (x > end.x()) {
+      x--;
+    } else if (y < end.y()) {
+      y++;
+    } else if (y > end.y()) {
+      y--;
+    }
+  }
+  maze(end.x(), end.y()) = S();
+}
 
 }  // namespace cxstructs
 #endif  //CXSTRUCTS_SRC_CXALGOS_MISC_H_
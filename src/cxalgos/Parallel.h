@@ -0,0 +1,441 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXALGOS_PARALLEL_H_
+#define CXSTRUCTS_SRC_CXALGOS_PARALLEL_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxthreadpool.h"
+
+// Parallel loops on the global ThreadPool over raw arrays and the contiguous containers (vec, mat)
+// Work is cut into blocks of half the L2 cache, so a block is still cached when a second pass (scan,
+// partition) comes back to it. Reductions combine the block results in block order - the result only depends
+// on the block size, which DETERMINISTIC fixes for every machine, so floating point sums are reproducible
+// independent of the thread count and CPU
+
+namespace cxstructs::parallel {
+/**
+ * How reduce() and transform_reduce() split the work
+ */
+enum class Reduction : uint8_t {
+  FAST,          // blocks sized by the L2 cache, block results summed in order
+  DETERMINISTIC  // fixed blocks and a pairwise tree - bitwise identical results on any machine and pool size
+};
+}  // namespace cxstructs::parallel
+
+namespace cxhelper {
+// elements per block in Reduction::DETERMINISTIC
+constexpr uint_32_cx kDeterministicBlock = 4096;
+
+template <typename T>
+inline uint_32_cx parallel_block(cxstructs::parallel::Reduction mode = cxstructs::parallel::Reduction::FAST) {
+  if (mode == cxstructs::parallel::Reduction::DETERMINISTIC) {
+    return kDeterministicBlock;
+  }
+  return static_cast<uint_32_cx>(std::max<size_t>(1024, l2_cache_size() / 2 / sizeof(T)));
+}
+// [data, data + size) of a contiguous container - vec (get_raw, size) or mat (get_raw, n_rows * n_cols)
+template <typename Container>
+inline auto contiguous_range(Container& container) {
+  if constexpr (requires { container.n_rows(); }) {
+    return std::pair{container.get_raw(), static_cast<uint_32_cx>(container.n_rows() * container.n_cols())};
+  } else {
+    return std::pair{container.get_raw(), static_cast<uint_32_cx>(container.size())};
+  }
+}
+template <typename Container>
+concept Contiguous = requires(Container& container) { container.get_raw(); };
+
+// reduces element(i) over [0, len) block wise - four interleaved accumulators inside a block keep the
+// floating point adds from waiting on each other
+template <typename R, typename Reduce, typename Element>
+R reduce_blocks(uint_32_cx len, R init, Reduce reduce, Element element, cxstructs::parallel::Reduction mode,
+                uint_32_cx block, cxstructs::ThreadPool& pool) {
+  if (len == 0) {
+    return init;
+  }
+  const uint_32_cx blocks = (len + block - 1) / block;
+  // not a vector - the blocks write their results concurrently, which vector<bool> would not allow
+  std::unique_ptr<R[]> partial(new R[blocks]);
+  pool.parallel_for(0, blocks, [&](uint_32_cx first, uint_32_cx last) {
+    for (uint_32_cx b = first; b < last; b++) {
+      const uint_32_cx begin = b * block;
+      const uint_32_cx end = std::min(len, begin + block);
+      if (end - begin < 8) {
+        R acc = element(begin);
+        for (uint_32_cx i = begin + 1; i < end; i++) {
+          acc = reduce(acc, element(i));
+        }
+        partial[b] = acc;
+        continue;
+      }
+      R acc0 = element(begin), acc1 = element(begin + 1), acc2 = element(begin + 2), acc3 = element(begin + 3);
+      uint_32_cx i = begin + 4;
+      for (; i + 4 <= end; i += 4) {
+        acc0 = reduce(acc0, element(i));
+        acc1 = reduce(acc1, element(i + 1));
+        acc2 = reduce(acc2, element(i + 2));
+        acc3 = reduce(acc3, element(i + 3));
+      }
+      for (; i < end; i++) {
+        acc0 = reduce(acc0, element(i));
+      }
+      partial[b] = reduce(reduce(acc0, acc1), reduce(acc2, acc3));
+    }
+  });
+  if (mode == cxstructs::parallel::Reduction::FAST) {
+    for (uint_32_cx b = 0; b < blocks; b++) {
+      init = reduce(init, partial[b]);
+    }
+    return init;
+  }
+  // pairwise tree, the same shape for any pool size - also keeps the rounding error of long sums low
+  for (uint_32_cx width = blocks; width > 1; width = (width + 1) / 2) {
+    for (uint_32_cx b = 0; b < width / 2; b++) {
+      partial[b] = reduce(partial[2 * b], partial[2 * b + 1]);
+    }
+    if (width % 2 != 0) {
+      partial[width / 2] = partial[width - 1];
+    }
+  }
+  return reduce(init, partial[0]);
+}
+}  // namespace cxhelper
+
+namespace cxstructs::parallel {
+/**
+ * Calls func(element) for every element in parallel
+ * @param arr the data
+ * @param len number of elements
+ * @param func callable taking T& - has to be thread safe
+ * @param pool the pool to run on - the library wide one by default
+ */
+template <typename T, typename Function>
+void for_each(T* arr, uint_32_cx len, Function func, ThreadPool& pool = ThreadPool::global()) {
+  pool.parallel_for(0, len, [&](uint_32_cx begin, uint_32_cx end) {
+    for (uint_32_cx i = begin; i < end; i++) {
+      func(arr[i]);
+    }
+  }, cxhelper::parallel_block<T>());
+}
+/**
+ * Calls func(element) for every element of a vec or mat in parallel
+ */
+template <cxhelper::Contiguous Container, typename Function>
+void for_each(Container& container, Function func, ThreadPool& pool = ThreadPool::global()) {
+  const auto [data, size] = cxhelper::contiguous_range(container);
+  for_each(data, size, func, pool);
+}
+/**
+ * Calls func(key, value) for every entry of a HashMap in parallel - the buckets are split into ranges
+ * @param func callable taking (const K&, V&) - has to be thread safe
+ */
+template <typename Map, typename Function>
+  requires requires(const Map& map) { map.for_each_in_buckets(0, 0, [](const auto&, auto&) {}); }
+void for_each(const Map& map, Function func, ThreadPool& pool = ThreadPool::global()) {
+  pool.parallel_for(0, map.capacity(), [&](uint_32_cx begin, uint_32_cx end) {
+    map.for_each_in_buckets(begin, end, func);
+  }, 4096);
+}
+/**
+ * out[i] = func(in[i]) in parallel - in and out may be the same array
+ * @param in the input
+ * @param len number of elements
+ * @param out the output, len elements
+ * @param func callable taking const T& - has to be thread safe
+ * @param pool the pool to run on - the library wide one by default
+ */
+template <typename T, typename U, typename Function>
+void transform(const T* in, uint_32_cx len, U* out, Function func, ThreadPool& pool = ThreadPool::global()) {
+  pool.parallel_for(0, len, [&](uint_32_cx begin, uint_32_cx end) {
+    for (uint_32_cx i = begin; i < end; i++) {
+      out[i] = func(in[i]);
+    }
+  }, cxhelper::parallel_block<T>());
+}
+/**
+ * out[i] = func(in[i]) for two vecs or mats of the same size
+ */
+template <cxhelper::Contiguous In, cxhelper::Contiguous Out, typename Function>
+void transform(const In& in, Out& out, Function func, ThreadPool& pool = ThreadPool::global()) {
+  const auto [in_data, in_size] = cxhelper::contiguous_range(in);
+  const auto [out_data, out_size] = cxhelper::contiguous_range(out);
+  CX_ASSERT(in_size == out_size, "containers have different sizes");
+  transform(static_cast<const std::remove_pointer_t<decltype(in_data)>*>(in_data), in_size, out_data, func,
+            pool);
+}
+/**
+ * Reduces transform(arr[i]) with the reduce operation, starting from init
+ * @param arr the data
+ * @param len number of elements
+ * @param init initial value, reduced in once
+ * @param reduce associative and commutative operation like std::plus
+ * @param transform callable taking const T&
+ * @param mode DETERMINISTIC for reproducible floating point results on any machine and thread count
+ * @param pool the pool to run on - the library wide one by default
+ */
+template <typename T, typename R, typename Reduce, typename Transform>
+R transform_reduce(const T* arr, uint_32_cx len, R init, Reduce reduce, Transform transform,
+                   Reduction mode = Reduction::FAST, ThreadPool& pool = ThreadPool::global()) {
+  return cxhelper::reduce_blocks(
+      len, init, reduce, [&](uint_32_cx i) -> R { return transform(arr[i]); }, mode,
+      cxhelper::parallel_block<T>(mode), pool);
+}
+/**
+ * Reduces transform(a[i], b[i]) over two arrays - e.g. a dot product with std::plus and std::multiplies
+ */
+template <typename T, typename U, typename R, typename Reduce, typename Transform>
+R transform_reduce(const T* a, const U* b, uint_32_cx len, R init, Reduce reduce, Transform transform,
+                   Reduction mode = Reduction::FAST, ThreadPool& pool = ThreadPool::global()) {
+  return cxhelper::reduce_blocks(
+      len, init, reduce, [&](uint_32_cx i) -> R { return transform(a[i], b[i]); }, mode,
+      cxhelper::parallel_block<T>(mode), pool);
+}
+/**
+ * Reduces the array with the reduce operation, starting from init
+ * @param reduce associative and commutative operation, std::plus by default
+ * @param mode DETERMINISTIC for reproducible floating point results on any machine and thread count
+ */
+template <typename T, typename Reduce = std::plus<>>
+T reduce(const T* arr, uint_32_cx len, T init = T(), Reduce reduce = Reduce(), Reduction mode = Reduction::FAST,
+         ThreadPool& pool = ThreadPool::global()) {
+  return transform_reduce(arr, len, init, reduce, [](const T& value) { return value; }, mode, pool);
+}
+/**
+ * Reduces all elements of a vec or mat
+ */
+template <cxhelper::Contiguous Container, typename Reduce = std::plus<>>
+auto reduce(const Container& container, Reduce reduce = Reduce(), Reduction mode = Reduction::FAST,
+            ThreadPool& pool = ThreadPool::global()) {
+  const auto [data, size] = cxhelper::contiguous_range(container);
+  using T = std::remove_cv_t<std::remove_pointer_t<decltype(data)>>;
+  return parallel::reduce<T>(data, size, T(), reduce, mode, pool);
+}
+/**
+ * out[i] = in[0] op in[1] op ... op in[i] - in and out may be the same array.<p>
+ * Two passes over blocks of half the L2 cache: block totals, then each block scans from its offset
+ * @param op associative operation, std::plus by default
+ */
+template <typename T, typename Op = std::plus<>>
+void inclusive_scan(const T* in, uint_32_cx len, T* out, Op op = Op(), ThreadPool& pool = ThreadPool::global()) {
+  if (len == 0) {
+    return;
+  }
+  const uint_32_cx block = cxhelper::parallel_block<T>();
+  const uint_32_cx blocks = (len + block - 1) / block;
+  auto scan = [&](uint_32_cx begin, uint_32_cx end, const T* offset) {
+    T acc = offset != nullptr ? op(*offset, in[begin]) : in[begin];
+    out[begin] = acc;
+    for (uint_32_cx i = begin + 1; i < end; i++) {
+      acc = op(acc, in[i]);
+      out[i] = acc;
+    }
+  };
+  if (blocks == 1 || pool.size() == 0) {
+    scan(0, len, nullptr);
+    return;
+  }
+  std::vector<T> offsets(blocks);
+  pool.parallel_for(0, blocks - 1, [&](uint_32_cx first, uint_32_cx last) {
+    for (uint_32_cx b = first; b < last; b++) {
+      T acc = in[b * block];
+      for (uint_32_cx i = b * block + 1; i < (b + 1) * block; i++) {
+        acc = op(acc, in[i]);
+      }
+      offsets[b + 1] = acc;
+    }
+  });
+  for (uint_32_cx b = 2; b < blocks; b++) {
+    offsets[b] = op(offsets[b - 1], offsets[b]);
+  }
+  pool.parallel_for(0, blocks, [&](uint_32_cx first, uint_32_cx last) {
+    for (uint_32_cx b = first; b < last; b++) {
+      scan(b * block, std::min(len, (b + 1) * block), b == 0 ? nullptr : &offsets[b]);
+    }
+  });
+}
+/**
+ * Moves the elements for which pred is true in front of the others, keeping the relative order in both
+ * groups (stable). The predicate is called once per element.<p>
+ * Needs a buffer of len elements - T has to be default constructible and movable
+ * @param arr the data
+ * @param len number of elements
+ * @param pred callable taking const T& - has to be thread safe
+ * @param pool the pool to run on - the library wide one by default
+ * @return the number of elements for which pred is true, the index of the second group
+ */
+template <typename T, typename Predicate>
+uint_32_cx partition(T* arr, uint_32_cx len, Predicate pred, ThreadPool& pool = ThreadPool::global()) {
+  if (len == 0) {
+    return 0;
+  }
+  const uint_32_cx block = cxhelper::parallel_block<T>();
+  const uint_32_cx blocks = (len + block - 1) / block;
+  std::vector<uint8_t> flags(len);
+  std::vector<uint_32_cx> selected(blocks + 1, 0);
+  pool.parallel_for(0, blocks, [&](uint_32_cx first, uint_32_cx last) {
+    for (uint_32_cx b = first; b < last; b++) {
+      uint_32_cx count = 0;
+      for (uint_32_cx i = b * block; i < std::min(len, (b + 1) * block); i++) {
+        flags[i] = pred(static_cast<const T&>(arr[i])) ? 1 : 0;
+        count += flags[i];
+      }
+      selected[b + 1] = count;
+    }
+  });
+  for (uint_32_cx b = 1; b <= blocks; b++) {
+    selected[b] += selected[b - 1];
+  }
+  const uint_32_cx total = selected[blocks];
+  std::vector<T> buffer(len);
+  pool.parallel_for(0, blocks, [&](uint_32_cx first, uint_32_cx last) {
+    for (uint_32_cx b = first; b < last; b++) {
+      uint_32_cx in_front = selected[b];
+      uint_32_cx in_back = total + b * block - selected[b];
+      for (uint_32_cx i = b * block; i < std::min(len, (b + 1) * block); i++) {
+        buffer[flags[i] ? in_front++ : in_back++] = std::move(arr[i]);
+      }
+    }
+  });
+  pool.parallel_for(0, len, [&](uint_32_cx begin, uint_32_cx end) {
+    std::move(buffer.begin() + begin, buffer.begin() + end, arr + begin);
+  }, block);
+  return total;
+}
+/**
+ * partition() for a vec
+ */
+template <cxhelper::Contiguous Container, typename Predicate>
+uint_32_cx partition(Container& container, Predicate pred, ThreadPool& pool = ThreadPool::global()) {
+  const auto [data, size] = cxhelper::contiguous_range(container);
+  return partition(data, size, pred, pool);
+}
+}  // namespace cxstructs::parallel
+
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <numeric>
+#include <random>
+#include "../cxstructs/HashMap.h"
+#include "../cxstructs/mat.h"
+#include "../cxstructs/vec.h"
+namespace cxtests {
+static void TEST_PARALLEL() {
+  using namespace cxstructs;
+  std::cout << "TESTING PARALLEL ALGORITHMS" << std::endl;
+  ThreadPool pool(3);
+  ThreadPool single(0);
+  std::mt19937 gen(67);
+  const uint_32_cx n = 1000003;
+  std::vector<int> ints(n);
+  for (auto& v : ints) {
+    v = static_cast<int>(gen() % 1000) - 500;
+  }
+
+  std::cout << "  Testing for_each and transform..." << std::endl;
+  std::vector<int> doubled(n);
+  parallel::transform(ints.data(), n, doubled.data(), [](int v) { return v * 2; }, pool);
+  std::vector<int> copy = ints;
+  parallel::for_each(copy.data(), n, [](int& v) { v *= 2; }, pool);
+  CX_ASSERT(copy == doubled, "");
+  vec<float> values(5000, 1.5F);
+  parallel::for_each(values, [](float& v) { v += 1; });
+  vec<float> squared(5000, 0.0F);
+  parallel::transform(values, squared, [](float v) { return v * v; });
+  CX_ASSERT(values[4999] == 2.5F && squared[0] == 6.25F, "");
+  mat m(300, 300);
+  parallel::for_each(m, [](float& v) { v = 6; }, pool);
+  CX_ASSERT(parallel::reduce(m) == 300 * 300 * 6.0F, "");
+
+  std::cout << "  Testing reduce..." << std::endl;
+  const long long expected = std::accumulate(ints.begin(), ints.end(), 0LL);
+  CX_ASSERT(parallel::transform_reduce(ints.data(), n, 0LL, std::plus<>(),
+                                       [](int v) { return static_cast<long long>(v); }, parallel::Reduction::FAST,
+                                       pool) == expected, "");
+  CX_ASSERT(parallel::reduce(ints.data(), n, 7, std::plus<>(), parallel::Reduction::FAST, pool) ==
+                expected + 7, "");
+  CX_ASSERT(parallel::reduce(ints.data(), n, -1000, [](int a, int b) { return std::max(a, b); }) == 499, "");
+  CX_ASSERT(parallel::reduce(ints.data(), 0, 5) == 5 && parallel::reduce(ints.data(), 3) == ints[0] + ints[1] + ints[2],
+            "");
+  std::vector<float> floats(n);
+  for (auto& v : floats) {
+    v = std::uniform_real_distribution<float>(-1, 1)(gen);
+  }
+  // the deterministic sum is bitwise the same on any number of threads
+  const auto det = [&](ThreadPool& p) {
+    return parallel::reduce(floats.data(), n, 0.0F, std::plus<>(), parallel::Reduction::DETERMINISTIC, p);
+  };
+  const float reference = det(single);
+  CX_ASSERT(det(pool) == reference && det(ThreadPool::global()) == reference, "");
+  const double exact = std::accumulate(floats.begin(), floats.end(), 0.0);
+  CX_ASSERT(std::abs(reference - exact) < 1e-2, "");
+  const float dot = parallel::transform_reduce(floats.data(), floats.data(), n, 0.0F, std::plus<>(),
+                                               std::multiplies<>(), parallel::Reduction::DETERMINISTIC, pool);
+  CX_ASSERT(std::abs(dot - n / 3.0) < n * 0.01, "");
+  CX_ASSERT(!parallel::transform_reduce(ints.data(), n, false, std::logical_or<>(),
+                                        [](int v) { return v > 1000; }, parallel::Reduction::FAST, pool),
+            "");
+
+  std::cout << "  Testing inclusive_scan..." << std::endl;
+  std::vector<long long> wide(ints.begin(), ints.end()), scanned(n), reference_scan(n);
+  std::partial_sum(wide.begin(), wide.end(), reference_scan.begin());
+  parallel::inclusive_scan(wide.data(), n, scanned.data(), std::plus<>(), pool);
+  CX_ASSERT(scanned == reference_scan, "");
+  parallel::inclusive_scan(wide.data(), n, wide.data(), std::plus<>(), single);
+  CX_ASSERT(wide == reference_scan, "");
+  std::vector<int> tiny{3, 1, 2};
+  parallel::inclusive_scan(tiny.data(), 3, tiny.data(), [](int a, int b) { return std::max(a, b); }, pool);
+  CX_ASSERT((tiny == std::vector<int>{3, 3, 3}), "");
+
+  std::cout << "  Testing partition..." << std::endl;
+  copy = ints;
+  const auto is_even = [](int v) { return v % 2 == 0; };
+  const uint_32_cx split = parallel::partition(copy.data(), n, is_even, pool);
+  std::vector<int> stable = ints;
+  const auto stable_split = std::stable_partition(stable.begin(), stable.end(), is_even) - stable.begin();
+  CX_ASSERT(split == static_cast<uint_32_cx>(stable_split) && copy == stable, "");
+  vec<int> numbers{5, 2, 8, 1, 4};
+  CX_ASSERT(parallel::partition(numbers, [](int v) { return v > 3; }) == 3, "");
+  CX_ASSERT(numbers[0] == 5 && numbers[1] == 8 && numbers[2] == 4 && numbers[3] == 2, "");
+
+  std::cout << "  Testing HashMap for_each..." << std::endl;
+  HashMap<int, int> map;
+  for (int i = 0; i < 20000; i++) {
+    map.insert(i, 1);
+  }
+  std::atomic<long long> sum{0};
+  parallel::for_each(map, [&sum](const int& key, int& value) {
+    value = 2;
+    sum += key;
+  }, pool);
+  long long values_sum = 0;
+  map.for_each([&values_sum](const int&, int& value) { values_sum += value; });
+  CX_ASSERT(sum == 20000LL * 19999 / 2 && values_sum == 40000, "");
+}
+}  // namespace cxtests
+#endif
+#endif  // CXSTRUCTS_SRC_CXALGOS_PARALLEL_H_
@@ -25,11 +25,20 @@
 #include <array>
 
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "../cxconfig.h"
+#include "../cxutil/cxthreadpool.h"
 
 namespace cxhelper {  // helper methods to provide clean calling interface
 template <typename T>
@@ -126,6 +135,724 @@ bool bogo_sort_internal(T* arr, uint_32_cx len, bool ascending) {
     return true;
   }
 }
+// pattern-defeating quicksort (Orson Peters) - introsort with pattern detection and block partitioning
+// below kPdqInsertionCutoff elements insertion sort (or the AVX2 network) finishes a partition
+constexpr std::ptrdiff_t kPdqInsertionCutoff = 24;
+// above this the pivot is the ninther (median of 3 medians) instead of the median of 3
+constexpr std::ptrdiff_t kPdqNintherThreshold = 128;
+// partial_insertion_sort() gives up after moving this many elements
+constexpr size_t kPdqPartialInsertionLimit = 8;
+// elements classified per block in the branchless partition - offsets fit in a byte
+constexpr size_t kPdqBlockSize = 64;
+// parallel_sort() sorts partitions smaller than this on one thread
+constexpr std::ptrdiff_t kParallelSortCutoff = 1 << 15;
+
+template <typename T, typename Compare>
+inline void insertion_sort(T* begin, T* end, Compare comp) {
+  if (begin == end) {
+    return;
+  }
+  for (T* cur = begin + 1; cur != end; ++cur) {
+    T* sift = cur;
+    T* sift_1 = cur - 1;
+    if (comp(*sift, *sift_1)) {
+      T tmp = std::move(*sift);
+      do {
+        *sift-- = std::move(*sift_1);
+      } while (sift != begin && comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+    }
+  }
+}
+// *(begin - 1) has to be smaller or equal to all elements - saves the bounds check
+template <typename T, typename Compare>
+inline void unguarded_insertion_sort(T* begin, T* end, Compare comp) {
+  if (begin == end) {
+    return;
+  }
+  for (T* cur = begin + 1; cur != end; ++cur) {
+    T* sift = cur;
+    T* sift_1 = cur - 1;
+    if (comp(*sift, *sift_1)) {
+      T tmp = std::move(*sift);
+      do {
+        *sift-- = std::move(*sift_1);
+      } while (comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+    }
+  }
+}
+// insertion sort that stops after kPdqPartialInsertionLimit moves - returns true if the range is sorted
+template <typename T, typename Compare>
+inline bool partial_insertion_sort(T* begin, T* end, Compare comp) {
+  if (begin == end) {
+    return true;
+  }
+  size_t limit = 0;
+  for (T* cur = begin + 1; cur != end; ++cur) {
+    T* sift = cur;
+    T* sift_1 = cur - 1;
+    if (comp(*sift, *sift_1)) {
+      T tmp = std::move(*sift);
+      do {
+        *sift-- = std::move(*sift_1);
+      } while (sift != begin && comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+      limit += cur - sift;
+    }
+    if (limit > kPdqPartialInsertionLimit) {
+      return false;
+    }
+  }
+  return true;
+}
+template <typename T, typename Compare>
+inline void sort2(T* a, T* b, Compare comp) {
+  if (comp(*b, *a)) {
+    std::iter_swap(a, b);
+  }
+}
+template <typename T, typename Compare>
+inline void sort3(T* a, T* b, T* c, Compare comp) {
+  sort2(a, b, comp);
+  sort2(b, c, comp);
+  sort2(a, b, comp);
+}
+template <typename T, typename Compare>
+inline void heap_sort(T* begin, T* end, Compare comp) {
+  std::make_heap(begin, end, comp);
+  std::sort_heap(begin, end, comp);
+}
+// moves the median of 3 (or the ninther) to *begin
+template <typename T, typename Compare>
+inline void pdq_choose_pivot(T* begin, T* end, Compare comp) {
+  const std::ptrdiff_t size = end - begin;
+  const std::ptrdiff_t s2 = size / 2;
+  if (size > kPdqNintherThreshold) {
+    sort3(begin, begin + s2, end - 1, comp);
+    sort3(begin + 1, begin + (s2 - 1), end - 2, comp);
+    sort3(begin + 2, begin + (s2 + 1), end - 3, comp);
+    sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), comp);
+    std::iter_swap(begin, begin + s2);
+  } else {
+    sort3(begin + s2, begin, end - 1, comp);
+  }
+}
+// swaps a few elements of both sides after a bad partition so patterns dont repeat it
+template <typename T>
+inline void pdq_break_patterns(T* begin, T* pivot_pos, T* end) {
+  const std::ptrdiff_t l_size = pivot_pos - begin;
+  const std::ptrdiff_t r_size = end - (pivot_pos + 1);
+  if (l_size >= kPdqInsertionCutoff) {
+    std::iter_swap(begin, begin + l_size / 4);
+    std::iter_swap(pivot_pos - 1, pivot_pos - l_size / 4);
+    if (l_size > kPdqNintherThreshold) {
+      std::iter_swap(begin + 1, begin + (l_size / 4 + 1));
+      std::iter_swap(begin + 2, begin + (l_size / 4 + 2));
+      std::iter_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+      std::iter_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+    }
+  }
+  if (r_size >= kPdqInsertionCutoff) {
+    std::iter_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+    std::iter_swap(end - 1, end - r_size / 4);
+    if (r_size > kPdqNintherThreshold) {
+      std::iter_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+      std::iter_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+      std::iter_swap(end - 2, end - (1 + r_size / 4));
+      std::iter_swap(end - 3, end - (2 + r_size / 4));
+    }
+  }
+}
+// partitions around *begin: [begin, pivot) < pivot <= (pivot, end) - second is true if nothing had to be swapped
+template <typename T, typename Compare>
+inline std::pair<T*, bool> partition_right(T* begin, T* end, Compare comp) {
+  T pivot(std::move(*begin));
+  T* first = begin;
+  T* last = end;
+  // the median of 3 guarantees an element >= pivot on the right, so these need no bounds check
+  while (comp(*++first, pivot))
+    ;
+  if (first - 1 == begin) {
+    while (first < last && !comp(*--last, pivot))
+      ;
+  } else {
+    while (!comp(*--last, pivot))
+      ;
+  }
+  const bool already_partitioned = first >= last;
+  while (first < last) {
+    std::iter_swap(first, last);
+    while (comp(*++first, pivot))
+      ;
+    while (!comp(*--last, pivot))
+      ;
+  }
+  T* pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return {pivot_pos, already_partitioned};
+}
+template <typename T>
+inline void swap_offsets(T* first, T* last, const unsigned char* offsets_l,
+                         const unsigned char* offsets_r, size_t num, bool use_swaps) {
+  if (use_swaps) {
+    // equal counts on both sides - plain swaps keep the order for the next partition
+    for (size_t i = 0; i < num; ++i) {
+      std::iter_swap(first + offsets_l[i], last - offsets_r[i]);
+    }
+  } else if (num > 0) {
+    // a cyclic permutation needs one move per element instead of three
+    T* l = first + offsets_l[0];
+    T* r = last - offsets_r[0];
+    T tmp(std::move(*l));
+    *l = std::move(*r);
+    for (size_t i = 1; i < num; ++i) {
+      l = first + offsets_l[i];
+      *r = std::move(*l);
+      r = last - offsets_r[i];
+      *l = std::move(*r);
+    }
+    *r = std::move(tmp);
+  }
+}
+// partition_right() without data dependent branches (BlockQuicksort) - elements are classified a block at a time
+// into offset buffers and only then swapped, so mispredicted comparisons dont stall the pipeline
+template <typename T, typename Compare>
+inline std::pair<T*, bool> partition_right_branchless(T* begin, T* end, Compare comp) {
+  T pivot(std::move(*begin));
+  T* first = begin;
+  T* last = end;
+  while (comp(*++first, pivot))
+    ;
+  if (first - 1 == begin) {
+    while (first < last && !comp(*--last, pivot))
+      ;
+  } else {
+    while (!comp(*--last, pivot))
+      ;
+  }
+  const bool already_partitioned = first >= last;
+  if (!already_partitioned) {
+    std::iter_swap(first, last);
+    ++first;
+
+    alignas(64) unsigned char offsets_l[kPdqBlockSize];
+    alignas(64) unsigned char offsets_r[kPdqBlockSize];
+    T* offsets_l_base = first;
+    T* offsets_r_base = last;
+    size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+    while (first < last) {
+      // fill whichever buffer is empty, split the rest evenly when both are
+      const size_t num_unknown = last - first;
+      const size_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+      const size_t right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+
+      const size_t left_count = std::min(left_split, kPdqBlockSize);
+      for (size_t i = 0; i < left_count; i++) {
+        offsets_l[num_l] = static_cast<unsigned char>(i);
+        num_l += !comp(*first, pivot);
+        ++first;
+      }
+      const size_t right_count = std::min(right_split, kPdqBlockSize);
+      for (size_t i = 0; i < right_count;) {
+        offsets_r[num_r] = static_cast<unsigned char>(++i);
+        num_r += comp(*--last, pivot);
+      }
+
+      const size_t num = std::min(num_l, num_r);
+      swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l, offsets_r + start_r, num,
+                   num_l == num_r);
+      num_l -= num;
+      num_r -= num;
+      start_l += num;
+      start_r += num;
+      if (num_l == 0) {
+        start_l = 0;
+        offsets_l_base = first;
+      }
+      if (num_r == 0) {
+        start_r = 0;
+        offsets_r_base = last;
+      }
+    }
+    // one buffer has leftovers - move them to the middle
+    if (num_l) {
+      while (num_l--) {
+        std::iter_swap(offsets_l_base + offsets_l[start_l + num_l], --last);
+      }
+      first = last;
+    }
+    if (num_r) {
+      while (num_r--) {
+        std::iter_swap(offsets_r_base - offsets_r[start_r + num_r], first);
+        ++first;
+      }
+      last = first;
+    }
+  }
+  T* pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return {pivot_pos, already_partitioned};
+}
+// partitions around *begin: [begin, pivot] <= pivot < (pivot, end) - used when many elements equal the pivot
+template <typename T, typename Compare>
+inline T* partition_left(T* begin, T* end, Compare comp) {
+  T pivot(std::move(*begin));
+  T* first = begin;
+  T* last = end;
+  while (comp(pivot, *--last))
+    ;
+  if (last + 1 == end) {
+    while (first < last && !comp(pivot, *++first))
+      ;
+  } else {
+    while (!comp(pivot, *++first))
+      ;
+  }
+  while (first < last) {
+    std::iter_swap(first, last);
+    while (comp(pivot, *--last))
+      ;
+    while (!comp(pivot, *++first))
+      ;
+  }
+  T* pivot_pos = last;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return pivot_pos;
+}
+
+// cheap comparisons on arithmetic types can use the branchless partition
+template <typename T, typename Compare>
+constexpr bool kBranchlessSort =
+    std::is_arithmetic_v<T> &&
+    (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::greater<T>> ||
+     std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::greater<>>);
+
+#if defined(CX_AVX2)
+// the network sorts up to 16 elements in two registers
+constexpr std::ptrdiff_t kNetworkSortSize = 16;
+
+template <typename T>
+struct NetworkLanes;
+template <>
+struct NetworkLanes<int32_t> {
+  static constexpr int32_t kPad = std::numeric_limits<int32_t>::max();
+  static inline __m256i min(__m256i a, __m256i b) noexcept { return _mm256_min_epi32(a, b); }
+  static inline __m256i max(__m256i a, __m256i b) noexcept { return _mm256_max_epi32(a, b); }
+};
+template <>
+struct NetworkLanes<uint32_t> {
+  static constexpr uint32_t kPad = std::numeric_limits<uint32_t>::max();
+  static inline __m256i min(__m256i a, __m256i b) noexcept { return _mm256_min_epu32(a, b); }
+  static inline __m256i max(__m256i a, __m256i b) noexcept { return _mm256_max_epu32(a, b); }
+};
+template <>
+struct NetworkLanes<float> {
+  static constexpr float kPad = std::numeric_limits<float>::infinity();
+  static inline __m256i min(__m256i a, __m256i b) noexcept {
+    return _mm256_castps_si256(_mm256_min_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)));
+  }
+  static inline __m256i max(__m256i a, __m256i b) noexcept {
+    return _mm256_castps_si256(_mm256_max_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)));
+  }
+};
+template <typename T, typename Compare>
+constexpr bool kNetworkSortable =
+    (std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> || std::is_same_v<T, float>) &&
+    (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::greater<T>>);
+
+// lanes of bitonic step (K, J) that keep the max after comparing with lane i ^ J
+constexpr int network_mask(int k, int j) {
+  int mask = 0;
+  for (int i = 0; i < 8; i++) {
+    const bool ascending = k >= 8 || (i & k) == 0;
+    const bool lower = (i & j) == 0;
+    if (lower != ascending) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+}
+template <typename T, int K, int J>
+inline __m256i network_step(__m256i v) noexcept {
+  constexpr int kMask = network_mask(K, J);
+  const __m256i partner =
+      _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0 ^ J, 1 ^ J, 2 ^ J, 3 ^ J, 4 ^ J, 5 ^ J, 6 ^ J, 7 ^ J));
+  return _mm256_blend_epi32(NetworkLanes<T>::min(v, partner), NetworkLanes<T>::max(v, partner), kMask);
+}
+// bitonic merge of a register whose halves are sorted in opposite directions (or any bitonic sequence)
+template <typename T>
+inline __m256i network_merge8(__m256i v) noexcept {
+  v = network_step<T, 8, 4>(v);
+  v = network_step<T, 8, 2>(v);
+  return network_step<T, 8, 1>(v);
+}
+template <typename T>
+inline __m256i network_sort8(__m256i v) noexcept {
+  v = network_step<T, 2, 1>(v);
+  v = network_step<T, 4, 2>(v);
+  v = network_step<T, 4, 1>(v);
+  return network_merge8<T>(v);
+}
+// sorts n <= 16 elements ascending - the unused lanes are padded with the largest value
+template <typename T>
+inline void network_sort(T* arr, std::ptrdiff_t n) noexcept {
+  alignas(32) T buffer[kNetworkSortSize];
+  std::fill_n(buffer, kNetworkSortSize, NetworkLanes<T>::kPad);
+  std::copy_n(arr, n, buffer);
+  __m256i a = network_sort8<T>(_mm256_load_si256(reinterpret_cast<const __m256i*>(buffer)));
+  if (n > 8) {
+    __m256i b = network_sort8<T>(_mm256_load_si256(reinterpret_cast<const __m256i*>(buffer + 8)));
+    // reversing b makes a|b bitonic, after min/max both halves are bitonic and lo <= hi
+    b = _mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    const __m256i lo = NetworkLanes<T>::min(a, b);
+    const __m256i hi = NetworkLanes<T>::max(a, b);
+    a = network_merge8<T>(lo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(buffer + 8), network_merge8<T>(hi));
+  }
+  _mm256_store_si256(reinterpret_cast<__m256i*>(buffer), a);
+  std::copy_n(buffer, n, arr);
+}
+#endif
+
+// sorts a partition below kPdqInsertionCutoff
+template <typename T, typename Compare>
+inline void pdq_small_sort(T* begin, T* end, Compare comp, bool leftmost) {
+#if defined(CX_AVX2)
+  if constexpr (kNetworkSortable<T, Compare>) {
+    if (end - begin <= kNetworkSortSize) {
+      network_sort(begin, end - begin);
+      if constexpr (std::is_same_v<Compare, std::greater<T>>) {
+        std::reverse(begin, end);
+      }
+      return;
+    }
+  }
+#endif
+  if (leftmost) {
+    insertion_sort(begin, end, comp);
+  } else {
+    unguarded_insertion_sort(begin, end, comp);
+  }
+}
+// partitions [begin, end) - returns nullptr if the range got sorted on the way
+template <typename T, typename Compare>
+inline T* pdq_partition(T*& begin, T* end, Compare comp, int& bad_allowed, bool leftmost) {
+  pdq_choose_pivot(begin, end, comp);
+  // the element before a right partition is its pivot, if it equals the new pivot all elements equal to it
+  // go left and are done
+  if (!leftmost && !comp(*(begin - 1), *begin)) {
+    begin = partition_left(begin, end, comp) + 1;
+    return begin - 1;
+  }
+  const std::ptrdiff_t size = end - begin;
+  const auto [pivot_pos, already_partitioned] = kBranchlessSort<T, Compare>
+                                                    ? partition_right_branchless(begin, end, comp)
+                                                    : partition_right(begin, end, comp);
+  const std::ptrdiff_t l_size = pivot_pos - begin;
+  const std::ptrdiff_t r_size = end - (pivot_pos + 1);
+  if (l_size < size / 8 || r_size < size / 8) {
+    // too many bad pivots - heapsort guarantees O(n log n)
+    if (--bad_allowed == 0) {
+      heap_sort(begin, end, comp);
+      return nullptr;
+    }
+    pdq_break_patterns(begin, pivot_pos, end);
+  } else if (already_partitioned && partial_insertion_sort(begin, pivot_pos, comp) &&
+             partial_insertion_sort(pivot_pos + 1, end, comp)) {
+    return nullptr;  // (nearly) sorted input finishes in O(n)
+  }
+  return pivot_pos;
+}
+template <typename T, typename Compare>
+void pdq_loop(T* begin, T* end, Compare comp, int bad_allowed, bool leftmost = true) {
+  while (true) {
+    if (end - begin < kPdqInsertionCutoff) {
+      pdq_small_sort(begin, end, comp, leftmost);
+      return;
+    }
+    T* const first = begin;
+    T* pivot_pos = pdq_partition(begin, end, comp, bad_allowed, leftmost);
+    if (pivot_pos == nullptr) {
+      return;
+    }
+    if (begin != first) {
+      continue;  // partition_left() - only the right side is left
+    }
+    // recurse into the left side, loop on the right
+    pdq_loop(begin, pivot_pos, comp, bad_allowed, leftmost);
+    begin = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+template <typename T, typename Compare>
+void pdq_parallel(T* begin, T* end, Compare comp, int bad_allowed, bool leftmost,
+                  cxstructs::ThreadPool& pool) {
+  while (end - begin > kParallelSortCutoff) {
+    T* const first = begin;
+    T* pivot_pos = pdq_partition(begin, end, comp, bad_allowed, leftmost);
+    if (pivot_pos == nullptr) {
+      return;
+    }
+    if (begin != first) {
+      continue;
+    }
+    // both sides are independent - the right one only reads its pivot which the left one doesnt touch
+    pool.parallel_for(0, 2, [&](uint_32_cx side_begin, uint_32_cx side_end) {
+      for (uint_32_cx side = side_begin; side < side_end; side++) {
+        if (side == 0) {
+          pdq_parallel(begin, pivot_pos, comp, bad_allowed, leftmost, pool);
+        } else {
+          pdq_parallel(pivot_pos + 1, end, comp, bad_allowed, false, pool);
+        }
+      }
+    });
+    return;
+  }
+  pdq_loop(begin, end, comp, bad_allowed, leftmost);
+}
+// floor(log2(n)) bad partitions are allowed before falling back to heapsort
+inline int pdq_bad_allowed(uint_32_cx len) noexcept {
+  int log = 0;
+  while (len >>= 1) {
+    log++;
+  }
+  return log;
+}
+
+// radix sort - 8 bit digits, keys are mapped to unsigned integers with the same order
+constexpr size_t kRadixBuckets = 256;
+// below this many elements the radix sorts use insertion sort (stable as well)
+constexpr size_t kRadixInsertionCutoff = 64;
+// parallel histogram and scatter only pay off with enough elements per thread
+constexpr size_t kRadixParallelMin = 1 << 16;
+
+template <size_t Bytes>
+struct radix_unsigned;
+template <>
+struct radix_unsigned<1> {
+  using type = uint8_t;
+};
+template <>
+struct radix_unsigned<2> {
+  using type = uint16_t;
+};
+template <>
+struct radix_unsigned<4> {
+  using type = uint32_t;
+};
+template <>
+struct radix_unsigned<8> {
+  using type = uint64_t;
+};
+/**
+ * Maps an arithmetic key to an unsigned integer with the same order:
+ * signed integers flip the sign bit, floats flip the sign bit if positive and all bits if negative
+ */
+template <typename K>
+inline auto radix_key(K key) noexcept {
+  static_assert(std::is_arithmetic_v<K>, "radix keys have to be arithmetic");
+  using U = typename radix_unsigned<sizeof(K)>::type;
+  constexpr U kSign = U(1) << (sizeof(K) * 8 - 1);
+  if constexpr (std::is_same_v<K, bool>) {
+    return static_cast<uint8_t>(key);
+  } else if constexpr (std::is_floating_point_v<K>) {
+    U bits;
+    std::memcpy(&bits, &key, sizeof(K));
+    return static_cast<U>(bits ^ ((bits & kSign) ? static_cast<U>(~U(0)) : kSign));
+  } else if constexpr (std::is_signed_v<K>) {
+    return static_cast<U>(static_cast<U>(key) ^ kSign);
+  } else {
+    return static_cast<U>(key);
+  }
+}
+// used when there are no values to carry along
+struct RadixNoValues {};
+
+// stable LSD radix sort of arr (and values) by keyOf, one pass per key byte.
+// All byte histograms come from a single read, passes where every element has the same byte are skipped.
+// With chunks > 1 every chunk counts and scatters its own range - chunk c writes behind chunks 0..c-1
+// of the same bucket so the sort stays stable
+template <typename T, typename V, typename KeyOf>
+void lsd_radix_sort(T* arr, V* values, size_t len, KeyOf keyOf, uint_32_cx threads) {
+  using Key = decltype(keyOf(arr[0]));
+  constexpr size_t kPasses = sizeof(Key);
+  constexpr bool kHasValues = !std::is_same_v<V, RadixNoValues>;
+  auto digit = [&keyOf](const T& e, size_t pass) {
+    return static_cast<size_t>((keyOf(e) >> (pass * 8)) & 0xFF);
+  };
+  if (len <= kRadixInsertionCutoff) {
+    // stable insertion sort on the keys, values follow
+    for (size_t i = 1; i < len; i++) {
+      T e = std::move(arr[i]);
+      const Key key = keyOf(e);
+      size_t j = i;
+      if constexpr (kHasValues) {
+        V v = std::move(values[i]);
+        for (; j > 0 && key < keyOf(arr[j - 1]); j--) {
+          arr[j] = std::move(arr[j - 1]);
+          values[j] = std::move(values[j - 1]);
+        }
+        values[j] = std::move(v);
+      } else {
+        for (; j > 0 && key < keyOf(arr[j - 1]); j--) {
+          arr[j] = std::move(arr[j - 1]);
+        }
+      }
+      arr[j] = std::move(e);
+    }
+    return;
+  }
+  const size_t chunks = threads <= 1 || len < kRadixParallelMin
+                            ? 1
+                            : std::min<size_t>(threads, len / (kRadixParallelMin / 4));
+  const size_t per = (len + chunks - 1) / chunks;
+  auto parallel = [&](auto&& func) {
+    if (chunks == 1) {
+      func(0);
+    } else {
+      cxstructs::ThreadPool::global().parallel_for(0, chunks, [&](uint_32_cx begin, uint_32_cx end) {
+        for (uint_32_cx c = begin; c < end; c++) {
+          func(c);
+        }
+      });
+    }
+  };
+
+  // one histogram per chunk and pass, the totals decide which passes can be skipped
+  std::vector<size_t> counts(chunks * kPasses * kRadixBuckets, 0);
+  parallel([&](size_t c) {
+    size_t* count = counts.data() + c * kPasses * kRadixBuckets;
+    for (size_t i = c * per; i < std::min(len, (c + 1) * per); i++) {
+      const Key key = keyOf(arr[i]);
+      for (size_t pass = 0; pass < kPasses; pass++) {
+        count[pass * kRadixBuckets + ((key >> (pass * 8)) & 0xFF)]++;
+      }
+    }
+  });
+
+  // default initialized - no need to zero memory that is overwritten by the first pass
+  std::unique_ptr<T[]> buffer(new T[len]);
+  std::unique_ptr<std::conditional_t<kHasValues, V, char>[]> value_buffer;
+  if constexpr (kHasValues) {
+    value_buffer.reset(new V[len]);
+  }
+  T* from = arr;
+  T* to = buffer.get();
+  auto* from_values = values;
+  auto* to_values = value_buffer.get();
+  std::vector<size_t> offsets(chunks * kRadixBuckets);
+  for (size_t pass = 0; pass < kPasses; pass++) {
+    // a pass only matters if the byte differs
+    bool trivial = false;
+    for (size_t b = 0; b < kRadixBuckets && !trivial; b++) {
+      size_t total = 0;
+      for (size_t c = 0; c < chunks; c++) {
+        total += counts[(c * kPasses + pass) * kRadixBuckets + b];
+      }
+      trivial = total == len;
+    }
+    if (trivial) {
+      continue;
+    }
+    if (pass > 0 && chunks > 1) {
+      // the chunks now hold other elements than in the first count
+      parallel([&](size_t c) {
+        size_t* count = counts.data() + (c * kPasses + pass) * kRadixBuckets;
+        std::fill_n(count, kRadixBuckets, 0);
+        for (size_t i = c * per; i < std::min(len, (c + 1) * per); i++) {
+          count[digit(from[i], pass)]++;
+        }
+      });
+    }
+    size_t sum = 0;
+    for (size_t b = 0; b < kRadixBuckets; b++) {
+      for (size_t c = 0; c < chunks; c++) {
+        offsets[c * kRadixBuckets + b] = sum;
+        sum += counts[(c * kPasses + pass) * kRadixBuckets + b];
+      }
+    }
+    parallel([&](size_t c) {
+      size_t* offset = offsets.data() + c * kRadixBuckets;
+      for (size_t i = c * per; i < std::min(len, (c + 1) * per); i++) {
+        const size_t target = offset[digit(from[i], pass)]++;
+        to[target] = std::move(from[i]);
+        if constexpr (kHasValues) {
+          to_values[target] = std::move(from_values[i]);
+        }
+      }
+    });
+    std::swap(from, to);
+    if constexpr (kHasValues) {
+      std::swap(from_values, to_values);
+    }
+  }
+  if (from != arr) {
+    std::move(from, from + len, arr);
+    if constexpr (kHasValues) {
+      std::move(from_values, from_values + len, values);
+    }
+  }
+}
+
+// the byte of s at depth - strings ending before it go to bucket 0
+template <typename S>
+inline size_t msd_bucket(const S& s, size_t depth) noexcept {
+  return depth < s.size() ? static_cast<unsigned char>(s[depth]) + 1 : 0;
+}
+// MSD radix sort of strings sharing their first depth bytes - buffer has room for len strings
+template <typename S>
+void msd_radix_sort(S* arr, S* buffer, size_t len, size_t depth, uint_32_cx threads) {
+  while (len > kRadixInsertionCutoff) {
+    size_t count[kRadixBuckets + 3] = {};
+    for (size_t i = 0; i < len; i++) {
+      count[msd_bucket(arr[i], depth) + 2]++;
+    }
+    // count[b + 1] becomes the start of bucket b
+    for (size_t b = 2; b < kRadixBuckets + 3; b++) {
+      count[b] += count[b - 1];
+    }
+    for (size_t i = 0; i < len; i++) {
+      buffer[count[msd_bucket(arr[i], depth) + 1]++] = std::move(arr[i]);
+    }
+    std::move(buffer, buffer + len, arr);
+    // count[b] is now the start of bucket b, bucket 0 (ended strings) is done
+    if (threads > 1 && len >= kRadixParallelMin) {
+      cxstructs::ThreadPool::global().parallel_for(1, kRadixBuckets + 1, [&](uint_32_cx begin, uint_32_cx end) {
+        for (uint_32_cx b = begin; b < end; b++) {
+          msd_radix_sort(arr + count[b], buffer + count[b], count[b + 1] - count[b], depth + 1, 1);
+        }
+      });
+      return;
+    }
+    // recurse into all buckets but the largest, loop on that one
+    size_t largest = 1;
+    for (size_t b = 2; b <= kRadixBuckets; b++) {
+      if (count[b + 1] - count[b] > count[largest + 1] - count[largest]) {
+        largest = b;
+      }
+    }
+    for (size_t b = 1; b <= kRadixBuckets; b++) {
+      if (b != largest && count[b + 1] - count[b] > 1) {
+        msd_radix_sort(arr + count[b], buffer + count[b], count[b + 1] - count[b], depth + 1, 1);
+      }
+    }
+    arr += count[largest];
+    buffer += count[largest];
+    len = count[largest + 1] - count[largest];
+    depth++;
+  }
+  // the first depth bytes are equal - compare the rest
+  insertion_sort(arr, arr + len, [depth](const S& a, const S& b) {
+    return std::string_view(a).substr(std::min(depth, a.size())) <
+           std::string_view(b).substr(std::min(depth, b.size()));
+  });
+}
+template <typename S>
+constexpr bool kRadixString = std::is_same_v<S, std::string> || std::is_same_v<S, std::string_view>;
 }  // namespace cxhelper
 
 namespace cxstructs {
@@ -263,8 +990,25 @@ template <typename T, typename Comparator,
 void quick_sort_comparator(T* arr, uint_32_cx len, Comparator comp) {
   cxhelper::quick_sort_internal_comparator(arr, 0, len - 1, comp);
 }
+/**
+ * <h2>Insertion sort</h2> moves each element to the left until the one before it is smaller.
+ * Very fast for small or nearly sorted arrays, which is why pdq_sort finishes its small partitions with it.
+ * <p> Best: O(n) <p> Average: O(n^2) <p> Worst: O(n^2)
+ * @tparam T type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param ascending false to sort descending
+ * @return arr
+ */
 template <typename T>
-T* insertionSort(T* arr, uint_32_cx len, bool ascending) {}
+T* insertionSort(T* arr, uint_32_cx len, bool ascending = true) {
+  if (ascending) {
+    cxhelper::insertion_sort(arr, arr + len, std::less<T>());
+  } else {
+    cxhelper::insertion_sort(arr, arr + len, std::greater<T>());
+  }
+  return arr;
+}
 /**
  * <h2>Merge sort</h2> has the best possible O notation runtime for all cases but in
  * practice is often slower than for example quicksort. It works by dividing the
@@ -283,9 +1027,206 @@ void merge_sort(T* arr, uint_32_cx len, bool ascending = true) {
   }
 }
 
+/**
+ * <h2>Heap sort</h2> builds a max heap in place and repeatedly moves its top to the end.
+ * Slower than quicksort in practice but never worse than O(n log n), pdq_sort falls back to it.
+ * <p> Best: O(n log n) <p> Average: O(n log n) <p> Worst: O(n log n)
+ * @tparam T type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param ascending false to sort descending
+ */
 template <typename T>
-void heapSort(T* arr, uint_32_cx len, bool ascending) {}
-
+void heapSort(T* arr, uint_32_cx len, bool ascending = true) {
+  if (ascending) {
+    cxhelper::heap_sort(arr, arr + len, std::less<T>());
+  } else {
+    cxhelper::heap_sort(arr, arr + len, std::greater<T>());
+  }
+}
+/**
+ * <h2>Radix sort</h2> sorts numbers by their bytes instead of comparing them. Each of the sizeof(T) passes
+ * counts the elements per byte value and moves them into their bucket - least significant byte first (LSD).
+ * <p>
+ * Signed integers and floats are mapped to unsigned integers with the same order (float bit-flipping),
+ * so negative values and -0.0 < 0.0 sort correctly. Passes where all elements share the byte are skipped.
+ * Needs a buffer of len elements. The sort is stable.<p>
+ * With threads > 1 each pass counts and scatters in parallel on the global ThreadPool.<p>
+ * Best: O(n * sizeof(T))<p>
+ * Average: O(n * sizeof(T))<p>
+ * Worst: O(n * sizeof(T))<p>
+ * @tparam T arithmetic type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param ascending false to sort descending
+ * @param threads number of threads for the counting and scattering
+ */
+template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+void radix_sort(T* arr, uint_32_cx len, bool ascending = true, uint_32_cx threads = 1) {
+  cxhelper::RadixNoValues* no_values = nullptr;
+  if (ascending) {
+    cxhelper::lsd_radix_sort(arr, no_values, len, [](T e) { return cxhelper::radix_key(e); }, threads);
+  } else {
+    cxhelper::lsd_radix_sort(
+        arr, no_values, len, [](T e) { return static_cast<decltype(cxhelper::radix_key(e))>(~cxhelper::radix_key(e)); },
+        threads);
+  }
+}
+/**
+ * Stable radix_sort() of any type by an arithmetic key
+ * <pre>radix_sort(rows, n, [](const Row& r) { return r.price; });</pre>
+ * @tparam T type
+ * @tparam KeyOf callable taking a const T& and returning an arithmetic key
+ * @param arr array to sort
+ * @param len length of the array
+ * @param key the key extractor - called a few times per element and pass, keep it cheap
+ * @param ascending false to sort descending
+ * @param threads number of threads for the counting and scattering
+ */
+template <typename T, typename KeyOf,
+          std::enable_if_t<std::is_arithmetic_v<std::invoke_result_t<KeyOf, const T&>>, int> = 0>
+void radix_sort(T* arr, uint_32_cx len, KeyOf key, bool ascending = true, uint_32_cx threads = 1) {
+  cxhelper::RadixNoValues* no_values = nullptr;
+  if (ascending) {
+    cxhelper::lsd_radix_sort(arr, no_values, len, [&key](const T& e) { return cxhelper::radix_key(key(e)); },
+                             threads);
+  } else {
+    cxhelper::lsd_radix_sort(
+        arr, no_values, len,
+        [&key](const T& e) { return static_cast<decltype(cxhelper::radix_key(key(e)))>(~cxhelper::radix_key(key(e))); },
+        threads);
+  }
+}
+/**
+ * Stable radix_sort() of key-value pairs in separate arrays - values[i] moves with keys[i]
+ * @tparam K arithmetic key type
+ * @tparam V value type
+ * @param keys the keys to sort by
+ * @param values one value per key
+ * @param len number of pairs
+ * @param ascending false to sort descending
+ * @param threads number of threads for the counting and scattering
+ */
+template <typename K, typename V, std::enable_if_t<std::is_arithmetic_v<K>, int> = 0>
+void radix_sort(K* keys, V* values, uint_32_cx len, bool ascending = true, uint_32_cx threads = 1) {
+  if (ascending) {
+    cxhelper::lsd_radix_sort(keys, values, len, [](K e) { return cxhelper::radix_key(e); }, threads);
+  } else {
+    cxhelper::lsd_radix_sort(
+        keys, values, len, [](K e) { return static_cast<decltype(cxhelper::radix_key(e))>(~cxhelper::radix_key(e)); },
+        threads);
+  }
+}
+/**
+ * MSD radix sort for std::string and std::string_view - sorts by the first byte, then every bucket by the
+ * next one. Only the bytes up to the first difference are looked at, buckets below 64 strings are insertion
+ * sorted. The order is the same as operator< (bytes compared as unsigned char).<p>
+ * With threads > 1 the buckets of large ranges are sorted in parallel on the global ThreadPool.<p>
+ * Average: O(n * common prefix length)
+ * @tparam S std::string or std::string_view
+ * @param arr array to sort
+ * @param len length of the array
+ * @param threads number of threads
+ */
+template <typename S, std::enable_if_t<cxhelper::kRadixString<S>, int> = 0>
+void radix_sort(S* arr, uint_32_cx len, uint_32_cx threads = 1) {
+  std::vector<S> buffer(len);
+  cxhelper::msd_radix_sort(arr, buffer.data(), len, 0, threads);
+}
+/**
+ * <h2>Pattern-defeating quicksort</h2> (pdqsort) is the production sort of the library - vec::sort() uses it.
+ * <p>
+ * It's an introsort: a quicksort with a median of 3 (ninther for large ranges) pivot that finishes small
+ * partitions with insertion sort and switches to heapsort after too many unbalanced partitions.
+ * On top it detects patterns: already partitioned ranges are checked with a bounded insertion sort, so sorted and
+ * reverse sorted input finishes in O(n), and ranges with many equal elements are partitioned in O(n).
+ * <p>
+ * For arithmetic types with std::less / std::greater the partition classifies blocks of elements without branches.
+ * With AVX2 partitions of up to 16 int32, uint32 or float elements are sorted with a sorting network.
+ * The sort is unstable.<p>
+ * Best: O(n)<p>
+ * Average: O(n log n)<p>
+ * Worst: O(n log n)<p>
+ * @tparam T type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param comp strict weak ordering like std::less - comp(a, b) is true if a goes before b
+ */
+template <typename T, typename Comparator,
+          typename = std::enable_if_t<std::is_invocable_r_v<bool, Comparator, T, T>>>
+void pdq_sort(T* arr, uint_32_cx len, Comparator comp) {
+  if (len > 1) {
+    cxhelper::pdq_loop(arr, arr + len, comp, cxhelper::pdq_bad_allowed(len));
+  }
+}
+/**
+ * Sorts the array with pdq_sort() in the given direction
+ * @tparam T type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param ascending false to sort descending
+ */
+template <typename T>
+void pdq_sort(T* arr, uint_32_cx len, bool ascending = true) {
+  if (ascending) {
+    pdq_sort(arr, len, std::less<T>());
+  } else {
+    pdq_sort(arr, len, std::greater<T>());
+  }
+}
+/**
+ * pdq_sort() that sorts both sides of every large partition in parallel on the given ThreadPool.<p>
+ * The first partitions run on the calling thread, below 32768 elements a side is sorted with pdq_sort().
+ * The comparator is called concurrently on disjoint elements.
+ * @tparam T type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param comp strict weak ordering like std::less
+ * @param pool the pool to run on - the library wide one by default
+ */
+template <typename T, typename Comparator,
+          typename = std::enable_if_t<std::is_invocable_r_v<bool, Comparator, T, T>>>
+void parallel_sort(T* arr, uint_32_cx len, Comparator comp,
+                   ThreadPool& pool = ThreadPool::global()) {
+  if (len > 1) {
+    cxhelper::pdq_parallel(arr, arr + len, comp, cxhelper::pdq_bad_allowed(len), true, pool);
+  }
+}
+/**
+ * Sorts the array with parallel_sort() in the given direction
+ * @tparam T type
+ * @param arr array to sort
+ * @param len length of the array
+ * @param ascending false to sort descending
+ * @param pool the pool to run on - the library wide one by default
+ */
+template <typename T>
+void parallel_sort(T* arr, uint_32_cx len, bool ascending = true,
+                   ThreadPool& pool = ThreadPool::global()) {
+  if (ascending) {
+    parallel_sort(arr, len, std::less<T>(), pool);
+  } else {
+    parallel_sort(arr, len, std::greater<T>(), pool);
+  }
+}
+#if defined(CX_KERNEL_DECL)
+// instantiated once in the cxstructs_kernels library
+extern template void pdq_sort<int>(int*, uint_32_cx, bool);
+extern template void pdq_sort<uint32_t>(uint32_t*, uint_32_cx, bool);
+extern template void pdq_sort<int64_t>(int64_t*, uint_32_cx, bool);
+extern template void pdq_sort<float>(float*, uint_32_cx, bool);
+extern template void pdq_sort<double>(double*, uint_32_cx, bool);
+extern template void parallel_sort<int>(int*, uint_32_cx, bool, ThreadPool&);
+extern template void parallel_sort<uint32_t>(uint32_t*, uint_32_cx, bool, ThreadPool&);
+extern template void parallel_sort<int64_t>(int64_t*, uint_32_cx, bool, ThreadPool&);
+extern template void parallel_sort<float>(float*, uint_32_cx, bool, ThreadPool&);
+extern template void parallel_sort<double>(double*, uint_32_cx, bool, ThreadPool&);
+extern template void radix_sort<int, 0>(int*, uint_32_cx, bool, uint_32_cx);
+extern template void radix_sort<uint32_t, 0>(uint32_t*, uint_32_cx, bool, uint_32_cx);
+extern template void radix_sort<int64_t, 0>(int64_t*, uint_32_cx, bool, uint_32_cx);
+extern template void radix_sort<float, 0>(float*, uint_32_cx, bool, uint_32_cx);
+extern template void radix_sort<double, 0>(double*, uint_32_cx, bool, uint_32_cx);
+#endif
 }  // namespace cxstructs
 #ifndef CX_DELETE_TESTS
 namespace cxtests {
@@ -328,6 +1269,151 @@ static void TEST_SORTING() {
   merge_sort(merge_vec.data(), SIZE);
   CX_ASSERT_sorted(merge_vec);
 
+  std::cout << "TESTING INSERTION SORT AND HEAP SORT" << std::endl;
+  std::vector<int> insertion_vec = generate_shuffled_vector(2000);
+  insertionSort(insertion_vec.data(), insertion_vec.size());
+  CX_ASSERT_sorted(insertion_vec);
+  std::vector<int> heap_vec = generate_shuffled_vector(SIZE);
+  heapSort(heap_vec.data(), SIZE, false);
+  CX_ASSERT_sorted(heap_vec, false);
+
+  std::cout << "TESTING PDQ SORT" << std::endl;
+  std::mt19937 gen{std::random_device{}()};
+  // patterns that break naive quicksorts
+  for (int size : {0, 1, 2, 7, 16, 23, 24, 100, 1000, 100000}) {
+    std::vector<std::vector<int>> inputs(6, std::vector<int>(size));
+    for (int i = 0; i < size; i++) {
+      inputs[0][i] = static_cast<int>(gen() % 1000000) - 500000;  // random
+      inputs[1][i] = i;                                              // sorted
+      inputs[2][i] = size - i;                                       // reverse
+      inputs[3][i] = 7;                                              // all equal
+      inputs[4][i] = i < size / 2 ? i : size - i;                    // organ pipe
+      inputs[5][i] = static_cast<int>(gen() % 4);                    // few distinct
+    }
+    for (auto& input : inputs) {
+      std::vector<int> expected = input;
+      std::sort(expected.begin(), expected.end());
+      std::vector<int> ascending = input;
+      pdq_sort(ascending.data(), size);
+      CX_ASSERT(ascending == expected, "");
+      std::vector<int> descending = input;
+      pdq_sort(descending.data(), size, false);
+      CX_ASSERT(std::equal(descending.rbegin(), descending.rend(), expected.begin()), "");
+    }
+  }
+  // every small size hits the sorting network for these types
+  for (int size = 0; size <= 24; size++) {
+    std::vector<float> floats(size);
+    std::vector<uint32_t> uints(size);
+    for (int i = 0; i < size; i++) {
+      floats[i] = static_cast<float>(gen() % 1000) / 7.0F - 50;
+      uints[i] = static_cast<uint32_t>(gen());
+    }
+    std::vector<float> floats_expected = floats;
+    std::sort(floats_expected.begin(), floats_expected.end());
+    pdq_sort(floats.data(), size);
+    CX_ASSERT(floats == floats_expected, "");
+    std::vector<uint32_t> uints_expected = uints;
+    std::sort(uints_expected.begin(), uints_expected.end(), std::greater<>());
+    pdq_sort(uints.data(), size, false);
+    CX_ASSERT(uints == uints_expected, "");
+  }
+  std::vector<std::string> strings;
+  for (int i = 0; i < 5000; i++) {
+    strings.push_back(std::to_string(gen() % 1000));
+  }
+  std::vector<std::string> strings_expected = strings;
+  std::sort(strings_expected.begin(), strings_expected.end(),
+            [](const std::string& a, const std::string& b) { return a.size() < b.size() || (a.size() == b.size() && a < b); });
+  pdq_sort(strings.data(), strings.size(), [](const std::string& a, const std::string& b) {
+    return a.size() < b.size() || (a.size() == b.size() && a < b);
+  });
+  CX_ASSERT(strings == strings_expected, "");
+
+  std::cout << "TESTING PARALLEL SORT" << std::endl;
+  ThreadPool pool(3);
+  for (int pattern = 0; pattern < 3; pattern++) {
+    std::vector<int64_t> values(1000000);
+    for (size_t i = 0; i < values.size(); i++) {
+      values[i] = pattern == 0 ? static_cast<int64_t>(gen()) : pattern == 1 ? static_cast<int64_t>(i) : static_cast<int64_t>(gen() % 16);
+    }
+    std::vector<int64_t> expected = values;
+    std::sort(expected.begin(), expected.end());
+    parallel_sort(values.data(), values.size(), true, pool);
+    CX_ASSERT(values == expected, "");
+  }
+  std::vector<double> doubles(300000);
+  for (auto& d : doubles) {
+    d = static_cast<double>(gen()) / 3.0;
+  }
+  parallel_sort(doubles.data(), doubles.size(), [](double a, double b) { return a > b; });
+  CX_ASSERT(std::is_sorted(doubles.begin(), doubles.end(), std::greater<>()), "");
+
+  std::cout << "TESTING RADIX SORT" << std::endl;
+  for (uint_32_cx threads : {1, 3}) {
+    for (size_t size : {0, 1, 50, 1000, 300000}) {
+      std::vector<uint32_t> uints(size);
+      std::vector<int16_t> shorts(size);
+      std::vector<float> floats(size);
+      std::vector<double> doubles(size);
+      for (size_t i = 0; i < size; i++) {
+        uints[i] = static_cast<uint32_t>(gen()) >> (i % 3 * 8);
+        shorts[i] = static_cast<int16_t>(gen());
+        floats[i] = (static_cast<float>(gen() % 20000) - 10000) / 3.0F;
+        doubles[i] = i % 5 == 0 ? -std::numeric_limits<double>::infinity() : static_cast<double>(gen()) - 2e9;
+      }
+      auto check = [&](auto values, bool ascending) {
+        auto expected = values;
+        if (ascending) {
+          std::sort(expected.begin(), expected.end());
+        } else {
+          std::sort(expected.begin(), expected.end(), std::greater<>());
+        }
+        radix_sort(values.data(), values.size(), ascending, threads);
+        CX_ASSERT(values == expected, "");
+      };
+      for (bool ascending : {true, false}) {
+        check(uints, ascending);
+        check(shorts, ascending);
+        check(floats, ascending);
+        check(doubles, ascending);
+      }
+      // key-value pairs and key extractors keep equal keys in input order
+      std::vector<uint8_t> keys(size);
+      std::vector<uint32_t> values(size);
+      std::vector<std::pair<float, uint32_t>> rows(size);
+      for (size_t i = 0; i < size; i++) {
+        keys[i] = static_cast<uint8_t>(gen() % 7);
+        values[i] = static_cast<uint32_t>(i);
+        rows[i] = {floats[i] > 0 ? 1.5F : -2.0F, static_cast<uint32_t>(i)};
+      }
+      radix_sort(keys.data(), values.data(), size, false, threads);
+      radix_sort(rows.data(), size, [](const std::pair<float, uint32_t>& r) { return r.first; }, true, threads);
+      for (size_t i = 1; i < size; i++) {
+        CX_ASSERT(keys[i - 1] > keys[i] || (keys[i - 1] == keys[i] && values[i - 1] < values[i]), "");
+        CX_ASSERT(rows[i - 1].first < rows[i].first ||
+                      (rows[i - 1].first == rows[i].first && rows[i - 1].second < rows[i].second),
+                  "");
+      }
+    }
+    std::vector<std::string> words;
+    for (int i = 0; i < 200000; i++) {
+      std::string word = i % 3 == 0 ? "prefix/" : "";
+      for (uint32_t c = 0, len = gen() % 12; c < len; c++) {
+        word += static_cast<char>(gen() % 4 == 0 ? 200 + gen() % 50 : 'a' + gen() % 26);
+      }
+      words.push_back(word);
+    }
+    const std::vector<std::string> originals = words;
+    std::vector<std::string_view> views(originals.begin(), originals.end());
+    std::vector<std::string> words_expected = words;
+    std::sort(words_expected.begin(), words_expected.end());
+    radix_sort(words.data(), words.size(), threads);
+    radix_sort(views.data(), views.size(), threads);
+    CX_ASSERT(words == words_expected, "");
+    CX_ASSERT(std::equal(views.begin(), views.end(), words_expected.begin()), "");
+  }
+
   std::cout << "TESTING BOGO SORT" << std::endl;
   std::vector<int> bogo_vec = generate_shuffled_vector(10);
   bogo_sort(bogo_vec.data(), 10);
@@ -17,61 +17,407 @@
 // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
-#define F
+#define CX_FINISHED
 #ifndef CXSTRUCTS_SRC_CXALGOS_STATISTIC_H_
 #define CXSTRUCTS_SRC_CXALGOS_STATISTIC_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
 #include "../cxconfig.h"
 #include "Sorting.h"
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <random>
+#endif
+
+// Exact quantiles use selection (introselect) instead of sorting - O(n) for one quantile,
+// O(n log k) for k quantiles as every selection splits the range for the ones left and right of it
+// TDigest is a mergeable sketch for streams too large to keep, most accurate at the tails (p99, p999)
+
+namespace cxhelper {
+// selects the ranks [first, last) (ascending) into their sorted position within arr[lo, hi)
+template <typename T>
+void multi_select(T* arr, uint_32_cx lo, uint_32_cx hi, const uint_32_cx* first, const uint_32_cx* last) {
+  while (first != last) {
+    const uint_32_cx* mid = first + (last - first) / 2;
+    std::nth_element(arr + lo, arr + *mid, arr + hi);
+    // ranks left of the selected one recurse, the ones right of it continue in this loop
+    multi_select(arr, lo, *mid, first, mid);
+    lo = *mid + 1;
+    first = mid + 1;
+    while (first != last && *first < lo) {
+      first++;  // duplicate ranks
+    }
+  }
+}
+// nearest rank - the smallest value with at least q of the data at or below it
+inline uint_32_cx quantile_rank(double quantile, uint_32_cx len) noexcept {
+  const double rank = std::ceil(quantile * static_cast<double>(len)) - 1.0;
+  return static_cast<uint_32_cx>(std::clamp(rank, 0.0, static_cast<double>(len - 1)));
+}
+}  // namespace cxhelper
 
 namespace cxstructs {
 /**
- * Returns the closest array value corresponding to the given quantile.
- * Copies the given array internally
- * @tparam T
- * @param quantile
- * @param arr
- * @param len
- * @return
+ * Computes several quantiles (nearest rank) in one go by selection - <b>reorders the array</b>
+ * @param arr the data, partially reordered afterwards
+ * @param len number of elements
+ * @param quantiles the wanted quantiles in [0, 1], any order
+ * @param count number of quantiles
+ * @param out one value per quantile in the same order
+ */
+template <typename T>
+void quantiles_inplace(T* arr, uint_32_cx len, const double* quantiles, uint_32_cx count, T* out) {
+  if (len == 0) {
+    throw std::invalid_argument("Array length must be positive");
+  }
+  std::vector<uint_32_cx> ranks(count);
+  for (uint_32_cx i = 0; i < count; i++) {
+    ranks[i] = cxhelper::quantile_rank(quantiles[i], len);
+  }
+  std::vector<uint_32_cx> sorted = ranks;
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  cxhelper::multi_select(arr, 0, len, sorted.data(), sorted.data() + sorted.size());
+  for (uint_32_cx i = 0; i < count; i++) {
+    out[i] = arr[ranks[i]];
+  }
+}
+/**
+ * Computes several quantiles (nearest rank) in one go by selection on a copy of the data
+ * @param arr the data, left untouched
+ * @param len number of elements
+ * @param quantiles the wanted quantiles in [0, 1], any order
+ * @param count number of quantiles
+ * @param out one value per quantile in the same order
  */
 template <typename T>
-inline T quantile_index(float quantile, const T* arr, int len) noexcept {
+void quantiles(const T* arr, uint_32_cx len, const double* quantiles, uint_32_cx count, T* out) {
+  std::vector<T> copy(arr, arr + len);
+  quantiles_inplace(copy.data(), len, quantiles, count, out);
+}
+/**
+ * Returns the closest array value corresponding to the given quantile (nearest rank).
+ * Copies the given array internally, selects instead of sorting
+ * @param quantile the quantile in [0, 1]
+ * @param arr the data
+ * @param len number of elements
+ * @return the value at the quantile
+ */
+template <typename T>
+inline T quantile_index(float quantile, const T* arr, int len) {
   if (len <= 0) {
     throw std::invalid_argument("Array length must be positive");
   }
-  auto cpyArr = new T[len];
-  memcpy_s(cpyArr, len, arr, len);
-  cxstructs::quick_sort(cpyArr, len);
-  float index = quantile * (float)len - 1;
+  const double q = quantile;
   T val;
-  if ((int)index - index < 0.000001) {
-    val = cpyArr[(int)index];
-  } else {
-    val = cpyArr[(int)index + 1];
-  }
-  delete[] cpyArr;
+  quantiles(arr, static_cast<uint_32_cx>(len), &q, 1, &val);
   return val;
 }
-
+/**
+ * Returns the n-th quartile interpolated between its two neighbouring values
+ * @param n the quartile - 1, 2 or 3
+ * @param arr the data
+ * @param len number of elements
+ */
 template <typename T>
-inline float quartile_nth(uint8_t n, const T* arr, int len) noexcept {
+inline float quartile_nth(uint8_t n, const T* arr, int len) {
   if (len <= 0) {
     throw std::invalid_argument("Array length must be positive");
   }
-  auto cpyArr = new T[len];
-  memcpy(cpyArr, arr,  len * sizeof(int));
-  cxstructs::selection_sort(cpyArr, len);
-
   float q = (len - 3) / 4.0F;
   q = n * q + n;
+  const auto upper = std::clamp(static_cast<int>(q), 0, len - 1);
+  const auto lower = std::max(upper - 1, 0);
 
-  T first = cpyArr[(int)q-1];
-  T second = cpyArr[(int)q ];
-
-  float factor = q - (int)q;
-  float val = first + (second - first) * factor;
+  std::vector<T> copy(arr, arr + len);
+  const uint_32_cx ranks[2] = {static_cast<uint_32_cx>(lower), static_cast<uint_32_cx>(upper)};
+  cxhelper::multi_select(copy.data(), 0, static_cast<uint_32_cx>(len), ranks, ranks + 2);
 
-  delete[] cpyArr;
-  return val;
+  const T first = copy[lower];
+  const T second = copy[upper];
+  const float factor = q - static_cast<float>(static_cast<int>(q));
+  return static_cast<float>(first) + static_cast<float>(second - first) * factor;
 }
+
+/**
+ * <h2>TDigest</h2>
+ * A streaming quantile sketch (merging t-digest) - add values one at a time, ask for any quantile at any time.
+ * <br><br>
+ * Values are buffered and periodically merged into a sorted list of centroids (mean, weight). The size of a
+ * centroid is bounded by a scale function that allows only tiny centroids near q=0 and q=1, so the tails
+ * (p99, p999) are far more accurate than the median. The memory stays at O(compression) no matter how many values.
+ * <br><br>
+ * Digests merge: give every thread its own digest and merge() them for the global view.
+ * <br><br>
+ * <b>Important:</b> Not thread safe - querying flushes the buffer.
+ */
+class TDigest {
+  struct Centroid {
+    double mean;
+    double weight;
+    bool operator<(const Centroid& o) const noexcept { return mean < o.mean; }
+  };
+  double compression_;
+  uint_32_cx buffer_cap_;
+  mutable std::vector<Centroid> centroids_;
+  mutable std::vector<Centroid> buffer_;
+  mutable double total_ = 0;
+  double min_ = std::numeric_limits<double>::infinity();
+  double max_ = -std::numeric_limits<double>::infinity();
+
+  // k1 scale function - centroids may span at most 1 in k
+  [[nodiscard]] inline double scale(double q) const noexcept {
+    return compression_ / (2.0 * std::numbers::pi) * std::asin(2.0 * std::clamp(q, 0.0, 1.0) - 1.0);
+  }
+  inline void flush() const {
+    if (buffer_.empty()) {
+      return;
+    }
+    for (const Centroid& c : buffer_) {
+      total_ += c.weight;
+    }
+    buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+    std::sort(buffer_.begin(), buffer_.end());
+    centroids_.clear();
+
+    double weight_before = 0;
+    double k_lower = scale(0);
+    Centroid current = buffer_[0];
+    for (size_t i = 1; i < buffer_.size(); i++) {
+      const Centroid& next = buffer_[i];
+      const double q = (weight_before + current.weight + next.weight) / total_;
+      if (scale(q) - k_lower <= 1.0) {
+        current.weight += next.weight;
+        current.mean += (next.mean - current.mean) * next.weight / current.weight;
+      } else {
+        weight_before += current.weight;
+        k_lower = scale(weight_before / total_);
+        centroids_.push_back(current);
+        current = next;
+      }
+    }
+    centroids_.push_back(current);
+    buffer_.clear();
+  }
+
+ public:
+  /**
+   * @param compression accuracy vs size - about compression / 2 centroids are kept, 100 - 500 is typical
+   */
+  explicit TDigest(double compression = 200)
+      : compression_(compression), buffer_cap_(static_cast<uint_32_cx>(compression * 5)) {
+    buffer_.reserve(buffer_cap_);
+  }
+  /**
+   * Adds a value (with a weight) to the digest
+   */
+  inline void add(double x, double weight = 1) {
+    if (std::isnan(x)) {
+      return;
+    }
+    buffer_.push_back({x, weight});
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+    if (buffer_.size() >= buffer_cap_) {
+      flush();
+    }
+  }
+  /**
+   * Merges the other digest into this one - the other stays unchanged
+   */
+  inline void merge(const TDigest& o) {
+    o.flush();
+    for (const Centroid& c : o.centroids_) {
+      buffer_.push_back(c);
+    }
+    min_ = std::min(min_, o.min_);
+    max_ = std::max(max_, o.max_);
+    flush();
+  }
+  /**
+   * @param q the quantile in [0, 1]
+   * @return the estimated value at the quantile, NaN if empty
+   */
+  [[nodiscard]] inline double quantile(double q) const {
+    flush();
+    if (centroids_.empty()) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (q <= 0) {
+      return min_;
+    }
+    if (q >= 1) {
+      return max_;
+    }
+    const auto& c = centroids_;
+    const size_t n = c.size();
+    if (n == 1) {
+      return c[0].mean;
+    }
+    const double index = q * total_;
+    // between the minimum and the center of the first centroid
+    if (index < c[0].weight / 2) {
+      if (c[0].weight == 1) {
+        return min_;
+      }
+      return min_ + (c[0].mean - min_) * index / (c[0].weight / 2);
+    }
+    double weight_so_far = c[0].weight / 2;
+    for (size_t i = 0; i + 1 < n; i++) {
+      const double dw = (c[i].weight + c[i + 1].weight) / 2;
+      if (weight_so_far + dw > index) {
+        // single values are exact, don't interpolate into them
+        double left = index - weight_so_far;
+        double right = weight_so_far + dw - index;
+        if (c[i].weight == 1 && left < 0.5) {
+          return c[i].mean;
+        }
+        if (c[i + 1].weight == 1 && right <= 0.5) {
+          return c[i + 1].mean;
+        }
+        return (c[i].mean * right + c[i + 1].mean * left) / dw;
+      }
+      weight_so_far += dw;
+    }
+    // between the center of the last centroid and the maximum
+    const Centroid& last = c[n - 1];
+    if (last.weight == 1) {
+      return max_;
+    }
+    const double z = index - (total_ - last.weight / 2);
+    return last.mean + (max_ - last.mean) * z / (last.weight / 2);
+  }
+  /**
+   * Evaluates several quantiles
+   * @param quantiles the wanted quantiles in [0, 1]
+   * @param count number of quantiles
+   * @param out one value per quantile
+   */
+  inline void quantiles(const double* qs, uint_32_cx count, double* out) const {
+    for (uint_32_cx i = 0; i < count; i++) {
+      out[i] = quantile(qs[i]);
+    }
+  }
+  /**
+   * @return the total weight added - the number of values for unit weights
+   */
+  [[nodiscard]] inline double count() const {
+    flush();
+    return total_;
+  }
+  [[nodiscard]] inline double min() const noexcept { return min_; }
+  [[nodiscard]] inline double max() const noexcept { return max_; }
+  /**
+   * @return number of centroids kept after flushing the buffer
+   */
+  [[nodiscard]] inline uint_32_cx centroid_count() const {
+    flush();
+    return static_cast<uint_32_cx>(centroids_.size());
+  }
+  inline void clear() noexcept {
+    centroids_.clear();
+    buffer_.clear();
+    total_ = 0;
+    min_ = std::numeric_limits<double>::infinity();
+    max_ = -std::numeric_limits<double>::infinity();
+  }
+};
+}  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+namespace cxtests {
+using namespace cxstructs;
+static void TEST_STATISTIC() {
+  std::cout << "TESTING STATISTIC" << std::endl;
+
+  std::cout << "  Testing exact quantiles..." << std::endl;
+  std::mt19937 gen(13);
+  std::vector<int> data(100001);
+  for (auto& val : data) {
+    val = static_cast<int>(gen() % 1000000);
+  }
+  std::vector<int> sorted = data;
+  std::sort(sorted.begin(), sorted.end());
+  const double qs[] = {0.999, 0.5, 0.0, 0.99, 1.0, 0.5, 0.25};
+  int out[7];
+  quantiles(data.data(), static_cast<uint_32_cx>(data.size()), qs, 7, out);
+  for (int i = 0; i < 7; i++) {
+    CX_ASSERT(out[i] == sorted[cxhelper::quantile_rank(qs[i], static_cast<uint_32_cx>(data.size()))], "");
+  }
+  CX_ASSERT(out[1] == sorted[50000] && out[2] == sorted[0] && out[4] == sorted[100000], "");
+  CX_ASSERT(quantile_index(0.5F, data.data(), static_cast<int>(data.size())) == sorted[50000], "");
+  CX_ASSERT(quantile_index(0.0F, data.data(), 1) == data[0], "");
+
+  std::vector<int> inplace = data;
+  quantiles_inplace(inplace.data(), static_cast<uint_32_cx>(inplace.size()), qs, 7, out);
+  CX_ASSERT(out[0] == sorted[99900] && out[3] == sorted[99000], "");
+
+  int quart[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  std::shuffle(quart, quart + 11, gen);
+  CX_ASSERT(quartile_nth(1, quart, 11) == 3.0F && quartile_nth(2, quart, 11) == 6.0F, "");
+  CX_ASSERT(quartile_nth(3, quart, 11) == 9.0F, "");
+  bool thrown = false;
+  try {
+    (void)quantile_index(0.5F, data.data(), 0);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  CX_ASSERT(thrown, "");
+
+  std::cout << "  Testing TDigest accuracy..." << std::endl;
+  const uint_32_cx n = 1000000;
+  std::vector<double> samples(n);
+  std::lognormal_distribution<double> latency(3.0, 1.0);
+  TDigest digest;
+  CX_ASSERT(std::isnan(digest.quantile(0.5)), "");
+  for (auto& sample : samples) {
+    sample = latency(gen);
+    digest.add(sample);
+  }
+  std::vector<double> sorted_samples = samples;
+  std::sort(sorted_samples.begin(), sorted_samples.end());
+  // error in rank - how far off the estimate is in the sorted data
+  auto rank_error = [&](double q, double estimate) {
+    const auto rank = std::lower_bound(sorted_samples.begin(), sorted_samples.end(), estimate) -
+                      sorted_samples.begin();
+    return std::abs(static_cast<double>(rank) / n - q);
+  };
+  CX_ASSERT(digest.count() == n && digest.centroid_count() < 400, "");
+  CX_ASSERT(rank_error(0.5, digest.quantile(0.5)) < 0.005, "");
+  CX_ASSERT(rank_error(0.99, digest.quantile(0.99)) < 0.001, "");
+  CX_ASSERT(rank_error(0.999, digest.quantile(0.999)) < 0.0002, "");
+  CX_ASSERT(digest.quantile(0) == sorted_samples[0] && digest.quantile(1) == sorted_samples[n - 1], "");
+
+  std::cout << "  Testing TDigest merge..." << std::endl;
+  TDigest parts[4];
+  for (uint_32_cx i = 0; i < n; i++) {
+    parts[i % 4].add(samples[i]);
+  }
+  TDigest merged;
+  for (const auto& part : parts) {
+    merged.merge(part);
+  }
+  CX_ASSERT(merged.count() == n && merged.min() == sorted_samples[0], "");
+  double estimates[3];
+  const double tails[] = {0.5, 0.99, 0.999};
+  merged.quantiles(tails, 3, estimates);
+  CX_ASSERT(rank_error(0.5, estimates[0]) < 0.005 && rank_error(0.99, estimates[1]) < 0.001, "");
+  CX_ASSERT(rank_error(0.999, estimates[2]) < 0.0002, "");
+
+  TDigest small;
+  for (int i = 1; i <= 10; i++) {
+    small.add(i);
+  }
+  CX_ASSERT(small.quantile(0.05) == 1 && small.quantile(0.5) >= 5 && small.quantile(0.5) <= 6, "");
+  small.clear();
+  CX_ASSERT(small.count() == 0 && std::isnan(small.quantile(0.5)), "");
 }
+}  // namespace cxtests
+#endif
 #endif  //CXSTRUCTS_SRC_CXALGOS_STATISTIC_H_
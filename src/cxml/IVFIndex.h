@@ -0,0 +1,419 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXML_IVFINDEX_H_
+#define CXSTRUCTS_SRC_CXML_IVFINDEX_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxstructs/TopK.h"
+#include "../cxstructs/mat.h"
+#include "../cxutil/cxdistance.h"
+#include "../cxutil/cxthreadpool.h"
+
+// Inverted file index (IVF-flat) for approximate nearest neighbour search over dense vectors
+// The vectors are clustered with spherical k-means, every cluster stores its vectors contiguously
+// A query only scans the nprobe clusters with the closest centroids - nprobe == lists() is an exact search
+
+namespace cxhelper {
+/**
+ * Scales the array to unit length - zero vectors stay zero
+ */
+inline void normalize(float* a, uint_32_cx n) noexcept {
+  const float norm = std::sqrt(dot_simd(a, a, n));
+  if (norm > 0) {
+    const float inv = 1.0F / norm;
+    for (uint_32_cx i = 0; i < n; i++) {
+      a[i] *= inv;
+    }
+  }
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+enum class Metric : uint8_t { DOT, COSINE };
+
+/**
+ * A search result: the row of the vector in the indexed matrix and its similarity to the query
+ */
+struct Neighbour {
+  uint32_t id_;
+  float score_;
+};
+
+/**
+ * <h2>IVFIndex</h2>
+ * Approximate nearest neighbour index over the rows of a matrix (inverted file with flat lists).
+ * <br><br>
+ * Building clusters the rows into lists() groups with spherical k-means. A query compares itself
+ * against all centroids and then scans only the vectors of the nprobe() closest clusters with a SIMD dot product.
+ * This trades a small loss in recall for a speed-up of roughly lists() / nprobe().
+ * <br><br>
+ * The index keeps its own contiguous copy of the vectors grouped by cluster (normalized for Metric::COSINE),
+ * so the source matrix can change or go out of scope afterwards. Searching is const and thread safe.
+ */
+class IVFIndex {
+  mat centroids_;                 // lists x dims, unit length
+  mat vectors_;                   // n x dims, ordered by list
+  std::vector<uint32_t> ids_;     // original row of each stored vector
+  std::vector<uint32_t> offsets_; // list l holds the rows [offsets_[l], offsets_[l + 1])
+  uint_32_cx dims_ = 0;
+  uint_32_cx nprobe_ = 1;
+  Metric metric_ = Metric::COSINE;
+
+  // every thread keeps its own scratch so batched queries dont allocate per query
+  struct Scratch {
+    std::vector<float> query_;
+    std::vector<uint32_t> probes_;
+    std::vector<float> scores_;  // scores of the list being scanned
+    TopK<uint32_t> top_;
+    std::vector<TopK<uint32_t>::Entry> sorted_;
+  };
+  static void assign(const mat_view& data, const mat& centroids, std::vector<uint32_t>& labels) {
+    constexpr uint_32_cx kChunk = 1024;  // bounds the temporary score matrix
+    mat scores;
+    for (uint_32_cx begin = 0; begin < data.n_rows(); begin += kChunk) {
+      const uint_32_cx rows = std::min(kChunk, data.n_rows() - begin);
+      scores.resize(rows, centroids.n_rows());
+      gemm(1.0F, data.block(begin, 0, rows, data.n_cols()), centroids, 0.0F, scores, false, true);
+      for (uint_32_cx r = 0; r < rows; r++) {
+        const float* row = scores.get_raw() + r * scores.n_cols();
+        labels[begin + r] = std::max_element(row, row + scores.n_cols()) - row;
+      }
+    }
+  }
+  void search(const float* query, const float* centroid_scores, uint_32_cx k, Scratch& scratch,
+              Neighbour* out) const {
+    const float* q = query;
+    if (metric_ == Metric::COSINE) {
+      scratch.query_.assign(query, query + dims_);
+      normalize(scratch.query_.data(), dims_);
+      q = scratch.query_.data();
+    }
+    const uint_32_cx lists = centroids_.n_rows();
+    const uint_32_cx probes = std::min(nprobe_, lists);
+    scratch.probes_.resize(lists);
+    for (uint32_t l = 0; l < lists; l++) {
+      scratch.probes_[l] = l;
+    }
+    if (probes < lists) {
+      std::nth_element(scratch.probes_.begin(), scratch.probes_.begin() + probes,
+                       scratch.probes_.end(), [centroid_scores](uint32_t a, uint32_t b) {
+                         return centroid_scores[a] > centroid_scores[b];
+                       });
+    }
+    // a whole list is scored first, then only the scores beating the current k-th best reach the heap
+    auto& top = scratch.top_;
+    top.reset(k);
+    for (uint_32_cx p = 0; p < probes; p++) {
+      const uint32_t list = scratch.probes_[p];
+      const uint32_t begin = offsets_[list], end = offsets_[list + 1];
+      scratch.scores_.resize(end - begin);
+      for (uint32_t i = begin; i < end; i++) {
+        const float* v = vectors_.get_raw() + static_cast<size_t>(i) * dims_;
+        if (i + 1 < end) {
+          CX_PREFETCH(v + dims_);
+        }
+        scratch.scores_[i - begin] = dot_simd(q, v, dims_);
+      }
+      top.push_n(scratch.scores_.data(), ids_.data() + begin, end - begin);
+    }
+    scratch.sorted_.resize(top.size());
+    const uint_32_cx found = top.sorted(scratch.sorted_.data());
+    for (uint_32_cx i = 0; i < found; i++) {
+      out[i] = {scratch.sorted_[i].value, scratch.sorted_[i].score};
+    }
+    std::fill(out + found, out + k, Neighbour{std::numeric_limits<uint32_t>::max(),
+                                              -std::numeric_limits<float>::infinity()});
+  }
+
+ public:
+  IVFIndex() = default;
+  /**
+   * Builds the index over the rows of data
+   * @param data one vector per row
+   * @param metric DOT for inner product and COSINE for cosine similarity
+   * @param lists number of clusters - 0 chooses about sqrt(rows)
+   * @param iterations k-means iterations
+   * @param seed seed for the centroid initialization
+   */
+  explicit IVFIndex(const mat_view& data, Metric metric = Metric::COSINE, uint_32_cx lists = 0,
+                    uint_32_cx iterations = 10, uint64_t seed = 42)
+      : dims_(data.n_cols()), metric_(metric) {
+    const uint_32_cx n = data.n_rows();
+    if (n == 0 || dims_ == 0) {
+      throw std::logic_error("cant index an empty matrix");
+    }
+    if (lists == 0) {
+      lists = static_cast<uint_32_cx>(std::sqrt(static_cast<double>(n)));
+    }
+    lists = std::clamp<uint_32_cx>(lists, 1, n);
+    nprobe_ = std::max<uint_32_cx>(1, lists / 16);
+
+    mat unit = data.to_mat();
+    for (uint_32_cx r = 0; r < n; r++) {
+      normalize(unit.get_raw() + r * dims_, dims_);
+    }
+
+    // spherical k-means on at most 64 points per list, picked without replacement
+    std::mt19937_64 rng(seed);
+    std::vector<uint32_t> order(n);
+    for (uint32_t i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    const uint_32_cx samples = std::min<uint_32_cx>(n, lists * 64);
+    mat train(samples, dims_);
+    for (uint_32_cx s = 0; s < samples; s++) {
+      std::copy_n(unit.get_raw() + static_cast<size_t>(order[s]) * dims_, dims_,
+                  train.get_raw() + s * dims_);
+    }
+    centroids_ = mat(lists, dims_);
+    std::copy_n(train.get_raw(), lists * dims_, centroids_.get_raw());
+
+    std::vector<uint32_t> labels(samples);
+    std::vector<uint32_t> counts(lists);
+    for (uint_32_cx it = 0; it < iterations; it++) {
+      assign(train, centroids_, labels);
+      centroids_.scale(0);
+      std::fill(counts.begin(), counts.end(), 0);
+      for (uint_32_cx s = 0; s < samples; s++) {
+        float* c = centroids_.get_raw() + labels[s] * dims_;
+        const float* v = train.get_raw() + s * dims_;
+        for (uint_32_cx d = 0; d < dims_; d++) {
+          c[d] += v[d];
+        }
+        counts[labels[s]]++;
+      }
+      for (uint_32_cx l = 0; l < lists; l++) {
+        float* c = centroids_.get_raw() + l * dims_;
+        if (counts[l] == 0) {  // restart empty clusters on a random sample
+          std::copy_n(train.get_raw() + (rng() % samples) * dims_, dims_, c);
+        }
+        normalize(c, dims_);
+      }
+    }
+
+    // counting sort of all rows into their lists
+    labels.resize(n);
+    assign(unit, centroids_, labels);
+    offsets_.assign(lists + 1, 0);
+    for (uint32_t label : labels) {
+      offsets_[label + 1]++;
+    }
+    for (uint_32_cx l = 0; l < lists; l++) {
+      offsets_[l + 1] += offsets_[l];
+    }
+    std::vector<uint32_t> fill(offsets_.begin(), offsets_.end() - 1);
+    const mat_view source = metric_ == Metric::COSINE ? mat_view(unit) : data;
+    vectors_ = mat(n, dims_);
+    ids_.resize(n);
+    for (uint32_t r = 0; r < n; r++) {
+      const uint32_t pos = fill[labels[r]]++;
+      ids_[pos] = r;
+      std::copy_n(source.data() + static_cast<size_t>(r) * source.stride(), dims_,
+                  vectors_.get_raw() + static_cast<size_t>(pos) * dims_);
+    }
+  }
+  /**
+   * Sets how many clusters each query scans - higher is more accurate and slower
+   * @param nprobe clusters per query, clamped to [1, lists()]
+   */
+  inline void set_nprobe(uint_32_cx nprobe) noexcept {
+    nprobe_ = std::clamp<uint_32_cx>(nprobe, 1, std::max<uint_32_cx>(1, lists()));
+  }
+  [[nodiscard]] inline uint_32_cx nprobe() const noexcept { return nprobe_; }
+  [[nodiscard]] inline uint_32_cx lists() const noexcept { return centroids_.n_rows(); }
+  [[nodiscard]] inline uint_32_cx dims() const noexcept { return dims_; }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return ids_.size(); }
+  [[nodiscard]] inline Metric metric() const noexcept { return metric_; }
+  /**
+   * Finds the k most similar indexed vectors
+   * @param query pointer to dims() floats
+   * @param k number of results
+   * @return up to k results ordered by descending score
+   */
+  [[nodiscard]] std::vector<Neighbour> most_similar(const float* query, uint_32_cx k) const {
+    std::vector<Neighbour> result(k);
+    if (k == 0 || size() == 0) {
+      return {};
+    }
+    std::vector<float> centroid_scores(lists());
+    for (uint_32_cx l = 0; l < lists(); l++) {
+      centroid_scores[l] = dot_simd(query, centroids_.get_raw() + l * dims_, dims_);
+    }
+    Scratch scratch;
+    search(query, centroid_scores.data(), k, scratch, result.data());
+    result.resize(std::min<uint_32_cx>(k, size()));
+    return result;
+  }
+  /**
+   * Answers one query per row of queries with a single matrix multiply against the centroids per chunk.<p>
+   * The results of query q are written to out[q * k, (q + 1) * k) in descending order.
+   * Missing results (k > size()) get the id UINT32_MAX and a score of -infinity
+   * @param queries one query per row with dims() columns
+   * @param k results per query
+   * @param out buffer of queries.n_rows() * k results
+   * @param threads with threads > 1 the queries are distributed over the global ThreadPool
+   */
+  void most_similar(const mat_view& queries, uint_32_cx k, Neighbour* out,
+                    uint_32_cx threads = 1) const {
+    if (queries.n_cols() != dims_) {
+      throw std::logic_error("query dimensions dont match the index");
+    }
+    if (k == 0 || queries.n_rows() == 0) {
+      return;
+    }
+    constexpr uint_32_cx kChunk = 64;
+    auto run = [&](uint_32_cx begin, uint_32_cx end) {
+      Scratch scratch;
+      mat centroid_scores;
+      for (uint_32_cx b = begin; b < end; b += kChunk) {
+        const uint_32_cx rows = std::min(kChunk, end - b);
+        centroid_scores.resize(rows, lists());
+        gemm(1.0F, queries.block(b, 0, rows, dims_), centroids_, 0.0F, centroid_scores, false,
+             true);
+        for (uint_32_cx r = 0; r < rows; r++) {
+          const uint_32_cx q = b + r;
+          const float* query = queries.data() + static_cast<size_t>(q) * queries.stride();
+          search(query, centroid_scores.get_raw() + r * lists(), k, scratch,
+                 out + static_cast<size_t>(q) * k);
+        }
+      }
+    };
+    if (threads <= 1) {
+      run(0, queries.n_rows());
+    } else {
+      ThreadPool::global().parallel_for(0, queries.n_rows(), run, kChunk);
+    }
+  }
+  /**
+   * @return the results of most_similar() for every query row, each ordered by descending score
+   */
+  [[nodiscard]] std::vector<std::vector<Neighbour>> most_similar(const mat_view& queries,
+                                                                 uint_32_cx k,
+                                                                 uint_32_cx threads = 1) const {
+    std::vector<Neighbour> flat(static_cast<size_t>(queries.n_rows()) * k);
+    most_similar(queries, k, flat.data(), threads);
+    std::vector<std::vector<Neighbour>> result(queries.n_rows());
+    const uint_32_cx found = std::min<uint_32_cx>(k, size());
+    for (uint_32_cx q = 0; q < queries.n_rows(); q++) {
+      result[q].assign(flat.begin() + q * k, flat.begin() + q * k + found);
+    }
+    return result;
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "IVF INDEX TESTS" << std::endl;
+    std::cout << "  Testing dot_simd..." << std::endl;
+    float a[37], b[37];
+    float expected = 0;
+    for (int i = 0; i < 37; i++) {
+      a[i] = static_cast<float>(i) * 0.5F;
+      b[i] = 1.0F - static_cast<float>(i) * 0.1F;
+      expected += a[i] * b[i];
+    }
+    CX_ASSERT(std::abs(dot_simd(a, b, 37) - expected) < 1e-3F, "");
+    CX_ASSERT(dot_simd(a, b, 0) == 0, "");
+
+    std::cout << "  Testing exact search..." << std::endl;
+    std::mt19937 gen(42);
+    std::normal_distribution<float> noise(0, 1);
+    const uint_32_cx n = 2000, dims = 24;
+    mat data(n, dims);
+    for (uint_32_cx i = 0; i < n * dims; i++) {
+      data.get_raw()[i] = noise(gen);
+    }
+    IVFIndex index(data, Metric::COSINE, 32);
+    CX_ASSERT(index.lists() == 32 && index.size() == n && index.dims() == dims, "");
+    index.set_nprobe(index.lists());
+    for (uint32_t row : {0U, 17U, 1999U}) {
+      auto result = index.most_similar(&data(row, 0), 5);
+      CX_ASSERT(result.size() == 5 && result[0].id_ == row, "");
+      CX_ASSERT(std::abs(result[0].score_ - 1.0F) < 1e-4F, "");
+      for (int i = 1; i < 5; i++) {
+        CX_ASSERT(result[i - 1].score_ >= result[i].score_, "");
+      }
+    }
+
+    std::cout << "  Testing recall of probed search..." << std::endl;
+    // clustered data, queries are noisy copies of the points
+    mat centers(40, dims);
+    for (uint_32_cx i = 0; i < 40 * dims; i++) {
+      centers.get_raw()[i] = noise(gen) * 4;
+    }
+    for (uint_32_cx r = 0; r < n; r++) {
+      for (uint_32_cx d = 0; d < dims; d++) {
+        data(r, d) = centers(r % 40, d) + noise(gen);
+      }
+    }
+    IVFIndex clustered(data, Metric::DOT, 40);
+    clustered.set_nprobe(4);
+    mat queries(200, dims);
+    for (uint_32_cx q = 0; q < 200; q++) {
+      for (uint_32_cx d = 0; d < dims; d++) {
+        queries(q, d) = data(q * 7, d) + noise(gen) * 0.1F;
+      }
+    }
+    IVFIndex exact = clustered;
+    exact.set_nprobe(exact.lists());
+    auto approx_result = clustered.most_similar(queries, 10, 2);
+    auto exact_result = exact.most_similar(queries, 10);
+    uint_32_cx hits = 0;
+    for (uint_32_cx q = 0; q < 200; q++) {
+      for (const auto& e : exact_result[q]) {
+        for (const auto& r : approx_result[q]) {
+          hits += r.id_ == e.id_;
+        }
+      }
+      // the batched path has to agree with the single query one
+      auto single = clustered.most_similar(&queries(q, 0), 10);
+      CX_ASSERT(single.size() == approx_result[q].size(), "");
+      for (uint_32_cx i = 0; i < single.size(); i++) {
+        CX_ASSERT(single[i].id_ == approx_result[q][i].id_, "");
+      }
+    }
+    CX_ASSERT(hits >= 200 * 10 * 9 / 10, "recall below 90%");
+
+    std::cout << "  Testing edge cases..." << std::endl;
+    mat tiny(3, 4);
+    tiny(0, 0) = 1;
+    tiny(1, 1) = 1;
+    tiny(2, 0) = 1;
+    tiny(2, 1) = 1;
+    IVFIndex small(tiny, Metric::COSINE);
+    auto few = small.most_similar(&tiny(0, 0), 10);
+    CX_ASSERT(few.size() == 3 && few[0].id_ == 0 && few[1].id_ == 2, "");
+    Neighbour padded[5];
+    small.most_similar(tiny.block(0, 0, 1, 4), 5, padded);
+    CX_ASSERT(padded[3].id_ == std::numeric_limits<uint32_t>::max(), "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXML_IVFINDEX_H_
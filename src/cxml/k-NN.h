@@ -21,13 +21,21 @@
 #ifndef CXSTRUCTS_SRC_MACHINELEARNING_K_NN_H_
 #define CXSTRUCTS_SRC_MACHINELEARNING_K_NN_H_
 
+#include <algorithm>
+#include <array>
 #include <exception>
+#include <limits>
+#include <span>
 #include <vector>
 #include "../cxconfig.h"
 #include "../cxstructs/Geometry.h"
 #include "../cxstructs/HashMap.h"
 #include "../cxstructs/QuadTree.h"
+#include "../cxstructs/k-Tree.h"
 #include "../cxstructs/row.h"
+#include "../cxstructs/small_vec.h"
+#include "../cxstructs/soa_vec.h"
+#include "../cxutil/cxthreadpool.h"
 /**
  * <h2>k-Nearest Neighbour</h2>
  *
@@ -38,7 +46,6 @@
 namespace cxstructs {
 
 enum class DISTANCE_FUNCTION_2D { EUCLIDEAN, MANHATTAN };
-enum class DISTANCE_FUNCTION_XD { EUCLIDEAN, MANHATTAN, CHEBYSHEV, COSINE };
 
 /**
  * @tparam C the categories
@@ -51,73 +58,184 @@ struct DataPoint_ {
   virtual float getWeight() const = 0;
   virtual C getCategory() = 0;
 };
+/**
+ * Interface for data points with any number of dimensions
+ * @tparam C the categories
+ */
+template <typename C>
+struct DataPointXD_ {
+  using Category = C;
+  virtual const float* values() const = 0;  // the feature vector
+  virtual float getWeight() const = 0;
+  virtual C getCategory() = 0;
+};
 
 template <typename DP_>
 class kNN_2D {
   using Category = typename DP_::Category;
-  D_func dist_func;
+  DISTANCE_FUNCTION_2D distance_;
   QuadTree<DP_> space;
 
   uint_32_cx n_points;
-  DP_* data_ptr;
-
-  inline void get_k_closest(float x, float y, int k, vec<DP_*>& k_closest) {
-    Rect search_space = {x, y, 1, 1};
 
-    while (k_closest.size() < k) {  //expanding till at least k size
-      k_closest = space.get_subrect(search_space);
-      search_space.x()--;
-      search_space.y()--;
-      search_space.height() += 2;
-      search_space.width() += 2;
+  static constexpr uint_32_cx kMaxCategories = 128;
+  // everything a query needs - one per thread so batches dont allocate per query
+  struct Scratch {
+    small_vec<DP_*, 16> k_closest;  // inline for the usual small k
+    typename QuadTree<DP_>::SearchScratch search;
+    std::array<float, kMaxCategories> catg_values;
+  };
+  Scratch scratch_;  // used by the single query methods
+
+  // the search compares squared euclidean distances - inlined lambdas instead of a function pointer
+  inline void get_k_closest(float x, float y, int k, Scratch& scratch) {
+    if (distance_ == DISTANCE_FUNCTION_2D::EUCLIDEAN) {
+      space.k_nearest(
+          x, y, k, scratch.k_closest,
+          [](float x1, float y1, float x2, float y2) { return squared_euclidean(x1, y1, x2, y2); },
+          scratch.search);
+    } else {
+      space.k_nearest(
+          x, y, k, scratch.k_closest,
+          [](float x1, float y1, float x2, float y2) { return manhattan(x1, y1, x2, y2); },
+          scratch.search);
     }
-
-    if (k_closest.size() > k) {
-      auto c_dist_func = dist_func;
-      //rearranging with custom comparator, ascending to distance
-      std::nth_element(k_closest.begin(), k_closest.begin() + k, k_closest.end(),
-                       [c_dist_func, x, y](DP_* f, DP_* s) {
-                         float dist1 = c_dist_func(x, y, f->x(), f->y());
-                         float dist2 = c_dist_func(x, y, s->x(), s->y());
-                         return dist1 < dist2;
-                       });
-      k_closest.resize(k);  // erasing elements after the k-th position
+  }
+  inline float distance(float x, float y, const DP_* p) const {
+    if (distance_ == DISTANCE_FUNCTION_2D::EUCLIDEAN) {
+      return std::sqrt(squared_euclidean(x, y, p->x(), p->y()));
+    }
+    return manhattan(x, y, p->x(), p->y());
+  }
+  using Score = float (kNN_2D::*)(float, float, DP_*) const;
+  template <Score score>
+  inline Category classify(float x, float y, int k, Scratch& scratch) {
+    scratch.catg_values.fill(0);
+    get_k_closest(x, y, k, scratch);  //getting pointer list of closest points
+    for (auto& ptr : scratch.k_closest) {
+      scratch.catg_values[ptr->getCategory()] += (this->*score)(x, y, ptr);
+    }
+    return Category(std::max_element(scratch.catg_values.begin(), scratch.catg_values.end()) -
+                    scratch.catg_values.begin());
+  }
+  template <Score score>
+  inline void classify_batch(std::span<const Point> points, int k, std::span<Category> out,
+                             uint_32_cx threads) {
+    if (out.size() < points.size()) {
+      throw std::logic_error("output buffer too small");
+    }
+    auto run = [&](uint_32_cx begin, uint_32_cx end) {
+      Scratch scratch;
+      for (uint_32_cx i = begin; i < end; i++) {
+        out[i] = classify<score>(points[i].x(), points[i].y(), k, scratch);
+      }
+    };
+    if (threads <= 1) {
+      run(0, points.size());
+    } else {
+      ThreadPool::global().parallel_for(0, points.size(), run, 256);
     }
   }
+  inline float count_score(float, float, DP_*) const { return 1; }
+  inline float distance_score(float x, float y, DP_* p) const { return distance(x, y, p); }
+  inline float weight_score(float, float, DP_* p) const { return p->getWeight(); }
+  inline float weighted_distance_score(float x, float y, DP_* p) const {
+    return distance(x, y, p) * p->getWeight();
+  }
+  // min and max over the plain coordinate arrays - branchless so it vectorizes
+  static inline Rect bounds_of(std::span<const float> xs, std::span<const float> ys) noexcept {
+    float min_x = std::numeric_limits<float>::max(), max_x = std::numeric_limits<float>::lowest();
+    float min_y = std::numeric_limits<float>::max(), max_y = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < xs.size(); i++) {
+      min_x = std::min(min_x, xs[i]);
+      max_x = std::max(max_x, xs[i]);
+      min_y = std::min(min_y, ys[i]);
+      max_y = std::max(max_y, ys[i]);
+    }
+    return {min_x, min_y, max_x - min_x, max_y - min_y};
+  }
+  // at least 1 wide and high so the tree can grow from it when points are added outside
+  static inline Rect with_extent(const Rect& b) noexcept {
+    return {b.x(), b.y(), b.width() > 0 ? b.width() : 1.0F, b.height() > 0 ? b.height() : 1.0F};
+  }
 
  public:
   kNN_2D(std::vector<DP_>& data, DISTANCE_FUNCTION_2D distance_function, Rect bounds = {})
-      : space({}), data_ptr(data.data()), n_points(data.size()) {
-    if (distance_function == DISTANCE_FUNCTION_2D::EUCLIDEAN) {
-      dist_func = cxstructs::euclidean;
-    } else {
-      dist_func = cxstructs::manhattan;
-    }
-    if (bounds.width() == 0 && bounds.height() == 0) {
-      float max_x = std::numeric_limits<float>::min();
-      float max_y = std::numeric_limits<float>::min();
-      float min_x = std::numeric_limits<float>::max();
-      float min_y = std::numeric_limits<float>::max();
-      for (auto& dp : data) {
-        if (dp.x() > max_x) {
-          max_x = dp.x();
-        }
-        if (dp.x() < min_x) {
-          min_x = dp.x();
-        }
-        if (dp.y() > max_y) {
-          max_y = dp.y();
-        }
-        if (dp.y() < min_y) {
-          min_y = dp.y();
-        }
+      : distance_(distance_function), space({}), n_points(data.size()) {
+    if (bounds.width() == 0 && bounds.height() == 0 && !data.empty()) {
+      float min_x = std::numeric_limits<float>::max(), max_x = std::numeric_limits<float>::lowest();
+      float min_y = std::numeric_limits<float>::max(), max_y = std::numeric_limits<float>::lowest();
+      for (const auto& dp : data) {
+        min_x = std::min(min_x, dp.x());
+        max_x = std::max(max_x, dp.x());
+        min_y = std::min(min_y, dp.y());
+        max_y = std::max(max_y, dp.y());
       }
-      space.set_bounds({min_x, min_y, max_x - min_x, max_y - min_y});
+      bounds = {min_x, min_y, max_x - min_x, max_y - min_y};
     }
+    space.set_bounds(with_extent(bounds));
     for (auto& dp : data) {
       space.insert(std::move(dp));
     }
   }
+  /**
+   * Builds the kNN from the rows of a soa_vec - the first two fields are x and y, the bounds are computed
+   * straight from those two arrays.<p>
+   * Each row is turned into a DP_ with all of its fields, so DP_ needs a matching constructor e.g.
+   * <code>DataPoint(float x, float y, Category c)</code> for a <code>soa_vec&lt;float, float, Category&gt;</code>.
+   * The tree stores its own copies of the points, the soa_vec doesnt have to outlive the kNN_2D
+   * @param data the rows
+   * @param distance_function the distance between two points
+   * @param bounds the space containing all points - computed if empty
+   */
+  template <typename... Fields>
+  kNN_2D(const soa_vec<float, float, Fields...>& data, DISTANCE_FUNCTION_2D distance_function,
+         Rect bounds = {})
+      : distance_(distance_function), space({}), n_points(data.size()) {
+    if (bounds.width() == 0 && bounds.height() == 0 && data.size() > 0) {
+      bounds = bounds_of(data.template get<0>(), data.template get<1>());
+    }
+    space.set_bounds(with_extent(bounds));
+    space.insert(data);
+  }
+  /**
+   * Adds a training point in O(log n) - if it lies outside the current bounds they grow to contain it
+   * @param point the data point to add
+   */
+  inline void add_point(const DP_& point) {
+    space.grow(point.x(), point.y());
+    space.insert(point);
+    n_points++;
+  }
+  /**
+   * Removes the first training point equal to the given one (DP_::operator==) in O(log n)
+   * @param point the data point to remove
+   * @return true if a point was removed
+   */
+  inline bool remove_point(const DP_& point) {
+    if (!space.erase(point)) {
+      return false;
+    }
+    n_points--;
+    return true;
+  }
+  /**
+   * Replaces a training point e.g. after it moved - remove_point() followed by add_point()
+   * @param old_point the data point as it is stored
+   * @param new_point its new state
+   * @return false if old_point wasnt found, nothing is added then
+   */
+  inline bool update_point(const DP_& old_point, const DP_& new_point) {
+    if (!remove_point(old_point)) {
+      return false;
+    }
+    add_point(new_point);
+    return true;
+  }
+  /**
+   * @return the number of training points
+   */
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return n_points; }
   /**
  * Classifies a point based on the absolute count of categories in the k closest points.
  * @param x The x-coordinate of the point.
@@ -130,23 +248,7 @@ class kNN_2D {
     if (n_points < k) {
       throw std::logic_error("not enough data points");
     }
-    vec<int, false> catg_values(128, 0);  // max categories
-    vec<DP_*> k_closest;
-
-    get_k_closest(x, y, k, k_closest);  //getting pointer list of closest points
-
-    for (auto& ptr : k_closest) {
-      catg_values[ptr->getCategory()]++;
-    }
-
-    int index = -1;
-    index = catg_values.max_element();
-
-    if (index == -1) {
-      throw std::logic_error("no category found!");
-    }
-
-    return Category(index);
+    return classify<&kNN_2D::count_score>(x, y, k, scratch_);
   }
   /**
  * Classifies a point based on the sum of distances to the k closest points in each category.
@@ -154,26 +256,9 @@ class kNN_2D {
  * @param y The y-coordinate of the point.
  * @param k The number of closest points to consider.
  * @return The category of the point.
- * @throws std::logic_error If no category is found.
  */
   inline Category classify_by_sum_distance(float x, float y, int k) {
-    vec<float, false> catg_values(128, 0);  // max categories
-    vec<DP_*> k_closest;
-
-    get_k_closest(x, y, k, k_closest);  //getting pointer list of closest points
-
-    for (auto& ptr : k_closest) {
-      catg_values[ptr->getCategory()] += dist_func(x, y, ptr->x(), ptr->y());
-    }
-
-    int index = -1;
-    index = catg_values.max_element();
-
-    if (index == -1) {
-      throw std::logic_error("no category found!");
-    }
-
-    return Category(index);
+    return classify<&kNN_2D::distance_score>(x, y, k, scratch_);
   }
   /**
  * Classifies a point based on the sum of weights of the k closest points in each category.
@@ -181,26 +266,9 @@ class kNN_2D {
  * @param y The y-coordinate of the point.
  * @param k The number of closest points to consider.
  * @return The category of the point.
- * @throws std::logic_error If no category is found.
  */
   inline Category classify_by_sum_weight(float x, float y, int k) {
-    vec<float, false> catg_values(128, 0);  // max categories
-    vec<DP_*> k_closest;
-
-    get_k_closest(x, y, k, k_closest);  //getting pointer list of closest points
-
-    for (auto& ptr : k_closest) {
-      catg_values[ptr->getCategory()] += ptr->getWeight();
-    }
-
-    int index = -1;
-    index = catg_values.max_element();
-
-    if (index == -1) {
-      throw std::logic_error("no category found!");
-    }
-
-    return Category(index);
+    return classify<&kNN_2D::weight_score>(x, y, k, scratch_);
   }
   /**
  * Classifies a point based on the sum of weighted distances to the k closest points in each category.
@@ -208,26 +276,46 @@ class kNN_2D {
  * @param y The y-coordinate of the point.
  * @param k The number of closest points to consider.
  * @return The category of the point.
- * @throws std::logic_error If no category is found.
  */
   inline Category classify_by_sum_weighted_distance(float x, float y, int k) {
-    vec<float, false> catg_values(128, 0);  // max categories
-    vec<DP_*> k_closest;
-
-    get_k_closest(x, y, k, k_closest);  //getting pointer list of closest points
-
-    for (auto& ptr : k_closest) {
-      catg_values[ptr->getCategory()] += dist_func(x, y, ptr->x(), ptr->y()) * ptr->getWeight();
-    }
-
-    int index = -1;
-    index = catg_values.max_element();
-
-    if (index == -1) {
-      throw std::logic_error("no category found!");
+    return classify<&kNN_2D::weighted_distance_score>(x, y, k, scratch_);
+  }
+  /**
+   * Batch version of classify_by_category_count() - writes the category of points[i] to out[i].<p>
+   * Every thread reuses one set of buffers for all of its queries
+   * @param points the query points
+   * @param k The number of closest points to consider.
+   * @param out buffer with at least points.size() elements
+   * @param threads with threads > 1 the queries are distributed over the global ThreadPool
+   * @throws std::logic_error If there are not enough data points or the buffer is too small.
+   */
+  inline void classify_by_category_count(std::span<const Point> points, int k,
+                                         std::span<Category> out, uint_32_cx threads = 1) {
+    if (k < 0 || n_points < static_cast<uint_32_cx>(k)) {
+      throw std::logic_error("not enough data points");
     }
-
-    return Category(index);
+    classify_batch<&kNN_2D::count_score>(points, k, out, threads);
+  }
+  /**
+   * Batch version of classify_by_sum_distance() - see classify_by_category_count()
+   */
+  inline void classify_by_sum_distance(std::span<const Point> points, int k,
+                                       std::span<Category> out, uint_32_cx threads = 1) {
+    classify_batch<&kNN_2D::distance_score>(points, k, out, threads);
+  }
+  /**
+   * Batch version of classify_by_sum_weight() - see classify_by_category_count()
+   */
+  inline void classify_by_sum_weight(std::span<const Point> points, int k, std::span<Category> out,
+                                     uint_32_cx threads = 1) {
+    classify_batch<&kNN_2D::weight_score>(points, k, out, threads);
+  }
+  /**
+   * Batch version of classify_by_sum_weighted_distance() - see classify_by_category_count()
+   */
+  inline void classify_by_sum_weighted_distance(std::span<const Point> points, int k,
+                                                std::span<Category> out, uint_32_cx threads = 1) {
+    classify_batch<&kNN_2D::weighted_distance_score>(points, k, out, threads);
   }
 #ifndef CX_DELETE_TESTS
   static void TEST() {
@@ -243,6 +331,9 @@ class kNN_2D {
       float y() const final { return y_; }
       Category getCategory() final { return category; }
       float getWeight() const final { return weight; }
+      bool operator==(const DataPoint& o) const {
+        return x_ == o.x_ && y_ == o.y_ && category == o.category;
+      }
     };
 
     std::cout << "TESTING k-NN" << std::endl;
@@ -283,12 +374,213 @@ class kNN_2D {
     CX_ASSERT((int)cat1 == 0, "");
     cat1 = knn.classify_by_sum_weighted_distance(5, 5, 4);
     CX_ASSERT((int)cat1 == 1, "");
+
+    std::cout << "   Testing soa_vec data" << std::endl;
+    soa_vec<float, float, Category> rows;
+    for (const auto& dp : data) {
+      rows.push_back(dp.x(), dp.y(), dp.category);
+    }
+    kNN_2D<DataPoint> soa_knn(rows, DISTANCE_FUNCTION_2D::EUCLIDEAN);
+    CX_ASSERT(soa_knn.classify_by_category_count(0, 0, 4) == knn.classify_by_category_count(0, 0, 4), "");
+    CX_ASSERT(soa_knn.classify_by_sum_distance(5, 5, 4) == knn.classify_by_sum_distance(5, 5, 4), "");
+    CX_ASSERT(soa_knn.classify_by_sum_weight(9, 9, 4) == knn.classify_by_sum_weight(9, 9, 4), "");
+
+    std::cout << "   Testing incremental updates" << std::endl;
+    kNN_2D<DataPoint> live(data, DISTANCE_FUNCTION_2D::EUCLIDEAN);
+    std::vector<DataPoint> current = data;
+    for (int i = 0; i < 4; i++) {  // outside the initial bounds
+      const DataPoint point(-10.0F - static_cast<float>(i), -10, Category::C);
+      live.add_point(point);
+      current.push_back(point);
+    }
+    CX_ASSERT(live.size() == current.size(), "");
+    CX_ASSERT(live.classify_by_category_count(-11, -10, 3) == Category::C, "");
+    CX_ASSERT(live.remove_point(DataPoint(-10, -10, Category::C)), "");
+    CX_ASSERT(!live.remove_point(DataPoint(-10, -10, Category::C)), "");
+    current.erase(current.begin() + 9);
+    CX_ASSERT(live.update_point(DataPoint(1, 2, Category::A), DataPoint(20, -4, Category::A)), "");
+    CX_ASSERT(!live.update_point(DataPoint(1, 2, Category::A), DataPoint(0, 0, Category::A)), "");
+    current[0] = DataPoint(20, -4, Category::A);
+    CX_ASSERT(live.size() == current.size(), "");
+    kNN_2D<DataPoint> rebuilt(current, DISTANCE_FUNCTION_2D::EUCLIDEAN);
+    for (int i = 0; i < 200; i++) {
+      const float x = static_cast<float>(i % 20) * 1.73F - 14.31F;
+      const float y = static_cast<float>(i / 20) * 1.37F - 12.17F;
+      CX_ASSERT(live.classify_by_sum_distance(x, y, 3) == rebuilt.classify_by_sum_distance(x, y, 3), "");
+    }
+
+    std::cout << "   Testing batch classification" << std::endl;
+    std::vector<Point> queries;
+    for (int i = 0; i < 2000; i++) {
+      queries.emplace_back(static_cast<float>(i % 50) * 0.25F - 1, static_cast<float>(i / 50) * 0.3F);
+    }
+    std::vector<Category> out(queries.size());
+    for (uint_32_cx threads : {1, 3}) {
+      knn.classify_by_category_count(queries, 4, out, threads);
+      for (size_t i = 0; i < queries.size(); i++) {
+        CX_ASSERT(out[i] == knn.classify_by_category_count(queries[i].x(), queries[i].y(), 4), "");
+      }
+      knn.classify_by_sum_distance(queries, 4, out, threads);
+      for (size_t i = 0; i < queries.size(); i++) {
+        CX_ASSERT(out[i] == knn.classify_by_sum_distance(queries[i].x(), queries[i].y(), 4), "");
+      }
+      knn.classify_by_sum_weight(queries, 4, out, threads);
+      for (size_t i = 0; i < queries.size(); i++) {
+        CX_ASSERT(out[i] == knn.classify_by_sum_weight(queries[i].x(), queries[i].y(), 4), "");
+      }
+      knn.classify_by_sum_weighted_distance(queries, 4, out, threads);
+      for (size_t i = 0; i < queries.size(); i++) {
+        const Point& q = queries[i];
+        CX_ASSERT(out[i] == knn.classify_by_sum_weighted_distance(q.x(), q.y(), 4), "");
+      }
+    }
+    bool thrown = false;
+    try {
+      knn.classify_by_sum_weight(queries, 4, std::span<Category>(out).first(10));
+    } catch (std::logic_error&) {
+      thrown = true;
+    }
+    CX_ASSERT(thrown, "");
   }
 #endif
 };
 
+/**
+ * k-NN for feature vectors of any dimension - searches a kTree built from the points.<p>
+ * The tree keeps a copy of the feature vectors for cache friendly searching, the data points themselves are
+ * referenced for their category and weight, so the vector has to outlive the kNN_XD
+ * @tparam DP_ data point implementing DataPointXD_
+ */
+template <typename DP_>
 class kNN_XD {
-  //will implement a k-Tree for that
+  using Category = typename DP_::Category;
+  kTree tree_;
+  DP_* data_ptr;
+  uint_32_cx n_points;
+  std::vector<std::pair<float, uint32_t>> k_closest_;  // reused between queries
+
+  template <typename Score>
+  inline Category classify(const float* point, int k, Score score) {
+    if (k < 0 || n_points < static_cast<uint_32_cx>(k)) {
+      throw std::logic_error("not enough data points");
+    }
+    vec<float, false> catg_values(128, 0);  // max categories
+    tree_.k_nearest(point, k, k_closest_);
+    for (const auto& [dist, index] : k_closest_) {
+      DP_& dp = data_ptr[index];
+      catg_values[dp.getCategory()] += score(dist, dp);
+    }
+    return Category(catg_values.max_element());
+  }
+
+ public:
+  /**
+   * @param data the data points - referenced, not copied
+   * @param dims the number of values every data point has
+   * @param distance_function the distance between two feature vectors
+   */
+  kNN_XD(std::vector<DP_>& data, uint_32_cx dims, DISTANCE_FUNCTION_XD distance_function)
+      : data_ptr(data.data()), n_points(data.size()) {
+    std::vector<float> values(static_cast<size_t>(n_points) * dims);
+    for (uint_32_cx i = 0; i < n_points; i++) {
+      std::copy_n(data[i].values(), dims, values.data() + static_cast<size_t>(i) * dims);
+    }
+    tree_ = kTree(values.data(), n_points, dims, distance_function);
+  }
+  /**
+   * Classifies a point based on the absolute count of categories in the k closest points.
+   * @param point the feature vector with the dimensions of the data points
+   * @param k The number of closest points to consider.
+   * @return The category of the point.
+   * @throws std::logic_error If there are not enough data points.
+   */
+  inline Category classify_by_category_count(const float* point, int k) {
+    return classify(point, k, [](float, DP_&) { return 1.0F; });
+  }
+  /**
+   * Classifies a point based on the sum of distances to the k closest points in each category.
+   * @param point the feature vector with the dimensions of the data points
+   * @param k The number of closest points to consider.
+   * @return The category of the point.
+   */
+  inline Category classify_by_sum_distance(const float* point, int k) {
+    return classify(point, k, [](float dist, DP_&) { return dist; });
+  }
+  /**
+   * Classifies a point based on the sum of weights of the k closest points in each category.
+   * @param point the feature vector with the dimensions of the data points
+   * @param k The number of closest points to consider.
+   * @return The category of the point.
+   */
+  inline Category classify_by_sum_weight(const float* point, int k) {
+    return classify(point, k, [](float, DP_& dp) { return dp.getWeight(); });
+  }
+  /**
+   * Classifies a point based on the sum of weighted distances to the k closest points in each category.
+   * @param point the feature vector with the dimensions of the data points
+   * @param k The number of closest points to consider.
+   * @return The category of the point.
+   */
+  inline Category classify_by_sum_weighted_distance(const float* point, int k) {
+    return classify(point, k, [](float dist, DP_& dp) { return dist * dp.getWeight(); });
+  }
+  /**
+   * @return the (distance, index into the data) pairs of the k closest points, ascending by distance
+   */
+  [[nodiscard]] inline std::vector<std::pair<float, uint32_t>> k_nearest(const float* point,
+                                                                         int k) const {
+    return tree_.k_nearest(point, k);
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    enum Category { A, B, C };
+    struct DataPoint : public DataPointXD_<Category> {
+      float values_[32]{};
+      Category category;
+      float weight = 1;
+      DataPoint(Category category) : category(category) {}
+      const float* values() const final { return values_; }
+      Category getCategory() final { return category; }
+      float getWeight() const final { return weight; }
+    };
+
+    std::cout << "TESTING k-NN XD" << std::endl;
+    // three clusters in 32 dimensions around (0,..), (10,..) and (20,..)
+    std::vector<DataPoint> data;
+    uint64_t state = 7;
+    for (int i = 0; i < 300; i++) {
+      DataPoint dp(Category(i % 3));
+      for (float& v : dp.values_) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        v = static_cast<float>(i % 3) * 10 + static_cast<float>(state >> 40) / (1 << 24);
+      }
+      data.push_back(dp);
+    }
+    // cosine cant tell the clusters apart as they lie on one ray
+    for (auto distance : {DISTANCE_FUNCTION_XD::EUCLIDEAN, DISTANCE_FUNCTION_XD::MANHATTAN,
+                          DISTANCE_FUNCTION_XD::CHEBYSHEV}) {
+      kNN_XD<DataPoint> knn(data, 32, distance);
+      float query[32];
+      for (int c = 0; c < 3; c++) {
+        std::fill(query, query + 32, static_cast<float>(c) * 10 + 0.5F);
+        CX_ASSERT(knn.classify_by_category_count(query, 5) == c, "");
+        CX_ASSERT(knn.classify_by_sum_weight(query, 5) == c, "");
+        CX_ASSERT(knn.classify_by_sum_distance(query, 5) == c, "");
+        CX_ASSERT(knn.classify_by_sum_weighted_distance(query, 5) == c, "");
+        auto closest = knn.k_nearest(query, 5);
+        CX_ASSERT(closest.size() == 5 && closest[0].second % 3 == static_cast<uint32_t>(c), "");
+      }
+    }
+    bool thrown = false;
+    try {
+      kNN_XD<DataPoint> knn(data, 32, DISTANCE_FUNCTION_XD::EUCLIDEAN);
+      (void)knn.classify_by_category_count(data[0].values(), 301);
+    } catch (std::logic_error&) {
+      thrown = true;
+    }
+    CX_ASSERT(thrown, "");
+  }
+#endif
 };
 
 }  // namespace cxstructs
@@ -21,28 +21,177 @@
 #ifndef CXSTRUCTS_SRC_CXML_WORD2VEC_H_
 #define CXSTRUCTS_SRC_CXML_WORD2VEC_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
 #include "../cxconfig.h"
 #include "../cxstructs/vec.h"
+#include "../cxutil/cxthreadpool.h"
 #include "FNN.h"
+#include "IVFIndex.h"
 
-namespace cxhelper {}
+// Skip-gram and CBOW with negative sampling in the style of the original word2vec tool
+// Instead of a softmax over the whole vocabulary every prediction is one positive and a few sampled
+// negative dot products, so a training step touches O(negatives * dims) memory independent of the vocabulary
+
+namespace cxhelper {
+/**
+ * Draws words with probability proportional to count^0.75
+ */
+class UnigramTable {
+  std::vector<uint32_t> table_;
+
+ public:
+  UnigramTable() = default;
+  explicit UnigramTable(const std::vector<uint64_t>& counts) {
+    const size_t size = std::clamp<size_t>(counts.size() * 16, 1 << 16, 1 << 24);
+    table_.resize(size);
+    double total = 0;
+    for (uint64_t count : counts) {
+      total += std::pow(static_cast<double>(count), 0.75);
+    }
+    size_t pos = 0;
+    double cumulative = 0;
+    for (uint32_t w = 0; w < counts.size() && pos < size; w++) {
+      cumulative += std::pow(static_cast<double>(counts[w]), 0.75) / total;
+      const auto end = std::min(size, static_cast<size_t>(cumulative * static_cast<double>(size)));
+      for (; pos < end; pos++) {
+        table_[pos] = w;
+      }
+    }
+    for (; pos < size; pos++) {  // rounding leftovers
+      table_[pos] = static_cast<uint32_t>(counts.size() - 1);
+    }
+  }
+  template <typename Rng>
+  inline uint32_t sample(Rng& rng) const noexcept {
+    return table_[rng() % table_.size()];
+  }
+};
+inline float fast_sigmoid(float x) noexcept {
+  if (x > 6) {
+    return 1;
+  }
+  if (x < -6) {
+    return 0;
+  }
+  return 1.0F / (1.0F + std::exp(-x));
+}
+// y += alpha * x
+inline void saxpy(float alpha, const float* x, float* y, uint_32_cx n) noexcept {
+#pragma omp simd
+  for (uint_32_cx i = 0; i < n; i++) {
+    y[i] += alpha * x[i];
+  }
+}
+}  // namespace cxhelper
 
 namespace cxstructs {
 class Word2Vec {
 
   FNN net;
-  uint8_t vec_len;
+  uint_32_cx vec_len;
   uint_32_cx vocab_len;
+  mat context_;     // vocab x vec_len output vectors while training with negative sampling
+  IVFIndex index_;  // built on demand by most_similar(), dropped by training
+
+  /**
+   * Trains on the tokens [begin, end) - shared vectors are updated without locks
+   * @param progress tokens processed by all threads, drives the learning rate decay
+   */
+  void train_sampled_range(const uint32_t* tokens, size_t begin, size_t end,
+                           const cxhelper::UnigramTable& table, int window, int negatives,
+                           float learnR, bool cbow, uint64_t seed,
+                           std::atomic<uint64_t>& progress, uint64_t total) {
+    mat& embed = net.weights(0);
+    float* in = embed.get_raw();
+    float* out = context_.get_raw();
+    const uint_32_cx dims = vec_len;
+    std::mt19937_64 rng(seed);
+    std::vector<float> hidden(dims);
+    std::vector<float> grad(dims);
+    float alpha = learnR;
+    uint64_t local = 0;
+    for (size_t pos = begin; pos < end; pos++) {
+      if (++local == 1024) {  // decay linearly to learnR * 1e-4
+        const uint64_t done = progress.fetch_add(local, std::memory_order_relaxed) + local;
+        local = 0;
+        alpha = learnR *
+                std::max(1e-4F, 1.0F - static_cast<float>(done) / static_cast<float>(total + 1));
+      }
+      const uint32_t center = tokens[pos];
+      const int shrink = static_cast<int>(rng() % window);  // random window size like the original
+      const size_t from = pos >= static_cast<size_t>(window - shrink) ? pos - (window - shrink) : 0;
+      const size_t to = std::min(end, pos + (window - shrink) + 1);
+
+      // predicts target from the vector h, accumulates the gradient for h in grad
+      auto learn = [&](const float* h) {
+        std::fill(grad.begin(), grad.end(), 0.0F);
+        for (int d = 0; d <= negatives; d++) {
+          uint32_t target = center;
+          float label = 1;
+          if (d > 0) {
+            target = table.sample(rng);
+            if (target == center) {
+              continue;
+            }
+            label = 0;
+          }
+          float* target_vec = out + static_cast<size_t>(target) * dims;
+          const float dot = cxhelper::dot_simd(h, target_vec, dims);
+          const float g = (label - cxhelper::fast_sigmoid(dot)) * alpha;
+          cxhelper::saxpy(g, target_vec, grad.data(), dims);
+          cxhelper::saxpy(g, h, target_vec, dims);
+        }
+      };
+      if (cbow) {
+        std::fill(hidden.begin(), hidden.end(), 0.0F);
+        uint_32_cx count = 0;
+        for (size_t c = from; c < to; c++) {
+          if (c != pos) {
+            cxhelper::saxpy(1.0F, in + static_cast<size_t>(tokens[c]) * dims, hidden.data(), dims);
+            count++;
+          }
+        }
+        if (count == 0) {
+          continue;
+        }
+        for (float& h : hidden) {
+          h /= static_cast<float>(count);
+        }
+        learn(hidden.data());
+        for (size_t c = from; c < to; c++) {
+          if (c != pos) {
+            cxhelper::saxpy(1.0F, grad.data(), in + static_cast<size_t>(tokens[c]) * dims, dims);
+          }
+        }
+      } else {
+        for (size_t c = from; c < to; c++) {
+          if (c == pos) {
+            continue;
+          }
+          float* word_vec = in + static_cast<size_t>(tokens[c]) * dims;
+          learn(word_vec);
+          cxhelper::saxpy(1.0F, grad.data(), word_vec, dims);
+        }
+      }
+    }
+    progress.fetch_add(local, std::memory_order_relaxed);
+  }
 
  public:
   Word2Vec(int vocabulary_size, int numbers_per_word)
       : net(
-            {vocabulary_size, numbers_per_word, vocabulary_size}, [](float x) { return x; }, 0.11,
+            {vocabulary_size, numbers_per_word, vocabulary_size}, cxstructs::linear, 0.11,
             cross_entropy),
         vec_len(numbers_per_word),
         vocab_len(vocabulary_size) {}
 
   void train(const std::vector<string>& sentence, int epochs) {
+    index_ = IVFIndex();
     mat in(sentence.size(), sentence.size());
     mat target(sentence.size(), sentence.size());
 
@@ -59,6 +208,7 @@ class Word2Vec {
     net.train(in, target, epochs);
   }
   void train_bag_of_words(const std::vector<string>& vocabulary, int radius, int epochs) {
+    index_ = IVFIndex();
     if (vocabulary.size() != vocab_len) {
       throw std::logic_error("vocabulary size doesnt match the training input");
     }
@@ -85,6 +235,169 @@ class Word2Vec {
     return out.get_row(0);
   }
   vec<float, false> get_vec(int vocab_index) { return net.get_weights(0, vocab_index); }
+  /**
+   * Word2Vec training with negative sampling on a tokenized corpus - memory and time per token dont
+   * depend on the vocabulary size, so large vocabularies are no problem<p>
+   * The word vectors (get_vec()) are the input weights of the network. Afterwards the output layer holds the
+   * sampled output vectors with zero biases, so predict_next() keeps working and training can be resumed
+   * after save() and load().<p>
+   * With threads > 1 the corpus is split into one slice per thread and all threads update the shared vectors
+   * without any locking (Hogwild!). The occasional lost update is harmless for this kind of sparse SGD but
+   * makes the result not bit-reproducible
+   * @param tokens the corpus as vocabulary indices
+   * @param count number of tokens
+   * @param epochs passes over the corpus
+   * @param window maximal distance between a word and its context
+   * @param negatives sampled negative words per prediction
+   * @param learnR starting learning rate - decays linearly
+   * @param threads number of threads
+   * @param cbow predict the word from its averaged context (CBOW) instead of the context from the word (skip-gram)
+   */
+  void train_negative_sampling(const uint32_t* tokens, size_t count, int epochs = 5, int window = 5,
+                               int negatives = 5, float learnR = 0.025F, uint_32_cx threads = 1,
+                               bool cbow = false) {
+    if (count < 2 || epochs <= 0) {
+      return;
+    }
+    index_ = IVFIndex();
+    window = std::max(window, 1);
+    threads = std::clamp<uint_32_cx>(threads, 1, static_cast<uint_32_cx>(count));
+    std::vector<uint64_t> counts(vocab_len, 0);
+    for (size_t i = 0; i < count; i++) {
+      if (tokens[i] >= vocab_len) {
+        throw std::out_of_range("token outside of the vocabulary");
+      }
+      counts[tokens[i]]++;
+    }
+    for (uint64_t& c : counts) {
+      c = std::max<uint64_t>(c, 1);  // unseen words keep a small chance to be sampled
+    }
+    const cxhelper::UnigramTable table(counts);
+    transpose_into(net.weights(1), context_);
+
+    std::atomic<uint64_t> progress{0};
+    const uint64_t total = static_cast<uint64_t>(count) * epochs;
+    for (int e = 0; e < epochs; e++) {
+      auto run = [&](uint_32_cx begin, uint_32_cx end) {
+        for (uint_32_cx t = begin; t < end; t++) {
+          const uint64_t seed = (static_cast<uint64_t>(e) << 32) + t;
+          train_sampled_range(tokens, count * t / threads, count * (t + 1) / threads, table, window,
+                              negatives, learnR, cbow, seed, progress, total);
+        }
+      };
+      if (threads == 1) {
+        run(0, 1);
+      } else {
+        ThreadPool::global().parallel_for(0, threads, run);
+      }
+    }
+
+    transpose_into(context_, net.weights(1));
+    context_ = mat();
+    net.bias(0).scale(0);
+    net.bias(1).scale(0);
+  }
+  void train_negative_sampling(const std::vector<uint32_t>& tokens, int epochs = 5, int window = 5,
+                               int negatives = 5, float learnR = 0.025F, uint_32_cx threads = 1,
+                               bool cbow = false) {
+    train_negative_sampling(tokens.data(), tokens.size(), epochs, window, negatives, learnR,
+                            threads, cbow);
+  }
+  /**
+   * @return the cosine similarity of the vectors of two words
+   */
+  [[nodiscard]] float similarity(int word_a, int word_b) {
+    const float* a = net.weights(0).get_raw() + static_cast<size_t>(word_a) * vec_len;
+    const float* b = net.weights(0).get_raw() + static_cast<size_t>(word_b) * vec_len;
+    const float norm = std::sqrt(cxhelper::dot_simd(a, a, vec_len) * cxhelper::dot_simd(b, b, vec_len));
+    return norm > 0 ? cxhelper::dot_simd(a, b, vec_len) / norm : 0;
+  }
+  /**
+   * Builds the approximate nearest neighbour index over the word vectors used by most_similar().<p>
+   * Happens automatically on the first query - call it directly to choose the parameters.
+   * Training drops the index
+   * @param lists number of clusters - 0 chooses about sqrt(vocabulary size)
+   * @param nprobe clusters each query scans, 0 keeps the default of lists / 16
+   */
+  void build_index(uint_32_cx lists = 0, uint_32_cx nprobe = 0) {
+    index_ = IVFIndex(net.weights(0), Metric::COSINE, lists);
+    if (nprobe > 0) {
+      index_.set_nprobe(nprobe);
+    }
+  }
+  /**
+   * @return the index over the word vectors - built on first use
+   */
+  [[nodiscard]] const IVFIndex& index() {
+    if (index_.size() == 0) {
+      build_index();
+    }
+    return index_;
+  }
+  /**
+   * Finds the words with the highest cosine similarity through the index
+   * @param word the vocabulary index of the word
+   * @param k number of similar words
+   * @return up to k other words ordered by descending similarity
+   */
+  [[nodiscard]] std::vector<Neighbour> most_similar(int word, uint_32_cx k) {
+    const float* query = net.weights(0).get_raw() + static_cast<size_t>(word) * vec_len;
+    auto result = index().most_similar(query, k + 1);
+    const auto self = static_cast<uint32_t>(word);
+    std::erase_if(result, [self](const Neighbour& n) { return n.id_ == self; });
+    result.resize(std::min<size_t>(result.size(), k));
+    return result;
+  }
+  /**
+   * Batched most_similar() - the query words can contain duplicates
+   * @param words the vocabulary indices to query
+   * @param k number of similar words per query
+   * @param threads with threads > 1 the queries are distributed over the global ThreadPool
+   * @return for each word up to k other words ordered by descending similarity
+   */
+  [[nodiscard]] std::vector<std::vector<Neighbour>> most_similar(const std::vector<int>& words,
+                                                                 uint_32_cx k,
+                                                                 uint_32_cx threads = 1) {
+    mat queries(words.size(), vec_len);
+    for (size_t i = 0; i < words.size(); i++) {
+      std::copy_n(net.weights(0).get_raw() + static_cast<size_t>(words[i]) * vec_len, vec_len,
+                  queries.get_raw() + i * vec_len);
+    }
+    auto result = index().most_similar(queries, k + 1, threads);
+    for (size_t i = 0; i < words.size(); i++) {
+      const auto self = static_cast<uint32_t>(words[i]);
+      std::erase_if(result[i], [self](const Neighbour& n) { return n.id_ == self; });
+      result[i].resize(std::min<size_t>(result[i].size(), k));
+    }
+    return result;
+  }
+  /**
+   * Saves the embedding network in the binary model format of FNN::save()
+   * @param path the file to write
+   */
+  void save(const std::string& path) const { net.save(path); }
+  /**
+   * Loads a model written by save() into newly allocated memory
+   * @param path the model file
+   */
+  static Word2Vec load(const std::string& path) { return Word2Vec(FNN::load(path)); }
+  /**
+   * Maps a model written by save() and uses its weights in place - see FNN::load_mmap()
+   * @param path the model file
+   */
+  static Word2Vec load_mmap(const std::string& path) { return Word2Vec(FNN::load_mmap(path)); }
+
+ private:
+  explicit Word2Vec(FNN&& network) : net(std::move(network)) {
+    const std::vector<int>& bounds = net.bounds();
+    if (bounds.size() != 3 || bounds[0] != bounds[2]) {
+      throw std::runtime_error("model file is not a Word2Vec model");
+    }
+    vec_len = bounds[1];
+    vocab_len = bounds[0];
+  }
+
+ public:
 
 #ifndef CX_DELETE_TESTS
   static void TEST() {
@@ -99,6 +412,76 @@ class Word2Vec {
     word_3_vec.train_bag_of_words(train, 2, 30);
     word_3_vec.predict_next(0).print();
     std::cout << word_3_vec.get_vec(0) << std::endl;
+
+    for (bool cbow : {false, true}) {
+      std::cout << (cbow ? "  Testing CBOW" : "  Testing skip-gram") << " with negative sampling..."
+                << std::endl;
+      // two topics that never share a context
+      std::mt19937 gen(7);
+      std::vector<uint32_t> corpus;
+      for (int sentence = 0; sentence < 1000; sentence++) {
+        const uint32_t topic = sentence % 2 == 0 ? 0 : 5;
+        for (int w = 0; w < 20; w++) {
+          corpus.push_back(topic + gen() % 5);
+        }
+        corpus.push_back(10 + sentence % 2);  // a separator word per topic
+      }
+      Word2Vec sampled(12, 16);
+      sampled.train_negative_sampling(corpus, 3, 3, 4, 0.05F, 2, cbow);
+      float within = 0, across = 0;
+      for (int a = 0; a < 5; a++) {
+        for (int b = 0; b < 5; b++) {
+          if (a != b) {
+            within += sampled.similarity(a, b) + sampled.similarity(a + 5, b + 5);
+          }
+          across += 2 * sampled.similarity(a, b + 5);
+        }
+      }
+      CX_ASSERT(within / 40 > across / 50 + 0.3F, "");
+    }
+    std::cout << "  Testing most_similar..." << std::endl;
+    {
+      std::mt19937 gen(3);
+      std::vector<uint32_t> corpus;
+      for (int sentence = 0; sentence < 1000; sentence++) {
+        const uint32_t topic = sentence % 2 == 0 ? 0 : 5;
+        for (int w = 0; w < 20; w++) {
+          corpus.push_back(topic + gen() % 5);
+        }
+      }
+      Word2Vec topics(10, 16);
+      topics.train_negative_sampling(corpus, 3, 3, 4, 0.05F);
+      topics.build_index(2, 2);
+      auto similar = topics.most_similar(7, 4);
+      CX_ASSERT(similar.size() == 4, "");
+      for (const auto& n : similar) {
+        CX_ASSERT(n.id_ >= 5 && n.id_ < 10 && n.id_ != 7, "");
+      }
+      auto batch = topics.most_similar(std::vector<int>{1, 7, 1}, 4, 2);
+      CX_ASSERT(batch.size() == 3 && batch[1].size() == 4, "");
+      for (size_t i = 0; i < 4; i++) {
+        CX_ASSERT(batch[1][i].id_ == similar[i].id_, "");
+        CX_ASSERT(batch[0][i].id_ < 5 && batch[0][i].id_ == batch[2][i].id_, "");
+      }
+    }
+    Word2Vec large(100000, 32);  // the dense trainer couldnt even allocate its inputs
+    std::vector<uint32_t> large_corpus(20000);
+    for (size_t i = 0; i < large_corpus.size(); i++) {
+      large_corpus[i] = static_cast<uint32_t>((i * 7919) % 100000);
+    }
+    large.train_negative_sampling(large_corpus, 1, 2, 2);
+    CX_ASSERT(large.get_vec(7919).size() == 32, "");
+
+    std::cout << "  Testing save and load_mmap..." << std::endl;
+    const std::string model_path = "cxstructs_w2v_test.model";
+    word_3_vec.save(model_path);
+    Word2Vec mapped = Word2Vec::load_mmap(model_path);
+    CX_ASSERT(mapped.vocab_len == 4 && mapped.vec_len == 2, "");
+    for (int i = 0; i < 4; i++) {
+      CX_ASSERT(mapped.get_vec(i)[0] == word_3_vec.get_vec(i)[0], "");
+      CX_ASSERT(mapped.get_vec(i)[1] == word_3_vec.get_vec(i)[1], "");
+    }
+    std::remove(model_path.c_str());
   }
 #endif
 };
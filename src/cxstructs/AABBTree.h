@@ -0,0 +1,628 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_AABBTREE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_AABBTREE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "../cxconfig.h"
+#include "Geometry.h"
+#include "small_vec.h"
+
+// Dynamic bounding volume hierarchy in the style of the Box2D broadphase
+// Leaves store a fat box (the shape grown by a margin) so small moves don't touch the tree at all
+// Insertion descends by the perimeter cost (surface area heuristic in 2D), AVL like rotations keep it balanced
+
+namespace cxhelper {
+/**
+ * Axis aligned box by its corners
+ */
+struct AABB {
+  float x0, y0, x1, y1;
+
+  [[nodiscard]] static inline AABB of(const cxstructs::Rect& r) noexcept {
+    return {r.x(), r.y(), r.x() + r.width(), r.y() + r.height()};
+  }
+  [[nodiscard]] static inline AABB of(const cxstructs::Circle& c) noexcept {
+    return {c.x() - c.radius(), c.y() - c.radius(), c.x() + c.radius(), c.y() + c.radius()};
+  }
+  [[nodiscard]] inline AABB merge(const AABB& o) const noexcept {
+    return {std::min(x0, o.x0), std::min(y0, o.y0), std::max(x1, o.x1), std::max(y1, o.y1)};
+  }
+  [[nodiscard]] inline AABB grow(float margin) const noexcept {
+    return {x0 - margin, y0 - margin, x1 + margin, y1 + margin};
+  }
+  // the 2D surface area heuristic uses the perimeter
+  [[nodiscard]] inline float perimeter() const noexcept { return 2 * ((x1 - x0) + (y1 - y0)); }
+  [[nodiscard]] inline bool contains(const AABB& o) const noexcept {
+    return x0 <= o.x0 && y0 <= o.y0 && o.x1 <= x1 && o.y1 <= y1;
+  }
+  // touching counts, same as Rect::intersects()
+  [[nodiscard]] inline bool overlaps(const AABB& o) const noexcept {
+    return !(x0 > o.x1 || x1 < o.x0 || y0 > o.y1 || y1 < o.y0);
+  }
+  /**
+   * Slab test of the ray origin + t * dir
+   * @return the entry distance or a negative value if the ray misses the box within [0, max_t]
+   */
+  [[nodiscard]] inline float ray_entry(float ox, float oy, float inv_dx, float inv_dy,
+                                       float max_t) const noexcept {
+    float t_min = 0, t_max = max_t;
+    const auto slab = [&](float o, float inv, float lo, float hi) {
+      if (std::isinf(inv)) {  // parallel to this axis
+        return o >= lo && o <= hi;
+      }
+      float t1 = (lo - o) * inv, t2 = (hi - o) * inv;
+      if (t1 > t2) {
+        std::swap(t1, t2);
+      }
+      t_min = std::max(t_min, t1);
+      t_max = std::min(t_max, t2);
+      return t_min <= t_max;
+    };
+    return slab(ox, inv_dx, x0, x1) && slab(oy, inv_dy, y0, y1) ? t_min : -1.0F;
+  }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>AABBTree</h2>
+ * is a dynamic bounding volume hierarchy over axis aligned boxes - the broadphase for shapes of varying size
+ * that move, where QuadTree, FlatQuadTree and HashGrid only index points.
+ * <br><br>
+ * Every inserted Rect or Circle becomes a leaf with a <b>fat</b> box: its bounds grown by a margin. Inner
+ * nodes bound their two children. move() only touches the tree when the new bounds leave the fat box, then the
+ * leaf is reinserted with a box that is also stretched in the direction of movement.<p>
+ * Insertion walks down to the sibling with the lowest perimeter cost (the 2D surface area heuristic) and
+ * rebalances on the way up with tree rotations, so the height stays logarithmic for any insertion order.
+ * <br><br>
+ * Nodes live in one flat array and are addressed by index, freed nodes are reused. The id returned by insert()
+ * stays valid until erase(). Queries test the exact bounds of the shapes, not the fat boxes.
+ * @tparam T user data stored per shape - e.g. an entity id
+ */
+template <typename T = uint32_t>
+class AABBTree {
+ public:
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+ private:
+  struct Node {
+    AABB box_;    // fat box for leaves, union of the children otherwise
+    AABB tight_;  // leaves: the bounds last passed to insert() or move()
+    uint32_t parent_ = npos;  // next free node while in the free list
+    uint32_t left_ = npos;    // npos for leaves
+    uint32_t right_ = npos;
+    int32_t height_ = 0;  // 0 for leaves, -1 for free nodes
+    T data_{};
+    [[nodiscard]] inline bool is_leaf() const noexcept { return left_ == npos; }
+  };
+  // fat boxes are stretched by the displacement times this
+  static constexpr float kDisplaceMultiplier = 4.0F;
+
+  std::vector<Node> nodes_;
+  uint32_t root_ = npos;
+  uint32_t free_ = npos;
+  uint_32_cx size_ = 0;
+  float margin_;
+
+  inline uint32_t allocate_node() {
+    if (free_ == npos) {
+      nodes_.emplace_back();
+      return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+    const uint32_t index = free_;
+    free_ = nodes_[index].parent_;
+    nodes_[index] = Node{};
+    return index;
+  }
+  inline void free_node(uint32_t index) noexcept {
+    nodes_[index].parent_ = free_;
+    nodes_[index].height_ = -1;
+    nodes_[index].data_ = T{};
+    free_ = index;
+  }
+  inline void replace_child(uint32_t parent, uint32_t old_child, uint32_t new_child) noexcept {
+    if (parent == npos) {
+      root_ = new_child;
+    } else if (nodes_[parent].left_ == old_child) {
+      nodes_[parent].left_ = new_child;
+    } else {
+      nodes_[parent].right_ = new_child;
+    }
+  }
+  inline void refit(uint32_t index) noexcept {
+    Node& node = nodes_[index];
+    const Node& l = nodes_[node.left_];
+    const Node& r = nodes_[node.right_];
+    node.box_ = l.box_.merge(r.box_);
+    node.height_ = 1 + std::max(l.height_, r.height_);
+  }
+  /**
+   * Rotates the higher child of a up if the heights of the children differ by more than one
+   * @return the index of the node now at the position of a
+   */
+  uint32_t balance(uint32_t a) noexcept {
+    Node& A = nodes_[a];
+    if (A.is_leaf() || A.height_ < 2) {
+      return a;
+    }
+    const uint32_t b = A.left_, c = A.right_;
+    const int32_t skew = nodes_[c].height_ - nodes_[b].height_;
+    if (skew > 1 || skew < -1) {
+      // up is the higher child, the other child of a stays
+      const bool rotate_right = skew > 1;
+      const uint32_t up = rotate_right ? c : b;
+      Node& U = nodes_[up];
+      const uint32_t f = U.left_, g = U.right_;
+      U.left_ = a;
+      U.parent_ = A.parent_;
+      A.parent_ = up;
+      replace_child(U.parent_, a, up);
+      // the higher grandchild stays with up, the lower one goes to a in place of up
+      const bool keep_f = nodes_[f].height_ > nodes_[g].height_;
+      const uint32_t keep = keep_f ? f : g, give = keep_f ? g : f;
+      U.right_ = keep;
+      (rotate_right ? A.right_ : A.left_) = give;
+      nodes_[give].parent_ = a;
+      refit(a);
+      refit(up);
+      return up;
+    }
+    return a;
+  }
+  // refits and rebalances all ancestors from index up
+  inline void fix_upwards(uint32_t index) noexcept {
+    while (index != npos) {
+      index = balance(index);
+      refit(index);
+      index = nodes_[index].parent_;
+    }
+  }
+  void insert_leaf(uint32_t leaf) {
+    if (root_ == npos) {
+      root_ = leaf;
+      nodes_[leaf].parent_ = npos;
+      return;
+    }
+    const AABB box = nodes_[leaf].box_;
+    uint32_t index = root_;
+    while (!nodes_[index].is_leaf()) {
+      const Node& node = nodes_[index];
+      const float area = node.box_.perimeter();
+      const float combined = node.box_.merge(box).perimeter();
+      // cost of pairing the new leaf with this node, and the increase every descent pays for this node
+      const float cost = 2 * combined;
+      const float inherited = 2 * (combined - area);
+      const auto descend_cost = [&](uint32_t child) {
+        const Node& c = nodes_[child];
+        const float merged = c.box_.merge(box).perimeter();
+        return (c.is_leaf() ? merged : merged - c.box_.perimeter()) + inherited;
+      };
+      const float cost_left = descend_cost(node.left_);
+      const float cost_right = descend_cost(node.right_);
+      if (cost < cost_left && cost < cost_right) {
+        break;
+      }
+      index = cost_left < cost_right ? node.left_ : node.right_;
+    }
+
+    const uint32_t sibling = index;
+    const uint32_t parent = allocate_node();  // may reallocate nodes_
+    const uint32_t old_parent = nodes_[sibling].parent_;
+    nodes_[parent].parent_ = old_parent;
+    nodes_[parent].left_ = sibling;
+    nodes_[parent].right_ = leaf;
+    replace_child(old_parent, sibling, parent);
+    nodes_[sibling].parent_ = parent;
+    nodes_[leaf].parent_ = parent;
+    fix_upwards(parent);
+  }
+  void remove_leaf(uint32_t leaf) noexcept {
+    if (leaf == root_) {
+      root_ = npos;
+      return;
+    }
+    const uint32_t parent = nodes_[leaf].parent_;
+    const uint32_t grand = nodes_[parent].parent_;
+    const uint32_t sibling = nodes_[parent].left_ == leaf ? nodes_[parent].right_ : nodes_[parent].left_;
+    replace_child(grand, parent, sibling);
+    nodes_[sibling].parent_ = grand;
+    free_node(parent);
+    fix_upwards(grand);
+  }
+  inline uint32_t create(const AABB& tight, const T& data) {
+    const uint32_t leaf = allocate_node();
+    nodes_[leaf].tight_ = tight;
+    nodes_[leaf].box_ = tight.grow(margin_);
+    nodes_[leaf].data_ = data;
+    insert_leaf(leaf);
+    size_++;
+    return leaf;
+  }
+  inline bool update(uint32_t id, const AABB& tight, float dx, float dy) {
+    CX_ASSERT(id < nodes_.size() && nodes_[id].height_ == 0, "no such shape");
+    Node& node = nodes_[id];
+    node.tight_ = tight;
+    // keep the fat box unless it doesnt fit anymore or is far too large after a fast move
+    if (node.box_.contains(tight) && tight.grow(4 * margin_).contains(node.box_)) {
+      return false;
+    }
+    remove_leaf(id);
+    AABB fat = tight.grow(margin_);
+    (dx < 0 ? fat.x0 : fat.x1) += dx * kDisplaceMultiplier;
+    (dy < 0 ? fat.y0 : fat.y1) += dy * kDisplaceMultiplier;
+    nodes_[id].box_ = fat;
+    insert_leaf(id);
+    return true;
+  }
+  template <typename Func>
+  inline void query_box(const AABB& box, Func func) const {
+    if (root_ == npos) {
+      return;
+    }
+    small_vec<uint32_t, 64> stack;
+    stack.push_back(root_);
+    while (!stack.empty()) {
+      const Node& node = nodes_[stack.back()];
+      const uint32_t index = stack.back();
+      stack.pop_back();
+      if (!node.box_.overlaps(box)) {
+        continue;
+      }
+      if (node.is_leaf()) {
+        if (node.tight_.overlaps(box)) {
+          func(index);
+        }
+      } else {
+        stack.push_back(node.left_);
+        stack.push_back(node.right_);
+      }
+    }
+  }
+
+ public:
+  /**
+   * @param margin the fat boxes of the leaves are the bounds grown by this on every side - the distance a shape
+   * can move without changing the tree
+   * @param initialCapacity nodes reserved upfront - a tree of n shapes has 2n - 1 nodes
+   */
+  explicit AABBTree(float margin = 0.1F, uint_32_cx initialCapacity = 64) : margin_(margin) {
+    nodes_.reserve(initialCapacity);
+  }
+  /**
+   * Adds a shape with its bounding box
+   * @param bounds the exact bounds of the shape
+   * @param data user data of the shape
+   * @return the id of the shape - valid until it is erased
+   */
+  inline uint32_t insert(const Rect& bounds, const T& data = T{}) { return create(AABB::of(bounds), data); }
+  inline uint32_t insert(const Circle& circle, const T& data = T{}) { return create(AABB::of(circle), data); }
+  /**
+   * Updates the bounds of a shape. The tree only changes if the bounds left the fat box of the shape
+   * @param id id of the shape
+   * @param bounds the new exact bounds
+   * @param dx, dy the displacement since the last move - predicts where the shape goes next
+   * @return true if the shape was reinserted
+   */
+  inline bool move(uint32_t id, const Rect& bounds, float dx = 0, float dy = 0) {
+    return update(id, AABB::of(bounds), dx, dy);
+  }
+  inline bool move(uint32_t id, const Circle& circle, float dx = 0, float dy = 0) {
+    return update(id, AABB::of(circle), dx, dy);
+  }
+  /**
+   * Removes the shape, its id can be handed out again by insert()
+   */
+  inline void erase(uint32_t id) {
+    CX_ASSERT(id < nodes_.size() && nodes_[id].height_ == 0, "no such shape");
+    remove_leaf(id);
+    free_node(id);
+    size_--;
+  }
+  /**
+   * Calls func(id) for every shape whose bounds intersect the given rect - touching counts
+   */
+  template <typename Func>
+  inline void query(const Rect& bound, Func func) const {
+    query_box(AABB::of(bound), func);
+  }
+  [[nodiscard]] inline std::vector<uint32_t> query(const Rect& bound) const {
+    std::vector<uint32_t> result;
+    query(bound, [&](uint32_t id) { result.push_back(id); });
+    return result;
+  }
+  /**
+   * Casts the ray origin + t * (dx, dy) against the bounds of the shapes, nearest subtrees are not preferred.
+   * @param max_t length of the ray in units of (dx, dy)
+   * @param func called as func(id, t) with the entry distance t of every hit box. Returns the new max_t -
+   * t to only look for closer hits, max_t to get all hits, 0 to stop
+   */
+  template <typename Func>
+  void raycast(float ox, float oy, float dx, float dy, float max_t, Func func) const {
+    if (root_ == npos) {
+      return;
+    }
+    const float inv_dx = 1.0F / dx, inv_dy = 1.0F / dy;
+    small_vec<uint32_t, 64> stack;
+    stack.push_back(root_);
+    while (!stack.empty() && max_t > 0) {
+      const uint32_t index = stack.back();
+      stack.pop_back();
+      const Node& node = nodes_[index];
+      if (node.box_.ray_entry(ox, oy, inv_dx, inv_dy, max_t) < 0) {
+        continue;
+      }
+      if (node.is_leaf()) {
+        const float t = node.tight_.ray_entry(ox, oy, inv_dx, inv_dy, max_t);
+        if (t >= 0) {
+          max_t = std::min(max_t, static_cast<float>(func(index, t)));
+        }
+      } else {
+        stack.push_back(node.left_);
+        stack.push_back(node.right_);
+      }
+    }
+  }
+  /**
+   * @return the id of the first shape hit by the ray and its entry distance, or {npos, max_t}
+   */
+  [[nodiscard]] inline std::pair<uint32_t, float> raycast(float ox, float oy, float dx, float dy,
+                                                          float max_t) const {
+    std::pair<uint32_t, float> hit{npos, max_t};
+    raycast(ox, oy, dx, dy, max_t, [&](uint32_t id, float t) {
+      hit = {id, t};
+      return t;
+    });
+    return hit;
+  }
+  /**
+   * Calls func(id_a, id_b) once for every pair of shapes whose bounds intersect - the broadphase pairs
+   */
+  template <typename Func>
+  void for_each_overlap_pair(Func func) const {
+    for (uint32_t a = 0; a < nodes_.size(); a++) {
+      if (nodes_[a].height_ != 0) {
+        continue;
+      }
+      query_box(nodes_[a].tight_, [&](uint32_t b) {
+        if (b > a) {
+          func(a, b);
+        }
+      });
+    }
+  }
+  [[nodiscard]] inline T& operator[](uint32_t id) noexcept { return nodes_[id].data_; }
+  [[nodiscard]] inline const T& operator[](uint32_t id) const noexcept { return nodes_[id].data_; }
+  /**
+   * @return the exact bounds of the shape
+   */
+  [[nodiscard]] inline Rect bounds(uint32_t id) const noexcept {
+    const AABB& b = nodes_[id].tight_;
+    return {b.x0, b.y0, b.x1 - b.x0, b.y1 - b.y0};
+  }
+  /**
+   * @return the fat box of the shape - the area it can move in without changing the tree
+   */
+  [[nodiscard]] inline Rect fat_bounds(uint32_t id) const noexcept {
+    const AABB& b = nodes_[id].box_;
+    return {b.x0, b.y0, b.x1 - b.x0, b.y1 - b.y0};
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+  /**
+   * @return the height of the tree - 0 for a single shape
+   */
+  [[nodiscard]] inline uint_32_cx height() const noexcept { return root_ == npos ? 0 : nodes_[root_].height_; }
+  /**
+   * Sum of the perimeters of all inner nodes relative to the root - lower means faster queries
+   */
+  [[nodiscard]] float area_ratio() const noexcept {
+    if (root_ == npos || nodes_[root_].is_leaf()) {
+      return 0;
+    }
+    float total = 0;
+    for (const Node& node : nodes_) {
+      if (node.height_ > 0) {
+        total += node.box_.perimeter();
+      }
+    }
+    return total / nodes_[root_].box_.perimeter();
+  }
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.blocks = 1;
+    stats.bytes_reserved = nodes_.capacity() * sizeof(Node);
+    stats.bytes_used = size_ * sizeof(T);
+    stats.depth = root_ == npos ? 0 : height() + 1;
+    return stats;
+  }
+  /**
+   * Removes all shapes, keeps the node storage
+   */
+  inline void clear() noexcept {
+    nodes_.clear();
+    root_ = npos;
+    free_ = npos;
+    size_ = 0;
+  }
+#ifndef CX_DELETE_TESTS
+ private:
+  // checks parent links, heights, balance and that every box bounds its children
+  void validate(uint32_t index, uint32_t parent, uint_32_cx& leaves) const {
+    const Node& node = nodes_[index];
+    CX_ASSERT(node.parent_ == parent, "");
+    if (node.is_leaf()) {
+      CX_ASSERT(node.height_ == 0 && node.box_.contains(node.tight_), "");
+      leaves++;
+      return;
+    }
+    const Node& l = nodes_[node.left_];
+    const Node& r = nodes_[node.right_];
+    CX_ASSERT(node.height_ == 1 + std::max(l.height_, r.height_), "");
+    CX_ASSERT(std::abs(l.height_ - r.height_) <= 1, "");
+    CX_ASSERT(node.box_.contains(l.box_) && node.box_.contains(r.box_), "");
+    validate(node.left_, index, leaves);
+    validate(node.right_, index, leaves);
+  }
+  void validate() const {
+    uint_32_cx leaves = 0;
+    if (root_ != npos) {
+      validate(root_, npos, leaves);
+    }
+    CX_ASSERT(leaves == size_, "");
+  }
+
+ public:
+  static void TEST() {
+    std::cout << "TESTING AABB TREE" << std::endl;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> pos(0, 1000);
+    std::uniform_real_distribution<float> extent(1, 30);
+
+    std::cout << "   Testing insert and balance..." << std::endl;
+    AABBTree tree(0.5F);
+    std::vector<Rect> rects;
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 500; i++) {  // sorted insertion order would degenerate an unbalanced tree
+      rects.emplace_back(static_cast<float>(i) * 2, 0, 1, 1);
+      ids.push_back(tree.insert(rects.back(), i));
+    }
+    tree.validate();
+    CX_ASSERT(tree.size() == 500 && tree.height() < 16, "");
+    CX_ASSERT(tree[ids[7]] == 7, "");
+    tree.clear();
+    rects.clear();
+    ids.clear();
+
+    std::vector<Circle> circles;
+    for (int i = 0; i < 2000; i++) {
+      if (i % 4 == 0) {
+        // whole numbers so the bounds of the circle are exact
+        circles.emplace_back(std::floor(pos(gen)), std::floor(pos(gen)), std::floor(extent(gen)));
+        rects.push_back({circles.back().x() - circles.back().radius(), circles.back().y() - circles.back().radius(),
+                         2 * circles.back().radius(), 2 * circles.back().radius()});
+        ids.push_back(tree.insert(circles.back(), i));
+      } else {
+        rects.emplace_back(pos(gen), pos(gen), extent(gen), extent(gen));
+        ids.push_back(tree.insert(rects.back(), i));
+      }
+    }
+    tree.validate();
+    CX_ASSERT(tree.area_ratio() > 0, "");
+
+    auto check_queries = [&]() {
+      for (int q = 0; q < 50; q++) {
+        const Rect r(pos(gen), pos(gen), extent(gen) * 5, extent(gen) * 5);
+        auto found = tree.query(r);
+        std::sort(found.begin(), found.end());
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < ids.size(); i++) {
+          if (ids[i] != npos && rects[i].intersects(r)) {
+            expected.push_back(ids[i]);
+          }
+        }
+        std::sort(expected.begin(), expected.end());
+        CX_ASSERT(found == expected, "");
+      }
+    };
+    std::cout << "   Testing rect queries..." << std::endl;
+    check_queries();
+
+    std::cout << "   Testing move with fat boxes..." << std::endl;
+    const Rect before = tree.fat_bounds(ids[1]);
+    rects[1].x() += 0.2F;
+    CX_ASSERT(!tree.move(ids[1], rects[1], 0.2F), "small moves stay in the fat box");
+    CX_ASSERT(tree.fat_bounds(ids[1]).x() == before.x(), "");
+    rects[1].x() += 50;
+    CX_ASSERT(tree.move(ids[1], rects[1], 50), "");
+    CX_ASSERT(tree.fat_bounds(ids[1]).width() > rects[1].width() + 50, "stretched in the direction of movement");
+    for (int i = 0; i < 2000; i += 3) {
+      const float dx = pos(gen) / 100 - 5, dy = pos(gen) / 100 - 5;
+      rects[i].x() += dx;
+      rects[i].y() += dy;
+      tree.move(ids[i], rects[i], dx, dy);
+    }
+    tree.validate();
+    check_queries();
+
+    std::cout << "   Testing erase..." << std::endl;
+    for (int i = 0; i < 2000; i += 2) {
+      tree.erase(ids[i]);
+      ids[i] = npos;
+    }
+    tree.validate();
+    CX_ASSERT(tree.size() == 1000, "");
+    check_queries();
+    const auto reused = tree.insert(Rect(1, 1, 1, 1));
+    CX_ASSERT(reused < tree.nodes_.size(), "freed nodes are reused");
+    tree.erase(reused);
+
+    std::cout << "   Testing overlap pairs..." << std::endl;
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    tree.for_each_overlap_pair([&](uint32_t a, uint32_t b) { pairs.emplace_back(std::min(a, b), std::max(a, b)); });
+    std::sort(pairs.begin(), pairs.end());
+    std::vector<std::pair<uint32_t, uint32_t>> expected_pairs;
+    for (uint32_t i = 0; i < ids.size(); i++) {
+      for (uint32_t j = i + 1; j < ids.size(); j++) {
+        if (ids[i] != npos && ids[j] != npos && rects[i].intersects(rects[j])) {
+          expected_pairs.emplace_back(std::min(ids[i], ids[j]), std::max(ids[i], ids[j]));
+        }
+      }
+    }
+    std::sort(expected_pairs.begin(), expected_pairs.end());
+    CX_ASSERT(pairs == expected_pairs, "");
+
+    std::cout << "   Testing raycast..." << std::endl;
+    AABBTree line;
+    for (int i = 0; i < 10; i++) {
+      line.insert(Rect(10.0F * i + 5, 0, 2, 10), i);
+    }
+    auto [first, t] = line.raycast(0, 5, 1, 0, 1000);
+    CX_ASSERT(first != npos && line[first] == 0 && t == 5, "");
+    std::tie(first, t) = line.raycast(100, 5, -1, 0, 1000);
+    CX_ASSERT(line[first] == 9 && t == 3, "");
+    CX_ASSERT(line.raycast(0, 20, 1, 0, 1000).first == npos, "");
+    CX_ASSERT(line.raycast(0, 5, 1, 0, 4).first == npos, "too short");
+    int hits = 0;
+    line.raycast(6, -5, 0, 1, 100, [&](uint32_t, float) {
+      hits++;
+      return 100.0F;
+    });
+    CX_ASSERT(hits == 1, "vertical ray");
+    hits = 0;
+    line.raycast(0, 5, 1, 0, 1000, [&](uint32_t, float) {
+      hits++;
+      return 1000.0F;
+    });
+    CX_ASSERT(hits == 10, "");
+    CX_ASSERT(line.memory_stats().elements == 10 && line.memory_stats().depth == line.height() + 1, "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_AABBTREE_H_
@@ -0,0 +1,931 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_BTREEMAP_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_BTREEMAP_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "../CXAllocator.h"
+#include "../cxconfig.h"
+#include "vec.h"
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#endif
+
+// B+-tree: every key lives in a leaf, inner nodes only route
+// Nodes are sized to a few cache lines so a lookup touches one small contiguous key array per level
+// Leaves are linked both ways, range scans walk them without going back up the tree
+
+namespace cxstructs {
+
+/**
+ * <h2>BTreeMap</h2>
+ * An ordered key-value map as a B+-tree, always balanced no matter the insertion order.
+ * <br><br>
+ * Unlike the BinaryTree, each node holds many sorted keys in one array (about 256 bytes of keys and
+ * values or children per node), so the tree stays a few levels deep and each level is a short linear-ish scan instead
+ * of a pointer chase. All operations are iterative.
+ * <br><br>
+ * Inserting at the end of the last leaf starts a new leaf instead of splitting it in half, so monotonic key streams
+ * (timestamps, order ids) fill leaves completely. Sorted data can be built in O(n) with bulk_load().
+ * <br><br>
+ * <b>Important:</b> Inserting or erasing invalidates iterators and references into the map.
+ *
+ * @tparam K key type - default constructible and movable
+ * @tparam V value type - default constructible and movable
+ * @tparam Compare strict weak ordering of the keys
+ */
+template <typename K, typename V, typename Compare = std::less<K>, AllocPolicy Policy = PoolAlloc>
+class BTreeMap {
+  static constexpr size_t kNodeBytes = 256;  // four cache lines
+  static constexpr uint_32_cx kLeafCap = static_cast<uint_32_cx>(
+      std::max<size_t>(4, (kNodeBytes - 2 * sizeof(void*) - sizeof(uint32_t)) / (sizeof(K) + sizeof(V))));
+  static constexpr uint_32_cx kInnerCap = static_cast<uint_32_cx>(
+      std::max<size_t>(4, (kNodeBytes - 2 * sizeof(void*)) / (sizeof(K) + sizeof(void*))));
+  static constexpr uint_32_cx kLeafMin = kLeafCap / 2;
+  static constexpr uint_32_cx kInnerMin = kInnerCap / 2;
+  static constexpr uint_32_cx kMaxHeight = 48;
+
+  struct Leaf {
+    uint32_t count_ = 0;
+    Leaf* prev_ = nullptr;
+    Leaf* next_ = nullptr;
+    K keys_[kLeafCap];
+    V values_[kLeafCap];
+  };
+  // child i holds the keys in [keys_[i-1], keys_[i])
+  struct Inner {
+    uint32_t count_ = 0;  // number of keys, there is one child more
+    K keys_[kInnerCap];
+    void* children_[kInnerCap + 1];
+  };
+
+  using LeafAlloc = cxhelper::policy_allocator_t<Leaf, Policy>;
+  using InnerAlloc = cxhelper::policy_allocator_t<Inner, Policy>;
+  LeafAlloc leaf_alloc_;
+  InnerAlloc inner_alloc_;
+  void* root_ = nullptr;
+  Leaf* first_ = nullptr;
+  Leaf* last_ = nullptr;
+  uint_32_cx size_ = 0;
+  uint_32_cx height_ = 0;  // number of inner levels, 0 means the root is a leaf
+  uint_32_cx leaf_count_ = 0;
+  uint_32_cx inner_count_ = 0;
+  [[no_unique_address]] Compare comp_;
+
+  inline Leaf* new_leaf() {
+    Leaf* leaf = leaf_alloc_.allocate(1);
+    std::allocator_traits<LeafAlloc>::construct(leaf_alloc_, leaf);
+    leaf_count_++;
+    return leaf;
+  }
+  inline Inner* new_inner() {
+    Inner* inner = inner_alloc_.allocate(1);
+    std::allocator_traits<InnerAlloc>::construct(inner_alloc_, inner);
+    inner_count_++;
+    return inner;
+  }
+  inline void delete_leaf(Leaf* leaf) {
+    std::allocator_traits<LeafAlloc>::destroy(leaf_alloc_, leaf);
+    leaf_alloc_.deallocate(leaf, 1);
+    leaf_count_--;
+  }
+  inline void delete_inner(Inner* inner) {
+    std::allocator_traits<InnerAlloc>::destroy(inner_alloc_, inner);
+    inner_alloc_.deallocate(inner, 1);
+    inner_count_--;
+  }
+  inline void unlink(Leaf* leaf) {
+    (leaf->prev_ ? leaf->prev_->next_ : first_) = leaf->next_;
+    (leaf->next_ ? leaf->next_->prev_ : last_) = leaf->prev_;
+  }
+
+  [[nodiscard]] inline uint_32_cx leaf_lower(const Leaf* leaf, const K& key) const {
+    return static_cast<uint_32_cx>(std::lower_bound(leaf->keys_, leaf->keys_ + leaf->count_, key, comp_) -
+                                   leaf->keys_);
+  }
+  [[nodiscard]] inline uint_32_cx leaf_upper(const Leaf* leaf, const K& key) const {
+    return static_cast<uint_32_cx>(std::upper_bound(leaf->keys_, leaf->keys_ + leaf->count_, key, comp_) -
+                                   leaf->keys_);
+  }
+  [[nodiscard]] inline uint_32_cx child_index(const Inner* inner, const K& key) const {
+    return static_cast<uint_32_cx>(std::upper_bound(inner->keys_, inner->keys_ + inner->count_, key, comp_) -
+                                   inner->keys_);
+  }
+  [[nodiscard]] inline Leaf* find_leaf(const K& key) const {
+    void* node = root_;
+    for (uint_32_cx level = 0; level < height_; level++) {
+      auto* inner = static_cast<Inner*>(node);
+      node = inner->children_[child_index(inner, key)];
+    }
+    return static_cast<Leaf*>(node);
+  }
+  [[nodiscard]] inline V* find_value(const K& key) const {
+    if (!root_) {
+      return nullptr;
+    }
+    Leaf* leaf = find_leaf(key);
+    const uint_32_cx pos = leaf_lower(leaf, key);
+    if (pos < leaf->count_ && !comp_(key, leaf->keys_[pos])) {
+      return &leaf->values_[pos];
+    }
+    return nullptr;
+  }
+
+  // moves [pos, count) one slot to the right and puts the pair at pos
+  template <typename Key, typename Val>
+  inline static void leaf_insert_at(Leaf* leaf, uint_32_cx pos, Key&& key, Val&& val) {
+    std::move_backward(leaf->keys_ + pos, leaf->keys_ + leaf->count_, leaf->keys_ + leaf->count_ + 1);
+    std::move_backward(leaf->values_ + pos, leaf->values_ + leaf->count_, leaf->values_ + leaf->count_ + 1);
+    leaf->keys_[pos] = std::forward<Key>(key);
+    leaf->values_[pos] = std::forward<Val>(val);
+    leaf->count_++;
+  }
+  inline static void leaf_erase_at(Leaf* leaf, uint_32_cx pos) {
+    std::move(leaf->keys_ + pos + 1, leaf->keys_ + leaf->count_, leaf->keys_ + pos);
+    std::move(leaf->values_ + pos + 1, leaf->values_ + leaf->count_, leaf->values_ + pos);
+    leaf->count_--;
+  }
+  // appends all pairs of src to dst
+  inline static void leaf_append(Leaf* dst, Leaf* src) {
+    std::move(src->keys_, src->keys_ + src->count_, dst->keys_ + dst->count_);
+    std::move(src->values_, src->values_ + src->count_, dst->values_ + dst->count_);
+    dst->count_ += src->count_;
+    src->count_ = 0;
+  }
+  // removes key pos and the child right of it
+  inline static void inner_erase_at(Inner* inner, uint_32_cx pos) {
+    std::move(inner->keys_ + pos + 1, inner->keys_ + inner->count_, inner->keys_ + pos);
+    std::move(inner->children_ + pos + 2, inner->children_ + inner->count_ + 1, inner->children_ + pos + 1);
+    inner->count_--;
+  }
+
+  // inserts the separator and the new right child after a split of path[level]'s child, splitting upwards as needed
+  inline void insert_into_parents(Inner** path, const uint_32_cx* slots, K separator, void* right) {
+    for (uint_32_cx level = height_; level-- > 0;) {
+      Inner* inner = path[level];
+      const uint_32_cx pos = slots[level];
+      if (inner->count_ < kInnerCap) {
+        std::move_backward(inner->keys_ + pos, inner->keys_ + inner->count_, inner->keys_ + inner->count_ + 1);
+        std::move_backward(inner->children_ + pos + 1, inner->children_ + inner->count_ + 1,
+                           inner->children_ + inner->count_ + 2);
+        inner->keys_[pos] = std::move(separator);
+        inner->children_[pos + 1] = right;
+        inner->count_++;
+        return;
+      }
+      // full - lay out the kInnerCap + 1 keys in order and move the upper half into a new node
+      K keys[kInnerCap + 1];
+      void* children[kInnerCap + 2];
+      std::move(inner->keys_, inner->keys_ + pos, keys);
+      keys[pos] = std::move(separator);
+      std::move(inner->keys_ + pos, inner->keys_ + kInnerCap, keys + pos + 1);
+      std::copy(inner->children_, inner->children_ + pos + 1, children);
+      children[pos + 1] = right;
+      std::copy(inner->children_ + pos + 1, inner->children_ + kInnerCap + 1, children + pos + 2);
+
+      constexpr uint_32_cx mid = (kInnerCap + 1) / 2;
+      Inner* sibling = new_inner();
+      std::move(keys, keys + mid, inner->keys_);
+      std::copy(children, children + mid + 1, inner->children_);
+      inner->count_ = mid;
+      std::move(keys + mid + 1, keys + kInnerCap + 1, sibling->keys_);
+      std::copy(children + mid + 1, children + kInnerCap + 2, sibling->children_);
+      sibling->count_ = kInnerCap - mid;
+      separator = std::move(keys[mid]);
+      right = sibling;
+    }
+    Inner* root = new_inner();
+    root->keys_[0] = std::move(separator);
+    root->children_[0] = root_;
+    root->children_[1] = right;
+    root->count_ = 1;
+    root_ = root;
+    height_++;
+  }
+
+  // returns the value slot of the key and whether it was newly inserted
+  template <typename Val>
+  inline std::pair<V*, bool> insert_impl(const K& key, Val&& val, bool assign) {
+    if (!root_) {
+      Leaf* leaf = new_leaf();
+      leaf_insert_at(leaf, 0, key, std::forward<Val>(val));
+      root_ = first_ = last_ = leaf;
+      size_ = 1;
+      return {&leaf->values_[0], true};
+    }
+    Inner* path[kMaxHeight];
+    uint_32_cx slots[kMaxHeight];
+    void* node = root_;
+    for (uint_32_cx level = 0; level < height_; level++) {
+      path[level] = static_cast<Inner*>(node);
+      slots[level] = child_index(path[level], key);
+      node = path[level]->children_[slots[level]];
+    }
+    auto* leaf = static_cast<Leaf*>(node);
+    const uint_32_cx pos = leaf_lower(leaf, key);
+    if (pos < leaf->count_ && !comp_(key, leaf->keys_[pos])) {
+      if (assign) {
+        leaf->values_[pos] = std::forward<Val>(val);
+      }
+      return {&leaf->values_[pos], false};
+    }
+    size_++;
+    if (leaf->count_ < kLeafCap) {
+      leaf_insert_at(leaf, pos, key, std::forward<Val>(val));
+      return {&leaf->values_[pos], true};
+    }
+
+    // appending to the very last leaf keeps it full and starts a new one - monotonic keys don't leave half empty leaves
+    const uint_32_cx split = pos == kLeafCap && !leaf->next_ ? kLeafCap : kLeafCap / 2;
+    Leaf* right = new_leaf();
+    std::move(leaf->keys_ + split, leaf->keys_ + kLeafCap, right->keys_);
+    std::move(leaf->values_ + split, leaf->values_ + kLeafCap, right->values_);
+    right->count_ = kLeafCap - split;
+    leaf->count_ = split;
+    right->prev_ = leaf;
+    right->next_ = leaf->next_;
+    (leaf->next_ ? leaf->next_->prev_ : last_) = right;
+    leaf->next_ = right;
+
+    V* result;
+    if (pos < split) {
+      leaf_insert_at(leaf, pos, key, std::forward<Val>(val));
+      result = &leaf->values_[pos];
+    } else {
+      leaf_insert_at(right, pos - split, key, std::forward<Val>(val));
+      result = &right->values_[pos - split];
+    }
+    insert_into_parents(path, slots, right->keys_[0], right);
+    return {result, true};
+  }
+
+  // fixes an underfull inner node at path[level] by borrowing from or merging with a sibling, upwards as needed
+  inline void rebalance_inner(Inner** path, const uint_32_cx* slots, uint_32_cx level) {
+    for (;; level--) {
+      Inner* node = path[level];
+      if (level == 0) {
+        if (node->count_ == 0) {
+          root_ = node->children_[0];
+          delete_inner(node);
+          height_--;
+        }
+        return;
+      }
+      if (node->count_ >= kInnerMin) {
+        return;
+      }
+      Inner* parent = path[level - 1];
+      const uint_32_cx idx = slots[level - 1];
+      Inner* left = idx > 0 ? static_cast<Inner*>(parent->children_[idx - 1]) : nullptr;
+      Inner* right = idx < parent->count_ ? static_cast<Inner*>(parent->children_[idx + 1]) : nullptr;
+
+      if (left && left->count_ > kInnerMin) {
+        std::move_backward(node->keys_, node->keys_ + node->count_, node->keys_ + node->count_ + 1);
+        std::move_backward(node->children_, node->children_ + node->count_ + 1,
+                           node->children_ + node->count_ + 2);
+        node->keys_[0] = std::move(parent->keys_[idx - 1]);
+        node->children_[0] = left->children_[left->count_];
+        parent->keys_[idx - 1] = std::move(left->keys_[left->count_ - 1]);
+        left->count_--;
+        node->count_++;
+        return;
+      }
+      if (right && right->count_ > kInnerMin) {
+        node->keys_[node->count_] = std::move(parent->keys_[idx]);
+        node->children_[node->count_ + 1] = right->children_[0];
+        node->count_++;
+        parent->keys_[idx] = std::move(right->keys_[0]);
+        std::move(right->keys_ + 1, right->keys_ + right->count_, right->keys_);
+        std::move(right->children_ + 1, right->children_ + right->count_ + 1, right->children_);
+        right->count_--;
+        return;
+      }
+      // merge the right one of the pair into the left one, the separator comes down between them
+      Inner* dst = left ? left : node;
+      Inner* src = left ? node : right;
+      const uint_32_cx sep = left ? idx - 1 : idx;
+      dst->keys_[dst->count_] = std::move(parent->keys_[sep]);
+      std::move(src->keys_, src->keys_ + src->count_, dst->keys_ + dst->count_ + 1);
+      std::copy(src->children_, src->children_ + src->count_ + 1, dst->children_ + dst->count_ + 1);
+      dst->count_ += src->count_ + 1;
+      delete_inner(src);
+      inner_erase_at(parent, sep);
+    }
+  }
+
+  inline void destroy_all() noexcept {
+    if (!root_) {
+      return;
+    }
+    // inner nodes level by level, leaves through their links
+    std::vector<Inner*> level;
+    std::vector<Inner*> next;
+    if (height_ > 0) {
+      level.push_back(static_cast<Inner*>(root_));
+    }
+    for (uint_32_cx depth = 1; depth < height_; depth++) {
+      next.clear();
+      for (Inner* inner : level) {
+        for (uint_32_cx i = 0; i <= inner->count_; i++) {
+          next.push_back(static_cast<Inner*>(inner->children_[i]));
+        }
+        delete_inner(inner);
+      }
+      level.swap(next);
+    }
+    for (Inner* inner : level) {
+      delete_inner(inner);
+    }
+    Leaf* leaf = first_;
+    while (leaf) {
+      Leaf* next_leaf = leaf->next_;
+      delete_leaf(leaf);
+      leaf = next_leaf;
+    }
+    root_ = first_ = last_ = nullptr;
+    size_ = height_ = 0;
+  }
+
+  // builds the tree bottom up from n strictly ascending pairs, nodes filled evenly and as full as possible
+  template <typename KeyAt, typename ValueAt>
+  void build_sorted(uint_32_cx n, KeyAt key_at, ValueAt value_at) {
+    clear();
+    if (n == 0) {
+      return;
+    }
+    for (uint_32_cx i = 1; i < n; i++) {
+      CX_ASSERT(comp_(key_at(i - 1), key_at(i)), "bulk_load needs strictly ascending keys");
+    }
+    std::vector<std::pair<void*, K>> level;  // node and the smallest key below it
+    const uint_32_cx leaves = (n + kLeafCap - 1) / kLeafCap;
+    level.reserve(leaves);
+    uint_32_cx index = 0;
+    for (uint_32_cx l = 0; l < leaves; l++) {
+      const uint_32_cx count = n / leaves + (l < n % leaves ? 1 : 0);
+      Leaf* leaf = new_leaf();
+      for (uint_32_cx i = 0; i < count; i++, index++) {
+        leaf->keys_[i] = key_at(index);
+        leaf->values_[i] = value_at(index);
+      }
+      leaf->count_ = count;
+      leaf->prev_ = last_;
+      (last_ ? last_->next_ : first_) = leaf;
+      last_ = leaf;
+      level.emplace_back(leaf, leaf->keys_[0]);
+    }
+    std::vector<std::pair<void*, K>> parents;
+    while (level.size() > 1) {
+      const auto children = static_cast<uint_32_cx>(level.size());
+      const uint_32_cx nodes = (children + kInnerCap) / (kInnerCap + 1);
+      parents.clear();
+      uint_32_cx child = 0;
+      for (uint_32_cx p = 0; p < nodes; p++) {
+        const uint_32_cx count = children / nodes + (p < children % nodes ? 1 : 0);
+        Inner* inner = new_inner();
+        parents.emplace_back(inner, level[child].second);
+        inner->children_[0] = level[child++].first;
+        for (uint_32_cx i = 1; i < count; i++, child++) {
+          inner->keys_[i - 1] = level[child].second;
+          inner->children_[i] = level[child].first;
+        }
+        inner->count_ = count - 1;
+      }
+      level.swap(parents);
+      height_++;
+    }
+    root_ = level[0].first;
+    size_ = n;
+  }
+
+ public:
+  template <bool Const>
+  class Iterator {
+    using Value = std::conditional_t<Const, const V, V>;
+    Leaf* leaf_;
+    uint_32_cx index_;
+
+   public:
+    Iterator(Leaf* leaf, uint_32_cx index) : leaf_(leaf), index_(index) {}
+    [[nodiscard]] inline const K& key() const { return leaf_->keys_[index_]; }
+    [[nodiscard]] inline Value& value() const { return leaf_->values_[index_]; }
+    inline std::pair<const K&, Value&> operator*() const { return {key(), value()}; }
+    inline Iterator& operator++() {
+      if (++index_ == leaf_->count_) {
+        leaf_ = leaf_->next_;
+        index_ = 0;
+      }
+      return *this;
+    }
+    // only valid on iterators that aren't the begin or end
+    inline Iterator& operator--() {
+      if (index_ == 0) {
+        leaf_ = leaf_->prev_;
+        index_ = leaf_->count_;
+      }
+      index_--;
+      return *this;
+    }
+    inline bool operator==(const Iterator& o) const { return leaf_ == o.leaf_ && index_ == o.index_; }
+    inline bool operator!=(const Iterator& o) const { return !(*this == o); }
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  BTreeMap() = default;
+  explicit BTreeMap(Compare comp) : comp_(std::move(comp)) {}
+  BTreeMap(const BTreeMap& o) : comp_(o.comp_) {
+    std::vector<const K*> keys;
+    std::vector<const V*> values;
+    keys.reserve(o.size_);
+    values.reserve(o.size_);
+    for (auto it = o.begin(); it != o.end(); ++it) {
+      keys.push_back(&it.key());
+      values.push_back(&it.value());
+    }
+    build_sorted(
+        o.size_, [&](uint_32_cx i) -> const K& { return *keys[i]; },
+        [&](uint_32_cx i) -> const V& { return *values[i]; });
+  }
+  BTreeMap(BTreeMap&& o) noexcept
+      : root_(o.root_),
+        first_(o.first_),
+        last_(o.last_),
+        size_(o.size_),
+        height_(o.height_),
+        leaf_count_(o.leaf_count_),
+        inner_count_(o.inner_count_),
+        comp_(std::move(o.comp_)) {
+    o.root_ = o.first_ = o.last_ = nullptr;
+    o.size_ = o.height_ = o.leaf_count_ = o.inner_count_ = 0;
+  }
+  BTreeMap& operator=(const BTreeMap& o) {
+    if (this != &o) {
+      BTreeMap copy(o);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+  BTreeMap& operator=(BTreeMap&& o) noexcept {
+    if (this != &o) {
+      destroy_all();
+      root_ = o.root_;
+      first_ = o.first_;
+      last_ = o.last_;
+      size_ = o.size_;
+      height_ = o.height_;
+      leaf_count_ = o.leaf_count_;
+      inner_count_ = o.inner_count_;
+      comp_ = std::move(o.comp_);
+      o.root_ = o.first_ = o.last_ = nullptr;
+      o.size_ = o.height_ = o.leaf_count_ = o.inner_count_ = 0;
+    }
+    return *this;
+  }
+  ~BTreeMap() { destroy_all(); }
+
+  /**
+   * Inserts the key, value pair if the key doesn't exist yet
+   * @return true if it was inserted, false if the key was already present (the value is left untouched)
+   */
+  inline bool insert(const K& key, const V& val) { return insert_impl(key, val, false).second; }
+  /**
+   * Inserts the key, value pair or replaces the value if the key already exists
+   * @return true if the key was newly inserted
+   */
+  inline bool insert_or_assign(const K& key, const V& val) { return insert_impl(key, val, true).second; }
+  /**
+   * Retrieves the value for the given key<p>
+   * If the key doesnt exist a default constructed value is inserted
+   */
+  inline V& operator[](const K& key) { return *insert_impl(key, V{}, false).first; }
+  /**
+   * Retrieves the value for the given key <p>
+   * <b>Throws an std::out_of_range if the key doesnt exist</b>
+   */
+  [[nodiscard]] inline V& at(const K& key) const {
+    V* val = find_value(key);
+    if (!val) {
+      throw std::out_of_range("no such key");
+    }
+    return *val;
+  }
+  /**
+   * @return a pointer to the value of this key or nullptr if it doesn't exist
+   */
+  [[nodiscard]] inline V* find(const K& key) { return find_value(key); }
+  [[nodiscard]] inline const V* find(const K& key) const { return find_value(key); }
+  [[nodiscard]] inline bool contains(const K& key) const { return find_value(key) != nullptr; }
+  /**
+   * Removes the key, value pair - underfull nodes borrow from or merge with a sibling
+   * @return true if the key existed
+   */
+  inline bool erase(const K& key) {
+    if (!root_) {
+      return false;
+    }
+    Inner* path[kMaxHeight];
+    uint_32_cx slots[kMaxHeight];
+    void* node = root_;
+    for (uint_32_cx level = 0; level < height_; level++) {
+      path[level] = static_cast<Inner*>(node);
+      slots[level] = child_index(path[level], key);
+      node = path[level]->children_[slots[level]];
+    }
+    auto* leaf = static_cast<Leaf*>(node);
+    const uint_32_cx pos = leaf_lower(leaf, key);
+    if (pos == leaf->count_ || comp_(key, leaf->keys_[pos])) {
+      return false;
+    }
+    leaf_erase_at(leaf, pos);
+    size_--;
+    if (height_ == 0) {
+      if (leaf->count_ == 0) {
+        delete_leaf(leaf);
+        root_ = first_ = last_ = nullptr;
+      }
+      return true;
+    }
+    if (leaf->count_ >= kLeafMin) {
+      return true;
+    }
+
+    Inner* parent = path[height_ - 1];
+    const uint_32_cx idx = slots[height_ - 1];
+    Leaf* left = idx > 0 ? static_cast<Leaf*>(parent->children_[idx - 1]) : nullptr;
+    Leaf* right = idx < parent->count_ ? static_cast<Leaf*>(parent->children_[idx + 1]) : nullptr;
+    if (left && left->count_ > kLeafMin) {
+      leaf_insert_at(leaf, 0, std::move(left->keys_[left->count_ - 1]),
+                     std::move(left->values_[left->count_ - 1]));
+      left->count_--;
+      parent->keys_[idx - 1] = leaf->keys_[0];
+      return true;
+    }
+    if (right && right->count_ > kLeafMin) {
+      leaf->keys_[leaf->count_] = std::move(right->keys_[0]);
+      leaf->values_[leaf->count_] = std::move(right->values_[0]);
+      leaf->count_++;
+      leaf_erase_at(right, 0);
+      parent->keys_[idx] = right->keys_[0];
+      return true;
+    }
+    Leaf* dst = left ? left : leaf;
+    Leaf* src = left ? leaf : right;
+    leaf_append(dst, src);
+    unlink(src);
+    delete_leaf(src);
+    inner_erase_at(parent, left ? idx - 1 : idx);
+    rebalance_inner(path, slots, height_ - 1);
+    return true;
+  }
+
+  /**
+   * @return iterator to the first key not less than the given one
+   */
+  [[nodiscard]] inline iterator lower_bound(const K& key) {
+    if (!root_) {
+      return end();
+    }
+    Leaf* leaf = find_leaf(key);
+    const uint_32_cx pos = leaf_lower(leaf, key);
+    return pos == leaf->count_ ? iterator(leaf->next_, 0) : iterator(leaf, pos);
+  }
+  /**
+   * @return iterator to the first key greater than the given one
+   */
+  [[nodiscard]] inline iterator upper_bound(const K& key) {
+    if (!root_) {
+      return end();
+    }
+    Leaf* leaf = find_leaf(key);
+    const uint_32_cx pos = leaf_upper(leaf, key);
+    return pos == leaf->count_ ? iterator(leaf->next_, 0) : iterator(leaf, pos);
+  }
+  /**
+   * Calls the function with every pair with a key in [low, high) in ascending order
+   * @param func callable taking (const K&, V&)
+   */
+  template <typename Function>
+  inline void for_each_range(const K& low, const K& high, Function func) {
+    for (auto it = lower_bound(low); it != end() && comp_(it.key(), high); ++it) {
+      func(it.key(), it.value());
+    }
+  }
+  /**
+   * Calls the function with every pair in ascending key order
+   * @param func callable taking (const K&, V&)
+   */
+  template <typename Function>
+  inline void for_each(Function func) {
+    for (Leaf* leaf = first_; leaf; leaf = leaf->next_) {
+      for (uint_32_cx i = 0; i < leaf->count_; i++) {
+        func(static_cast<const K&>(leaf->keys_[i]), leaf->values_[i]);
+      }
+    }
+  }
+
+  /**
+   * Replaces the content with the given pairs in O(n) - the keys have to be strictly ascending
+   * @param keys sorted keys
+   * @param values values, one per key
+   */
+  template <AllocPolicy P1, AllocPolicy P2>
+  inline void bulk_load(const vec<K, P1>& keys, const vec<V, P2>& values) {
+    CX_ASSERT(keys.size() == values.size(), "one value per key");
+    build_sorted(
+        keys.size(), [&](uint_32_cx i) -> const K& { return keys[i]; },
+        [&](uint_32_cx i) -> const V& { return values[i]; });
+  }
+  /**
+   * Replaces the content with the given pairs in O(n) - the keys have to be strictly ascending
+   * @param pairs (key, value) pairs sorted by key
+   */
+  template <AllocPolicy P>
+  inline void bulk_load(const vec<std::pair<K, V>, P>& pairs) {
+    build_sorted(
+        pairs.size(), [&](uint_32_cx i) -> const K& { return pairs[i].first; },
+        [&](uint_32_cx i) -> const V& { return pairs[i].second; });
+  }
+
+  inline void clear() { destroy_all(); }
+  [[nodiscard]] inline uint_32_cx size() const { return size_; }
+  [[nodiscard]] inline bool empty() const { return size_ == 0; }
+  /**
+   * @return number of levels including the leaves, 0 if empty
+   */
+  [[nodiscard]] inline uint_32_cx height() const { return root_ ? height_ + 1 : 0; }
+  /**
+   * @return iterator to the largest key or end() if empty
+   */
+  [[nodiscard]] inline iterator last() { return last_ ? iterator(last_, last_->count_ - 1) : end(); }
+  [[nodiscard]] inline const_iterator last() const {
+    return last_ ? const_iterator(last_, last_->count_ - 1) : end();
+  }
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.blocks = leaf_count_ + inner_count_;
+    stats.bytes_used = size_ * (sizeof(K) + sizeof(V));
+    stats.bytes_reserved = leaf_count_ * cxhelper::allocation_size<LeafAlloc>(1) +
+                           inner_count_ * cxhelper::allocation_size<InnerAlloc>(1);
+    stats.load_factor =
+        leaf_count_ == 0 ? 0.0F : static_cast<float>(size_) / static_cast<float>(leaf_count_ * kLeafCap);
+    stats.depth = height();
+    return stats;
+  }
+  inline iterator begin() { return iterator(first_, 0); }
+  inline iterator end() { return iterator(nullptr, 0); }
+  inline const_iterator begin() const { return const_iterator(first_, 0); }
+  inline const_iterator end() const { return const_iterator(nullptr, 0); }
+
+#ifndef CX_DELETE_TESTS
+ private:
+  // checks ordering, separator bounds, fill and leaf links - returns the number of keys below the node
+  uint_32_cx validate(void* node, uint_32_cx level, const K* low, const K* high, Leaf*& prev) const {
+    if (level == height_) {
+      auto* leaf = static_cast<Leaf*>(node);
+      CX_ASSERT(leaf->count_ > 0 && leaf->count_ <= kLeafCap, "leaf count");
+      CX_ASSERT(node == root_ || leaf->count_ >= kLeafMin || leaf == last_, "underfull leaf");
+      CX_ASSERT(leaf->prev_ == prev && (prev ? prev->next_ : first_) == leaf, "leaf links");
+      for (uint_32_cx i = 0; i < leaf->count_; i++) {
+        CX_ASSERT(i == 0 || comp_(leaf->keys_[i - 1], leaf->keys_[i]), "unsorted leaf");
+        CX_ASSERT(!low || !comp_(leaf->keys_[i], *low), "key below separator");
+        CX_ASSERT(!high || comp_(leaf->keys_[i], *high), "key above separator");
+      }
+      prev = leaf;
+      return leaf->count_;
+    }
+    auto* inner = static_cast<Inner*>(node);
+    CX_ASSERT(inner->count_ <= kInnerCap, "inner count");
+    CX_ASSERT(node == root_ ? inner->count_ > 0 : inner->count_ >= kInnerMin, "underfull inner");
+    uint_32_cx total = 0;
+    for (uint_32_cx i = 0; i <= inner->count_; i++) {
+      total += validate(inner->children_[i], level + 1, i == 0 ? low : &inner->keys_[i - 1],
+                        i == inner->count_ ? high : &inner->keys_[i], prev);
+    }
+    return total;
+  }
+  void validate() const {
+    if (!root_) {
+      CX_ASSERT(size_ == 0 && !first_ && !last_ && leaf_count_ == 0 && inner_count_ == 0, "empty tree");
+      return;
+    }
+    Leaf* prev = nullptr;
+    CX_ASSERT(validate(root_, 0, nullptr, nullptr, prev) == size_, "size");
+    CX_ASSERT(prev == last_ && !last_->next_, "last leaf");
+  }
+
+ public:
+  static void TEST() {
+    std::cout << "BTREEMAP TESTS" << std::endl;
+    std::cout << "  Testing insertion and lookup..." << std::endl;
+    BTreeMap map1;
+    CX_ASSERT(map1.empty() && map1.height() == 0 && !map1.contains(1), "");
+    const bool inserted = map1.insert(5, 50);
+    const bool reinserted = map1.insert(5, 55);
+    CX_ASSERT(inserted && !reinserted && map1.at(5) == 50, "");
+    const bool assigned_new = map1.insert_or_assign(5, 55);
+    CX_ASSERT(!assigned_new && map1.at(5) == 55, "");
+    map1[7] = 70;
+    CX_ASSERT(map1.size() == 2 && *map1.find(7) == 70 && !map1.find(6), "");
+    bool thrown = false;
+    try {
+      (void)map1.at(6);
+    } catch (const std::out_of_range&) {
+      thrown = true;
+    }
+    CX_ASSERT(thrown, "");
+
+    std::cout << "  Testing monotonic inserts..." << std::endl;
+    BTreeMap map2;
+    for (int i = 0; i < 100000; i++) {
+      map2.insert(i, i * 2);
+    }
+    map2.validate();
+    CX_ASSERT(map2.size() == 100000, "");
+    CX_ASSERT(map2.height() <= 6, "");
+    // appending keeps the leaves full
+    CX_ASSERT(map2.memory_stats().load_factor > 0.99F, "");
+    for (int i = 0; i < 100000; i += 7) {
+      CX_ASSERT(map2.at(i) == i * 2, "");
+    }
+    BTreeMap map3;
+    for (int i = 100000; i > 0; i--) {
+      map3.insert(i, i);
+    }
+    map3.validate();
+    CX_ASSERT(map3.height() <= 7 && map3.begin().key() == 1 && map3.last().key() == 100000, "");
+
+    std::cout << "  Testing iteration and bounds..." << std::endl;
+    int expected = 0;
+    for (auto [key, value] : map2) {
+      CX_ASSERT(key == expected && value == expected * 2, "");
+      expected++;
+    }
+    CX_ASSERT(expected == 100000, "");
+    auto it = map2.last();
+    for (int i = 99999; i >= 0; i--, --it) {
+      CX_ASSERT(it.key() == i, "");
+      if (i == 0) {
+        break;
+      }
+    }
+    BTreeMap map4;
+    for (int i = 0; i < 1000; i += 10) {
+      map4.insert(i, i);
+    }
+    CX_ASSERT(map4.lower_bound(15).key() == 20 && map4.lower_bound(20).key() == 20, "");
+    CX_ASSERT(map4.upper_bound(20).key() == 30 && map4.lower_bound(-5).key() == 0, "");
+    CX_ASSERT(map4.lower_bound(991) == map4.end() && map4.upper_bound(990) == map4.end(), "");
+    int sum = 0;
+    map4.for_each_range(100, 150, [&](const int& key, int& value) {
+      sum += key;
+      value = -1;
+    });
+    CX_ASSERT(sum == 100 + 110 + 120 + 130 + 140 && map4.at(140) == -1 && map4.at(150) == 150, "");
+
+    std::cout << "  Testing erase..." << std::endl;
+    uint_32_cx erased = 0;
+    for (int i = 0; i < 100000; i += 2) {
+      erased += map2.erase(i);
+    }
+    const bool erased_again = map2.erase(0);
+    CX_ASSERT(erased == 50000 && !erased_again && map2.size() == 50000, "");
+    map2.validate();
+    for (int i = 0; i < 100; i++) {
+      CX_ASSERT(map2.contains(i) == (i % 2 == 1), "");
+    }
+    for (int i = 1; i < 100000; i += 2) {
+      erased += map2.erase(i);
+    }
+    CX_ASSERT(erased == 100000, "");
+    map2.validate();
+    CX_ASSERT(map2.empty() && map2.begin() == map2.end() && map2.memory_stats().blocks == 0, "");
+
+    std::cout << "  Testing random operations against std::map..." << std::endl;
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> key_dist(0, 5000);
+    std::map<int, int> reference;
+    BTreeMap map5;
+    for (int i = 0; i < 200000; i++) {
+      const int key = key_dist(gen);
+      if (gen() % 3 == 0) {
+        const bool removed = map5.erase(key);
+        CX_ASSERT(removed == (reference.erase(key) == 1), "");
+      } else {
+        const bool added = map5.insert_or_assign(key, i);
+        CX_ASSERT(added == !reference.contains(key), "");
+        reference[key] = i;
+      }
+      if (i % 20000 == 0) {
+        map5.validate();
+      }
+    }
+    map5.validate();
+    CX_ASSERT(map5.size() == reference.size(), "");
+    auto ref_it = reference.begin();
+    for (auto [key, value] : map5) {
+      CX_ASSERT(key == ref_it->first && value == ref_it->second, "");
+      ++ref_it;
+    }
+    for (int i = 0; i < 1000; i++) {
+      const int key = key_dist(gen);
+      auto ref_lower = reference.lower_bound(key);
+      auto lower = map5.lower_bound(key);
+      CX_ASSERT((ref_lower == reference.end()) == (lower == map5.end()), "");
+      CX_ASSERT(lower == map5.end() || lower.key() == ref_lower->first, "");
+    }
+
+    std::cout << "  Testing bulk_load..." << std::endl;
+    const uint_32_cx sizes[] = {0, 1, kLeafCap, kLeafCap + 1, 1000, 54321};
+    for (uint_32_cx n : sizes) {
+      vec<int> keys;
+      vec<int> values;
+      for (uint_32_cx i = 0; i < n; i++) {
+        keys.push_back(static_cast<int>(i * 3));
+        values.push_back(static_cast<int>(i));
+      }
+      BTreeMap map6;
+      map6.insert(-1, -1);
+      map6.bulk_load(keys, values);
+      map6.validate();
+      CX_ASSERT(map6.size() == n && !map6.contains(-1), "");
+      for (uint_32_cx i = 0; i < n; i++) {
+        CX_ASSERT(map6.at(static_cast<int>(i * 3)) == static_cast<int>(i), "");
+      }
+      // the tree keeps working after a bulk load
+      for (int i = 1; i < 3000; i += 3) {
+        map6.insert(i, i);
+      }
+      for (int i = 0; i < 3000; i += 2) {
+        map6.erase(i);
+      }
+      map6.validate();
+    }
+    vec<std::pair<int, int>> pairs;
+    for (int i = 0; i < 500; i++) {
+      pairs.push_back({i, -i});
+    }
+    BTreeMap map7;
+    map7.bulk_load(pairs);
+    map7.validate();
+    CX_ASSERT(map7.size() == 500 && map7.at(499) == -499, "");
+
+    std::cout << "  Testing copy and move..." << std::endl;
+    BTreeMap map8(map7);
+    map8.validate();
+    map8.erase(0);
+    CX_ASSERT(map8.size() == 499 && map7.size() == 500, "");
+    BTreeMap map9(std::move(map8));
+    CX_ASSERT(map9.size() == 499 && map8.empty(), "");
+    map8 = map9;
+    map8.validate();
+    CX_ASSERT(map8.size() == 499 && map8.at(1) == -1, "");
+
+    std::cout << "  Testing custom compare and string keys..." << std::endl;
+    BTreeMap<int, int, std::greater<int>> bids;
+    for (int price : {100, 105, 99, 101}) {
+      bids.insert(price, price);
+    }
+    CX_ASSERT(bids.begin().key() == 105 && bids.last().key() == 99, "");
+    BTreeMap<std::string, int> words;
+    for (int i = 0; i < 2000; i++) {
+      words.insert("key" + std::to_string(i), i);
+    }
+    CX_ASSERT(words.size() == 2000 && words.at("key1999") == 1999 && words.begin().key() == "key0", "");
+    CX_ASSERT(words.lower_bound("key2").key() == "key2" && words.upper_bound("key2").key() == "key20", "");
+
+    std::cout << "  Testing memory_stats..." << std::endl;
+    auto stats = map7.memory_stats();
+    CX_ASSERT(stats.elements == 500 && stats.depth == map7.height() && stats.blocks > 500 / kLeafCap, "");
+    CX_ASSERT(stats.bytes_reserved >= stats.blocks * sizeof(Inner), "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_BTREEMAP_H_
@@ -59,12 +59,24 @@ using namespace cxhelper;
  * While accessing or searching for a specific element in a binary tree requires traversing potentially half the tree,
  * a balanced binary tree allows for faster lookup times of O(log N).
  */
-template <typename T>
+template <typename T, AllocPolicy Policy = PoolAlloc>
 class BinaryTree {
   using TNode = TreeNode<T>;
+  using Allocator = cxhelper::policy_allocator_t<TNode, Policy>;
+  Allocator alloc;
   TNode* root_;
   uint_32_cx size_;
 
+  inline TNode* new_node(const T& val) {
+    TNode* node = alloc.allocate(1);
+    std::allocator_traits<Allocator>::construct(alloc, node, val);
+    return node;
+  }
+  inline void delete_node(TNode* node) {
+    std::allocator_traits<Allocator>::destroy(alloc, node);
+    alloc.deallocate(node, 1);
+  }
+
   inline int subTreeDepth(TNode* node) {
     if (!node) {
       return 0;
@@ -74,31 +86,23 @@ class BinaryTree {
       return std::max(left, right) + 1;
     }
   }
+  // iterative - a degenerated (sorted input) tree is as deep as it is large
   inline void insert(const T& val, TNode* node) {
-    if (val < node->data_) {
-      if (!node->left_) {
-        node->left_ = new TNode(val);
-      } else
-        insert(val, node->left_);
-    } else {
-      if (!node->right_) {
-        node->right_ = new TNode(val);
-      } else
-        insert(val, node->right_);
+    while (true) {
+      TNode*& child = val < node->data_ ? node->left_ : node->right_;
+      if (!child) {
+        child = new_node(val);
+        return;
+      }
+      node = child;
     }
   }
   inline bool contains(const T& val, TNode* node) const {
-    if (node) {
+    while (node) {
       if (val < node->data_) {
-        if (node->left_) {
-          return contains(val, node->left_);
-        }
-        return false;
+        node = node->left_;
       } else if (val > node->data_) {
-        if (node->right_) {
-          return contains(val, node->right_);
-        }
-        return false;
+        node = node->right_;
       } else {
         return true;
       }
@@ -117,12 +121,12 @@ class BinaryTree {
     } else {
       if (!node->left_) {
         TNode* temp = node->right_;
-        delete node;
+        delete_node(node);
         size_--;
         return temp;
       } else if (!node->right_) {
         TNode* temp = node->left_;
-        delete node;
+        delete_node(node);
         size_--;
         return temp;
       }
@@ -150,6 +154,9 @@ class BinaryTree {
   BinaryTree(BinaryTree&&) = delete;
   BinaryTree& operator=(BinaryTree&&) = delete;
   ~BinaryTree() {
+    if (!root_) {
+      return;
+    }
     std::deque<TNode*> nodesToDelete;
     nodesToDelete.push_back(root_);
 
@@ -164,7 +171,7 @@ class BinaryTree {
         nodesToDelete.push_back(node->right_);
       }
 
-      delete node;
+      delete_node(node);
     }
   }
   /**
@@ -200,12 +207,12 @@ class BinaryTree {
       size_++;
     } else {
       size_++;
-      root_ = new TNode(val);
+      root_ = new_node(val);
     }
   }
 
   /**
-   * Recursively searches the tree for the given value
+   * Searches the tree for the given value
    * @param val - the value to search for
    * @return - true if the tree contained the given value, false otherwise
    */
@@ -226,6 +233,9 @@ class BinaryTree {
    After the operation, the tree becomes empty and its size is 0
    **/
   inline void clear() {
+    if (!root_) {
+      return;
+    }
     std::deque<TNode*> nodesToDelete;
     nodesToDelete.push_back(root_);
 
@@ -240,7 +250,7 @@ class BinaryTree {
         nodesToDelete.push_back(node->right_);
       }
 
-      delete node;
+      delete_node(node);
     }
     size_ = 0;
     root_ = nullptr;
@@ -260,6 +270,33 @@ class BinaryTree {
    * @return the maximum depth of the tree
    */
   uint_32_cx maxDepth() { return subTreeDepth(root_); }
+  /**
+   * Walks the whole tree for its depth
+   * @return the heap memory of this tree - one node per element
+   */
+  [[nodiscard]] MemoryStats memory_stats() const {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.blocks = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    stats.bytes_reserved = size_ * cxhelper::allocation_size<Allocator>(1);
+    std::vector<std::pair<TNode*, uint_32_cx>> stack;
+    if (root_) {
+      stack.emplace_back(root_, 1);
+    }
+    while (!stack.empty()) {
+      auto [node, depth] = stack.back();
+      stack.pop_back();
+      stats.depth = std::max(stats.depth, depth);
+      if (node->left_) {
+        stack.emplace_back(node->left_, depth + 1);
+      }
+      if (node->right_) {
+        stack.emplace_back(node->right_, depth + 1);
+      }
+    }
+    return stats;
+  }
 
   class InOrderIterator {
     std::deque<TNode*> nodes;
@@ -378,6 +415,15 @@ class BinaryTree {
       CX_ASSERT(num >= prev_num, "sort check");
       prev_num = num;
     }
+
+    std::cout << "  Testing memory_stats..." << std::endl;
+    BinaryTree<int> bt3;
+    for (int i = 0; i < 10; i++) {
+      bt3.insert(i);
+    }
+    auto stats = bt3.memory_stats();
+    CX_ASSERT(stats.elements == 10 && stats.depth == 10 && stats.blocks == 10, "");
+    CX_ASSERT(stats.bytes_reserved >= 10 * sizeof(TreeNode<int>), "");
   }
 #endif
 };
@@ -0,0 +1,257 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_BLOOMFILTER_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_BLOOMFILTER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+
+namespace cxhelper {
+/**
+ * Default filter policy of HashSet and HashMap - keeps no state and lets every lookup through
+ */
+struct NoFilter {
+  static constexpr bool enabled = false;
+  inline void reset(size_t) noexcept {}
+  inline void insert_hash(uint64_t) noexcept {}
+  [[nodiscard]] inline bool may_contain_hash(uint64_t) const noexcept { return true; }
+  [[nodiscard]] inline size_t memory_usage() const noexcept { return 0; }
+};
+
+// odd constants from the Impala / Parquet filters, each picks the bit of one word of a block
+alignas(32) inline constexpr uint32_t kBloomSalt[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                       0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+inline void bloom_insert_scalar(uint32_t* block, uint32_t h) noexcept {
+  for (int i = 0; i < 8; i++) {
+    block[i] |= 1U << ((h * kBloomSalt[i]) >> 27);
+  }
+}
+inline bool bloom_test_scalar(const uint32_t* block, uint32_t h) noexcept {
+  uint32_t missing = 0;
+  for (int i = 0; i < 8; i++) {
+    missing |= ~block[i] & (1U << ((h * kBloomSalt[i]) >> 27));
+  }
+  return missing == 0;
+}
+#if defined(CX_X86_DISPATCH)
+CX_TARGET_AVX2 inline __m256i bloom_mask_avx2(uint32_t h) noexcept {
+  const __m256i salt = _mm256_load_si256(reinterpret_cast<const __m256i*>(kBloomSalt));
+  const __m256i bit = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(h)), salt), 27);
+  return _mm256_sllv_epi32(_mm256_set1_epi32(1), bit);
+}
+CX_TARGET_AVX2 inline void bloom_insert_avx2(uint32_t* block, uint32_t h) noexcept {
+  auto* words = reinterpret_cast<__m256i*>(block);
+  _mm256_store_si256(words, _mm256_or_si256(_mm256_load_si256(words), bloom_mask_avx2(h)));
+}
+CX_TARGET_AVX2 inline bool bloom_test_avx2(const uint32_t* block, uint32_t h) noexcept {
+  const __m256i words = _mm256_load_si256(reinterpret_cast<const __m256i*>(block));
+  return _mm256_testc_si256(words, bloom_mask_avx2(h)) != 0;
+}
+#endif
+/**
+ * Sets the 8 bits of h in a 32 byte aligned block
+ */
+inline void bloom_insert(uint32_t* block, uint32_t h) noexcept {
+#if defined(CX_AVX2)
+  bloom_insert_avx2(block, h);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = select_isa(bloom_insert_scalar, bloom_insert_avx2);
+  kernel(block, h);
+#else
+  bloom_insert_scalar(block, h);
+#endif
+}
+/**
+ * @return true if all 8 bits of h are set in the block
+ */
+inline bool bloom_test(const uint32_t* block, uint32_t h) noexcept {
+#if defined(CX_AVX2)
+  return bloom_test_avx2(block, h);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = select_isa(bloom_test_scalar, bloom_test_avx2);
+  return kernel(block, h);
+#else
+  return bloom_test_scalar(block, h);
+#endif
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>BloomFilter</h2>
+ * Split block Bloom filter: every key sets 8 bits inside one 32 byte block, one bit in each 32 bit word of it.
+ * A lookup therefore costs one cache miss and an absent key is rejected without touching the table behind it.
+ * With AVX2 the 8 bit positions are computed and tested with a handful of vector instructions - picked at
+ * runtime when the build target lacks it.
+ * <br><br>
+ * There are no false negatives. The false positive rate is about the one given to reset() as long as no more
+ * keys than expected are inserted. Keys cant be removed - a container in front of which the filter sits
+ * rebuilds it instead.
+ * <br><br>
+ * Usable standalone or as the Filter policy of HashSet / HashMap:
+ * <pre>
+ * HashSet<std::string, cxstructs::hash<std::string>, BloomFilter<>> seen;
+ * if (!seen.contains(line)) { ... } // misses are answered by the filter
+ * </pre>
+ * @tparam K the key type
+ * @tparam Hash the hash of the key, remixed by the filter
+ */
+template <typename K = uint64_t, typename Hash = cxstructs::hash<K>>
+class BloomFilter {
+  struct alignas(32) Block {
+    uint32_t words[8];
+  };
+  std::vector<Block> blocks_;
+  Hash hash_func_;
+  size_t inserted_ = 0;
+  double fp_rate_;
+
+  [[nodiscard]] inline const Block& block_of(uint64_t h) const noexcept {
+    return blocks_[((h >> 32) * blocks_.size()) >> 32];
+  }
+  [[nodiscard]] inline Block& block_of(uint64_t h) noexcept {
+    return blocks_[((h >> 32) * blocks_.size()) >> 32];
+  }
+
+ public:
+  /**
+   * @param expected number of keys the filter is sized for
+   * @param fp_rate targeted false positive rate
+   */
+  explicit BloomFilter(size_t expected = 1024, double fp_rate = 0.01)
+      : hash_func_(cxhelper::default_hash_func<Hash, K>()), fp_rate_(fp_rate) {
+    reset(expected);
+  }
+  /**
+   * Clears the filter and resizes it for the given number of keys
+   * @param expected number of keys
+   */
+  inline void reset(size_t expected) {
+    // about 1.44 * log2(1 / p) bits per key for a classic filter, blocking costs roughly 15% more
+    const double bits_per_key = std::max(4.0, 1.65 * std::log2(1.0 / fp_rate_));
+    const auto bits = static_cast<size_t>(static_cast<double>(std::max<size_t>(expected, 1)) * bits_per_key);
+    blocks_ = std::vector<Block>(std::max<size_t>(1, (bits + 255) / 256));
+    inserted_ = 0;
+  }
+  /**
+   * Clears the filter, keeps its size
+   */
+  inline void clear() noexcept {
+    std::fill(blocks_.begin(), blocks_.end(), Block{});
+    inserted_ = 0;
+  }
+  /**
+   * Adds a key by a hash value, the container interface - h is remixed, any hash works
+   */
+  inline void insert_hash(uint64_t h) noexcept {
+    h = hash_int(h);
+    cxhelper::bloom_insert(block_of(h).words, static_cast<uint32_t>(h));
+    inserted_++;
+  }
+  /**
+   * @return false if no key with this hash was inserted, true if one probably was
+   */
+  [[nodiscard]] inline bool may_contain_hash(uint64_t h) const noexcept {
+    h = hash_int(h);
+    return cxhelper::bloom_test(block_of(h).words, static_cast<uint32_t>(h));
+  }
+  /**
+   * Adds a key
+   */
+  inline void insert(const K& key) noexcept { insert_hash(hash_func_(key)); }
+  /**
+   * @return false if the key was never inserted, true if it probably was
+   */
+  [[nodiscard]] inline bool may_contain(const K& key) const noexcept { return may_contain_hash(hash_func_(key)); }
+  /**
+   * Fetches the block of a key ahead of a later lookup
+   */
+  inline void prefetch(const K& key) const noexcept { CX_PREFETCH(&block_of(hash_int(hash_func_(key)))); }
+  /**
+   * @return the number of inserts since the last reset - repeated keys count again
+   */
+  [[nodiscard]] inline size_t inserted() const noexcept { return inserted_; }
+  [[nodiscard]] inline size_t memory_usage() const noexcept { return blocks_.capacity() * sizeof(Block); }
+  static constexpr bool enabled = true;
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "BLOOM FILTER TESTS" << std::endl;
+    std::cout << "  Testing no false negatives..." << std::endl;
+    BloomFilter<uint64_t> filter(10000);
+    for (uint64_t i = 0; i < 10000; i++) {
+      filter.insert(i * 7919);
+    }
+    bool all = true;
+    for (uint64_t i = 0; i < 10000; i++) {
+      all &= filter.may_contain(i * 7919);
+    }
+    CX_ASSERT(all && filter.inserted() == 10000, "");
+
+    std::cout << "  Testing kernels agree..." << std::endl;
+    alignas(32) uint32_t scalar_block[8]{};
+    alignas(32) uint32_t block[8]{};
+    bool same = true;
+    for (uint64_t i = 0; i < 64; i++) {
+      const auto h = static_cast<uint32_t>(hash_int(i));
+      same &= cxhelper::bloom_test(block, h) == cxhelper::bloom_test_scalar(scalar_block, h);
+      cxhelper::bloom_insert_scalar(scalar_block, h);
+      cxhelper::bloom_insert(block, h);
+      same &= std::equal(block, block + 8, scalar_block) && cxhelper::bloom_test(block, h);
+    }
+    CX_ASSERT(same, "");
+
+    std::cout << "  Testing false positive rate..." << std::endl;
+    uint64_t false_positives = 0;
+    for (uint64_t i = 0; i < 100000; i++) {
+      false_positives += filter.may_contain(i * 7919 + 1);
+    }
+    CX_ASSERT(false_positives < 2000, "");
+    BloomFilter<uint64_t> tight(10000, 0.001);
+    for (uint64_t i = 0; i < 10000; i++) {
+      tight.insert(i * 7919);
+    }
+    uint64_t tight_positives = 0;
+    for (uint64_t i = 0; i < 100000; i++) {
+      tight_positives += tight.may_contain(i * 7919 + 1);
+    }
+    CX_ASSERT(tight_positives < 300 && tight.memory_usage() > filter.memory_usage(), "");
+
+    std::cout << "  Testing clear and reset..." << std::endl;
+    filter.clear();
+    CX_ASSERT(!filter.may_contain(7919) && filter.inserted() == 0, "");
+    filter.reset(10);
+    filter.insert(3);
+    CX_ASSERT(filter.may_contain(3) && filter.memory_usage() == 32, "");
+
+    BloomFilter<std::string> words(100);
+    words.insert("apple");
+    words.insert("pear");
+    words.prefetch("plum");
+    CX_ASSERT(words.may_contain("apple") && words.may_contain("pear"), "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_BLOOMFILTER_H_
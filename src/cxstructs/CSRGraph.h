@@ -0,0 +1,279 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_CSRGRAPH_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_CSRGRAPH_H_
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+
+namespace cxstructs {
+
+/**
+ * <h2>CSRGraph</h2>
+ * Immutable graph in compressed sparse row form, built once from an edge list.
+ * <br><br>
+ * The out-edges of vertex v are the targets in [offsets[v], offsets[v + 1]), one flat array for the whole
+ * graph. That is O(V + E) memory instead of O(V²) for an adjacency matrix and visiting the neighbours of a
+ * vertex is one sequential scan. Building is a counting sort by source: one pass counts the degrees, a prefix
+ * sum gives the offsets and a second pass scatters the targets.
+ * <br><br>
+ * Weights are optional, an unweighted graph stores none and weight() returns 1.<p>
+ * An undirected graph stores every edge in both directions and is its own transpose.<p>
+ * Searches over it are in cxalgos/GraphTraversal.h.
+ * <pre>
+ * std::vector<CSRGraph<>::Edge> edges = {{0, 1, 2.5F}, {1, 2, 1.0F}};
+ * CSRGraph<> graph(3, edges);
+ * for (uint32_t u : graph.neighbours(1)) { ... }
+ * </pre>
+ * @tparam Weight edge weight type
+ */
+template <typename Weight = float>
+class CSRGraph {
+ public:
+  using Vertex = uint32_t;
+  using EdgeIndex = uint64_t;
+  struct Edge {
+    Vertex from;
+    Vertex to;
+    Weight weight = Weight(1);
+  };
+  // no vertex - unreached depth or the parent of a root
+  static constexpr Vertex kNone = UINT32_MAX;
+
+ private:
+  std::vector<EdgeIndex> offsets_;
+  std::vector<Vertex> targets_;
+  std::vector<Weight> weights_;  // empty if unweighted
+  bool symmetric_ = false;
+
+  // counting sort of the edges by source, Get(i) returns {from, to, weight}
+  template <bool Weighted, typename Get>
+  void build(Vertex vertices, std::size_t count, Get get) {
+    const EdgeIndex total = symmetric_ ? 2 * static_cast<EdgeIndex>(count) : count;
+    offsets_.assign(static_cast<std::size_t>(vertices) + 1, 0);
+    for (std::size_t i = 0; i < count; i++) {
+      const Edge e = get(i);
+      CX_ASSERT(e.from < vertices && e.to < vertices, "vertex out of range");
+      offsets_[e.from + 1]++;
+      if (symmetric_) {
+        offsets_[e.to + 1]++;
+      }
+    }
+    for (Vertex v = 0; v < vertices; v++) {
+      offsets_[v + 1] += offsets_[v];
+    }
+    targets_.resize(total);
+    if constexpr (Weighted) {
+      weights_.resize(total);
+    }
+    // offsets_[v] is the next free slot of v while scattering and ends up at the start of v + 1
+    for (std::size_t i = 0; i < count; i++) {
+      const Edge e = get(i);
+      const EdgeIndex slot = offsets_[e.from]++;
+      targets_[slot] = e.to;
+      if constexpr (Weighted) {
+        weights_[slot] = e.weight;
+      }
+      if (symmetric_) {
+        const EdgeIndex back = offsets_[e.to]++;
+        targets_[back] = e.from;
+        if constexpr (Weighted) {
+          weights_[back] = e.weight;
+        }
+      }
+    }
+    for (Vertex v = vertices; v > 0; v--) {
+      offsets_[v] = offsets_[v - 1];
+    }
+    offsets_[0] = 0;
+  }
+
+ public:
+  CSRGraph() : offsets_(1, 0) {}
+  /**
+   * Builds a weighted graph
+   * @param vertices number of vertices, ids are [0, vertices)
+   * @param edges the edges, order doesnt matter
+   * @param undirected if true every edge is stored in both directions
+   */
+  CSRGraph(Vertex vertices, std::span<const Edge> edges, bool undirected = false)
+      : symmetric_(undirected) {
+    build<true>(vertices, edges.size(), [&edges](std::size_t i) { return edges[i]; });
+  }
+  /**
+   * Builds an unweighted graph - all weights are 1
+   * @param vertices number of vertices, ids are [0, vertices)
+   * @param edges the edges as {from, to}, order doesnt matter
+   * @param undirected if true every edge is stored in both directions
+   */
+  CSRGraph(Vertex vertices, std::span<const std::pair<Vertex, Vertex>> edges, bool undirected = false)
+      : symmetric_(undirected) {
+    build<false>(vertices, edges.size(),
+                 [&edges](std::size_t i) { return Edge{edges[i].first, edges[i].second}; });
+  }
+  /**
+   * @return the graph with every edge reversed - a copy for undirected graphs
+   */
+  [[nodiscard]] CSRGraph transpose() const {
+    if (symmetric_) {
+      return *this;
+    }
+    const Vertex n = vertices();
+    CSRGraph result;
+    // same counting sort as build(), keyed by target
+    result.offsets_.assign(static_cast<std::size_t>(n) + 1, 0);
+    for (Vertex t : targets_) {
+      result.offsets_[t + 1]++;
+    }
+    for (Vertex v = 0; v < n; v++) {
+      result.offsets_[v + 1] += result.offsets_[v];
+    }
+    result.targets_.resize(targets_.size());
+    if (weighted()) {
+      result.weights_.resize(weights_.size());
+    }
+    std::vector<EdgeIndex> next(result.offsets_.begin(), result.offsets_.end() - 1);
+    for (Vertex v = 0; v < n; v++) {
+      for (EdgeIndex e = offsets_[v]; e < offsets_[v + 1]; e++) {
+        const EdgeIndex slot = next[targets_[e]]++;
+        result.targets_[slot] = v;
+        if (weighted()) {
+          result.weights_[slot] = weights_[e];
+        }
+      }
+    }
+    return result;
+  }
+  /**
+   * @return the number of vertices
+   */
+  [[nodiscard]] inline Vertex vertices() const noexcept {
+    return static_cast<Vertex>(offsets_.size() - 1);
+  }
+  /**
+   * @return the number of stored edges - twice the input edges for undirected graphs
+   */
+  [[nodiscard]] inline EdgeIndex edges() const noexcept { return targets_.size(); }
+  /**
+   * @return true if the graph was built undirected and is its own transpose
+   */
+  [[nodiscard]] inline bool symmetric() const noexcept { return symmetric_; }
+  /**
+   * @return true if the graph stores weights
+   */
+  [[nodiscard]] inline bool weighted() const noexcept { return !weights_.empty(); }
+  /**
+   * @return the number of out-edges of v
+   */
+  [[nodiscard]] inline EdgeIndex degree(Vertex v) const noexcept {
+    CX_ASSERT(v < vertices(), "vertex out of range");
+    return offsets_[v + 1] - offsets_[v];
+  }
+  /**
+   * @return index of the first out-edge of v - its edges are [edge_begin(v), edge_end(v))
+   */
+  [[nodiscard]] inline EdgeIndex edge_begin(Vertex v) const noexcept { return offsets_[v]; }
+  /**
+   * @return one past the index of the last out-edge of v
+   */
+  [[nodiscard]] inline EdgeIndex edge_end(Vertex v) const noexcept { return offsets_[v + 1]; }
+  /**
+   * @return the target vertex of edge e
+   */
+  [[nodiscard]] inline Vertex target(EdgeIndex e) const noexcept { return targets_[e]; }
+  /**
+   * @return the weight of edge e, 1 if the graph is unweighted
+   */
+  [[nodiscard]] inline Weight weight(EdgeIndex e) const noexcept {
+    return weights_.empty() ? Weight(1) : weights_[e];
+  }
+  /**
+   * @return the targets of the out-edges of v
+   */
+  [[nodiscard]] inline std::span<const Vertex> neighbours(Vertex v) const noexcept {
+    CX_ASSERT(v < vertices(), "vertex out of range");
+    return {targets_.data() + offsets_[v], static_cast<std::size_t>(offsets_[v + 1] - offsets_[v])};
+  }
+  /**
+   * @return the weights of the out-edges of v, parallel to neighbours(v) - empty if unweighted
+   */
+  [[nodiscard]] inline std::span<const Weight> weights(Vertex v) const noexcept {
+    if (weights_.empty()) {
+      return {};
+    }
+    return {weights_.data() + offsets_[v], static_cast<std::size_t>(offsets_[v + 1] - offsets_[v])};
+  }
+  /**
+   * @return the bytes held by the offset, target and weight arrays
+   */
+  [[nodiscard]] inline std::size_t memory_usage() const noexcept {
+    return offsets_.capacity() * sizeof(EdgeIndex) + targets_.capacity() * sizeof(Vertex) +
+           weights_.capacity() * sizeof(Weight);
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "CSR GRAPH TESTS" << std::endl;
+    std::cout << "  Testing build..." << std::endl;
+    std::vector<Edge> edges = {{2, 0, 4}, {0, 1, 1}, {0, 2, 2}, {3, 1, 5}, {1, 2, 3}};
+    CSRGraph<Weight> g(4, edges);
+    CX_ASSERT(g.vertices() == 4 && g.edges() == 5, "");
+    CX_ASSERT(g.weighted() && !g.symmetric(), "");
+    CX_ASSERT(g.degree(0) == 2 && g.degree(1) == 1 && g.degree(2) == 1 && g.degree(3) == 1, "");
+    // input order is kept within a vertex
+    CX_ASSERT(g.neighbours(0)[0] == 1 && g.neighbours(0)[1] == 2, "");
+    CX_ASSERT(g.weights(0)[0] == 1 && g.weights(0)[1] == 2, "");
+    CX_ASSERT(g.neighbours(3)[0] == 1 && g.weights(3)[0] == 5, "");
+    CX_ASSERT(g.target(g.edge_begin(2)) == 0 && g.weight(g.edge_begin(2)) == 4, "");
+
+    std::cout << "  Testing transpose..." << std::endl;
+    auto t = g.transpose();
+    CX_ASSERT(t.edges() == 5 && t.degree(0) == 1 && t.degree(1) == 2 && t.degree(2) == 2, "");
+    CX_ASSERT(t.degree(3) == 0 && t.neighbours(3).empty(), "");
+    CX_ASSERT(t.neighbours(0)[0] == 2 && t.weights(0)[0] == 4, "");
+    CX_ASSERT(t.neighbours(1)[0] == 0 && t.neighbours(1)[1] == 3 && t.weights(1)[1] == 5, "");
+    auto tt = t.transpose();
+    for (Vertex v = 0; v < 4; v++) {
+      CX_ASSERT(tt.degree(v) == g.degree(v), "");
+      for (EdgeIndex i = 0; i < g.degree(v); i++) {
+        CX_ASSERT(tt.neighbours(v)[i] == g.neighbours(v)[i], "");
+        CX_ASSERT(tt.weights(v)[i] == g.weights(v)[i], "");
+      }
+    }
+
+    std::cout << "  Testing undirected and unweighted..." << std::endl;
+    std::vector<std::pair<Vertex, Vertex>> pairs = {{0, 1}, {1, 2}, {2, 0}};
+    CSRGraph<Weight> u(5, pairs, true);
+    CX_ASSERT(u.symmetric() && !u.weighted(), "");
+    CX_ASSERT(u.edges() == 6 && u.degree(0) == 2 && u.degree(4) == 0, "");
+    CX_ASSERT(u.weight(0) == 1 && u.weights(0).empty(), "");
+    CX_ASSERT(u.transpose().edges() == 6, "");
+
+    CSRGraph<Weight> empty;
+    CX_ASSERT(empty.vertices() == 0 && empty.edges() == 0, "");
+    CX_ASSERT(empty.transpose().vertices() == 0, "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_CSRGRAPH_H_
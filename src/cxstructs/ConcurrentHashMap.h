@@ -0,0 +1,305 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTHASHMAP_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTHASHMAP_H_
+
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "../cxconfig.h"
+#include "HashMap.h"
+
+// Thread safe HashMap made out of independently locked HashMap shards
+// The shard is picked from the upper bits of the hash, the shard itself uses the lower bits for its buckets
+// Readers of the same shard share the lock, writers only block their own shard
+
+namespace cxstructs {
+
+/**
+ * <h2>ConcurrentHashMap</h2>
+ * A key-value store that can be used from many threads at once.
+ * <br><br>
+ * The keys are spread over a power of two number of shards. Each shard is a normal cxstructs::HashMap
+ * guarded by its own reader-writer lock, so all hashing, rehashing and load factor logic is the one of the HashMap.
+ * Threads only contend when they access the same shard at the same time and at least one of them writes.
+ * <br><br>
+ * Values are always returned by copy as references would escape the lock.
+ *
+ * @tparam K key type
+ * @tparam V value type
+ * @tparam Hash hash function - the upper bits select the shard so it should be well distributed
+ */
+template <typename K, typename V, typename Hash = cxstructs::hash<K>>
+class ConcurrentHashMap {
+  using Map = HashMap<K, V, Hash>;
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex_;
+    Map map_;
+    Shard(const Hash& hash, uint_32_cx initialCapacity, float loadFactor)
+        : map_(hash, initialCapacity, loadFactor) {}
+  };
+
+  std::vector<Shard*> shards_;
+  uint_32_cx shard_shift_;
+  Hash hash_func_;
+
+  [[nodiscard]] inline Shard& shard_of(const K& key) const {
+    // multiply to pull entropy into the top bits, hash functions like std::hash<int> leave them empty
+    const uint64_t h = static_cast<uint64_t>(hash_func_(key)) * 0x9E3779B97F4A7C15ULL;
+    return *shards_[shard_shift_ == 64 ? 0 : h >> shard_shift_];
+  }
+
+ public:
+  /**
+   * @param shardCount number of independently locked shards - rounded to the next power of two
+   * @param initialCapacity the initial capacity of each shard
+   * @param loadFactor the load factor of each shard
+   */
+  explicit ConcurrentHashMap(uint_32_cx shardCount = 32, uint_32_cx initialCapacity = 64,
+                             float loadFactor = 0.9)
+      : ConcurrentHashMap(default_hash_func<Hash, K>(), shardCount, initialCapacity, loadFactor) {}
+  /**
+   * This constructor allows the user to supply their own hash function for the key type
+   * @param hash_function this function is called with any given key with type K
+   * @param shardCount number of independently locked shards - rounded to the next power of two
+   * @param initialCapacity the initial capacity of each shard
+   * @param loadFactor the load factor of each shard
+   */
+  explicit ConcurrentHashMap(Hash hash_function, uint_32_cx shardCount = 32,
+                             uint_32_cx initialCapacity = 64, float loadFactor = 0.9)
+      : hash_func_(std::move(hash_function)) {
+    shardCount = next_power_of_2(shardCount < 1 ? 1 : shardCount);
+    shard_shift_ = 64 - std::countr_zero(static_cast<uint64_t>(shardCount));
+    shards_.reserve(shardCount);
+    for (uint_32_cx i = 0; i < shardCount; i++) {
+      shards_.push_back(new Shard(hash_func_, initialCapacity, loadFactor));
+    }
+  }
+  ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+  ~ConcurrentHashMap() {
+    for (auto shard : shards_) {
+      delete shard;
+    }
+  }
+  /**
+   * Inserts the key, value Pair or replaces the value if the key already exists
+   * @param key - the key to access the stored element
+   * @param val - the stored value at the given key
+   * @return true if the key was newly inserted
+   */
+  inline bool insert_or_assign(const K& key, const V& val) {
+    Shard& shard = shard_of(key);
+    std::unique_lock lock(shard.mutex_);
+    const auto old_size = shard.map_.size();
+    shard.map_.insert(key, val);
+    return shard.map_.size() != old_size;
+  }
+  /**
+   * Same as insert_or_assign() - keeps the HashMap interface
+   */
+  inline void insert(const K& key, const V& val) { insert_or_assign(key, val); }
+  /**
+   * Looks up the value of the given key
+   * @param key the key to search for
+   * @return a copy of the value or an empty optional if the key doesnt exist
+   */
+  [[nodiscard]] inline std::optional<V> find(const K& key) const {
+    Shard& shard = shard_of(key);
+    std::shared_lock lock(shard.mutex_);
+    V* val = shard.map_.find(key);
+    if (val) {
+      return *val;
+    }
+    return std::nullopt;
+  }
+  /**
+   * @param key the key to search for
+   * @return true if the key is present in the map
+   */
+  [[nodiscard]] inline bool contains(const K& key) const {
+    Shard& shard = shard_of(key);
+    std::shared_lock lock(shard.mutex_);
+    return shard.map_.contains(key);
+  }
+  /**
+   * Removes this key, value Pair from the map
+   * @param key - they key to be removed
+   * @return true if the key existed
+   */
+  inline bool erase(const K& key) {
+    Shard& shard = shard_of(key);
+    std::unique_lock lock(shard.mutex_);
+    const auto old_size = shard.map_.size();
+    shard.map_.erase(key);
+    return shard.map_.size() != old_size;
+  }
+  /**
+   * Atomically updates the value of the given key with func(V&), default constructing it if missing
+   * @param key the key to update
+   * @param func callable taking V&
+   */
+  template <typename Function>
+  inline void update(const K& key, Function func) {
+    Shard& shard = shard_of(key);
+    std::unique_lock lock(shard.mutex_);
+    V* val = shard.map_.find(key);
+    if (!val) {
+      shard.map_.insert(key, V());
+      val = shard.map_.find(key);
+    }
+    func(*val);
+  }
+  /**
+   * Reserves space for n elements spread evenly across all shards
+   * @param n the number of elements to make room for
+   */
+  inline void reserve(uint_32_cx n) {
+    for (auto shard : shards_) {
+      std::unique_lock lock(shard->mutex_);
+      shard->map_.reserve(n / shards_.size() + 1);
+    }
+  }
+  /**
+   * Locks every shard in turn, so the result can be outdated under concurrent writes
+   * @return the number of elements
+   */
+  [[nodiscard]] inline uint_32_cx size() const {
+    uint_32_cx size = 0;
+    for (auto shard : shards_) {
+      std::shared_lock lock(shard->mutex_);
+      size += shard->map_.size();
+    }
+    return size;
+  }
+  [[nodiscard]] inline bool empty() const { return size() == 0; }
+  [[nodiscard]] inline uint_32_cx shard_count() const { return shards_.size(); }
+  /**
+   * Clears all shards of their contents
+   */
+  inline void clear() {
+    for (auto shard : shards_) {
+      std::unique_lock lock(shard->mutex_);
+      shard->map_.clear();
+    }
+  }
+  /**
+   * Calls func(shard_index, const HashMap&) for every shard while holding its read lock<p>
+   * With threads > 1 the shards are distributed over that many threads, so func has to be thread safe
+   * @param func callable taking (uint_32_cx, const HashMap<K,V,Hash>&)
+   * @param threads number of threads to visit the shards with
+   */
+  template <typename Function>
+  inline void for_each_shard(Function func, uint_32_cx threads = 1) const {
+    if (threads <= 1) {
+      for (uint_32_cx i = 0; i < shards_.size(); i++) {
+        std::shared_lock lock(shards_[i]->mutex_);
+        func(i, static_cast<const Map&>(shards_[i]->map_));
+      }
+      return;
+    }
+    std::atomic<uint_32_cx> next{0};
+    std::vector<std::thread> workers;
+    for (uint_32_cx t = 0; t < threads && t < shards_.size(); t++) {
+      workers.emplace_back([&]() {
+        for (uint_32_cx i = next++; i < shards_.size(); i = next++) {
+          std::shared_lock lock(shards_[i]->mutex_);
+          func(i, static_cast<const Map&>(shards_[i]->map_));
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "CONCURRENT HASHMAP TESTS" << std::endl;
+    std::cout << "  Testing insert_or_assign and find..." << std::endl;
+    ConcurrentHashMap<int, std::string> map1(4);
+    CX_ASSERT(map1.shard_count() == 4, "");
+    CX_ASSERT(map1.insert_or_assign(1, "One"), "");
+    CX_ASSERT(!map1.insert_or_assign(1, "One_Updated"), "");
+    CX_ASSERT(map1.find(1).value() == "One_Updated", "");
+    CX_ASSERT(!map1.find(2).has_value(), "");
+
+    std::cout << "  Testing erase..." << std::endl;
+    CX_ASSERT(map1.erase(1), "");
+    CX_ASSERT(!map1.erase(1), "");
+    CX_ASSERT(map1.empty(), "");
+
+    std::cout << "  Testing concurrent writers..." << std::endl;
+    ConcurrentHashMap<int, int> map2;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+      threads.emplace_back([&map2, t]() {
+        for (int i = 0; i < 10000; i++) {
+          map2.insert_or_assign(t * 10000 + i, i);
+          map2.update(-1, [](int& counter) { counter++; });
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CX_ASSERT(map2.size() == 80001, "");
+    CX_ASSERT(map2.find(-1).value() == 80000, "");
+    for (int i = 0; i < 80000; i++) {
+      CX_ASSERT(map2.find(i).value() == i % 10000, "");
+    }
+
+    std::cout << "  Testing concurrent readers and erasers..." << std::endl;
+    threads.clear();
+    for (int t = 0; t < 8; t++) {
+      threads.emplace_back([&map2, t]() {
+        for (int i = 0; i < 10000; i++) {
+          if (t % 2 == 0) {
+            map2.erase(t * 10000 + i);
+          } else {
+            CX_ASSERT(map2.contains(t * 10000 + i), "");
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CX_ASSERT(map2.size() == 40001, "");
+
+    std::cout << "  Testing for_each_shard..." << std::endl;
+    std::atomic<int> count{0};
+    map2.for_each_shard(
+        [&count](uint_32_cx, const HashMap<int, int>& shard) {
+          shard.for_each([&count](const int&, int&) { count++; });
+        },
+        4);
+    CX_ASSERT(count == 40001, "");
+    map2.clear();
+    CX_ASSERT(map2.size() == 0, "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTHASHMAP_H_
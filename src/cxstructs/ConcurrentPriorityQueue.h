@@ -0,0 +1,263 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTPRIORITYQUEUE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTPRIORITYQUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxmath.h"
+#include "PriorityQueue.h"
+
+// Relaxed MultiQueue: several independently locked PriorityQueue shards
+// push goes to a random shard, try_pop looks at two random shards and pops the better top
+// Pops are not strictly ordered but the rank error stays small relative to the shard count
+
+namespace cxstructs {
+
+/**
+ * <h2>ConcurrentPriorityQueue</h2>
+ * A priority queue that many producers and consumers can use at once, e.g. for task scheduling.
+ * <br><br>
+ * Made out of a power of two number of cxstructs::PriorityQueue shards, each behind its own mutex.
+ * Producers push into a random shard. Consumers lock two random shards and pop the better of their tops
+ * ("power of two choices"). Threads never wait for a busy shard while another one is free.
+ * <br><br>
+ * The order is relaxed: try_pop() returns one of the highest priority elements, not necessarily the best.
+ * With one shard it behaves like a locked PriorityQueue.
+ *
+ * @tparam T value type
+ * @tparam Compare same convention as PriorityQueue - std::greater<T> pops the smallest elements first
+ * @tparam Policy allocation policy of the shards
+ */
+template <typename T, typename Compare = std::greater<T>, AllocPolicy Policy = PoolAlloc>
+class ConcurrentPriorityQueue {
+  using Queue = PriorityQueue<T, Compare, Policy>;
+  struct alignas(64) Shard {
+    std::mutex mutex_;
+    Queue queue_;
+    std::atomic<uint_32_cx> size_{0};
+  };
+
+  std::vector<Shard*> shards_;
+  uint_32_cx mask_;
+  Compare comp_;
+
+  [[nodiscard]] static inline uint32_t random() noexcept {
+    thread_local uint32_t state =
+        static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+  // locks a random shard, skipping busy ones for a few tries
+  [[nodiscard]] inline Shard& lock_any(std::unique_lock<std::mutex>& lock) noexcept {
+    for (int attempt = 0; attempt < 4; attempt++) {
+      Shard& shard = *shards_[random() & mask_];
+      lock = std::unique_lock(shard.mutex_, std::try_to_lock);
+      if (lock.owns_lock()) {
+        return shard;
+      }
+    }
+    Shard& shard = *shards_[random() & mask_];
+    lock = std::unique_lock(shard.mutex_);
+    return shard;
+  }
+  inline bool pop_from(Shard& shard, T& out) {
+    if (shard.queue_.size() == 0) {
+      return false;
+    }
+    out = std::move(shard.queue_.top());
+    shard.queue_.pop();
+    shard.size_.store(shard.queue_.size(), std::memory_order_relaxed);
+    return true;
+  }
+
+ public:
+  /**
+   * @param shardCount number of heaps - rounded to the next power of two, 0 picks twice the hardware threads
+   */
+  explicit ConcurrentPriorityQueue(uint_32_cx shardCount = 0) {
+    if (shardCount == 0) {
+      shardCount = 2 * std::max(1U, std::thread::hardware_concurrency());
+    }
+    shardCount = next_power_of_2(shardCount);
+    mask_ = shardCount - 1;
+    shards_.reserve(shardCount);
+    for (uint_32_cx i = 0; i < shardCount; i++) {
+      shards_.push_back(new Shard());
+    }
+  }
+  ConcurrentPriorityQueue(const ConcurrentPriorityQueue&) = delete;
+  ConcurrentPriorityQueue& operator=(const ConcurrentPriorityQueue&) = delete;
+  ~ConcurrentPriorityQueue() {
+    for (auto shard : shards_) {
+      delete shard;
+    }
+  }
+  /**
+   * Adds an element to a random shard
+   * @param e the element to be added
+   */
+  inline void push(const T& e) {
+    std::unique_lock<std::mutex> lock;
+    Shard& shard = lock_any(lock);
+    shard.queue_.push(e);
+    shard.size_.store(shard.queue_.size(), std::memory_order_relaxed);
+  }
+  /**
+   * Constructs a new element in a random shard
+   * @param args T constructor arguments
+   */
+  template <typename... Args>
+  inline void emplace(Args&&... args) {
+    std::unique_lock<std::mutex> lock;
+    Shard& shard = lock_any(lock);
+    shard.queue_.emplace(std::forward<Args>(args)...);
+    shard.size_.store(shard.queue_.size(), std::memory_order_relaxed);
+  }
+  /**
+   * Removes one of the highest priority elements
+   * @param out receives the element
+   * @return false if the queue was empty
+   */
+  inline bool try_pop(T& out) {
+    if (shards_.size() > 1) {
+      for (int attempt = 0; attempt < 4; attempt++) {
+        const uint32_t r = random();
+        Shard& a = *shards_[r & mask_];
+        Shard& b = *shards_[(r >> 16) & mask_];
+        if (&a == &b ||
+            (a.size_.load(std::memory_order_relaxed) | b.size_.load(std::memory_order_relaxed)) == 0) {
+          continue;
+        }
+        std::unique_lock<std::mutex> la(a.mutex_, std::try_to_lock);
+        std::unique_lock<std::mutex> lb(b.mutex_, std::try_to_lock);
+        if (!la.owns_lock() && !lb.owns_lock()) {
+          continue;
+        }
+        const bool aOk = la.owns_lock() && a.queue_.size() > 0;
+        const bool bOk = lb.owns_lock() && b.queue_.size() > 0;
+        if (aOk && (!bOk || !comp_(a.queue_.top(), b.queue_.top()))) {
+          return pop_from(a, out);
+        }
+        if (bOk) {
+          return pop_from(b, out);
+        }
+      }
+    }
+    // few elements or heavy contention - visit every shard once before reporting empty
+    const uint32_t start = random();
+    for (uint_32_cx i = 0; i < shards_.size(); i++) {
+      Shard& shard = *shards_[(start + i) & mask_];
+      if (shard.size_.load(std::memory_order_relaxed) == 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(shard.mutex_);
+      if (pop_from(shard, out)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  /**
+   * Not synchronized with concurrent pushes and pops
+   * @return the approximate number of elements
+   */
+  [[nodiscard]] inline uint_32_cx size_approx() const noexcept {
+    uint_32_cx size = 0;
+    for (auto shard : shards_) {
+      size += shard->size_.load(std::memory_order_relaxed);
+    }
+    return size;
+  }
+  [[nodiscard]] inline bool empty_approx() const noexcept { return size_approx() == 0; }
+  [[nodiscard]] inline uint_32_cx shard_count() const noexcept { return shards_.size(); }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "CONCURRENT PRIORITY QUEUE TESTS" << std::endl;
+    std::cout << "  Testing single shard order..." << std::endl;
+    ConcurrentPriorityQueue<int> q1(1);
+    for (int i = 99; i >= 0; i--) {
+      q1.push(i);
+    }
+    CX_ASSERT(q1.size_approx() == 100, "");
+    int val;
+    for (int i = 0; i < 100; i++) {
+      CX_ASSERT(q1.try_pop(val) && val == i, "");
+    }
+    CX_ASSERT(!q1.try_pop(val) && q1.empty_approx(), "");
+
+    std::cout << "  Testing relaxed order..." << std::endl;
+    ConcurrentPriorityQueue<int> q2(8);
+    CX_ASSERT(q2.shard_count() == 8, "");
+    for (int i = 0; i < 10000; i++) {
+      q2.emplace(i);
+    }
+    // the best of two shards is one of the 16 smallest elements with overwhelming probability
+    int sum = 0;
+    for (int i = 0; i < 100; i++) {
+      CX_ASSERT(q2.try_pop(val), "");
+      sum += val;
+    }
+    CX_ASSERT(sum < 100 * 100, "");
+    while (q2.try_pop(val)) {
+    }
+    CX_ASSERT(q2.size_approx() == 0, "");
+
+    std::cout << "  Testing concurrent producers and consumers..." << std::endl;
+    ConcurrentPriorityQueue<int> q3;
+    std::vector<std::thread> threads;
+    std::vector<std::atomic<int>> seen(40000);
+    std::atomic<int> popped{0};
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&q3, t]() {
+        for (int i = 0; i < 10000; i++) {
+          q3.push(t * 10000 + i);
+        }
+      });
+      threads.emplace_back([&]() {
+        int v;
+        while (popped.load() < 40000) {
+          if (q3.try_pop(v)) {
+            seen[v]++;
+            popped++;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CX_ASSERT(q3.size_approx() == 0, "");
+    for (auto& count : seen) {
+      CX_ASSERT(count == 1, "");
+    }
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_CONCURRENTPRIORITYQUEUE_H_
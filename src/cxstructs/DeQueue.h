@@ -32,11 +32,9 @@ namespace cxstructs {
  * <h2>DeQueue</h2> is a double ended queue. It functions very similar to the normal queue but is different in that it allows for retrieval and addition at both ends.
  * Like the Queue this implementation also uses a circular array to manage the data.
  */
-template <typename T, bool UseCXPoolAllocator = true>
+template <typename T, AllocPolicy Policy = PoolAlloc>
 class DeQueue {
-  using Allocator =
-      typename std::conditional<UseCXPoolAllocator, CXPoolAllocator<T, sizeof(T) * 33, 1>,
-                                std::allocator<T>>::type;
+  using Allocator = cxhelper::policy_allocator_t<T, Policy>;
   Allocator alloc;
   T* arr_;
   uint_32_cx len_;
@@ -48,6 +46,7 @@ class DeQueue {
   bool is_trivial_destr = std::is_trivially_destructible<T>::value;
 
   inline void grow() {
+    auto old_len = len_;
     len_ *= 2;
 
     T* n_arr = alloc.allocate(len_);
@@ -70,7 +69,7 @@ class DeQueue {
         std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
       }
     }
-    alloc.deallocate(arr_, len_);
+    alloc.deallocate(arr_, old_len);
 
     arr_ = n_arr;
     front_ = 0;
@@ -312,6 +311,19 @@ class DeQueue {
     * @return
     */
   [[nodiscard]] inline uint_32_cx capacity() const noexcept { return len_; }
+  /**
+   * @return the heap memory of this DeQueue - one array of capacity() elements
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    if (arr_) {
+      stats.bytes_reserved = cxhelper::allocation_size<Allocator>(len_);
+      stats.blocks = 1;
+    }
+    return stats;
+  }
   inline void shrink_to_fit() noexcept {
     CX_WARNING(len_ > size_ * 1.5,"");
     shrink();
@@ -0,0 +1,431 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_FLATQUADTREE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_FLATQUADTREE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "Geometry.h"
+#include "vec.h"
+
+// Linear QuadTree: nodes live in one array in breadth first order and the 4 children of a node are adjacent
+// Points are stored once, sorted by their Morton code (z-order), so every node owns a contiguous range of them
+
+namespace cxhelper {
+// spreads the lower 16 bits so there is a zero bit between each of them
+inline uint32_t morton_spread(uint32_t v) noexcept {
+  v &= 0x0000FFFF;
+  v = (v | (v << 8)) & 0x00FF00FF;
+  v = (v | (v << 4)) & 0x0F0F0F0F;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+/**
+ * Interleaves the bits of both 16 bit coordinates, x in the even bits
+ */
+inline uint32_t morton_encode(uint32_t x, uint32_t y) noexcept {
+  return morton_spread(x) | (morton_spread(y) << 1);
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>FlatQuadTree</h2>
+ * is a QuadTree without pointers, built in one pass from all its points.<p>
+ * The points are sorted by their Morton code inside the bounds. Nodes are kept in a single array in breadth
+ * first order with their 4 children next to each other (top left, top right, bottom left, bottom right),
+ * so a child is addressed by index. Because of the z-order every node - also an inner one - covers one
+ * contiguous range of the point array: a node that lies fully inside a query rectangle is counted or
+ * collected without visiting its subtree.
+ * <br><br>
+ * All queries are iterative and dont allocate (except for the result containers).
+ * Compared to QuadTree there is no insert or erase - call build() again when the points change,
+ * which reuses all allocations.
+ * @tparam T type with x() and y() getters
+ */
+template <typename T>
+class FlatQuadTree {
+  struct Node {
+    float x_, y_, w_, h_;
+    uint32_t first_child_;  // 0 for leaves, the root is never a child
+    uint32_t begin_;        // range of points in this subtree
+    uint32_t end_;
+  };
+  static constexpr uint_16_cx kMaxDepth = 16;  // 16 bits per axis in the 32 bit Morton code
+
+  std::vector<Node> nodes_;
+  std::vector<T> points_;
+  std::vector<std::pair<uint32_t, uint32_t>> codes_;  // (Morton code, source index) while building
+  std::vector<uint32_t> code_of_;                     // Morton code of every stored point
+  Rect bounds_;
+  uint_16_cx max_depth_;
+  uint_32_cx max_points_;
+  uint_16_cx depth_ = 0;
+
+  [[nodiscard]] static inline bool intersects(const Node& n, const Rect& r) noexcept {
+    return !(n.x_ > r.x() + r.width() || n.x_ + n.w_ < r.x() || n.y_ > r.y() + r.height() ||
+             n.y_ + n.h_ < r.y());
+  }
+  [[nodiscard]] static inline bool inside(const Node& n, const Rect& r) noexcept {
+    return n.x_ >= r.x() && n.y_ >= r.y() && n.x_ + n.w_ <= r.x() + r.width() &&
+           n.y_ + n.h_ <= r.y() + r.height();
+  }
+  // calls func(begin, end, fully_inside) for every node range that can hold points of bound
+  template <typename Function>
+  inline void visit(const Rect& bound, Function func) const {
+    if (nodes_.empty()) {
+      return;
+    }
+    std::array<uint32_t, 3 * kMaxDepth + 4> stack;
+    uint_32_cx top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      const Node& node = nodes_[stack[--top]];
+      if (node.begin_ == node.end_ || !intersects(node, bound)) {
+        continue;
+      }
+      if (node.first_child_ == 0 || inside(node, bound)) {
+        func(node.begin_, node.end_, inside(node, bound));
+        continue;
+      }
+      for (uint32_t c = 0; c < 4; c++) {
+        stack[top++] = node.first_child_ + c;
+      }
+    }
+  }
+
+ public:
+  /**
+   * @param bounds the area of the tree - points outside of it are skipped by build()
+   * @param max_depth maximum depth of the tree - at most 16
+   * @param max_points nodes with more points are split unless they are at max depth
+   */
+  explicit FlatQuadTree(Rect bounds, uint_16_cx max_depth = 10, uint_32_cx max_points = 50)
+      : bounds_(bounds),
+        max_depth_(std::min(max_depth, kMaxDepth)),
+        max_points_(std::max<uint_32_cx>(max_points, 1)) {}
+  /**
+   * Builds the tree from the given elements, replacing the old content - O(n log n)
+   * @param elements the elements to copy into the tree
+   */
+  void build(std::span<const T> elements) {
+    nodes_.clear();
+    points_.clear();
+    codes_.clear();
+    code_of_.clear();
+    depth_ = 0;
+    const float cells = static_cast<float>(1U << max_depth_);
+    const float sx = bounds_.width() > 0 ? cells / bounds_.width() : 0;
+    const float sy = bounds_.height() > 0 ? cells / bounds_.height() : 0;
+    const auto max_cell = static_cast<uint32_t>(cells) - 1;
+    for (uint32_t i = 0; i < elements.size(); i++) {
+      const T& e = elements[i];
+      if (!bounds_.contains(e)) {
+        continue;
+      }
+      const auto cx = std::min(max_cell, static_cast<uint32_t>((e.x() - bounds_.x()) * sx));
+      const auto cy = std::min(max_cell, static_cast<uint32_t>((e.y() - bounds_.y()) * sy));
+      codes_.emplace_back(morton_encode(cx, cy) << (2 * (kMaxDepth - max_depth_)), i);
+    }
+    std::sort(codes_.begin(), codes_.end());
+    points_.reserve(codes_.size());
+    code_of_.reserve(codes_.size());
+    for (const auto& [code, index] : codes_) {
+      points_.push_back(elements[index]);
+      code_of_.push_back(code);
+    }
+
+    // breadth first - nodes_ doubles as the work queue, the depth of a node follows from its level
+    nodes_.push_back({bounds_.x(), bounds_.y(), bounds_.width(), bounds_.height(), 0, 0,
+                      static_cast<uint32_t>(points_.size())});
+    uint32_t level_end = 1;
+    uint_16_cx depth = 0;
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+      if (i == level_end) {
+        level_end = nodes_.size();
+        depth++;
+      }
+      const Node node = nodes_[i];
+      if (node.end_ - node.begin_ <= max_points_ || depth == max_depth_) {
+        continue;
+      }
+      depth_ = std::max<uint_16_cx>(depth_, depth + 1);
+      nodes_[i].first_child_ = nodes_.size();
+      // the 2 bits below the prefix of this node select the child
+      const uint32_t shift = 2 * (kMaxDepth - depth - 1);
+      const float hw = node.w_ / 2, hh = node.h_ / 2;
+      const uint32_t prefix = depth == 0 ? 0 : code_of_[node.begin_] >> (shift + 2) << (shift + 2);
+      uint32_t begin = node.begin_;
+      for (uint32_t c = 0; c < 4; c++) {
+        uint32_t end = node.end_;
+        if (c < 3) {
+          const uint32_t limit = prefix | ((c + 1) << shift);
+          end = std::lower_bound(code_of_.begin() + begin, code_of_.begin() + node.end_, limit) -
+                code_of_.begin();
+        }
+        nodes_.push_back({node.x_ + (c & 1) * hw, node.y_ + (c >> 1) * hh, hw, hh, 0, begin, end});
+        begin = end;
+      }
+    }
+  }
+  /**
+   * Number of points contained in the given rectangle bound
+   * @param bound the rectangle to search in
+   * @return number of points
+   */
+  [[nodiscard]] inline uint_32_cx count_subrect(const Rect& bound) const {
+    uint_32_cx count = 0;
+    visit(bound, [&](uint32_t begin, uint32_t end, bool inside) {
+      if (inside) {
+        count += end - begin;
+        return;
+      }
+      for (uint32_t i = begin; i < end; i++) {
+        count += bound.contains(points_[i]);
+      }
+    });
+    return count;
+  }
+  /**
+   * Calls func(const T&) for every point in the given rectangle bound
+   * @param bound the rectangle to search in
+   * @param func callable taking const T&
+   */
+  template <typename Function>
+  inline void for_each_subrect(const Rect& bound, Function func) const {
+    visit(bound, [&](uint32_t begin, uint32_t end, bool inside) {
+      for (uint32_t i = begin; i < end; i++) {
+        if (inside || bound.contains(points_[i])) {
+          func(points_[i]);
+        }
+      }
+    });
+  }
+  /**
+   * Retrieves all elements that are contained in the given bound as a iterable list of pointers
+   * @param bound the rectangle to search in
+   * @param result cleared and filled with pointers into the tree - valid until the next build()
+   */
+  inline void get_subrect(const Rect& bound, vec<const T*>& result) const {
+    result.clear();
+    for_each_subrect(bound, [&](const T& e) { result.push_back(&e); });
+  }
+  [[nodiscard]] inline vec<const T*> get_subrect(const Rect& bound) const {
+    vec<const T*> result;
+    get_subrect(bound, result);
+    return result;
+  }
+  /**
+   * Reusable buffers of k_nearest()
+   */
+  struct SearchScratch {
+    std::vector<std::pair<float, uint32_t>> nodes_;  // min-heap of nodes to visit
+    std::vector<std::pair<float, uint32_t>> best_;   // max-heap of the k closest points
+  };
+  /**
+   * Finds the k elements closest to (x, y) with a best-first traversal - see QuadTree::k_nearest()
+   * @param x x-coordinate of the query
+   * @param y y-coordinate of the query
+   * @param k number of elements
+   * @param result filled with pointers to the up to k closest elements ordered by ascending distance
+   * @param dist distance callable (x1, y1, x2, y2) that grows with both coordinate differences
+   * @param scratch reused buffers - one per thread
+   */
+  template <typename Distance>
+  void k_nearest(float x, float y, uint_32_cx k, vec<const T*>& result, Distance dist,
+                 SearchScratch& scratch) const {
+    result.clear();
+    if (k == 0 || nodes_.empty()) {
+      return;
+    }
+    auto node_distance = [&](const Node& n) {
+      return dist(x, y, std::clamp(x, n.x_, n.x_ + n.w_), std::clamp(y, n.y_, n.y_ + n.h_));
+    };
+    auto greater = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+      return a.first > b.first;
+    };
+    auto less = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+      return a.first < b.first;
+    };
+    auto& nodes = scratch.nodes_;
+    auto& best = scratch.best_;
+    nodes.clear();
+    best.clear();
+    nodes.emplace_back(node_distance(nodes_[0]), 0);
+    while (!nodes.empty()) {
+      std::pop_heap(nodes.begin(), nodes.end(), greater);
+      const auto [node_dist, index] = nodes.back();
+      nodes.pop_back();
+      if (best.size() == k && node_dist >= best.front().first) {
+        break;
+      }
+      const Node& node = nodes_[index];
+      if (node.first_child_ != 0) {
+        for (uint32_t c = 0; c < 4; c++) {
+          const Node& child = nodes_[node.first_child_ + c];
+          if (child.begin_ != child.end_) {
+            nodes.emplace_back(node_distance(child), node.first_child_ + c);
+            std::push_heap(nodes.begin(), nodes.end(), greater);
+          }
+        }
+        continue;
+      }
+      for (uint32_t i = node.begin_; i < node.end_; i++) {
+        const float d = dist(x, y, points_[i].x(), points_[i].y());
+        if (best.size() < k) {
+          best.emplace_back(d, i);
+          std::push_heap(best.begin(), best.end(), less);
+        } else if (d < best.front().first) {
+          std::pop_heap(best.begin(), best.end(), less);
+          best.back() = {d, i};
+          std::push_heap(best.begin(), best.end(), less);
+        }
+      }
+    }
+    std::sort_heap(best.begin(), best.end(), less);
+    for (const auto& pair : best) {
+      result.push_back(&points_[pair.second]);
+    }
+  }
+  /**
+   * Finds the k elements closest to (x, y) by euclidean distance
+   * @return pointers to the up to k closest elements ordered by ascending distance
+   */
+  [[nodiscard]] inline vec<const T*> k_nearest(float x, float y, uint_32_cx k) const {
+    vec<const T*> result;
+    SearchScratch scratch;
+    k_nearest(
+        x, y, k, result,
+        [](float x1, float y1, float x2, float y2) {
+          return (x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2);
+        },
+        scratch);
+    return result;
+  }
+  /**
+   * Removes all points, keeps the allocations for the next build()
+   */
+  inline void clear() noexcept {
+    nodes_.clear();
+    points_.clear();
+    code_of_.clear();
+    depth_ = 0;
+  }
+  /**
+   * Sets new bounds - takes effect on the next build()
+   */
+  inline void set_bounds(const Rect& new_bound) noexcept { bounds_ = new_bound; }
+  [[nodiscard]] inline const Rect& get_bounds() const noexcept { return bounds_; }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return points_.size(); }
+  [[nodiscard]] inline uint_16_cx depth() const noexcept { return depth_; }
+  [[nodiscard]] inline uint_32_cx node_count() const noexcept { return nodes_.size(); }
+  /**
+   * @return all points sorted in z-order
+   */
+  [[nodiscard]] inline std::span<const T> points() const noexcept { return points_; }
+  /**
+   * Calls func(bounds, elements) for every node in breadth first order - elements are the points of a leaf
+   * and empty for inner nodes, so every point is passed exactly once
+   * @param func callable taking (const Rect&, std::span<const T>)
+   */
+  template <typename Function>
+  inline void for_each_node(Function func) const {
+    for (const Node& node : nodes_) {
+      const std::span<const T> elements =
+          node.first_child_ == 0 ? std::span<const T>(points_.data() + node.begin_, node.end_ - node.begin_)
+                                 : std::span<const T>();
+      func(Rect(node.x_, node.y_, node.w_, node.h_), elements);
+    }
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "TESTING FLAT QUAD TREE" << std::endl;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> distr(0, 200);
+    std::vector<Point> points;
+    for (int i = 0; i < 20000; i++) {
+      points.emplace_back(distr(gen), distr(gen));
+    }
+    points.emplace_back(-5, 10);  // outside
+    for (int i = 0; i < 100; i++) {
+      points.emplace_back(7, 7);  // more duplicates than a leaf can split
+    }
+
+    std::cout << "   Testing build..." << std::endl;
+    FlatQuadTree<Point> tree({0, 0, 200, 200}, 8, 16);
+    tree.build(points);
+    CX_ASSERT(tree.size() == 20100, "");
+    CX_ASSERT(tree.depth() == 8, "");
+    CX_ASSERT(tree.node_count() % 4 == 1, "");
+
+    std::cout << "   Testing count and get subrect..." << std::endl;
+    CX_ASSERT(tree.count_subrect({0, 0, 200, 200}) == 20100, "");
+    for (int q = 0; q < 100; q++) {
+      Rect r(distr(gen) - 20, distr(gen) - 20, distr(gen) / 3, distr(gen) / 5);
+      uint_32_cx expected = 0;
+      for (const auto& p : points) {
+        expected += r.contains(p) && tree.get_bounds().contains(p);
+      }
+      CX_ASSERT(tree.count_subrect(r) == expected, "");
+      auto inside = tree.get_subrect(r);
+      CX_ASSERT(inside.size() == expected, "");
+      for (auto ptr : inside) {
+        CX_ASSERT(r.contains(*ptr), "");
+      }
+    }
+
+    std::cout << "   Testing k_nearest..." << std::endl;
+    for (int q = 0; q < 50; q++) {
+      const float x = distr(gen), y = distr(gen);
+      auto closest = tree.k_nearest(x, y, 8);
+      std::vector<float> dists;
+      for (const auto& p : tree.points()) {
+        dists.push_back((p.x() - x) * (p.x() - x) + (p.y() - y) * (p.y() - y));
+      }
+      std::sort(dists.begin(), dists.end());
+      CX_ASSERT(closest.size() == 8, "");
+      for (int i = 0; i < 8; i++) {
+        const float d = (closest[i]->x() - x) * (closest[i]->x() - x) +
+                        (closest[i]->y() - y) * (closest[i]->y() - y);
+        CX_ASSERT(d == dists[i], "");
+      }
+    }
+
+    std::cout << "   Testing rebuild..." << std::endl;
+    points.resize(10);
+    tree.build(points);
+    CX_ASSERT(tree.size() == 10 && tree.node_count() == 1, "");
+    tree.clear();
+    CX_ASSERT(tree.size() == 0 && tree.count_subrect({0, 0, 200, 200}) == 0, "");
+    CX_ASSERT(tree.k_nearest(1, 1, 3).size() == 0, "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_FLATQUADTREE_H_
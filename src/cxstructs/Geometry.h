@@ -22,9 +22,22 @@
 #define CXSTRUCTS_SRC_DATASTRUCTURES_GEOMETRY_H_
 
 #include <algorithm>
+#include <bit>
 #include <cstdint>
+#include <cstring>
 #include "../cxalgos/MathFunctions.h"
 #include "../cxconfig.h"
+#include "../cxutil/cxhash.h"
+
+#if defined(CX_NEON)
+namespace cxhelper {
+// one bit per lane like _mm_movemask_ps
+inline uint64_t neon_movemask(uint32x4_t m) noexcept {
+  const uint32x4_t bits = {1, 2, 4, 8};
+  return vaddvq_u32(vandq_u32(m, bits));
+}
+}  // namespace cxhelper
+#endif
 
 namespace cxstructs {
 
@@ -157,7 +170,7 @@ class Circle : public Shape {
    * @return `true` if this circle contained with the circle, `false` otherwise.
    */
   [[nodiscard]] inline bool intersects(const Circle& c) const final {
-    return !(((x_ - c.x_) * (x_ - c.x_) + (y_ - c.y_) * (y_ - c.y_)) > (r_ * c.r_ + r_ * c.r_));
+    return !(((x_ - c.x_) * (x_ - c.x_) + (y_ - c.y_) * (y_ - c.y_)) > (r_ + c.r_) * (r_ + c.r_));
   }
   /**
    * Checks if the given circle is fully contained inside this circle.<p>
@@ -364,6 +377,31 @@ class Sector : public Shape {
   }
 };
 
+//cxstructs::hash specializations used by the hashing cxstructs
+template <>
+struct hash<Point, void> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(const Point& p) const noexcept {
+    const cxstructs::hash<float> float_hash;
+    return static_cast<size_t>(hash_combine(float_hash(p.x()), float_hash(p.y())));
+  }
+};
+template <>
+struct hash<PointI, void> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(const PointI& p) const noexcept {
+    return static_cast<size_t>(hash_int((static_cast<uint64_t>(static_cast<uint32_t>(p.x)) << 32) |
+                                        static_cast<uint32_t>(p.y)));
+  }
+};
+template <typename sizeType>
+struct hash<PointT<sizeType>, void> {
+  using is_avalanching = std::true_type;
+  inline size_t operator()(const PointT<sizeType>& p) const noexcept {
+    return static_cast<size_t>(hash_combine(static_cast<uint64_t>(p.x), static_cast<uint64_t>(p.y)));
+  }
+};
+
 // Definitions of member functions
 bool Rect::intersects(const Circle& c) const {
   const float closestX = std::clamp(c.x(), x_, x_ + w_);
@@ -385,6 +423,215 @@ bool Circle::contains(const Point& p) const {
   return ((x_ - p.x()) * (x_ - p.x()) + (y_ - p.y()) * (y_ - p.y()) < r_ * r_);
 }
 
+// Batch tests of one shape against many others stored as separate coordinate arrays (e.g. the columns of a soa_vec)
+// They never go through the Shape vtable and check 8 (AVX2) or 4 (SSE2/NEON) shapes per instruction
+// The results are bitmasks: bit i of mask[i / 64] is set if shape i matches - same result as the scalar methods
+
+/**
+ * n rectangles as separate arrays
+ */
+struct RectsSoA {
+  const float* x;
+  const float* y;
+  const float* w;
+  const float* h;
+  uint_32_cx size;
+};
+/**
+ * n circles as separate arrays
+ */
+struct CirclesSoA {
+  const float* x;
+  const float* y;
+  const float* r;
+  uint_32_cx size;
+};
+/**
+ * @return the number of uint64_t a result mask over n shapes needs
+ */
+constexpr uint_32_cx mask_words(uint_32_cx n) noexcept {
+  return (n + 63) / 64;
+}
+/**
+ * Calls func(index) for every set bit of a result mask
+ */
+template <typename Func>
+inline void for_each_set(const uint64_t* mask, uint_32_cx n, Func func) {
+  for (uint_32_cx w = 0; w < mask_words(n); w++) {
+    for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+      func(w * 64 + static_cast<uint_32_cx>(std::countr_zero(bits)));
+    }
+  }
+}
+inline uint_32_cx count_set(const uint64_t* mask, uint_32_cx n) noexcept {
+  uint_32_cx count = 0;
+  for (uint_32_cx w = 0; w < mask_words(n); w++) {
+    count += std::popcount(mask[w]);
+  }
+  return count;
+}
+/**
+ * Tests r against all given rectangles - same as r.intersects(rects[i])
+ * @param mask receives the result - at least mask_words(rects.size) words
+ * @return the number of intersecting rectangles
+ */
+inline uint_32_cx intersects_batch(const Rect& r, const RectsSoA& rects, uint64_t* mask) noexcept {
+  const uint_32_cx n = rects.size;
+  if (n == 0) {
+    return 0;
+  }
+  std::memset(mask, 0, mask_words(n) * sizeof(uint64_t));
+  const float x0 = r.x(), y0 = r.y(), x1 = r.x() + r.width(), y1 = r.y() + r.height();
+  uint_32_cx i = 0;
+#if defined(CX_AVX2)
+  const __m256 vx0 = _mm256_set1_ps(x0), vy0 = _mm256_set1_ps(y0);
+  const __m256 vx1 = _mm256_set1_ps(x1), vy1 = _mm256_set1_ps(y1);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_loadu_ps(rects.x + i);
+    const __m256 y = _mm256_loadu_ps(rects.y + i);
+    __m256 apart = _mm256_cmp_ps(vx0, _mm256_add_ps(x, _mm256_loadu_ps(rects.w + i)), _CMP_GT_OQ);
+    apart = _mm256_or_ps(apart, _mm256_cmp_ps(vx1, x, _CMP_LT_OQ));
+    apart = _mm256_or_ps(apart, _mm256_cmp_ps(vy0, _mm256_add_ps(y, _mm256_loadu_ps(rects.h + i)), _CMP_GT_OQ));
+    apart = _mm256_or_ps(apart, _mm256_cmp_ps(vy1, y, _CMP_LT_OQ));
+    mask[i / 64] |= static_cast<uint64_t>(~_mm256_movemask_ps(apart) & 0xFF) << (i % 64);
+  }
+#elif defined(CX_SSE2)
+  const __m128 vx0 = _mm_set1_ps(x0), vy0 = _mm_set1_ps(y0), vx1 = _mm_set1_ps(x1), vy1 = _mm_set1_ps(y1);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 x = _mm_loadu_ps(rects.x + i);
+    const __m128 y = _mm_loadu_ps(rects.y + i);
+    __m128 apart = _mm_cmpgt_ps(vx0, _mm_add_ps(x, _mm_loadu_ps(rects.w + i)));
+    apart = _mm_or_ps(apart, _mm_cmplt_ps(vx1, x));
+    apart = _mm_or_ps(apart, _mm_cmpgt_ps(vy0, _mm_add_ps(y, _mm_loadu_ps(rects.h + i))));
+    apart = _mm_or_ps(apart, _mm_cmplt_ps(vy1, y));
+    mask[i / 64] |= static_cast<uint64_t>(~_mm_movemask_ps(apart) & 0xF) << (i % 64);
+  }
+#elif defined(CX_NEON)
+  const float32x4_t vx0 = vdupq_n_f32(x0), vy0 = vdupq_n_f32(y0), vx1 = vdupq_n_f32(x1), vy1 = vdupq_n_f32(y1);
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t x = vld1q_f32(rects.x + i);
+    const float32x4_t y = vld1q_f32(rects.y + i);
+    uint32x4_t apart = vcgtq_f32(vx0, vaddq_f32(x, vld1q_f32(rects.w + i)));
+    apart = vorrq_u32(apart, vcltq_f32(vx1, x));
+    apart = vorrq_u32(apart, vcgtq_f32(vy0, vaddq_f32(y, vld1q_f32(rects.h + i))));
+    apart = vorrq_u32(apart, vcltq_f32(vy1, y));
+    mask[i / 64] |= cxhelper::neon_movemask(vmvnq_u32(apart)) << (i % 64);
+  }
+#endif
+  for (; i < n; i++) {
+    const bool hit = !(x0 > rects.x[i] + rects.w[i] || x1 < rects.x[i] || y0 > rects.y[i] + rects.h[i] ||
+                       y1 < rects.y[i]);
+    mask[i / 64] |= static_cast<uint64_t>(hit) << (i % 64);
+  }
+  return count_set(mask, n);
+}
+/**
+ * Tests c against all given circles - same as c.intersects(circles[i])
+ * @param mask receives the result - at least mask_words(circles.size) words
+ * @return the number of intersecting circles
+ */
+inline uint_32_cx intersects_batch(const Circle& c, const CirclesSoA& circles, uint64_t* mask) noexcept {
+  const uint_32_cx n = circles.size;
+  if (n == 0) {
+    return 0;
+  }
+  std::memset(mask, 0, mask_words(n) * sizeof(uint64_t));
+  const float cx = c.x(), cy = c.y(), cr = c.radius();
+  uint_32_cx i = 0;
+#if defined(CX_AVX2)
+  const __m256 vx = _mm256_set1_ps(cx), vy = _mm256_set1_ps(cy), vr = _mm256_set1_ps(cr);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 dx = _mm256_sub_ps(vx, _mm256_loadu_ps(circles.x + i));
+    const __m256 dy = _mm256_sub_ps(vy, _mm256_loadu_ps(circles.y + i));
+    const __m256 r = _mm256_add_ps(vr, _mm256_loadu_ps(circles.r + i));
+    // no fma - the rounding has to match the scalar test
+    const __m256 dist = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    const __m256 apart = _mm256_cmp_ps(dist, _mm256_mul_ps(r, r), _CMP_GT_OQ);
+    mask[i / 64] |= static_cast<uint64_t>(~_mm256_movemask_ps(apart) & 0xFF) << (i % 64);
+  }
+#elif defined(CX_SSE2)
+  const __m128 vx = _mm_set1_ps(cx), vy = _mm_set1_ps(cy), vr = _mm_set1_ps(cr);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 dx = _mm_sub_ps(vx, _mm_loadu_ps(circles.x + i));
+    const __m128 dy = _mm_sub_ps(vy, _mm_loadu_ps(circles.y + i));
+    const __m128 r = _mm_add_ps(vr, _mm_loadu_ps(circles.r + i));
+    const __m128 dist = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    const __m128 apart = _mm_cmpgt_ps(dist, _mm_mul_ps(r, r));
+    mask[i / 64] |= static_cast<uint64_t>(~_mm_movemask_ps(apart) & 0xF) << (i % 64);
+  }
+#elif defined(CX_NEON)
+  const float32x4_t vx = vdupq_n_f32(cx), vy = vdupq_n_f32(cy), vr = vdupq_n_f32(cr);
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t dx = vsubq_f32(vx, vld1q_f32(circles.x + i));
+    const float32x4_t dy = vsubq_f32(vy, vld1q_f32(circles.y + i));
+    const float32x4_t r = vaddq_f32(vr, vld1q_f32(circles.r + i));
+    const float32x4_t dist = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+    const uint32x4_t apart = vcgtq_f32(dist, vmulq_f32(r, r));
+    mask[i / 64] |= cxhelper::neon_movemask(vmvnq_u32(apart)) << (i % 64);
+  }
+#endif
+  for (; i < n; i++) {
+    const float dx = cx - circles.x[i];
+    const float dy = cy - circles.y[i];
+    const float r = cr + circles.r[i];
+    const bool hit = !(dx * dx + dy * dy > r * r);
+    mask[i / 64] |= static_cast<uint64_t>(hit) << (i % 64);
+  }
+  return count_set(mask, n);
+}
+/**
+ * Tests which of the given rectangles contain p - same as rects[i].contains(p)
+ * @param mask receives the result - at least mask_words(rects.size) words
+ * @return the number of rectangles containing p
+ */
+inline uint_32_cx contains_batch(const RectsSoA& rects, const Point& p, uint64_t* mask) noexcept {
+  const uint_32_cx n = rects.size;
+  if (n == 0) {
+    return 0;
+  }
+  std::memset(mask, 0, mask_words(n) * sizeof(uint64_t));
+  const float px = p.x(), py = p.y();
+  uint_32_cx i = 0;
+#if defined(CX_AVX2)
+  const __m256 vx = _mm256_set1_ps(px), vy = _mm256_set1_ps(py);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_loadu_ps(rects.x + i);
+    const __m256 y = _mm256_loadu_ps(rects.y + i);
+    __m256 out = _mm256_cmp_ps(x, vx, _CMP_GT_OQ);
+    out = _mm256_or_ps(out, _mm256_cmp_ps(y, vy, _CMP_GT_OQ));
+    out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(x, _mm256_loadu_ps(rects.w + i)), vx, _CMP_LT_OQ));
+    out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(y, _mm256_loadu_ps(rects.h + i)), vy, _CMP_LT_OQ));
+    mask[i / 64] |= static_cast<uint64_t>(~_mm256_movemask_ps(out) & 0xFF) << (i % 64);
+  }
+#elif defined(CX_SSE2)
+  const __m128 vx = _mm_set1_ps(px), vy = _mm_set1_ps(py);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 x = _mm_loadu_ps(rects.x + i);
+    const __m128 y = _mm_loadu_ps(rects.y + i);
+    __m128 out = _mm_or_ps(_mm_cmpgt_ps(x, vx), _mm_cmpgt_ps(y, vy));
+    out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(x, _mm_loadu_ps(rects.w + i)), vx));
+    out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(y, _mm_loadu_ps(rects.h + i)), vy));
+    mask[i / 64] |= static_cast<uint64_t>(~_mm_movemask_ps(out) & 0xF) << (i % 64);
+  }
+#elif defined(CX_NEON)
+  const float32x4_t vx = vdupq_n_f32(px), vy = vdupq_n_f32(py);
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t x = vld1q_f32(rects.x + i);
+    const float32x4_t y = vld1q_f32(rects.y + i);
+    uint32x4_t out = vorrq_u32(vcgtq_f32(x, vx), vcgtq_f32(y, vy));
+    out = vorrq_u32(out, vcltq_f32(vaddq_f32(x, vld1q_f32(rects.w + i)), vx));
+    out = vorrq_u32(out, vcltq_f32(vaddq_f32(y, vld1q_f32(rects.h + i)), vy));
+    mask[i / 64] |= cxhelper::neon_movemask(vmvnq_u32(out)) << (i % 64);
+  }
+#endif
+  for (; i < n; i++) {
+    const bool hit = !(rects.x[i] > px || rects.y[i] > py || rects.x[i] + rects.w[i] < px ||
+                       rects.y[i] + rects.h[i] < py);
+    mask[i / 64] |= static_cast<uint64_t>(hit) << (i % 64);
+  }
+  return count_set(mask, n);
+}
+
 }  // namespace cxstructs
 namespace std {
 template <>
@@ -420,6 +667,8 @@ struct hash<cxstructs::Circle> {
 };
 }  // namespace std
 #ifndef CX_DELETE_TESTS
+#include <random>
+#include <vector>
 static void GEOMETRY_TEST() {
   using namespace cxstructs;
   std::cout << "RECTANGLE TESTS" << std::endl;
@@ -526,6 +775,57 @@ static void GEOMETRY_TEST() {
   Point p4(15.0, 5.0);
 
   // Point p3 is inside Circle c8
+
+  std::cout << "BATCH TESTS:" << std::endl;
+  std::cout << "  Testing batch results against the scalar methods..." << std::endl;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> coord(0, 100);
+  std::uniform_int_distribution<int> extent(0, 20);
+  for (uint_32_cx n : {0, 3, 8, 37, 64, 200}) {
+    std::vector<float> x(n), y(n), w(n), h(n);
+    std::vector<Rect> rects;
+    std::vector<Circle> circles;
+    for (uint_32_cx i = 0; i < n; i++) {
+      x[i] = static_cast<float>(coord(gen));
+      y[i] = static_cast<float>(coord(gen));
+      w[i] = static_cast<float>(extent(gen));
+      h[i] = static_cast<float>(extent(gen));
+      rects.emplace_back(x[i], y[i], w[i], h[i]);
+      circles.emplace_back(x[i], y[i], w[i]);
+    }
+    std::vector<uint64_t> mask(mask_words(n));
+    const Rect query(40, 40, 20, 10);
+    const Circle circle(50, 50, 10);
+    const Point point(50, 50);
+
+    uint_32_cx count = intersects_batch(query, {x.data(), y.data(), w.data(), h.data(), n}, mask.data());
+    uint_32_cx expected = 0;
+    for (uint_32_cx i = 0; i < n; i++) {
+      CX_ASSERT(bool(mask[i / 64] >> (i % 64) & 1) == query.intersects(rects[i]), "");
+      expected += query.intersects(rects[i]);
+    }
+    CX_ASSERT(count == expected, "");
+
+    count = intersects_batch(circle, {x.data(), y.data(), w.data(), n}, mask.data());
+    for (uint_32_cx i = 0; i < n; i++) {
+      CX_ASSERT(bool(mask[i / 64] >> (i % 64) & 1) == circle.intersects(circles[i]), "");
+    }
+    CX_ASSERT(count == count_set(mask.data(), n), "");
+
+    contains_batch({x.data(), y.data(), w.data(), h.data(), n}, point, mask.data());
+    uint_32_cx visited = 0;
+    for_each_set(mask.data(), n, [&](uint_32_cx i) {
+      CX_ASSERT(rects[i].contains(point), "");
+      visited++;
+    });
+    expected = 0;
+    for (const auto& rect : rects) {
+      expected += rect.contains(point);
+    }
+    CX_ASSERT(visited == expected, "");
+  }
+  CX_ASSERT(Circle(0, 0, 5).intersects(Circle(9, 0, 5)), "touching radii sum");
+  CX_ASSERT(!Circle(0, 0, 5).intersects(Circle(11, 0, 5)), "");
 }
 #endif
 #endif  //CXSTRUCTS_SRC_DATASTRUCTURES_GEOMETRY_H_
@@ -0,0 +1,362 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_GRID2D_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_GRID2D_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+#include "../cxutil/cxthreadpool.h"
+
+namespace cxstructs {
+/**
+ * Non owning view of a row major 2D field
+ * @tparam S the cell type
+ */
+template <typename S>
+struct FieldView {
+  const S* data_;
+  uint32_t width_;
+  uint32_t height_;
+  size_t stride_;
+  FieldView() noexcept : FieldView(nullptr, 0, 0) {}
+  /**
+   * @param data the first cell
+   * @param width cells per row
+   * @param height number of rows
+   * @param stride distance between two rows in cells - 0 means width
+   */
+  FieldView(const S* data, uint32_t width, uint32_t height, size_t stride = 0) noexcept
+      : data_(data), width_(width), height_(height), stride_(stride == 0 ? width : stride) {}
+  FieldView(const std::vector<S>& flat, uint32_t width, uint32_t height) noexcept
+      : FieldView(flat.data(), width, height) {}
+  [[nodiscard]] inline const S& operator()(uint32_t x, uint32_t y) const noexcept {
+    return data_[y * stride_ + x];
+  }
+  [[nodiscard]] inline uint32_t width() const noexcept { return width_; }
+  [[nodiscard]] inline uint32_t height() const noexcept { return height_; }
+  [[nodiscard]] inline bool inside(int64_t x, int64_t y) const noexcept {
+    return x >= 0 && y >= 0 && x < width_ && y < height_;
+  }
+};
+
+/**
+ * ROW_MAJOR stores row after row, TILED stores 8x8 tiles after each other so all 8 neighbours of a cell
+ * are usually in the same 64 cell block
+ */
+enum class GridLayout : uint8_t { ROW_MAJOR, TILED };
+}  // namespace cxstructs
+
+namespace cxhelper {
+struct NoFieldView {};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>Grid2D</h2>
+ * Owning 2D grid in one contiguous allocation, instead of one heap allocation per row of a
+ * <code>std::vector<std::vector<T>></code>.
+ * <br><br>
+ * An optional border of cells surrounds the grid: (x, y) is valid for x in [-border, width + border).
+ * Neighbour loops of kernels like cellular automata or maze carving can then read x - 1 and x + 1 without bounds
+ * checks, the border holds a caller chosen value (e.g. a wall).
+ * <br><br>
+ * A ROW_MAJOR grid is a FieldView of its interior, so it can be passed to GridAStar, GridJPS, GridHPA, FlowField
+ * and batch_pathfinding as is. A TILED grid trades that for locality in both directions and is meant for
+ * 2D stencils over huge grids.
+ * <pre>
+ * Grid2D<uint8_t> tiles(4096, 4096);
+ * tiles.fill_parallel([](uint32_t x, uint32_t y) { return (x ^ y) % 7 == 0; });
+ * astar.find_path(tiles, uint8_t{1}, start, target, path);
+ * </pre>
+ * @tparam T the cell type
+ * @tparam Layout memory order of the cells
+ */
+template <typename T, GridLayout Layout = GridLayout::ROW_MAJOR>
+class Grid2D
+    : public std::conditional_t<Layout == GridLayout::ROW_MAJOR, FieldView<T>, cxhelper::NoFieldView> {
+  using Base = std::conditional_t<Layout == GridLayout::ROW_MAJOR, FieldView<T>, cxhelper::NoFieldView>;
+  static_assert(!std::is_same_v<T, bool>, "use uint8_t, bool cells cant be written from several threads");
+  static constexpr uint32_t kTile = 8;
+  std::vector<T> data_;
+  uint32_t cols_ = 0;
+  uint32_t rows_ = 0;
+  uint32_t border_ = 0;
+  uint32_t stride_ = 0;   // cells per padded row
+  uint32_t tiles_x_ = 0;  // tiles per padded row - TILED only
+
+  // position of the padded coordinate (px, py) in data_
+  [[nodiscard]] inline size_t index(uint32_t px, uint32_t py) const noexcept {
+    if constexpr (Layout == GridLayout::ROW_MAJOR) {
+      return static_cast<size_t>(py) * stride_ + px;
+    } else {
+      const size_t tile = static_cast<size_t>(py / kTile) * tiles_x_ + px / kTile;
+      return tile * kTile * kTile + (py % kTile) * kTile + px % kTile;
+    }
+  }
+  // points the FieldView base at the interior
+  inline void rebind() noexcept {
+    if constexpr (Layout == GridLayout::ROW_MAJOR) {
+      const T* origin = data_.empty() ? nullptr : data_.data() + index(border_, border_);
+      static_cast<FieldView<T>&>(*this) = FieldView<T>(origin, cols_, rows_, stride_);
+    }
+  }
+
+ public:
+  Grid2D() = default;
+  /**
+   * @param width cells per row
+   * @param height number of rows
+   * @param value initial value of the cells
+   * @param border cells of padding on every side
+   * @param border_value value of the padding
+   */
+  Grid2D(uint32_t width, uint32_t height, const T& value = T(), uint32_t border = 0,
+         const T& border_value = T()) {
+    resize(width, height, value, border, border_value);
+  }
+  Grid2D(const Grid2D& o)
+      : Base(), data_(o.data_), cols_(o.cols_), rows_(o.rows_), border_(o.border_), stride_(o.stride_),
+        tiles_x_(o.tiles_x_) {
+    rebind();
+  }
+  Grid2D(Grid2D&& o) noexcept
+      : Base(), data_(std::move(o.data_)), cols_(o.cols_), rows_(o.rows_), border_(o.border_), stride_(o.stride_),
+        tiles_x_(o.tiles_x_) {
+    rebind();
+    o.data_.clear();
+    o.cols_ = o.rows_ = o.border_ = o.stride_ = o.tiles_x_ = 0;
+    o.rebind();
+  }
+  Grid2D& operator=(const Grid2D& o) {
+    if (this != &o) {
+      Grid2D copy(o);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+  Grid2D& operator=(Grid2D&& o) noexcept {
+    if (this != &o) {
+      data_ = std::move(o.data_);
+      cols_ = o.cols_;
+      rows_ = o.rows_;
+      border_ = o.border_;
+      stride_ = o.stride_;
+      tiles_x_ = o.tiles_x_;
+      rebind();
+      o.data_.clear();
+      o.cols_ = o.rows_ = o.border_ = o.stride_ = o.tiles_x_ = 0;
+      o.rebind();
+    }
+    return *this;
+  }
+  /**
+   * Changes the size and resets every cell - reuses the allocation if it is big enough
+   * @param width cells per row
+   * @param height number of rows
+   * @param value value of the cells
+   * @param border cells of padding on every side
+   * @param border_value value of the padding
+   */
+  void resize(uint32_t width, uint32_t height, const T& value = T(), uint32_t border = 0,
+              const T& border_value = T()) {
+    if (width == 0 || height == 0) {
+      width = height = border = 0;
+    }
+    cols_ = width;
+    rows_ = height;
+    border_ = border;
+    stride_ = width + 2 * border;
+    const uint32_t padded_rows = height + 2 * border;
+    size_t cells = static_cast<size_t>(stride_) * padded_rows;
+    if constexpr (Layout == GridLayout::TILED) {
+      tiles_x_ = (stride_ + kTile - 1) / kTile;
+      cells = static_cast<size_t>(tiles_x_) * ((padded_rows + kTile - 1) / kTile) * kTile * kTile;
+    }
+    data_.assign(cells, border_value);
+    rebind();
+    fill(value);
+  }
+  /**
+   * @param x column in [-border, width + border)
+   * @param y row in [-border, height + border)
+   */
+  [[nodiscard]] inline T& operator()(int64_t x, int64_t y) noexcept {
+    CX_ASSERT(x >= -int64_t(border_) && y >= -int64_t(border_) && x < int64_t(cols_) + border_ &&
+                  y < int64_t(rows_) + border_,
+              "index out of bounds");
+    return data_[index(static_cast<uint32_t>(x + border_), static_cast<uint32_t>(y + border_))];
+  }
+  [[nodiscard]] inline const T& operator()(int64_t x, int64_t y) const noexcept {
+    CX_ASSERT(x >= -int64_t(border_) && y >= -int64_t(border_) && x < int64_t(cols_) + border_ &&
+                  y < int64_t(rows_) + border_,
+              "index out of bounds");
+    return data_[index(static_cast<uint32_t>(x + border_), static_cast<uint32_t>(y + border_))];
+  }
+  [[nodiscard]] inline uint32_t width() const noexcept { return cols_; }
+  [[nodiscard]] inline uint32_t height() const noexcept { return rows_; }
+  [[nodiscard]] inline uint32_t border() const noexcept { return border_; }
+  /**
+   * @return true if (x, y) is inside the grid, not in the border
+   */
+  [[nodiscard]] inline bool inside(int64_t x, int64_t y) const noexcept {
+    return x >= 0 && y >= 0 && x < cols_ && y < rows_;
+  }
+  /**
+   * @return the interior as a FieldView - ROW_MAJOR only
+   */
+  [[nodiscard]] inline FieldView<T> view() const noexcept
+    requires(Layout == GridLayout::ROW_MAJOR)
+  {
+    return *this;
+  }
+  /**
+   * @return the cells including border and tile padding, in storage order
+   */
+  [[nodiscard]] inline T* data() noexcept { return data_.data(); }
+  [[nodiscard]] inline const T* data() const noexcept { return data_.data(); }
+  /**
+   * @return the number of stored cells including border and tile padding
+   */
+  [[nodiscard]] inline size_t storage_size() const noexcept { return data_.size(); }
+  /**
+   * Sets every cell inside the grid, the border keeps its value
+   */
+  void fill(const T& value) {
+    for (uint32_t y = 0; y < rows_; y++) {
+      for (uint32_t x = 0; x < cols_; x++) {
+        data_[index(x + border_, y + border_)] = value;
+      }
+    }
+  }
+  /**
+   * Sets every border cell
+   */
+  void fill_border(const T& value) {
+    const int64_t b = border_;
+    for (int64_t y = -b; y < int64_t(rows_) + b; y++) {
+      for (int64_t x = -b; x < int64_t(cols_) + b; x++) {
+        if (!inside(x, y)) {
+          (*this)(x, y) = value;
+        }
+      }
+    }
+  }
+  /**
+   * Sets every cell inside the grid to func(x, y), rows are split over the pool.<p>
+   * func has to be thread safe - for random content derive the value from (x, y) and a seed instead of
+   * sharing one generator
+   * @param func callable taking (uint32_t x, uint32_t y) and returning the value of the cell
+   * @param pool the pool to run on
+   */
+  template <typename Function>
+  void fill_parallel(Function func, ThreadPool& pool = ThreadPool::global()) {
+    const uint_32_cx grain = std::max<uint_32_cx>(1, 16384 / std::max<uint32_t>(cols_, 1));
+    pool.parallel_for(
+        0, rows_,
+        [this, &func](uint_32_cx begin, uint_32_cx end) {
+          // locals, as stores of char sized cells could alias the members
+          T* cells = data_.data();
+          const uint32_t cols = cols_;
+          const uint32_t border = border_;
+          for (auto y = static_cast<uint32_t>(begin); y < end; y++) {
+            if constexpr (Layout == GridLayout::ROW_MAJOR) {
+              T* row = cells + index(border, y + border);
+              for (uint32_t x = 0; x < cols; x++) {
+                row[x] = func(x, y);
+              }
+            } else {
+              for (uint32_t x = 0; x < cols; x++) {
+                cells[index(x + border, y + border)] = func(x, y);
+              }
+            }
+          }
+        },
+        grain);
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "GRID2D TESTS" << std::endl;
+    std::cout << "  Testing access..." << std::endl;
+    Grid2D<int, Layout> g(13, 7, 5, 2, -1);
+    CX_ASSERT(g.width() == 13 && g.height() == 7 && g.border() == 2, "");
+    CX_ASSERT(g(0, 0) == 5 && g(12, 6) == 5, "");
+    CX_ASSERT(g(-1, 0) == -1 && g(-2, -2) == -1 && g(14, 8) == -1 && g(13, 3) == -1, "");
+    for (uint32_t y = 0; y < 7; y++) {
+      for (uint32_t x = 0; x < 13; x++) {
+        g(x, y) = static_cast<int>(y * 100 + x);
+      }
+    }
+    for (uint32_t y = 0; y < 7; y++) {
+      for (uint32_t x = 0; x < 13; x++) {
+        CX_ASSERT(g(x, y) == static_cast<int>(y * 100 + x), "");
+      }
+    }
+    CX_ASSERT(g(-1, 3) == -1 && g(13, 6) == -1, "");
+    g.fill_border(-7);
+    CX_ASSERT(g(-2, 8) == -7 && g(6, 3) == 306, "");
+    if constexpr (Layout == GridLayout::TILED) {
+      // 17x11 padded cells take 3x2 tiles
+      CX_ASSERT(g.storage_size() == 6 * 64, "");
+    } else {
+      CX_ASSERT(g.storage_size() == 17 * 11, "");
+      const FieldView<int>& view = g;
+      CX_ASSERT(view.width() == 13 && view(4, 2) == 204 && view(12, 6) == 612, "");
+      CX_ASSERT(g.view()(0, 6) == 600, "");
+    }
+
+    std::cout << "  Testing copy and move..." << std::endl;
+    Grid2D<int, Layout> copy(g);
+    g(1, 1) = 0;
+    CX_ASSERT(copy(1, 1) == 101 && copy(-1, -1) == -7, "");
+    Grid2D<int, Layout> moved(std::move(copy));
+    CX_ASSERT(moved(1, 1) == 101 && copy.width() == 0 && copy.storage_size() == 0, "");
+    copy = moved;
+    moved = Grid2D<int, Layout>(2, 2, 9);
+    CX_ASSERT(copy(12, 6) == 612 && moved(1, 1) == 9 && moved.storage_size() > 0, "");
+    if constexpr (Layout == GridLayout::ROW_MAJOR) {
+      CX_ASSERT(static_cast<const FieldView<int>&>(copy)(12, 6) == 612, "");
+      CX_ASSERT(static_cast<const FieldView<int>&>(moved)(1, 1) == 9, "");
+    }
+
+    std::cout << "  Testing fill_parallel..." << std::endl;
+    ThreadPool pool(3);
+    Grid2D<uint32_t, Layout> big(1000, 333, 0, 1, 7);
+    big.fill_parallel([](uint32_t x, uint32_t y) { return x * 3 + y * 1000; }, pool);
+    bool same = true;
+    for (uint32_t y = 0; y < 333; y++) {
+      for (uint32_t x = 0; x < 1000; x++) {
+        same &= big(x, y) == x * 3 + y * 1000;
+      }
+    }
+    CX_ASSERT(same, "");
+    CX_ASSERT(big(-1, 0) == 7 && big(1000, 332) == 7 && big(5, 333) == 7, "");
+    big.fill(4);
+    CX_ASSERT(big(999, 332) == 4 && big(-1, -1) == 7, "");
+    big.resize(0, 10);
+    CX_ASSERT(big.storage_size() == 0 && !big.inside(0, 0), "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_GRID2D_H_
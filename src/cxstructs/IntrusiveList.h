@@ -0,0 +1,422 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_INTRUSIVELIST_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_INTRUSIVELIST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "../cxconfig.h"
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <vector>
+#endif
+
+// Intrusive lists don't own or allocate anything - the links live in a hook member of the user's type
+// An object can be in as many lists at once as it has hooks, e.g. an LRU list and a free list
+// Both lists are circular around a sentinel hook, so linking and unlinking never branch on the ends
+
+namespace cxstructs {
+/**
+ * Links of an IntrusiveList - embed one per list the object can be in at the same time
+ */
+struct IntrusiveListHook {
+  IntrusiveListHook* prev_ = nullptr;
+  IntrusiveListHook* next_ = nullptr;
+  IntrusiveListHook() = default;
+  // copying an object doesn't copy its list membership
+  IntrusiveListHook(const IntrusiveListHook&) noexcept {}
+  IntrusiveListHook& operator=(const IntrusiveListHook&) noexcept { return *this; }
+  [[nodiscard]] inline bool is_linked() const noexcept { return next_ != nullptr; }
+};
+/**
+ * Link of an IntrusiveSList - embed one per list the object can be in at the same time
+ */
+struct IntrusiveSListHook {
+  IntrusiveSListHook* next_ = nullptr;
+  IntrusiveSListHook() = default;
+  IntrusiveSListHook(const IntrusiveSListHook&) noexcept {}
+  IntrusiveSListHook& operator=(const IntrusiveSListHook&) noexcept { return *this; }
+  [[nodiscard]] inline bool is_linked() const noexcept { return next_ != nullptr; }
+};
+}  // namespace cxstructs
+
+namespace cxhelper {
+// the object a hook is embedded in - offsetof for a member pointer
+template <typename T, typename Hook, Hook T::*Member>
+inline T* hook_owner(Hook* hook) noexcept {
+  static const std::ptrdiff_t offset = [] {
+    union Probe {
+      char none_;
+      T obj_;
+      Probe() : none_() {}
+      ~Probe() {}
+    } probe;
+    return reinterpret_cast<const char*>(&(probe.obj_.*Member)) - reinterpret_cast<const char*>(&probe);
+  }();
+  return reinterpret_cast<T*>(reinterpret_cast<char*>(hook) - offset);
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>IntrusiveList</h2>
+ * A doubly linked list over objects that carry their own links in an IntrusiveListHook member.
+ * <br><br>
+ * The list never allocates or copies - it only links objects the user owns, so pushing, erasing and moving an
+ * object to the front are O(1) pointer swaps without touching the allocator. Perfect for LRU orders and
+ * bookkeeping where the objects already live somewhere else (a pool, a vec, a HashMap).
+ * <br><br>
+ * <b>Important:</b> An object has to be erased from the list before it is destroyed.
+ *
+ * @tparam T element type
+ * @tparam Member the hook of T this list uses, e.g. &Entry::lru_hook
+ */
+template <typename T, IntrusiveListHook T::*Member>
+class IntrusiveList {
+  IntrusiveListHook sentinel_;
+  uint_32_cx size_ = 0;
+
+  inline static IntrusiveListHook& hook(T& obj) noexcept { return obj.*Member; }
+  inline static T& owner(IntrusiveListHook* hook) noexcept {
+    return *cxhelper::hook_owner<T, IntrusiveListHook, Member>(hook);
+  }
+  inline void link_before(IntrusiveListHook* pos, IntrusiveListHook* node) noexcept {
+    CX_ASSERT(!node->is_linked(), "object is already in a list");
+    node->next_ = pos;
+    node->prev_ = pos->prev_;
+    pos->prev_->next_ = node;
+    pos->prev_ = node;
+    size_++;
+  }
+  inline void unlink(IntrusiveListHook* node) noexcept {
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->prev_ = node->next_ = nullptr;
+    size_--;
+  }
+  inline void take(IntrusiveList& o) noexcept {
+    if (o.size_ == 0) {
+      sentinel_.prev_ = sentinel_.next_ = &sentinel_;
+      return;
+    }
+    sentinel_.next_ = o.sentinel_.next_;
+    sentinel_.prev_ = o.sentinel_.prev_;
+    sentinel_.next_->prev_ = &sentinel_;
+    sentinel_.prev_->next_ = &sentinel_;
+    size_ = o.size_;
+    o.sentinel_.prev_ = o.sentinel_.next_ = &o.sentinel_;
+    o.size_ = 0;
+  }
+
+ public:
+  template <bool Const>
+  class Iterator {
+    using Value = std::conditional_t<Const, const T, T>;
+    IntrusiveListHook* node_;
+
+   public:
+    explicit Iterator(IntrusiveListHook* node) : node_(node) {}
+    inline Value& operator*() const { return owner(node_); }
+    inline Value* operator->() const { return &owner(node_); }
+    inline Iterator& operator++() {
+      node_ = node_->next_;
+      return *this;
+    }
+    inline Iterator& operator--() {
+      node_ = node_->prev_;
+      return *this;
+    }
+    inline bool operator==(const Iterator& o) const { return node_ == o.node_; }
+    inline bool operator!=(const Iterator& o) const { return node_ != o.node_; }
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  IntrusiveList() noexcept { sentinel_.prev_ = sentinel_.next_ = &sentinel_; }
+  IntrusiveList(const IntrusiveList&) = delete;
+  IntrusiveList& operator=(const IntrusiveList&) = delete;
+  IntrusiveList(IntrusiveList&& o) noexcept { take(o); }
+  IntrusiveList& operator=(IntrusiveList&& o) noexcept {
+    if (this != &o) {
+      clear();
+      take(o);
+    }
+    return *this;
+  }
+  // unlinks the remaining objects so their hooks can be reused
+  ~IntrusiveList() { clear(); }
+
+  inline void push_back(T& obj) noexcept { link_before(&sentinel_, &hook(obj)); }
+  inline void push_front(T& obj) noexcept { link_before(sentinel_.next_, &hook(obj)); }
+  /**
+   * Links the object in front of pos
+   */
+  inline void insert(T& pos, T& obj) noexcept { link_before(&hook(pos), &hook(obj)); }
+  /**
+   * Unlinks the object from this list in O(1)
+   */
+  inline void erase(T& obj) noexcept {
+    CX_ASSERT(hook(obj).is_linked(), "object is not in a list");
+    unlink(&hook(obj));
+  }
+  inline T& pop_front() noexcept {
+    CX_ASSERT(size_ > 0, "list is empty");
+    T& obj = owner(sentinel_.next_);
+    unlink(sentinel_.next_);
+    return obj;
+  }
+  inline T& pop_back() noexcept {
+    CX_ASSERT(size_ > 0, "list is empty");
+    T& obj = owner(sentinel_.prev_);
+    unlink(sentinel_.prev_);
+    return obj;
+  }
+  /**
+   * Moves an object of this list to the front - e.g. marking an LRU entry as just used
+   */
+  inline void move_to_front(T& obj) noexcept {
+    unlink(&hook(obj));
+    push_front(obj);
+  }
+  inline void move_to_back(T& obj) noexcept {
+    unlink(&hook(obj));
+    push_back(obj);
+  }
+  [[nodiscard]] inline T& front() noexcept {
+    CX_ASSERT(size_ > 0, "no such element");
+    return owner(sentinel_.next_);
+  }
+  [[nodiscard]] inline T& back() noexcept {
+    CX_ASSERT(size_ > 0, "no such element");
+    return owner(sentinel_.prev_);
+  }
+  /**
+   * Unlinks all objects, the objects themselves are untouched
+   */
+  inline void clear() noexcept {
+    IntrusiveListHook* node = sentinel_.next_;
+    while (node != &sentinel_) {
+      IntrusiveListHook* next = node->next_;
+      node->prev_ = node->next_ = nullptr;
+      node = next;
+    }
+    sentinel_.prev_ = sentinel_.next_ = &sentinel_;
+    size_ = 0;
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+  inline iterator begin() noexcept { return iterator(sentinel_.next_); }
+  inline iterator end() noexcept { return iterator(&sentinel_); }
+  inline const_iterator begin() const noexcept { return const_iterator(sentinel_.next_); }
+  inline const_iterator end() const noexcept {
+    return const_iterator(const_cast<IntrusiveListHook*>(&sentinel_));
+  }
+};
+
+/**
+ * <h2>IntrusiveSList</h2>
+ * A singly linked LIFO list over objects that carry their own link in an IntrusiveSListHook member.
+ * <br><br>
+ * One pointer per object and O(1) push_front/pop_front without any allocation - the classic free list.
+ * Erasing anything but the front is O(n).
+ *
+ * @tparam T element type
+ * @tparam Member the hook of T this list uses, e.g. &Slot::free_hook
+ */
+template <typename T, IntrusiveSListHook T::*Member>
+class IntrusiveSList {
+  IntrusiveSListHook sentinel_;
+  uint_32_cx size_ = 0;
+
+  inline static IntrusiveSListHook& hook(T& obj) noexcept { return obj.*Member; }
+  inline static T& owner(IntrusiveSListHook* hook) noexcept {
+    return *cxhelper::hook_owner<T, IntrusiveSListHook, Member>(hook);
+  }
+
+ public:
+  template <bool Const>
+  class Iterator {
+    using Value = std::conditional_t<Const, const T, T>;
+    IntrusiveSListHook* node_;
+
+   public:
+    explicit Iterator(IntrusiveSListHook* node) : node_(node) {}
+    inline Value& operator*() const { return owner(node_); }
+    inline Value* operator->() const { return &owner(node_); }
+    inline Iterator& operator++() {
+      node_ = node_->next_;
+      return *this;
+    }
+    inline bool operator==(const Iterator& o) const { return node_ == o.node_; }
+    inline bool operator!=(const Iterator& o) const { return node_ != o.node_; }
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  IntrusiveSList() noexcept { sentinel_.next_ = &sentinel_; }
+  IntrusiveSList(const IntrusiveSList&) = delete;
+  IntrusiveSList& operator=(const IntrusiveSList&) = delete;
+  ~IntrusiveSList() { clear(); }
+
+  inline void push_front(T& obj) noexcept {
+    IntrusiveSListHook* node = &hook(obj);
+    CX_ASSERT(!node->is_linked(), "object is already in a list");
+    node->next_ = sentinel_.next_;
+    sentinel_.next_ = node;
+    size_++;
+  }
+  inline T& pop_front() noexcept {
+    CX_ASSERT(size_ > 0, "list is empty");
+    IntrusiveSListHook* node = sentinel_.next_;
+    sentinel_.next_ = node->next_;
+    node->next_ = nullptr;
+    size_--;
+    return owner(node);
+  }
+  [[nodiscard]] inline T& front() noexcept {
+    CX_ASSERT(size_ > 0, "no such element");
+    return owner(sentinel_.next_);
+  }
+  /**
+   * Unlinks the object in O(n)
+   * @return true if it was in this list
+   */
+  inline bool erase(T& obj) noexcept {
+    IntrusiveSListHook* target = &hook(obj);
+    for (IntrusiveSListHook* prev = &sentinel_; prev->next_ != &sentinel_; prev = prev->next_) {
+      if (prev->next_ == target) {
+        prev->next_ = target->next_;
+        target->next_ = nullptr;
+        size_--;
+        return true;
+      }
+    }
+    return false;
+  }
+  inline void clear() noexcept {
+    IntrusiveSListHook* node = sentinel_.next_;
+    while (node != &sentinel_) {
+      IntrusiveSListHook* next = node->next_;
+      node->next_ = nullptr;
+      node = next;
+    }
+    sentinel_.next_ = &sentinel_;
+    size_ = 0;
+  }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+  inline iterator begin() noexcept { return iterator(sentinel_.next_); }
+  inline iterator end() noexcept { return iterator(&sentinel_); }
+  inline const_iterator begin() const noexcept { return const_iterator(sentinel_.next_); }
+  inline const_iterator end() const noexcept {
+    return const_iterator(const_cast<IntrusiveSListHook*>(&sentinel_));
+  }
+};
+}  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+namespace cxtests {
+using namespace cxstructs;
+struct IntrusiveTestEntry {
+  int key = 0;
+  double payload = 0;
+  IntrusiveListHook lru_hook;
+  IntrusiveSListHook free_hook;
+};
+static void TEST_INTRUSIVE_LIST() {
+  std::cout << "TESTING INTRUSIVE LIST" << std::endl;
+  using Entry = IntrusiveTestEntry;
+  std::vector<Entry> entries(100);
+  for (int i = 0; i < 100; i++) {
+    entries[i].key = i;
+  }
+
+  std::cout << "  Testing push and iteration..." << std::endl;
+  IntrusiveList<Entry, &Entry::lru_hook> lru;
+  CX_ASSERT(lru.empty() && lru.begin() == lru.end(), "");
+  for (int i = 0; i < 10; i++) {
+    lru.push_back(entries[i]);
+  }
+  lru.push_front(entries[10]);
+  CX_ASSERT(lru.size() == 11 && lru.front().key == 10 && lru.back().key == 9, "");
+  int expected = 0;
+  for (auto it = ++lru.begin(); it != lru.end(); ++it) {
+    CX_ASSERT(it->key == expected && &*it == &entries[expected], "");
+    expected++;
+  }
+  auto last = --lru.end();
+  CX_ASSERT(last->key == 9, "");
+
+  std::cout << "  Testing LRU operations..." << std::endl;
+  lru.move_to_front(entries[5]);
+  CX_ASSERT(lru.front().key == 5 && lru.size() == 11, "");
+  lru.move_to_back(entries[10]);
+  CX_ASSERT(lru.back().key == 10, "");
+  lru.erase(entries[3]);
+  CX_ASSERT(!entries[3].lru_hook.is_linked() && lru.size() == 10, "");
+  lru.insert(entries[4], entries[3]);
+  CX_ASSERT(entries[3].lru_hook.next_ == &entries[4].lru_hook, "");
+  Entry& evicted = lru.pop_back();
+  CX_ASSERT(evicted.key == 10 && !evicted.lru_hook.is_linked(), "");
+  Entry& newest = lru.pop_front();
+  CX_ASSERT(newest.key == 5 && lru.size() == 9, "");
+
+  std::cout << "  Testing free list..." << std::endl;
+  IntrusiveSList<Entry, &Entry::free_hook> free_list;
+  for (int i = 50; i < 100; i++) {
+    free_list.push_front(entries[i]);
+  }
+  // one object in two lists at once
+  free_list.push_front(entries[0]);
+  CX_ASSERT(free_list.size() == 51 && free_list.front().key == 0 && entries[0].lru_hook.is_linked(), "");
+  const Entry& reused = free_list.pop_front();
+  CX_ASSERT(reused.key == 0 && free_list.front().key == 99, "");
+  const bool erased = free_list.erase(entries[75]);
+  const bool erased_again = free_list.erase(entries[75]);
+  CX_ASSERT(erased && !erased_again && free_list.size() == 49, "");
+  expected = 99;
+  for (const Entry& entry : free_list) {
+    if (expected == 75) {
+      expected--;
+    }
+    CX_ASSERT(entry.key == expected, "");
+    expected--;
+  }
+
+  std::cout << "  Testing move and clear..." << std::endl;
+  IntrusiveList<Entry, &Entry::lru_hook> moved(std::move(lru));
+  CX_ASSERT(moved.size() == 9 && lru.empty() && moved.back().key == 9, "");
+  CX_ASSERT(&*(--moved.end()) == &entries[9], "");
+  moved.clear();
+  free_list.clear();
+  for (const Entry& entry : entries) {
+    CX_ASSERT(!entry.lru_hook.is_linked() && !entry.free_hook.is_linked(), "");
+  }
+  {
+    IntrusiveList<Entry, &Entry::lru_hook> scoped;
+    scoped.push_back(entries[1]);
+  }
+  CX_ASSERT(!entries[1].lru_hook.is_linked(), "");
+}
+}  // namespace cxtests
+#endif
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_INTRUSIVELIST_H_
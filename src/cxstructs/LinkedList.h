@@ -56,12 +56,10 @@ using namespace cxhelper;
  * However, accessing or searching for specific elements in the list requires potentially <b> traversing the entire list,
  * which is an O(n)</b> operation. This makes it less suitable for cases where random access is frequently required.<p>
  */
-template <typename T, bool UseCXPoolAllocator = true>
+template <typename T, AllocPolicy Policy = PoolAlloc>
 class LinkedList {
   using Node = ListNode<T>;
-  using Allocator =
-      typename std::conditional<UseCXPoolAllocator, CXPoolAllocator<Node, sizeof(Node) * 33, 1>,
-                                std::allocator<Node>>::type;
+  using Allocator = cxhelper::policy_allocator_t<Node, Policy>;
 
   Allocator alloc;
   uint_32_cx size_;
@@ -71,14 +69,14 @@ class LinkedList {
 
  public:
   LinkedList() : sentinel_(T()), end_(&sentinel_), size_(0){};
-  LinkedList(const LinkedList<T>& o) : sentinel_(T()), end_(&sentinel_), size_(0) {
+  LinkedList(const LinkedList& o) : size_(0), sentinel_(T()), end_(&sentinel_) {
     Node* current_old = o.sentinel_.next_;
     while (current_old != nullptr) {
       push_back(current_old->val_);
       current_old = current_old->next_;
     }
   }
-  LinkedList& operator=(const LinkedList<T>& o) {
+  LinkedList& operator=(const LinkedList& o) {
     if (this != &o) {
       clear();
       Node* current_old = o.sentinel_.next_;
@@ -263,6 +261,17 @@ class LinkedList {
  * @return the current size of this Linked List
  */
   [[nodiscard]] inline uint_32_cx size() const { return size_; }
+  /**
+   * @return the heap memory of this list - one node per element
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.blocks = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    stats.bytes_reserved = size_ * cxhelper::allocation_size<Allocator>(1);
+    return stats;
+  }
   class Iterator {
    public:
     Node* current;
@@ -280,7 +289,7 @@ class LinkedList {
   Iterator begin() { return Iterator(sentinel_.next_); }
   Iterator end() { return Iterator(nullptr); }
 
-  friend std::ostream& operator<<(std::ostream& os, const LinkedList<T>& q) {
+  friend std::ostream& operator<<(std::ostream& os, const LinkedList& q) {
     Node* current = q.sentinel_.next_;
     while (current != nullptr) {
       os << current->val_ << "->";
@@ -21,14 +21,30 @@
 #ifndef CXSTRUCTS_SRC_DATASTRUCTURES_QUADTREE_H_
 #define CXSTRUCTS_SRC_DATASTRUCTURES_QUADTREE_H_
 
+#include <algorithm>
+#include <new>
+#include <span>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "../cxconfig.h"
 #include "Geometry.h"
+#include "soa_vec.h"
 #include "vec.h"
 
 //used in kNN 2D
 
+namespace cxhelper {
+// a QuadTree node inside a snapshot - nodes are stored in preorder, children in the order of child_bounds()
+struct QuadTreeSnapshotNode {
+  float x, y, width, height;
+  uint32_t points;  // elements of this node, stored in the same preorder
+  uint16_t max_depth;
+  uint16_t children;  // 0 or 4
+};
+}  // namespace cxhelper
+
 namespace cxstructs {
 
 /**
@@ -55,22 +71,67 @@ class QuadTree {
   QuadTree* top_right_;
   QuadTree* bottom_left_;
   QuadTree* bottom_right_;
+  // bounds of child c in the order top left, top right, bottom left, bottom right
+  [[nodiscard]] inline Rect child_bounds(int c) const noexcept {
+    const float half_width = bounds_.width() / 2, half_height = bounds_.height() / 2;
+    return {bounds_.x() + static_cast<float>(c & 1) * half_width,
+            bounds_.y() + static_cast<float>(c >> 1) * half_height, half_width, half_height};
+  }
+  // the 4 children share one allocation - top_left_ is the start of the block
+  inline void make_children() {
+    auto* block = static_cast<QuadTree*>(::operator new(4 * sizeof(QuadTree)));
+    for (int c = 0; c < 4; c++) {
+      new (block + c) QuadTree(child_bounds(c), max_depth_ - 1, max_points_);
+    }
+    set_children(block);
+  }
+  inline void set_children(QuadTree* block) noexcept {
+    top_left_ = block;
+    top_right_ = block + 1;
+    bottom_left_ = block + 2;
+    bottom_right_ = block + 3;
+  }
+  inline void free_children() noexcept {
+    if (top_left_) {
+      for (int c = 0; c < 4; c++) {
+        top_left_[c].~QuadTree();
+      }
+      ::operator delete(top_left_);
+      top_left_ = top_right_ = bottom_left_ = bottom_right_ = nullptr;
+    }
+  }
+  // a leaf takes [first, first + n) as is, otherwise it is partitioned into the quadrants like insert_subtrees()
+  inline void build_node(T* first, uint_32_cx n) {
+    if (n <= max_points_ || max_depth_ == 0) {
+      free_children();
+      vec_.assign(first, n);
+      return;
+    }
+    vec_.assign(first, 0);
+    if (!top_left_) {
+      make_children();
+    } else {
+      for (int c = 0; c < 4; c++) {
+        top_left_[c].bounds_ = child_bounds(c);
+        top_left_[c].max_depth_ = max_depth_ - 1;
+      }
+    }
+    const float mid_x = bounds_.x() + bounds_.width() / 2;
+    const float mid_y = bounds_.y() + bounds_.height() / 2;
+    T* last = first + n;
+    T* bottom = std::partition(first, last, [=](const T& e) { return !(e.y() > mid_y); });
+    T* top_right = std::partition(first, bottom, [=](const T& e) { return !(e.x() > mid_x); });
+    T* bottom_right = std::partition(bottom, last, [=](const T& e) { return !(e.x() > mid_x); });
+    top_left_->build_node(first, top_right - first);
+    top_right_->build_node(top_right, bottom - top_right);
+    bottom_left_->build_node(bottom, bottom_right - bottom);
+    bottom_right_->build_node(bottom_right, last - bottom_right);
+  }
   /**
      * @brief Subdivides the QuadTree into four smaller QuadTrees and distributing elements
      */
-  inline void split() noexcept {
-    const auto half_width = bounds_.width() / 2;
-    auto half_height = bounds_.height() / 2;
-    top_left_ = new QuadTree({bounds_.x(), bounds_.y(), half_width, half_height}, max_depth_ - 1,
-                             max_points_);
-    top_right_ = new QuadTree({bounds_.x() + half_width, bounds_.y(), half_width, half_height},
-                              max_depth_ - 1, max_points_);
-    bottom_left_ = new QuadTree({bounds_.x(), bounds_.y() + half_height, half_width, half_height},
-                                max_depth_ - 1, max_points_);
-    bottom_right_ =
-        new QuadTree({bounds_.x() + half_width, bounds_.y() + half_height, half_width, half_height},
-                     max_depth_ - 1, max_points_);
-
+  inline void split() {
+    make_children();
     for (const auto& e : vec_) {
       insert_subtrees(e);
     }
@@ -100,6 +161,67 @@ class QuadTree {
       bottom_left_->size_subtrees(current);
     }
   }
+  inline void memory_subtrees(MemoryStats& stats, uint_32_cx depth) const noexcept {
+    const MemoryStats points = vec_.memory_stats();
+    stats.elements += points.elements;
+    stats.bytes_used += points.bytes_used;
+    stats.bytes_reserved += points.bytes_reserved;
+    stats.blocks += points.blocks;
+    stats.depth = std::max(stats.depth, depth);
+    if (top_right_) {
+      stats.blocks += 1;
+      stats.bytes_reserved += 4 * sizeof(QuadTree);
+      top_right_->memory_subtrees(stats, depth + 1);
+      top_left_->memory_subtrees(stats, depth + 1);
+      bottom_right_->memory_subtrees(stats, depth + 1);
+      bottom_left_->memory_subtrees(stats, depth + 1);
+    }
+  }
+  template <typename Function>
+  inline void visit_subtrees(Function& func) const {
+    func(bounds_, std::span<const T>(vec_.get_raw(), vec_.size()));
+    if (top_left_) {
+      for (int c = 0; c < 4; c++) {
+        top_left_[c].visit_subtrees(func);
+      }
+    }
+  }
+  inline void save_subtrees(std::vector<cxhelper::QuadTreeSnapshotNode>& nodes, std::vector<T>& points) const {
+    nodes.push_back({bounds_.x(), bounds_.y(), bounds_.width(), bounds_.height(),
+                     static_cast<uint32_t>(vec_.size()), static_cast<uint16_t>(max_depth_),
+                     static_cast<uint16_t>(top_left_ ? 4 : 0)});
+    points.insert(points.end(), vec_.get_raw(), vec_.get_raw() + vec_.size());
+    if (top_left_) {
+      for (int c = 0; c < 4; c++) {
+        top_left_[c].save_subtrees(nodes, points);
+      }
+    }
+  }
+  // rebuilds this node and its subtrees from the records starting at node, false if they dont add up
+  inline bool load_subtrees(const cxhelper::QuadTreeSnapshotNode* nodes, uint64_t count, uint64_t& node,
+                            const T* points, uint64_t point_count, uint64_t& point) {
+    if (node >= count) {
+      return false;
+    }
+    const auto& record = nodes[node++];
+    if (record.points > point_count - point || (record.children != 0 && record.children != 4) ||
+        (record.children && record.max_depth == 0)) {
+      return false;
+    }
+    bounds_ = Rect(record.x, record.y, record.width, record.height);
+    max_depth_ = record.max_depth;
+    vec_.assign(points + point, record.points);
+    point += record.points;
+    if (record.children) {
+      make_children();
+      for (int c = 0; c < 4; c++) {
+        if (!top_left_[c].load_subtrees(nodes, count, node, points, point_count, point)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
   inline void count_subrect_subtrees(const Rect& bound, uint_32_cx& count) noexcept {
     if (bound.intersects(bounds_)) {
       for (const auto& point : vec_) {
@@ -131,23 +253,18 @@ class QuadTree {
       }
     }
   }
-  inline void erase_point(const T& e) const noexcept {
-    if (e.x() > bounds_.x() + bounds_.width() / 2) {
-      if (e.y() > bounds_.y() + bounds_.height() / 2) {
-        bottom_right_->erase(e);
-      } else {
-        top_right_->erase(e);
-      }
-    } else {
-      if (e.y() > bounds_.y() + bounds_.height() / 2) {
-        bottom_left_->erase(e);
-      } else {
-        top_left_->erase(e);
-      }
-    }
+  // squared euclidean distance, the default metric of k_nearest()
+  static inline float squared_distance(float x1, float y1, float x2, float y2) noexcept {
+    return (x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2);
   }
-
  public:
+  /**
+   * Reusable buffers of k_nearest()
+   */
+  struct SearchScratch {
+    std::vector<std::pair<float, QuadTree*>> nodes_;  // min-heap of nodes to visit
+    std::vector<std::pair<float, T*>> best_;          // max-heap of the k closest elements
+  };
   /*no default constructor to prevent modifications and subtree mismatch
    * Setting new bound invalidates the lower layers!
    * Also, no moving(copying) the quad tree yet
@@ -175,24 +292,7 @@ class QuadTree {
   QuadTree& operator=(const QuadTree&) = delete;
   QuadTree(QuadTree&&) = delete;
   QuadTree& operator=(QuadTree&&) = delete;
-  ~QuadTree() {
-    if(top_right_){
-      delete top_right_;
-      top_right_ = nullptr;
-    }
-    if(top_left_){
-      delete top_left_;
-      top_left_ = nullptr;
-    }
-    if(bottom_right_){
-      delete bottom_right_;
-      bottom_right_ = nullptr;
-    }
-    if(bottom_left_){
-      delete bottom_left_;
-      bottom_left_ = nullptr;
-    }
-  }
+  ~QuadTree() { free_children(); }
   /**
      * @brief Inserts a element into the QuadTree.
      *
@@ -221,6 +321,21 @@ class QuadTree {
 
     insert_subtrees(e);
   }
+  /**
+   * Inserts every row of a soa_vec - the first two fields are the x and y coordinate.<p>
+   * Rows are turned into a T with all fields if T is constructible from them, otherwise with just x and y
+   * @param rows the rows to insert
+   */
+  template <typename X, typename Y, typename... Fields>
+  inline void insert(const soa_vec<X, Y, Fields...>& rows) {
+    for (const auto& row : rows) {
+      if constexpr (std::is_constructible_v<T, const X&, const Y&, const Fields&...>) {
+        insert(std::make_from_tuple<T>(row));
+      } else {
+        insert(T(std::get<0>(row), std::get<1>(row)));
+      }
+    }
+  }
 
 
   /**
@@ -243,39 +358,229 @@ class QuadTree {
     accumulate_subrect_subtrees(bound, retval);
     return retval;
   }
+  /**
+   * Finds the k elements closest to (x, y) with a best-first traversal.<p>
+   * Nodes are visited in order of their distance to the query and the search stops as soon as the next node
+   * is farther away than the k-th best element found so far, so only the nodes around the query are touched
+   * @param x x-coordinate of the query
+   * @param y y-coordinate of the query
+   * @param k number of elements
+   * @param result filled with pointers to the up to k closest elements ordered by ascending distance
+   * @param dist distance callable (x1, y1, x2, y2) like cxstructs::euclidean or cxstructs::manhattan - it has to grow
+   * with both coordinate differences, which holds for all Lp distances
+   */
+  template <typename Distance>
+  inline void k_nearest(float x, float y, uint_32_cx k, vec<T*>& result, Distance dist) {
+    SearchScratch scratch;
+    k_nearest(x, y, k, result, dist, scratch);
+  }
+  /**
+   * Same as k_nearest() but reuses the heaps in scratch, so repeated queries dont allocate.<p>
+   * Searching doesnt modify the tree - concurrent queries are fine as long as each thread has its own scratch<p>
+   * result can be any list of T* with clear() and push_back(), a small_vec avoids the allocation of vec::clear()
+   */
+  template <typename Distance, typename Result>
+  inline void k_nearest(float x, float y, uint_32_cx k, Result& result, Distance dist,
+                        SearchScratch& scratch) {
+    result.clear();
+    if (k == 0) {
+      return;
+    }
+    // lower bound for everything inside the node: the distance to the closest point of its bounds
+    auto node_distance = [&](const QuadTree* node) {
+      const Rect& b = node->bounds_;
+      return dist(x, y, std::clamp(x, b.x(), b.x() + b.width()),
+                  std::clamp(y, b.y(), b.y() + b.height()));
+    };
+    auto node_greater = [](const std::pair<float, QuadTree*>& a,
+                           const std::pair<float, QuadTree*>& b) { return a.first > b.first; };
+    auto point_less = [](const std::pair<float, T*>& a, const std::pair<float, T*>& b) {
+      return a.first < b.first;
+    };
+    auto& nodes = scratch.nodes_;
+    auto& best = scratch.best_;
+    nodes.clear();
+    best.clear();
+    nodes.emplace_back(node_distance(this), this);
+    while (!nodes.empty()) {
+      std::pop_heap(nodes.begin(), nodes.end(), node_greater);
+      const auto [node_dist, node] = nodes.back();
+      nodes.pop_back();
+      if (best.size() == k && node_dist >= best.front().first) {
+        break;  // every remaining node is at least as far away
+      }
+      auto arr = node->vec_.get_raw();
+      for (uint_fast32_t i = 0; i < node->vec_.size(); i++) {
+        const float d = dist(x, y, arr[i].x(), arr[i].y());
+        if (best.size() < k) {
+          best.emplace_back(d, &arr[i]);
+          std::push_heap(best.begin(), best.end(), point_less);
+        } else if (d < best.front().first) {
+          std::pop_heap(best.begin(), best.end(), point_less);
+          best.back() = {d, &arr[i]};
+          std::push_heap(best.begin(), best.end(), point_less);
+        }
+      }
+      if (node->top_right_) {
+        for (QuadTree* child :
+             {node->top_left_, node->top_right_, node->bottom_left_, node->bottom_right_}) {
+          nodes.emplace_back(node_distance(child), child);
+          std::push_heap(nodes.begin(), nodes.end(), node_greater);
+        }
+      }
+    }
+    std::sort_heap(best.begin(), best.end(), point_less);
+    for (const auto& pair : best) {
+      result.push_back(pair.second);
+    }
+  }
+  /**
+   * Finds the k elements closest to (x, y) by euclidean distance
+   * @param x x-coordinate of the query
+   * @param y y-coordinate of the query
+   * @param k number of elements
+   * @return pointers to the up to k closest elements ordered by ascending distance
+   */
+  inline vec<T*> k_nearest(float x, float y, uint_32_cx k) {
+    vec<T*> result;
+    k_nearest(x, y, k, result, squared_distance);
+    return result;
+  }
   /**
    * Removes the first occurence of that object from the quadtree<p>
-   * Uses operator== to check for equality
+   * Uses operator== to check for equality - only the subtrees containing its position are searched
    * @param e the element to erase
+   * @return true if an element was removed
    */
-  inline void erase(const T& e) {
+  inline bool erase(const T& e) {
     if (!top_right_) {
-      vec_.erase(e);
-    } else {
-      erase_point(e);
+      return vec_.erase(e);
+    }
+    // a point on a border between quadrants can be in either of them
+    for (QuadTree* child : {top_left_, top_right_, bottom_left_, bottom_right_}) {
+      if (child->bounds_.contains(e) && child->erase(e)) {
+        return true;
+      }
     }
+    return false;
   }
   /**
-   * Clears the QuadTree of all elements including its own subtrees
+   * Expands the bounds until they contain (x, y) without reinserting any element.<p>
+   * Each step puts the current tree into one quadrant of a new root twice its size (growing towards the point),
+   * so it costs O(log(distance / size)) and raises the max depth by one
+   * @param x x-coordinate to include
+   * @param y y-coordinate to include
    */
-  inline void clear() {
-    if(top_right_){
-      delete top_right_;
-      top_right_ = nullptr;
+  inline void grow(float x, float y) {
+    CX_ASSERT(bounds_.width() > 0 && bounds_.height() > 0, "cant grow empty bounds");
+    while (!bounds_.contains(Point{x, y})) {
+      const Rect previous = bounds_;
+      const float w = previous.width(), h = previous.height();
+      const bool left = x < previous.x(), up = y < previous.y();
+      bounds_ = {left ? previous.x() - w : previous.x(), up ? previous.y() - h : previous.y(), 2 * w, 2 * h};
+      const int old_slot = (left ? 1 : 0) + (up ? 2 : 0);  // the quadrant away from the point
+      auto* block = static_cast<QuadTree*>(::operator new(4 * sizeof(QuadTree)));
+      for (int c = 0; c < 4; c++) {
+        new (block + c) QuadTree(c == old_slot ? previous : child_bounds(c), max_depth_, max_points_);
+      }
+      QuadTree& old = block[old_slot];
+      old.vec_ = std::move(vec_);
+      old.top_left_ = top_left_;
+      old.top_right_ = top_right_;
+      old.bottom_left_ = bottom_left_;
+      old.bottom_right_ = bottom_right_;
+      set_children(block);
+      max_depth_++;
     }
-    if(top_left_){
-      delete top_left_;
-      top_left_ = nullptr;
+  }
+  /**
+   * Reusable buffers of rebuild_in_place()
+   */
+  struct BuildScratch {
+    std::vector<T> points_;  // the elements while they are partitioned
+  };
+  /**
+   * Builds the tree from all elements at once, replacing the old content - elements outside the bounds are
+   * skipped like in insert().<p>
+   * The elements are sorted into z-order (the Morton order of the quadrants) with one 4-way partition per
+   * level, using the same midpoints as insert(). Every node is then created once with its final elements:
+   * no split() redistributes anything, each leaf copies one contiguous range and the 4 children of a node
+   * share one allocation. The result has the same shape as inserting the elements one by one
+   * @param elements the elements to copy into the tree
+   */
+  inline void build(std::span<const T> elements) {
+    BuildScratch scratch;
+    clear();
+    rebuild_in_place(elements, scratch);
+  }
+  /**
+   * build() that keeps the current nodes and point arrays wherever the new shape still has them - only nodes that
+   * now need children allocate, only ones that lost them free. Meant for trees rebuilt every frame from points
+   * that moved a bit, with one scratch per tree (or thread) reused between frames
+   * @param elements the elements to copy into the tree
+   * @param scratch reused buffers
+   */
+  inline void rebuild_in_place(std::span<const T> elements, BuildScratch& scratch) {
+    auto& points = scratch.points_;
+    points.clear();
+    for (const T& e : elements) {
+      if (bounds_.contains(e)) {
+        points.push_back(e);
+      }
     }
-    if(bottom_right_){
-      delete bottom_right_;
-      bottom_right_ = nullptr;
+    build_node(points.data(), points.size());
+  }
+  /**
+   * Writes the tree into a snapshot - see cxsnapshot.h<p>
+   * The nodes are stored in preorder with their bounds and element counts in place of child pointers,
+   * followed by all elements as one raw array
+   * @param writer a SnapshotWriter
+   */
+  template <typename Writer>
+  void save_snapshot(Writer& writer) const {
+    static_assert(std::is_trivially_copyable_v<T>, "snapshots store QuadTree elements raw");
+    std::vector<cxhelper::QuadTreeSnapshotNode> nodes;
+    std::vector<T> points;
+    save_subtrees(nodes, points);
+    writer.begin("quadtree", 1, sizeof(T), points.size());
+    writer.write_value(static_cast<uint64_t>(max_points_));
+    writer.write_value(static_cast<uint64_t>(nodes.size()));
+    writer.write_array(nodes.data(), nodes.size());
+    writer.write_array(points.data(), points.size());
+    writer.end();
+  }
+  /**
+   * Replaces the contents with the next snapshot section - the saved shape is recreated as is, without
+   * inserting or splitting anything. A failed load leaves the tree empty
+   * @param reader a SnapshotReader
+   * @return false if the section doesnt hold a QuadTree of this element type
+   */
+  template <typename Reader>
+  bool load_snapshot(Reader& reader) {
+    uint64_t point_count = 0, max_points = 0, count = 0;
+    if (!reader.begin("quadtree", 1, sizeof(T), point_count) || !reader.read_value(max_points) ||
+        !reader.read_value(count)) {
+      return false;
     }
-    if(bottom_left_){
-      delete bottom_left_;
-      bottom_left_ = nullptr;
+    const auto* nodes = reader.template read_array<cxhelper::QuadTreeSnapshotNode>(count);
+    const T* points = reader.template read_array<T>(point_count);
+    if (!nodes || !points) {
+      return false;
     }
-
+    clear();
+    max_points_ = static_cast<uint_16_cx>(max_points);
+    uint64_t node = 0, point = 0;
+    if (!load_subtrees(nodes, count, node, points, point_count, point) || node != count || point != point_count) {
+      clear();
+      return false;
+    }
+    return reader.end();
+  }
+  /**
+   * Clears the QuadTree of all elements including its own subtrees
+   */
+  inline void clear() {
+    free_children();
     vec_.clear();
   };
   /**
@@ -288,6 +593,15 @@ class QuadTree {
     size_subtrees(size);
     return size;
   }
+  /**
+   * Actively iterates down the whole tree - the point vectors of all nodes and the subtrees themselves
+   * @return the heap memory of this tree
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    memory_subtrees(stats, 1);
+    return stats;
+  }
   /**
    * Actively iterates down the tree for its max depth<p>
    * <b>This can get slow on large trees </b>
@@ -310,6 +624,15 @@ class QuadTree {
    */
   inline void set_bounds(const Rect& new_bound) noexcept { bounds_ = new_bound; }
   [[nodiscard]] inline const Rect& get_bounds() const noexcept { return bounds_; }
+  /**
+   * Calls func(bounds, elements) for every node in preorder - elements are the ones stored in the node itself,
+   * so every element is passed exactly once
+   * @param func callable taking (const Rect&, std::span<const T>)
+   */
+  template <typename Function>
+  inline void for_each_node(Function func) const {
+    visit_subtrees(func);
+  }
   class Iterator {};
 #ifndef CX_DELETE_TESTS
   static void TEST() {
@@ -335,18 +658,124 @@ class QuadTree {
     tree.erase({2, 2});
     CX_ASSERT(tree.size() == 1000,"");
 
+    std::cout << "   Testing grow..." << std::endl;
+    QuadTree<Point> grown({0, 0, 10, 10}, 6, 2);
+    std::vector<Point> grown_points;
+    for (int i = 0; i <= 10; i++) {
+      grown_points.emplace_back(static_cast<float>(i), static_cast<float>(10 - i));
+    }
+    grown_points.emplace_back(-25, 37);
+    grown_points.emplace_back(100, -3);
+    for (const auto& p : grown_points) {
+      grown.grow(p.x(), p.y());
+      grown.insert(p);
+    }
+    CX_ASSERT(grown.get_bounds().contains(Point{-25, 37}), "");
+    CX_ASSERT(grown.get_bounds().contains(Point{100, -3}), "");
+    CX_ASSERT(grown.size() == grown_points.size(), "");
+    CX_ASSERT(grown.k_nearest(-20, 30, 1)[0]->x() == -25, "");
+    for (const auto& p : grown_points) {  // also the ones on the borders of the old root
+      CX_ASSERT(grown.erase(p), "");
+    }
+    CX_ASSERT(grown.size() == 0, "");
+    CX_ASSERT(!grown.erase({1, 1}), "");
+
+    std::cout << "   Testing soa_vec insert..." << std::endl;
+    soa_vec<float, float, int> rows;
+    for (int i = 0; i < 500; i++) {
+      rows.push_back(distr(gen), distr(gen), i);
+    }
+    QuadTree<Point> soa_tree({0, 0, 200, 200});
+    soa_tree.insert(rows);
+    CX_ASSERT(soa_tree.size() == 500, "");
+
     std::cout << "   Testing max capacity..." << std::endl;
     QuadTree<Point> tree1({0, 0, 200, 200}, 2, 10);
     for (uint_fast32_t i = 0; i < 100000; i++) {
       tree.insert({distr(gen), distr(gen)});
     }
 
+    std::cout << "   Testing k_nearest..." << std::endl;
+    QuadTree<Point> tree2({0, 0, 200, 200}, 8, 16);
+    std::vector<Point> points;
+    for (uint_fast32_t i = 0; i < 5000; i++) {
+      points.emplace_back(distr(gen), distr(gen));
+      tree2.insert(points.back());
+    }
+    for (int q = 0; q < 50; q++) {
+      const float x = distr(gen) * 1.2F - 20, y = distr(gen) * 1.2F - 20;  // also outside the bounds
+      auto closest = tree2.k_nearest(x, y, 10);
+      CX_ASSERT(closest.size() == 10, "");
+      std::vector<float> dists;
+      for (const auto& p : points) {
+        dists.push_back(squared_distance(x, y, p.x(), p.y()));
+      }
+      std::sort(dists.begin(), dists.end());
+      for (int i = 0; i < 10; i++) {
+        CX_ASSERT(squared_distance(x, y, closest[i]->x(), closest[i]->y()) == dists[i], "");
+      }
+    }
+    vec<Point*> manhattan_closest;
+    tree2.k_nearest(100, 100, 3, manhattan_closest, [](float x1, float y1, float x2, float y2) {
+      return std::abs(x1 - x2) + std::abs(y1 - y2);
+    });
+    CX_ASSERT(manhattan_closest.size() == 3, "");
+    CX_ASSERT(tree2.k_nearest(1, 1, 0).size() == 0, "");
+    CX_ASSERT(tree2.k_nearest(1, 1, 10000).size() == 5000, "");
+
+    std::cout << "   Testing build..." << std::endl;
+    QuadTree<Point> built({0, 0, 200, 200}, 8, 16);
+    built.build(points);
+    CX_ASSERT(built.size() == points.size(), "");
+    CX_ASSERT(built.depth() == tree2.depth(), "");
+    CX_ASSERT(built.memory_stats().depth == tree2.memory_stats().depth, "");
+    for (int q = 0; q < 20; q++) {
+      const Rect r{distr(gen), distr(gen), distr(gen) / 4, distr(gen) / 4};
+      CX_ASSERT(built.count_subrect(r) == tree2.count_subrect(r), "");
+      auto a = built.k_nearest(r.x(), r.y(), 5);
+      auto b = tree2.k_nearest(r.x(), r.y(), 5);
+      for (int i = 0; i < 5; i++) {
+        CX_ASSERT(*a[i] == *b[i], "");
+      }
+    }
+    built.insert({100, 100});
+    CX_ASSERT(built.erase({100, 100}) && built.erase(points[42]), "");
+    CX_ASSERT(built.size() == points.size() - 1, "");
+
+    std::cout << "   Testing rebuild_in_place..." << std::endl;
+    QuadTree<Point>::BuildScratch build_scratch;
+    for (int frame = 0; frame < 5; frame++) {
+      for (auto& p : points) {  // everything drifts a bit, some leave the bounds
+        p = Point(p.x() + 3.0F, p.y() - 1.0F);
+      }
+      built.rebuild_in_place(points, build_scratch);
+      QuadTree<Point> fresh({0, 0, 200, 200}, 8, 16);
+      for (const auto& p : points) {
+        fresh.insert(p);
+      }
+      CX_ASSERT(built.size() == fresh.size(), "");
+      CX_ASSERT(built.count_subrect({50, 50, 30, 30}) == fresh.count_subrect({50, 50, 30, 30}), "");
+      CX_ASSERT(built.k_nearest(10, 190, 1)[0]->x() == fresh.k_nearest(10, 190, 1)[0]->x(), "");
+    }
+    built.rebuild_in_place(std::span<const Point>(points).first(3), build_scratch);
+    CX_ASSERT(built.size() <= 3 && built.depth() == 0, "");
+
     std::cout << "   Testing object retrieval..." << std::endl;
     tree1.clear();
     tree1.insert({2, 2});
     for (auto ptr : tree1.get_subrect({0, 0, 2, 2})) {
       CX_ASSERT(*ptr == Point(2, 2),"");
     }
+
+    std::cout << "   Testing memory_stats..." << std::endl;
+    QuadTree<Point> tree3({0, 0, 100, 100}, 10, 4);
+    for (int i = 0; i < 5; i++) {
+      tree3.insert({i * 0.1F, i * 0.1F});  // forces splits down one corner
+    }
+    auto stats = tree3.memory_stats();
+    CX_ASSERT(stats.elements == 5 && stats.depth >= 2, "");
+    CX_ASSERT(stats.depth > tree3.depth(), "depth() only follows the top right quadrant");
+    CX_ASSERT(stats.bytes_reserved >= stats.bytes_used, "");
   }
 #endif
 };
@@ -26,6 +26,7 @@
 #include <cstdint>
 #include <exception>
 #include <iostream>
+#include <span>
 
 namespace cxstructs {
 
@@ -39,11 +40,9 @@ namespace cxstructs {
  * The difference to a DeQueue (double ended queue) is the limitation of only being able to push_back to the end and pop_back from the start.
  * @tparam T the datatype
  */
-template <typename T, bool UseCXPoolAllocator = true>
+template <typename T, AllocPolicy Policy = PoolAlloc>
 class Queue {
-  using Allocator =
-      typename std::conditional<UseCXPoolAllocator, CXPoolAllocator<T, sizeof(T) * 33, 1>,
-                                std::allocator<T>>::type;
+  using Allocator = cxhelper::policy_allocator_t<T, Policy>;
   Allocator alloc;
   T* arr_;
   uint_32_cx len_;
@@ -53,6 +52,7 @@ class Queue {
   bool is_trivial_destr = std::is_trivially_destructible<T>::value;
 
   inline void grow() {
+    auto old_len = len_;
     len_ *= 2;
 
     T* n_arr = alloc.allocate(len_);
@@ -60,8 +60,8 @@ class Queue {
     if (front_ == 0) {
       std::uninitialized_move(arr_, arr_ + size_, n_arr);
     } else {
-      std::uninitialized_move(arr_ + front_, arr_ + size_, n_arr);
-      std::uninitialized_move(arr_, arr_ + front_, n_arr + size_ - 1);
+      std::uninitialized_move(arr_ + front_, arr_ + old_len, n_arr);
+      std::uninitialized_move(arr_, arr_ + front_, n_arr + old_len - front_);
     }
 
     if (!is_trivial_destr) {
@@ -70,29 +70,27 @@ class Queue {
       }
     }
 
-    alloc.deallocate(arr_, size_);
+    alloc.deallocate(arr_, old_len);
     arr_ = n_arr;
     front_ = 0;
   }
   inline void shrink() {
+    auto old_len = len_;
     len_ = size_ * 1.5;
 
     T* n_arr = alloc.allocate(len_);
 
-    if (front_ == 0) {
-      std::uninitialized_move(arr_, arr_ + size_, n_arr);
-    } else {
-      std::uninitialized_move(arr_ + front_, arr_ + size_, n_arr);
-      std::uninitialized_move(arr_, arr_ + front_, n_arr + size_);
-    }
+    const uint_32_cx first = std::min(size_, old_len - front_);
+    std::uninitialized_move(arr_ + front_, arr_ + front_ + first, n_arr);
+    std::uninitialized_move(arr_, arr_ + (size_ - first), n_arr + first);
 
     if (!is_trivial_destr) {
-      for (size_t i = 0; i < size_; i++) {
+      for (size_t i = 0; i < old_len; i++) {
         std::allocator_traits<Allocator>::destroy(alloc, &arr_[i]);
       }
     }
 
-    alloc.deallocate(arr_, size_);
+    alloc.deallocate(arr_, old_len);
     arr_ = n_arr;
     front_ = 0;
   }
@@ -178,7 +176,7 @@ class Queue {
     }
     int_32_cx index = front_ + size_;
     if (index >= len_) {
-      index = 0;
+      index -= len_;
     }
     arr_[index] = e;
     size_++;
@@ -193,7 +191,7 @@ class Queue {
     }
     int_32_cx index = front_ + size_;
     if (index >= len_) {
-      index = 0;
+      index -= len_;
     }
     arr_[index] = std::move(e);
     size_++;
@@ -210,7 +208,7 @@ class Queue {
     }
     int_32_cx index = front_ + size_;
     if (index >= len_) {
-      index = 0;
+      index -= len_;
     }
     std::allocator_traits<Allocator>::construct(alloc, &arr_[index], std::forward<Args>(args)...);
     size_++;
@@ -253,7 +251,7 @@ class Queue {
 
     int_32_cx index = front_ + size_ - 1;
     if (index >= len_) {
-      index = 0;
+      index -= len_;
     }
     return arr_[index];
   }
@@ -266,10 +264,38 @@ class Queue {
     CX_ASSERT(size_ > 0, "no such element");
     int_32_cx index = front_ + size_ - 1;
     if (index >= len_) {
-      index = 0;
+      index -= len_;
     }
     return arr_[index];
   }
+  /**
+   * Element access counted from the front - index 0 is the oldest element
+   * @param i the position from the front
+   * @return a reference to the element
+   */
+  [[nodiscard]] inline T& operator[](uint_32_cx i) const noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    uint_32_cx index = front_ + i;
+    if (index >= len_) {
+      index -= len_;
+    }
+    return arr_[index];
+  }
+  /**
+   * Returns the contiguous run of the ring buffer that starts at position <b>i</b> from the front.<br>
+   * The queued elements are split into at most two such runs - call again with i + run.size() for the second.
+   * Lets callers process the contents with plain loops instead of per element index wrapping
+   * @param i the position from the front
+   * @return a span over the elements [i, i + n) with n as large as possible without wrapping
+   */
+  [[nodiscard]] inline std::span<T> segment(uint_32_cx i) const noexcept {
+    CX_ASSERT(i <= size_, "index out of bounds");
+    uint_32_cx index = front_ + i;
+    if (index >= len_) {
+      index -= len_;
+    }
+    return {arr_ + index, std::min(size_ - i, len_ - index)};
+  }
   /**
    *
    * @return true if the queue is empty
@@ -304,13 +330,26 @@ class Queue {
    * @return
    */
   [[nodiscard]] inline uint_32_cx capacity() const { return len_; }
+  /**
+   * @return the heap memory of this Queue - one array of capacity() elements
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    if (arr_) {
+      stats.bytes_reserved = cxhelper::allocation_size<Allocator>(len_);
+      stats.blocks = 1;
+    }
+    return stats;
+  }
   friend std::ostream& operator<<(std::ostream& os, const Queue& q) {
     if (q.size() == 0) {
       return os << "[]";
     }
-    os << "[" << q.arr_[0];
-    for (uint_32_cx i = q.front_ + 1; i < q.size_; i++) {
-      os << "," << q.arr_[i];
+    os << "[" << q[0];
+    for (uint_32_cx i = 1; i < q.size_; i++) {
+      os << "," << q[i];
     }
     return os << "]";
   }
@@ -318,26 +357,24 @@ class Queue {
     T* ptr;
     uint_32_cx current;
     uint_32_cx len;
+    uint_32_cx pos;
 
    public:
-    explicit Iterator(T* p, uint_32_cx start, uint_32_cx len) : len(len), ptr(p), current(start) {}
+    explicit Iterator(T* p, uint_32_cx start, uint_32_cx len, uint_32_cx pos)
+        : ptr(p), current(start), len(len), pos(pos) {}
     T& operator*() { return ptr[current]; }
     Iterator& operator++() {
       if (++current >= len) {
         current = 0;
       }
+      pos++;
       return *this;
     }
-    bool operator!=(const Iterator& other) const { return current != other.current; }
-    bool operator==(const Iterator& other) const { return current == other.current; }
+    bool operator!=(const Iterator& other) const { return pos != other.pos; }
+    bool operator==(const Iterator& other) const { return pos == other.pos; }
   };
-  inline Iterator begin() { return Iterator(arr_, front_, len_); }
-  inline Iterator end() {
-    int_32_cx index = front_ + size_ - 1;
-    if (index >= len_) {
-      index = 0;
-    }
-    return Iterator(arr_, index, len_); }
+  inline Iterator begin() { return Iterator(arr_, front_, len_, 0); }
+  inline Iterator end() { return Iterator(arr_, front_, len_, size_); }
 #ifndef CX_DELETE_TESTS
 #include <queue>
   static void TEST() {
@@ -461,8 +498,40 @@ class Queue {
     }
     int b = 20;
     for(auto val : qq){
-     // CX_ASSERT(b++ ==val, "");
+      CX_ASSERT(b++ == val, "");
+    }
+
+    std::cout << "  Testing growth of a wrapped queue and segments..." << std::endl;
+    Queue<int> qw(8);
+    for (int j = 0; j < 6; j++) {
+      qw.push(j);
+    }
+    for (int j = 0; j < 4; j++) {
+      qw.pop();
+    }
+    for (int j = 6; j < 20; j++) {
+      qw.push(j);
+    }
+    CX_ASSERT(qw.size() == 16, "");
+    for (uint_fast32_t j = 0; j < qw.size(); j++) {
+      CX_ASSERT(qw[j] == (int)j + 4, "");
+    }
+    CX_ASSERT(qw.back() == 19, "");
+    for (int j = 0; j < 10; j++) {
+      qw.pop();
+      qw.push(20 + j);
+    }
+    uint_fast32_t seen = 0;
+    while (seen < qw.size()) {
+      auto run = qw.segment(seen);
+      CX_ASSERT(!run.empty(), "");
+      for (int val : run) {
+        CX_ASSERT(val == (int)seen + 14, "");
+        seen++;
+      }
     }
+    qw.shrink_to_fit();
+    CX_ASSERT(qw.front() == 14 && qw.back() == 29, "");
 
   }
 #endif
@@ -42,11 +42,9 @@ namespace cxstructs {
  * <br><br>
  * The Stack is highly efficient and simple to use, primarily because its LIFO structure ensures that the element to be accessed is always at the same location (the top).
  */
-template <typename T, bool UseCXPoolAllocator = true>
+template <typename T, AllocPolicy Policy = PoolAlloc>
 class Stack {
-  using Allocator =
-      typename std::conditional<UseCXPoolAllocator, CXPoolAllocator<T, sizeof(T) * 33, 1>,
-                                std::allocator<T>>::type;
+  using Allocator = cxhelper::policy_allocator_t<T, Policy>;
   Allocator alloc;
   T* arr_;
   uint_32_cx size_;
@@ -54,6 +52,7 @@ class Stack {
   bool is_trivial_destr = std::is_trivially_destructible<T>::value;
 
   inline void grow() {
+    auto old_len = len_;
     len_ *= 2;
 
     T* n_arr = alloc.allocate(len_);
@@ -67,7 +66,7 @@ class Stack {
       }
     }
 
-    alloc.deallocate(arr_, size_);
+    alloc.deallocate(arr_, old_len);
     arr_ = n_arr;
     //as array is moved no need for delete []
   }
@@ -149,11 +148,11 @@ class Stack {
     }
   }
   //copy constructor
-  explicit Stack(const Stack<T>& o) : size_(o.size_), len_(o.len_) {
+  explicit Stack(const Stack& o) : size_(o.size_), len_(o.len_) {
     arr_ = alloc.allocate(len_);
     std::copy(o.arr_, o.arr_ + size_, arr_);
   }
-  Stack& operator=(const Stack<T>& o) {
+  Stack& operator=(const Stack& o) {
     if (this != &o) {
       //ugly allocator syntax but saves a lot when using primitive types
       if (!is_trivial_destr) {
@@ -218,6 +217,19 @@ class Stack {
    * @return The number of elements in the Stack.
    */
   [[nodiscard]] inline uint_32_cx size() { return size_; }
+  /**
+   * @return the heap memory of this Stack - one array of capacity() elements
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.bytes_used = size_ * sizeof(T);
+    if (arr_) {
+      stats.bytes_reserved = cxhelper::allocation_size<Allocator>(len_);
+      stats.blocks = 1;
+    }
+    return stats;
+  }
   /**
      * @brief Pushes an element onto the Stack.
      *
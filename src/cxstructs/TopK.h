@@ -0,0 +1,331 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_TOPK_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_TOPK_H_
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <thread>
+#include <vector>
+#include "../cxconfig.h"
+
+// Bounded top-k selection over a stream of scored values
+// A fixed capacity min-heap holds the k best so far, its root is the score a candidate has to beat
+// Batches are filtered against that threshold with SIMD before anything touches the heap
+
+namespace cxhelper {
+/**
+ * Bitmask of the scores that beat the threshold - bit i is set if scores[i] > threshold
+ * (or < threshold if Largest is false). At most 8 scores per call, NaN never beats it
+ */
+template <bool Largest>
+inline uint32_t beats_mask8(const float* scores, float threshold) noexcept {
+#if defined(CX_AVX2)
+  const __m256 s = _mm256_loadu_ps(scores);
+  const __m256 t = _mm256_set1_ps(threshold);
+  return static_cast<uint32_t>(_mm256_movemask_ps(Largest ? _mm256_cmp_ps(s, t, _CMP_GT_OQ)
+                                                          : _mm256_cmp_ps(s, t, _CMP_LT_OQ)));
+#elif defined(CX_SSE2)
+  const __m128 t = _mm_set1_ps(threshold);
+  const __m128 lo = _mm_loadu_ps(scores), hi = _mm_loadu_ps(scores + 4);
+  const int low = _mm_movemask_ps(Largest ? _mm_cmpgt_ps(lo, t) : _mm_cmplt_ps(lo, t));
+  const int high = _mm_movemask_ps(Largest ? _mm_cmpgt_ps(hi, t) : _mm_cmplt_ps(hi, t));
+  return static_cast<uint32_t>(low | high << 4);
+#elif defined(CX_NEON)
+  const float32x4_t t = vdupq_n_f32(threshold);
+  const float32x4_t lo = vld1q_f32(scores), hi = vld1q_f32(scores + 4);
+  const uint32x4_t low = Largest ? vcgtq_f32(lo, t) : vcltq_f32(lo, t);
+  const uint32x4_t high = Largest ? vcgtq_f32(hi, t) : vcltq_f32(hi, t);
+  const uint32x4_t bits = {1, 2, 4, 8};
+  return vaddvq_u32(vandq_u32(low, bits)) | vaddvq_u32(vandq_u32(high, bits)) << 4;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < 8; i++) {
+    mask |= static_cast<uint32_t>(Largest ? scores[i] > threshold : scores[i] < threshold) << i;
+  }
+  return mask;
+#endif
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+
+/**
+ * <h2>TopK</h2>
+ * keeps the k values with the highest scores (or the lowest if Largest is false) out of any number of pushes.<p>
+ * Memory is fixed to k entries: a binary min-heap whose root is the current k-th best score - the threshold.
+ * A push that doesnt beat the threshold is a single comparison, a push that does replaces the root and
+ * sifts it down (O(log k)). push_n() compares 8 scores at a time against the threshold with SIMD and only
+ * hands the survivors to the heap - once the heap has settled that is almost none of them.
+ * <br><br>
+ * TopKs are mergeable: give every thread its own one and merge() the partial results at the end.
+ * On equal scores the value pushed first is kept. NaN scores are ignored.
+ * @tparam V the value stored with each score - e.g. an id
+ * @tparam Largest true to keep the highest scores, false to keep the lowest (e.g. distances)
+ */
+template <typename V = uint32_t, bool Largest = true>
+class TopK {
+ public:
+  struct Entry {
+    float score;
+    V value;
+  };
+
+ private:
+  std::vector<Entry> heap_;  // never grows past k_
+  uint_32_cx k_;
+
+  // a is a better score than b
+  static inline bool better(float a, float b) noexcept { return Largest ? a > b : a < b; }
+  inline void sift_up(uint_32_cx i) noexcept {
+    const Entry e = heap_[i];
+    while (i > 0) {
+      const uint_32_cx parent = (i - 1) / 2;
+      if (!better(heap_[parent].score, e.score)) {
+        break;
+      }
+      heap_[i] = heap_[parent];
+      i = parent;
+    }
+    heap_[i] = e;
+  }
+  // puts e at the root and restores the heap - cheaper than pop and push
+  inline void replace_root(const Entry& e) noexcept {
+    const uint_32_cx n = heap_.size();
+    uint_32_cx i = 0;
+    while (true) {
+      uint_32_cx child = 2 * i + 1;
+      if (child >= n) {
+        break;
+      }
+      if (child + 1 < n && better(heap_[child].score, heap_[child + 1].score)) {
+        child++;
+      }
+      if (!better(e.score, heap_[child].score)) {
+        break;
+      }
+      heap_[i] = heap_[child];
+      i = child;
+    }
+    heap_[i] = e;
+  }
+
+ public:
+  /**
+   * @param k the number of values to keep
+   */
+  explicit TopK(uint_32_cx k = 10) : k_(k) { heap_.reserve(k); }
+  /**
+   * Offers a value - it is kept if it is among the k best so far
+   * @return true if it was kept
+   */
+  inline bool push(float score, const V& value) noexcept {
+    if (heap_.size() < k_) {
+      if (std::isnan(score)) {
+        return false;
+      }
+      heap_.push_back({score, value});
+      sift_up(heap_.size() - 1);
+      return true;
+    }
+    if (k_ == 0 || !better(score, heap_[0].score)) {
+      return false;
+    }
+    replace_root({score, value});
+    return true;
+  }
+  /**
+   * Offers scores[i] with values[i] for all i - same as n calls to push() but compares 8 scores at a time
+   * against the threshold, so rejected candidates never touch the heap
+   */
+  inline void push_n(const float* scores, const V* values, uint_32_cx n) noexcept {
+    push_n(scores, n, [values](uint_32_cx i) { return values[i]; });
+  }
+  /**
+   * Offers scores[i] with the value make_value(i) for all i - the value is only made for candidates that
+   * beat the threshold, e.g. [first](uint_32_cx i) { return first + i; } for consecutive ids
+   */
+  template <typename MakeValue>
+  inline void push_n(const float* scores, uint_32_cx n, MakeValue make_value) noexcept {
+    uint_32_cx i = 0;
+    for (; i < n && heap_.size() < k_; i++) {
+      push(scores[i], make_value(i));
+    }
+    if (k_ == 0) {
+      return;
+    }
+    for (; i + 8 <= n; i += 8) {
+      uint32_t mask = cxhelper::beats_mask8<Largest>(scores + i, heap_[0].score);
+      while (mask) {
+        const int lane = std::countr_zero(mask);
+        mask &= mask - 1;
+        // the threshold may have moved since the mask was taken
+        if (better(scores[i + lane], heap_[0].score)) {
+          replace_root({scores[i + lane], make_value(i + lane)});
+        }
+      }
+    }
+    for (; i < n; i++) {
+      push(scores[i], make_value(i));
+    }
+  }
+  inline void push_n(std::span<const float> scores, std::span<const V> values) noexcept {
+    CX_ASSERT(scores.size() == values.size(), "every score needs a value");
+    push_n(scores.data(), values.data(), scores.size());
+  }
+  /**
+   * Adds the entries of another TopK, e.g. the partial result of another thread
+   */
+  template <bool L>
+  inline void merge(const TopK<V, L>& other) noexcept {
+    static_assert(L == Largest, "only TopKs of the same order can be merged");
+    for (const Entry& e : other.entries()) {
+      push(e.score, e.value);
+    }
+  }
+  /**
+   * The score a value has to beat to be kept - -infinity (+infinity if !Largest) until k values are held
+   */
+  [[nodiscard]] inline float threshold() const noexcept {
+    if (heap_.size() < k_ || k_ == 0) {
+      return Largest ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+    }
+    return heap_[0].score;
+  }
+  /**
+   * The kept entries in heap order - the first one is the k-th best
+   */
+  [[nodiscard]] inline std::span<const Entry> entries() const noexcept { return heap_; }
+  /**
+   * Writes the kept entries best first to out
+   * @param out space for size() entries
+   * @return the number of entries written
+   */
+  inline uint_32_cx sorted(Entry* out) const {
+    std::copy(heap_.begin(), heap_.end(), out);
+    std::sort(out, out + heap_.size(), [](const Entry& a, const Entry& b) { return better(a.score, b.score); });
+    return heap_.size();
+  }
+  /**
+   * @return the kept entries best first
+   */
+  [[nodiscard]] inline std::vector<Entry> sorted() const {
+    std::vector<Entry> result(heap_.size());
+    sorted(result.data());
+    return result;
+  }
+  /**
+   * Removes all entries and sets a new k - keeps the allocation if it is large enough
+   */
+  inline void reset(uint_32_cx k) {
+    heap_.clear();
+    heap_.reserve(k);
+    k_ = k;
+  }
+  inline void clear() noexcept { heap_.clear(); }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return heap_.size(); }
+  [[nodiscard]] inline uint_32_cx k() const noexcept { return k_; }
+  [[nodiscard]] inline bool empty() const noexcept { return heap_.empty(); }
+  [[nodiscard]] inline bool full() const noexcept { return heap_.size() == k_; }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "TESTING TOP K" << std::endl;
+
+    std::cout << "   Testing push..." << std::endl;
+    TopK<int> top(3);
+    CX_ASSERT(top.empty() && top.threshold() == -std::numeric_limits<float>::infinity(), "");
+    for (int i = 0; i < 10; i++) {
+      top.push(static_cast<float>(i % 7), i);
+    }
+    auto best = top.sorted();
+    CX_ASSERT(best.size() == 3 && top.full() && top.threshold() == 4, "");
+    CX_ASSERT(best[0].score == 6 && best[0].value == 6 && best[1].value == 5 && best[2].value == 4, "");
+    CX_ASSERT(!top.push(4, 99) && top.push(4.5F, 45) && top.threshold() == 4.5F, "ties keep the first");
+    CX_ASSERT(!top.push(std::nanf(""), 1) && !TopK<int>(2).push(std::nanf(""), 1), "");
+    TopK<int> none(0);
+    CX_ASSERT(!none.push(1, 1) && none.empty(), "");
+
+    std::cout << "   Testing push_n against a full sort..." << std::endl;
+    uint64_t seed = 74;  // splitmix64
+    auto next = [&seed]() {
+      uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    };
+    std::vector<float> scores(100003);
+    std::vector<uint32_t> ids(scores.size());
+    for (uint32_t i = 0; i < scores.size(); i++) {
+      scores[i] = static_cast<float>(next() % 1000000) / 7.0F;
+      ids[i] = i;
+    }
+    std::vector<uint32_t> order = ids;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return scores[a] != scores[b] ? scores[a] > scores[b] : a < b;
+    });
+    for (uint_32_cx k : {1, 7, 100, 1000}) {
+      TopK<uint32_t> batch(k);
+      batch.push_n(scores, ids);
+      TopK<uint32_t, false> lowest(k);
+      lowest.push_n(scores.data(), scores.size(), [](uint_32_cx i) { return static_cast<uint32_t>(i); });
+      const auto b = batch.sorted();
+      const auto l = lowest.sorted();
+      for (uint_32_cx i = 0; i < k; i++) {
+        CX_ASSERT(b[i].score == scores[order[i]], "");
+        CX_ASSERT(l[i].score == scores[order[order.size() - 1 - i]], "");
+      }
+    }
+
+    std::cout << "   Testing merge of per thread results..." << std::endl;
+    constexpr int kThreads = 4;
+    std::vector<TopK<uint32_t>> partial(kThreads, TopK<uint32_t>(50));
+    std::vector<std::thread> threads;
+    const uint_32_cx chunk = scores.size() / kThreads + 1;
+    for (int t = 0; t < kThreads; t++) {
+      threads.emplace_back([&, t]() {
+        const uint_32_cx begin = std::min<uint_32_cx>(t * chunk, scores.size());
+        const uint_32_cx end = std::min<uint_32_cx>(begin + chunk, scores.size());
+        partial[t].push_n(scores.data() + begin, ids.data() + begin, end - begin);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    TopK<uint32_t> merged(50);
+    for (const auto& p : partial) {
+      merged.merge(p);
+    }
+    const auto m = merged.sorted();
+    for (uint_32_cx i = 0; i < 50; i++) {
+      CX_ASSERT(m[i].score == scores[order[i]], "");
+    }
+    merged.reset(5);
+    CX_ASSERT(merged.empty() && merged.k() == 5, "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_TOPK_H_
@@ -0,0 +1,492 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_UNROLLEDLIST_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_UNROLLEDLIST_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "../CXAllocator.h"
+#include "../cxconfig.h"
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <string>
+#endif
+
+namespace cxhelper {
+/**
+ * Node of the UnrolledList - up to N elements in place, the first count_ are alive
+ */
+template <typename T, uint_32_cx N>
+struct UnrolledNode {
+  UnrolledNode* prev_ = nullptr;
+  UnrolledNode* next_ = nullptr;
+  uint_32_cx count_ = 0;
+  alignas(T) unsigned char data_[N * sizeof(T)];
+  [[nodiscard]] inline T* items() noexcept { return std::launder(reinterpret_cast<T*>(data_)); }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>Unrolled Linked List</h2>
+ * A doubly linked list where every node holds a small array of elements (about 256 bytes) instead of a single one.
+ * <br><br>
+ * Iteration walks contiguous memory and only follows a pointer every few elements, there is one allocation per node
+ * instead of per element and the node pointers are amortized over many elements.
+ * Inserting or erasing in the middle shifts at most one node's worth of elements - a full node is split in two,
+ * neighbours that together fit into half a node are merged.
+ * <br><br>
+ * Finding an index skips whole nodes, so erase_at() and operator[] are O(n / elements per node).
+ * <br><br>
+ * <b>Important:</b> Inserting or erasing invalidates iterators and references into the node that changed.
+ */
+template <typename T, AllocPolicy Policy = PoolAlloc>
+class UnrolledList {
+ public:
+  static constexpr uint_32_cx kNodeCapacity = static_cast<uint_32_cx>(
+      std::max<size_t>(4, (256 - 2 * sizeof(void*) - sizeof(uint_32_cx)) / sizeof(T)));
+
+ private:
+  using Node = UnrolledNode<T, kNodeCapacity>;
+  using Allocator = cxhelper::policy_allocator_t<Node, Policy>;
+
+  Allocator alloc;
+  Node* head_ = nullptr;
+  Node* tail_ = nullptr;
+  uint_32_cx size_ = 0;
+  uint_32_cx nodes_ = 0;
+
+  inline Node* new_node() {
+    Node* node = alloc.allocate(1);
+    std::allocator_traits<Allocator>::construct(alloc, node);
+    nodes_++;
+    return node;
+  }
+  // links a fresh node after the given one, nullptr links it as the new head
+  inline Node* insert_node_after(Node* node) {
+    Node* fresh = new_node();
+    fresh->prev_ = node;
+    fresh->next_ = node ? node->next_ : head_;
+    (fresh->next_ ? fresh->next_->prev_ : tail_) = fresh;
+    (node ? node->next_ : head_) = fresh;
+    return fresh;
+  }
+  inline void remove_node(Node* node) {
+    (node->prev_ ? node->prev_->next_ : head_) = node->next_;
+    (node->next_ ? node->next_->prev_ : tail_) = node->prev_;
+    std::destroy_n(node->items(), node->count_);
+    std::allocator_traits<Allocator>::destroy(alloc, node);
+    alloc.deallocate(node, 1);
+    nodes_--;
+  }
+  // the node needs room for one more
+  template <typename... Args>
+  inline static void insert_in_node(Node* node, uint_32_cx pos, Args&&... args) {
+    T* items = node->items();
+    if (pos == node->count_) {
+      ::new (items + pos) T(std::forward<Args>(args)...);
+    } else {
+      T val(std::forward<Args>(args)...);
+      ::new (items + node->count_) T(std::move(items[node->count_ - 1]));
+      std::move_backward(items + pos, items + node->count_ - 1, items + node->count_);
+      items[pos] = std::move(val);
+    }
+    node->count_++;
+  }
+  inline static void erase_in_node(Node* node, uint_32_cx pos) {
+    T* items = node->items();
+    std::move(items + pos + 1, items + node->count_, items + pos);
+    std::destroy_at(items + node->count_ - 1);
+    node->count_--;
+  }
+  // moves the elements [from, count) of src to the end of dst
+  inline static void transfer(Node* src, uint_32_cx from, Node* dst) {
+    T* items = src->items();
+    std::uninitialized_move(items + from, items + src->count_, dst->items() + dst->count_);
+    std::destroy(items + from, items + src->count_);
+    dst->count_ += src->count_ - from;
+    src->count_ = from;
+  }
+  // the node and index of the element at index
+  inline std::pair<Node*, uint_32_cx> locate(uint_32_cx index) const {
+    if (index < size_ / 2) {
+      Node* node = head_;
+      while (index >= node->count_) {
+        index -= node->count_;
+        node = node->next_;
+      }
+      return {node, index};
+    }
+    Node* node = tail_;
+    uint_32_cx back = size_ - 1 - index;
+    while (back >= node->count_) {
+      back -= node->count_;
+      node = node->prev_;
+    }
+    return {node, node->count_ - 1 - back};
+  }
+
+ public:
+  template <bool Const>
+  class Iterator {
+    using Value = std::conditional_t<Const, const T, T>;
+    Node* node_;
+    uint_32_cx index_;
+    friend class UnrolledList;
+
+   public:
+    Iterator(Node* node, uint_32_cx index) : node_(node), index_(index) {}
+    inline Value& operator*() const { return node_->items()[index_]; }
+    inline Value* operator->() const { return node_->items() + index_; }
+    inline Iterator& operator++() {
+      if (++index_ == node_->count_) {
+        node_ = node_->next_;
+        index_ = 0;
+      }
+      return *this;
+    }
+    // only valid on iterators that aren't the begin or end
+    inline Iterator& operator--() {
+      if (index_ == 0) {
+        node_ = node_->prev_;
+        index_ = node_->count_;
+      }
+      index_--;
+      return *this;
+    }
+    inline bool operator==(const Iterator& o) const { return node_ == o.node_ && index_ == o.index_; }
+    inline bool operator!=(const Iterator& o) const { return !(*this == o); }
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  UnrolledList() = default;
+  UnrolledList(const UnrolledList& o) {
+    for (const T& val : o) {
+      push_back(val);
+    }
+  }
+  UnrolledList(UnrolledList&& o) noexcept : head_(o.head_), tail_(o.tail_), size_(o.size_), nodes_(o.nodes_) {
+    o.head_ = o.tail_ = nullptr;
+    o.size_ = o.nodes_ = 0;
+  }
+  UnrolledList& operator=(const UnrolledList& o) {
+    if (this != &o) {
+      clear();
+      for (const T& val : o) {
+        push_back(val);
+      }
+    }
+    return *this;
+  }
+  UnrolledList& operator=(UnrolledList&& o) noexcept {
+    if (this != &o) {
+      clear();
+      head_ = o.head_;
+      tail_ = o.tail_;
+      size_ = o.size_;
+      nodes_ = o.nodes_;
+      o.head_ = o.tail_ = nullptr;
+      o.size_ = o.nodes_ = 0;
+    }
+    return *this;
+  }
+  ~UnrolledList() { clear(); }
+
+  /**
+   * Adds a new element to the end of the list
+   * @param val - the element to be added
+   */
+  inline void push_back(const T& val) { emplace_back(val); }
+  template <typename... Args>
+  inline T& emplace_back(Args&&... args) {
+    if (!tail_ || tail_->count_ == kNodeCapacity) {
+      insert_node_after(tail_);
+    }
+    T* elem = ::new (tail_->items() + tail_->count_) T(std::forward<Args>(args)...);
+    tail_->count_++;
+    size_++;
+    return *elem;
+  }
+  /**
+   * Adds a new element to the front of the list
+   * @param val - the element to be added
+   */
+  inline void push_front(const T& val) { emplace_front(val); }
+  template <typename... Args>
+  inline T& emplace_front(Args&&... args) {
+    if (!head_ || head_->count_ == kNodeCapacity) {
+      insert_node_after(nullptr);
+    }
+    insert_in_node(head_, 0, std::forward<Args>(args)...);
+    size_++;
+    return head_->items()[0];
+  }
+  inline void pop_back() {
+    CX_ASSERT(size_ > 0, "list is empty");
+    std::destroy_at(tail_->items() + --tail_->count_);
+    size_--;
+    if (tail_->count_ == 0) {
+      remove_node(tail_);
+    }
+  }
+  inline void pop_front() {
+    CX_ASSERT(size_ > 0, "list is empty");
+    erase_in_node(head_, 0);
+    size_--;
+    if (head_->count_ == 0) {
+      remove_node(head_);
+    }
+  }
+  [[nodiscard]] inline T& front() {
+    CX_ASSERT(size_ > 0, "no such element");
+    return head_->items()[0];
+  }
+  [[nodiscard]] inline T& back() {
+    CX_ASSERT(size_ > 0, "no such element");
+    return tail_->items()[tail_->count_ - 1];
+  }
+  /**
+   * Inserts the element in front of the iterator, a full node is split in half
+   * @return iterator to the inserted element
+   */
+  inline iterator insert(iterator pos, const T& val) {
+    if (pos.node_ == nullptr) {
+      emplace_back(val);
+      return iterator(tail_, tail_->count_ - 1);
+    }
+    Node* node = pos.node_;
+    uint_32_cx index = pos.index_;
+    if (node->count_ == kNodeCapacity) {
+      constexpr uint_32_cx half = kNodeCapacity / 2;
+      transfer(node, half, insert_node_after(node));
+      if (index > half) {
+        node = node->next_;
+        index -= half;
+      }
+    }
+    insert_in_node(node, index, val);
+    size_++;
+    return iterator(node, index);
+  }
+  /**
+   * Removes the element at the iterator, merges its node with a neighbour if both fit into half a node
+   * @return iterator to the element after the removed one
+   */
+  inline iterator erase(iterator pos) {
+    Node* node = pos.node_;
+    const uint_32_cx index = pos.index_;
+    erase_in_node(node, index);
+    size_--;
+    if (node->count_ == 0) {
+      Node* next = node->next_;
+      remove_node(node);
+      return iterator(next, 0);
+    }
+    uint_32_cx next = index;
+    if (node->prev_ && node->prev_->count_ + node->count_ <= kNodeCapacity / 2) {
+      Node* prev = node->prev_;
+      next += prev->count_;
+      transfer(node, 0, prev);
+      remove_node(node);
+      node = prev;
+    }
+    if (node->next_ && node->count_ + node->next_->count_ <= kNodeCapacity / 2) {
+      transfer(node->next_, 0, node);
+      remove_node(node->next_);
+    }
+    return next < node->count_ ? iterator(node, next) : iterator(node->next_, 0);
+  }
+  /**
+   * Removes the element at index counting from the start
+   * @param index  - the index at which to erase the element
+   * @return the element removed with this operation
+   */
+  inline T erase_at(uint_32_cx index) {
+    CX_ASSERT(index < size_, "index too big");
+    auto [node, pos] = locate(index);
+    T val = std::move(node->items()[pos]);
+    erase(iterator(node, pos));
+    return val;
+  }
+  /**
+   * Removes the first element equal to the given value
+   * @return true if an element was removed
+   */
+  inline bool erase(const T& val) {
+    for (Node* node = head_; node; node = node->next_) {
+      T* items = node->items();
+      for (uint_32_cx i = 0; i < node->count_; i++) {
+        if (items[i] == val) {
+          erase(iterator(node, i));
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  [[nodiscard]] inline T& operator[](uint_32_cx index) {
+    CX_ASSERT(index < size_, "index too big");
+    auto [node, pos] = locate(index);
+    return node->items()[pos];
+  }
+  [[nodiscard]] inline const T& operator[](uint_32_cx index) const {
+    CX_ASSERT(index < size_, "index too big");
+    auto [node, pos] = locate(index);
+    return node->items()[pos];
+  }
+  inline void clear() {
+    while (head_) {
+      remove_node(head_);
+    }
+    size_ = 0;
+  }
+  [[nodiscard]] inline uint_32_cx size() const { return size_; }
+  [[nodiscard]] inline bool empty() const { return size_ == 0; }
+  /**
+   * @return the heap memory of this list - one block per node
+   */
+  [[nodiscard]] inline MemoryStats memory_stats() const noexcept {
+    MemoryStats stats;
+    stats.elements = size_;
+    stats.blocks = nodes_;
+    stats.bytes_used = size_ * sizeof(T);
+    stats.bytes_reserved = nodes_ * cxhelper::allocation_size<Allocator>(1);
+    stats.load_factor =
+        nodes_ == 0 ? 0.0F : static_cast<float>(size_) / static_cast<float>(nodes_ * kNodeCapacity);
+    return stats;
+  }
+  inline iterator begin() { return iterator(head_, 0); }
+  inline iterator end() { return iterator(nullptr, 0); }
+  inline const_iterator begin() const { return const_iterator(head_, 0); }
+  inline const_iterator end() const { return const_iterator(nullptr, 0); }
+
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "UNROLLED LIST TESTS" << std::endl;
+    std::cout << "  Testing push and pop..." << std::endl;
+    UnrolledList<int> list1;
+    for (int i = 0; i < 1000; i++) {
+      list1.push_back(i);
+    }
+    CX_ASSERT(list1.size() == 1000 && list1.front() == 0 && list1.back() == 999, "");
+    // appending fills every node
+    CX_ASSERT(list1.memory_stats().blocks == (1000 + kNodeCapacity - 1) / kNodeCapacity, "");
+    for (int i = 1; i <= 100; i++) {
+      list1.push_front(-i);
+    }
+    CX_ASSERT(list1.size() == 1100 && list1.front() == -100 && list1[100] == 0, "");
+    int expected = -100;
+    for (int val : list1) {
+      CX_ASSERT(val == expected, "");
+      expected++;
+    }
+    for (int i = 0; i < 100; i++) {
+      list1.pop_front();
+      list1.pop_back();
+    }
+    CX_ASSERT(list1.size() == 900 && list1.front() == 0 && list1.back() == 899, "");
+
+    std::cout << "  Testing index access and erase_at..." << std::endl;
+    for (uint_32_cx i = 0; i < 900; i += 37) {
+      CX_ASSERT(list1[i] == static_cast<int>(i), "");
+    }
+    const int removed = list1.erase_at(450);
+    CX_ASSERT(removed == 450 && list1.size() == 899 && list1[450] == 451, "");
+    const bool found = list1.erase(451);
+    const bool found_again = list1.erase(451);
+    CX_ASSERT(found && !found_again && list1[450] == 452, "");
+
+    std::cout << "  Testing insert and erase in the middle..." << std::endl;
+    UnrolledList<int> list2;
+    for (int i = 0; i < 10; i++) {
+      list2.push_back(i * 10);
+    }
+    auto it = list2.begin();
+    for (int i = 0; i < 5; i++) {
+      ++it;
+    }
+    for (int i = 0; i < 200; i++) {
+      it = list2.insert(it, 49 - i % 10);
+    }
+    CX_ASSERT(list2.size() == 210 && *it == 40 && list2[5] == 40, "");
+    for (auto iter = list2.begin(); iter != list2.end();) {
+      iter = *iter % 10 != 0 ? list2.erase(iter) : ++iter;
+    }
+    CX_ASSERT(list2.size() == 30, "");
+    uint_32_cx index = 0;
+    for (int val : list2) {
+      CX_ASSERT(val % 10 == 0 && list2[index++] == val, "");
+    }
+    // the emptied nodes were merged or freed
+    CX_ASSERT(list2.memory_stats().blocks <= 4, "");
+    while (!list2.empty()) {
+      list2.erase(list2.begin());
+    }
+    CX_ASSERT(list2.memory_stats().blocks == 0 && list2.begin() == list2.end(), "");
+
+    std::cout << "  Testing non trivial types..." << std::endl;
+    UnrolledList<std::string> list3;
+    for (int i = 0; i < 500; i++) {
+      list3.push_back(std::string(40, static_cast<char>('a' + i % 26)));
+    }
+    auto it3 = list3.begin();
+    for (int i = 0; i < 250; i++) {
+      ++it3;
+    }
+    for (int i = 0; i < 100; i++) {
+      it3 = list3.insert(it3, "middle");
+    }
+    for (int i = 0; i < 300; i += 3) {
+      list3.erase_at(static_cast<uint_32_cx>(i));
+    }
+    CX_ASSERT(list3.size() == 500, "");
+    UnrolledList<std::string> list4(list3);
+    UnrolledList<std::string> list5;
+    list5 = list4;
+    uint_32_cx i = 0;
+    for (const auto& val : list5) {
+      CX_ASSERT(val == list3[i++], "");
+    }
+    UnrolledList<std::string> list6(std::move(list5));
+    CX_ASSERT(list6.size() == 500 && list5.empty(), "");
+    auto last = list6.begin();
+    for (uint_32_cx j = 1; j < list6.size(); j++) {
+      ++last;
+    }
+    --last;
+    CX_ASSERT(*last == list3[498] && last->size() == list3[498].size(), "");
+
+    std::cout << "  Testing memory_stats..." << std::endl;
+    auto stats = list1.memory_stats();
+    CX_ASSERT(stats.elements == 898 && stats.load_factor > 0.5F, "");
+    CX_ASSERT(stats.bytes_reserved == stats.blocks * cxhelper::allocation_size<Allocator>(1), "");
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_UNROLLEDLIST_H_
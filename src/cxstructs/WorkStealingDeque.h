@@ -0,0 +1,231 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_WORKSTEALINGDEQUE_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_WORKSTEALINGDEQUE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "../cxconfig.h"
+
+// Chase-Lev deque with the memory orders of "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013)
+// Same circular power of two array as DeQueue, but top and bottom only grow and are masked into it
+// Arrays replaced by grow() are kept until destruction, a thief may still be reading from them
+
+namespace cxstructs {
+
+/**
+ * <h2>WorkStealingDeque</h2>
+ * Lock-free double ended queue for work stealing schedulers.
+ * <br><br>
+ * One <b>owner</b> thread pushes and pops at the back (LIFO, so it keeps working on the hottest task),
+ * any number of <b>thieves</b> steal from the front (FIFO, they take the oldest and usually largest task).
+ * Owner operations only need a CAS when the deque is down to its last element.
+ * The ring buffer grows on demand like DeQueue's.
+ * @tparam T element type - has to be trivially copyable, usually a pointer to a task
+ */
+template <typename T>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>, "elements are copied racily, use pointers");
+  struct Ring {
+    int64_t mask_;
+    std::unique_ptr<std::atomic<T>[]> slots_;
+    explicit Ring(int64_t len) : mask_(len - 1), slots_(new std::atomic<T>[len]) {}
+    inline void put(int64_t i, T val) noexcept {
+      slots_[i & mask_].store(val, std::memory_order_relaxed);
+    }
+    [[nodiscard]] inline T get(int64_t i) const noexcept {
+      return slots_[i & mask_].load(std::memory_order_relaxed);
+    }
+  };
+  alignas(64) std::atomic<int64_t> top_{0};  // next element to steal
+  alignas(64) std::atomic<int64_t> bottom_{0};  // next free slot of the owner
+  std::atomic<Ring*> ring_;
+  std::vector<std::unique_ptr<Ring>> rings_;  // owner only
+
+  Ring* grow(Ring* old, int64_t top, int64_t bottom) {
+    auto ring = std::make_unique<Ring>((old->mask_ + 1) * 2);
+    for (int64_t i = top; i < bottom; i++) {
+      ring->put(i, old->get(i));
+    }
+    Ring* raw = ring.get();
+    rings_.push_back(std::move(ring));
+    ring_.store(raw, std::memory_order_release);
+    return raw;
+  }
+
+ public:
+  /**
+   * @param capacity initial capacity - rounded up to a power of two
+   */
+  explicit WorkStealingDeque(uint_32_cx capacity = 64) {
+    int64_t len = 2;
+    while (len < static_cast<int64_t>(capacity)) {
+      len *= 2;
+    }
+    rings_.push_back(std::make_unique<Ring>(len));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+  }
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+  /**
+   * Adds an element at the back - owner only
+   * @param val the element
+   */
+  inline void push_back(T val) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    Ring* ring = ring_.load(std::memory_order_relaxed);
+    if (b - t > ring->mask_) {
+      ring = grow(ring, t, b);
+    }
+    ring->put(b, val);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  /**
+   * Removes the newest element - owner only
+   * @param out receives the element
+   * @return false if the deque was empty or a thief took the last element
+   */
+  inline bool pop_back(T& out) noexcept {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Ring* ring = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    out = ring->get(b);
+    if (t == b) {
+      // last element, race the thieves for it
+      const bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+  /**
+   * Removes the oldest element - any thread
+   * @param out receives the element
+   * @return false if the deque was empty or another thread got the element first
+   */
+  inline bool steal(T& out) noexcept {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+    // the value is only used if the CAS proves nobody took it meanwhile
+    const T val = ring_.load(std::memory_order_acquire)->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    out = val;
+    return true;
+  }
+  /**
+   * @return the approximate number of elements
+   */
+  [[nodiscard]] inline uint_32_cx size_approx() const noexcept {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? static_cast<uint_32_cx>(b - t) : 0;
+  }
+  [[nodiscard]] inline bool empty_approx() const noexcept { return size_approx() == 0; }
+  /**
+   * @return the current ring buffer capacity
+   */
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept {
+    return ring_.load(std::memory_order_relaxed)->mask_ + 1;
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "WORK STEALING DEQUE TESTS" << std::endl;
+    std::cout << "  Testing owner operations..." << std::endl;
+    WorkStealingDeque<int> d1(4);
+    CX_ASSERT(d1.capacity() == 4 && d1.empty_approx(), "");
+    for (int i = 0; i < 100; i++) {
+      d1.push_back(i);
+    }
+    CX_ASSERT(d1.size_approx() == 100 && d1.capacity() == 128, "");
+    int val;
+    CX_ASSERT(d1.pop_back(val) && val == 99, "");
+    CX_ASSERT(d1.steal(val) && val == 0, "");
+    CX_ASSERT(d1.steal(val) && val == 1, "");
+    for (int i = 98; i >= 2; i--) {
+      CX_ASSERT(d1.pop_back(val) && val == i, "");
+    }
+    CX_ASSERT(!d1.pop_back(val) && !d1.steal(val) && d1.empty_approx(), "");
+    d1.push_back(5);
+    CX_ASSERT(d1.steal(val) && val == 5 && !d1.pop_back(val), "");
+
+    std::cout << "  Testing concurrent thieves..." << std::endl;
+    constexpr int kCount = 100000;
+    WorkStealingDeque<int> d2(2);
+    std::vector<std::atomic<uint8_t>> seen(kCount);
+    std::atomic<int> taken{0};
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; t++) {
+      thieves.emplace_back([&]() {
+        int v;
+        while (taken.load() < kCount) {
+          if (d2.steal(v)) {
+            seen[v]++;
+            taken++;
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (int i = 0; i < kCount; i++) {
+      d2.push_back(i);
+      if (i % 3 == 0 && d2.pop_back(val)) {
+        seen[val]++;
+        taken++;
+      }
+    }
+    while (taken.load() < kCount) {
+      if (d2.pop_back(val)) {
+        seen[val]++;
+        taken++;
+      }
+    }
+    for (auto& thread : thieves) {
+      thread.join();
+    }
+    for (auto& count : seen) {
+      CX_ASSERT(count == 1, "");
+    }
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_WORKSTEALINGDEQUE_H_
@@ -0,0 +1,582 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_BITSET_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_BITSET_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include "../cxconfig.h"
+
+// Bit sets over 64 bit words for dense integer ids (visited / closed sets, masks)
+// The bulk operations run on whole words, with AVX2 (runtime dispatched on x86) for and/or/xor/andnot and
+// a nibble lookup popcount. Finding the next set bit skips zero words and uses countr_zero inside a word
+
+namespace cxhelper {
+enum class BitOp : uint8_t { AND, OR, XOR, ANDNOT };
+
+template <BitOp Op>
+inline void bit_words_scalar(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+  for (size_t i = 0; i < n; i++) {
+    if constexpr (Op == BitOp::AND) {
+      dst[i] &= src[i];
+    } else if constexpr (Op == BitOp::OR) {
+      dst[i] |= src[i];
+    } else if constexpr (Op == BitOp::XOR) {
+      dst[i] ^= src[i];
+    } else {
+      dst[i] &= ~src[i];
+    }
+  }
+}
+inline size_t popcount_words_scalar(const uint64_t* words, size_t n) noexcept {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    count += std::popcount(words[i]);
+  }
+  return count;
+}
+#if defined(CX_X86_DISPATCH)
+template <BitOp Op>
+CX_TARGET_AVX2 inline void bit_words_avx2(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i r;
+    if constexpr (Op == BitOp::AND) {
+      r = _mm256_and_si256(a, b);
+    } else if constexpr (Op == BitOp::OR) {
+      r = _mm256_or_si256(a, b);
+    } else if constexpr (Op == BitOp::XOR) {
+      r = _mm256_xor_si256(a, b);
+    } else {
+      r = _mm256_andnot_si256(b, a);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+  }
+  bit_words_scalar<Op>(dst + i, src + i, n - i);
+}
+// popcount of 4 words at once - nibble lookup with pshufb, byte counts summed with sad
+CX_TARGET_AVX2 inline size_t popcount_words_avx2(const uint64_t* words, size_t n) noexcept {
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2,
+                                         2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+    const __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+    const __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_words_scalar(words + i, n - i);
+}
+#endif
+/**
+ * dst[i] = dst[i] Op src[i] for n words
+ */
+template <BitOp Op>
+inline void bit_words(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+#if defined(CX_AVX2)
+  bit_words_avx2<Op>(dst, src, n);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = select_isa(bit_words_scalar<Op>, bit_words_avx2<Op>);
+  kernel(dst, src, n);
+#else
+  bit_words_scalar<Op>(dst, src, n);
+#endif
+}
+/**
+ * @return the number of set bits in n words
+ */
+inline size_t popcount_words(const uint64_t* words, size_t n) noexcept {
+#if defined(CX_AVX2)
+  return popcount_words_avx2(words, n);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = select_isa(popcount_words_scalar, popcount_words_avx2);
+  return kernel(words, n);
+#else
+  return popcount_words_scalar(words, n);
+#endif
+}
+
+/**
+ * Operations shared by bitset and fixed_bitset - Derived provides words(), word_count() and size().
+ * Bits past size() in the last word are always zero.
+ */
+template <typename Derived>
+class bitset_base {
+  [[nodiscard]] inline uint64_t* w() noexcept { return static_cast<Derived*>(this)->words(); }
+  [[nodiscard]] inline const uint64_t* w() const noexcept {
+    return static_cast<const Derived*>(this)->words();
+  }
+  [[nodiscard]] inline size_t n_words() const noexcept {
+    return static_cast<const Derived*>(this)->word_count();
+  }
+  [[nodiscard]] inline size_t n_bits() const noexcept { return static_cast<const Derived*>(this)->size(); }
+
+ protected:
+  // clears the unused bits of the last word
+  inline void trim() noexcept {
+    if (n_bits() % 64 != 0) {
+      w()[n_words() - 1] &= (uint64_t(1) << (n_bits() % 64)) - 1;
+    }
+  }
+  template <BitOp Op, typename Other>
+  inline Derived& apply(const Other& other) noexcept {
+    CX_ASSERT(other.size() == n_bits(), "bitsets have different sizes");
+    bit_words<Op>(w(), other.words(), n_words());
+    return *static_cast<Derived*>(this);
+  }
+
+ public:
+  static constexpr size_t npos = SIZE_MAX;
+
+  [[nodiscard]] inline bool test(size_t i) const noexcept {
+    CX_ASSERT(i < n_bits(), "index out of bounds");
+    return (w()[i / 64] >> (i % 64)) & 1;
+  }
+  [[nodiscard]] inline bool operator[](size_t i) const noexcept { return test(i); }
+  inline void set(size_t i) noexcept {
+    CX_ASSERT(i < n_bits(), "index out of bounds");
+    w()[i / 64] |= uint64_t(1) << (i % 64);
+  }
+  inline void set(size_t i, bool value) noexcept {
+    CX_ASSERT(i < n_bits(), "index out of bounds");
+    const uint64_t bit = uint64_t(1) << (i % 64);
+    w()[i / 64] = (w()[i / 64] & ~bit) | (value ? bit : 0);
+  }
+  inline void reset(size_t i) noexcept {
+    CX_ASSERT(i < n_bits(), "index out of bounds");
+    w()[i / 64] &= ~(uint64_t(1) << (i % 64));
+  }
+  inline void flip(size_t i) noexcept {
+    CX_ASSERT(i < n_bits(), "index out of bounds");
+    w()[i / 64] ^= uint64_t(1) << (i % 64);
+  }
+  /**
+   * Sets the bit - the usual visited check in one step
+   * @return true if the bit was not set before
+   */
+  inline bool test_and_set(size_t i) noexcept {
+    CX_ASSERT(i < n_bits(), "index out of bounds");
+    const uint64_t bit = uint64_t(1) << (i % 64);
+    const bool was_unset = (w()[i / 64] & bit) == 0;
+    w()[i / 64] |= bit;
+    return was_unset;
+  }
+  /**
+   * Sets all bits to 0
+   */
+  inline void clear() noexcept { std::fill(w(), w() + n_words(), 0); }
+  /**
+   * Sets all bits to 1
+   */
+  inline void set_all() noexcept {
+    std::fill(w(), w() + n_words(), ~uint64_t(0));
+    trim();
+  }
+  /**
+   * @return the number of set bits
+   */
+  [[nodiscard]] inline size_t count() const noexcept { return popcount_words(w(), n_words()); }
+  [[nodiscard]] inline bool any() const noexcept {
+    return std::any_of(w(), w() + n_words(), [](uint64_t word) { return word != 0; });
+  }
+  [[nodiscard]] inline bool none() const noexcept { return !any(); }
+  [[nodiscard]] inline bool all() const noexcept { return count() == n_bits(); }
+  /**
+   * @return the index of the first set bit at or after i, npos if there is none
+   */
+  [[nodiscard]] inline size_t find_next(size_t i) const noexcept {
+    if (i >= n_bits()) {
+      return npos;
+    }
+    size_t word = i / 64;
+    uint64_t bits = w()[word] & (~uint64_t(0) << (i % 64));
+    while (bits == 0) {
+      if (++word == n_words()) {
+        return npos;
+      }
+      bits = w()[word];
+    }
+    return word * 64 + std::countr_zero(bits);
+  }
+  /**
+   * @return the index of the first set bit, npos if there is none
+   */
+  [[nodiscard]] inline size_t find_first() const noexcept { return find_next(0); }
+  /**
+   * Calls func(index) for every set bit in ascending order
+   */
+  template <typename Function>
+  inline void for_each_set(Function func) const {
+    const uint64_t* words = w();
+    for (size_t word = 0; word < n_words(); word++) {
+      for (uint64_t bits = words[word]; bits != 0; bits &= bits - 1) {
+        func(word * 64 + std::countr_zero(bits));
+      }
+    }
+  }
+  template <typename Other>
+  inline Derived& operator&=(const Other& other) noexcept {
+    return apply<BitOp::AND>(other);
+  }
+  template <typename Other>
+  inline Derived& operator|=(const Other& other) noexcept {
+    return apply<BitOp::OR>(other);
+  }
+  template <typename Other>
+  inline Derived& operator^=(const Other& other) noexcept {
+    return apply<BitOp::XOR>(other);
+  }
+  /**
+   * Clears every bit that is set in other - this &= ~other
+   */
+  template <typename Other>
+  inline Derived& and_not(const Other& other) noexcept {
+    return apply<BitOp::ANDNOT>(other);
+  }
+  template <typename Other>
+  [[nodiscard]] inline bool operator==(const Other& other) const noexcept {
+    return n_bits() == other.size() && std::equal(w(), w() + n_words(), other.words());
+  }
+};
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>bitset</h2>
+ * Dynamically sized bit set, one bit per id in a flat array of 64 bit words.
+ * <br><br>
+ * A visited set for n vertices takes n / 8 bytes - 8 times less than a byte per entry and without the
+ * proxy objects of <code>std::vector<bool></code>. Bulk operations (&=, |=, ^=, and_not, count) work on
+ * whole words with AVX2, find_next() and for_each_set() skip 64 clear bits at a time.
+ * <br><br>
+ * The atomic_* methods can be used from several threads at once on the same bitset, e.g. to claim vertices
+ * in a parallel search. Plain methods must not run concurrently with writers.
+ * <pre>
+ * bitset visited(n);
+ * if (visited.test_and_set(v)) { ... first visit ... }
+ * </pre>
+ */
+class bitset : public cxhelper::bitset_base<bitset> {
+  std::vector<uint64_t> words_;
+  size_t size_ = 0;
+  friend class cxhelper::bitset_base<bitset>;
+
+ public:
+  bitset() = default;
+  /**
+   * @param bits number of bits
+   * @param value initial value of all bits
+   */
+  explicit bitset(size_t bits, bool value = false) { resize(bits, value); }
+  /**
+   * Changes the number of bits, new bits get the given value
+   */
+  inline void resize(size_t bits, bool value = false) {
+    const size_t old = size_;
+    words_.resize((bits + 63) / 64, value ? ~uint64_t(0) : 0);
+    size_ = bits;
+    if (value && old < bits && old % 64 != 0) {
+      words_[old / 64] |= ~uint64_t(0) << (old % 64);
+    }
+    trim();
+  }
+  /**
+   * Resizes to bits and clears all of them, keeps the allocation if possible
+   */
+  inline void assign(size_t bits, bool value = false) {
+    size_ = bits;
+    words_.assign((bits + 63) / 64, value ? ~uint64_t(0) : 0);
+    trim();
+  }
+  [[nodiscard]] inline size_t size() const noexcept { return size_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+  [[nodiscard]] inline size_t word_count() const noexcept { return words_.size(); }
+  [[nodiscard]] inline uint64_t* words() noexcept { return words_.data(); }
+  [[nodiscard]] inline const uint64_t* words() const noexcept { return words_.data(); }
+  /**
+   * Thread safe test - relaxed, pairs with the other atomic_* methods
+   */
+  [[nodiscard]] inline bool atomic_test(size_t i) const noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    return (std::atomic_ref<const uint64_t>(words_[i / 64]).load(std::memory_order_relaxed) >> (i % 64)) & 1;
+  }
+  /**
+   * Thread safe set
+   */
+  inline void atomic_set(size_t i) noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    std::atomic_ref<uint64_t>(words_[i / 64]).fetch_or(uint64_t(1) << (i % 64), std::memory_order_relaxed);
+  }
+  /**
+   * Thread safe test_and_set - exactly one of several threads setting the same bit gets true
+   * @return true if this call set the bit
+   */
+  inline bool atomic_test_and_set(size_t i) noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    const uint64_t bit = uint64_t(1) << (i % 64);
+    return (std::atomic_ref<uint64_t>(words_[i / 64]).fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+  }
+};
+
+/**
+ * <h2>fixed_bitset</h2>
+ * bitset with a compile time size, stored inline without allocation - same operations as bitset
+ * @tparam N number of bits
+ */
+template <size_t N>
+class fixed_bitset : public cxhelper::bitset_base<fixed_bitset<N>> {
+  std::array<uint64_t, (N + 63) / 64> words_{};
+
+ public:
+  constexpr fixed_bitset() noexcept = default;
+  [[nodiscard]] static constexpr size_t size() noexcept { return N; }
+  [[nodiscard]] static constexpr size_t word_count() noexcept { return (N + 63) / 64; }
+  [[nodiscard]] inline uint64_t* words() noexcept { return words_.data(); }
+  [[nodiscard]] inline const uint64_t* words() const noexcept { return words_.data(); }
+};
+
+/**
+ * <h2>stamped_bitset</h2>
+ * Bit set with an O(1) clear() for searches that reuse one set per query and only touch a few ids.
+ * <br><br>
+ * Every word carries the generation it was last written in, a word from an older generation reads as zero.
+ * clear() only increments the generation, so a query on a huge grid or graph pays for the words it touches
+ * and not for the whole set. Costs 12 instead of 8 bytes per 64 ids.
+ */
+class stamped_bitset {
+  std::vector<uint64_t> words_;
+  std::vector<uint32_t> stamps_;
+  size_t size_ = 0;
+  uint32_t generation_ = 1;
+
+  [[nodiscard]] inline uint64_t& word(size_t i) noexcept {
+    const size_t index = i / 64;
+    if (stamps_[index] != generation_) {
+      stamps_[index] = generation_;
+      words_[index] = 0;
+    }
+    return words_[index];
+  }
+
+ public:
+  stamped_bitset() = default;
+  explicit stamped_bitset(size_t bits) { resize(bits); }
+  /**
+   * Changes the number of bits and clears all of them
+   */
+  inline void resize(size_t bits) {
+    size_ = bits;
+    words_.assign((bits + 63) / 64, 0);
+    stamps_.assign(words_.size(), 0);
+    generation_ = 1;
+  }
+  [[nodiscard]] inline size_t size() const noexcept { return size_; }
+  [[nodiscard]] inline bool test(size_t i) const noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    return stamps_[i / 64] == generation_ && ((words_[i / 64] >> (i % 64)) & 1);
+  }
+  [[nodiscard]] inline bool operator[](size_t i) const noexcept { return test(i); }
+  inline void set(size_t i) noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    word(i) |= uint64_t(1) << (i % 64);
+  }
+  inline void reset(size_t i) noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    word(i) &= ~(uint64_t(1) << (i % 64));
+  }
+  /**
+   * @return true if the bit was not set before
+   */
+  inline bool test_and_set(size_t i) noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    uint64_t& w = word(i);
+    const uint64_t bit = uint64_t(1) << (i % 64);
+    const bool was_unset = (w & bit) == 0;
+    w |= bit;
+    return was_unset;
+  }
+  /**
+   * Clears all bits in O(1) - every 2^32 calls the stamps are reset once
+   */
+  inline void clear() noexcept {
+    if (++generation_ == 0) {
+      std::fill(stamps_.begin(), stamps_.end(), 0);
+      generation_ = 1;
+    }
+  }
+  /**
+   * @return the number of set bits - walks all words
+   */
+  [[nodiscard]] inline size_t count() const noexcept {
+    size_t count = 0;
+    for (size_t i = 0; i < words_.size(); i++) {
+      count += stamps_[i] == generation_ ? std::popcount(words_[i]) : 0;
+    }
+    return count;
+  }
+};
+}  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <random>
+#include <thread>
+namespace cxtests {  // namespace cxtests
+static void TEST_BITSET() {
+  using cxstructs::bitset;
+  std::cout << "BITSET TESTS" << std::endl;
+  std::cout << "  Testing single bits..." << std::endl;
+  bitset b(130);
+  CX_ASSERT(b.size() == 130 && b.word_count() == 3 && b.none() && b.count() == 0, "");
+  b.set(0);
+  b.set(64);
+  b.set(129);
+  CX_ASSERT(b.test(0) && b[64] && b.test(129) && !b.test(1) && b.count() == 3, "");
+  CX_ASSERT(b.test_and_set(5) && !b.test_and_set(5), "");
+  b.reset(5);
+  b.flip(63);
+  b.set(100, true);
+  b.set(100, false);
+  CX_ASSERT(!b.test(5) && b.test(63) && !b.test(100) && b.count() == 4, "");
+
+  std::cout << "  Testing find_next..." << std::endl;
+  CX_ASSERT(b.find_first() == 0 && b.find_next(1) == 63 && b.find_next(64) == 64, "");
+  CX_ASSERT(b.find_next(65) == 129 && b.find_next(130) == bitset::npos, "");
+  std::vector<size_t> seen;
+  b.for_each_set([&seen](size_t i) { seen.push_back(i); });
+  CX_ASSERT((seen == std::vector<size_t>{0, 63, 64, 129}), "");
+
+  std::cout << "  Testing resize and set_all..." << std::endl;
+  b.set_all();
+  CX_ASSERT(b.count() == 130 && b.all(), "");
+  b.resize(200, false);
+  CX_ASSERT(b.count() == 130 && !b.test(130), "");
+  b.resize(250, true);
+  CX_ASSERT(b.count() == 180 && b.test(200) && !b.test(199), "");
+  b.resize(10);
+  CX_ASSERT(b.count() == 10 && b.find_next(10) == bitset::npos, "");
+  b.assign(70);
+  CX_ASSERT(b.size() == 70 && b.none(), "");
+
+  std::cout << "  Testing bulk operations..." << std::endl;
+  std::mt19937_64 rng(3);
+  for (const size_t n : {1UL, 63UL, 64UL, 65UL, 255UL, 256UL, 1000UL, 4099UL}) {
+    bitset x(n), y(n);
+    std::vector<uint8_t> rx(n), ry(n);
+    for (size_t i = 0; i < n; i++) {
+      rx[i] = rng() & 1;
+      ry[i] = rng() % 3 == 0;
+      x.set(i, rx[i]);
+      y.set(i, ry[i]);
+    }
+    auto check = [&](const bitset& r, auto op) {
+      bool same = true;
+      size_t count = 0;
+      for (size_t i = 0; i < n; i++) {
+        const bool expected = op(rx[i] != 0, ry[i] != 0);
+        same &= r.test(i) == expected;
+        count += expected;
+      }
+      return same && r.count() == count;
+    };
+    bitset r = x;
+    CX_ASSERT(check(r &= y, [](bool a, bool c) { return a && c; }), "");
+    r = x;
+    CX_ASSERT(check(r |= y, [](bool a, bool c) { return a || c; }), "");
+    r = x;
+    CX_ASSERT(check(r ^= y, [](bool a, bool c) { return a != c; }), "");
+    r = x;
+    CX_ASSERT(check(r.and_not(y), [](bool a, bool c) { return a && !c; }), "");
+    CX_ASSERT(r == r && !(x == y || x == bitset(n + 1)), "");
+    size_t prev = 0, visited = 0;
+    for (size_t i = x.find_first(); i != bitset::npos; i = x.find_next(i + 1)) {
+      CX_ASSERT(rx[i] && (visited == 0 || i > prev), "");
+      prev = i;
+      visited++;
+    }
+    CX_ASSERT(visited == x.count(), "");
+    // every dispatch level gives the same result
+    CX_ASSERT(cxhelper::popcount_words_scalar(x.words(), x.word_count()) == x.count(), "");
+  }
+
+  std::cout << "  Testing atomic methods..." << std::endl;
+  bitset shared(10000);
+  std::atomic<int> claimed{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&shared, &claimed] {
+      for (size_t i = 0; i < 10000; i++) {
+        if (!shared.atomic_test(i) && shared.atomic_test_and_set(i)) {
+          claimed++;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  CX_ASSERT(claimed == 10000 && shared.all(), "");
+  shared.atomic_set(3);
+  CX_ASSERT(shared.atomic_test(3), "");
+
+  std::cout << "  Testing fixed_bitset..." << std::endl;
+  cxstructs::fixed_bitset<100> f;
+  static_assert(sizeof(f) == 16, "");
+  CX_ASSERT(f.none() && f.size() == 100, "");
+  f.set(99);
+  f.set(3);
+  cxstructs::fixed_bitset<100> g;
+  g.set_all();
+  CX_ASSERT(g.count() == 100, "");
+  g.and_not(f);
+  CX_ASSERT(g.count() == 98 && !g.test(99) && g.find_next(3) == 4, "");
+  g |= f;
+  CX_ASSERT(g.all(), "");
+
+  std::cout << "  Testing stamped_bitset..." << std::endl;
+  cxstructs::stamped_bitset s(1000);
+  CX_ASSERT(s.test_and_set(10) && !s.test_and_set(10) && s.test(10), "");
+  s.set(999);
+  s.set(11);
+  s.reset(11);
+  CX_ASSERT(s.count() == 2 && !s.test(11), "");
+  s.clear();
+  CX_ASSERT(!s.test(10) && !s[999] && s.count() == 0, "");
+  s.set(12);
+  CX_ASSERT(s.test(12) && !s.test(10) && s.count() == 1, "");
+  for (int i = 0; i < 1000; i++) {
+    s.clear();
+  }
+  CX_ASSERT(s.count() == 0 && s.test_and_set(12), "");
+}
+}  // namespace cxtests
+#endif
+#endif  // CXSTRUCTS_SRC_CXSTRUCTS_BITSET_H_
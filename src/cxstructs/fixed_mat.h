@@ -0,0 +1,423 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_FIXED_MAT_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_FIXED_MAT_H_
+
+#include <cmath>
+#include <initializer_list>
+#include <type_traits>
+#include "../cxconfig.h"
+#include "row.h"
+
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include "Geometry.h"
+#endif
+
+namespace cxstructs {
+
+/**
+ * <h2>fixed_mat</h2>
+ * is a compile-time sized matrix of R rows, stored as R row<C, T> on the stack.<p>
+ * Unlike mat it never allocates and all operations are constexpr and unrolled at compile time, so small
+ * transforms (2x2 to 4x4), mat-vec products and inverses compile down to straight-line code.
+ * Float matrices with 4 or 8 columns use the SIMD dot product of row.<p>
+ * For 2D geometry the 3x3 matrices are affine transforms: see translation(), rotation(), scaling() and
+ * transform_point() - they compose with operator* like mat.
+ *
+ * @tparam R number of rows
+ * @tparam C number of columns
+ * @tparam T element type - defaults to float
+ */
+template <uint_32_cx R, uint_32_cx C, typename T = float>
+class fixed_mat {
+  row<C, T> rows_[R]{};
+
+  template <typename F>
+  static constexpr void unroll(F&& f) noexcept {
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (f(static_cast<uint_32_cx>(I)), ...);
+    }(std::make_index_sequence<R>{});
+  }
+
+ public:
+  /**
+   * Zero initialized matrix
+   */
+  constexpr fixed_mat() = default;
+  constexpr explicit fixed_mat(const T val) {
+    for (auto& r : rows_) {
+      r = row<C, T>(val);
+    }
+  }
+  /**
+   * @param form called with (row, column) for every element
+   */
+  template <typename fill_form,
+            typename = std::enable_if_t<std::is_invocable_r_v<T, fill_form, uint_32_cx, uint_32_cx>>>
+  constexpr explicit fixed_mat(fill_form form) {
+    for (uint_32_cx i = 0; i < R; i++) {
+      for (uint_32_cx j = 0; j < C; j++) {
+        rows_[i][j] = form(i, j);
+      }
+    }
+  }
+  /**
+   * @param init_list R * C values in row-major order
+   */
+  constexpr fixed_mat(std::initializer_list<T> init_list) {
+    CX_ASSERT(init_list.size() == R * C, "");
+    auto it = init_list.begin();
+    for (uint_32_cx i = 0; i < R; i++) {
+      for (uint_32_cx j = 0; j < C; j++) {
+        rows_[i][j] = *it++;
+      }
+    }
+  }
+  [[nodiscard]] static constexpr fixed_mat identity() noexcept
+    requires(R == C)
+  {
+    fixed_mat result;
+    for (uint_32_cx i = 0; i < R; i++) {
+      result.rows_[i][i] = T(1);
+    }
+    return result;
+  }
+  [[nodiscard]] constexpr T& operator()(uint_32_cx i, uint_32_cx j) noexcept { return rows_[i][j]; }
+  [[nodiscard]] constexpr const T& operator()(uint_32_cx i, uint_32_cx j) const noexcept {
+    return rows_[i][j];
+  }
+  [[nodiscard]] constexpr row<C, T>& operator[](uint_32_cx i) noexcept { return rows_[i]; }
+  [[nodiscard]] constexpr const row<C, T>& operator[](uint_32_cx i) const noexcept {
+    return rows_[i];
+  }
+  [[nodiscard]] constexpr uint_32_cx n_rows() const noexcept { return R; }
+  [[nodiscard]] constexpr uint_32_cx n_cols() const noexcept { return C; }
+
+  [[nodiscard]] constexpr fixed_mat operator+(const fixed_mat& o) const noexcept {
+    fixed_mat result;
+    unroll([&](uint_32_cx i) { result.rows_[i] = rows_[i] + o.rows_[i]; });
+    return result;
+  }
+  [[nodiscard]] constexpr fixed_mat operator-(const fixed_mat& o) const noexcept {
+    fixed_mat result;
+    unroll([&](uint_32_cx i) { result.rows_[i] = rows_[i] - o.rows_[i]; });
+    return result;
+  }
+  [[nodiscard]] constexpr fixed_mat operator*(T scalar) const noexcept {
+    fixed_mat result;
+    unroll([&](uint_32_cx i) { result.rows_[i] = rows_[i] * scalar; });
+    return result;
+  }
+  [[nodiscard]] constexpr bool operator==(const fixed_mat& o) const noexcept {
+    for (uint_32_cx i = 0; i < R; i++) {
+      if (!(rows_[i] == o.rows_[i])) return false;
+    }
+    return true;
+  }
+  /**
+   * @return the mat-vec product - one row dot product per row
+   */
+  [[nodiscard]] constexpr row<R, T> operator*(const row<C, T>& v) const noexcept {
+    row<R, T> result;
+    unroll([&](uint_32_cx i) { result[i] = rows_[i].dot(v); });
+    return result;
+  }
+  /**
+   * @return the matrix product - accumulates scaled rows of o so the inner loop stays row-wise
+   */
+  template <uint_32_cx K>
+  [[nodiscard]] constexpr fixed_mat<R, K, T> operator*(const fixed_mat<C, K, T>& o) const noexcept {
+    fixed_mat<R, K, T> result;
+    for (uint_32_cx i = 0; i < R; i++) {
+      row<K, T> acc(T(0));
+      for (uint_32_cx j = 0; j < C; j++) {
+        acc += o[j] * rows_[i][j];
+      }
+      result[i] = acc;
+    }
+    return result;
+  }
+  [[nodiscard]] constexpr fixed_mat<C, R, T> transpose() const noexcept {
+    fixed_mat<C, R, T> result;
+    for (uint_32_cx i = 0; i < R; i++) {
+      for (uint_32_cx j = 0; j < C; j++) {
+        result(j, i) = rows_[i][j];
+      }
+    }
+    return result;
+  }
+  /**
+   * Closed form determinant for 2x2, 3x3 and 4x4
+   */
+  [[nodiscard]] constexpr T determinant() const noexcept
+    requires(R == C && R >= 2 && R <= 4)
+  {
+    const auto& m = *this;
+    if constexpr (R == 2) {
+      return m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+    } else if constexpr (R == 3) {
+      return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1)) -
+             m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0)) +
+             m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+    } else {
+      const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+      const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+      const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+      const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+      const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+      const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+      const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+      const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+      const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+      const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+      const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+      const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+      return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+  }
+  /**
+   * Closed form inverse (adjugate / determinant) for 2x2, 3x3 and 4x4
+   * @param out the inverse - untouched if the matrix is singular
+   * @return false if the determinant is 0
+   */
+  [[nodiscard]] constexpr bool inverse(fixed_mat& out) const noexcept
+    requires(R == C && R >= 2 && R <= 4)
+  {
+    const auto& m = *this;
+    if constexpr (R == 2) {
+      const T det = determinant();
+      if (det == T(0)) return false;
+      const T inv = T(1) / det;
+      out = {m(1, 1) * inv, -m(0, 1) * inv, -m(1, 0) * inv, m(0, 0) * inv};
+    } else if constexpr (R == 3) {
+      const T c00 = m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1);
+      const T c01 = m(1, 2) * m(2, 0) - m(1, 0) * m(2, 2);
+      const T c02 = m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0);
+      const T det = m(0, 0) * c00 + m(0, 1) * c01 + m(0, 2) * c02;
+      if (det == T(0)) return false;
+      const T inv = T(1) / det;
+      out = {c00 * inv,
+             (m(0, 2) * m(2, 1) - m(0, 1) * m(2, 2)) * inv,
+             (m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1)) * inv,
+             c01 * inv,
+             (m(0, 0) * m(2, 2) - m(0, 2) * m(2, 0)) * inv,
+             (m(0, 2) * m(1, 0) - m(0, 0) * m(1, 2)) * inv,
+             c02 * inv,
+             (m(0, 1) * m(2, 0) - m(0, 0) * m(2, 1)) * inv,
+             (m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0)) * inv};
+    } else {
+      // 2x2 sub determinants of the upper (s) and lower (c) two rows
+      const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+      const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+      const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+      const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+      const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+      const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+      const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+      const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+      const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+      const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+      const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+      const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+      const T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+      if (det == T(0)) return false;
+      const T inv = T(1) / det;
+      out = {(m(1, 1) * c5 - m(1, 2) * c4 + m(1, 3) * c3) * inv,
+             (-m(0, 1) * c5 + m(0, 2) * c4 - m(0, 3) * c3) * inv,
+             (m(3, 1) * s5 - m(3, 2) * s4 + m(3, 3) * s3) * inv,
+             (-m(2, 1) * s5 + m(2, 2) * s4 - m(2, 3) * s3) * inv,
+             (-m(1, 0) * c5 + m(1, 2) * c2 - m(1, 3) * c1) * inv,
+             (m(0, 0) * c5 - m(0, 2) * c2 + m(0, 3) * c1) * inv,
+             (-m(3, 0) * s5 + m(3, 2) * s2 - m(3, 3) * s1) * inv,
+             (m(2, 0) * s5 - m(2, 2) * s2 + m(2, 3) * s1) * inv,
+             (m(1, 0) * c4 - m(1, 1) * c2 + m(1, 3) * c0) * inv,
+             (-m(0, 0) * c4 + m(0, 1) * c2 - m(0, 3) * c0) * inv,
+             (m(3, 0) * s4 - m(3, 1) * s2 + m(3, 3) * s0) * inv,
+             (-m(2, 0) * s4 + m(2, 1) * s2 - m(2, 3) * s0) * inv,
+             (-m(1, 0) * c3 + m(1, 1) * c1 - m(1, 2) * c0) * inv,
+             (m(0, 0) * c3 - m(0, 1) * c1 + m(0, 2) * c0) * inv,
+             (-m(3, 0) * s3 + m(3, 1) * s1 - m(3, 2) * s0) * inv,
+             (m(2, 0) * s3 - m(2, 1) * s1 + m(2, 2) * s0) * inv};
+    }
+    return true;
+  }
+  /**
+   * @return affine 2D translation
+   */
+  [[nodiscard]] static constexpr fixed_mat translation(T x, T y) noexcept
+    requires(R == 3 && C == 3)
+  {
+    return {1, 0, x, 0, 1, y, 0, 0, 1};
+  }
+  /**
+   * @return affine 2D scaling around the origin
+   */
+  [[nodiscard]] static constexpr fixed_mat scaling(T x, T y) noexcept
+    requires(R == 3 && C == 3)
+  {
+    return {x, 0, 0, 0, y, 0, 0, 0, 1};
+  }
+  /**
+   * @param radians counter-clockwise around the origin
+   * @return affine 2D rotation
+   */
+  [[nodiscard]] static inline fixed_mat rotation(T radians) noexcept
+    requires(R == 3 && C == 3)
+  {
+    const T c = std::cos(radians);
+    const T s = std::sin(radians);
+    return {c, -s, 0, s, c, 0, 0, 0, 1};
+  }
+  /**
+   * Applies the affine transform to a point - (x, y) for 3x3, (x, y, z) for 4x4
+   * @return the transformed point without the homogeneous coordinate
+   */
+  [[nodiscard]] constexpr row<C - 1, T> transform_point(const row<C - 1, T>& p) const noexcept
+    requires(R == C && R >= 3)
+  {
+    row<C - 1, T> result;
+    for (uint_32_cx i = 0; i < C - 1; i++) {
+      T sum = rows_[i][C - 1];
+      for (uint_32_cx j = 0; j < C - 1; j++) {
+        sum += rows_[i][j] * p[j];
+      }
+      result[i] = sum;
+    }
+    return result;
+  }
+  /**
+   * Applies a 3x3 affine transform to any point type with x() and y() (e.g. Point)
+   */
+  template <class PointType>
+  [[nodiscard]] constexpr PointType transform_point(const PointType& p) const noexcept
+    requires(R == 3 && C == 3 && requires { p.x(); })
+  {
+    const row<2, T> result = transform_point(row<2, T>{p.x(), p.y()});
+    return PointType(result[0], result[1]);
+  }
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "TESTING FIXED MAT" << std::endl;
+
+    std::cout << "  Testing row..." << std::endl;
+    constexpr row<3> a{1, 2, 3};
+    constexpr row<3> b{4, 5, 6};
+    static_assert(a.dot(b) == 32);
+    static_assert((a + b)[2] == 9 && (b - a)[0] == 3 && (a * 2)[1] == 4);
+    static_assert(a.cross(b) == row<3>{-3, 6, -3});
+    static_assert(a.manhattan_distance(b) == 9 && a.chebyshev_distance(b) == 3);
+    static_assert(row<4>{1, 2, 3, 4}.squared_distance(row<4>(0.0F)) == 30);
+    row<8> r8([](uint_32_cx i) { return static_cast<float>(i); });
+    row<8> o8(1.0F);
+    CX_ASSERT(r8.dot(o8) == 28, "");
+    CX_ASSERT(r8.squared_distance(o8) == 92, "");
+    CX_ASSERT(r8.manhattan_distance(o8) == 22 && r8.chebyshev_distance(o8) == 6, "");
+    row<4> r4{3, 0, 4, 0};
+    CX_ASSERT(r4.norm() == 5 && std::abs(r4.normalized().norm() - 1) < 1e-6F, "");
+    CX_ASSERT(r4.dot(row<4>{1, 2, 3, 4}) == 15, "");
+    CX_ASSERT(r4.squared_distance(row<4>{1, 2, 3, 4}) == 4 + 4 + 1 + 16, "");
+    // runtime simd and compile time paths agree on all sizes
+    uint64_t state = 3;
+    auto next = [&state]() {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return static_cast<float>(state >> 40) / static_cast<float>(1 << 24);
+    };
+    for (int i = 0; i < 100; i++) {
+      row<8> x([&](uint_32_cx) { return next(); });
+      row<8> y([&](uint_32_cx) { return next(); });
+      float dot = 0, dist = 0;
+      for (uint_32_cx j = 0; j < 8; j++) {
+        dot += x[j] * y[j];
+        dist += (x[j] - y[j]) * (x[j] - y[j]);
+      }
+      CX_ASSERT(std::abs(x.dot(y) - dot) < 1e-5F, "");
+      CX_ASSERT(std::abs(x.squared_distance(y) - dist) < 1e-5F, "");
+      const auto x4 = row<4>::load(x.data());
+      const auto y4 = row<4>::load(y.data());
+      CX_ASSERT(std::abs(x4.dot(y4) - (x[0] * y[0] + x[1] * y[1] + x[2] * y[2] + x[3] * y[3])) < 1e-5F,
+                "");
+    }
+
+    std::cout << "  Testing products..." << std::endl;
+    constexpr fixed_mat<2, 3> m{1, 2, 3, 4, 5, 6};
+    static_assert(m(1, 2) == 6 && m.transpose()(2, 1) == 6);
+    static_assert(m * row<3>{1, 1, 1} == row<2>{6, 15});
+    static_assert(m * m.transpose() == fixed_mat<2, 2>{14, 32, 32, 77});
+    static_assert(fixed_mat<3, 3>::identity() * a == a);
+    static_assert(m + m == m * 2 && (m - m) == fixed_mat<2, 3>());
+    fixed_mat<4, 4> f4([](uint_32_cx i, uint_32_cx j) { return static_cast<float>(i * 4 + j); });
+    const row<4> v4 = f4 * row<4>{1, 0, 0, 1};
+    CX_ASSERT(v4 == (row<4>{3, 11, 19, 27}), "");
+
+    std::cout << "  Testing inverse..." << std::endl;
+    static_assert(fixed_mat<2, 2>{1, 2, 3, 4}.determinant() == -2);
+    static_assert(fixed_mat<3, 3>{2, 0, 1, 1, 3, 2, 1, 1, 2}.determinant() == 6);
+    static_assert(fixed_mat<4, 4, double>::identity().determinant() == 1);
+    constexpr auto inv2 = [] {
+      fixed_mat<2, 2, double> out;
+      (void)fixed_mat<2, 2, double>{2, 1, 1, 1}.inverse(out);
+      return out;
+    }();
+    static_assert(inv2 == fixed_mat<2, 2, double>{1, -1, -1, 2});
+    static_assert(inv2 * fixed_mat<2, 2, double>{2, 1, 1, 1} == fixed_mat<2, 2, double>::identity());
+    auto check_inverse = [](const auto& mat) {
+      auto inv = mat;
+      const bool ok = mat.inverse(inv);
+      CX_ASSERT(ok, "");
+      const auto product = mat * inv;
+      for (uint_32_cx i = 0; i < mat.n_rows(); i++) {
+        for (uint_32_cx j = 0; j < mat.n_cols(); j++) {
+          CX_ASSERT(std::abs(product(i, j) - (i == j ? 1.0 : 0.0)) < 1e-9, "");
+        }
+      }
+    };
+    check_inverse(fixed_mat<3, 3, double>{2, 0, 1, 1, 3, 2, 1, 1, 2});
+    check_inverse(fixed_mat<4, 4, double>{4, 7, 2, 1, 3, 6, 1, 0, 2, 5, 3, 2, 1, 1, 0, 9});
+    check_inverse(fixed_mat<4, 4, double>([](uint_32_cx i, uint_32_cx j) {
+      return i == j ? 10.0 : static_cast<double>(i + 2 * j) / 7;
+    }));
+    fixed_mat<3, 3> singular{1, 2, 3, 2, 4, 6, 0, 1, 1};
+    fixed_mat<3, 3> untouched(7.0F);
+    const bool inverted = singular.inverse(untouched);
+    CX_ASSERT((!inverted && untouched == fixed_mat<3, 3>(7.0F)), "");
+    fixed_mat<4, 4> singular4;
+    const bool inverted4 = singular4.inverse(singular4);
+    CX_ASSERT(!inverted4, "");
+
+    std::cout << "  Testing transforms..." << std::endl;
+    constexpr auto move_scale = fixed_mat<3, 3>::translation(1, 2) * fixed_mat<3, 3>::scaling(2, 3);
+    static_assert(move_scale.transform_point(row<2>{1, 1}) == row<2>{3, 5});
+    const auto rot = fixed_mat<3, 3>::rotation(3.14159265F / 2);
+    const Point p = rot.transform_point(Point(1, 0));
+    CX_ASSERT(std::abs(p.x()) < 1e-6F && std::abs(p.y() - 1) < 1e-6F, "");
+    fixed_mat<3, 3> undo;
+    const bool has_inverse = move_scale.inverse(undo);
+    const Point back = undo.transform_point(move_scale.transform_point(Point(5, -4)));
+    CX_ASSERT(has_inverse && std::abs(back.x() - 5) < 1e-5F && std::abs(back.y() + 4) < 1e-5F, "");
+    constexpr auto move3 = fixed_mat<4, 4>{1, 0, 0, 1, 0, 1, 0, 2, 0, 0, 1, 3, 0, 0, 0, 1};
+    static_assert(move3.transform_point(row<3>{1, 1, 1}) == row<3>{2, 3, 4});
+  }
+#endif
+};
+
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_FIXED_MAT_H_
@@ -22,17 +22,416 @@
 #ifndef CXSTRUCTS_SRC_CXSTRUCTS_MAT_H_
 #define CXSTRUCTS_SRC_CXSTRUCTS_MAT_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <new>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include "../cxconfig.h"
-#include "../cxutil/cxmath.h"
+#include "../cxutil/cxactivation.h"
+#include "../cxutil/cxio.h"
+#include "../cxutil/cxthreadpool.h"
 #include "vec.h"
 
+// Blocked single precision matrix multiply in the style of BLIS / GotoBLAS
+// A and B are packed into contiguous panels that fit the caches, a register blocked micro-kernel does the math
+// AVX2+FMA and NEON kernels, otherwise a scalar kernel the compiler can vectorize
+
+namespace cxhelper {
+constexpr uint_32_cx kGemmMR = 6;    // rows of the micro tile
+constexpr uint_32_cx kGemmNR = 16;   // columns of the micro tile
+constexpr uint_32_cx kGemmKC = 256;  // depth of a packed panel - MR x KC of A stays in L1
+constexpr uint_32_cx kGemmMC = 120;  // rows of a packed A block - MC x KC stays in L2
+constexpr uint_32_cx kGemmNC = 2048; // columns of a packed B block - KC x NC stays in L3
+// below this many multiply-adds packing costs more than it saves
+constexpr uint64_t kGemmSmall = 16 * 16 * 16;
+// alignment of all matrix storage - a cache line, enough for aligned AVX-512 loads
+constexpr size_t kMatAlign = 64;
+
+/**
+ * Allocates uninitialized, kMatAlign aligned storage for n floats
+ */
+inline float* mat_alloc(size_t n) {
+  if (n == 0) {
+    return nullptr;
+  }
+  return static_cast<float*>(::operator new(n * sizeof(float), std::align_val_t(kMatAlign)));
+}
+inline void mat_free(float* ptr) noexcept {
+  ::operator delete(ptr, std::align_val_t(kMatAlign));
+}
+
+/**
+ * Per thread packing memory, grows on demand and is reused between calls
+ */
+inline float* gemm_buffer(uint_32_cx slot, size_t floats) {
+  struct Buffer {
+    float* data_ = nullptr;
+    size_t size_ = 0;
+    ~Buffer() { ::operator delete(data_, std::align_val_t(64)); }
+  };
+  thread_local Buffer buffers[2];
+  Buffer& buffer = buffers[slot];
+  if (buffer.size_ < floats) {
+    ::operator delete(buffer.data_, std::align_val_t(64));
+    buffer.data_ = static_cast<float*>(::operator new(floats * sizeof(float), std::align_val_t(64)));
+    buffer.size_ = floats;
+  }
+  return buffer.data_;
+}
+/**
+ * Fused output stage of sgemm(): C = act(alpha * A * B + beta * C + bias)<p>
+ * The bias is a row broadcast over all rows of C and is written with the initial scaling of C,
+ * the activation is applied while the last panel of a tile is stored - both cost no extra pass over C
+ */
+struct GemmEpilogue {
+  const float* bias_ = nullptr;
+  float (*act_)(float) = nullptr;
+};
+// packs mc x kc of A (or of A^T) into row panels of MR - zero padded
+inline void gemm_pack_a(uint_32_cx mc, uint_32_cx kc, const float* A, uint_32_cx lda, bool trans,
+                        float* pack) {
+  for (uint_32_cx i = 0; i < mc; i += kGemmMR) {
+    const uint_32_cx rows = std::min(kGemmMR, mc - i);
+    for (uint_32_cx k = 0; k < kc; k++) {
+      uint_32_cx r = 0;
+      for (; r < rows; r++) {
+        *pack++ = trans ? A[k * lda + i + r] : A[(i + r) * lda + k];
+      }
+      for (; r < kGemmMR; r++) {
+        *pack++ = 0;
+      }
+    }
+  }
+}
+// packs kc x nc of B (or of B^T) into column panels of NR - zero padded
+inline void gemm_pack_b(uint_32_cx kc, uint_32_cx nc, const float* B, uint_32_cx ldb, bool trans,
+                        float* pack) {
+  for (uint_32_cx j = 0; j < nc; j += kGemmNR) {
+    const uint_32_cx cols = std::min(kGemmNR, nc - j);
+    if (trans) {
+      for (uint_32_cx k = 0; k < kc; k++) {
+        uint_32_cx c = 0;
+        for (; c < cols; c++) {
+          pack[c] = B[(j + c) * ldb + k];
+        }
+        for (; c < kGemmNR; c++) {
+          pack[c] = 0;
+        }
+        pack += kGemmNR;
+      }
+      continue;
+    }
+    for (uint_32_cx k = 0; k < kc; k++) {
+      const float* row = B + k * ldb + j;
+      if (cols == kGemmNR) {
+        std::copy(row, row + kGemmNR, pack);
+      } else {
+        std::copy(row, row + cols, pack);
+        std::fill(pack + cols, pack + kGemmNR, 0.0F);
+      }
+      pack += kGemmNR;
+    }
+  }
+}
+// applies act to n contiguous values - the vectorised span version for built-in activations
+inline void gemm_activate(float* row, uint_32_cx n, float (*act)(float)) noexcept {
+  if (const auto span_act = cxstructs::span_activation(act)) {
+    span_act({row, n});
+    return;
+  }
+  for (uint_32_cx j = 0; j < n; j++) {
+    row[j] = act(row[j]);
+  }
+}
+// acc[MR x NR] = packedA * packedB over kc - the NEON or portable variant
+inline void gemm_accumulate_scalar(uint_32_cx kc, const float* a, const float* b, float* acc) noexcept {
+#if defined(CX_NEON)
+  float32x4_t c[kGemmMR][4];
+  for (auto& row : c) {
+    for (auto& v : row) {
+      v = vdupq_n_f32(0);
+    }
+  }
+  for (uint_32_cx k = 0; k < kc; k++) {
+    const float32x4_t b0 = vld1q_f32(b), b1 = vld1q_f32(b + 4);
+    const float32x4_t b2 = vld1q_f32(b + 8), b3 = vld1q_f32(b + 12);
+    for (uint_32_cx r = 0; r < kGemmMR; r++) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+      c[r][0] = vfmaq_n_f32(c[r][0], b0, a[r]);
+      c[r][1] = vfmaq_n_f32(c[r][1], b1, a[r]);
+      c[r][2] = vfmaq_n_f32(c[r][2], b2, a[r]);
+      c[r][3] = vfmaq_n_f32(c[r][3], b3, a[r]);
+#else
+      c[r][0] = vmlaq_n_f32(c[r][0], b0, a[r]);
+      c[r][1] = vmlaq_n_f32(c[r][1], b1, a[r]);
+      c[r][2] = vmlaq_n_f32(c[r][2], b2, a[r]);
+      c[r][3] = vmlaq_n_f32(c[r][3], b3, a[r]);
+#endif
+    }
+    a += kGemmMR;
+    b += kGemmNR;
+  }
+  for (uint_32_cx r = 0; r < kGemmMR; r++) {
+    for (uint_32_cx v = 0; v < 4; v++) {
+      vst1q_f32(acc + r * kGemmNR + v * 4, c[r][v]);
+    }
+  }
+#else
+  std::fill(acc, acc + kGemmMR * kGemmNR, 0.0F);
+  for (uint_32_cx k = 0; k < kc; k++) {
+    for (uint_32_cx r = 0; r < kGemmMR; r++) {
+      const float av = a[r];
+      for (uint_32_cx j = 0; j < kGemmNR; j++) {
+        acc[r * kGemmNR + j] += av * b[j];
+      }
+    }
+    a += kGemmMR;
+    b += kGemmNR;
+  }
+#endif
+}
+#if defined(CX_X86_DISPATCH)
+CX_TARGET_AVX2 inline void gemm_accumulate_avx2(uint_32_cx kc, const float* a, const float* b,
+                                               float* acc) noexcept {
+  __m256 c[kGemmMR][2];
+  for (auto& row : c) {
+    row[0] = _mm256_setzero_ps();
+    row[1] = _mm256_setzero_ps();
+  }
+  for (uint_32_cx k = 0; k < kc; k++) {
+    const __m256 b0 = _mm256_load_ps(b);
+    const __m256 b1 = _mm256_load_ps(b + 8);
+    for (uint_32_cx r = 0; r < kGemmMR; r++) {
+      const __m256 av = _mm256_broadcast_ss(a + r);
+      c[r][0] = _mm256_fmadd_ps(av, b0, c[r][0]);
+      c[r][1] = _mm256_fmadd_ps(av, b1, c[r][1]);
+    }
+    a += kGemmMR;
+    b += kGemmNR;
+  }
+  for (uint_32_cx r = 0; r < kGemmMR; r++) {
+    _mm256_store_ps(acc + r * kGemmNR, c[r][0]);
+    _mm256_store_ps(acc + r * kGemmNR + 8, c[r][1]);
+  }
+}
+#endif
+// picks the accumulate variant for the running cpu once (see cxcpu.h)
+inline void gemm_accumulate(uint_32_cx kc, const float* a, const float* b, float* acc) noexcept {
+#if defined(CX_FMA)
+  gemm_accumulate_avx2(kc, a, b, acc);
+#elif defined(CX_X86_DISPATCH)
+  static const auto kernel = cxhelper::select_isa(gemm_accumulate_scalar, gemm_accumulate_avx2);
+  kernel(kc, a, b, acc);
+#else
+  gemm_accumulate_scalar(kc, a, b, acc);
+#endif
+}
+/**
+ * C[MR x NR] += alpha * packedA * packedB for a full or partial (rows x cols) tile
+ */
+inline void gemm_micro_kernel(uint_32_cx kc, float alpha, const float* a, const float* b, float* C,
+                              uint_32_cx ldc, uint_32_cx rows, uint_32_cx cols,
+                              float (*act)(float) = nullptr) {
+  alignas(64) float acc[kGemmMR * kGemmNR];
+  gemm_accumulate(kc, a, b, acc);
+  for (uint_32_cx r = 0; r < rows; r++) {
+    float* c_row = C + r * ldc;
+    const float* acc_row = acc + r * kGemmNR;
+    for (uint_32_cx j = 0; j < cols; j++) {
+      c_row[j] += alpha * acc_row[j];
+    }
+    if (act) {
+      gemm_activate(c_row, cols, act);
+    }
+  }
+}
+/**
+ * C = beta * C + bias applied once upfront so the kernels only accumulate - beta == 0 discards NaNs in C
+ */
+inline void gemm_scale_c(uint_32_cx M, uint_32_cx N, float beta, float* C, uint_32_cx ldc,
+                         const float* bias = nullptr) {
+  if (beta == 1.0F && !bias) {
+    return;
+  }
+  for (uint_32_cx i = 0; i < M; i++) {
+    float* row = C + i * ldc;
+    if (beta == 0.0F) {
+      if (bias) {
+        std::copy(bias, bias + N, row);
+      } else {
+        std::fill(row, row + N, 0.0F);
+      }
+    } else {
+      for (uint_32_cx j = 0; j < N; j++) {
+        row[j] = beta * row[j] + (bias ? bias[j] : 0.0F);
+      }
+    }
+  }
+}
+#if defined(CX_KERNEL_DECL)
+void sgemm(uint_32_cx M, uint_32_cx N, uint_32_cx K, float alpha, const float* A, uint_32_cx lda,
+           const float* B, uint_32_cx ldb, float beta, float* C, uint_32_cx ldc, bool transA = false,
+           bool transB = false, GemmEpilogue epilogue = {});
+void sgemm_parallel(cxstructs::ThreadPool& pool, uint_32_cx M, uint_32_cx N, uint_32_cx K, float alpha,
+                    const float* A, uint_32_cx lda, const float* B, uint_32_cx ldb, float beta,
+                    float* C, uint_32_cx ldc, bool transA = false, bool transB = false,
+                    GemmEpilogue epilogue = {});
+#else
+/**
+ * Row major C[M x N] = alpha * op(A)[M x K] * op(B)[K x N] + beta * C
+ * @param lda row stride of A as stored
+ * @param ldb row stride of B as stored
+ * @param ldc row stride of C
+ * @param transA if true A is stored as K x M and used transposed
+ * @param transB if true B is stored as N x K and used transposed
+ */
+CX_KERNEL void sgemm(uint_32_cx M, uint_32_cx N, uint_32_cx K, float alpha, const float* A,
+                     uint_32_cx lda, const float* B, uint_32_cx ldb, float beta, float* C,
+                     uint_32_cx ldc, bool transA = false, bool transB = false,
+                     GemmEpilogue epilogue = {}) {
+  gemm_scale_c(M, N, beta, C, ldc, epilogue.bias_);
+  if (M == 0 || N == 0 || K == 0 || alpha == 0.0F) {
+    if (epilogue.act_) {
+      for (uint_32_cx i = 0; i < M; i++) {
+        gemm_activate(C + i * ldc, N, epilogue.act_);
+      }
+    }
+    return;
+  }
+  if (static_cast<uint64_t>(M) * N * K <= kGemmSmall) {
+    for (uint_32_cx i = 0; i < M; i++) {
+      for (uint_32_cx j = 0; j < N; j++) {
+        float sum = 0.0F;
+        for (uint_32_cx k = 0; k < K; k++) {
+          sum += (transA ? A[k * lda + i] : A[i * lda + k]) *
+                 (transB ? B[j * ldb + k] : B[k * ldb + j]);
+        }
+        C[i * ldc + j] += alpha * sum;
+      }
+      if (epilogue.act_) {
+        gemm_activate(C + i * ldc, N, epilogue.act_);
+      }
+    }
+    return;
+  }
+  float* pack_a = gemm_buffer(0, kGemmMC * kGemmKC);
+  float* pack_b = gemm_buffer(1, static_cast<size_t>(kGemmKC) *
+                                     ((std::min(kGemmNC, N) + kGemmNR - 1) / kGemmNR * kGemmNR));
+  for (uint_32_cx jc = 0; jc < N; jc += kGemmNC) {
+    const uint_32_cx nc = std::min(kGemmNC, N - jc);
+    for (uint_32_cx pc = 0; pc < K; pc += kGemmKC) {
+      const uint_32_cx kc = std::min(kGemmKC, K - pc);
+      float (*act)(float) = pc + kc == K ? epilogue.act_ : nullptr;
+      gemm_pack_b(kc, nc, transB ? B + jc * ldb + pc : B + pc * ldb + jc, ldb, transB, pack_b);
+      for (uint_32_cx ic = 0; ic < M; ic += kGemmMC) {
+        const uint_32_cx mc = std::min(kGemmMC, M - ic);
+        gemm_pack_a(mc, kc, transA ? A + pc * lda + ic : A + ic * lda + pc, lda, transA, pack_a);
+        for (uint_32_cx jr = 0; jr < nc; jr += kGemmNR) {
+          for (uint_32_cx ir = 0; ir < mc; ir += kGemmMR) {
+            gemm_micro_kernel(kc, alpha, pack_a + ir * kc, pack_b + jr * kc,
+                              C + (ic + ir) * ldc + jc + jr, ldc, std::min(kGemmMR, mc - ir),
+                              std::min(kGemmNR, nc - jr), act);
+          }
+        }
+      }
+    }
+  }
+}
+/**
+ * sgemm() with the rows (or for flat outputs the columns) of C split across the threads of the pool
+ */
+CX_KERNEL void sgemm_parallel(cxstructs::ThreadPool& pool, uint_32_cx M, uint_32_cx N,
+                              uint_32_cx K, float alpha, const float* A, uint_32_cx lda,
+                              const float* B, uint_32_cx ldb, float beta, float* C, uint_32_cx ldc,
+                              bool transA = false, bool transB = false, GemmEpilogue epilogue = {}) {
+  const uint_32_cx threads = pool.size() + 1;
+  if (M >= threads * kGemmMR * 2 || N < threads * kGemmNR * 2) {
+    const uint_32_cx rows = std::max(kGemmMR, (M / (threads * 4)) / kGemmMR * kGemmMR);
+    pool.parallel_for(
+        0, M,
+        [&](uint_32_cx begin, uint_32_cx end) {
+          sgemm(end - begin, N, K, alpha, transA ? A + begin : A + begin * lda, lda, B, ldb, beta,
+                C + begin * ldc, ldc, transA, transB, epilogue);
+        },
+        rows);
+  } else {
+    const uint_32_cx cols = std::max(kGemmNR, (N / (threads * 4)) / kGemmNR * kGemmNR);
+    pool.parallel_for(
+        0, N,
+        [&](uint_32_cx begin, uint_32_cx end) {
+          GemmEpilogue cols_epilogue = epilogue;
+          if (cols_epilogue.bias_) {
+            cols_epilogue.bias_ += begin;
+          }
+          sgemm(M, end - begin, K, alpha, A, lda, transB ? B + begin * ldb : B + begin, ldb, beta,
+                C + begin, ldc, transA, transB, cols_epilogue);
+        },
+        cols);
+  }
+}
+#endif
+}  // namespace cxhelper
+
 namespace cxstructs {
+class mat;
+inline void gemm(float alpha, const mat& A, const mat& B, float beta, mat& C, bool transA = false,
+                 bool transB = false);
+
+/**
+ * <h2>mat_view</h2>
+ * A non-owning, read-only window onto row-major float data.<p>
+ * Rows are <b>stride</b> floats apart, so a view can describe a whole matrix, a block of a larger
+ * matrix or an externally owned buffer (mmapped weights, network buffers) without copying anything.
+ * The viewed memory has to outlive the view.
+ */
+class mat_view {
+  const float* data_ = nullptr;
+  uint_32_cx n_rows_ = 0;
+  uint_32_cx n_cols_ = 0;
+  uint_32_cx stride_ = 0;
+
+ public:
+  mat_view() = default;
+  /**
+   * @param data pointer to the first element
+   * @param rows number of rows
+   * @param cols number of columns
+   * @param stride distance between two rows in floats - 0 means densely packed (stride == cols)
+   */
+  inline mat_view(const float* data, uint_32_cx rows, uint_32_cx cols, uint_32_cx stride = 0)
+      : data_(data), n_rows_(rows), n_cols_(cols), stride_(stride == 0 ? cols : stride) {
+    CX_ASSERT(stride_ >= n_cols_, "stride smaller than the row length");
+  }
+  inline mat_view(const mat& m);  // NOLINT views are meant to be created implicitly
+  inline float operator()(uint_32_cx row, uint_32_cx col) const {
+    return data_[row * stride_ + col];
+  }
+  /**
+   * @return a view of the rows x cols block starting at (row, col) - shares the stride
+   */
+  [[nodiscard]] inline mat_view block(uint_32_cx row, uint_32_cx col, uint_32_cx rows,
+                                      uint_32_cx cols) const {
+    CX_ASSERT(row + rows <= n_rows_ && col + cols <= n_cols_, "block out of bounds");
+    return {data_ + row * stride_ + col, rows, cols, stride_};
+  }
+  [[nodiscard]] inline mat_view row(uint_32_cx row) const { return block(row, 0, 1, n_cols_); }
+  /**
+   * @return a dense, owning copy of the viewed elements
+   */
+  [[nodiscard]] inline mat to_mat() const;
+  [[nodiscard]] inline const float* data() const noexcept { return data_; }
+  [[nodiscard]] inline uint_32_cx n_rows() const noexcept { return n_rows_; }
+  [[nodiscard]] inline uint_32_cx n_cols() const noexcept { return n_cols_; }
+  [[nodiscard]] inline uint_32_cx stride() const noexcept { return stride_; }
+  [[nodiscard]] inline bool is_contiguous() const noexcept { return stride_ == n_cols_; }
+};
+inline void gemm(float alpha, const mat_view& A, const mat_view& B, float beta, mat& C,
+                 bool transA = false, bool transB = false);
 /**
     <h2>2D Matrix</h2>
     This data structure is an efficient representation of a two-dimensional<b> ROW-MAJOR</b> matrix, using a flattened array for cache efficiency and faster access times.
@@ -46,16 +445,57 @@ namespace cxstructs {
     A 2D Matrix is essential in various applications such as graphics transformations, solving systems of linear equations, and data analysis. The flattened array representation ensures that the elements are stored in a contiguous block of memory, which is beneficial for cache performance.<p>
 
     <b>Use Cases:</b> 2D Matrices are widely used in linear algebra, image processing, computer graphics, and scientific computing.
+    <br><br>
+    <b>Storage:</b> The elements are 64-byte aligned. With mat::wrap() a matrix can also run directly on an
+    external buffer without copying or taking ownership. mat_view gives a read-only, strided view.
     */
 class mat {
   float* arr;
   uint_32_cx n_rows_;
   uint_32_cx n_cols_;
+  uint_32_cx capacity_ = n_rows_ * n_cols_;  // allocated elements - can be more than n_rows_ * n_cols_
+  bool owns_ = true;                          // false for wrapped external buffers
+  // element count from which operations are split across the global ThreadPool
+  static inline uint_32_cx parallel_threshold_ = 1 << 18;
+
+  /**
+   * Calls func(begin, end) on the index range of all elements, in parallel for large matrices
+   */
+  template <typename Function>
+  inline void for_elements(Function func) const {
+    const uint_32_cx n = n_rows_ * n_cols_;
+    if (n >= parallel_threshold_ && ThreadPool::global().size() > 0) {
+      ThreadPool::global().parallel_for(0, n, func, 1 << 14);
+    } else {
+      func(0, n);
+    }
+  }
+  static inline void multiply(float alpha, const mat_view& A, const mat_view& B, float beta,
+                              mat& C, bool transA = false, bool transB = false,
+                              cxhelper::GemmEpilogue epilogue = {}) {
+    const uint_32_cx M = transA ? A.n_cols() : A.n_rows();
+    const uint_32_cx K = transA ? A.n_rows() : A.n_cols();
+    const uint_32_cx N = transB ? B.n_rows() : B.n_cols();
+    const uint64_t work = static_cast<uint64_t>(M) * N * K;
+    if (work >= static_cast<uint64_t>(parallel_threshold_) * 64 && ThreadPool::global().size() > 0) {
+      cxhelper::sgemm_parallel(ThreadPool::global(), M, N, K, alpha, A.data(), A.stride(),
+                               B.data(), B.stride(), beta, C.arr, C.n_cols_, transA, transB,
+                               epilogue);
+    } else {
+      cxhelper::sgemm(M, N, K, alpha, A.data(), A.stride(), B.data(), B.stride(), beta, C.arr,
+                      C.n_cols_, transA, transB, epilogue);
+    }
+  }
+  inline void release() noexcept {
+    if (owns_) {
+      cxhelper::mat_free(arr);
+    }
+  }
 
  public:
   inline mat() : n_cols_(0), n_rows_(0), arr(nullptr){};
   inline mat(std::initializer_list<float> list) : n_rows_(1), n_cols_((uint_32_cx)list.size()) {
-    arr = new float[n_cols_];
+    arr = cxhelper::mat_alloc(n_cols_);
     uint32_t i = 0;
     for (float val : list) {
       arr[i++] = val;
@@ -63,7 +503,7 @@ class mat {
   }
   inline mat(std::initializer_list<std::initializer_list<float>> list)
       : n_rows_((uint_32_cx)list.size()), n_cols_((uint_32_cx)list.begin()->size()) {
-    arr = new float[n_rows_ * n_cols_];
+    arr = cxhelper::mat_alloc(n_rows_ * n_cols_);
     uint32_t i = 0;
     for (const auto& sublist : list) {
       for (float val : sublist) {
@@ -79,13 +519,13 @@ class mat {
    */
   inline mat(const uint_32_cx& n_rows, const uint_32_cx& n_cols)
       : n_rows_(n_rows), n_cols_(n_cols) {
-    arr = new float[n_rows * n_cols];
+    arr = cxhelper::mat_alloc(n_rows * n_cols);
     std::fill(arr, arr + n_rows * n_cols, 0);
   }
 
   inline explicit mat(std::vector<std::vector<float>> vec)
       : n_rows_(vec.size()), n_cols_((uint_32_cx)vec[0].size()) {
-    arr = new float[n_rows_ * n_cols_];
+    arr = cxhelper::mat_alloc(n_rows_ * n_cols_);
     for (uint_32_cx i = 0; i < n_rows_; i++) {
       std::copy_n(vec[i].begin(), n_cols_, arr + i * n_cols_);
     }
@@ -103,7 +543,7 @@ class mat {
             typename = std::enable_if_t<std::is_invocable_r_v<double, fill_form, double>>>
   inline mat(uint_32_cx n_rows, uint_32_cx n_cols, fill_form form)
       : n_rows_(n_rows), n_cols_(n_cols) {
-    arr = new float[n_rows * n_cols];
+    arr = cxhelper::mat_alloc(n_rows * n_cols);
     for (int i = 0; i < n_rows * n_cols; i++) {
       arr[i] = form(i);
     }
@@ -116,14 +556,38 @@ class mat {
    * @param cols
    */
   inline mat(float* data, uint_32_cx rows, uint_32_cx cols)
-      : n_rows_(rows), n_cols_(cols), arr(new float[rows * cols]) {
+      : n_rows_(rows), n_cols_(cols), arr(cxhelper::mat_alloc(rows * cols)) {
     std::copy(data, data + rows * cols, arr);
   }
   inline mat(const mat& o) : n_rows_(o.n_rows_), n_cols_(o.n_cols_) {
-    arr = new float[n_rows_ * n_cols_];
+    arr = cxhelper::mat_alloc(n_rows_ * n_cols_);
     std::copy(o.arr, o.arr + n_rows_ * n_cols_, arr);
   }
-  inline ~mat() { delete[] arr; };
+  inline mat(mat&& o) noexcept
+      : arr(o.arr), n_rows_(o.n_rows_), n_cols_(o.n_cols_), capacity_(o.capacity_), owns_(o.owns_) {
+    o.arr = nullptr;
+    o.n_rows_ = o.n_cols_ = o.capacity_ = 0;
+    o.owns_ = true;
+  }
+  /**
+   * Creates a matrix that works directly on the given buffer without copying or taking ownership<p>
+   * The buffer has to hold rows * cols floats and outlive the matrix. Writes go to the buffer and
+   * only a resize beyond rows * cols makes the matrix allocate its own storage
+   * @param data externally owned, densely packed row-major data
+   * @param rows number of rows
+   * @param cols number of columns
+   * @return a non-owning matrix
+   */
+  static inline mat wrap(float* data, uint_32_cx rows, uint_32_cx cols) {
+    mat ret;
+    ret.arr = data;
+    ret.n_rows_ = rows;
+    ret.n_cols_ = cols;
+    ret.capacity_ = rows * cols;
+    ret.owns_ = false;
+    return ret;
+  }
+  inline ~mat() { release(); };
   inline float& operator()(const uint_32_cx& row, const uint_32_cx& col) {
     return arr[row * n_cols_ + col];
   }
@@ -138,19 +602,82 @@ class mat {
    * @return a pointer to the underlying array
    */
   float* get_raw() { return arr; }
+  [[nodiscard]] const float* get_raw() const { return arr; }
   //assign
   inline mat& operator=(const mat& other) {
     if (this != &other) {
-      delete[] arr;
-
+      resize(other.n_rows_, other.n_cols_);
+      std::copy(other.arr, other.arr + n_rows_ * n_cols_, arr);
+    }
+    return *this;
+  }
+  inline mat& operator=(mat&& other) noexcept {
+    if (this != &other) {
+      release();
+      arr = other.arr;
       n_rows_ = other.n_rows_;
       n_cols_ = other.n_cols_;
-
-      arr = new float[n_rows_ * n_cols_];
-      std::copy(other.arr, other.arr + n_rows_ * n_cols_, arr);
+      capacity_ = other.capacity_;
+      owns_ = other.owns_;
+      other.arr = nullptr;
+      other.n_rows_ = other.n_cols_ = other.capacity_ = 0;
+      other.owns_ = true;
     }
     return *this;
   }
+  /**
+   * Changes the dimensions of the matrix. Only allocates if the new size exceeds the capacity<p>
+   * The values are unspecified afterwards
+   * @param n_rows new number of rows
+   * @param n_cols new number of columns
+   */
+  inline void resize(uint_32_cx n_rows, uint_32_cx n_cols) {
+    if (n_rows * n_cols > capacity_) {
+      release();
+      arr = cxhelper::mat_alloc(n_rows * n_cols);
+      capacity_ = n_rows * n_cols;
+      owns_ = true;
+    }
+    n_rows_ = n_rows;
+    n_cols_ = n_cols;
+  }
+  /**
+   * Replaces the contents with a numeric CSV file - one matrix row per line.<p>
+   * The rows are counted first, then the values are parsed straight into the resized matrix, in parallel
+   * with threads > 1.
+   * @param filePath the file to read
+   * @param delimiter the field separator
+   * @param header if true the first line is skipped
+   * @param threads number of chunks parsed in parallel on the global ThreadPool
+   * @return false if the file could not be read or a field is not a number - the values are unspecified then
+   */
+  bool load_csv(const std::string& filePath, char delimiter = ',', bool header = false,
+                uint_32_cx threads = 1) {
+    CSVReader csv(filePath, delimiter, header, threads);
+    if (!csv.is_open()) {
+      return false;
+    }
+    resize(static_cast<uint_32_cx>(csv.rows()), static_cast<uint_32_cx>(csv.cols()));
+    float* data = arr;
+    const size_t cols = csv.cols();
+    return csv.parse<float>(
+        [data, cols](size_t row, size_t col, float value) { data[row * cols + col] = value; });
+  }
+  /**
+   * @return the number of elements that fit without reallocating
+   */
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept { return capacity_; }
+  /**
+   * @return false if the matrix runs on a buffer passed to mat::wrap()
+   */
+  [[nodiscard]] inline bool owns_data() const noexcept { return owns_; }
+  /**
+   * @return a read-only view of the rows x cols block starting at (row, col)
+   */
+  [[nodiscard]] inline mat_view block(uint_32_cx row, uint_32_cx col, uint_32_cx rows,
+                                      uint_32_cx cols) const {
+    return mat_view(*this).block(row, col, rows, cols);
+  }
   /**
    * Returns a new matrix that is the result of the multiplication
    * of the current matrix with the provided matrix.
@@ -163,26 +690,34 @@ class mat {
     CX_ASSERT(n_cols_ == o.n_rows_, "invalid dimensions");
 
     mat result(n_rows_, o.n_cols_);
-    for (uint_32_cx i = 0; i < n_rows_; i++) {
-      for (uint_32_cx j = 0; j < o.n_cols_; j++) {
-        float sum = 0.0f;
-        for (uint_32_cx k = 0; k < n_cols_; k++) {
-          sum += arr[i * n_cols_ + k] * o.arr[k * o.n_cols_ + j];
-        }
-        result.arr[i * result.n_cols_ + j] = sum;
-      }
-    }
+    multiply(1.0F, *this, o, 0.0F, result);
     return result;
   }
+  friend inline void gemm(float alpha, const mat& A, const mat& B, float beta, mat& C,
+                          bool transA, bool transB);
+  friend inline void gemm(float alpha, const mat_view& A, const mat_view& B, float beta, mat& C,
+                          bool transA, bool transB);
+  friend class mat_view;
+  friend inline void mul_into(const mat& A, const mat& B, mat& C);
+  friend inline void affine_into(const mat_view& A, const mat& B, const mat& bias,
+                                 float (*act)(float), mat& C);
+  friend inline void add_into(const mat& A, const mat& B, mat& C);
+  friend inline void sub_into(const mat& A, const mat& B, mat& C);
+  friend inline void hadamard_into(const mat& A, const mat& B, mat& C);
+  friend inline void transpose_into(const mat& A, mat& C);
+  friend inline void sum_cols_into(const mat& A, mat& C);
+  friend inline void axpy(float alpha, const mat& X, mat& Y);
   /**
    * Alternative in-place scaling with a float
    * @param f a float scalar
    */
   inline void operator*=(const float& f) const {
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
 #pragma omp simd linear(i : 1)
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      arr[i] *= f;
-    }
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] *= f;
+      }
+    });
   }
   /**
    * Returns a new matrix that
@@ -194,9 +729,11 @@ class mat {
   inline mat operator+(const mat& o) const {
     CX_ASSERT(o.n_cols_ == n_cols_ || o.n_rows_ == n_rows_, "invalid dimensions");
     mat res(n_rows_, n_cols_);
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      res.arr[i] = arr[i] + o.arr[i];
-    }
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_fast32_t i = begin; i < end; i++) {
+        res.arr[i] = arr[i] + o.arr[i];
+      }
+    });
     return res;
   };
   /**
@@ -209,17 +746,57 @@ class mat {
   inline mat operator-(const mat& o) const {
     CX_ASSERT(o.n_cols_ == n_cols_ || o.n_rows_ == n_rows_, "invalid dimensions");
     mat res(n_rows_, n_cols_);
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      res.arr[i] = arr[i] - o.arr[i];
-    }
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_fast32_t i = begin; i < end; i++) {
+        res.arr[i] = arr[i] - o.arr[i];
+      }
+    });
     return res;
   };
+  inline void operator+=(const mat& o) const {
+    CX_ASSERT(o.n_cols_ == n_cols_ && o.n_rows_ == n_rows_, "invalid dimensions");
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd linear(i : 1)
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] += o.arr[i];
+      }
+    });
+  }
+  /**
+   * In-place Hadamard product (element-wise multiplication)
+   * @param o other matrix of the same size
+   */
+  inline void operator%=(const mat& o) const {
+    CX_ASSERT(o.n_cols_ == n_cols_ && o.n_rows_ == n_rows_, "invalid dimensions");
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd linear(i : 1)
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] *= o.arr[i];
+      }
+    });
+  }
+  /**
+   * Adds the given 1 x n_cols row to every row of the matrix (e.g. a bias)
+   * @param row the row to add
+   */
+  inline void add_row(const mat& row) const {
+    CX_ASSERT(row.n_rows_ == 1 && row.n_cols_ == n_cols_, "invalid dimensions");
+    for (uint_32_cx i = 0; i < n_rows_; i++) {
+      float* dst = arr + i * n_cols_;
+#pragma omp simd
+      for (uint_32_cx j = 0; j < n_cols_; j++) {
+        dst[j] += row.arr[j];
+      }
+    }
+  }
   inline void operator-=(const mat& o) const {
     CX_ASSERT(o.n_cols_ == n_cols_ || o.n_rows_ == n_rows_, "invalid dimensions");
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
 #pragma omp simd linear(i : 1)
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      arr[i] -= o.arr[i];
-    }
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] -= o.arr[i];
+      }
+    });
   }
   /**
    * Returns a new matrix that is the matrix Hadamard product (element-wise multiplication).
@@ -231,9 +808,11 @@ class mat {
     CX_ASSERT(o.n_cols_ == n_cols_ || o.n_rows_ == n_rows_, "invalid dimensions");
 
     mat res(n_rows_, n_cols_);
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      res.arr[i] = arr[i] * o.arr[i];
-    }
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_fast32_t i = begin; i < end; i++) {
+        res.arr[i] = arr[i] * o.arr[i];
+      }
+    });
     return res;
   }
   /**
@@ -245,9 +824,11 @@ class mat {
   inline mat operator/(const mat& o) const {
     CX_ASSERT(o.n_cols_ == n_cols_ || o.n_rows_ == n_rows_, "invalid dimensions");
     mat res(n_rows_, n_cols_);
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      res.arr[i] = arr[i] / o.arr[i];
-    }
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_fast32_t i = begin; i < end; i++) {
+        res.arr[i] = arr[i] / o.arr[i];
+      }
+    });
     return res;
   }
   /**
@@ -329,25 +910,46 @@ class mat {
       arr[i * n_cols_ + col] = l(i, arr[i * n_cols_ + col]);
     }
   }
+  /**
+   * Allows you to perform a lambda function on all values of the matrix<p>
+   * Large matrices are split across threads so the lambda has to be thread safe
+   * @tparam lambda the function to perform
+   * @param l the function to determine the new value: val -> lambda(... return val)
+   */
   template <typename lambda>
   inline void mat_op(lambda l) {
-#pragma omp simd linear(i : 1)
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      arr[i] = l(arr[i]);
+    if constexpr (std::is_pointer_v<lambda>) {  // noexcept function pointers like cxstructs::sig end up here
+      if (const auto span_func = span_activation(l)) {
+        for_elements([&](uint_32_cx begin, uint_32_cx end) { span_func({arr + begin, end - begin}); });
+        return;
+      }
     }
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd linear(i : 1)
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] = l(arr[i]);
+      }
+    });
   }
   /**
    * Allows you to perform a function on all values of the matrix
-   * The current value is given as input [](float mat_val){return func(mat_val);}
+   * The current value is given as input [](float mat_val){return func(mat_val);}<p>
+   * Built-in activations and their derivatives (sig, tanh, relu, linear) run as vectorised span versions
    * @tparam lambda the function to perform
    * @param row row to perform the operation on
    * @param l the function to determine the new value
    */
   inline void mat_op(float (*func)(float)) {
-#pragma omp simd linear(i : 1)
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      arr[i] = func(arr[i]);
+    if (const auto span_func = span_activation(func)) {
+      for_elements([&](uint_32_cx begin, uint_32_cx end) { span_func({arr + begin, end - begin}); });
+      return;
     }
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd linear(i : 1)
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] = func(arr[i]);
+      }
+    });
   }
   /**
  * Takes the dot product of each row of the matrix with the given vector and returns a new vector
@@ -417,11 +1019,20 @@ class mat {
    * @param s the scalar
    */
   inline void scale(const float& a) {
+    for_elements([&](uint_32_cx begin, uint_32_cx end) {
 #pragma omp simd linear(i : 1)
-    for (uint_fast32_t i = 0; i < n_rows_ * n_cols_; i++) {
-      arr[i] = arr[i] * a;
-    }
+      for (uint_fast32_t i = begin; i < end; i++) {
+        arr[i] = arr[i] * a;
+      }
+    });
   };
+  /**
+   * Sets the number of elements from which element-wise operations run on the global ThreadPool<p>
+   * Multiplications go parallel from 64 times this many multiply-adds
+   * @param elements the new threshold - use UINT32_MAX to always run single threaded
+   */
+  static inline void set_parallel_threshold(uint_32_cx elements) noexcept { parallel_threshold_ = elements; }
+  [[nodiscard]] static inline uint_32_cx parallel_threshold() noexcept { return parallel_threshold_; }
   [[nodiscard]] inline mat sum_rows() const {
     mat retval(n_rows_, 1);
     for (uint_fast32_t i = 0; i < n_rows_; i++) {
@@ -649,6 +1260,160 @@ class mat {
     CX_ASSERT(m19(1, 0) == 43, "");
     CX_ASSERT(m19(1, 1) == 50, "");
 
+    std::cout << "  Testing blocked multiplication...\n";
+    auto naive = [](const mat& a, const mat& b) {
+      mat c(a.n_rows_, b.n_cols_);
+      for (uint_32_cx i = 0; i < a.n_rows_; i++) {
+        for (uint_32_cx j = 0; j < b.n_cols_; j++) {
+          double sum = 0;
+          for (uint_32_cx k = 0; k < a.n_cols_; k++) {
+            sum += a(i, k) * b(k, j);
+          }
+          c(i, j) = (float)sum;
+        }
+      }
+      return c;
+    };
+    const uint_32_cx shapes[][3] = {{1, 1, 1}, {7, 13, 5}, {6, 16, 300}, {67, 129, 301}, {250, 70, 520}};
+    for (auto& shape : shapes) {
+      mat a(shape[0], shape[2], [](int i) { return (float)(i % 7) - 3.0F; });
+      mat b(shape[2], shape[1], [](int i) { return (float)(i % 5) * 0.5F - 1.0F; });
+      mat expected = naive(a, b);
+      mat res = a * b;
+      for (uint_32_cx i = 0; i < res.n_rows_ * res.n_cols_; i++) {
+        CX_ASSERT(std::abs(res.arr[i] - expected.arr[i]) < 1e-3F, "");
+      }
+      mat out(shape[0], shape[1], [](int i) { return (float)i; });
+      mat prev = out;
+      gemm(2.0F, a, b, 0.5F, out);
+      for (uint_32_cx i = 0; i < out.n_rows_ * out.n_cols_; i++) {
+        CX_ASSERT(std::abs(out.arr[i] - (2.0F * expected.arr[i] + 0.5F * prev.arr[i])) < 1e-2F, "");
+      }
+    }
+
+    std::cout << "  Testing in-place operations...\n";
+    mat q1(5, 3, [](int i) { return (float)i; });
+    mat q2(5, 3, [](int i) { return (float)(i % 4); });
+    mat q3(3, 4, [](int i) { return (float)i - 2.0F; });
+    mat out1;
+    add_into(q1, q2, out1);
+    CX_ASSERT(out1 == q1 + q2, "");
+    const float* out1_data = out1.arr;
+    sub_into(q1, q2, out1);
+    CX_ASSERT(out1 == q1 - q2 && out1.arr == out1_data, "");
+    hadamard_into(q1, q2, out1);
+    CX_ASSERT(out1 == q1 % q2 && out1.arr == out1_data, "");
+    mul_into(q1, q3, out1);
+    CX_ASSERT(out1 == q1 * q3 && out1.n_cols_ == 4, "");
+    transpose_into(q1, out1);
+    CX_ASSERT(out1 == q1.transpose(), "");
+    sum_cols_into(q1, out1);
+    CX_ASSERT(out1 == q1.sum_cols(), "");
+    mat q4 = q1;
+    axpy(-2.0F, q2, q4);
+    for (uint_32_cx i = 0; i < 15; i++) {
+      CX_ASSERT(q4.arr[i] == q1.arr[i] - 2.0F * q2.arr[i], "");
+    }
+    q4 %= q2;
+    q4 += q1;
+    q4.add_row(mat(1, 3, [](int i) { return (float)i; }));
+    CX_ASSERT(q4(4, 2) == (q1(4, 2) - 2.0F * q2(4, 2)) * q2(4, 2) + q1(4, 2) + 2.0F, "");
+    mat t_out(3, 3);
+    gemm(1.0F, q1, q2, 0.0F, t_out, true, false);
+    CX_ASSERT(t_out == q1.transpose() * q2, "");
+    mat t_out2(5, 5);
+    gemm(1.0F, q1, q2, 0.0F, t_out2, false, true);
+    CX_ASSERT(t_out2 == q1 * q2.transpose(), "");
+    mat big_a(300, 70, [](int i) { return (float)(i % 9) - 4.0F; });
+    mat big_b(300, 90, [](int i) { return (float)(i % 5) - 2.0F; });
+    mat big_c(70, 90);
+    gemm(1.0F, big_a, big_b, 0.0F, big_c, true, false);
+    CX_ASSERT(big_c == big_a.transpose() * big_b, "");
+    mat big_d(300, 300);
+    gemm(1.0F, big_a, big_a, 0.0F, big_d, false, true);
+    CX_ASSERT(big_d == big_a * big_a.transpose(), "");
+    mat moved = std::move(big_d);
+    CX_ASSERT(moved.n_rows_ == 300 && big_d.arr == nullptr, "");
+
+    std::cout << "  Testing fused bias and activation...\n";
+    float (*clamp)(float) = [](float x) { return x > 0 ? x : 0.0F; };
+    for (uint_32_cx n : {3U, 70U}) {
+      mat fa(n + 5, n, [](int i) { return (float)(i % 7) - 3.0F; });
+      mat fb(n, n + 2, [](int i) { return (float)(i % 5) - 2.0F; });
+      mat f_bias(1, n + 2, [](int i) { return (float)i - 1.0F; });
+      mat f_out;
+      affine_into(fa, fb, f_bias, clamp, f_out);
+      mat f_expected = fa * fb;
+      f_expected.add_row(f_bias);
+      f_expected.mat_op(clamp);
+      CX_ASSERT(f_out == f_expected, "");
+      affine_into(fa, fb, f_bias, nullptr, f_out);
+      CX_ASSERT(f_out(1, 1) == (fa * fb)(1, 1) + f_bias(0, 1), "");
+      // built-in activations go through the vectorised span versions in both paths
+      mat f_sig;
+      affine_into(fa, fb, f_bias, cxstructs::sig, f_sig);
+      mat f_sig_expected = fa * fb;
+      f_sig_expected.add_row(f_bias);
+      f_sig_expected.mat_op(cxstructs::sig);
+      for (uint_32_cx i = 0; i < f_sig.n_rows() * f_sig.n_cols(); i++) {
+        CX_ASSERT(std::abs(f_sig.arr[i] - f_sig_expected.arr[i]) < 1e-6F, "");
+        CX_ASSERT(std::abs(f_sig.arr[i] - cxstructs::sig(f_out.arr[i])) < 1e-6F, "");
+      }
+    }
+
+    std::cout << "  Testing aligned storage and views...\n";
+    CX_ASSERT(reinterpret_cast<uintptr_t>(q1.arr) % cxhelper::kMatAlign == 0, "");
+    float external[4 * 6];
+    for (int i = 0; i < 24; i++) {
+      external[i] = (float)i;
+    }
+    {
+      mat wrapped = mat::wrap(external, 4, 6);
+      CX_ASSERT(!wrapped.owns_data() && wrapped.arr == external, "");
+      CX_ASSERT(wrapped(1, 2) == 8, "");
+      wrapped.scale(2.0F);
+      mat moved_wrap = std::move(wrapped);
+      CX_ASSERT(moved_wrap.arr == external && !moved_wrap.owns_data(), "");
+      moved_wrap.resize(8, 8);  // grows - switches to own storage
+      CX_ASSERT(moved_wrap.owns_data() && moved_wrap.arr != external, "");
+    }
+    CX_ASSERT(external[23] == 46, "");
+    mat_view ext_view(external, 4, 6);
+    mat_view ext_block = ext_view.block(1, 2, 3, 3);
+    CX_ASSERT(ext_block.stride() == 6 && !ext_block.is_contiguous(), "");
+    CX_ASSERT(ext_block(0, 0) == 16 && ext_block(2, 2) == 2 * 22, "");
+    mat block_copy = ext_block.to_mat();
+    CX_ASSERT(block_copy.n_rows_ == 3 && block_copy(2, 0) == 2 * 20, "");
+    mat block_sq(3, 3);
+    gemm(1.0F, ext_block, ext_block, 0.0F, block_sq);
+    CX_ASSERT(block_sq == block_copy * block_copy, "");
+    mat block_t(6, 3);
+    gemm(1.0F, big_a.block(0, 0, 3, 6), q1.block(1, 0, 3, 3), 0.0F, block_t, true, false);
+    CX_ASSERT(block_t == big_a.block(0, 0, 3, 6).to_mat().transpose() * q1.block(1, 0, 3, 3).to_mat(),
+              "");
+
+    std::cout << "  Testing parallel operations...\n";
+    const auto old_threshold = parallel_threshold();
+    mat p1(300, 200, [](int i) { return (float)(i % 11); });
+    mat p2(200, 150, [](int i) { return (float)(i % 3) - 1.0F; });
+    mat p1_sum = p1 + p1;
+    mat p1_prod = p1 * p2;
+    set_parallel_threshold(64);
+    CX_ASSERT(p1 + p1 == p1_sum, "");
+    CX_ASSERT(p1 * p2 == p1_prod, "");
+    mat p3 = p1;
+    p3.mat_op([](float val) { return val * 2; });
+    CX_ASSERT(p3 == p1_sum, "");
+    p3.scale(0.5F);
+    CX_ASSERT(p3 == p1, "");
+    mat flat(2, 4000, [](int i) { return (float)(i % 5); });
+    mat flat_b(4000, 1000, [](int i) { return (float)(i % 2); });
+    set_parallel_threshold(UINT32_MAX);
+    mat flat_prod = flat * flat_b;
+    set_parallel_threshold(64);
+    CX_ASSERT(flat * flat_b == flat_prod, "");
+    set_parallel_threshold(old_threshold);
+
     std::cout << "  Testing row and col operations...\n";
 
     mat m20(2, 2);
@@ -665,6 +1430,31 @@ class mat {
     CX_ASSERT(m20(0, 0) == 2, "");
     CX_ASSERT(m20(1, 0) == 7, "");
 
+    std::cout << "  Testing load_csv...\n";
+    const std::string csv_path = "cxstructs_mat_test.csv";
+    {
+      std::ofstream out(csv_path);
+      out << "a,b,c,d\n";
+      for (int i = 0; i < 40000; i++) {
+        out << i << "," << i * 0.25F << ",-" << i % 7 << "," << (i % 1000) * 0.125F << (i % 2 ? "\r\n" : "\n");
+      }
+      out << "\n";
+    }
+    mat loaded;
+    CX_ASSERT(loaded.load_csv(csv_path, ',', true, 4), "");
+    CX_ASSERT(loaded.n_rows() == 40000 && loaded.n_cols() == 4, "");
+    for (uint_32_cx i = 0; i < loaded.n_rows(); i++) {
+      CX_ASSERT(loaded(i, 0) == (float)i && loaded(i, 1) == i * 0.25F, "");
+      CX_ASSERT(loaded(i, 2) == -(float)(i % 7) && loaded(i, 3) == (i % 1000) * 0.125F, "");
+    }
+    {
+      std::ofstream out(csv_path);
+      out << "1, 2\n3, x\n";
+    }
+    CX_ASSERT(!loaded.load_csv(csv_path), "");
+    std::remove(csv_path.c_str());
+    CX_ASSERT(!loaded.load_csv(csv_path), "");
+
     std::cout << "  Testing print...\n";
     m20.print();
     m20.print("m20");
@@ -672,5 +1462,160 @@ class mat {
   }
 #endif
 };
+/**
+ * General matrix multiply into an existing matrix: C = alpha * A * B + beta * C<p>
+ * Does not allocate, C has to be of size A.n_rows() x B.n_cols() and must not be A or B
+ * @param alpha scalar for the product
+ * @param A left matrix
+ * @param B right matrix
+ * @param beta scalar for the previous content of C - 0 overwrites C
+ * @param C the output
+ */
+inline void gemm(float alpha, const mat& A, const mat& B, float beta, mat& C, bool transA,
+                 bool transB) {
+  CX_ASSERT((transA ? A.n_rows_ : A.n_cols_) == (transB ? B.n_cols_ : B.n_rows_) &&
+                C.n_rows_ == (transA ? A.n_cols_ : A.n_rows_) &&
+                C.n_cols_ == (transB ? B.n_rows_ : B.n_cols_),
+            "invalid dimensions");
+  CX_ASSERT(&C != &A && &C != &B, "output aliases an input");
+  mat::multiply(alpha, A, B, beta, C, transA, transB);
+}
+/**
+ * Same as gemm() on matrices, but A and B can be strided views into larger or external buffers
+ */
+inline void gemm(float alpha, const mat_view& A, const mat_view& B, float beta, mat& C,
+                 bool transA, bool transB) {
+  CX_ASSERT((transA ? A.n_rows() : A.n_cols()) == (transB ? B.n_cols() : B.n_rows()) &&
+                C.n_rows_ == (transA ? A.n_cols() : A.n_rows()) &&
+                C.n_cols_ == (transB ? B.n_rows() : B.n_cols()),
+            "invalid dimensions");
+  CX_ASSERT(C.arr != A.data() && C.arr != B.data(), "output aliases an input");
+  mat::multiply(alpha, A, B, beta, C, transA, transB);
+}
+inline mat_view::mat_view(const mat& m)
+    : data_(m.arr), n_rows_(m.n_rows_), n_cols_(m.n_cols_), stride_(m.n_cols_) {}
+inline mat mat_view::to_mat() const {
+  mat ret(n_rows_, n_cols_);
+  for (uint_32_cx i = 0; i < n_rows_; i++) {
+    std::copy_n(data_ + i * stride_, n_cols_, ret.arr + i * n_cols_);
+  }
+  return ret;
+}
+/*
+ * Out parameter variants of the operators - the output is resized to fit and only allocates
+ * if it has to grow, so reusing the same outputs makes a computation allocation free
+ */
+
+/**
+ * C = A * B
+ */
+inline void mul_into(const mat& A, const mat& B, mat& C) {
+  CX_ASSERT(A.n_cols_ == B.n_rows_, "invalid dimensions");
+  CX_ASSERT(&C != &A && &C != &B, "output aliases an input");
+  C.resize(A.n_rows_, B.n_cols_);
+  mat::multiply(1.0F, A, B, 0.0F, C);
+}
+/**
+ * C = act(A * B + bias) in a single pass - the bias add and activation run inside the gemm epilogue<p>
+ * The building block of a dense neural network layer
+ * @param A batch x in inputs
+ * @param B in x out weights
+ * @param bias 1 x out row added to every row
+ * @param act activation applied to every element - nullptr for none
+ * @param C batch x out output - resized to fit, must not alias the inputs
+ */
+inline void affine_into(const mat_view& A, const mat& B, const mat& bias, float (*act)(float),
+                        mat& C) {
+  CX_ASSERT(A.n_cols() == B.n_rows_ && bias.n_rows_ == 1 && bias.n_cols_ == B.n_cols_,
+            "invalid dimensions");
+  CX_ASSERT(C.arr != A.data() && &C != &B && &C != &bias, "output aliases an input");
+  C.resize(A.n_rows(), B.n_cols_);
+  mat::multiply(1.0F, A, B, 0.0F, C, false, false, {bias.arr, act});
+}
+/**
+ * C = A + B - C may be A or B
+ */
+inline void add_into(const mat& A, const mat& B, mat& C) {
+  CX_ASSERT(A.n_cols_ == B.n_cols_ && A.n_rows_ == B.n_rows_, "invalid dimensions");
+  C.resize(A.n_rows_, A.n_cols_);
+  A.for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd
+    for (uint_32_cx i = begin; i < end; i++) {
+      C.arr[i] = A.arr[i] + B.arr[i];
+    }
+  });
+}
+/**
+ * C = A - B - C may be A or B
+ */
+inline void sub_into(const mat& A, const mat& B, mat& C) {
+  CX_ASSERT(A.n_cols_ == B.n_cols_ && A.n_rows_ == B.n_rows_, "invalid dimensions");
+  C.resize(A.n_rows_, A.n_cols_);
+  A.for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd
+    for (uint_32_cx i = begin; i < end; i++) {
+      C.arr[i] = A.arr[i] - B.arr[i];
+    }
+  });
+}
+/**
+ * C = A % B (element-wise) - C may be A or B
+ */
+inline void hadamard_into(const mat& A, const mat& B, mat& C) {
+  CX_ASSERT(A.n_cols_ == B.n_cols_ && A.n_rows_ == B.n_rows_, "invalid dimensions");
+  C.resize(A.n_rows_, A.n_cols_);
+  A.for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd
+    for (uint_32_cx i = begin; i < end; i++) {
+      C.arr[i] = A.arr[i] * B.arr[i];
+    }
+  });
+}
+/**
+ * C = A^T - blocked so both matrices are walked in cache sized tiles
+ */
+inline void transpose_into(const mat& A, mat& C) {
+  CX_ASSERT(&C != &A, "output aliases the input");
+  constexpr uint_32_cx tile = 32;
+  C.resize(A.n_cols_, A.n_rows_);
+  for (uint_32_cx i0 = 0; i0 < A.n_rows_; i0 += tile) {
+    for (uint_32_cx j0 = 0; j0 < A.n_cols_; j0 += tile) {
+      const uint_32_cx i_end = std::min(A.n_rows_, i0 + tile);
+      const uint_32_cx j_end = std::min(A.n_cols_, j0 + tile);
+      for (uint_32_cx i = i0; i < i_end; i++) {
+        for (uint_32_cx j = j0; j < j_end; j++) {
+          C.arr[j * A.n_rows_ + i] = A.arr[i * A.n_cols_ + j];
+        }
+      }
+    }
+  }
+}
+/**
+ * C = the 1 x n_cols sums over all rows of A
+ */
+inline void sum_cols_into(const mat& A, mat& C) {
+  CX_ASSERT(&C != &A, "output aliases the input");
+  C.resize(1, A.n_cols_);
+  std::fill(C.arr, C.arr + A.n_cols_, 0.0F);
+  for (uint_32_cx i = 0; i < A.n_rows_; i++) {
+    const float* row = A.arr + i * A.n_cols_;
+#pragma omp simd
+    for (uint_32_cx j = 0; j < A.n_cols_; j++) {
+      C.arr[j] += row[j];
+    }
+  }
+}
+/**
+ * Y += alpha * X - fused scale and add without a temporary
+ */
+inline void axpy(float alpha, const mat& X, mat& Y) {
+  CX_ASSERT(X.n_cols_ == Y.n_cols_ && X.n_rows_ == Y.n_rows_, "invalid dimensions");
+  Y.for_elements([&](uint_32_cx begin, uint_32_cx end) {
+#pragma omp simd
+    for (uint_32_cx i = begin; i < end; i++) {
+      Y.arr[i] += alpha * X.arr[i];
+    }
+  });
+}
 }  // namespace cxstructs
 #endif
\ No newline at end of file
@@ -0,0 +1,424 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXSTRUCTS_SOAVEC_H_
+#define CXSTRUCTS_SRC_CXSTRUCTS_SOAVEC_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "../cxconfig.h"
+#include "../cxutil/cxio.h"
+
+// Structure of arrays list: every field of a row lives in its own 64 byte aligned array
+// Loops over one or two fields (e.g. x and y) stream exactly the bytes they use and vectorize
+// Rows are read and written through std::tuple<Fields&...> proxies, fields through get<I>() spans
+
+namespace cxhelper {
+// alignment of every field array - a cache line, enough for aligned AVX-512 loads
+constexpr size_t kSoaAlign = 64;
+}  // namespace cxhelper
+
+namespace cxstructs {
+using namespace cxhelper;
+
+/**
+ * <h2>soa_vec</h2>
+ * A dynamic list of rows where each field is stored in its own contiguous, 64-byte aligned array.
+ * <br><br>
+ * <code>soa_vec&lt;float, float, int&gt; points;</code> keeps all x, all y and all ints next to each other.
+ * <code>points.get&lt;0&gt;()</code> returns the x values as a std::span, <code>points[i]</code> a tuple of references
+ * to the fields of row i, so <code>auto [x, y, id] = points[i];</code> binds to the stored values.
+ * <br><br>
+ * Fields have to be trivially copyable - growing copies each array with memcpy.
+ * <br>
+ * By convention of kNN_2D, QuadTree and HashGrid the first two fields are the x and y coordinate.
+ *
+ * @tparam Fields the field types of a row
+ */
+template <typename... Fields>
+class soa_vec {
+  static_assert(sizeof...(Fields) > 0, "soa_vec needs at least one field");
+  static_assert((std::is_trivially_copyable_v<Fields> && ...), "soa_vec fields have to be trivially copyable");
+  using Indices = std::index_sequence_for<Fields...>;
+
+  std::tuple<Fields*...> arrays_{};
+  uint_32_cx size_ = 0;
+  uint_32_cx len_ = 0;
+
+  template <typename T>
+  static inline T* allocate(uint_32_cx n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kSoaAlign)));
+  }
+  template <typename T>
+  static inline void deallocate(T* ptr) noexcept {
+    ::operator delete(ptr, std::align_val_t(kSoaAlign));
+  }
+  template <size_t... I>
+  inline void reallocate(uint_32_cx new_len, std::index_sequence<I...>) {
+    (
+        [&] {
+          using T = std::tuple_element_t<I, std::tuple<Fields...>>;
+          T* n_arr = allocate<T>(new_len);
+          T*& arr = std::get<I>(arrays_);
+          if (arr) {
+            if (size_ > 0) {
+              std::memcpy(static_cast<void*>(n_arr), arr, size_ * sizeof(T));
+            }
+            deallocate(arr);
+          }
+          arr = n_arr;
+        }(),
+        ...);
+    len_ = new_len;
+  }
+  template <size_t... I>
+  inline void release(std::index_sequence<I...>) noexcept {
+    ((std::get<I>(arrays_) ? deallocate(std::get<I>(arrays_)) : void()), ...);
+    arrays_ = {};
+  }
+  template <size_t... I>
+  inline void copy_from(const soa_vec& o, std::index_sequence<I...>) {
+    ((o.size_ > 0 ? (void)std::memcpy(static_cast<void*>(std::get<I>(arrays_)), std::get<I>(o.arrays_),
+                                      o.size_ * sizeof(Fields))
+                  : void()),
+     ...);
+  }
+  template <size_t... I>
+  [[nodiscard]] inline std::tuple<Fields&...> row(uint_32_cx i, std::index_sequence<I...>) const noexcept {
+    return std::tuple<Fields&...>(std::get<I>(arrays_)[i]...);
+  }
+  template <size_t... I, typename... Args>
+  inline void write(uint_32_cx i, std::index_sequence<I...>, Args&&... values) noexcept {
+    ((std::get<I>(arrays_)[i] = std::forward<Args>(values)), ...);
+  }
+  template <typename T, size_t... I>
+  inline void write_field(uint_32_cx i, size_t field, T value, std::index_sequence<I...>) noexcept {
+    ((field == I ? (void)(std::get<I>(arrays_)[i] = static_cast<Fields>(value)) : void()), ...);
+  }
+  template <size_t... I>
+  inline void move_down(uint_32_cx i, std::index_sequence<I...>) noexcept {
+    ((std::memmove(static_cast<void*>(std::get<I>(arrays_) + i), std::get<I>(arrays_) + i + 1,
+                   (size_ - i - 1) * sizeof(Fields))),
+     ...);
+  }
+
+ public:
+  using Row = std::tuple<Fields&...>;
+  using value_type = std::tuple<Fields...>;
+  template <size_t I>
+  using field_type = std::tuple_element_t<I, std::tuple<Fields...>>;
+  static constexpr size_t field_count = sizeof...(Fields);
+
+  inline explicit soa_vec(uint_32_cx capacity = 0) {
+    if (capacity > 0) {
+      reallocate(capacity, Indices{});
+    }
+  }
+  inline soa_vec(const soa_vec& o) : size_(0), len_(0) {
+    if (o.size_ > 0) {
+      reallocate(o.size_, Indices{});
+      copy_from(o, Indices{});
+      size_ = o.size_;
+    }
+  }
+  inline soa_vec& operator=(const soa_vec& o) {
+    if (this != &o) {
+      size_ = 0;
+      if (len_ < o.size_) {
+        reallocate(o.size_, Indices{});
+      }
+      copy_from(o, Indices{});
+      size_ = o.size_;
+    }
+    return *this;
+  }
+  inline soa_vec(soa_vec&& o) noexcept : arrays_(o.arrays_), size_(o.size_), len_(o.len_) {
+    o.arrays_ = {};
+    o.size_ = 0;
+    o.len_ = 0;
+  }
+  inline soa_vec& operator=(soa_vec&& o) noexcept {
+    if (this != &o) {
+      release(Indices{});
+      arrays_ = o.arrays_;
+      size_ = o.size_;
+      len_ = o.len_;
+      o.arrays_ = {};
+      o.size_ = 0;
+      o.len_ = 0;
+    }
+    return *this;
+  }
+  inline ~soa_vec() { release(Indices{}); }
+  /**
+   * @return tuple of references to the fields of row i
+   */
+  [[nodiscard]] inline Row operator[](uint_32_cx i) const noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    return row(i, Indices{});
+  }
+  /**
+   * @return reference to field I of row i
+   */
+  template <size_t I>
+  [[nodiscard]] inline field_type<I>& get(uint_32_cx i) const noexcept {
+    CX_ASSERT(i < size_, "index out of bounds");
+    return std::get<I>(arrays_)[i];
+  }
+  /**
+   * @return all values of field I as one contiguous span
+   */
+  template <size_t I>
+  [[nodiscard]] inline std::span<field_type<I>> get() const noexcept {
+    return {std::get<I>(arrays_), size_};
+  }
+  /**
+   * @return the aligned array of field I
+   */
+  template <size_t I>
+  [[nodiscard]] inline field_type<I>* data() const noexcept {
+    return std::get<I>(arrays_);
+  }
+  /**
+   * Appends a row
+   * @param values one value per field
+   */
+  template <typename... Args>
+    requires(sizeof...(Args) == sizeof...(Fields))
+  inline void push_back(Args&&... values) {
+    if (size_ == len_) [[unlikely]] {
+      reallocate(len_ < 8 ? 16 : len_ * 2, Indices{});
+    }
+    write(size_++, Indices{}, std::forward<Args>(values)...);
+  }
+  template <typename... Args>
+  inline void emplace_back(Args&&... values) {
+    push_back(std::forward<Args>(values)...);
+  }
+  /**
+   * Appends a row given as tuple
+   */
+  inline void push_back(const value_type& values) {
+    std::apply([this](const Fields&... v) { push_back(v...); }, values);
+  }
+  /**
+   * Replaces the contents with the rows of a numeric CSV file - column i goes into field i.<p>
+   * The rows are counted first and written straight into the field arrays, in parallel with threads > 1.
+   * Fields of one shared type are parsed as that type, mixed fields as double and then converted.
+   * @param filePath the file to read
+   * @param delimiter the field separator
+   * @param header if true the first line is skipped
+   * @param threads number of chunks parsed in parallel on the global ThreadPool
+   * @return false if the file could not be read, the column count does not match the fields or a field is
+   * not a number - the contents are unspecified then
+   */
+  bool load_csv(const std::string& filePath, char delimiter = ',', bool header = false,
+                uint_32_cx threads = 1)
+    requires(std::is_arithmetic_v<Fields> && ...)
+  {
+    using First = std::tuple_element_t<0, std::tuple<Fields...>>;
+    using Parse = std::conditional_t<(std::is_same_v<First, Fields> && ...), First, double>;
+    CSVReader csv(filePath, delimiter, header, threads);
+    if (!csv.is_open() || (csv.rows() > 0 && csv.cols() != sizeof...(Fields))) {
+      return false;
+    }
+    clear();
+    reserve(static_cast<uint_32_cx>(csv.rows()));
+    size_ = static_cast<uint_32_cx>(csv.rows());
+    return csv.parse<Parse>([this](size_t row, size_t col, Parse value) {
+      write_field(static_cast<uint_32_cx>(row), col, value, Indices{});
+    });
+  }
+  inline void pop_back() noexcept {
+    CX_ASSERT(size_ > 0, "out of bounds");
+    size_--;
+  }
+  /**
+   * Removes the row at index i - O(n-i)
+   */
+  inline void pop(uint_32_cx i) noexcept {
+    CX_ASSERT(i < size_, "out of bounds");
+    move_down(i, Indices{});
+    size_--;
+  }
+  /**
+   * Removes the row at index i by moving the last row into its place - O(1) but changes the order
+   */
+  inline void swap_remove(uint_32_cx i) noexcept {
+    CX_ASSERT(i < size_, "out of bounds");
+    if (i != --size_) {
+      row(i, Indices{}) = row(size_, Indices{});
+    }
+  }
+  inline void reserve(uint_32_cx new_capacity) {
+    if (len_ < new_capacity) {
+      reallocate(new_capacity, Indices{});
+    }
+  }
+  /**
+   * Resizes the list to n rows, new rows are value initialized
+   */
+  inline void resize(uint_32_cx n) {
+    reserve(n);
+    for (uint_32_cx i = size_; i < n; i++) {
+      row(i, Indices{}) = value_type{};
+    }
+    size_ = n;
+  }
+  /**
+   * Removes all rows but keeps the capacity
+   */
+  inline void clear() noexcept { size_ = 0; }
+  [[nodiscard]] inline uint_32_cx size() const noexcept { return size_; }
+  [[nodiscard]] inline uint_32_cx capacity() const noexcept { return len_; }
+  [[nodiscard]] inline bool empty() const noexcept { return size_ == 0; }
+
+  /**
+   * Random access iterator over the rows, dereferencing gives a Row proxy
+   */
+  class Iterator {
+    const soa_vec* list_;
+    uint_32_cx i_;
+
+   public:
+    using value_type = soa_vec::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = Row;
+    using iterator_category = std::random_access_iterator_tag;
+
+    inline Iterator(const soa_vec* list, uint_32_cx i) noexcept : list_(list), i_(i) {}
+    inline reference operator*() const noexcept { return (*list_)[i_]; }
+    inline reference operator[](difference_type n) const noexcept { return (*list_)[i_ + n]; }
+    inline Iterator& operator++() noexcept {
+      ++i_;
+      return *this;
+    }
+    inline Iterator operator++(int) noexcept {
+      Iterator temp = *this;
+      ++i_;
+      return temp;
+    }
+    inline Iterator& operator--() noexcept {
+      --i_;
+      return *this;
+    }
+    inline Iterator operator--(int) noexcept {
+      Iterator temp = *this;
+      --i_;
+      return temp;
+    }
+    inline Iterator operator+(difference_type n) const noexcept { return {list_, static_cast<uint_32_cx>(i_ + n)}; }
+    inline Iterator operator-(difference_type n) const noexcept { return {list_, static_cast<uint_32_cx>(i_ - n)}; }
+    inline difference_type operator-(const Iterator& other) const noexcept {
+      return static_cast<difference_type>(i_) - static_cast<difference_type>(other.i_);
+    }
+    inline Iterator& operator+=(difference_type n) noexcept {
+      i_ += n;
+      return *this;
+    }
+    inline Iterator& operator-=(difference_type n) noexcept {
+      i_ -= n;
+      return *this;
+    }
+    inline bool operator==(const Iterator& other) const noexcept { return i_ == other.i_; }
+    inline bool operator!=(const Iterator& other) const noexcept { return i_ != other.i_; }
+    inline bool operator<(const Iterator& other) const noexcept { return i_ < other.i_; }
+  };
+  inline Iterator begin() const noexcept { return {this, 0}; }
+  inline Iterator end() const noexcept { return {this, size_}; }
+
+#ifndef CX_DELETE_TESTS
+  static void TEST() {
+    std::cout << "TESTING SOA VEC" << std::endl;
+
+    std::cout << "  Testing push_back and field spans..." << std::endl;
+    soa_vec<float, float, int> points;
+    for (int i = 0; i < 1000; i++) {
+      points.push_back(static_cast<float>(i), static_cast<float>(i) * 2, i % 7);
+    }
+    CX_ASSERT(points.size() == 1000, "");
+    CX_ASSERT(reinterpret_cast<uintptr_t>(points.data<0>()) % kSoaAlign == 0, "");
+    CX_ASSERT(reinterpret_cast<uintptr_t>(points.data<2>()) % kSoaAlign == 0, "");
+    std::span<float> xs = points.get<0>();
+    std::span<float> ys = points.get<1>();
+    float sum = 0;
+    for (size_t i = 0; i < xs.size(); i++) {
+      sum += ys[i] -  xs[i];
+    }
+    CX_ASSERT(sum == 999 * 1000 / 2, "");
+
+    std::cout << "  Testing row proxies..." << std::endl;
+    auto [x, y, id] = points[10];
+    CX_ASSERT(x == 10 && y == 20 && id == 3, "");
+    x = -1;  // writes through
+    CX_ASSERT(points.get<0>(10) == -1, "");
+    points[11] = std::tuple<float, float, int>(5, 6, 7);
+    CX_ASSERT(points.get<2>(11) == 7, "");
+    int count = 0;
+    for (auto [px, py, pid] : points) {
+      count += pid == 0;
+    }
+    CX_ASSERT(count == 143, "");
+    CX_ASSERT(points.end() - points.begin() == 1000, "");
+
+    std::cout << "  Testing removal and copies..." << std::endl;
+    points.pop(0);
+    CX_ASSERT(points.size() == 999 && points.get<0>(0) == 1, "");
+    points.swap_remove(0);
+    CX_ASSERT(points.size() == 998 && points.get<0>(0) == 999, "");
+    soa_vec<float, float, int> copy = points;
+    soa_vec<float, float, int> moved = std::move(points);
+    CX_ASSERT(points.empty() && moved.size() == 998 && copy.get<1>(0) == moved.get<1>(0), "");
+    copy.resize(1010);
+    CX_ASSERT(copy.get<0>(1009) == 0 && copy.get<2>(997) == moved.get<2>(997), "");
+    copy.clear();
+    copy.push_back(std::tuple<float, float, int>(1, 2, 3));
+    CX_ASSERT(copy.size() == 1 && copy.get<1>(0) == 2, "");
+
+    std::cout << "  Testing load_csv..." << std::endl;
+    const std::string path = "cxstructs_soa_test.csv";
+    {
+      std::ofstream out(path);
+      out << "x;y;id\n";
+      for (int i = 0; i < 50000; i++) {
+        out << i * 0.5F << "; " << -i << ";" << i * 3 << "\n";
+      }
+    }
+    soa_vec<float, float, int> loaded;
+    CX_ASSERT(loaded.load_csv(path, ';', true, 4), "");
+    CX_ASSERT(loaded.size() == 50000, "");
+    for (uint_32_cx i = 0; i < loaded.size(); i++) {
+      CX_ASSERT(loaded.get<0>(i) == i * 0.5F && loaded.get<1>(i) == -(float)i, "");
+      CX_ASSERT(loaded.get<2>(i) == (int)i * 3, "");
+    }
+    soa_vec<float, float> wrong_columns;
+    CX_ASSERT(!wrong_columns.load_csv(path, ';', true), "");
+    std::remove(path.c_str());
+  }
+#endif
+};
+}  // namespace cxstructs
+#endif  //CXSTRUCTS_SRC_CXSTRUCTS_SOAVEC_H_
@@ -0,0 +1,418 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXACTIVATION_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXACTIVATION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include "../cxconfig.h"
+
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include <vector>
+#endif
+
+// Activation functions - scalar and vectorised over spans
+// The span versions use a polynomial exp (Cephes, ~2 ulp) and run 8 wide with AVX2, 4 wide with SSE2,
+// the scalar tail runs the same polynomial
+
+namespace cxstructs {
+//function pointer typedef
+typedef float (*func)(float);
+typedef void (*func_span)(std::span<float>);
+
+//activation functions
+inline float sig(float x) noexcept {
+  return 1.0F / (1.0F + std::exp(-x));
+}
+inline float tanh(float x) noexcept {
+  return std::tanh(x);
+}
+inline float relu(float x) noexcept {
+  return x > 0 ? x : 0;
+}
+inline float linear(float x) noexcept {
+  return x;
+}
+//derivatives
+inline float d_sig(float x) noexcept {
+  return sig(x) * (1 - sig(x));
+}
+inline float d_relu(float x) noexcept {
+  return x > 0 ? 1 : 0;
+}
+inline float d_tanh(float x) noexcept {
+  float t = std::tanh(x);
+  return 1 - t * t;
+}
+inline float d_linear(float /*x*/) noexcept {
+  return 1;
+}
+}  // namespace cxstructs
+
+namespace cxhelper {
+constexpr float kExpMax = 88.3762626647949F;
+constexpr float kExpMin = -87.3365447504F;  // smallest input with a normal float result
+constexpr float kLog2e = 1.44269504088896341F;
+constexpr float kLn2Hi = 0.693359375F;  // ln(2) split in two so n * kLn2Hi is exact
+constexpr float kLn2Lo = -2.12194440e-4F;
+constexpr float kExpP[] = {1.9875691500E-4F, 1.3981999507E-3F, 8.3334519073E-3F,
+                           4.1665795894E-2F, 1.6666665459E-1F, 5.0000001201E-1F};
+constexpr float kTanhMax = 9.0F;  // tanh(9) rounds to 1 in float
+
+// thin wrappers so every kernel is written once for float, __m128 (SSE2) and __m256 (AVX2)
+template <typename V>
+inline V v_set(float c) noexcept {
+  return c;
+}
+template <typename V>
+inline V v_load(const float* p) noexcept {
+  return *p;
+}
+inline void v_store(float* p, float v) noexcept { *p = v; }
+inline float v_add(float a, float b) noexcept { return a + b; }
+inline float v_sub(float a, float b) noexcept { return a - b; }
+inline float v_mul(float a, float b) noexcept { return a * b; }
+inline float v_div(float a, float b) noexcept { return a / b; }
+inline float v_min(float a, float b) noexcept { return a < b ? a : b; }
+inline float v_max(float a, float b) noexcept { return a > b ? a : b; }
+inline float v_fmadd(float a, float b, float c) noexcept { return a * b + c; }
+inline float v_positive(float a) noexcept { return a > 0 ? 1.0F : 0.0F; }
+inline float v_floor(float a) noexcept {
+  const float t = static_cast<float>(static_cast<int32_t>(a));
+  return t > a ? t - 1.0F : t;
+}
+// 2^n for an integral valued n
+inline float v_exp2(float n) noexcept {
+  const int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+  float result;
+  std::memcpy(&result, &bits, sizeof(float));
+  return result;
+}
+#if defined(CX_SSE2)
+template <>
+inline __m128 v_set<__m128>(float c) noexcept {
+  return _mm_set1_ps(c);
+}
+template <>
+inline __m128 v_load<__m128>(const float* p) noexcept {
+  return _mm_loadu_ps(p);
+}
+inline void v_store(float* p, __m128 v) noexcept { _mm_storeu_ps(p, v); }
+inline __m128 v_add(__m128 a, __m128 b) noexcept { return _mm_add_ps(a, b); }
+inline __m128 v_sub(__m128 a, __m128 b) noexcept { return _mm_sub_ps(a, b); }
+inline __m128 v_mul(__m128 a, __m128 b) noexcept { return _mm_mul_ps(a, b); }
+inline __m128 v_div(__m128 a, __m128 b) noexcept { return _mm_div_ps(a, b); }
+inline __m128 v_min(__m128 a, __m128 b) noexcept { return _mm_min_ps(a, b); }
+inline __m128 v_max(__m128 a, __m128 b) noexcept { return _mm_max_ps(a, b); }
+inline __m128 v_fmadd(__m128 a, __m128 b, __m128 c) noexcept {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+inline __m128 v_positive(__m128 a) noexcept {
+  return _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.0F));
+}
+inline __m128 v_floor(__m128 a) noexcept {  // truncate and correct negatives - roundps needs SSE4.1
+  const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0F)));
+}
+inline __m128 v_exp2(__m128 n) noexcept {
+  return _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+}
+#endif
+#if defined(CX_AVX2)
+template <>
+inline __m256 v_set<__m256>(float c) noexcept {
+  return _mm256_set1_ps(c);
+}
+template <>
+inline __m256 v_load<__m256>(const float* p) noexcept {
+  return _mm256_loadu_ps(p);
+}
+inline void v_store(float* p, __m256 v) noexcept { _mm256_storeu_ps(p, v); }
+inline __m256 v_add(__m256 a, __m256 b) noexcept { return _mm256_add_ps(a, b); }
+inline __m256 v_sub(__m256 a, __m256 b) noexcept { return _mm256_sub_ps(a, b); }
+inline __m256 v_mul(__m256 a, __m256 b) noexcept { return _mm256_mul_ps(a, b); }
+inline __m256 v_div(__m256 a, __m256 b) noexcept { return _mm256_div_ps(a, b); }
+inline __m256 v_min(__m256 a, __m256 b) noexcept { return _mm256_min_ps(a, b); }
+inline __m256 v_max(__m256 a, __m256 b) noexcept { return _mm256_max_ps(a, b); }
+inline __m256 v_fmadd(__m256 a, __m256 b, __m256 c) noexcept {
+#if defined(CX_FMA)
+  return _mm256_fmadd_ps(a, b, c);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+inline __m256 v_positive(__m256 a) noexcept {
+  return _mm256_and_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_set1_ps(1.0F));
+}
+inline __m256 v_floor(__m256 a) noexcept { return _mm256_floor_ps(a); }
+inline __m256 v_exp2(__m256 n) noexcept {
+  return _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+}
+#endif
+
+// e^x = 2^n * e^r with |r| <= ln(2) / 2 and e^r from a degree 5 polynomial
+template <typename V>
+inline V exp_approx(V x) noexcept {
+  x = v_min(v_max(x, v_set<V>(kExpMin)), v_set<V>(kExpMax));
+  const V n = v_floor(v_fmadd(x, v_set<V>(kLog2e), v_set<V>(0.5F)));
+  V r = v_sub(x, v_mul(n, v_set<V>(kLn2Hi)));
+  r = v_sub(r, v_mul(n, v_set<V>(kLn2Lo)));
+  V p = v_set<V>(kExpP[0]);
+  for (int i = 1; i < 6; i++) {
+    p = v_fmadd(p, r, v_set<V>(kExpP[i]));
+  }
+  const V y = v_add(v_fmadd(v_mul(p, r), r, r), v_set<V>(1.0F));
+  return v_mul(y, v_exp2(n));
+}
+template <typename V>
+inline V sig_approx(V x) noexcept {
+  const V one = v_set<V>(1.0F);
+  return v_div(one, v_add(one, exp_approx(v_sub(v_set<V>(0.0F), x))));
+}
+template <typename V>
+inline V tanh_approx(V x) noexcept {
+  const V one = v_set<V>(1.0F);
+  x = v_min(v_max(x, v_set<V>(-kTanhMax)), v_set<V>(kTanhMax));
+  const V e = exp_approx(v_add(x, x));
+  return v_div(v_sub(e, one), v_add(e, one));
+}
+// op on blocks of 8 (AVX2) and 4 (SSE2) floats, the rest one at a time
+template <typename Op>
+inline void span_apply(std::span<float> x, Op op) noexcept {
+  float* data = x.data();
+  const size_t n = x.size();
+  size_t i = 0;
+#if defined(CX_AVX2)
+  for (const size_t end = n / 8 * 8; i < end; i += 8) {
+    _mm256_storeu_ps(data + i, op(_mm256_loadu_ps(data + i)));
+  }
+#endif
+#if defined(CX_SSE2)
+  for (const size_t end = n / 4 * 4; i < end; i += 4) {
+    _mm_storeu_ps(data + i, op(_mm_loadu_ps(data + i)));
+  }
+#endif
+  for (; i < n; i++) {
+    data[i] = op(data[i]);
+  }
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+//activation functions - in place over a span
+inline void exp_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) { return cxhelper::exp_approx(v); });
+}
+inline void sig_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) { return cxhelper::sig_approx(v); });
+}
+inline void tanh_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) { return cxhelper::tanh_approx(v); });
+}
+inline void relu_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) {
+    return cxhelper::v_max(v, cxhelper::v_set<decltype(v)>(0.0F));
+  });
+}
+inline void linear_span(std::span<float>) noexcept {}
+//derivatives - in place over a span
+inline void d_sig_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) {
+    const auto s = cxhelper::sig_approx(v);
+    return cxhelper::v_mul(s, cxhelper::v_sub(cxhelper::v_set<decltype(v)>(1.0F), s));
+  });
+}
+inline void d_tanh_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) {
+    const auto t = cxhelper::tanh_approx(v);
+    return cxhelper::v_sub(cxhelper::v_set<decltype(v)>(1.0F), cxhelper::v_mul(t, t));
+  });
+}
+inline void d_relu_span(std::span<float> x) noexcept {
+  cxhelper::span_apply(x, [](auto v) { return cxhelper::v_positive(v); });
+}
+inline void d_linear_span(std::span<float> x) noexcept {
+  std::fill(x.begin(), x.end(), 1.0F);
+}
+/**
+ * Numerically stable softmax in place - the max is subtracted before exponentiating
+ */
+inline void softmax_span(std::span<float> x) noexcept {
+  if (x.empty()) return;
+  const float max = *std::max_element(x.begin(), x.end());
+  for (float& v : x) {
+    v -= max;
+  }
+  exp_span(x);
+  float sum = 0;
+  for (const float v : x) {
+    sum += v;
+  }
+  const float inv = 1.0F / sum;
+  for (float& v : x) {
+    v *= inv;
+  }
+}
+/**
+ * Fused softmax and cross entropy over one sample in a single numerically stable pass (log-sum-exp)
+ * @param logits turned into the softmax probabilities
+ * @param target the target distribution - usually one-hot
+ * @param grad the gradient with respect to the logits (probabilities - target) - may alias logits
+ * @return the cross entropy loss -sum(target * log(softmax(logits)))
+ */
+inline float softmax_cross_entropy(std::span<float> logits, std::span<const float> target,
+                                   std::span<float> grad) noexcept {
+  if (logits.empty()) return 0;
+  const float max = *std::max_element(logits.begin(), logits.end());
+  float loss = 0;
+  for (size_t i = 0; i < logits.size(); i++) {
+    logits[i] -= max;
+    loss -= target[i] * logits[i];
+  }
+  exp_span(logits);
+  float sum = 0, target_sum = 0;
+  for (size_t i = 0; i < logits.size(); i++) {
+    sum += logits[i];
+    target_sum += target[i];
+  }
+  const float inv = 1.0F / sum;
+  for (size_t i = 0; i < logits.size(); i++) {
+    logits[i] *= inv;
+    grad[i] = logits[i] - target[i];
+  }
+  return loss + target_sum * std::log(sum);
+}
+/**
+ * @return the span version of a built-in activation (or derivative) or nullptr for custom functions -
+ * always nullptr without SIMD as the polynomial only pays off when vectorised
+ */
+inline func_span span_activation(func f) noexcept {
+#if defined(CX_SSE2)
+  if (f == sig) return sig_span;
+  if (f == relu) return relu_span;
+  if (f == tanh) return tanh_span;
+  if (f == linear) return linear_span;
+  if (f == d_sig) return d_sig_span;
+  if (f == d_relu) return d_relu_span;
+  if (f == d_tanh) return d_tanh_span;
+  if (f == d_linear) return d_linear_span;
+#endif
+  return nullptr;
+}
+// compile-time activations (e.g. for StaticFNN) - apply() runs the span version over a fixed size array,
+// function is the matching scalar function of FNN
+struct Linear {
+  static constexpr func function = linear;
+  template <uint_32_cx N>
+  static void apply(float*) noexcept {}
+};
+struct ReLU {
+  static constexpr func function = relu;
+  template <uint_32_cx N>
+  static void apply(float* x) noexcept {
+    relu_span({x, N});
+  }
+};
+struct Sigmoid {
+  static constexpr func function = sig;
+  template <uint_32_cx N>
+  static void apply(float* x) noexcept {
+    sig_span({x, N});
+  }
+};
+struct Tanh {
+  static constexpr func function = cxstructs::tanh;
+  template <uint_32_cx N>
+  static void apply(float* x) noexcept {
+    tanh_span({x, N});
+  }
+};
+}  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+namespace cxtests {  // namespace to avoid name clashes
+using namespace cxstructs;
+
+static void TEST_ACTIVATIONS() {
+  std::cout << "TESTING ACTIVATIONS" << std::endl;
+
+  std::cout << "  Testing span versions against the scalar functions..." << std::endl;
+  // 203 values so the scalar tail after the blocks of 8 is covered
+  std::vector<float> input;
+  for (int i = 0; i < 203; i++) {
+    input.push_back(-30.0F + static_cast<float>(i) * 0.3F);
+  }
+  input.push_back(-200.0F);
+  input.push_back(200.0F);
+  const std::pair<func, func_span> pairs[] = {
+      {sig, sig_span},       {cxstructs::tanh, tanh_span}, {relu, relu_span},
+      {linear, linear_span}, {d_sig, d_sig_span},          {d_tanh, d_tanh_span},
+      {d_relu, d_relu_span}, {d_linear, d_linear_span}};
+  for (const auto& [f, span_f] : pairs) {
+#if defined(CX_SSE2)
+    CX_ASSERT(span_activation(f) == span_f, "");
+#endif
+    std::vector<float> values = input;
+    span_f(values);
+    for (size_t i = 0; i < input.size(); i++) {
+      CX_ASSERT(std::abs(values[i] - f(input[i])) < 2e-6F, "");
+    }
+  }
+  CX_ASSERT(span_activation([](float x) { return x * 2; }) == nullptr, "");
+  std::vector<float> exps = {-87.0F, -10.0F, -1.0F, 0.0F, 0.5F, 1.0F, 10.0F, 40.0F, 88.0F};
+  for (int i = 0; i < 7; i++) {
+    exps.push_back(0.123F * static_cast<float>(i));
+  }
+  std::vector<float> expected = exps;
+  exp_span(exps);
+  for (size_t i = 0; i < exps.size(); i++) {
+    const float exact = std::exp(expected[i]);
+    CX_ASSERT(std::abs(exps[i] - exact) <= 3e-7F * exact, "");
+  }
+
+  std::cout << "  Testing stable softmax cross entropy..." << std::endl;
+  float logits[] = {1000.0F, 1001.0F, 1002.0F};
+  const float target[] = {0.0F, 0.0F, 1.0F};
+  float grad[3];
+  const float loss = softmax_cross_entropy(logits, target, grad);
+  const float expected_p = 1.0F / (1.0F + std::exp(-1.0F) + std::exp(-2.0F));
+  CX_ASSERT(std::abs(loss + std::log(expected_p)) < 1e-5F, "");
+  CX_ASSERT(std::abs(logits[2] - expected_p) < 1e-6F && std::abs(grad[2] - (expected_p - 1)) < 1e-6F,
+            "");
+  CX_ASSERT(std::abs(logits[0] + logits[1] + logits[2] - 1) < 1e-6F, "");
+  float same[] = {-5.0F, 5.0F};
+  const float one_hot[] = {0.0F, 1.0F};
+  const float small_loss = softmax_cross_entropy(same, one_hot, same);  // grad aliasing the logits
+  CX_ASSERT(small_loss > 0 && small_loss < 1e-4F && std::abs(same[1]) < 1e-4F, "");
+  float row[] = {3.0F, 3.0F, 3.0F, 3.0F};
+  softmax_span(row);
+  CX_ASSERT(std::abs(row[0] - 0.25F) < 1e-7F && std::abs(row[3] - 0.25F) < 1e-7F, "");
+}
+}  // namespace cxtests
+#endif
+#endif  //CXSTRUCTS_SRC_CXUTIL_CXACTIVATION_H_
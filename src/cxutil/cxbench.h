@@ -0,0 +1,804 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXBENCH_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXBENCH_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "cxtime.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Benchmark harness: registered benchmarks run with warm-up and repeated samples, the report shows
+// median, percentiles and stddev per benchmark and argument and can be written as JSON or CSV
+// Percentiles come from a LatencyHistogram - of the per sample times and, if the body records them with
+// state.record_latency(), of single operations (p50/p99/p99.9 per operation)
+// Next to the time it counts heap allocations (with CX_BENCH_COUNT_ALLOCATIONS()), cache and branch misses
+// (Linux perf_event, where permitted) and the peak resident memory of the process
+//
+// A benchmark is a function taking a BenchState, only the keep_running() loop is timed:
+//
+// static void bench_push(cxstructs::BenchState& state) {
+//   std::vector<int> setup(state.arg());           // not timed
+//   while (state.keep_running()) {
+//     cxstructs::do_not_optimize(setup.data());     // timed, state.iterations() times
+//   }
+// }
+// CX_BENCHMARK(bench_push, 1000, 100000);
+// int main(int argc, char** argv) { return cxstructs::Benchmarks::main(argc, argv); }
+
+namespace cxhelper {
+#ifdef _MSC_VER
+inline volatile const void* bench_sink = nullptr;
+#endif
+inline void* bench_aligned_alloc(size_t alignment, size_t size) noexcept {
+#ifdef _MSC_VER
+  return _aligned_malloc(size ? size : 1, alignment);
+#else
+  // aligned_alloc wants a multiple of the alignment
+  return std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+#endif
+}
+inline void bench_aligned_free(void* ptr) noexcept {
+#ifdef _MSC_VER
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+// peak resident set size of the process in KiB, 0 where unknown
+inline uint64_t peak_rss_kb() noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss) / 1024;  // bytes on macOS
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#else
+  return 0;
+#endif
+}
+inline std::string json_escape(const std::string& s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+
+/**
+ * Makes the compiler assume value is read, so the computation producing it cannot be removed
+ */
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  cxhelper::bench_sink = &value;
+  _ReadWriteBarrier();
+#endif
+}
+/**
+ * Makes the compiler assume value is read and modified, so it cannot be kept in a register or folded
+ */
+template <typename T>
+inline void do_not_optimize(T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : "+m"(value) : : "memory");
+#else
+  cxhelper::bench_sink = &value;
+  _ReadWriteBarrier();
+#endif
+}
+/**
+ * Forces all pending writes to memory - stores before this cannot be dropped as dead
+ */
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#else
+  _ReadWriteBarrier();
+#endif
+}
+
+/**
+ * Process wide heap allocation counters - only counted in an executable that uses
+ * CX_BENCH_COUNT_ALLOCATIONS() in one source file
+ */
+struct BenchAllocations {
+  static inline std::atomic<uint64_t> count{0};
+  static inline std::atomic<uint64_t> bytes{0};
+  static inline bool enabled = false;
+
+  static inline void record(size_t size) noexcept {
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * <h2>PerfCounters</h2>
+ * Hardware cache-miss and branch-miss counters of the calling thread through perf_event_open().
+ * <br><br>
+ * Only on Linux, and only if perf_event_paranoid allows user space counting - available() tells.
+ * Elsewhere all methods do nothing.
+ */
+class PerfCounters {
+  static constexpr int kCounters = 2;
+  int fds_[kCounters] = {-1, -1};
+
+#if defined(__linux__)
+  static int open_counter(uint64_t config) noexcept {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+  void control(unsigned long request) const noexcept {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, request, 0);
+      }
+    }
+  }
+#endif
+
+ public:
+  enum Counter { CACHE_MISSES, BRANCH_MISSES };
+  PerfCounters() noexcept {
+#if defined(__linux__)
+    fds_[CACHE_MISSES] = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+    fds_[BRANCH_MISSES] = open_counter(PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+  }
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+  [[nodiscard]] inline bool available() const noexcept { return fds_[0] >= 0 && fds_[1] >= 0; }
+  inline void enable() const noexcept {
+#if defined(__linux__)
+    control(PERF_EVENT_IOC_ENABLE);
+#endif
+  }
+  inline void disable() const noexcept {
+#if defined(__linux__)
+    control(PERF_EVENT_IOC_DISABLE);
+#endif
+  }
+  inline void reset() const noexcept {
+#if defined(__linux__)
+    control(PERF_EVENT_IOC_RESET);
+#endif
+  }
+  /**
+   * @return the events counted while enabled since the last reset(), 0 if unavailable
+   */
+  [[nodiscard]] uint64_t read(Counter counter) const noexcept {
+    uint64_t value = 0;
+#if defined(__linux__)
+    if (fds_[counter] >= 0 && ::read(fds_[counter], &value, sizeof(value)) != sizeof(value)) {
+      value = 0;
+    }
+#endif
+    return value;
+  }
+};
+
+/**
+ * <h2>BenchState</h2>
+ * Passed to every benchmark run - times the keep_running() loop and carries the argument of the run.
+ */
+class BenchState {
+  using clock = std::chrono::steady_clock;
+  clock::time_point start_{};
+  clock::duration elapsed_{};
+  uint64_t arg_;
+  uint64_t iterations_;
+  uint64_t remaining_;
+  uint64_t items_ = 0;
+  uint64_t allocations_ = 0;
+  uint64_t allocations_start_ = 0;
+  const PerfCounters* perf_;
+  LatencyHistogram* latencies_;
+  bool started_ = false;
+  bool running_ = false;
+
+ public:
+  BenchState(uint64_t arg, uint64_t iterations, const PerfCounters* perf = nullptr,
+             LatencyHistogram* latencies = nullptr) noexcept
+      : arg_(arg), iterations_(iterations), remaining_(iterations), perf_(perf), latencies_(latencies) {}
+  /**
+   * The loop condition of a benchmark - starts the timer on the first call and stops it once
+   * iterations() runs are done
+   */
+  inline bool keep_running() noexcept {
+    if (!started_) [[unlikely]] {
+      started_ = true;
+      resume();
+    }
+    if (remaining_ > 0) [[likely]] {
+      remaining_--;
+      return true;
+    }
+    pause();
+    return false;
+  }
+  /**
+   * Stops the timer - for per iteration setup that should not be measured
+   */
+  inline void pause() noexcept {
+    if (running_) {
+      elapsed_ += clock::now() - start_;
+      if (perf_) {
+        perf_->disable();
+      }
+      allocations_ += BenchAllocations::count.load(std::memory_order_relaxed) - allocations_start_;
+      running_ = false;
+    }
+  }
+  inline void resume() noexcept {
+    if (!running_) {
+      allocations_start_ = BenchAllocations::count.load(std::memory_order_relaxed);
+      if (perf_) {
+        perf_->enable();
+      }
+      running_ = true;
+      start_ = clock::now();
+    }
+  }
+  /**
+   * Records the latency of a single operation - the report then shows its p50, p99 and p99.9.<br>
+   * Only kept for the measured samples, calibration and warm-up runs ignore it
+   * @param ns the duration in nanoseconds
+   */
+  inline void record_latency(uint64_t ns) noexcept {
+    if (latencies_) {
+      latencies_->record(ns);
+    }
+  }
+  /**
+   * Sets the total number of items processed by the run, the report then shows the throughput
+   */
+  inline void set_items_processed(uint64_t items) noexcept { items_ = items; }
+  /**
+   * @return the argument of this run, e.g. the number of elements
+   */
+  [[nodiscard]] inline uint64_t arg() const noexcept { return arg_; }
+  [[nodiscard]] inline uint64_t iterations() const noexcept { return iterations_; }
+  [[nodiscard]] inline uint64_t items_processed() const noexcept { return items_; }
+  /**
+   * @return heap allocations inside the timed region - 0 without CX_BENCH_COUNT_ALLOCATIONS()
+   */
+  [[nodiscard]] inline uint64_t allocations() const noexcept { return allocations_; }
+  [[nodiscard]] inline double elapsed_seconds() const noexcept {
+    return std::chrono::duration<double>(elapsed_).count();
+  }
+};
+
+/**
+ * Statistics of one benchmark and argument - all times are nanoseconds per iteration
+ */
+struct BenchResult {
+  std::string name;
+  uint64_t arg = 0;
+  uint64_t iterations = 0;  // per sample
+  uint32_t samples = 0;
+  double median = 0;
+  double mean = 0;
+  double stddev = 0;
+  double min = 0;
+  double max = 0;
+  double p5 = 0;
+  double p95 = 0;
+  double p99 = 0;
+  double items_per_second = 0;
+  // latency of single operations from BenchState::record_latency(), negative if none were recorded
+  double op_p50 = -1;
+  double op_p99 = -1;
+  double op_p999 = -1;
+  // per iteration over all samples, negative if not measured
+  double allocations = -1;
+  double cache_misses = -1;
+  double branch_misses = -1;
+  // peak resident memory of the whole process after this benchmark
+  uint64_t peak_rss_kb = 0;
+  // fastest median in the group divided by this median - 1.0 for the fastest
+  double relative = 1;
+
+  /**
+   * @return the part of the name before the last '/' - benchmarks of one group are compared
+   */
+  [[nodiscard]] std::string group() const { return name.substr(0, name.rfind('/')); }
+};
+
+/**
+ * Settings of a benchmark run, filled from the command line by Benchmarks::main()
+ */
+struct BenchConfig {
+  std::string filter;             // only run benchmarks whose name contains this
+  std::string json_path;          // write the results as JSON if not empty
+  std::string csv_path;           // write the results as CSV if not empty
+  uint32_t repetitions = 15;      // measured samples per benchmark and argument
+  uint32_t warmup = 2;            // discarded samples after calibration
+  double min_sample_time = 0.02;  // seconds a single sample has to run at least
+  bool print = true;
+};
+
+/**
+ * <h2>Benchmarks</h2>
+ * Registry and runner of the benchmarks.
+ * <br><br>
+ * Each benchmark is calibrated by growing its iteration count until one sample runs for at least
+ * min_sample_time. After warm-up samples it is measured repetitions times, the spread of these samples
+ * gives the percentiles and the standard deviation. Benchmarks named "group/variant" are compared within
+ * their group, the group may contain further '/' like "HashMap/uniform/std::unordered_map".
+ */
+class Benchmarks {
+  struct Entry {
+    std::string name;
+    std::function<void(BenchState&)> func;
+    std::vector<uint64_t> args;
+  };
+  static std::vector<Entry>& registry() {
+    static std::vector<Entry> entries;
+    return entries;
+  }
+  static BenchState run_once(const std::function<void(BenchState&)>& func, uint64_t arg,
+                             uint64_t iterations, const PerfCounters* perf = nullptr,
+                             LatencyHistogram* latencies = nullptr) {
+    BenchState state(arg, iterations, perf, latencies);
+    func(state);
+    return state;
+  }
+
+ public:
+  /**
+   * Registers a benchmark
+   * @param name unique name, "group/variant" to compare variants of one group
+   * @param func the benchmark body
+   * @param args one run per argument - an empty list runs once with argument 0
+   * @return true, so the call can initialize a static
+   */
+  static bool add(std::string name, std::function<void(BenchState&)> func,
+                  std::vector<uint64_t> args = {}) {
+    if (args.empty()) {
+      args.push_back(0);
+    }
+    registry().push_back({std::move(name), std::move(func), std::move(args)});
+    return true;
+  }
+  /**
+   * Calibrates and measures a single benchmark
+   */
+  static BenchResult measure(const std::string& name, const std::function<void(BenchState&)>& func,
+                             uint64_t arg, const BenchConfig& config = {}) {
+    uint64_t iterations = 1;
+    double elapsed = run_once(func, arg, iterations).elapsed_seconds();
+    while (elapsed < config.min_sample_time && iterations < (1ULL << 40)) {
+      const double factor = elapsed > 0 ? config.min_sample_time / elapsed * 1.2 : 10;
+      iterations = static_cast<uint64_t>(static_cast<double>(iterations) * std::clamp(factor, 2.0, 10.0));
+      elapsed = run_once(func, arg, iterations).elapsed_seconds();
+    }
+    for (uint32_t i = 0; i < config.warmup; i++) {
+      run_once(func, arg, iterations);
+    }
+
+    const PerfCounters perf;
+    perf.reset();
+    LatencyHistogram operations;
+    std::vector<double> samples;
+    double items_per_second = 0;
+    uint64_t allocations = 0;
+    for (uint32_t i = 0; i < std::max(config.repetitions, 1U); i++) {
+      const BenchState state =
+          run_once(func, arg, iterations, perf.available() ? &perf : nullptr, &operations);
+      const double seconds = state.elapsed_seconds();
+      samples.push_back(seconds * 1e9 / static_cast<double>(iterations));
+      if (seconds > 0) {
+        items_per_second += static_cast<double>(state.items_processed()) / seconds;
+      }
+      allocations += state.allocations();
+    }
+    const double total_iterations = static_cast<double>(iterations) * static_cast<double>(samples.size());
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = name;
+    result.arg = arg;
+    result.iterations = iterations;
+    result.samples = static_cast<uint32_t>(samples.size());
+    result.min = samples.front();
+    result.max = samples.back();
+    // sample percentiles with picosecond resolution, a bucket is at most 0.8% wide
+    LatencyHistogram sample_hist;
+    for (double s : samples) {
+      sample_hist.record(static_cast<uint64_t>(std::llround(s * 1000.0)));
+    }
+    const auto ps = sample_hist.percentiles({50, 5, 95, 99});
+    double* targets[] = {&result.median, &result.p5, &result.p95, &result.p99};
+    for (size_t i = 0; i < ps.size(); i++) {
+      *targets[i] = std::clamp(static_cast<double>(ps[i]) / 1000.0, result.min, result.max);
+    }
+    if (!operations.empty()) {
+      const auto ops = operations.percentiles({50, 99, 99.9});
+      result.op_p50 = static_cast<double>(ops[0]);
+      result.op_p99 = static_cast<double>(ops[1]);
+      result.op_p999 = static_cast<double>(ops[2]);
+    }
+    for (double s : samples) {
+      result.mean += s;
+    }
+    result.mean /= static_cast<double>(samples.size());
+    for (double s : samples) {
+      result.stddev += (s - result.mean) * (s - result.mean);
+    }
+    result.stddev = samples.size() > 1 ? std::sqrt(result.stddev / static_cast<double>(samples.size() - 1)) : 0;
+    result.items_per_second = items_per_second / static_cast<double>(samples.size());
+    if (BenchAllocations::enabled) {
+      result.allocations = static_cast<double>(allocations) / total_iterations;
+    }
+    if (perf.available()) {
+      result.cache_misses = static_cast<double>(perf.read(PerfCounters::CACHE_MISSES)) / total_iterations;
+      result.branch_misses = static_cast<double>(perf.read(PerfCounters::BRANCH_MISSES)) / total_iterations;
+    }
+    result.peak_rss_kb = cxhelper::peak_rss_kb();
+    return result;
+  }
+  /**
+   * Runs all registered benchmarks matching the filter of the config
+   * @return one result per benchmark and argument, relative speeds filled in per group and argument
+   */
+  static std::vector<BenchResult> run(const BenchConfig& config = {}) {
+    std::vector<BenchResult> results;
+    for (const Entry& entry : registry()) {
+      if (!config.filter.empty() && entry.name.find(config.filter) == std::string::npos) {
+        continue;
+      }
+      for (uint64_t arg : entry.args) {
+        results.push_back(measure(entry.name, entry.func, arg, config));
+        if (config.print) {
+          std::cout << "  " << entry.name << "/" << arg << std::endl;
+        }
+      }
+    }
+    std::map<std::pair<std::string, uint64_t>, double> fastest;
+    for (const BenchResult& r : results) {
+      auto [it, inserted] = fastest.emplace(std::make_pair(r.group(), r.arg), r.median);
+      if (!inserted) {
+        it->second = std::min(it->second, r.median);
+      }
+    }
+    for (BenchResult& r : results) {
+      r.relative = r.median > 0 ? fastest[{r.group(), r.arg}] / r.median : 1;
+    }
+    return results;
+  }
+  /**
+   * Prints the results as a table
+   */
+  static void print(const std::vector<BenchResult>& results, std::ostream& out = std::cout) {
+    size_t width = 16;
+    for (const BenchResult& r : results) {
+      width = std::max(width, r.name.size() + std::to_string(r.arg).size() + 3);
+    }
+    // counters that were not measured show as n/a
+    auto optional = [&out](double value, int precision) {
+      if (value < 0) {
+        out << std::setw(12) << "n/a";
+      } else {
+        out << std::setw(12) << std::setprecision(precision) << value;
+      }
+    };
+    out << std::left << std::setw(static_cast<int>(width)) << "benchmark/arg" << std::right
+        << std::setw(14) << "median ns" << std::setw(14) << "p5 ns" << std::setw(14) << "p95 ns"
+        << std::setw(14) << "p99 ns"
+        << std::setw(9) << "stddev" << std::setw(10) << "relative" << std::setw(12) << "allocs/it"
+        << std::setw(12) << "cache-m/it" << std::setw(12) << "branch-m/it" << std::setw(12) << "peak MiB"
+        << "\n";
+    for (const BenchResult& r : results) {
+      out << std::left << std::setw(static_cast<int>(width)) << (r.name + "/" + std::to_string(r.arg))
+          << std::right << std::fixed << std::setprecision(1) << std::setw(14) << r.median
+          << std::setw(14) << r.p5 << std::setw(14) << r.p95 << std::setw(14) << r.p99 << std::setw(8)
+          << (r.mean > 0 ? r.stddev / r.mean * 100 : 0) << "%" << std::setprecision(2)
+          << std::setw(10) << r.relative;
+      optional(r.allocations, 2);
+      optional(r.cache_misses, 1);
+      optional(r.branch_misses, 1);
+      out << std::setw(12) << std::setprecision(1) << static_cast<double>(r.peak_rss_kb) / 1024.0 << "\n";
+    }
+    // single operation latencies, only for benchmarks that recorded them
+    bool operations = false;
+    for (const BenchResult& r : results) {
+      operations |= r.op_p50 >= 0;
+    }
+    if (operations) {
+      out << "\n" << std::left << std::setw(static_cast<int>(width)) << "operation latency" << std::right
+          << std::setw(14) << "p50 ns" << std::setw(14) << "p99 ns" << std::setw(14) << "p99.9 ns" << "\n";
+      for (const BenchResult& r : results) {
+        if (r.op_p50 < 0) {
+          continue;
+        }
+        out << std::left << std::setw(static_cast<int>(width)) << (r.name + "/" + std::to_string(r.arg))
+            << std::right << std::setprecision(0) << std::setw(14) << r.op_p50 << std::setw(14) << r.op_p99
+            << std::setw(14) << r.op_p999 << "\n";
+      }
+    }
+    out << std::defaultfloat;
+  }
+  static void write_json(const std::vector<BenchResult>& results, std::ostream& out) {
+    out << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+      const BenchResult& r = results[i];
+      out << (i ? ",\n" : "\n") << "    {\"name\": \"" << cxhelper::json_escape(r.name)
+          << "\", \"arg\": " << r.arg << ", \"iterations\": " << r.iterations
+          << ", \"samples\": " << r.samples << std::setprecision(10) << ", \"median_ns\": " << r.median
+          << ", \"mean_ns\": " << r.mean << ", \"stddev_ns\": " << r.stddev << ", \"min_ns\": " << r.min
+          << ", \"max_ns\": " << r.max << ", \"p5_ns\": " << r.p5 << ", \"p95_ns\": " << r.p95
+          << ", \"p99_ns\": " << r.p99          << ", \"items_per_second\": " << r.items_per_second << ", \"relative\": " << r.relative;
+      // unmeasured counters are null
+      auto optional = [&out](const char* key, double value) {
+        out << ", \"" << key << "\": ";
+        if (value < 0) {
+          out << "null";
+        } else {
+          out << value;
+        }
+      };
+      optional("allocations_per_iteration", r.allocations);
+      optional("cache_misses_per_iteration", r.cache_misses);
+      optional("branch_misses_per_iteration", r.branch_misses);
+      optional("op_p50_ns", r.op_p50);
+      optional("op_p99_ns", r.op_p99);
+      optional("op_p999_ns", r.op_p999);
+      out << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+    }
+    out << "\n  ]\n}\n";
+  }
+  static void write_csv(const std::vector<BenchResult>& results, std::ostream& out) {
+    out << "name,arg,iterations,samples,median_ns,mean_ns,stddev_ns,min_ns,max_ns,p5_ns,p95_ns,"
+           "p99_ns,items_per_second,relative,allocations_per_iteration,cache_misses_per_iteration,"
+           "branch_misses_per_iteration,op_p50_ns,op_p99_ns,op_p999_ns,peak_rss_kb\n";
+    out << std::setprecision(10);
+    for (const BenchResult& r : results) {
+      out << r.name << "," << r.arg << "," << r.iterations << "," << r.samples << "," << r.median
+          << "," << r.mean << "," << r.stddev << "," << r.min << "," << r.max << "," << r.p5 << ","
+          << r.p95 << "," << r.p99 << "," << r.items_per_second << "," << r.relative << ",";
+      // unmeasured counters stay empty
+      for (double value :
+           {r.allocations, r.cache_misses, r.branch_misses, r.op_p50, r.op_p99, r.op_p999}) {
+        if (value >= 0) {
+          out << value;
+        }
+        out << ",";
+      }
+      out << r.peak_rss_kb << "\n";
+    }
+  }
+  /**
+   * Parses the command line, runs the registered benchmarks, prints and writes the results<p>
+   * Options: --filter=NAME --repetitions=N --warmup=N --min-time=SECONDS --json=PATH --csv=PATH
+   * @return the exit code for main()
+   */
+  static int main(int argc, char** argv) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      const auto eq = arg.find('=');
+      const std::string key = arg.substr(0, eq);
+      const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+      if (key == "--filter") {
+        config.filter = value;
+      } else if (key == "--repetitions") {
+        config.repetitions = static_cast<uint32_t>(std::stoul(value));
+      } else if (key == "--warmup") {
+        config.warmup = static_cast<uint32_t>(std::stoul(value));
+      } else if (key == "--min-time") {
+        config.min_sample_time = std::stod(value);
+      } else if (key == "--json") {
+        config.json_path = value;
+      } else if (key == "--csv") {
+        config.csv_path = value;
+      } else {
+        std::cerr << "Unknown option: " << arg << "\n"
+                  << "Options: --filter=NAME --repetitions=N --warmup=N --min-time=SECONDS "
+                     "--json=PATH --csv=PATH"
+                  << std::endl;
+        return 1;
+      }
+    }
+    const std::vector<BenchResult> results = run(config);
+    print(results);
+    if (!config.json_path.empty()) {
+      std::ofstream out(config.json_path);
+      write_json(results, out);
+    }
+    if (!config.csv_path.empty()) {
+      std::ofstream out(config.csv_path);
+      write_csv(results, out);
+    }
+    return 0;
+  }
+};
+
+}  // namespace cxstructs
+
+/**
+ * Registers a benchmark function under its own name - the optional arguments are the values of
+ * BenchState::arg(), one run each
+ */
+#define CX_BENCHMARK(func, ...)                                \
+  [[maybe_unused]] static const bool cx_benchmark_##func = \
+      cxstructs::Benchmarks::add(#func, func, {__VA_ARGS__})
+
+/**
+ * Replaces the global operator new and delete with counting versions so benchmarks report their heap
+ * allocations - use in exactly one source file of a benchmark executable
+ */
+#define CX_BENCH_COUNT_ALLOCATIONS()                                                                \
+  [[maybe_unused]] static const bool cx_bench_allocations_enabled =                                 \
+      (cxstructs::BenchAllocations::enabled = true);                                                \
+  void* operator new(std::size_t size) {                                                            \
+    cxstructs::BenchAllocations::record(size);                                                      \
+    if (void* ptr = std::malloc(size ? size : 1)) {                                                 \
+      return ptr;                                                                                   \
+    }                                                                                               \
+    throw std::bad_alloc();                                                                         \
+  }                                                                                                 \
+  void* operator new(std::size_t size, std::align_val_t align) {                                    \
+    cxstructs::BenchAllocations::record(size);                                                      \
+    const auto alignment = static_cast<std::size_t>(align);                                         \
+    if (void* ptr = cxhelper::bench_aligned_alloc(alignment, size)) {                               \
+      return ptr;                                                                                   \
+    }                                                                                               \
+    throw std::bad_alloc();                                                                         \
+  }                                                                                                 \
+  void operator delete(void* ptr) noexcept { std::free(ptr); }                                      \
+  void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }                         \
+  void operator delete(void* ptr, std::align_val_t) noexcept { cxhelper::bench_aligned_free(ptr); } \
+  void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {                         \
+    cxhelper::bench_aligned_free(ptr);                                                              \
+  }
+
+#ifndef CX_DELETE_TESTS
+namespace cxtests {
+using namespace cxstructs;
+static void TEST_BENCH() {
+  std::cout << "TESTING BENCH" << std::endl;
+
+  std::cout << "  Testing BenchState..." << std::endl;
+  BenchState state(7, 100);
+  uint64_t runs = 0;
+  while (state.keep_running()) {
+    runs++;
+    do_not_optimize(runs);
+  }
+  CX_ASSERT(runs == 100 && state.arg() == 7 && state.elapsed_seconds() >= 0, "");
+  BenchState counting(0, 10);
+  while (counting.keep_running()) {
+    BenchAllocations::record(16);
+  }
+  BenchAllocations::record(16);  // outside of the timed loop
+  CX_ASSERT(counting.allocations() == 10, "");
+
+  std::cout << "  Testing measure..." << std::endl;
+  BenchConfig config;
+  config.repetitions = 5;
+  config.warmup = 1;
+  config.min_sample_time = 0.001;
+  const BenchResult result = Benchmarks::measure(
+      "sum",
+      [](BenchState& s) {
+        std::vector<int> values(s.arg(), 1);
+        while (s.keep_running()) {
+          int sum = 0;
+          for (int v : values) {
+            sum += v;
+          }
+          do_not_optimize(sum);
+        }
+        s.set_items_processed(s.iterations() * s.arg());
+      },
+      1000, config);
+  CX_ASSERT(result.samples == 5 && result.arg == 1000, "");
+  CX_ASSERT(result.min <= result.p5 && result.p5 <= result.median && result.median <= result.p95, "");
+  CX_ASSERT(result.p95 <= result.p99 && result.p99 <= result.max, "");
+  CX_ASSERT(result.median > 0 && result.items_per_second > 0 && result.op_p50 < 0, "");
+  CX_ASSERT(result.iterations * result.median >= 0.5e6, "calibration reaches the sample time");
+  CX_ASSERT(BenchAllocations::enabled || result.allocations < 0, "");
+  CX_ASSERT(PerfCounters().available() == (result.cache_misses >= 0), "");
+
+  std::cout << "  Testing operation latencies..." << std::endl;
+  const BenchResult ops = Benchmarks::measure(
+      "ops",
+      [](BenchState& s) {
+        uint64_t i = 0;
+        while (s.keep_running()) {
+          s.record_latency(++i % 100 == 0 ? 5000 : 100);
+        }
+      },
+      0, config);
+  CX_ASSERT(ops.op_p50 >= 99 && ops.op_p50 <= 101, "");
+  CX_ASSERT(ops.op_p999 >= 4960 && ops.op_p999 <= 5040 && ops.op_p50 <= ops.op_p99, "");
+
+  std::cout << "  Testing output..." << std::endl;
+  std::ostringstream json;
+  std::ostringstream csv;
+  std::ostringstream table;
+  Benchmarks::write_json({result, ops}, json);
+  Benchmarks::write_csv({result, ops}, csv);
+  Benchmarks::print({result, ops}, table);
+  CX_ASSERT(json.str().find("\"name\": \"sum\"") != std::string::npos, "");
+  CX_ASSERT(csv.str().find("\nsum,1000,") != std::string::npos, "");
+  CX_ASSERT(json.str().find("\"peak_rss_kb\"") != std::string::npos, "");
+  CX_ASSERT(json.str().find("\"op_p50_ns\": null") != std::string::npos, "");
+  CX_ASSERT(table.str().find("operation latency") != std::string::npos, "");
+}
+}  // namespace cxtests
+#endif
+#endif  //CXSTRUCTS_SRC_CXUTIL_CXBENCH_H_
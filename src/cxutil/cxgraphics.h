@@ -21,31 +21,286 @@
 #ifndef CXSTRUCTS_SRC_CXUTIL_CXGRAPHICS_H_
 #define CXSTRUCTS_SRC_CXUTIL_CXGRAPHICS_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
 #include "../cxconfig.h"
+#include "../cxstructs/FlatQuadTree.h"
 #include "../cxstructs/Geometry.h"
 #include "../cxstructs/QuadTree.h"
 
+namespace cxstructs {
+/**
+ * Maps world coordinates to pixels - pixel = world * scale + offset
+ */
+struct CanvasView {
+  float scale_x = 1, scale_y = 1;
+  float offset_x = 0, offset_y = 0;
+  /**
+   * Fits the world rectangle into the pixel rectangle (x, y, width, height)
+   * @param flip_y if true the world y axis points upwards
+   */
+  static CanvasView fit(const Rect& world, int x, int y, int width, int height, bool flip_y = false) {
+    CanvasView view;
+    view.scale_x = world.width() > 0 ? static_cast<float>(width) / world.width() : 1;
+    view.scale_y = world.height() > 0 ? static_cast<float>(height) / world.height() : 1;
+    view.offset_x = static_cast<float>(x) - world.x() * view.scale_x;
+    if (flip_y) {
+      view.scale_y = -view.scale_y;
+      view.offset_y = static_cast<float>(y + height) - world.y() * view.scale_y;
+    } else {
+      view.offset_y = static_cast<float>(y) - world.y() * view.scale_y;
+    }
+    return view;
+  }
+  [[nodiscard]] inline float x(float world_x) const noexcept { return world_x * scale_x + offset_x; }
+  [[nodiscard]] inline float y(float world_y) const noexcept { return world_y * scale_y + offset_y; }
+};
+
+/**
+ * <h2>PixelCanvas</h2>
+ * is an off-screen 32 bit pixel buffer (0x00RRGGBB, rows top to bottom) that rasterizes everything itself.<p>
+ * Rectangles and points are written as horizontal spans straight into memory, so a frame of a million points
+ * costs a few milliseconds instead of one GDI call per primitive. The memory is either owned or attached,
+ * GraphicsWindow attaches the bits of its DIB section and blits the finished frame once.
+ * <br><br>
+ * Everything is clipped to the canvas, coordinates outside of it are allowed.
+ */
+class PixelCanvas {
+  uint32_t* pixels_ = nullptr;
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<uint32_t> owned_;
+
+  // the world rectangle in pixels as [x0, x1] x [y0, y1], clamped so the casts cant overflow
+  inline void to_pixels(const Rect& r, const CanvasView& view, int& x0, int& y0, int& x1, int& y1) const {
+    const auto clamp = [](float v, int size) {
+      return static_cast<int>(std::clamp(v, -1.0F, static_cast<float>(size)));
+    };
+    const float ax = view.x(r.x()), bx = view.x(r.x() + r.width());
+    const float ay = view.y(r.y()), by = view.y(r.y() + r.height());
+    x0 = clamp(std::min(ax, bx), width_);
+    x1 = clamp(std::max(ax, bx), width_);
+    y0 = clamp(std::min(ay, by), height_);
+    y1 = clamp(std::max(ay, by), height_);
+  }
+
+ public:
+  PixelCanvas() = default;
+  PixelCanvas(int width, int height)
+      : width_(std::max(width, 0)),
+        height_(std::max(height, 0)),
+        owned_(static_cast<size_t>(width_) * height_) {
+    pixels_ = owned_.data();
+  }
+  PixelCanvas(const PixelCanvas&) = delete;
+  PixelCanvas& operator=(const PixelCanvas&) = delete;
+  PixelCanvas(PixelCanvas&&) noexcept = default;
+  PixelCanvas& operator=(PixelCanvas&&) noexcept = default;
+  /**
+   * Draws into memory owned by someone else from now on, for example the bits of a DIB section
+   * @param pixels width * height pixels, rows top to bottom
+   */
+  inline void attach(uint32_t* pixels, int width, int height) noexcept {
+    owned_.clear();
+    owned_.shrink_to_fit();
+    pixels_ = pixels;
+    width_ = pixels ? width : 0;
+    height_ = pixels ? height : 0;
+  }
+  static constexpr uint32_t rgb(uint8_t r, uint8_t g, uint8_t b) noexcept {
+    return static_cast<uint32_t>(r) << 16 | static_cast<uint32_t>(g) << 8 | b;
+  }
+  [[nodiscard]] inline int width() const noexcept { return width_; }
+  [[nodiscard]] inline int height() const noexcept { return height_; }
+  [[nodiscard]] inline std::span<uint32_t> pixels() noexcept {
+    return {pixels_, static_cast<size_t>(width_) * height_};
+  }
+  [[nodiscard]] inline uint32_t at(int x, int y) const noexcept {
+    CX_ASSERT(x >= 0 && x < width_ && y >= 0 && y < height_, "pixel out of bounds");
+    return pixels_[static_cast<size_t>(y) * width_ + x];
+  }
+  inline void fill(uint32_t color) noexcept {
+    std::fill_n(pixels_, static_cast<size_t>(width_) * height_, color);
+  }
+  /**
+   * Fills the pixels [x, x + width) x [y, y + height) - one span per row
+   */
+  inline void fill_rect(int x, int y, int width, int height, uint32_t color) noexcept {
+    const int x0 = std::max(x, 0), x1 = std::min(x + width, width_);
+    const int y0 = std::max(y, 0), y1 = std::min(y + height, height_);
+    if (x0 >= x1) {
+      return;
+    }
+    for (int row = y0; row < y1; row++) {
+      std::fill(pixels_ + static_cast<size_t>(row) * width_ + x0, pixels_ + static_cast<size_t>(row) * width_ + x1,
+                color);
+    }
+  }
+  /**
+   * Draws the 1 pixel outline of [x, x + width) x [y, y + height)
+   */
+  inline void draw_rect(int x, int y, int width, int height, uint32_t color) noexcept {
+    if (width <= 0 || height <= 0) {
+      return;
+    }
+    fill_rect(x, y, width, 1, color);
+    fill_rect(x, y + height - 1, width, 1, color);
+    fill_rect(x, y + 1, 1, height - 2, color);
+    fill_rect(x + width - 1, y + 1, 1, height - 2, color);
+  }
+  /**
+   * Draws a line from (x1, y1) to (x2, y2) including both ends - horizontal and vertical lines are spans
+   */
+  inline void draw_line(int x1, int y1, int x2, int y2, uint32_t color) noexcept {
+    if (y1 == y2) {
+      fill_rect(std::min(x1, x2), y1, std::abs(x2 - x1) + 1, 1, color);
+      return;
+    }
+    if (x1 == x2) {
+      fill_rect(x1, std::min(y1, y2), 1, std::abs(y2 - y1) + 1, color);
+      return;
+    }
+    // both ends on the same outer side
+    if ((x1 < 0 && x2 < 0) || (y1 < 0 && y2 < 0) || (x1 >= width_ && x2 >= width_) ||
+        (y1 >= height_ && y2 >= height_)) {
+      return;
+    }
+    // Bresenham
+    const int dx = std::abs(x2 - x1), dy = -std::abs(y2 - y1);
+    const int sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1;
+    int error = dx + dy;
+    while (true) {
+      if (x1 >= 0 && x1 < width_ && y1 >= 0 && y1 < height_) {
+        pixels_[static_cast<size_t>(y1) * width_ + x1] = color;
+      }
+      if (x1 == x2 && y1 == y2) {
+        break;
+      }
+      const int e2 = 2 * error;
+      if (e2 >= dy) {
+        error += dy;
+        x1 += sx;
+      }
+      if (e2 <= dx) {
+        error += dx;
+        y1 += sy;
+      }
+    }
+  }
+  /**
+   * Fills the world rectangle
+   */
+  inline void fill_rect(const Rect& rect, const CanvasView& view, uint32_t color) noexcept {
+    int x0, y0, x1, y1;
+    to_pixels(rect, view, x0, y0, x1, y1);
+    fill_rect(x0, y0, x1 - x0, y1 - y0, color);
+  }
+  /**
+   * Draws the outline of the world rectangle - its far edges are included
+   */
+  inline void draw_rect(const Rect& rect, const CanvasView& view, uint32_t color) noexcept {
+    int x0, y0, x1, y1;
+    to_pixels(rect, view, x0, y0, x1, y1);
+    draw_rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1, color);
+  }
+  /**
+   * Plots all points in one pass as size x size squares - points outside of the canvas are skipped
+   * @param points elements with x() and y() getters
+   */
+  template <typename PointType>
+  inline void plot_points(std::span<const PointType> points, const CanvasView& view, uint32_t color,
+                          int size = 1) noexcept {
+    const auto w = static_cast<float>(width_), h = static_cast<float>(height_);
+    const int half = size / 2;
+    for (const PointType& p : points) {
+      const float fx = view.x(p.x()), fy = view.y(p.y());
+      // also rejects NaN
+      if (!(fx >= 0 && fx < w && fy >= 0 && fy < h)) {
+        continue;
+      }
+      const int x = static_cast<int>(fx), y = static_cast<int>(fy);
+      if (size == 1) {
+        pixels_[static_cast<size_t>(y) * width_ + x] = color;
+      } else {
+        fill_rect(x - half, y - half, size, size, color);
+      }
+    }
+  }
+  template <typename PointType>
+  inline void plot_points(const std::vector<PointType>& points, const CanvasView& view, uint32_t color,
+                          int size = 1) noexcept {
+    plot_points(std::span<const PointType>(points), view, color, size);
+  }
+  /**
+   * Draws the node outlines and then the elements of a QuadTree or FlatQuadTree on top
+   * @param tree any tree with for_each_node()
+   */
+  template <typename Tree>
+  inline void draw_quadtree(const Tree& tree, const CanvasView& view, uint32_t line_color, uint32_t point_color,
+                            int point_size = 1) noexcept {
+    tree.for_each_node([&](const Rect& bounds, auto) { draw_rect(bounds, view, line_color); });
+    tree.for_each_node([&](const Rect&, auto elements) { plot_points(elements, view, point_color, point_size); });
+  }
+};
+}  // namespace cxstructs
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <chrono>
 #include <functional>
 #include <utility>
+namespace cxhelper {
+// COLORREF is 0x00BBGGRR, the DIB section 0x00RRGGBB
+inline uint32_t colorref_to_pixel(COLORREF color) noexcept {
+  return (color & 0xFF) << 16 | (color & 0xFF00) | (color >> 16 & 0xFF);
+}
+}  // namespace cxhelper
+
 namespace cxstructs {
+/**
+ * <h2>GraphicsWindow</h2>
+ * Native window that renders every frame into a PixelCanvas backed by a DIB section.<p>
+ * The callback draws into the canvas (or with GDI into the memory DC), afterward the frame is shown
+ * with a single BitBlt - there is no background erase, so nothing flickers.
+ */
 class GraphicsWindow {
   using RenderCallback = std::function<void(GraphicsWindow&)>;
   HWND hwnd_;
+  HDC memDC_;
   HBITMAP bitmap_, old_bitmap_;
   int width_, height_;
   bool running_;
   RenderCallback callback_;
   HFONT hFont;
+  PixelCanvas canvas_;
   static LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
-    if (uMsg == WM_DESTROY) {
-      PostQuitMessage(0);
-    } else {
-      return DefWindowProc(hwnd, uMsg, wParam, lParam);
+    auto* window = reinterpret_cast<GraphicsWindow*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+    switch (uMsg) {
+      case WM_DESTROY:
+        PostQuitMessage(0);
+        return 0;
+      case WM_ERASEBKGND:
+        return 1;  // every frame covers the whole client area
+      case WM_PAINT: {
+        PAINTSTRUCT ps;
+        HDC hdc = BeginPaint(hwnd, &ps);
+        if (window) {
+          window->present(hdc);
+        }
+        EndPaint(hwnd, &ps);
+        return 0;
+      }
+      default:
+        return DefWindowProc(hwnd, uMsg, wParam, lParam);
     }
-    return 0;
+  }
+  inline void present(HDC hdc) {
+    GdiFlush();
+    BitBlt(hdc, 0, 0, width_, height_, memDC_, 0, 0, SRCCOPY);
   }
 
  public:
@@ -66,23 +321,46 @@ class GraphicsWindow {
         CreateWindowEx(0, "GraphicsWindow", "GraphicsWindow", WS_OVERLAPPEDWINDOW, CW_USEDEFAULT,
                        CW_USEDEFAULT, rect.right - rect.left, rect.bottom - rect.top, nullptr,
                        nullptr, GetModuleHandle(nullptr), nullptr);
-
-    // Create bitmap
+    SetWindowLongPtr(hwnd_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+
+    // 32 bit top-down DIB section, the canvas draws straight into its bits
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = width_;
+    info.bmiHeader.biHeight = -height_;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    void* bits = nullptr;
     HDC hdc = GetDC(hwnd_);
-    SelectObject(hdc, hFont);
-    bitmap_ = CreateCompatibleBitmap(hdc, width_, height_);
+    memDC_ = CreateCompatibleDC(hdc);
+    bitmap_ = CreateDIBSection(hdc, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
     ReleaseDC(hwnd_, hdc);
-    old_bitmap_ = nullptr;
+    old_bitmap_ = (HBITMAP)SelectObject(memDC_, bitmap_);
+    SelectObject(memDC_, hFont);
+    canvas_.attach(static_cast<uint32_t*>(bits), width_, height_);
 
     ShowWindow(hwnd_, SW_SHOW);
 
     // Start the render loop
     renderLoop();
   }
+  GraphicsWindow(const GraphicsWindow&) = delete;
+  GraphicsWindow& operator=(const GraphicsWindow&) = delete;
+  ~GraphicsWindow() {
+    SelectObject(memDC_, old_bitmap_);
+    DeleteObject(bitmap_);
+    DeleteDC(memDC_);
+    DeleteObject(hFont);
+    if (IsWindow(hwnd_)) {
+      DestroyWindow(hwnd_);
+    }
+  }
 
   void renderLoop() {
     MSG msg;
     while (running_) {
+      const auto frame_start = std::chrono::steady_clock::now();
       // Process any messages in the queue.
       while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
         if (msg.message == WM_QUIT) {
@@ -93,87 +371,58 @@ class GraphicsWindow {
         DispatchMessage(&msg);
       }
 
+      // GDI has to be done with the bits before the canvas touches them
+      GdiFlush();
       if (callback_) {
         callback_(*this);
       }
-      // Redraw window
-      InvalidateRect(hwnd_, nullptr, TRUE);
-      UpdateWindow(hwnd_);
-      Sleep(1000 / 60);
+      // one blit per frame
+      HDC hdc = GetDC(hwnd_);
+      present(hdc);
+      ReleaseDC(hwnd_, hdc);
+
+      const auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - frame_start)
+                             .count();
+      if (spent < 1000 / 60) {
+        Sleep(static_cast<DWORD>(1000 / 60 - spent));
+      }
     }
   }
+  /**
+   * The pixel buffer of the current frame
+   */
+  [[nodiscard]] PixelCanvas& canvas() noexcept { return canvas_; }
+  /**
+   * The memory DC of the frame for GDI calls like TextOut
+   */
+  [[nodiscard]] HDC memoryDC() const noexcept { return memDC_; }
 
   void drawLine(int x1, int y1, int x2, int y2, COLORREF color) {
-    HDC hdc = GetDC(hwnd_);
-    HDC memDC = CreateCompatibleDC(hdc);
-    old_bitmap_ = (HBITMAP)SelectObject(memDC, bitmap_);
-
-    HPEN hPen = CreatePen(PS_SOLID, 2, color);
-    SelectObject(memDC, hPen);
-
-    MoveToEx(memDC, x1, y1, nullptr);
-    LineTo(memDC, x2, y2);
-
-    BitBlt(hdc, 0, 0, width_, height_, memDC, 0, 0, SRCCOPY);
-
-    DeleteObject(hPen);
-    SelectObject(memDC, old_bitmap_);
-    DeleteDC(memDC);
-    ReleaseDC(hwnd_, hdc);
+    canvas_.draw_line(x1, y1, x2, y2, cxhelper::colorref_to_pixel(color));
   }
 
   void fillRect(Rect rect, COLORREF color) {
-    HDC hdc = GetDC(hwnd_);
-    HDC memDC = CreateCompatibleDC(hdc);
-    old_bitmap_ = (HBITMAP)SelectObject(memDC, bitmap_);
-
-    RECT rect_1;
-    rect_1.left = rect.x();
-    rect_1.top = rect.x();
-    rect_1.right = rect.x() + rect.width();
-    rect_1.bottom = rect.y() + rect.height();
-
-    HBRUSH hBrush = CreateSolidBrush(color);
-    FillRect(memDC, &rect_1, hBrush);
-
-    BitBlt(hdc, 0, 0, width_, height_, memDC, 0, 0, SRCCOPY);
-
-    DeleteObject(hBrush);
-    SelectObject(memDC, old_bitmap_);
-    DeleteDC(memDC);
-    ReleaseDC(hwnd_, hdc);
+    canvas_.fill_rect(rect, CanvasView{}, cxhelper::colorref_to_pixel(color));
   }
 
-  void clear(COLORREF color = RGB(255, 255, 255)) {
-    fillRect({0, 0, (float)width_, (float)height_}, color);
-  }
+  void clear(COLORREF color = RGB(255, 255, 255)) { fill(color); }
 
-  void fill(COLORREF color) {
-    HDC hdc = GetDC(hwnd_);
-    HDC memDC = CreateCompatibleDC(hdc);
-    old_bitmap_ = (HBITMAP)SelectObject(memDC, bitmap_);
-
-    RECT rect;
-    rect.left = rect.top = 0;
-    rect.right = width_;
-    rect.bottom = height_;
-    HBRUSH brush = CreateSolidBrush(color);
-    FillRect(memDC, &rect, brush);
-    DeleteObject(brush);
-
-    BitBlt(hdc, 0, 0, width_, height_, memDC, 0, 0, SRCCOPY);
-
-    SelectObject(memDC, old_bitmap_);
-    DeleteDC(memDC);
-    ReleaseDC(hwnd_, hdc);
+  void fill(COLORREF color) { canvas_.fill(cxhelper::colorref_to_pixel(color)); }
+  /**
+   * Draws all node outlines and elements of a QuadTree or FlatQuadTree, fitted to the window
+   */
+  template <typename Tree>
+  void drawQuadTree(const Tree& tree, COLORREF lines = RGB(160, 160, 160), COLORREF points = RGB(255, 0, 0)) {
+    const CanvasView view = CanvasView::fit(tree.get_bounds(), 0, 0, width_ - 1, height_ - 1);
+    canvas_.draw_quadtree(tree, view, cxhelper::colorref_to_pixel(lines), cxhelper::colorref_to_pixel(points));
   }
-  template <typename T>
-  void drawQuadTree(QuadTree<T> tree) {}
 
   template <typename PointType>
-  void drawPointsWithAxis(std::vector<PointType> points) {
-    HDC hdc = GetDC(hwnd_);
-
+  void drawPointsWithAxis(const std::vector<PointType>& points) {
+    if (points.empty()) {
+      return;
+    }
     int startX = width_ * 0.1;
     int startY = height_ * 0.1;
 
@@ -193,51 +442,129 @@ class GraphicsWindow {
     minY -= 1;
     minX -= 1;
 
-    MoveToEx(hdc, startX, height_ - startY, nullptr);
-    LineTo(hdc, startX, startY);
-    MoveToEx(hdc, startX, height_ - startY, nullptr);
-    LineTo(hdc, startX + axisWidth, height_ - startY);
+    const uint32_t black = PixelCanvas::rgb(0, 0, 0);
+    canvas_.draw_line(startX, height_ - startY, startX, startY, black);
+    canvas_.draw_line(startX, height_ - startY, startX + axisWidth, height_ - startY, black);
 
-    float scaleX = maxX - minX / (float)axisWidth;
-    float scaleY = maxY - minY / (float)axisHeight;
+    const CanvasView view =
+        CanvasView::fit({minX, minY, maxX - minX, maxY - minY}, startX, startY, axisWidth, axisHeight, true);
+    canvas_.plot_points(points, view, PixelCanvas::rgb(255, 0, 0), 2);
 
-    for (const auto& point : points) {
-      int x = startX + ((point.x() - minX) / (maxX - minX)) * axisWidth;
-      int y = startY + (1 - (point.y() - minY) / (maxY - minY)) * axisHeight;
-
-      SetPixel(hdc, x, y, RGB(255, 0, 0));
-      SetPixel(hdc, x + 1, y + 1, RGB(255, 0, 0));
-      SetPixel(hdc, x + 1, y, RGB(255, 0, 0));
-      SetPixel(hdc, x, y + 1, RGB(255, 0, 0));
-    }
-
-    SelectObject(hdc, hFont);
-    SetTextColor(hdc, RGB(0, 0, 0));
-    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(memDC_, RGB(0, 0, 0));
+    SetBkMode(memDC_, TRANSPARENT);
 
     std::string minXStr = std::to_string((int)minX);
     std::string minYStr = std::to_string((int)minY);
     std::string maxXStr = std::to_string((int)maxX);
     std::string maxYStr = std::to_string((int)maxY);
 
-    TextOut(hdc, startX, height_ - startY + startY / 2, minXStr.c_str(), minXStr.size());
-    TextOut(hdc, startX - startX / 2, height_ - startY, minYStr.c_str(), minYStr.size());
+    TextOut(memDC_, startX, height_ - startY + startY / 2, minXStr.c_str(), minXStr.size());
+    TextOut(memDC_, startX - startX / 2, height_ - startY, minYStr.c_str(), minYStr.size());
 
-    TextOut(hdc, startX + axisWidth - 50, startY + axisHeight + 10, maxXStr.c_str(),
+    TextOut(memDC_, startX + axisWidth - 50, startY + axisHeight + 10, maxXStr.c_str(),
             maxXStr.size());
-    TextOut(hdc, startX - 50, startY, maxYStr.c_str(), maxYStr.size());
-
-    ReleaseDC(hwnd_, hdc);
+    TextOut(memDC_, startX - 50, startY, maxYStr.c_str(), maxYStr.size());
   }
 };
+}  // namespace cxstructs
 #undef max
 #undef min
-#else
-#pragma("Graphics support only for Windows")
-//#include <X11/Xlib.h>
 #endif
 
 #ifndef CX_DELETE_TESTS
+namespace cxtests {
+using namespace cxstructs;
+static void TEST_GRAPHICS() {
+  std::cout << "TESTING GRAPHICS" << std::endl;
+  const uint32_t white = PixelCanvas::rgb(255, 255, 255), red = PixelCanvas::rgb(255, 0, 0);
+  const uint32_t gray = PixelCanvas::rgb(160, 160, 160);
+  auto count = [](PixelCanvas& canvas, uint32_t color) {
+    return std::count(canvas.pixels().begin(), canvas.pixels().end(), color);
+  };
+
+  std::cout << "  Testing spans and clipping..." << std::endl;
+  PixelCanvas canvas(64, 48);
+  canvas.fill(white);
+  CX_ASSERT(count(canvas, white) == 64 * 48 && canvas.at(63, 47) == white, "");
+  CX_ASSERT(PixelCanvas::rgb(1, 2, 3) == 0x010203, "");
+  canvas.fill_rect(-10, 40, 20, 100, red);
+  CX_ASSERT(count(canvas, red) == 10 * 8 && canvas.at(9, 47) == red && canvas.at(10, 47) == white, "");
+  canvas.fill(white);
+  canvas.draw_rect(2, 3, 10, 5, red);
+  CX_ASSERT(count(canvas, red) == 2 * 10 + 2 * 3 && canvas.at(11, 7) == red && canvas.at(5, 5) == white, "");
+  canvas.fill(white);
+  canvas.draw_line(0, 0, 31, 31, red);
+  CX_ASSERT(count(canvas, red) == 32 && canvas.at(31, 31) == red, "");
+  canvas.draw_line(-100, 5, 1000, 5, red);
+  CX_ASSERT(count(canvas, red) == 32 + 63, "");
+  canvas.draw_line(-100, -50, -5, 3000, red);
+  canvas.draw_line(-1000000, -1000000, 1000000, 1000000, red);
+  CX_ASSERT(count(canvas, red) == 32 + 63 + 16, "only the visible part of the long diagonal is drawn");
+
+  std::cout << "  Testing views and points..." << std::endl;
+  const CanvasView view = CanvasView::fit({0, 0, 200, 100}, 0, 0, 64, 48);
+  CX_ASSERT(view.x(100) == 32 && view.y(50) == 24, "");
+  const CanvasView flipped = CanvasView::fit({0, 0, 200, 100}, 0, 0, 64, 48, true);
+  CX_ASSERT(flipped.y(0) == 48 && flipped.y(100) == 0, "");
+  canvas.fill(white);
+  const std::vector<Point> points{{0, 0}, {100, 50}, {199, 99}, {-1, 5}, {250, 5}, {10, 1e30F}};
+  canvas.plot_points(points, view, red);
+  CX_ASSERT(count(canvas, red) == 3 && canvas.at(0, 0) == red && canvas.at(32, 24) == red, "");
+  canvas.plot_points(points, view, red, 3);
+  CX_ASSERT(count(canvas, red) == 4 + 9 + 4, "squares are clipped at the border");
+  canvas.fill(white);
+  canvas.fill_rect({-50, -50, 100, 75}, view, red);
+  CX_ASSERT(count(canvas, red) == 16 * 12 && canvas.at(15, 11) == red, "");
+
+  std::cout << "  Testing quad trees..." << std::endl;
+  std::vector<Point> cloud;
+  for (int i = 0; i < 2000; i++) {
+    cloud.emplace_back(static_cast<float>(i * 37 % 200), static_cast<float>(i * 53 % 100));
+  }
+  QuadTree<Point> tree({0, 0, 200, 100}, 8, 16);
+  FlatQuadTree<Point> flat({0, 0, 200, 100}, 8, 16);
+  for (const Point& p : cloud) {
+    tree.insert(p);
+  }
+  flat.build(cloud);
+  uint_32_cx nodes = 0, elements = 0;
+  flat.for_each_node([&](const Rect&, std::span<const Point> e) {
+    nodes++;
+    elements += e.size();
+  });
+  CX_ASSERT(nodes == flat.node_count() && elements == cloud.size(), "");
+  elements = 0;
+  tree.for_each_node([&](const Rect&, std::span<const Point> e) { elements += e.size(); });
+  CX_ASSERT(elements == cloud.size(), "");
+
+  PixelCanvas pointer_canvas(401, 201), flat_canvas(401, 201), reference(401, 201);
+  const CanvasView tree_view = CanvasView::fit(tree.get_bounds(), 0, 0, 400, 200);
+  for (PixelCanvas* c : {&pointer_canvas, &flat_canvas, &reference}) {
+    c->fill(white);
+  }
+  pointer_canvas.draw_quadtree(tree, tree_view, gray, red);
+  flat_canvas.draw_quadtree(flat, tree_view, gray, red);
+  reference.plot_points(cloud, tree_view, red);
+  CX_ASSERT(pointer_canvas.at(400, 0) == gray && pointer_canvas.at(0, 200) == gray, "root outline");
+  CX_ASSERT(flat_canvas.at(400, 100) == gray && flat_canvas.at(200, 200) == gray, "first split");
+  for (int y = 0; y < 201; y++) {
+    for (int x = 0; x < 401; x++) {
+      if (reference.at(x, y) == red) {
+        CX_ASSERT(pointer_canvas.at(x, y) == red && flat_canvas.at(x, y) == red, "every point is drawn");
+      }
+    }
+  }
+
+  std::cout << "  Testing attached memory..." << std::endl;
+  std::vector<uint32_t> memory(16 * 16);
+  PixelCanvas attached;
+  attached.attach(memory.data(), 16, 16);
+  attached.fill_rect(4, 4, 8, 8, red);
+  CX_ASSERT(std::count(memory.begin(), memory.end(), red) == 64 && memory[4 * 16 + 4] == red, "");
+}
+}  // namespace cxtests
+#ifdef _WIN32
+namespace cxstructs {
 static void TEST() {
   std::vector<Point> p{{2, 2}, {40, 40}, {2, 3}, {5, 6}, {10, 15}, {25, 25}};
   GraphicsWindow win(800, 800, [&p](GraphicsWindow& win) {
@@ -245,6 +572,7 @@ static void TEST() {
     win.drawPointsWithAxis(p);
   });
 }
+}  // namespace cxstructs
+#endif
 #endif
-}
 #endif  //CXSTRUCTS_SRC_CXUTIL_CXGRAPHICS_H_
@@ -21,10 +21,55 @@
 #ifndef CXSTRUCTS_SRC_CXIO_H_
 #define CXSTRUCTS_SRC_CXIO_H_
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <new>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+#include "cxthreadpool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cxhelper {
+// below this many bytes per chunk a parallel CSV parse is not worth the tasks
+constexpr size_t kCSVChunkMin = 1 << 18;
+
+inline const char* csv_skip_blanks(const char* it, const char* end) noexcept {
+  while (it < end && (*it == ' ' || *it == '\t')) {
+    it++;
+  }
+  return it;
+}
+// end of the line content starting at it - without the '\n' and a trailing '\r'
+inline const char* csv_line_end(const char* it, const char* end, const char*& next) noexcept {
+  const auto* nl = static_cast<const char*>(std::memchr(it, '\n', static_cast<size_t>(end - it)));
+  next = nl ? nl + 1 : end;
+  const char* stop = nl ? nl : end;
+  if (stop > it && stop[-1] == '\r') {
+    stop--;
+  }
+  return stop;
+}
+}  // namespace cxhelper
 
 namespace cxstructs {
 
@@ -37,20 +82,626 @@ namespace cxstructs {
  */
 inline bool load_txt(const std::string& filePath, std::string& contents) {
 
-  std::ifstream file(filePath, std::ios::in);
+  std::ifstream file(filePath, std::ios::in | std::ios::binary | std::ios::ate);
 
   if (!file.is_open()) {
     std::cerr << "Could not open the file: " << filePath << std::endl;
     return false;
   }
 
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-
-  contents = std::move(buffer.str());
+  // one read straight into the string instead of going through a stringstream copy
+  const auto size = static_cast<size_t>(file.tellg());
+  file.seekg(0);
+  contents.resize(size);
+  file.read(contents.data(), static_cast<std::streamsize>(size));
+  contents.resize(static_cast<size_t>(file.gcount()));
 
   return true;
 }
 
+/**
+ * Calls func(std::string_view line) for every line of the given text without copying it.<br>
+ * Lines are split on '\n', a trailing '\r' is removed and a final line without newline is included.
+ * @param text the text to split - e.g. MappedFile::view()
+ * @param func called with each line, views point into text
+ */
+template <typename Func>
+void for_each_line(std::string_view text, Func func) {
+  const char* it = text.data();
+  const char* end = it + text.size();
+  while (it < end) {
+    const auto* nl = static_cast<const char*>(std::memchr(it, '\n', static_cast<size_t>(end - it)));
+    const char* lineEnd = nl ? nl : end;
+    std::string_view line(it, static_cast<size_t>(lineEnd - it));
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    func(line);
+    it = nl ? nl + 1 : end;
+  }
+}
+
+/**
+ * Access pattern hints for MappedFile::advise() - the equivalent of madvise()
+ */
+enum class Access : uint8_t {
+  NORMAL,      // no special treatment
+  SEQUENTIAL,  // read ahead aggressively and drop pages behind the reader
+  RANDOM,      // disable read ahead
+  WILL_NEED,   // start paging in the whole range now
+  DONT_NEED    // the range is not needed any time soon
+};
+
+/**
+ * <h2>MappedFile</h2>
+ * Maps a whole file into memory, the operating system pages the contents in on first access.
+ * <br><br>
+ * Read-only mappings are shared with every other process mapping the file. Copy-on-write mappings can
+ * be written to, but the changes stay private and never reach the file.
+ */
+class MappedFile {
+  char* data_ = nullptr;
+  size_t size_ = 0;
+  bool open_ = false;
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#endif
+
+ public:
+  MappedFile() = default;
+  /**
+   * @param filePath the file to map
+   * @param copyOnWrite if true the mapped memory is writable without modifying the file
+   */
+  explicit MappedFile(const std::string& filePath, bool copyOnWrite = false) {
+    open(filePath, copyOnWrite);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& o) noexcept { *this = std::move(o); }
+  MappedFile& operator=(MappedFile&& o) noexcept {
+    if (this != &o) {
+      close();
+      data_ = std::exchange(o.data_, nullptr);
+      size_ = std::exchange(o.size_, 0);
+      open_ = std::exchange(o.open_, false);
+#ifdef _WIN32
+      file_ = std::exchange(o.file_, INVALID_HANDLE_VALUE);
+      mapping_ = std::exchange(o.mapping_, nullptr);
+#endif
+    }
+    return *this;
+  }
+  ~MappedFile() { close(); }
+  /**
+   * Maps the given file, closing the current one first
+   * @param filePath the file to map
+   * @param copyOnWrite if true the mapped memory is writable without modifying the file
+   * @return true if the file was mapped - an empty file is open with size 0
+   */
+  bool open(const std::string& filePath, bool copyOnWrite = false) {
+    close();
+#ifdef _WIN32
+    file_ = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+      close();
+      return false;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ > 0) {
+      mapping_ = CreateFileMappingA(file_, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0,
+                                    0, nullptr);
+      if (mapping_ == nullptr) {
+        close();
+        return false;
+      }
+      data_ = static_cast<char*>(
+          MapViewOfFile(mapping_, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+      if (data_ == nullptr) {
+        close();
+        return false;
+      }
+    }
+#else
+    const int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+      ::close(fd);
+      return false;
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+      void* ptr = mmap(nullptr, size_, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        ::close(fd);
+        size_ = 0;
+        return false;
+      }
+      data_ = static_cast<char*>(ptr);
+    }
+    ::close(fd);  // the mapping keeps the file alive
+#endif
+    open_ = true;
+    return true;
+  }
+  /**
+   * Unmaps the file - pointers into it are invalid afterwards
+   */
+  void close() noexcept {
+#ifdef _WIN32
+    if (data_) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_) {
+      munmap(data_, size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+  }
+  /**
+   * Tells the operating system how the mapping is going to be accessed.<br>
+   * Only a hint - on platforms without support this does nothing and returns false
+   * @param access the expected access pattern
+   * @param offset start of the range in bytes, rounded down to the page boundary
+   * @param length length of the range in bytes, 0 means until the end of the file
+   * @return true if the hint was applied
+   */
+  bool advise(Access access, size_t offset = 0, size_t length = 0) const noexcept {
+    if (!data_ || offset >= size_) {
+      return false;
+    }
+    if (length == 0 || length > size_ - offset) {
+      length = size_ - offset;
+    }
+#ifdef _WIN32
+    (void)access;
+    return false;
+#else
+    const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t aligned = offset / page * page;
+    int advice = MADV_NORMAL;
+    switch (access) {
+      case Access::NORMAL:
+        advice = MADV_NORMAL;
+        break;
+      case Access::SEQUENTIAL:
+        advice = MADV_SEQUENTIAL;
+        break;
+      case Access::RANDOM:
+        advice = MADV_RANDOM;
+        break;
+      case Access::WILL_NEED:
+        advice = MADV_WILLNEED;
+        break;
+      case Access::DONT_NEED:
+        advice = MADV_DONTNEED;
+        break;
+    }
+    return madvise(data_ + aligned, length + (offset - aligned), advice) == 0;
+#endif
+  }
+  [[nodiscard]] inline char* data() noexcept { return data_; }
+  [[nodiscard]] inline const char* data() const noexcept { return data_; }
+  [[nodiscard]] inline size_t size() const noexcept { return size_; }
+  [[nodiscard]] inline bool is_open() const noexcept { return open_; }
+  /**
+   * @return the whole file as text - valid as long as the file stays mapped
+   */
+  [[nodiscard]] inline std::string_view view() const noexcept { return {data_, size_}; }
+  /**
+   * @return the whole file as bytes - valid as long as the file stays mapped
+   */
+  [[nodiscard]] inline std::span<const std::byte> bytes() const noexcept {
+    return {reinterpret_cast<const std::byte*>(data_), size_};
+  }
+};
+
+/**
+ * <h2>LineReader</h2>
+ * Streams a text file line by line through one large aligned buffer.
+ * <br><br>
+ * Unlike std::getline no string is allocated per line: next() hands out views into the buffer which
+ * stay valid until the following call. The file is read in big chunks with buffering of the C
+ * library turned off and the operating system is told the access is sequential, so files much larger
+ * than memory stream at disk speed. A line longer than the buffer grows it.
+ */
+class LineReader {
+  static constexpr size_t kAlignment = 4096;
+  FILE* file_ = nullptr;
+  char* buffer_ = nullptr;
+  size_t capacity_ = 0;
+  size_t begin_ = 0;  // first unconsumed byte
+  size_t end_ = 0;    // end of the valid data
+  bool eof_ = true;
+
+  static char* allocate(size_t bytes) {
+    return static_cast<char*>(::operator new(bytes, std::align_val_t{kAlignment}));
+  }
+  static void deallocate(char* ptr) noexcept {
+    if (ptr) {
+      ::operator delete(ptr, std::align_val_t{kAlignment});
+    }
+  }
+  bool refill() {
+    const size_t remaining = end_ - begin_;
+    if (begin_ > 0) {
+      std::memmove(buffer_, buffer_ + begin_, remaining);
+    }
+    begin_ = 0;
+    end_ = remaining;
+    if (end_ == capacity_) {
+      char* grown = allocate(capacity_ * 2);
+      std::memcpy(grown, buffer_, end_);
+      deallocate(buffer_);
+      buffer_ = grown;
+      capacity_ *= 2;
+    }
+    const size_t read = std::fread(buffer_ + end_, 1, capacity_ - end_, file_);
+    end_ += read;
+    if (read == 0) {
+      eof_ = true;
+    }
+    return read > 0;
+  }
+
+ public:
+  LineReader() = default;
+  /**
+   * @param filePath the file to read
+   * @param bufferSize size of the read buffer in bytes - defaults to 1 MiB
+   */
+  explicit LineReader(const std::string& filePath, size_t bufferSize = 1 << 20) {
+    open(filePath, bufferSize);
+  }
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+  LineReader(LineReader&& o) noexcept { *this = std::move(o); }
+  LineReader& operator=(LineReader&& o) noexcept {
+    if (this != &o) {
+      close();
+      file_ = std::exchange(o.file_, nullptr);
+      buffer_ = std::exchange(o.buffer_, nullptr);
+      capacity_ = std::exchange(o.capacity_, 0);
+      begin_ = std::exchange(o.begin_, 0);
+      end_ = std::exchange(o.end_, 0);
+      eof_ = std::exchange(o.eof_, true);
+    }
+    return *this;
+  }
+  ~LineReader() { close(); }
+  /**
+   * Opens the given file, closing the current one first
+   * @param filePath the file to read
+   * @param bufferSize size of the read buffer in bytes
+   * @return true if the file was opened
+   */
+  bool open(const std::string& filePath, size_t bufferSize = 1 << 20) {
+    close();
+    file_ = std::fopen(filePath.c_str(), "rb");
+    if (!file_) {
+      return false;
+    }
+    std::setvbuf(file_, nullptr, _IONBF, 0);  // we already buffer, skip the extra copy
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fileno(file_), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    capacity_ = bufferSize < 64 ? 64 : (bufferSize + kAlignment - 1) / kAlignment * kAlignment;
+    buffer_ = allocate(capacity_);
+    eof_ = false;
+    return true;
+  }
+  void close() noexcept {
+    if (file_) {
+      std::fclose(file_);
+    }
+    deallocate(buffer_);
+    file_ = nullptr;
+    buffer_ = nullptr;
+    capacity_ = begin_ = end_ = 0;
+    eof_ = true;
+  }
+  /**
+   * Reads the next line without its line ending ('\n' or "\r\n")
+   * @param line set to the line - valid until the next call
+   * @return false if there are no more lines
+   */
+  bool next(std::string_view& line) {
+    if (!file_) {
+      return false;
+    }
+    while (true) {
+      const size_t scanned = end_ - begin_;
+      const auto* nl =
+          static_cast<const char*>(std::memchr(buffer_ + begin_, '\n', scanned));
+      if (nl) {
+        line = std::string_view(buffer_ + begin_, static_cast<size_t>(nl - (buffer_ + begin_)));
+        begin_ = static_cast<size_t>(nl - buffer_) + 1;
+        break;
+      }
+      if (eof_ || !refill()) {
+        if (begin_ == end_) {
+          return false;
+        }
+        line = std::string_view(buffer_ + begin_, end_ - begin_);
+        begin_ = end_;
+        break;
+      }
+    }
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    return true;
+  }
+  [[nodiscard]] inline bool is_open() const noexcept { return file_ != nullptr; }
+};
+
+/**
+ * <h2>CSVReader</h2>
+ * Parses numeric CSV files straight into preallocated storage - no string is created per line or field.
+ * <br><br>
+ * The file is memory mapped and split into chunks at line boundaries. Counting the rows of each chunk
+ * gives every chunk its first row index, so the chunks are then parsed independently on the global
+ * ThreadPool with std::from_chars. Line and delimiter scanning goes through memchr, which the C library
+ * vectorizes.<p>
+ * Empty lines are skipped, fields may be padded with spaces or tabs. Quoted fields are not supported.
+ * <br><br>
+ * See mat::load_csv() and soa_vec::load_csv() for loading whole files.
+ */
+class CSVReader {
+  MappedFile file_;
+  std::string_view header_;
+  std::vector<std::string_view> chunks_;
+  std::vector<size_t> first_row_;  // row index of the first line of each chunk
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  uint_32_cx threads_ = 1;
+  char delim_ = ',';
+  bool open_ = false;
+
+  template <typename Func>
+  void for_each_chunk(Func func) const {
+    if (chunks_.size() == 1) {
+      func(0);
+      return;
+    }
+    ThreadPool::global().parallel_for(0, chunks_.size(), [&](uint_32_cx begin, uint_32_cx end) {
+      for (uint_32_cx c = begin; c < end; c++) {
+        func(c);
+      }
+    });
+  }
+  static size_t count_rows(std::string_view chunk) noexcept {
+    size_t rows = 0;
+    const char* it = chunk.data();
+    const char* end = it + chunk.size();
+    const char* next;
+    while (it < end) {
+      if (cxhelper::csv_line_end(it, end, next) != it) {
+        rows++;
+      }
+      it = next;
+    }
+    return rows;
+  }
+  template <typename T, typename Func>
+  bool parse_chunk(std::string_view chunk, size_t row, Func& func) const {
+    const char* it = chunk.data();
+    const char* end = it + chunk.size();
+    const char* next;
+    while (it < end) {
+      const char* stop = cxhelper::csv_line_end(it, end, next);
+      if (stop == it) {
+        it = next;
+        continue;
+      }
+      for (size_t col = 0; col < cols_; col++) {
+        it = cxhelper::csv_skip_blanks(it, stop);
+        if (it < stop && *it == '+') {
+          it++;
+        }
+        T value;
+        const auto [ptr, ec] = std::from_chars(it, stop, value);
+        if (ec != std::errc{}) {
+          return false;
+        }
+        it = cxhelper::csv_skip_blanks(ptr, stop);
+        if (col + 1 < cols_) {
+          if (it == stop || *it != delim_) {
+            return false;
+          }
+          it++;
+        }
+        func(row, col, value);
+      }
+      if (it != stop) {
+        return false;  // more fields than the first row
+      }
+      row++;
+      it = next;
+    }
+    return true;
+  }
+  void index(std::string_view text, bool header) {
+    const char* it = text.data();
+    const char* end = it + text.size();
+    const char* next;
+    if (header && it < end) {
+      header_ = {it, static_cast<size_t>(cxhelper::csv_line_end(it, end, next) - it)};
+      it = next;
+    }
+    // the first non-empty line decides the number of columns
+    for (const char* line = it; line < end; line = next) {
+      const char* stop = cxhelper::csv_line_end(line, end, next);
+      if (stop != line) {
+        cols_ = static_cast<size_t>(std::count(line, stop, delim_)) + 1;
+        break;
+      }
+    }
+    const size_t bytes = static_cast<size_t>(end - it);
+    const size_t parts = std::max<size_t>(1, std::min<size_t>(threads_, bytes / cxhelper::kCSVChunkMin));
+    for (size_t p = 1; p <= parts && it < end; p++) {
+      const char* split = p == parts ? end : text.data() + (text.size() * p) / parts;
+      if (split <= it) {
+        continue;
+      }
+      if (split < end) {
+        const auto* nl = static_cast<const char*>(std::memchr(split, '\n', static_cast<size_t>(end - split)));
+        split = nl ? nl + 1 : end;
+      }
+      chunks_.emplace_back(it, static_cast<size_t>(split - it));
+      it = split;
+    }
+    first_row_.assign(chunks_.size(), 0);
+    for_each_chunk([&](size_t c) { first_row_[c] = count_rows(chunks_[c]); });
+    for (size_t& rows : first_row_) {
+      const size_t count = rows;
+      rows = rows_;
+      rows_ += count;
+    }
+  }
+
+ public:
+  /**
+   * Maps and indexes the given file - rows() and cols() are known right after construction
+   * @param filePath the file to read
+   * @param delimiter the field separator
+   * @param header if true the first line is skipped and available through header()
+   * @param threads number of chunks that are counted and parsed in parallel
+   */
+  explicit CSVReader(const std::string& filePath, char delimiter = ',', bool header = false,
+                     uint_32_cx threads = 1)
+      : threads_(std::max<uint_32_cx>(threads, 1)), delim_(delimiter) {
+    if (!file_.open(filePath)) {
+      return;
+    }
+    file_.advise(Access::SEQUENTIAL);
+    index(file_.view(), header);
+    open_ = true;
+  }
+  /**
+   * Indexes CSV text that is already in memory - it has to outlive the reader
+   */
+  CSVReader(std::string_view text, char delimiter, bool header = false, uint_32_cx threads = 1)
+      : threads_(std::max<uint_32_cx>(threads, 1)), delim_(delimiter), open_(true) {
+    index(text, header);
+  }
+  /**
+   * Parses all fields as T and hands them to func(size_t row, size_t col, T value).<p>
+   * With more than one chunk func is called concurrently for different rows, so it has to be thread safe -
+   * writing into distinct slots of preallocated storage is.
+   * @return false if a field is not a number or a row has a different number of fields than the first
+   */
+  template <typename T, typename Func>
+  bool parse(Func func) const {
+    static_assert(std::is_arithmetic_v<T>, "CSVReader parses numbers");
+    if (!open_) {
+      return false;
+    }
+    std::atomic<bool> ok{true};
+    for_each_chunk([&](size_t c) {
+      if (ok.load(std::memory_order_relaxed) && !parse_chunk<T>(chunks_[c], first_row_[c], func)) {
+        ok.store(false, std::memory_order_relaxed);
+      }
+    });
+    return ok.load();
+  }
+  [[nodiscard]] inline bool is_open() const noexcept { return open_; }
+  /**
+   * @return number of non-empty lines without the header
+   */
+  [[nodiscard]] inline size_t rows() const noexcept { return rows_; }
+  /**
+   * @return number of fields in the first row
+   */
+  [[nodiscard]] inline size_t cols() const noexcept { return cols_; }
+  /**
+   * @return the header line, empty if the reader was told there is none
+   */
+  [[nodiscard]] inline std::string_view header() const noexcept { return header_; }
+};
+
 }  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+namespace cxtests {
+using namespace cxstructs;
+static void TEST_IO() {
+  std::cout << "TESTING IO" << std::endl;
+  const std::string path = "cxstructs_io_test.txt";
+  std::string text;
+  for (int i = 0; i < 5000; i++) {
+    text += "line " + std::to_string(i) + (i % 3 == 0 ? "\r\n" : "\n");
+  }
+  const std::string longLine(10000, 'x');
+  text += longLine + "\n";
+  text += "unterminated";
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+  }
+
+  std::cout << "  Testing load_txt..." << std::endl;
+  std::string loaded;
+  CX_ASSERT(load_txt(path, loaded), "");
+  CX_ASSERT(loaded == text, "");
+
+  std::cout << "  Testing MappedFile view and for_each_line..." << std::endl;
+  MappedFile file(path);
+  CX_ASSERT(file.is_open() && file.view() == text, "");
+  CX_ASSERT(file.bytes().size() == text.size(), "");
+  file.advise(Access::SEQUENTIAL);
+  int lines = 0;
+  for_each_line(file.view(), [&](std::string_view line) {
+    if (lines < 5000) {
+      CX_ASSERT(line == "line " + std::to_string(lines), "");
+    } else {
+      CX_ASSERT(line == (lines == 5000 ? longLine : "unterminated"), "");
+    }
+    lines++;
+  });
+  CX_ASSERT(lines == 5002, "");
+
+  std::cout << "  Testing LineReader..." << std::endl;
+  // a small buffer forces refills and growing past the long line
+  LineReader reader(path, 64);
+  std::string_view line;
+  lines = 0;
+  while (reader.next(line)) {
+    if (lines < 5000) {
+      CX_ASSERT(line == "line " + std::to_string(lines), "");
+    } else {
+      CX_ASSERT(line == (lines == 5000 ? longLine : "unterminated"), "");
+    }
+    lines++;
+  }
+  CX_ASSERT(lines == 5002, "");
+  CX_ASSERT(!reader.next(line), "");
+  CX_ASSERT(!LineReader("cxstructs_missing_file.txt").is_open(), "");
+
+  file.close();
+  std::remove(path.c_str());
+}
+}  // namespace cxtests
+#endif
 #endif  //CXSTRUCTS_SRC_CXIO_H_
@@ -0,0 +1,868 @@
+// Copyright (c) 2023 gk646
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#define CX_FINISHED
+#ifndef CXSTRUCTS_SRC_CXUTIL_CXRECLAIM_H_
+#define CXSTRUCTS_SRC_CXUTIL_CXRECLAIM_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../cxconfig.h"
+
+// Safe memory reclamation for lock-free readers - a node unlinked by a writer is only freed once no reader
+// can still hold a pointer to it
+// EpochDomain: readers pin the global epoch (one store and a fence), retired nodes are freed two epochs later.
+// Cheapest for readers, but a reader stalled inside its guard holds back all reclamation
+// HazardDomain: readers publish the exact pointer they use, so memory stays bounded even if a reader stalls.
+// Each protect() costs a store, a fence and a reload
+// rcu_ptr publishes whole versions of a read-mostly structure on top of either domain
+
+namespace cxhelper {
+struct RetiredPtr {
+  void* ptr;
+  void (*deleter)(void*);
+  uint64_t epoch;
+};
+inline void free_retired(std::vector<RetiredPtr>& retired) noexcept {
+  for (const auto& r : retired) {
+    r.deleter(r.ptr);
+  }
+  retired.clear();
+}
+// one per thread and domain, records are reused after their thread exits but never freed before the domain
+struct alignas(64) EpochRecord {
+  std::atomic<uint64_t> epoch{0};  // pinned epoch, 0 while the thread is outside a guard
+  std::atomic<bool> in_use{false};
+  uint32_t nesting = 0;  // owner only
+  std::vector<RetiredPtr> retired;  // owner only
+  EpochRecord* next = nullptr;
+};
+struct EpochState {
+  std::atomic<uint64_t> epoch{1};
+  std::atomic<EpochRecord*> records{nullptr};
+  std::mutex orphan_mutex;
+  std::vector<RetiredPtr> orphans;  // retired nodes of exited threads
+
+  EpochState() = default;
+  EpochState(const EpochState&) = delete;
+  EpochState& operator=(const EpochState&) = delete;
+  ~EpochState() {
+    reclaim_all();
+    for (EpochRecord* record = records.load(); record;) {
+      EpochRecord* next = record->next;
+      delete record;
+      record = next;
+    }
+  }
+  // no thread may use the domain anymore
+  void reclaim_all() {
+    for (EpochRecord* record = records.load(std::memory_order_acquire); record; record = record->next) {
+      free_retired(record->retired);
+    }
+    std::lock_guard<std::mutex> lock(orphan_mutex);
+    free_retired(orphans);
+  }
+  EpochRecord* acquire() {
+    for (EpochRecord* record = records.load(std::memory_order_acquire); record; record = record->next) {
+      bool expected = false;
+      if (!record->in_use.load(std::memory_order_relaxed) &&
+          record->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+        return record;
+      }
+    }
+    auto* record = new EpochRecord();
+    record->in_use.store(true, std::memory_order_relaxed);
+    EpochRecord* head = records.load(std::memory_order_relaxed);
+    do {
+      record->next = head;
+    } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+    return record;
+  }
+  void release(EpochRecord* record) {
+    record->epoch.store(0, std::memory_order_release);
+    record->nesting = 0;
+    if (!record->retired.empty()) {
+      std::lock_guard<std::mutex> lock(orphan_mutex);
+      orphans.insert(orphans.end(), record->retired.begin(), record->retired.end());
+      record->retired.clear();
+    }
+    record->in_use.store(false, std::memory_order_release);
+  }
+  // the epoch can move on once every pinned thread has seen the current one
+  bool try_advance() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t current = epoch.load(std::memory_order_relaxed);
+    for (EpochRecord* record = records.load(std::memory_order_acquire); record; record = record->next) {
+      const uint64_t pinned = record->epoch.load(std::memory_order_acquire);
+      if (pinned != 0 && pinned != current) {
+        return false;
+      }
+    }
+    return epoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+  }
+  // frees what was retired at least two epochs ago - no pinned thread can still see it
+  size_t collect(std::vector<RetiredPtr>& retired) noexcept {
+    const uint64_t current = epoch.load(std::memory_order_acquire);
+    const auto keep = std::partition(retired.begin(), retired.end(),
+                                     [current](const RetiredPtr& r) { return r.epoch + 2 > current; });
+    const size_t freed = retired.end() - keep;
+    for (auto it = keep; it != retired.end(); ++it) {
+      it->deleter(it->ptr);
+    }
+    retired.erase(keep, retired.end());
+    return freed;
+  }
+};
+// the records this thread holds, given back when the thread exits
+struct EpochThreadCache {
+  std::vector<std::pair<std::shared_ptr<EpochState>, EpochRecord*>> entries;
+  EpochState* last_state = nullptr;
+  EpochRecord* last_record = nullptr;
+  ~EpochThreadCache() {
+    for (auto& [state, record] : entries) {
+      state->release(record);
+    }
+  }
+};
+inline EpochRecord* epoch_record(const std::shared_ptr<EpochState>& state) {
+  thread_local EpochThreadCache cache;
+  if (cache.last_state == state.get()) {
+    return cache.last_record;
+  }
+  EpochRecord* record = nullptr;
+  for (auto& [s, r] : cache.entries) {
+    if (s == state) {
+      record = r;
+    }
+  }
+  if (record == nullptr) {
+    record = state->acquire();
+    cache.entries.emplace_back(state, record);
+  }
+  cache.last_state = state.get();
+  cache.last_record = record;
+  return record;
+}
+
+struct alignas(64) HazardRecord {
+  std::atomic<const void*> ptr{nullptr};
+  std::atomic<bool> in_use{false};
+  HazardRecord* next = nullptr;
+};
+struct HazardRetired {
+  void* ptr;
+  void (*deleter)(void*);
+  HazardRetired* next;
+};
+// retired list nodes come from the shared size class pools
+inline HazardRetired* new_hazard_retired(void* ptr, void (*deleter)(void*)) {
+  return new (size_class_allocate(sizeof(HazardRetired))) HazardRetired{ptr, deleter, nullptr};
+}
+inline void delete_hazard_retired(HazardRetired* node) noexcept {
+  size_class_deallocate(node, sizeof(HazardRetired));
+}
+template <typename T>
+inline void delete_object(void* ptr) {
+  delete static_cast<T*>(ptr);
+}
+}  // namespace cxhelper
+
+namespace cxstructs {
+/**
+ * <h2>EpochDomain</h2>
+ * Epoch based reclamation: readers pin the domain while they hold pointers into a lock-free structure,
+ * writers retire what they unlink and it is freed once every reader pinned at that time has left.
+ * <br><br>
+ * Pinning stores the global epoch into the thread's record and issues one fence, guards nest for free.
+ * The epoch advances when all pinned threads have seen the current one, nodes retired in epoch e are
+ * freed from e + 2 on. Each thread frees its own retired nodes in batches of 64.
+ * <br><br>
+ * A thread that sleeps while pinned stops all reclamation - use HazardDomain if readers can block.
+ * <pre>
+ * auto guard = domain.pin();
+ * Node* node = head.load(std::memory_order_acquire);   // valid until the guard ends
+ * ...
+ * domain.retire(unlinked);                              // in a writer, after unlinking
+ * </pre>
+ */
+class EpochDomain {
+  static constexpr size_t kCollectThreshold = 64;
+  std::shared_ptr<cxhelper::EpochState> state_;
+
+ public:
+  EpochDomain() : state_(std::make_shared<cxhelper::EpochState>()) {}
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+  /**
+   * Frees everything still retired - no thread may be pinned anymore
+   */
+  ~EpochDomain() { state_->reclaim_all(); }
+  /**
+   * The library wide domain, never destroyed so it outlives every thread using it
+   */
+  static EpochDomain& global() {
+    static auto* domain = new EpochDomain();
+    return *domain;
+  }
+  /**
+   * Keeps the calling thread pinned for its lifetime
+   */
+  class Guard {
+    cxhelper::EpochRecord* record_;
+
+   public:
+    explicit Guard(cxhelper::EpochRecord* record) noexcept : record_(record) {}
+    Guard(Guard&& o) noexcept : record_(std::exchange(o.record_, nullptr)) {}
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+    Guard& operator=(Guard&&) = delete;
+    ~Guard() {
+      if (record_ && --record_->nesting == 0) {
+        record_->epoch.store(0, std::memory_order_release);
+      }
+    }
+  };
+  /**
+   * Pins the calling thread - pointers loaded from the protected structure stay valid until the guard ends
+   */
+  [[nodiscard]] inline Guard pin() {
+    cxhelper::EpochRecord* record = cxhelper::epoch_record(state_);
+    if (record->nesting++ == 0) {
+      record->epoch.store(state_->epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    return Guard(record);
+  }
+  /**
+   * Frees ptr with deleter once no thread pinned now can still read it. Call after unlinking ptr
+   */
+  inline void retire(void* ptr, void (*deleter)(void*)) {
+    cxhelper::EpochRecord* record = cxhelper::epoch_record(state_);
+    record->retired.push_back({ptr, deleter, state_->epoch.load(std::memory_order_acquire)});
+    if (record->retired.size() >= kCollectThreshold) {
+      state_->try_advance();
+      state_->collect(record->retired);
+    }
+  }
+  /**
+   * Retires an object allocated with new
+   */
+  template <typename T>
+  inline void retire(T* ptr) {
+    retire(const_cast<std::remove_cv_t<T>*>(ptr), &cxhelper::delete_object<std::remove_cv_t<T>>);
+  }
+  /**
+   * Tries to advance the epoch and frees what the calling thread and exited threads retired long enough ago
+   * @return the number of freed objects
+   */
+  inline size_t collect() {
+    cxhelper::EpochRecord* record = cxhelper::epoch_record(state_);
+    state_->try_advance();
+    size_t freed = state_->collect(record->retired);
+    std::unique_lock<std::mutex> lock(state_->orphan_mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+      freed += state_->collect(state_->orphans);
+    }
+    return freed;
+  }
+  /**
+   * Waits until everything the calling thread retired so far is freed - spins while other threads stay
+   * pinned, must not be called inside a guard
+   */
+  inline void synchronize() {
+    cxhelper::EpochRecord* record = cxhelper::epoch_record(state_);
+    CX_ASSERT(record->nesting == 0, "synchronize() inside a guard never finishes");
+    while (!record->retired.empty()) {
+      collect();
+      std::this_thread::yield();
+    }
+  }
+  /**
+   * @return the number of objects the calling thread retired that are not freed yet
+   */
+  [[nodiscard]] inline size_t pending() const { return cxhelper::epoch_record(state_)->retired.size(); }
+  /**
+   * @return the current global epoch
+   */
+  [[nodiscard]] inline uint64_t epoch() const noexcept { return state_->epoch.load(std::memory_order_relaxed); }
+};
+
+/**
+ * <h2>HazardDomain</h2>
+ * Hazard pointers: a reader announces every pointer it is about to use in one of its hazard slots,
+ * a retired node is only freed if no slot holds it.
+ * <br><br>
+ * Unlike epochs a stalled reader only keeps the few nodes it protects alive, at the cost of a fence per
+ * protect(). Retired nodes are collected in a shared lock-free list and scanned once there are more of
+ * them than twice the number of hazard slots.
+ * <pre>
+ * auto hp = domain.make_hazard_pointer();
+ * Node* node = hp.protect(head);   // valid until hp is reset or protects something else
+ * </pre>
+ */
+class HazardDomain {
+  std::atomic<cxhelper::HazardRecord*> records_{nullptr};
+  std::atomic<cxhelper::HazardRetired*> retired_{nullptr};
+  std::atomic<size_t> retired_count_{0};
+  std::atomic<size_t> record_count_{0};
+
+  cxhelper::HazardRecord* acquire() {
+    for (auto* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+      bool expected = false;
+      if (!record->in_use.load(std::memory_order_relaxed) &&
+          record->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+        return record;
+      }
+    }
+    auto* record = new cxhelper::HazardRecord();
+    record->in_use.store(true, std::memory_order_relaxed);
+    auto* head = records_.load(std::memory_order_relaxed);
+    do {
+      record->next = head;
+    } while (!records_.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+    record_count_.fetch_add(1, std::memory_order_relaxed);
+    return record;
+  }
+  inline void push_retired(cxhelper::HazardRetired* first, cxhelper::HazardRetired* last) noexcept {
+    auto* head = retired_.load(std::memory_order_relaxed);
+    do {
+      last->next = head;
+    } while (!retired_.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+ public:
+  HazardDomain() = default;
+  HazardDomain(const HazardDomain&) = delete;
+  HazardDomain& operator=(const HazardDomain&) = delete;
+  /**
+   * Frees everything still retired - no hazard pointer may be in use anymore
+   */
+  ~HazardDomain() {
+    for (auto* node = retired_.exchange(nullptr); node;) {
+      auto* next = node->next;
+      node->deleter(node->ptr);
+      cxhelper::delete_hazard_retired(node);
+      node = next;
+    }
+    for (auto* record = records_.load(); record;) {
+      auto* next = record->next;
+      delete record;
+      record = next;
+    }
+  }
+  /**
+   * The library wide domain, never destroyed so it outlives every thread using it
+   */
+  static HazardDomain& global() {
+    static auto* domain = new HazardDomain();
+    return *domain;
+  }
+  /**
+   * One hazard slot - move only, gives the slot back when destroyed
+   */
+  class HazardPointer {
+    HazardDomain* domain_;
+    cxhelper::HazardRecord* record_;
+
+   public:
+    explicit HazardPointer(HazardDomain& domain) : domain_(&domain), record_(domain.acquire()) {}
+    HazardPointer(HazardPointer&& o) noexcept
+        : domain_(o.domain_), record_(std::exchange(o.record_, nullptr)) {}
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+    HazardPointer& operator=(HazardPointer&&) = delete;
+    ~HazardPointer() {
+      if (record_) {
+        record_->ptr.store(nullptr, std::memory_order_release);
+        record_->in_use.store(false, std::memory_order_release);
+      }
+    }
+    /**
+     * Loads src and protects the loaded pointer - retries until src still holds it after announcing it
+     * @return the protected pointer, valid until reset() or the next protect()
+     */
+    template <typename T>
+    inline T* protect(const std::atomic<T*>& src) noexcept {
+      T* ptr = src.load(std::memory_order_relaxed);
+      while (true) {
+        record_->ptr.store(ptr, std::memory_order_seq_cst);
+        T* again = src.load(std::memory_order_seq_cst);
+        if (again == ptr) {
+          return ptr;
+        }
+        ptr = again;
+      }
+    }
+    /**
+     * Ends the protection
+     */
+    inline void reset() noexcept { record_->ptr.store(nullptr, std::memory_order_release); }
+  };
+  [[nodiscard]] inline HazardPointer make_hazard_pointer() { return HazardPointer(*this); }
+  /**
+   * Frees ptr with deleter once no hazard pointer protects it. Call after unlinking ptr
+   */
+  inline void retire(void* ptr, void (*deleter)(void*)) {
+    auto* node = cxhelper::new_hazard_retired(ptr, deleter);
+    push_retired(node, node);
+    const size_t count = retired_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count >= std::max<size_t>(64, 2 * record_count_.load(std::memory_order_relaxed))) {
+      collect();
+    }
+  }
+  /**
+   * Retires an object allocated with new
+   */
+  template <typename T>
+  inline void retire(T* ptr) {
+    retire(const_cast<std::remove_cv_t<T>*>(ptr), &cxhelper::delete_object<std::remove_cv_t<T>>);
+  }
+  /**
+   * Frees every retired object no hazard pointer protects
+   * @return the number of freed objects
+   */
+  inline size_t collect() {
+    auto* list = retired_.exchange(nullptr, std::memory_order_acquire);
+    if (!list) {
+      return 0;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::vector<const void*> hazards;
+    for (auto* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+      if (const void* ptr = record->ptr.load(std::memory_order_seq_cst)) {
+        hazards.push_back(ptr);
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    cxhelper::HazardRetired *kept_first = nullptr, *kept_last = nullptr;
+    size_t freed = 0, kept = 0;
+    while (list) {
+      auto* next = list->next;
+      if (std::binary_search(hazards.begin(), hazards.end(), static_cast<const void*>(list->ptr))) {
+        list->next = kept_first;
+        kept_first = list;
+        kept_last = kept_last ? kept_last : list;
+        kept++;
+      } else {
+        list->deleter(list->ptr);
+        cxhelper::delete_hazard_retired(list);
+        freed++;
+      }
+      list = next;
+    }
+    retired_count_.fetch_sub(freed, std::memory_order_relaxed);
+    if (kept_first) {
+      push_retired(kept_first, kept_last);
+    }
+    return freed;
+  }
+  /**
+   * @return the number of retired objects that are not freed yet
+   */
+  [[nodiscard]] inline size_t pending() const noexcept { return retired_count_.load(std::memory_order_relaxed); }
+};
+
+/**
+ * <h2>rcu_ptr</h2>
+ * Read-copy-update pointer for read-mostly data: readers get the current version without locks, a writer
+ * builds a new version and publishes it with one atomic exchange. The old version is retired and freed
+ * once the last reader that could see it is gone.
+ * <br><br>
+ * Works for whole structures like a Trie, StaticHashMap or QuadTree - readers keep querying the old one
+ * while the new one is built. Versions are allocated with the allocation policy (the shared pools by
+ * default). Writers are serialized by a mutex, readers never touch it.
+ * <pre>
+ * rcu_ptr<StaticHashMap<int, int>> table;
+ * table.emplace(map);                                  // writer
+ * if (auto read = table.read()) { read->find(key); }   // reader
+ * </pre>
+ * @tparam T the published type
+ * @tparam Domain EpochDomain (cheapest reads) or HazardDomain (bounded memory with stalled readers)
+ * @tparam Policy allocation policy of the versions - PoolAlloc or StdAlloc
+ */
+template <typename T, typename Domain = EpochDomain, AllocPolicy Policy = PoolAlloc>
+class rcu_ptr {
+  static_assert(std::is_same_v<Domain, EpochDomain> || std::is_same_v<Domain, HazardDomain>,
+                "rcu_ptr works with EpochDomain or HazardDomain");
+  static_assert(Policy != ArenaAlloc, "versions are freed from other threads, arenas can not do that");
+  using Alloc = cxhelper::policy_allocator_t<T, Policy>;
+  using Token = std::conditional_t<std::is_same_v<Domain, EpochDomain>, EpochDomain::Guard,
+                                   HazardDomain::HazardPointer>;
+
+  std::atomic<T*> ptr_{nullptr};
+  Domain* domain_;
+  std::mutex write_mutex_;
+
+  template <typename... Args>
+  static T* create(Args&&... args) {
+    Alloc alloc;
+    T* ptr = std::allocator_traits<Alloc>::allocate(alloc, 1);
+    try {
+      std::allocator_traits<Alloc>::construct(alloc, ptr, std::forward<Args>(args)...);
+    } catch (...) {
+      std::allocator_traits<Alloc>::deallocate(alloc, ptr, 1);
+      throw;
+    }
+    return ptr;
+  }
+  static void destroy(void* ptr) {
+    Alloc alloc;
+    std::allocator_traits<Alloc>::destroy(alloc, static_cast<T*>(ptr));
+    std::allocator_traits<Alloc>::deallocate(alloc, static_cast<T*>(ptr), 1);
+  }
+  inline void publish(T* next) {
+    if (T* old = ptr_.exchange(next, std::memory_order_acq_rel)) {
+      domain_->retire(old, &destroy);
+    }
+  }
+
+ public:
+  /**
+   * A reader's view of one version - stays valid and unchanged for the lifetime of the object
+   */
+  class ReadGuard {
+    Token token_;
+    const T* ptr_;
+
+   public:
+    ReadGuard(Token&& token, const T* ptr) noexcept : token_(std::move(token)), ptr_(ptr) {}
+    [[nodiscard]] inline const T* get() const noexcept { return ptr_; }
+    inline const T& operator*() const noexcept { return *ptr_; }
+    inline const T* operator->() const noexcept { return ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+  };
+
+  explicit rcu_ptr(Domain& domain = Domain::global()) : domain_(&domain) {}
+  rcu_ptr(const rcu_ptr&) = delete;
+  rcu_ptr& operator=(const rcu_ptr&) = delete;
+  /**
+   * Frees the current version - no reader may still use it
+   */
+  ~rcu_ptr() {
+    if (T* ptr = ptr_.load(std::memory_order_acquire)) {
+      destroy(ptr);
+    }
+  }
+  /**
+   * @return the current version, pinned until the guard is destroyed - empty if nothing was published
+   */
+  [[nodiscard]] inline ReadGuard read() const {
+    if constexpr (std::is_same_v<Domain, EpochDomain>) {
+      Token guard = domain_->pin();
+      return ReadGuard(std::move(guard), ptr_.load(std::memory_order_acquire));
+    } else {
+      Token hazard = domain_->make_hazard_pointer();
+      const T* ptr = hazard.protect(ptr_);
+      return ReadGuard(std::move(hazard), ptr);
+    }
+  }
+  /**
+   * Publishes a new version constructed from args
+   */
+  template <typename... Args>
+  inline void emplace(Args&&... args) {
+    T* next = create(std::forward<Args>(args)...);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    publish(next);
+  }
+  /**
+   * Builds a new version with func(T&) on a default constructed T and publishes it when func returns -
+   * for types that can not be copied, like Trie or QuadTree
+   */
+  template <typename Function>
+  inline void rebuild(Function func) {
+    T* next = create();
+    try {
+      func(*next);
+    } catch (...) {
+      destroy(next);
+      throw;
+    }
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    publish(next);
+  }
+  /**
+   * Copies the current version, applies func(T&) to the copy and publishes it. Concurrent updates are
+   * serialized, none of them is lost
+   */
+  template <typename Function>
+  inline void update(Function func) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const T* current = ptr_.load(std::memory_order_acquire);
+    T* next = current ? create(*current) : create();
+    try {
+      func(*next);
+    } catch (...) {
+      destroy(next);
+      throw;
+    }
+    publish(next);
+  }
+  /**
+   * Removes the current version, readers see an empty pointer from now on
+   */
+  inline void reset() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    publish(nullptr);
+  }
+  /**
+   * @return the domain versions are retired to
+   */
+  [[nodiscard]] inline Domain& domain() const noexcept { return *domain_; }
+};
+}  // namespace cxstructs
+
+#ifndef CX_DELETE_TESTS
+#include <iostream>
+#include "../cxstructs/StaticHashMap.h"
+#include "../cxstructs/Trie.h"
+namespace cxtests {
+namespace reclaim_test {
+inline std::atomic<int> live{0};
+struct Counted {
+  int value;
+  Counted* next = nullptr;
+  explicit Counted(int v) : value(v) { live++; }
+  ~Counted() { live--; }
+};
+// Treiber stack, pop() keeps the popped node protected while reading its next pointer
+template <typename Domain>
+struct Stack {
+  std::atomic<Counted*> head{nullptr};
+  Domain& domain;
+  explicit Stack(Domain& d) : domain(d) {}
+  ~Stack() {
+    for (Counted* node = head.load(); node;) {
+      Counted* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+  void push(int v) {
+    auto* node = new Counted(v);
+    node->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+  }
+  bool pop(int& out) {
+    if constexpr (std::is_same_v<Domain, cxstructs::EpochDomain>) {
+      auto guard = domain.pin();
+      Counted* node = head.load(std::memory_order_acquire);
+      while (node && !head.compare_exchange_weak(node, node->next, std::memory_order_acquire)) {}
+      if (!node) {
+        return false;
+      }
+      out = node->value;
+      domain.retire(node);
+    } else {
+      auto hp = domain.make_hazard_pointer();
+      Counted* node;
+      while (true) {
+        node = hp.protect(head);
+        if (!node) {
+          return false;
+        }
+        if (head.compare_exchange_strong(node, node->next, std::memory_order_acquire)) {
+          break;
+        }
+      }
+      hp.reset();
+      out = node->value;
+      domain.retire(node);
+    }
+    return true;
+  }
+};
+template <typename Domain>
+void stress_stack(Domain& domain) {
+  Stack<Domain> stack(domain);
+  std::atomic<long long> popped_sum{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&stack, &popped_sum, t] {
+      long long sum = 0;
+      int value;
+      for (int i = 0; i < 20000; i++) {
+        stack.push(t * 20000 + i);
+        if (stack.pop(value)) {
+          sum += value;
+        }
+      }
+      popped_sum += sum;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  int value;
+  long long rest = 0;
+  while (stack.pop(value)) {
+    rest += value;
+  }
+  const long long n = 80000;
+  CX_ASSERT(popped_sum + rest == n * (n - 1) / 2, "every value popped exactly once");
+}
+}  // namespace reclaim_test
+static void TEST_RECLAIM() {
+  using namespace cxstructs;
+  using reclaim_test::Counted;
+  using reclaim_test::live;
+  std::cout << "TESTING MEMORY RECLAMATION" << std::endl;
+
+  std::cout << "  Testing EpochDomain..." << std::endl;
+  {
+    EpochDomain domain;
+    const uint64_t start = domain.epoch();
+    for (int i = 0; i < 10; i++) {
+      domain.retire(new Counted(i));
+    }
+    CX_ASSERT(live == 10 && domain.pending() == 10, "");
+    domain.synchronize();
+    CX_ASSERT(live == 0 && domain.pending() == 0 && domain.epoch() >= start + 2, "");
+    // a pinned reader holds back everything retired after it pinned
+    std::atomic<int> stage{0};
+    std::thread reader([&] {
+      auto guard = domain.pin();
+      auto nested = domain.pin();
+      stage = 1;
+      while (stage != 2) {
+        std::this_thread::yield();
+      }
+    });
+    while (stage != 1) {
+      std::this_thread::yield();
+    }
+    domain.retire(new Counted(1));
+    for (int i = 0; i < 10; i++) {
+      domain.collect();
+    }
+    CX_ASSERT(live == 1, "");
+    stage = 2;
+    reader.join();
+    domain.synchronize();
+    CX_ASSERT(live == 0, "");
+    domain.retire(new Counted(2));
+  }
+  CX_ASSERT(live == 0, "the destructor frees what is left");
+  {
+    EpochDomain domain;
+    reclaim_test::stress_stack(domain);
+    domain.synchronize();
+  }
+  CX_ASSERT(live == 0, "");
+
+  std::cout << "  Testing HazardDomain..." << std::endl;
+  {
+    HazardDomain domain;
+    std::atomic<Counted*> shared{new Counted(7)};
+    auto hp = domain.make_hazard_pointer();
+    Counted* protected_node = hp.protect(shared);
+    CX_ASSERT(protected_node->value == 7, "");
+    shared.store(new Counted(8));
+    domain.retire(protected_node);
+    for (int i = 0; i < 100; i++) {
+      domain.retire(new Counted(i));
+    }
+    domain.collect();
+    CX_ASSERT(live == 2 && domain.pending() == 1 && protected_node->value == 7, "only the protected node is left");
+    hp.reset();
+    CX_ASSERT(domain.collect() == 1 && live == 1, "");
+    delete shared.load();
+    reclaim_test::stress_stack(domain);
+    domain.collect();
+  }
+  CX_ASSERT(live == 0, "");
+
+  std::cout << "  Testing rcu_ptr..." << std::endl;
+  {
+    // readers always see one complete version: every key maps to the version number
+    rcu_ptr<StaticHashMap<int, int>> table;
+    CX_ASSERT(!table.read(), "");
+    auto make_version = [](int version) {
+      std::vector<int> keys(200), values(200, version);
+      for (int i = 0; i < 200; i++) {
+        keys[i] = i * 3;
+      }
+      return StaticHashMap<int, int>(keys.data(), values.data(), keys.size());
+    };
+    table.emplace(make_version(0));
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+      readers.emplace_back([&] {
+        while (!stop) {
+          auto read = table.read();
+          const int version = *read->find(0);
+          for (int i = 0; i < 200; i++) {
+            torn += *read->find(i * 3) != version;
+          }
+        }
+      });
+    }
+    for (int version = 1; version < 300; version++) {
+      table.emplace(make_version(version));
+    }
+    stop = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    CX_ASSERT(torn == 0 && *table.read()->find(3) == 299, "");
+
+    rcu_ptr<std::vector<int>, HazardDomain, StdAlloc> list;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+      writers.emplace_back([&list] {
+        for (int i = 0; i < 250; i++) {
+          list.update([](std::vector<int>& v) { v.push_back(1); });
+          auto read = list.read();
+          CX_ASSERT(!read->empty(), "");
+        }
+      });
+    }
+    for (auto& writer : writers) {
+      writer.join();
+    }
+    CX_ASSERT(list.read()->size() == 1000, "no update is lost");
+    list.reset();
+    CX_ASSERT(!list.read(), "");
+
+    rcu_ptr<Trie> words;
+    words.rebuild([](Trie& trie) {
+      trie.insert("hello");
+      trie.insert("help");
+    });
+    auto before = words.read();
+    words.rebuild([](Trie& trie) { trie.insert("world"); });
+    CX_ASSERT(before->contains("help") && !before->contains("world"), "old readers keep their version");
+    CX_ASSERT(words.read()->contains("world") && words.read()->size() == 1, "");
+  }
+  EpochDomain::global().synchronize();
+  HazardDomain::global().collect();
+}
+}  // namespace cxtests
+#endif
+#endif  // CXSTRUCTS_SRC_CXUTIL_CXRECLAIM_H_